@@ -29,6 +29,53 @@
 #include "decoder/decodable-matrix.h"
 #include "base/timer.h"
 
+namespace kaldi {
+
+// Decodes all the utterances in "loglike_reader" with "decoder"; the decoding
+// graph may be an FST or a CompactDecodingGraph.
+template <typename FST>
+void DecodeLoglikes(LatticeFasterDecoderTpl<FST> *decoder,
+                    SequentialBaseFloatMatrixReader *loglike_reader,
+                    const TransitionModel &trans_model,
+                    const fst::SymbolTable *word_syms,
+                    BaseFloat acoustic_scale,
+                    bool determinize,
+                    bool allow_partial,
+                    Int32VectorWriter *alignment_writer,
+                    Int32VectorWriter *words_writer,
+                    CompactLatticeWriter *compact_lattice_writer,
+                    LatticeWriter *lattice_writer,
+                    double *tot_like,
+                    int64 *frame_count,
+                    int32 *num_success,
+                    int32 *num_fail) {
+  for (; !loglike_reader->Done(); loglike_reader->Next()) {
+    std::string utt = loglike_reader->Key();
+    Matrix<BaseFloat> loglikes (loglike_reader->Value());
+    loglike_reader->FreeCurrent();
+    if (loglikes.NumRows() == 0) {
+      KALDI_WARN << "Zero-length utterance: " << utt;
+      (*num_fail)++;
+      continue;
+    }
+
+    DecodableMatrixScaledMapped decodable(trans_model, loglikes, acoustic_scale);
+
+    double like;
+    if (DecodeUtteranceLatticeFaster(
+            *decoder, decodable, trans_model, word_syms, utt,
+            acoustic_scale, determinize, allow_partial, alignment_writer,
+            words_writer, compact_lattice_writer, lattice_writer,
+            &like)) {
+      *tot_like += like;
+      *frame_count += loglikes.NumRows();
+      (*num_success)++;
+    } else (*num_fail)++;
+  }
+}
+
+}  // namespace kaldi
+
 
 int main(int argc, char *argv[]) {
   try {
@@ -42,7 +89,8 @@ int main(int argc, char *argv[]) {
         "Generate lattices, reading log-likelihoods as matrices\n"
         " (model is needed only for the integer mappings in its transition-model)\n"
         "Usage: latgen-faster-mapped [options] trans-model-in (fst-in|fsts-rspecifier) loglikes-rspecifier"
-        " lattice-wspecifier [ words-wspecifier [alignments-wspecifier] ]\n";
+        " lattice-wspecifier [ words-wspecifier [alignments-wspecifier] ]\n"
+        "fst-in may also be a graph converted by make-compact-graph.\n";
     ParseOptions po(usage);
     Timer timer;
     bool allow_partial = false;
@@ -93,39 +141,32 @@ int main(int argc, char *argv[]) {
 
     double tot_like = 0.0;
     kaldi::int64 frame_count = 0;
-    int num_success = 0, num_fail = 0;
+    int32 num_success = 0, num_fail = 0;
 
-    if (ClassifyRspecifier(fst_in_str, NULL, NULL) == kNoRspecifier) {
+    if (IsCompactDecodingGraph(fst_in_str)) {
+      SequentialBaseFloatMatrixReader loglike_reader(feature_rspecifier);
+      CompactDecodingGraph decode_graph;
+      ReadKaldiObject(fst_in_str, &decode_graph);
+      LatticeFasterDecoderTpl<CompactDecodingGraph> decoder(decode_graph,
+                                                            config);
+      DecodeLoglikes(&decoder, &loglike_reader, trans_model, word_syms,
+                     acoustic_scale, determinize, allow_partial,
+                     &alignment_writer, &words_writer, &compact_lattice_writer,
+                     &lattice_writer, &tot_like, &frame_count, &num_success,
+                     &num_fail);
+    } else if (ClassifyRspecifier(fst_in_str, NULL, NULL) == kNoRspecifier) {
       SequentialBaseFloatMatrixReader loglike_reader(feature_rspecifier);
       // Input FST is just one FST, not a table of FSTs.
       VectorFst<StdArc> *decode_fst = fst::ReadFstKaldi(fst_in_str);
 
       {
-        LatticeFasterDecoder decoder(*decode_fst, config);
-    
-        for (; !loglike_reader.Done(); loglike_reader.Next()) {
-          std::string utt = loglike_reader.Key();
-          Matrix<BaseFloat> loglikes (loglike_reader.Value());
-          loglike_reader.FreeCurrent();
-          if (loglikes.NumRows() == 0) {
-            KALDI_WARN << "Zero-length utterance: " << utt;
-            num_fail++;
-            continue;
-          }
-      
-          DecodableMatrixScaledMapped decodable(trans_model, loglikes, acoustic_scale);
-
-          double like;
-          if (DecodeUtteranceLatticeFaster(
-                  decoder, decodable, trans_model, word_syms, utt,
-                  acoustic_scale, determinize, allow_partial, &alignment_writer,
-                  &words_writer, &compact_lattice_writer, &lattice_writer,
-                  &like)) {
-            tot_like += like;
-            frame_count += loglikes.NumRows();
-            num_success++;
-          } else num_fail++;
-        }
+        LatticeFasterDecoderTpl<VectorFst<StdArc> > decoder(*decode_fst,
+                                                            config);
+        DecodeLoglikes(&decoder, &loglike_reader, trans_model, word_syms,
+                       acoustic_scale, determinize, allow_partial,
+                       &alignment_writer, &words_writer,
+                       &compact_lattice_writer, &lattice_writer, &tot_like,
+                       &frame_count, &num_success, &num_fail);
       }
       delete decode_fst; // delete this only after decoder goes out of scope.
     } else { // We have different FSTs for different utterances.
@@ -145,7 +186,8 @@ int main(int argc, char *argv[]) {
           num_fail++;
           continue;
         }
-        LatticeFasterDecoder decoder(fst_reader.Value(), config);
+        LatticeFasterDecoderTpl<VectorFst<StdArc> > decoder(fst_reader.Value(),
+                                                            config);
         DecodableMatrixScaledMapped decodable(trans_model, loglikes, acoustic_scale);
         double like;
         if (DecodeUtteranceLatticeFaster(
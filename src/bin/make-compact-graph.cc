@@ -0,0 +1,67 @@
+// bin/make-compact-graph.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "fstext/kaldi-fst-io.h"
+#include "decoder/compact-decoding-graph.h"
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+
+    const char *usage =
+        "Converts a decoding graph (e.g. HCLG.fst) to the format of class\n"
+        "CompactDecodingGraph, in which the emitting and nonemitting arcs\n"
+        "are stored separately in a compact form, which makes decoding\n"
+        "faster.  Decoding programs that support it (e.g.\n"
+        "latgen-faster-mapped) accept the output in place of the FST, if it\n"
+        "is given as a file.\n"
+        "\n"
+        "Usage: make-compact-graph <fst-in> <compact-graph-out>\n"
+        " e.g.: make-compact-graph exp/tri3/graph/HCLG.fst HCLG.compact\n";
+
+    ParseOptions po(usage);
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 2) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string fst_rxfilename = po.GetArg(1),
+        graph_wxfilename = po.GetArg(2);
+
+    fst::Fst<fst::StdArc> *fst = fst::ReadFstKaldiMapped(fst_rxfilename);
+    CompactDecodingGraph graph;
+    graph.Init(*fst);
+    delete fst;
+
+    WriteKaldiObject(graph, graph_wxfilename, true);
+
+    KALDI_LOG << "Wrote compact graph with " << graph.NumStates()
+              << " states, " << graph.NumEmittingArcs() << " emitting and "
+              << graph.NumNonemittingArcs() << " nonemitting arcs ("
+              << graph.MemoryInBytes() << " bytes) to " << graph_wxfilename;
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
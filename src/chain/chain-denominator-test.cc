@@ -0,0 +1,115 @@
+// chain/chain-denominator-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "chain/chain-denominator.h"
+#include "base/timer.h"
+
+namespace kaldi {
+namespace chain {
+
+// Creates a random FST with roughly the shape of a denominator FST: each state
+// has "num_arcs" arcs to random states, with pdf-ids plus one as the labels and
+// probabilities that sum to one.
+static void RandomDenominatorFst(int32 num_states, int32 num_arcs,
+                                 int32 num_pdfs, fst::StdVectorFst *fst) {
+  fst->DeleteStates();
+  for (int32 s = 0; s < num_states; s++)
+    fst->AddState();
+  fst->SetStart(0);
+  BaseFloat cost = Log(static_cast<BaseFloat>(num_arcs));
+  for (int32 s = 0; s < num_states; s++) {
+    for (int32 i = 0; i < num_arcs; i++) {
+      int32 pdf_id = RandInt(0, num_pdfs - 1);
+      fst->AddArc(s, fst::StdArc(pdf_id + 1, pdf_id + 1,
+                                 fst::TropicalWeight(cost),
+                                 RandInt(0, num_states - 1)));
+    }
+  }
+}
+
+// Does the forward-backward with "num_threads" threads and returns the
+// objective function; puts the derivative in "nnet_output_deriv" and the time
+// taken in "elapsed".
+static BaseFloat DenominatorForwardBackward(
+    const DenominatorGraph &den_graph,
+    int32 num_sequences,
+    const CuMatrixBase<BaseFloat> &nnet_output,
+    int32 num_threads,
+    CuMatrix<BaseFloat> *nnet_output_deriv,
+    double *elapsed) {
+  ChainTrainingOptions opts;
+  opts.num_threads = num_threads;
+  Timer timer;
+  DenominatorComputation denominator_computation(opts, den_graph,
+                                                 num_sequences, nnet_output);
+  BaseFloat forward_prob = denominator_computation.Forward();
+  nnet_output_deriv->Resize(nnet_output.NumRows(), nnet_output.NumCols());
+  denominator_computation.Backward(1.0, nnet_output_deriv);
+  *elapsed = timer.Elapsed();
+  return forward_prob;
+}
+
+// Checks that the multi-threaded computation gives the same results as the
+// single-threaded one, and prints the time taken by each.
+static void TestDenominatorThreads(int32 num_states, int32 num_arcs,
+                                   int32 num_pdfs, int32 num_sequences,
+                                   int32 frames_per_sequence,
+                                   int32 num_threads) {
+  fst::StdVectorFst den_fst;
+  RandomDenominatorFst(num_states, num_arcs, num_pdfs, &den_fst);
+  DenominatorGraph den_graph(den_fst, num_pdfs);
+
+  CuMatrix<BaseFloat> nnet_output(num_sequences * frames_per_sequence,
+                                  num_pdfs);
+  nnet_output.SetRandn();
+
+  CuMatrix<BaseFloat> deriv1, deriv2;
+  double time1, time2;
+  BaseFloat objf1 = DenominatorForwardBackward(den_graph, num_sequences,
+                                               nnet_output, 1, &deriv1, &time1),
+      objf2 = DenominatorForwardBackward(den_graph, num_sequences,
+                                         nnet_output, num_threads, &deriv2,
+                                         &time2);
+  KALDI_LOG << "Denominator forward-backward with " << num_states
+            << " states, " << num_sequences << " sequences of "
+            << frames_per_sequence << " frames took " << time1
+            << " seconds with one thread, " << time2 << " with "
+            << num_threads << " threads.";
+  // Each sequence is computed in the same way however the sequences are split
+  // among the threads, so the results should be the same.
+  KALDI_ASSERT(ApproxEqual(objf1, objf2, 1.0e-05));
+  KALDI_ASSERT(deriv1.ApproxEqual(deriv2, 1.0e-05));
+}
+
+}  // namespace chain
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  using namespace kaldi::chain;
+#if HAVE_CUDA == 1
+  // This tests the CPU code.
+  CuDevice::Instantiate().SelectGpuId("no");
+#endif
+  for (int32 i = 0; i < 5; i++)
+    TestDenominatorThreads(RandInt(1, 100), RandInt(1, 5), RandInt(1, 50),
+                           RandInt(1, 13), RandInt(1, 20), RandInt(2, 4));
+  // The size of a typical denominator graph, to compare the speed.
+  TestDenominatorThreads(10000, 10, 3000, 64, 20, 4);
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
@@ -20,10 +20,48 @@
 
 #include "chain/chain-denominator.h"
 #include "chain/chain-kernels-ansi.h"
+#include "chain/chain-kernels-cpu.h"
+#include "thread/kaldi-thread.h"
 
 namespace kaldi {
 namespace chain {
 
+// This is used when we are not using a GPU and opts.num_threads > 1.  The
+// sequences are independent, so each thread does the whole forward or
+// backward computation for a range of the sequences; see
+// DenominatorComputation::ForwardCpuRange() and BackwardCpuRange().
+class DenominatorCpuTask: public MultiThreadable {
+ public:
+  // Does the forward computation if "nnet_output_deriv" is NULL, else the
+  // backward computation.
+  DenominatorCpuTask(DenominatorComputation *computation,
+                     BaseFloat deriv_weight,
+                     CuMatrixBase<BaseFloat> *nnet_output_deriv):
+      computation_(computation), deriv_weight_(deriv_weight),
+      nnet_output_deriv_(nnet_output_deriv) { }
+
+  void operator () () {
+    // Each thread gets a range of sequences whose size is a multiple of 4, so
+    // that it can be done entirely with SIMD instructions.
+    int32 num_sequences = computation_->num_sequences_,
+        block_size = (num_sequences + num_threads_ - 1) / num_threads_;
+    block_size = 4 * ((block_size + 3) / 4);
+    int32 seq_begin = std::min(thread_id_ * block_size, num_sequences),
+        seq_end = std::min(seq_begin + block_size, num_sequences);
+    if (seq_begin == seq_end)
+      return;
+    if (nnet_output_deriv_ == NULL)
+      computation_->ForwardCpuRange(seq_begin, seq_end);
+    else
+      computation_->BackwardCpuRange(deriv_weight_, nnet_output_deriv_,
+                                     seq_begin, seq_end);
+  }
+ private:
+  DenominatorComputation *computation_;
+  BaseFloat deriv_weight_;
+  CuMatrixBase<BaseFloat> *nnet_output_deriv_;
+};
+
 DenominatorComputation::DenominatorComputation(
     const ChainTrainingOptions &opts,
     const DenominatorGraph &den_graph,
@@ -61,6 +99,15 @@ DenominatorComputation::DenominatorComputation(
 }
 
 
+bool DenominatorComputation::UseCpuThreads() const {
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled())
+    return false;
+#endif
+  return opts_.num_threads > 1;
+}
+
+
 void DenominatorComputation::AlphaFirstFrame() {
   // dim == num_hmm_states_ * num_sequences_.
   BaseFloat *first_frame_alpha = alpha_.RowData(0);
@@ -80,21 +127,21 @@ void DenominatorComputation::AlphaFirstFrame() {
 // the alpha computation for some 0 < t <= num_time_steps_.
 void DenominatorComputation::AlphaGeneralFrame(int32 t) {
   KALDI_ASSERT(t > 0 && t <= frames_per_sequence_);
-  BaseFloat *this_alpha = alpha_.RowData(t);
-  const BaseFloat *prev_alpha_dash = alpha_.RowData(t - 1);
-  const Int32Pair *backward_transitions = den_graph_.BackwardTransitions();
-  const DenominatorGraphTransition *transitions = den_graph_.Transitions();
-  int32 num_pdfs = exp_nnet_output_transposed_.NumRows(),
-      num_hmm_states = den_graph_.NumStates(),
-      num_sequences = num_sequences_;
-
-  // 'probs' is the matrix of pseudo-likelihoods for frame t - 1.
-  CuSubMatrix<BaseFloat> probs(exp_nnet_output_transposed_, 0, num_pdfs,
-                               (t-1) * num_sequences_, num_sequences_);
-  const BaseFloat *prob_data = probs.Data();
-
 #if HAVE_CUDA == 1
   if (CuDevice::Instantiate().Enabled()) {
+    BaseFloat *this_alpha = alpha_.RowData(t);
+    const BaseFloat *prev_alpha_dash = alpha_.RowData(t - 1);
+    const Int32Pair *backward_transitions = den_graph_.BackwardTransitions();
+    const DenominatorGraphTransition *transitions = den_graph_.Transitions();
+    int32 num_pdfs = exp_nnet_output_transposed_.NumRows(),
+        num_hmm_states = den_graph_.NumStates(),
+        num_sequences = num_sequences_;
+
+    // 'probs' is the matrix of pseudo-likelihoods for frame t - 1.
+    CuSubMatrix<BaseFloat> probs(exp_nnet_output_transposed_, 0, num_pdfs,
+                                 (t-1) * num_sequences_, num_sequences_);
+    const BaseFloat *prob_data = probs.Data();
+
     Timer tim;
     dim3 dimBlock(std::min<int32>(CU1DBLOCK, num_sequences), 1, 1);
     dim3 dimGrid(n_blocks(num_sequences, dimBlock.x), num_hmm_states, 1);
@@ -124,52 +171,43 @@ void DenominatorComputation::AlphaGeneralFrame(int32 t) {
   } else
 #endif
   {
-    int32 prob_stride = probs.Stride();
-    for (int32 h = 0; h < num_hmm_states; h++) {
-      for (int32 s = 0; s < num_sequences; s++) {
-        double this_tot_alpha = 0.0;
-        const DenominatorGraphTransition
-            *trans_iter = transitions + backward_transitions[h].first,
-            *trans_end = transitions + backward_transitions[h].second;
-        for (; trans_iter != trans_end; ++trans_iter) {
-          BaseFloat transition_prob = trans_iter->transition_prob;
-          int32 pdf_id = trans_iter->pdf_id,
-              prev_hmm_state = trans_iter->hmm_state;
-          BaseFloat prob = prob_data[pdf_id * prob_stride + s],
-              this_prev_alpha = prev_alpha_dash[prev_hmm_state * num_sequences + s];
-          this_tot_alpha += this_prev_alpha * transition_prob * prob;
-        }
-        // Let arbitrary_scale be the inverse of the alpha-sum value that we
-        // store in the same place we'd store the alpha for the state numbered
-        // 'num_hmm_states'. We multiply this into all the
-        // transition-probabilities from the previous frame to this frame, in
-        // both the forward and backward passes, in order to keep the alphas in
-        // a good numeric range.  This won't affect the posteriors, but when
-        // computing the total likelihood we'll need to compensate for it later
-        // on.
-        BaseFloat arbitrary_scale =
-            1.0 / prev_alpha_dash[num_hmm_states * num_sequences + s];
-        KALDI_ASSERT(this_tot_alpha - this_tot_alpha == 0);
-        this_alpha[h * num_sequences + s] = this_tot_alpha * arbitrary_scale;
-      }
-    }
+    AlphaGeneralFrameCpu(t, 0, num_sequences_);
   }
 }
 
+void DenominatorComputation::AlphaGeneralFrameCpu(int32 t, int32 seq_begin,
+                                                  int32 seq_end) {
+  int32 num_pdfs = exp_nnet_output_transposed_.NumRows();
+  // 'probs' is the matrix of pseudo-likelihoods for frame t - 1.
+  CuSubMatrix<BaseFloat> probs(exp_nnet_output_transposed_, 0, num_pdfs,
+                               (t-1) * num_sequences_, num_sequences_);
+  ChainHmmForwardCpu(den_graph_.BackwardTransitions(),
+                     den_graph_.Transitions(),
+                     num_sequences_, seq_begin, seq_end,
+                     den_graph_.NumStates(),
+                     probs.Data(), probs.Stride(),
+                     alpha_.RowData(t - 1), alpha_.RowData(t));
+}
+
 void DenominatorComputation::AlphaDash(int32 t) {
-  BaseFloat *this_alpha = alpha_.RowData(t);
+  AlphaDash(t, 0, num_sequences_);
+}
+
+void DenominatorComputation::AlphaDash(int32 t, int32 seq_begin,
+                                       int32 seq_end) {
+  BaseFloat *this_alpha = alpha_.RowData(t) + seq_begin;
 
   // create a 'fake matrix' for the regular alphas- view this row as a matrix.
   // initializer takes [pointer, num-rows, num-cols, stride].
   CuSubMatrix<BaseFloat> alpha_mat(this_alpha,
                                    den_graph_.NumStates(),
-                                   num_sequences_,
+                                   seq_end - seq_begin,
                                    num_sequences_);
 
   // the alpha-dash is the sum of alpha over all states.
   CuSubVector<BaseFloat> alpha_sum_vec(this_alpha +
                                        den_graph_.NumStates() * num_sequences_,
-                                       num_sequences_);
+                                       seq_end - seq_begin);
   alpha_sum_vec.AddRowSumMat(1.0, alpha_mat, 0.0);
 
   alpha_mat.AddVecVec(opts_.leaky_hmm_coefficient,
@@ -178,21 +216,25 @@ void DenominatorComputation::AlphaDash(int32 t) {
   // it's now alpha-dash.
 }
 
-// compute beta from beta-dash.
 void DenominatorComputation::Beta(int32 t) {
-  BaseFloat *this_beta_dash = beta_.RowData(t % 2);
+  Beta(t, 0, num_sequences_);
+}
+
+// compute beta from beta-dash.
+void DenominatorComputation::Beta(int32 t, int32 seq_begin, int32 seq_end) {
+  BaseFloat *this_beta_dash = beta_.RowData(t % 2) + seq_begin;
   // create a 'fake matrix' for the regular beta-dash (which is
   // the counterpart of alpha-dash)- view this row as a matrix.
   // initializer takes [pointer, num-rows, num-cols, stride].
   CuSubMatrix<BaseFloat> beta_dash_mat(this_beta_dash,
                                        den_graph_.NumStates(),
-                                       num_sequences_,
+                                       seq_end - seq_begin,
                                        num_sequences_);
   // making the t index implicit, the beta-dash-sum for each sequence is the sum
   // over all states i of beta_i * opts_.leaky_hmm_coefficient * initial_prob_i.
   CuSubVector<BaseFloat> beta_dash_sum_vec(
       this_beta_dash + den_graph_.NumStates() * num_sequences_,
-      num_sequences_);
+      seq_end - seq_begin);
   beta_dash_sum_vec.AddMatVec(opts_.leaky_hmm_coefficient, beta_dash_mat,
                               kTrans, den_graph_.InitialProbs(), 0.0);
   // we are computing beta in place.  After the following, beta-dash-mat
@@ -203,14 +245,29 @@ void DenominatorComputation::Beta(int32 t) {
 
 BaseFloat DenominatorComputation::Forward() {
   AlphaFirstFrame();
-  AlphaDash(0);
-  for (int32 t = 1; t <= frames_per_sequence_; t++) {
-    AlphaGeneralFrame(t);
-    AlphaDash(t);
+  if (UseCpuThreads()) {
+    // The threads are joined when "threads" goes out of scope.
+    MultiThreader<DenominatorCpuTask> threads(
+        opts_.num_threads, DenominatorCpuTask(this, 0.0, NULL));
+  } else {
+    AlphaDash(0);
+    for (int32 t = 1; t <= frames_per_sequence_; t++) {
+      AlphaGeneralFrame(t);
+      AlphaDash(t);
+    }
   }
   return ComputeTotLogLike();
 }
 
+void DenominatorComputation::ForwardCpuRange(int32 seq_begin,
+                                             int32 seq_end) {
+  AlphaDash(0, seq_begin, seq_end);
+  for (int32 t = 1; t <= frames_per_sequence_; t++) {
+    AlphaGeneralFrameCpu(t, seq_begin, seq_end);
+    AlphaDash(t, seq_begin, seq_end);
+  }
+}
+
 BaseFloat DenominatorComputation::ComputeTotLogLike() {
   tot_prob_.Resize(num_sequences_);
   // View the last alpha-dash as a matrix of size num-hmm-states by num-sequences.
@@ -253,32 +310,85 @@ bool DenominatorComputation::Backward(
     BaseFloat deriv_weight,
     CuMatrixBase<BaseFloat> *nnet_output_deriv) {
   BetaDashLastFrame();
+  if (UseCpuThreads()) {
+    {
+      // The threads are joined when "threads" goes out of scope.  They stop
+      // after the beta-dash of frame 0, so that BetaGeneralFrameDebug() can
+      // check all the sequences; the per-frame checks that are done at
+      // verbose level >= 1 without threads are not done.
+      MultiThreader<DenominatorCpuTask> threads(
+          opts_.num_threads,
+          DenominatorCpuTask(this, deriv_weight, nnet_output_deriv));
+    }
+    BetaGeneralFrameDebug(0);
+    Beta(0);
+    CommitDerivs(0, deriv_weight, nnet_output_deriv, 0, num_sequences_);
+    return ok_;
+  }
   Beta(frames_per_sequence_);
   for (int32 t = frames_per_sequence_ - 1; t >= 0; t--) {
     BetaDashGeneralFrame(t);
     if (GetVerboseLevel() >= 1 || t == 0)
       BetaGeneralFrameDebug(t);
     Beta(t);
-    if (t % kMaxDerivTimeSteps == 0) {
-      // commit the derivative stored in exp_nnet_output_transposed_ by adding
-      // its transpose to the appropriate sub-matrix of 'nnet_output_deriv'.
-      int32 chunk_frames = std::min<int32>(static_cast<int32>(kMaxDerivTimeSteps),
-                                           frames_per_sequence_ - t),
-                num_pdfs = exp_nnet_output_transposed_.NumRows();
+    if (t % kMaxDerivTimeSteps == 0)
+      CommitDerivs(t, deriv_weight, nnet_output_deriv, 0, num_sequences_);
+  }
+  return ok_;
+}
+
+void DenominatorComputation::BackwardCpuRange(
+    BaseFloat deriv_weight,
+    CuMatrixBase<BaseFloat> *nnet_output_deriv,
+    int32 seq_begin, int32 seq_end) {
+  Beta(frames_per_sequence_, seq_begin, seq_end);
+  for (int32 t = frames_per_sequence_ - 1; t > 0; t--) {
+    BetaDashGeneralFrameCpu(t, seq_begin, seq_end);
+    Beta(t, seq_begin, seq_end);
+    if (t % kMaxDerivTimeSteps == 0)
+      CommitDerivs(t, deriv_weight, nnet_output_deriv, seq_begin, seq_end);
+  }
+  BetaDashGeneralFrameCpu(0, seq_begin, seq_end);
+}
+
+void DenominatorComputation::CommitDerivs(
+    int32 t, BaseFloat deriv_weight,
+    CuMatrixBase<BaseFloat> *nnet_output_deriv,
+    int32 seq_begin, int32 seq_end) {
+  // commit the derivative stored in nnet_output_deriv_transposed_ by adding
+  // its transpose to the appropriate sub-matrix of 'nnet_output_deriv'.
+  int32 chunk_frames = std::min<int32>(static_cast<int32>(kMaxDerivTimeSteps),
+                                       frames_per_sequence_ - t),
+            num_pdfs = exp_nnet_output_transposed_.NumRows();
+  if (seq_begin == 0 && seq_end == num_sequences_) {
+    CuSubMatrix<BaseFloat> transposed_deriv_part(
+        nnet_output_deriv_transposed_,
+        0, num_pdfs,
+        0, chunk_frames * num_sequences_);
+    CuSubMatrix<BaseFloat> output_deriv_part(
+        *nnet_output_deriv,
+        t * num_sequences_, chunk_frames * num_sequences_,
+        0, num_pdfs);
+    output_deriv_part.AddMat(deriv_weight, transposed_deriv_part, kTrans);
+    if (t != 0)
+      transposed_deriv_part.SetZero();
+  } else {
+    // Only some of the sequences, so the rows and columns we need are not
+    // contiguous; we do one frame at a time.
+    for (int32 f = 0; f < chunk_frames; f++) {
       CuSubMatrix<BaseFloat> transposed_deriv_part(
           nnet_output_deriv_transposed_,
           0, num_pdfs,
-          0, chunk_frames * num_sequences_);
+          f * num_sequences_ + seq_begin, seq_end - seq_begin);
       CuSubMatrix<BaseFloat> output_deriv_part(
           *nnet_output_deriv,
-          t * num_sequences_, chunk_frames * num_sequences_,
+          (t + f) * num_sequences_ + seq_begin, seq_end - seq_begin,
           0, num_pdfs);
       output_deriv_part.AddMat(deriv_weight, transposed_deriv_part, kTrans);
       if (t != 0)
         transposed_deriv_part.SetZero();
     }
   }
-  return ok_;
 }
 
 void DenominatorComputation::BetaDashLastFrame() {
@@ -303,28 +413,28 @@ void DenominatorComputation::BetaDashLastFrame() {
 
 void DenominatorComputation::BetaDashGeneralFrame(int32 t) {
   KALDI_ASSERT(t >= 0 && t < frames_per_sequence_);
-  int32 num_pdfs = exp_nnet_output_transposed_.NumRows();
-  // t_wrapped gives us the time-index we use when indexing
-  // nnet_output_deriv_transposed_; to save memory we limit the size of the
-  // matrix, storing only chunks of frames at a time, and we add it to the
-  // non-transposed output whenever we finish a chunk.
-  int32 t_wrapped = t % static_cast<int32>(kMaxDerivTimeSteps);
-  const BaseFloat *this_alpha_dash = alpha_.RowData(t),
-      *next_beta = beta_.RowData((t + 1) % 2);
-  BaseFloat *this_beta_dash = beta_.RowData(t % 2);
-  const Int32Pair *forward_transitions = den_graph_.ForwardTransitions();
-  const DenominatorGraphTransition *transitions = den_graph_.Transitions();
-  // 'probs' is the matrix of pseudo-likelihoods for frame t.
-  CuSubMatrix<BaseFloat> probs(exp_nnet_output_transposed_, 0, num_pdfs,
-                               t * num_sequences_, num_sequences_),
-      log_prob_deriv(nnet_output_deriv_transposed_, 0, num_pdfs,
-                     t_wrapped * num_sequences_, num_sequences_);
-
-  int32 num_hmm_states = den_graph_.NumStates(),
-      num_sequences = num_sequences_;
-
 #if HAVE_CUDA == 1
   if (CuDevice::Instantiate().Enabled()) {
+    int32 num_pdfs = exp_nnet_output_transposed_.NumRows();
+    // t_wrapped gives us the time-index we use when indexing
+    // nnet_output_deriv_transposed_; to save memory we limit the size of the
+    // matrix, storing only chunks of frames at a time, and we add it to the
+    // non-transposed output whenever we finish a chunk.
+    int32 t_wrapped = t % static_cast<int32>(kMaxDerivTimeSteps);
+    const BaseFloat *this_alpha_dash = alpha_.RowData(t),
+        *next_beta = beta_.RowData((t + 1) % 2);
+    BaseFloat *this_beta_dash = beta_.RowData(t % 2);
+    const Int32Pair *forward_transitions = den_graph_.ForwardTransitions();
+    const DenominatorGraphTransition *transitions = den_graph_.Transitions();
+    // 'probs' is the matrix of pseudo-likelihoods for frame t.
+    CuSubMatrix<BaseFloat> probs(exp_nnet_output_transposed_, 0, num_pdfs,
+                                 t * num_sequences_, num_sequences_),
+        log_prob_deriv(nnet_output_deriv_transposed_, 0, num_pdfs,
+                       t_wrapped * num_sequences_, num_sequences_);
+
+    int32 num_hmm_states = den_graph_.NumStates(),
+        num_sequences = num_sequences_;
+
     Timer tim;
     dim3 dimBlock(std::min<int32>(CU1DBLOCK, num_sequences), 1, 1);
     dim3 dimGrid(n_blocks(num_sequences, dimBlock.x), num_hmm_states, 1);
@@ -355,39 +465,31 @@ void DenominatorComputation::BetaDashGeneralFrame(int32 t) {
   } else
 #endif
   {
-    int32 prob_stride = probs.Stride(),
-         deriv_stride = log_prob_deriv.Stride();
-    const BaseFloat *prob_data = probs.Data();
-    BaseFloat *log_prob_deriv_data = log_prob_deriv.Data();
-    for (int32 h = 0; h < num_hmm_states; h++) {
-      for (int32 s = 0; s < num_sequences; s++) {
-        BaseFloat this_alpha_dash_prob = this_alpha_dash[h * num_sequences + s],
-            inv_arbitrary_scale =
-            this_alpha_dash[num_hmm_states * num_sequences + s];
-        double tot_variable_factor = 0.0;
-        BaseFloat occupation_factor = this_alpha_dash_prob /
-            inv_arbitrary_scale;
-        const DenominatorGraphTransition
-            *trans_iter = transitions + forward_transitions[h].first,
-            *trans_end = transitions + forward_transitions[h].second;
-        for (; trans_iter != trans_end; ++trans_iter) {
-          BaseFloat transition_prob = trans_iter->transition_prob;
-          int32 pdf_id = trans_iter->pdf_id,
-              next_hmm_state = trans_iter->hmm_state;
-          BaseFloat variable_factor = transition_prob *
-              next_beta[next_hmm_state * num_sequences + s] *
-              prob_data[pdf_id * prob_stride + s];
-          tot_variable_factor += variable_factor;
-          BaseFloat occupation_prob = variable_factor * occupation_factor;
-          log_prob_deriv_data[pdf_id * deriv_stride + s] += occupation_prob;
-        }
-        this_beta_dash[h * num_sequences + s] =
-            tot_variable_factor / inv_arbitrary_scale;
-      }
-    }
+    BetaDashGeneralFrameCpu(t, 0, num_sequences_);
   }
 }
 
+void DenominatorComputation::BetaDashGeneralFrameCpu(int32 t, int32 seq_begin,
+                                                     int32 seq_end) {
+  int32 num_pdfs = exp_nnet_output_transposed_.NumRows();
+  // t_wrapped gives us the time-index we use when indexing
+  // nnet_output_deriv_transposed_; see BetaDashGeneralFrame().
+  int32 t_wrapped = t % static_cast<int32>(kMaxDerivTimeSteps);
+  // 'probs' is the matrix of pseudo-likelihoods for frame t.
+  CuSubMatrix<BaseFloat> probs(exp_nnet_output_transposed_, 0, num_pdfs,
+                               t * num_sequences_, num_sequences_),
+      log_prob_deriv(nnet_output_deriv_transposed_, 0, num_pdfs,
+                     t_wrapped * num_sequences_, num_sequences_);
+  ChainHmmBackwardCpu(den_graph_.ForwardTransitions(),
+                      den_graph_.Transitions(),
+                      num_sequences_, seq_begin, seq_end,
+                      den_graph_.NumStates(),
+                      probs.Data(), probs.Stride(),
+                      alpha_.RowData(t), beta_.RowData((t + 1) % 2),
+                      beta_.RowData(t % 2),
+                      log_prob_deriv.Data(), log_prob_deriv.Stride());
+}
+
 void DenominatorComputation::BetaGeneralFrameDebug(int32 t) {
   BaseFloat num_hmm_states = den_graph_.NumStates(),
       alpha_beta_size = num_hmm_states * num_sequences_;
@@ -40,6 +40,8 @@
 namespace kaldi {
 namespace chain {
 
+class DenominatorCpuTask;
+
 
 /*
   This extended comment describes how we implement forward-backward without log
@@ -232,9 +234,14 @@ class DenominatorComputation {
   void AlphaFirstFrame();
   // the alpha computation for some 0 < t <= num_time_steps_.
   void AlphaGeneralFrame(int32 t);
+  // the CPU version of AlphaGeneralFrame(), for the sequences
+  // seq_begin <= s < seq_end.
+  void AlphaGeneralFrameCpu(int32 t, int32 seq_begin, int32 seq_end);
   // does the 'alpha-dash' computation for time t.  this relates to
   // 'leaky hmm'.
   void AlphaDash(int32 t);
+  // AlphaDash() for the sequences seq_begin <= s < seq_end.
+  void AlphaDash(int32 t, int32 seq_begin, int32 seq_end);
 
   // done after all the alphas, this function computes and returns the total
   // log-likelihood summed over all the sequences, and sets tot_prob_ (if we're
@@ -246,8 +253,36 @@ class DenominatorComputation {
   void BetaDashLastFrame();
   // beta computation for 0 <= beta < num_time_steps_.
   void BetaDashGeneralFrame(int32 t);
+  // the CPU version of BetaDashGeneralFrame(), for the sequences
+  // seq_begin <= s < seq_end.
+  void BetaDashGeneralFrameCpu(int32 t, int32 seq_begin, int32 seq_end);
+
   // compute the beta quantity from the beta-dash quantity (relates to leaky hmm).
   void Beta(int32 t);
+  // Beta() for the sequences seq_begin <= s < seq_end.
+  void Beta(int32 t, int32 seq_begin, int32 seq_end);
+
+  // adds deriv_weight times the derivatives stored in
+  // nnet_output_deriv_transposed_ for frames t ... t + kMaxDerivTimeSteps - 1
+  // and the sequences seq_begin <= s < seq_end to 'nnet_output_deriv', and
+  // zeroes them if t != 0.
+  void CommitDerivs(int32 t, BaseFloat deriv_weight,
+                    CuMatrixBase<BaseFloat> *nnet_output_deriv,
+                    int32 seq_begin, int32 seq_end);
+
+  // returns true if we are not using a GPU and opts_.num_threads > 1, in
+  // which case Forward() and Backward() split the sequences among threads.
+  bool UseCpuThreads() const;
+  // the part of Forward() after AlphaFirstFrame() that each thread does, for
+  // the sequences seq_begin <= s < seq_end.
+  void ForwardCpuRange(int32 seq_begin, int32 seq_end);
+  // the part of Backward() after BetaDashLastFrame() that each thread does,
+  // for the sequences seq_begin <= s < seq_end; it stops after the
+  // beta-dash of frame 0, which Backward() finishes for all sequences.
+  void BackwardCpuRange(BaseFloat deriv_weight,
+                        CuMatrixBase<BaseFloat> *nnet_output_deriv,
+                        int32 seq_begin, int32 seq_end);
+  friend class DenominatorCpuTask;
 
   // some checking that we can do if debug mode is activated, or on frame zero.
   // Sets ok_ to false if a bad problem is detected.
@@ -305,6 +340,8 @@ class DenominatorComputation {
   CuVector<BaseFloat> log_correction_term_;
 
   bool ok_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(DenominatorComputation);
 };
 
 
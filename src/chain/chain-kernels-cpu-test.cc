@@ -0,0 +1,188 @@
+// chain/chain-kernels-cpu-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "chain/chain-kernels-cpu.h"
+#include "matrix/kaldi-matrix.h"
+#include "base/timer.h"
+
+namespace kaldi {
+namespace chain {
+
+// A random graph in the format the kernels use: each of the "num_states"
+// states has "num_arcs" transitions to random states with random pdf-ids.  We
+// use the same transitions for the forward and the backward direction, which
+// is fine since the kernels don't care what they mean.
+struct RandomKernelGraph {
+  std::vector<Int32Pair> state_transitions;
+  std::vector<DenominatorGraphTransition> transitions;
+
+  RandomKernelGraph(int32 num_states, int32 num_arcs, int32 num_pdfs) {
+    for (int32 h = 0; h < num_states; h++) {
+      Int32Pair range;
+      range.first = transitions.size();
+      for (int32 i = 0; i < num_arcs; i++) {
+        DenominatorGraphTransition t;
+        t.transition_prob = RandUniform() / num_arcs;
+        t.pdf_id = RandInt(0, num_pdfs - 1);
+        t.hmm_state = RandInt(0, num_states - 1);
+        transitions.push_back(t);
+      }
+      range.second = transitions.size();
+      state_transitions.push_back(range);
+    }
+  }
+};
+
+// Sets up random positive alphas, betas and probs like the ones in
+// DenominatorComputation (with the alpha-sums in the last num_sequences
+// elements).
+static void RandomKernelInputs(int32 num_states, int32 num_sequences,
+                               int32 num_pdfs,
+                               Vector<BaseFloat> *alpha,
+                               Vector<BaseFloat> *beta,
+                               Matrix<BaseFloat> *probs) {
+  alpha->Resize((num_states + 1) * num_sequences);
+  beta->Resize((num_states + 1) * num_sequences);
+  probs->Resize(num_pdfs, num_sequences);
+  for (int32 i = 0; i < alpha->Dim(); i++) {
+    (*alpha)(i) = 0.1 + RandUniform();
+    (*beta)(i) = 0.1 + RandUniform();
+  }
+  for (int32 p = 0; p < num_pdfs; p++)
+    for (int32 s = 0; s < num_sequences; s++)
+      (*probs)(p, s) = 0.1 + 2.0 * RandUniform();
+}
+
+static void UnitTestChainHmmKernelsCpu() {
+  int32 num_states = RandInt(1, 50), num_arcs = RandInt(1, 8),
+      num_pdfs = RandInt(1, 30), num_sequences = RandInt(1, 20),
+      seq_begin = RandInt(0, num_sequences - 1),
+      seq_end = RandInt(seq_begin + 1, num_sequences);
+  RandomKernelGraph graph(num_states, num_arcs, num_pdfs);
+  Vector<BaseFloat> alpha, beta;
+  Matrix<BaseFloat> probs;
+  RandomKernelInputs(num_states, num_sequences, num_pdfs,
+                     &alpha, &beta, &probs);
+
+  // The elements outside [seq_begin, seq_end) must not be touched, so we start
+  // both outputs from the same random values.
+  Vector<BaseFloat> this_alpha(alpha.Dim()), this_alpha_ref(alpha.Dim());
+  this_alpha.SetRandn();
+  this_alpha_ref.CopyFromVec(this_alpha);
+  ChainHmmForwardCpu(&(graph.state_transitions[0]), &(graph.transitions[0]),
+                     num_sequences, seq_begin, seq_end, num_states,
+                     probs.Data(), probs.Stride(), alpha.Data(),
+                     this_alpha.Data());
+  ChainHmmForwardCpuReference(&(graph.state_transitions[0]),
+                              &(graph.transitions[0]),
+                              num_sequences, seq_begin, seq_end, num_states,
+                              probs.Data(), probs.Stride(), alpha.Data(),
+                              this_alpha_ref.Data());
+  AssertEqual(this_alpha, this_alpha_ref);
+
+  Vector<BaseFloat> this_beta(beta.Dim()), this_beta_ref(beta.Dim());
+  this_beta.SetRandn();
+  this_beta_ref.CopyFromVec(this_beta);
+  Matrix<BaseFloat> deriv(num_pdfs, num_sequences), deriv_ref;
+  deriv.SetRandn();
+  deriv_ref = deriv;
+  ChainHmmBackwardCpu(&(graph.state_transitions[0]), &(graph.transitions[0]),
+                      num_sequences, seq_begin, seq_end, num_states,
+                      probs.Data(), probs.Stride(), alpha.Data(), beta.Data(),
+                      this_beta.Data(), deriv.Data(), deriv.Stride());
+  ChainHmmBackwardCpuReference(&(graph.state_transitions[0]),
+                               &(graph.transitions[0]),
+                               num_sequences, seq_begin, seq_end, num_states,
+                               probs.Data(), probs.Stride(), alpha.Data(),
+                               beta.Data(), this_beta_ref.Data(),
+                               deriv_ref.Data(), deriv_ref.Stride());
+  AssertEqual(this_beta, this_beta_ref);
+  AssertEqual(deriv, deriv_ref);
+}
+
+// Compares the speed of the kernels with the reference versions, on a graph
+// with about the size of a typical denominator graph.
+static void ChainHmmKernelsCpuSpeedTest() {
+  int32 num_states = 10000, num_arcs = 10, num_pdfs = 3000,
+      num_sequences = 64, num_iters = 10;
+  RandomKernelGraph graph(num_states, num_arcs, num_pdfs);
+  Vector<BaseFloat> alpha, beta, this_alpha, this_beta;
+  Matrix<BaseFloat> probs;
+  RandomKernelInputs(num_states, num_sequences, num_pdfs,
+                     &alpha, &beta, &probs);
+  this_alpha.Resize(alpha.Dim());
+  this_beta.Resize(beta.Dim());
+  Matrix<BaseFloat> deriv(num_pdfs, num_sequences);
+  const Int32Pair *state_transitions = &(graph.state_transitions[0]);
+  const DenominatorGraphTransition *transitions = &(graph.transitions[0]);
+
+  double forward_time, forward_time_ref, backward_time, backward_time_ref;
+  Timer timer;
+  for (int32 i = 0; i < num_iters; i++)
+    ChainHmmForwardCpuReference(state_transitions, transitions,
+                                num_sequences, 0, num_sequences, num_states,
+                                probs.Data(), probs.Stride(), alpha.Data(),
+                                this_alpha.Data());
+  forward_time_ref = timer.Elapsed();
+  timer.Reset();
+  for (int32 i = 0; i < num_iters; i++)
+    ChainHmmForwardCpu(state_transitions, transitions,
+                       num_sequences, 0, num_sequences, num_states,
+                       probs.Data(), probs.Stride(), alpha.Data(),
+                       this_alpha.Data());
+  forward_time = timer.Elapsed();
+  timer.Reset();
+  for (int32 i = 0; i < num_iters; i++)
+    ChainHmmBackwardCpuReference(state_transitions, transitions,
+                                 num_sequences, 0, num_sequences, num_states,
+                                 probs.Data(), probs.Stride(), alpha.Data(),
+                                 beta.Data(), this_beta.Data(),
+                                 deriv.Data(), deriv.Stride());
+  backward_time_ref = timer.Elapsed();
+  timer.Reset();
+  for (int32 i = 0; i < num_iters; i++)
+    ChainHmmBackwardCpu(state_transitions, transitions,
+                        num_sequences, 0, num_sequences, num_states,
+                        probs.Data(), probs.Stride(), alpha.Data(),
+                        beta.Data(), this_beta.Data(),
+                        deriv.Data(), deriv.Stride());
+  backward_time = timer.Elapsed();
+
+  KALDI_LOG << "For " << num_states << " states, " << num_arcs
+            << " arcs per state and " << num_sequences << " sequences, "
+            << "time per frame of forward kernel is "
+            << (1000.0 * forward_time / num_iters) << " ms vs. "
+            << (1000.0 * forward_time_ref / num_iters)
+            << " ms for the reference (speedup "
+            << (forward_time_ref / forward_time) << "), backward kernel "
+            << (1000.0 * backward_time / num_iters) << " ms vs. "
+            << (1000.0 * backward_time_ref / num_iters)
+            << " ms (speedup " << (backward_time_ref / backward_time) << ")";
+}
+
+}  // namespace chain
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  using namespace kaldi::chain;
+  for (int32 i = 0; i < 50; i++)
+    UnitTestChainHmmKernelsCpu();
+  ChainHmmKernelsCpuSpeedTest();
+  KALDI_LOG << "Success.";
+  return 0;
+}
@@ -0,0 +1,255 @@
+// chain/chain-kernels-cpu.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#if defined(__SSE2__) && KALDI_DOUBLEPRECISION == 0
+#include <emmintrin.h>
+#define KALDI_CHAIN_KERNELS_CPU_SSE2 1
+#endif
+#include "chain/chain-kernels-cpu.h"
+
+namespace kaldi {
+namespace chain {
+
+void ChainHmmForwardCpu(const Int32Pair *backward_transitions,
+                        const DenominatorGraphTransition *transitions,
+                        int32 num_sequences,
+                        int32 seq_begin,
+                        int32 seq_end,
+                        int32 num_hmm_states,
+                        const BaseFloat *probs,
+                        int32 prob_stride,
+                        const BaseFloat *prev_alpha,
+                        BaseFloat *this_alpha) {
+  // Let arbitrary_scale be the inverse of the alpha-sum value that we store in
+  // the same place we'd store the alpha for the state numbered
+  // 'num_hmm_states'. We multiply this into all the transition-probabilities
+  // from the previous frame to this frame, in both the forward and backward
+  // passes, in order to keep the alphas in a good numeric range.  This won't
+  // affect the posteriors, but when computing the total likelihood we'll need
+  // to compensate for it later on.
+  const BaseFloat *prev_alpha_sum = prev_alpha + num_hmm_states * num_sequences;
+
+  // The sequences are the innermost loop, because the probabilities and alphas
+  // of consecutive sequences are consecutive in memory.  With SSE2 we do them
+  // 4 at a time; the arithmetic is the same as in the scalar code, so the
+  // results are identical.
+  for (int32 h = 0; h < num_hmm_states; h++) {
+    const DenominatorGraphTransition
+        *trans_begin = transitions + backward_transitions[h].first,
+        *trans_end = transitions + backward_transitions[h].second;
+    BaseFloat *this_alpha_h = this_alpha + h * num_sequences;
+    int32 s = seq_begin;
+#ifdef KALDI_CHAIN_KERNELS_CPU_SSE2
+    for (; s + 4 <= seq_end; s += 4) {
+      __m128d tot_alpha_low = _mm_setzero_pd(),
+          tot_alpha_high = _mm_setzero_pd();
+      for (const DenominatorGraphTransition *trans_iter = trans_begin;
+           trans_iter != trans_end; ++trans_iter) {
+        __m128 prev_alpha_vec = _mm_loadu_ps(
+            prev_alpha + trans_iter->hmm_state * num_sequences + s),
+            prob = _mm_loadu_ps(probs + trans_iter->pdf_id * prob_stride + s),
+            product = _mm_mul_ps(
+                _mm_mul_ps(prev_alpha_vec,
+                           _mm_set1_ps(trans_iter->transition_prob)), prob);
+        tot_alpha_low = _mm_add_pd(tot_alpha_low, _mm_cvtps_pd(product));
+        tot_alpha_high = _mm_add_pd(
+            tot_alpha_high, _mm_cvtps_pd(_mm_movehl_ps(product, product)));
+      }
+      double tot_alpha[4];
+      _mm_storeu_pd(tot_alpha, tot_alpha_low);
+      _mm_storeu_pd(tot_alpha + 2, tot_alpha_high);
+      for (int32 i = 0; i < 4; i++) {
+        BaseFloat arbitrary_scale = 1.0 / prev_alpha_sum[s + i];
+        KALDI_ASSERT(tot_alpha[i] - tot_alpha[i] == 0);
+        this_alpha_h[s + i] = tot_alpha[i] * arbitrary_scale;
+      }
+    }
+#endif
+    for (; s < seq_end; s++) {
+      double this_tot_alpha = 0.0;
+      for (const DenominatorGraphTransition *trans_iter = trans_begin;
+           trans_iter != trans_end; ++trans_iter) {
+        BaseFloat transition_prob = trans_iter->transition_prob;
+        int32 pdf_id = trans_iter->pdf_id,
+            prev_hmm_state = trans_iter->hmm_state;
+        BaseFloat prob = probs[pdf_id * prob_stride + s],
+            this_prev_alpha = prev_alpha[prev_hmm_state * num_sequences + s];
+        this_tot_alpha += this_prev_alpha * transition_prob * prob;
+      }
+      BaseFloat arbitrary_scale = 1.0 / prev_alpha_sum[s];
+      KALDI_ASSERT(this_tot_alpha - this_tot_alpha == 0);
+      this_alpha_h[s] = this_tot_alpha * arbitrary_scale;
+    }
+  }
+}
+
+void ChainHmmForwardCpuReference(const Int32Pair *backward_transitions,
+                                 const DenominatorGraphTransition *transitions,
+                                 int32 num_sequences,
+                                 int32 seq_begin,
+                                 int32 seq_end,
+                                 int32 num_hmm_states,
+                                 const BaseFloat *probs,
+                                 int32 prob_stride,
+                                 const BaseFloat *prev_alpha,
+                                 BaseFloat *this_alpha) {
+  for (int32 h = 0; h < num_hmm_states; h++) {
+    for (int32 s = seq_begin; s < seq_end; s++) {
+      double this_tot_alpha = 0.0;
+      const DenominatorGraphTransition
+          *trans_iter = transitions + backward_transitions[h].first,
+          *trans_end = transitions + backward_transitions[h].second;
+      for (; trans_iter != trans_end; ++trans_iter) {
+        BaseFloat transition_prob = trans_iter->transition_prob;
+        int32 pdf_id = trans_iter->pdf_id,
+            prev_hmm_state = trans_iter->hmm_state;
+        BaseFloat prob = probs[pdf_id * prob_stride + s],
+            this_prev_alpha = prev_alpha[prev_hmm_state * num_sequences + s];
+        this_tot_alpha += this_prev_alpha * transition_prob * prob;
+      }
+      BaseFloat arbitrary_scale =
+          1.0 / prev_alpha[num_hmm_states * num_sequences + s];
+      KALDI_ASSERT(this_tot_alpha - this_tot_alpha == 0);
+      this_alpha[h * num_sequences + s] = this_tot_alpha * arbitrary_scale;
+    }
+  }
+}
+
+void ChainHmmBackwardCpu(const Int32Pair *forward_transitions,
+                         const DenominatorGraphTransition *transitions,
+                         int32 num_sequences,
+                         int32 seq_begin,
+                         int32 seq_end,
+                         int32 num_hmm_states,
+                         const BaseFloat *probs,
+                         int32 prob_stride,
+                         const BaseFloat *this_alpha,
+                         const BaseFloat *next_beta,
+                         BaseFloat *this_beta,
+                         BaseFloat *log_prob_deriv,
+                         int32 log_prob_deriv_stride) {
+  const BaseFloat *inv_arbitrary_scales =
+      this_alpha + num_hmm_states * num_sequences;
+
+  // As in ChainHmmForwardCpu(), the sequences are the innermost loop.  Only
+  // the columns of log_prob_deriv for sequences seq_begin ... seq_end - 1 are
+  // written to, so calls for different ranges can run at the same time.
+  for (int32 h = 0; h < num_hmm_states; h++) {
+    const DenominatorGraphTransition
+        *trans_begin = transitions + forward_transitions[h].first,
+        *trans_end = transitions + forward_transitions[h].second;
+    const BaseFloat *this_alpha_h = this_alpha + h * num_sequences;
+    BaseFloat *this_beta_h = this_beta + h * num_sequences;
+    int32 s = seq_begin;
+#ifdef KALDI_CHAIN_KERNELS_CPU_SSE2
+    for (; s + 4 <= seq_end; s += 4) {
+      __m128 inv_arbitrary_scale = _mm_loadu_ps(inv_arbitrary_scales + s),
+          occupation_factor = _mm_div_ps(_mm_loadu_ps(this_alpha_h + s),
+                                         inv_arbitrary_scale);
+      __m128d tot_variable_factor_low = _mm_setzero_pd(),
+          tot_variable_factor_high = _mm_setzero_pd();
+      for (const DenominatorGraphTransition *trans_iter = trans_begin;
+           trans_iter != trans_end; ++trans_iter) {
+        __m128 next_beta_vec = _mm_loadu_ps(
+            next_beta + trans_iter->hmm_state * num_sequences + s),
+            prob = _mm_loadu_ps(probs + trans_iter->pdf_id * prob_stride + s),
+            variable_factor = _mm_mul_ps(
+                _mm_mul_ps(_mm_set1_ps(trans_iter->transition_prob),
+                           next_beta_vec), prob);
+        tot_variable_factor_low = _mm_add_pd(tot_variable_factor_low,
+                                             _mm_cvtps_pd(variable_factor));
+        tot_variable_factor_high = _mm_add_pd(
+            tot_variable_factor_high,
+            _mm_cvtps_pd(_mm_movehl_ps(variable_factor, variable_factor)));
+        BaseFloat *deriv = log_prob_deriv +
+            trans_iter->pdf_id * log_prob_deriv_stride + s;
+        _mm_storeu_ps(deriv, _mm_add_ps(_mm_loadu_ps(deriv),
+                                        _mm_mul_ps(variable_factor,
+                                                   occupation_factor)));
+      }
+      double tot_variable_factor[4];
+      _mm_storeu_pd(tot_variable_factor, tot_variable_factor_low);
+      _mm_storeu_pd(tot_variable_factor + 2, tot_variable_factor_high);
+      for (int32 i = 0; i < 4; i++)
+        this_beta_h[s + i] =
+            tot_variable_factor[i] / inv_arbitrary_scales[s + i];
+    }
+#endif
+    for (; s < seq_end; s++) {
+      BaseFloat this_alpha_prob = this_alpha_h[s],
+          inv_arbitrary_scale = inv_arbitrary_scales[s];
+      double tot_variable_factor = 0.0;
+      BaseFloat occupation_factor = this_alpha_prob / inv_arbitrary_scale;
+      for (const DenominatorGraphTransition *trans_iter = trans_begin;
+           trans_iter != trans_end; ++trans_iter) {
+        BaseFloat transition_prob = trans_iter->transition_prob;
+        int32 pdf_id = trans_iter->pdf_id,
+            next_hmm_state = trans_iter->hmm_state;
+        BaseFloat variable_factor = transition_prob *
+            next_beta[next_hmm_state * num_sequences + s] *
+            probs[pdf_id * prob_stride + s];
+        tot_variable_factor += variable_factor;
+        BaseFloat occupation_prob = variable_factor * occupation_factor;
+        log_prob_deriv[pdf_id * log_prob_deriv_stride + s] += occupation_prob;
+      }
+      this_beta_h[s] = tot_variable_factor / inv_arbitrary_scale;
+    }
+  }
+}
+
+void ChainHmmBackwardCpuReference(const Int32Pair *forward_transitions,
+                                  const DenominatorGraphTransition *transitions,
+                                  int32 num_sequences,
+                                  int32 seq_begin,
+                                  int32 seq_end,
+                                  int32 num_hmm_states,
+                                  const BaseFloat *probs,
+                                  int32 prob_stride,
+                                  const BaseFloat *this_alpha,
+                                  const BaseFloat *next_beta,
+                                  BaseFloat *this_beta,
+                                  BaseFloat *log_prob_deriv,
+                                  int32 log_prob_deriv_stride) {
+  for (int32 h = 0; h < num_hmm_states; h++) {
+    for (int32 s = seq_begin; s < seq_end; s++) {
+      BaseFloat this_alpha_prob = this_alpha[h * num_sequences + s],
+          inv_arbitrary_scale =
+          this_alpha[num_hmm_states * num_sequences + s];
+      double tot_variable_factor = 0.0;
+      BaseFloat occupation_factor = this_alpha_prob / inv_arbitrary_scale;
+      const DenominatorGraphTransition
+          *trans_iter = transitions + forward_transitions[h].first,
+          *trans_end = transitions + forward_transitions[h].second;
+      for (; trans_iter != trans_end; ++trans_iter) {
+        BaseFloat transition_prob = trans_iter->transition_prob;
+        int32 pdf_id = trans_iter->pdf_id,
+            next_hmm_state = trans_iter->hmm_state;
+        BaseFloat variable_factor = transition_prob *
+            next_beta[next_hmm_state * num_sequences + s] *
+            probs[pdf_id * prob_stride + s];
+        tot_variable_factor += variable_factor;
+        BaseFloat occupation_prob = variable_factor * occupation_factor;
+        log_prob_deriv[pdf_id * log_prob_deriv_stride + s] += occupation_prob;
+      }
+      this_beta[h * num_sequences + s] =
+          tot_variable_factor / inv_arbitrary_scale;
+    }
+  }
+}
+
+}  // namespace chain
+}  // namespace kaldi
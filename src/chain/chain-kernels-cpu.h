@@ -0,0 +1,93 @@
+// chain/chain-kernels-cpu.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_CHAIN_CHAIN_KERNELS_CPU_H_
+#define KALDI_CHAIN_CHAIN_KERNELS_CPU_H_
+
+#include "base/kaldi-common.h"
+#include "chain/chain-datastruct.h"
+
+namespace kaldi {
+namespace chain {
+
+/**
+   These are the CPU versions of the kernels in chain-kernels-ansi.h, which do
+   the forward and backward computation of the denominator HMM for one frame
+   (see class DenominatorComputation).  They take the same arguments as the CUDA
+   kernels, except that instead of a grid they take a range of sequences
+   seq_begin <= s < seq_end to compute, so that the sequences can be split among
+   threads.  "num_sequences" is the stride of the alphas and betas.
+
+   ChainHmmForwardCpu() and ChainHmmBackwardCpu() handle four sequences at a
+   time with SSE2 instructions if they are available.  The *Reference()
+   versions are the plain loops over HMM states and sequences, which we keep
+   for testing; the results of the two should be the same.
+*/
+void ChainHmmForwardCpu(const Int32Pair *backward_transitions,
+                        const DenominatorGraphTransition *transitions,
+                        int32 num_sequences,
+                        int32 seq_begin,
+                        int32 seq_end,
+                        int32 num_hmm_states,
+                        const BaseFloat *probs,
+                        int32 prob_stride,
+                        const BaseFloat *prev_alpha,
+                        BaseFloat *this_alpha);
+
+void ChainHmmForwardCpuReference(const Int32Pair *backward_transitions,
+                                 const DenominatorGraphTransition *transitions,
+                                 int32 num_sequences,
+                                 int32 seq_begin,
+                                 int32 seq_end,
+                                 int32 num_hmm_states,
+                                 const BaseFloat *probs,
+                                 int32 prob_stride,
+                                 const BaseFloat *prev_alpha,
+                                 BaseFloat *this_alpha);
+
+void ChainHmmBackwardCpu(const Int32Pair *forward_transitions,
+                         const DenominatorGraphTransition *transitions,
+                         int32 num_sequences,
+                         int32 seq_begin,
+                         int32 seq_end,
+                         int32 num_hmm_states,
+                         const BaseFloat *probs,
+                         int32 prob_stride,
+                         const BaseFloat *this_alpha,
+                         const BaseFloat *next_beta,
+                         BaseFloat *this_beta,
+                         BaseFloat *log_prob_deriv,
+                         int32 log_prob_deriv_stride);
+
+void ChainHmmBackwardCpuReference(const Int32Pair *forward_transitions,
+                                  const DenominatorGraphTransition *transitions,
+                                  int32 num_sequences,
+                                  int32 seq_begin,
+                                  int32 seq_end,
+                                  int32 num_hmm_states,
+                                  const BaseFloat *probs,
+                                  int32 prob_stride,
+                                  const BaseFloat *this_alpha,
+                                  const BaseFloat *next_beta,
+                                  BaseFloat *this_beta,
+                                  BaseFloat *log_prob_deriv,
+                                  int32 log_prob_deriv_stride);
+
+}  // namespace chain
+}  // namespace kaldi
+
+#endif  // KALDI_CHAIN_CHAIN_KERNELS_CPU_H_
@@ -61,8 +61,12 @@ struct ChainTrainingOptions {
   // should have a softmax as its final nonlinearity.
   BaseFloat xent_regularize;
 
+  // Number of threads used in the denominator computation when we are not
+  // using a GPU.
+  int32 num_threads;
+
   ChainTrainingOptions(): l2_regularize(0.0), leaky_hmm_coefficient(1.0e-05),
-                          xent_regularize(0.0) { }
+                          xent_regularize(0.0), num_threads(1) { }
   
   void Register(OptionsItf *opts) {
     opts->Register("l2-regularize", &l2_regularize, "l2 regularization "
@@ -78,6 +82,9 @@ struct ChainTrainingOptions {
                    "nonzero, the network is expected to have an output "
                    "named 'output-xent', which should have a softmax as "
                    "its final nonlinearity.");
+    opts->Register("num-threads", &num_threads, "Number of threads used in "
+                   "the denominator forward-backward computation, if not "
+                   "using a GPU.");
   }
 };
 
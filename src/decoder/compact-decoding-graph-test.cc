@@ -0,0 +1,170 @@
+// decoder/compact-decoding-graph-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "decoder/compact-decoding-graph.h"
+#include "decoder/lattice-faster-decoder.h"
+#include "decoder/decodable-matrix.h"
+#include "base/timer.h"
+#include "util/kaldi-io.h"
+
+namespace kaldi {
+
+// Creates a random graph that looks a bit like a decoding graph: every state
+// has a self-loop and a few other emitting arcs, and some states have
+// epsilon arcs, which only go to higher-numbered states so there are no
+// epsilon cycles.  Labels on emitting arcs are in the range [1, num_pdfs).
+static fst::VectorFst<fst::StdArc> *RandomDecodingGraph(int32 num_states,
+                                                        int32 num_pdfs) {
+  typedef fst::StdArc Arc;
+  fst::VectorFst<Arc> *fst = new fst::VectorFst<Arc>();
+  for (int32 s = 0; s < num_states; s++)
+    fst->AddState();
+  fst->SetStart(0);
+  for (int32 s = 0; s < num_states; s++) {
+    fst->AddArc(s, Arc(1 + Rand() % (num_pdfs - 1), 0,
+                       RandUniform(), s));
+    int32 num_arcs = 1 + Rand() % 4;
+    for (int32 i = 0; i < num_arcs; i++) {
+      int32 olabel = (Rand() % 5 == 0 ? 1 + Rand() % 1000 : 0);
+      fst->AddArc(s, Arc(1 + Rand() % (num_pdfs - 1), olabel,
+                         5.0 * RandUniform(), Rand() % num_states));
+    }
+    if (s + 1 < num_states && Rand() % 3 == 0) {
+      int32 nextstate = s + 1 + Rand() % std::min(10, num_states - s - 1);
+      fst->AddArc(s, Arc(0, 1 + Rand() % 1000, 5.0 * RandUniform(),
+                         nextstate));
+    }
+    if (Rand() % 10 == 0)
+      fst->SetFinal(s, RandUniform());
+  }
+  return fst;
+}
+
+static void TestCompactDecodingGraphConversion() {
+  typedef fst::StdArc Arc;
+  fst::VectorFst<Arc> *fst = RandomDecodingGraph(1 + Rand() % 200, 50);
+  CompactDecodingGraph graph;
+  graph.Init(*fst);
+  KALDI_ASSERT(graph.Start() == fst->Start() &&
+               graph.NumStates() == fst->NumStates());
+  for (int32 s = 0; s < fst->NumStates(); s++) {
+    KALDI_ASSERT(graph.Final(s) == fst->Final(s));
+    EmittingArcIterator<CompactDecodingGraph> eiter(graph, s);
+    NonemittingArcIterator<CompactDecodingGraph> niter(graph, s);
+    for (fst::ArcIterator<fst::VectorFst<Arc> > aiter(*fst, s); !aiter.Done();
+         aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      if (arc.ilabel != 0) {
+        KALDI_ASSERT(!eiter.Done() && eiter.ILabel() == arc.ilabel &&
+                     eiter.OLabel() == arc.olabel &&
+                     eiter.NextState() == arc.nextstate &&
+                     eiter.GraphCost() == arc.weight.Value());
+        eiter.Next();
+      } else {
+        KALDI_ASSERT(!niter.Done() && niter.ILabel() == 0 &&
+                     niter.OLabel() == arc.olabel &&
+                     niter.NextState() == arc.nextstate &&
+                     niter.GraphCost() == arc.weight.Value());
+        niter.Next();
+      }
+    }
+    KALDI_ASSERT(eiter.Done() && niter.Done());
+  }
+
+  // Test I/O.
+  std::string filename = "tmpf.compact";
+  WriteKaldiObject(graph, filename, true);
+  KALDI_ASSERT(IsCompactDecodingGraph(filename));
+  CompactDecodingGraph graph2;
+  ReadKaldiObject(filename, &graph2);
+  KALDI_ASSERT(graph2.NumStates() == graph.NumStates() &&
+               graph2.NumEmittingArcs() == graph.NumEmittingArcs() &&
+               graph2.NumNonemittingArcs() == graph.NumNonemittingArcs() &&
+               graph2.MemoryInBytes() == graph.MemoryInBytes());
+  unlink(filename.c_str());
+  delete fst;
+}
+
+// Decodes random likelihoods with the generic decoder, with the one
+// specialized for ConstFst and with the one specialized for
+// CompactDecodingGraph, checks that they give the same output, and prints the
+// time taken by each.
+static void TestCompactDecodingGraphDecoding(int32 num_states,
+                                             int32 num_frames,
+                                             BaseFloat beam) {
+  int32 num_pdfs = 500;
+  fst::VectorFst<fst::StdArc> *fst = RandomDecodingGraph(num_states, num_pdfs);
+  fst::ConstFst<fst::StdArc> const_fst(*fst);
+  delete fst;
+  CompactDecodingGraph graph;
+  graph.Init(const_fst);
+
+  Matrix<BaseFloat> loglikes(num_frames, num_pdfs);
+  loglikes.SetRandn();
+  DecodableMatrixScaled decodable(loglikes, 1.0);
+
+  LatticeFasterDecoderConfig config;
+  config.beam = beam;
+  config.max_active = 5000;
+  LatticeFasterDecoder decoder(const_fst, config);
+  LatticeFasterDecoderTpl<fst::ConstFst<fst::StdArc> > const_decoder(
+      const_fst, config);
+  LatticeFasterDecoderTpl<CompactDecodingGraph> compact_decoder(graph, config);
+
+  Timer timer;
+  decoder.Decode(&decodable);
+  double fst_time = timer.Elapsed();
+  timer.Reset();
+  const_decoder.Decode(&decodable);
+  double const_time = timer.Elapsed();
+  timer.Reset();
+  compact_decoder.Decode(&decodable);
+  double compact_time = timer.Elapsed();
+
+  Lattice lat, const_lat, compact_lat;
+  decoder.GetRawLattice(&lat);
+  const_decoder.GetRawLattice(&const_lat);
+  compact_decoder.GetRawLattice(&compact_lat);
+  KALDI_ASSERT(lat.NumStates() == const_lat.NumStates() &&
+               lat.NumStates() == compact_lat.NumStates());
+  Lattice best_path, const_best_path, compact_best_path;
+  decoder.GetBestPath(&best_path);
+  const_decoder.GetBestPath(&const_best_path);
+  compact_decoder.GetBestPath(&compact_best_path);
+  KALDI_ASSERT(fst::Equal(best_path, const_best_path) &&
+               fst::Equal(best_path, compact_best_path));
+
+  KALDI_LOG << "Decoding " << num_frames << " frames with a graph of "
+            << num_states << " states took " << fst_time << " seconds with "
+            << "Fst<StdArc>, " << const_time << " with ConstFst<StdArc>, and "
+            << compact_time << " with CompactDecodingGraph ("
+            << graph.MemoryInBytes() << " bytes).";
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 10; i++)
+    TestCompactDecodingGraphConversion();
+  for (int32 i = 0; i < 5; i++)
+    TestCompactDecodingGraphDecoding(1 + Rand() % 1000, 1 + Rand() % 50, 10.0);
+  // A larger graph, to compare the speed.
+  TestCompactDecodingGraphDecoding(1000000, 200, 12.0);
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
@@ -0,0 +1,159 @@
+// decoder/compact-decoding-graph.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <fstream>
+#include <limits>
+#include "decoder/compact-decoding-graph.h"
+#include "util/kaldi-io.h"
+
+namespace kaldi {
+
+void CompactDecodingGraph::Init(const fst::Fst<Arc> &fst) {
+  StateId num_states = fst::CountStates(fst);
+  start_ = fst.Start();
+  states_.clear();
+  emitting_arcs_.clear();
+  emitting_olabels_.clear();
+  nonemitting_arcs_.clear();
+
+  // First count the arcs, so we can allocate exactly the memory we need.
+  size_t num_emitting = 0, num_nonemitting = 0;
+  for (StateId s = 0; s < num_states; s++) {
+    size_t num_eps = fst.NumInputEpsilons(s);
+    num_nonemitting += num_eps;
+    num_emitting += fst.NumArcs(s) - num_eps;
+  }
+  if (num_emitting > std::numeric_limits<uint32>::max() ||
+      num_nonemitting > std::numeric_limits<uint32>::max())
+    KALDI_ERR << "Graph has too many arcs for CompactDecodingGraph: "
+              << num_emitting << " emitting, " << num_nonemitting
+              << " nonemitting.";
+  states_.resize(num_states + 1);
+  emitting_arcs_.reserve(num_emitting);
+  emitting_olabels_.reserve(num_emitting);
+  nonemitting_arcs_.reserve(num_nonemitting);
+
+  for (StateId s = 0; s < num_states; s++) {
+    StateInfo &info = states_[s];
+    info.emitting_begin = emitting_arcs_.size();
+    info.nonemitting_begin = nonemitting_arcs_.size();
+    info.final_cost = fst.Final(s).Value();
+    for (fst::ArcIterator<fst::Fst<Arc> > aiter(fst, s); !aiter.Done();
+         aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      if (arc.ilabel != 0) {
+        EmittingArc emitting_arc;
+        emitting_arc.nextstate = arc.nextstate;
+        emitting_arc.graph_cost = arc.weight.Value();
+        emitting_arc.ilabel = arc.ilabel;
+        emitting_arcs_.push_back(emitting_arc);
+        emitting_olabels_.push_back(arc.olabel);
+      } else {
+        NonemittingArc nonemitting_arc;
+        nonemitting_arc.nextstate = arc.nextstate;
+        nonemitting_arc.graph_cost = arc.weight.Value();
+        nonemitting_arc.olabel = arc.olabel;
+        nonemitting_arcs_.push_back(nonemitting_arc);
+      }
+    }
+  }
+  // NumInputEpsilons() may not be exact for all FST types, so check.
+  KALDI_ASSERT(emitting_arcs_.size() == num_emitting &&
+               nonemitting_arcs_.size() == num_nonemitting);
+  StateInfo &end_info = states_[num_states];
+  end_info.emitting_begin = emitting_arcs_.size();
+  end_info.nonemitting_begin = nonemitting_arcs_.size();
+  end_info.final_cost = std::numeric_limits<BaseFloat>::infinity();
+}
+
+size_t CompactDecodingGraph::MemoryInBytes() const {
+  return sizeof(StateInfo) * states_.size() +
+      sizeof(EmittingArc) * emitting_arcs_.size() +
+      sizeof(Label) * emitting_olabels_.size() +
+      sizeof(NonemittingArc) * nonemitting_arcs_.size();
+}
+
+// Writes the contents of a vector of POD type as a block of bytes.
+template <class T>
+static void WriteVectorData(std::ostream &os, const std::vector<T> &vec) {
+  if (!vec.empty())
+    os.write(reinterpret_cast<const char*>(&(vec[0])), sizeof(T) * vec.size());
+}
+
+template <class T>
+static void ReadVectorData(std::istream &is, size_t size,
+                           std::vector<T> *vec) {
+  vec->resize(size);
+  if (size != 0)
+    is.read(reinterpret_cast<char*>(&((*vec)[0])), sizeof(T) * size);
+}
+
+void CompactDecodingGraph::Write(std::ostream &os, bool binary) const {
+  if (!binary)
+    KALDI_ERR << "CompactDecodingGraph can only be written in binary mode.";
+  WriteToken(os, binary, "<CompactDecodingGraph>");
+  WriteBasicType(os, binary, start_);
+  WriteBasicType(os, binary, static_cast<int64>(states_.size()));
+  WriteBasicType(os, binary, static_cast<int64>(emitting_arcs_.size()));
+  WriteBasicType(os, binary, static_cast<int64>(nonemitting_arcs_.size()));
+  WriteVectorData(os, states_);
+  WriteVectorData(os, emitting_arcs_);
+  WriteVectorData(os, emitting_olabels_);
+  WriteVectorData(os, nonemitting_arcs_);
+  WriteToken(os, binary, "</CompactDecodingGraph>");
+  if (!os.good())
+    KALDI_ERR << "Error writing CompactDecodingGraph to stream.";
+}
+
+void CompactDecodingGraph::Read(std::istream &is, bool binary) {
+  if (!binary)
+    KALDI_ERR << "CompactDecodingGraph can only be read in binary mode.";
+  ExpectToken(is, binary, "<CompactDecodingGraph>");
+  int64 num_state_infos, num_emitting, num_nonemitting;
+  ReadBasicType(is, binary, &start_);
+  ReadBasicType(is, binary, &num_state_infos);
+  ReadBasicType(is, binary, &num_emitting);
+  ReadBasicType(is, binary, &num_nonemitting);
+  if (num_state_infos < 1 || num_emitting < 0 || num_nonemitting < 0)
+    KALDI_ERR << "Bad sizes reading CompactDecodingGraph.";
+  ReadVectorData(is, num_state_infos, &states_);
+  ReadVectorData(is, num_emitting, &emitting_arcs_);
+  ReadVectorData(is, num_emitting, &emitting_olabels_);
+  ReadVectorData(is, num_nonemitting, &nonemitting_arcs_);
+  ExpectToken(is, binary, "</CompactDecodingGraph>");
+  if (states_.back().emitting_begin != emitting_arcs_.size() ||
+      states_.back().nonemitting_begin != nonemitting_arcs_.size())
+    KALDI_ERR << "Inconsistent CompactDecodingGraph (corrupted file?)";
+}
+
+bool IsCompactDecodingGraph(const std::string &rxfilename) {
+  if (ClassifyRxfilename(rxfilename) != kFileInput)
+    return false;
+  std::ifstream is(rxfilename.c_str(), std::ios::in | std::ios::binary);
+  if (!is.good())
+    return false;
+  // A CompactDecodingGraph is in Kaldi's binary format, so it starts with
+  // "\0B"; OpenFst's files start with a magic number that is different.
+  bool binary;
+  if (!InitKaldiInputStream(is, &binary) || !binary)
+    return false;
+  std::string token;
+  is >> token;
+  return (token == "<CompactDecodingGraph>");
+}
+
+} // end namespace kaldi.
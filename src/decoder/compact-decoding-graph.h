@@ -0,0 +1,234 @@
+// decoder/compact-decoding-graph.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_DECODER_COMPACT_DECODING_GRAPH_H_
+#define KALDI_DECODER_COMPACT_DECODING_GRAPH_H_
+
+#include <string>
+#include <vector>
+#include "base/kaldi-common.h"
+#include "fst/fstlib.h"
+
+namespace kaldi {
+
+/*
+   The decoders that are templated on the type of the decoding graph (e.g.
+   LatticeFasterDecoderTpl) visit the arcs leaving a state through the two
+   iterator templates below: EmittingArcIterator visits the arcs with nonzero
+   ilabel, which are processed in ProcessEmitting(), and NonemittingArcIterator
+   the arcs with zero ilabel, processed in ProcessNonemitting().  The generic
+   versions work for any OpenFst FST type (they wrap fst::ArcIterator<FST> and
+   skip the arcs of the other kind); there are specializations for
+   CompactDecodingGraph, which stores the two kinds of arc separately.
+
+   The interface is: Done(), Next(), ILabel(), OLabel(), GraphCost() and
+   NextState().  The weights are assumed to be tropical, and GraphCost()
+   returns the weight as a cost.
+*/
+template <class FST>
+class EmittingArcIterator {
+ public:
+  typedef typename FST::Arc Arc;
+  typedef typename Arc::StateId StateId;
+  typedef typename Arc::Label Label;
+
+  EmittingArcIterator(const FST &fst, StateId s): aiter_(fst, s) { Skip(); }
+
+  bool Done() const { return aiter_.Done(); }
+  void Next() { aiter_.Next(); Skip(); }
+  Label ILabel() const { return aiter_.Value().ilabel; }
+  Label OLabel() const { return aiter_.Value().olabel; }
+  BaseFloat GraphCost() const { return aiter_.Value().weight.Value(); }
+  StateId NextState() const { return aiter_.Value().nextstate; }
+
+ private:
+  void Skip() {
+    while (!aiter_.Done() && aiter_.Value().ilabel == 0) aiter_.Next();
+  }
+  fst::ArcIterator<FST> aiter_;
+};
+
+template <class FST>
+class NonemittingArcIterator {
+ public:
+  typedef typename FST::Arc Arc;
+  typedef typename Arc::StateId StateId;
+  typedef typename Arc::Label Label;
+
+  NonemittingArcIterator(const FST &fst, StateId s): aiter_(fst, s) { Skip(); }
+
+  bool Done() const { return aiter_.Done(); }
+  void Next() { aiter_.Next(); Skip(); }
+  Label ILabel() const { return 0; }
+  Label OLabel() const { return aiter_.Value().olabel; }
+  BaseFloat GraphCost() const { return aiter_.Value().weight.Value(); }
+  StateId NextState() const { return aiter_.Value().nextstate; }
+
+ private:
+  void Skip() {
+    while (!aiter_.Done() && aiter_.Value().ilabel != 0) aiter_.Next();
+  }
+  fst::ArcIterator<FST> aiter_;
+};
+
+
+/**
+   CompactDecodingGraph is a read-only decoding graph (HCLG) in a format that
+   is laid out for the way the decoders access it.  A decoder looks at the
+   emitting and the nonemitting arcs of a state at different times (in
+   ProcessEmitting() and ProcessNonemitting()), so here they are stored in two
+   separate arrays, and the decoder never reads arcs of the kind it is not
+   interested in.  The arcs are 12 bytes rather than the 16 of fst::StdArc:
+   emitting arcs store (nextstate, cost, ilabel), and their olabels, which are
+   only needed for the arcs that survive pruning, are in a separate array;
+   nonemitting arcs store (nextstate, cost, olabel), as their ilabel is zero.
+   The per-state information (where each state's arcs start, and the final
+   cost) is one array of 12-byte entries.
+
+   The graph is created from an FST (see Init(), and the program
+   make-compact-graph) and is stored on disk in Kaldi's binary format.  Use it
+   with the decoders that are templated on the graph type, e.g.
+   LatticeFasterDecoderTpl<CompactDecodingGraph>.
+ */
+class CompactDecodingGraph {
+ public:
+  typedef fst::StdArc Arc;
+  typedef Arc::StateId StateId;
+  typedef Arc::Label Label;
+  typedef Arc::Weight Weight;
+
+  CompactDecodingGraph(): start_(fst::kNoStateId) { }
+
+  /// Initializes from an FST; the weights are assumed to be costs (as in the
+  /// tropical semiring).  The FST's states must be numbered 0, 1, ... .
+  void Init(const fst::Fst<Arc> &fst);
+
+  StateId Start() const { return start_; }
+
+  /// Returns the final-cost of state s (infinity if it is not final), as a
+  /// tropical weight, like fst::Fst::Final().
+  Weight Final(StateId s) const { return Weight(states_[s].final_cost); }
+
+  StateId NumStates() const {
+    return (states_.empty() ? 0 : static_cast<StateId>(states_.size() - 1));
+  }
+
+  size_t NumEmittingArcs() const { return emitting_arcs_.size(); }
+  size_t NumNonemittingArcs() const { return nonemitting_arcs_.size(); }
+
+  /// Returns the memory used by the graph, in bytes.
+  size_t MemoryInBytes() const;
+
+  /// Only the binary format is supported.
+  void Write(std::ostream &os, bool binary) const;
+  void Read(std::istream &is, bool binary);
+
+ private:
+  friend class EmittingArcIterator<CompactDecodingGraph>;
+  friend class NonemittingArcIterator<CompactDecodingGraph>;
+
+  struct EmittingArc {
+    StateId nextstate;
+    BaseFloat graph_cost;
+    Label ilabel;
+  };
+  struct NonemittingArc {
+    StateId nextstate;
+    BaseFloat graph_cost;
+    Label olabel;
+  };
+  // The arcs of state s are emitting_arcs_[states_[s].emitting_begin ...
+  // states_[s+1].emitting_begin - 1], and similarly for the nonemitting arcs;
+  // states_ has an extra entry at the end for this purpose.
+  struct StateInfo {
+    uint32 emitting_begin;
+    uint32 nonemitting_begin;
+    BaseFloat final_cost;
+  };
+
+  StateId start_;
+  std::vector<StateInfo> states_;
+  std::vector<EmittingArc> emitting_arcs_;
+  std::vector<Label> emitting_olabels_;  // parallel to emitting_arcs_.
+  std::vector<NonemittingArc> nonemitting_arcs_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(CompactDecodingGraph);
+};
+
+
+template <>
+class EmittingArcIterator<CompactDecodingGraph> {
+ public:
+  typedef CompactDecodingGraph::StateId StateId;
+  typedef CompactDecodingGraph::Label Label;
+
+  EmittingArcIterator(const CompactDecodingGraph &graph, StateId s):
+      arc_(graph.emitting_arcs_.begin() + graph.states_[s].emitting_begin),
+      end_(graph.emitting_arcs_.begin() + graph.states_[s+1].emitting_begin),
+      olabel_(graph.emitting_olabels_.begin() +
+              graph.states_[s].emitting_begin) { }
+
+  bool Done() const { return arc_ == end_; }
+  void Next() { ++arc_; ++olabel_; }
+  Label ILabel() const { return arc_->ilabel; }
+  Label OLabel() const { return *olabel_; }
+  BaseFloat GraphCost() const { return arc_->graph_cost; }
+  StateId NextState() const { return arc_->nextstate; }
+
+ private:
+  typedef std::vector<CompactDecodingGraph::EmittingArc>::const_iterator
+      ArcIter;
+  ArcIter arc_, end_;
+  std::vector<Label>::const_iterator olabel_;
+};
+
+template <>
+class NonemittingArcIterator<CompactDecodingGraph> {
+ public:
+  typedef CompactDecodingGraph::StateId StateId;
+  typedef CompactDecodingGraph::Label Label;
+
+  NonemittingArcIterator(const CompactDecodingGraph &graph, StateId s):
+      arc_(graph.nonemitting_arcs_.begin() +
+           graph.states_[s].nonemitting_begin),
+      end_(graph.nonemitting_arcs_.begin() +
+           graph.states_[s+1].nonemitting_begin) { }
+
+  bool Done() const { return arc_ == end_; }
+  void Next() { ++arc_; }
+  Label ILabel() const { return 0; }
+  Label OLabel() const { return arc_->olabel; }
+  BaseFloat GraphCost() const { return arc_->graph_cost; }
+  StateId NextState() const { return arc_->nextstate; }
+
+ private:
+  typedef std::vector<CompactDecodingGraph::NonemittingArc>::const_iterator
+      ArcIter;
+  ArcIter arc_, end_;
+};
+
+
+/// Returns true if "rxfilename" is a file containing a CompactDecodingGraph,
+/// as opposed to an FST.  It only looks at the start of the file.  Pipes and
+/// the standard input cannot be read twice, so for them this returns false;
+/// compact graphs must be given to decoding programs as files.
+bool IsCompactDecodingGraph(const std::string &rxfilename);
+
+
+} // end namespace kaldi.
+
+#endif
@@ -193,9 +193,12 @@ DecodeUtteranceLatticeFasterClass::~DecodeUtteranceLatticeFasterClass() {
 }
 
 
-// Takes care of output.  Returns true on success.
-bool DecodeUtteranceLatticeFaster(
-    LatticeFasterDecoder &decoder, // not const but is really an input.
+// Does the decoding and takes care of output for the
+// DecodeUtteranceLattice*() functions below, which only differ in the type of
+// the decoder.  Returns true on success.
+template <typename Decoder>
+static bool DecodeUtteranceLatticeInternal(
+    Decoder &decoder, // not const but is really an input.
     DecodableInterface &decodable, // not const but is really an input.
     const TransitionModel &trans_model,
     const fst::SymbolTable *word_syms,
@@ -227,7 +230,7 @@ bool DecodeUtteranceLatticeFaster(
   }
 
   double likelihood;
-  LatticeWeight weight;
+  LatticeWeight weight = LatticeWeight::Zero();
   int32 num_frames;
   { // First do some stuff with word-level traceback...
     VectorFst<LatticeArc> decoded;
@@ -258,8 +261,7 @@ bool DecodeUtteranceLatticeFaster(
 
   // Get lattice, and do determinization if requested.
   Lattice lat;
-  decoder.GetRawLattice(&lat);
-  if (lat.NumStates() == 0)
+  if (!decoder.GetRawLattice(&lat))
     KALDI_ERR << "Unexpected problem getting lattice for utterance " << utt;
   fst::Connect(&lat);
   if (determinize) {
@@ -291,9 +293,11 @@ bool DecodeUtteranceLatticeFaster(
   return true;
 }
 
+
 // Takes care of output.  Returns true on success.
-bool DecodeUtteranceLatticeSimple(
-    LatticeSimpleDecoder &decoder, // not const but is really an input.
+template <typename FST>
+bool DecodeUtteranceLatticeFaster(
+    LatticeFasterDecoderTpl<FST> &decoder, // not const but is really an input.
     DecodableInterface &decodable, // not const but is really an input.
     const TransitionModel &trans_model,
     const fst::SymbolTable *word_syms,
@@ -306,86 +310,85 @@ bool DecodeUtteranceLatticeSimple(
     CompactLatticeWriter *compact_lattice_writer,
     LatticeWriter *lattice_writer,
     double *like_ptr) { // puts utterance's like in like_ptr on success.
-  using fst::VectorFst;
-
-  if (!decoder.Decode(&decodable)) {
-    KALDI_WARN << "Failed to decode file " << utt;
-    return false;
-  }
-  if (!decoder.ReachedFinal()) {
-    if (allow_partial) {
-      KALDI_WARN << "Outputting partial output for utterance " << utt
-                 << " since no final-state reached\n";
-    } else {
-      KALDI_WARN << "Not producing output for utterance " << utt
-                 << " since no final-state reached and "
-                 << "--allow-partial=false.\n";
-      return false;
-    }
-  }
+  return DecodeUtteranceLatticeInternal(decoder, decodable, trans_model,
+                                        word_syms, utt, acoustic_scale,
+                                        determinize, allow_partial,
+                                        alignment_writer, words_writer,
+                                        compact_lattice_writer, lattice_writer,
+                                        like_ptr);
+}
 
-  double likelihood;
-  LatticeWeight weight = LatticeWeight::Zero();
-  int32 num_frames;
-  { // First do some stuff with word-level traceback...
-    VectorFst<LatticeArc> decoded;
-    if (!decoder.GetBestPath(&decoded))
-      // Shouldn't really reach this point as already checked success.
-      KALDI_ERR << "Failed to get traceback for utterance " << utt;
+// Instantiate the template above for the types of graph that
+// LatticeFasterDecoderTpl is instantiated for.
+#define KALDI_INSTANTIATE_DECODE_UTTERANCE_LATTICE_FASTER(FST)           \
+  template bool DecodeUtteranceLatticeFaster(                           \
+      LatticeFasterDecoderTpl<FST> &decoder,                            \
+      DecodableInterface &decodable,                                    \
+      const TransitionModel &trans_model,                               \
+      const fst::SymbolTable *word_syms,                                \
+      std::string utt,                                                  \
+      double acoustic_scale,                                            \
+      bool determinize,                                                 \
+      bool allow_partial,                                               \
+      Int32VectorWriter *alignment_writer,                              \
+      Int32VectorWriter *words_writer,                                  \
+      CompactLatticeWriter *compact_lattice_writer,                     \
+      LatticeWriter *lattice_writer,                                    \
+      double *like_ptr);
+
+KALDI_INSTANTIATE_DECODE_UTTERANCE_LATTICE_FASTER(fst::Fst<fst::StdArc>)
+KALDI_INSTANTIATE_DECODE_UTTERANCE_LATTICE_FASTER(fst::ConstFst<fst::StdArc>)
+KALDI_INSTANTIATE_DECODE_UTTERANCE_LATTICE_FASTER(fst::VectorFst<fst::StdArc>)
+KALDI_INSTANTIATE_DECODE_UTTERANCE_LATTICE_FASTER(
+    fst::MappedConstFst<fst::StdArc>)
+KALDI_INSTANTIATE_DECODE_UTTERANCE_LATTICE_FASTER(CompactDecodingGraph)
+
+#undef KALDI_INSTANTIATE_DECODE_UTTERANCE_LATTICE_FASTER
 
-    std::vector<int32> alignment;
-    std::vector<int32> words;
-    GetLinearSymbolSequence(decoded, &alignment, &words, &weight);
-    num_frames = alignment.size();
-    if (words_writer->IsOpen())
-      words_writer->Write(utt, words);
-    if (alignment_writer->IsOpen())
-      alignment_writer->Write(utt, alignment);
-    if (word_syms != NULL) {
-      std::cerr << utt << ' ';
-      for (size_t i = 0; i < words.size(); i++) {
-        std::string s = word_syms->Find(words[i]);
-        if (s == "")
-          KALDI_ERR << "Word-id " << words[i] <<" not in symbol table.";
-        std::cerr << s << ' ';
-      }
-      std::cerr << '\n';
-    }
-    likelihood = -(weight.Value1() + weight.Value2());
-  }
+// Takes care of output.  Returns true on success.
+bool DecodeUtteranceLatticeSimple(
+    LatticeSimpleDecoder &decoder, // not const but is really an input.
+    DecodableInterface &decodable, // not const but is really an input.
+    const TransitionModel &trans_model,
+    const fst::SymbolTable *word_syms,
+    std::string utt,
+    double acoustic_scale,
+    bool determinize,
+    bool allow_partial,
+    Int32VectorWriter *alignment_writer,
+    Int32VectorWriter *words_writer,
+    CompactLatticeWriter *compact_lattice_writer,
+    LatticeWriter *lattice_writer,
+    double *like_ptr) { // puts utterance's like in like_ptr on success.
+  return DecodeUtteranceLatticeInternal(decoder, decodable, trans_model,
+                                        word_syms, utt, acoustic_scale,
+                                        determinize, allow_partial,
+                                        alignment_writer, words_writer,
+                                        compact_lattice_writer, lattice_writer,
+                                        like_ptr);
+}
 
-  // Get lattice, and do determinization if requested.
-  Lattice lat;
-  if (!decoder.GetRawLattice(&lat))
-    KALDI_ERR << "Unexpected problem getting lattice for utterance " << utt;
-  fst::Connect(&lat);
-  if (determinize) {
-    CompactLattice clat;
-    if (!DeterminizeLatticePhonePrunedWrapper(
-            trans_model,
-            &lat,
-            decoder.GetOptions().lattice_beam,
-            &clat,
-            decoder.GetOptions().det_opts))
-      KALDI_WARN << "Determinization finished earlier than the beam for "
-                 << "utterance " << utt;
-    // We'll write the lattice without acoustic scaling.
-    if (acoustic_scale != 0.0)
-      fst::ScaleLattice(fst::AcousticLatticeScale(1.0 / acoustic_scale), &clat);
-    compact_lattice_writer->Write(utt, clat);
-  } else {
-    // We'll write the lattice without acoustic scaling.
-    if (acoustic_scale != 0.0)
-      fst::ScaleLattice(fst::AcousticLatticeScale(1.0 / acoustic_scale), &lat);
-    lattice_writer->Write(utt, lat);
-  }
-  KALDI_LOG << "Log-like per frame for utterance " << utt << " is "
-            << (likelihood / num_frames) << " over "
-            << num_frames << " frames.";
-  KALDI_VLOG(2) << "Cost for utterance " << utt << " is "
-                << weight.Value1() << " + " << weight.Value2();
-  *like_ptr = likelihood;
-  return true;
+// Takes care of output.  Returns true on success.
+bool DecodeUtteranceLatticeBiglmFaster(
+    LatticeBiglmFasterDecoder &decoder, // not const but is really an input.
+    DecodableInterface &decodable, // not const but is really an input.
+    const TransitionModel &trans_model,
+    const fst::SymbolTable *word_syms,
+    std::string utt,
+    double acoustic_scale,
+    bool determinize,
+    bool allow_partial,
+    Int32VectorWriter *alignment_writer,
+    Int32VectorWriter *words_writer,
+    CompactLatticeWriter *compact_lattice_writer,
+    LatticeWriter *lattice_writer,
+    double *like_ptr) { // puts utterance's like in like_ptr on success.
+  return DecodeUtteranceLatticeInternal(decoder, decodable, trans_model,
+                                        word_syms, utt, acoustic_scale,
+                                        determinize, allow_partial,
+                                        alignment_writer, words_writer,
+                                        compact_lattice_writer, lattice_writer,
+                                        like_ptr);
 }
 
 
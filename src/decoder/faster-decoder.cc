@@ -19,12 +19,14 @@
 // limitations under the License.
 
 #include "decoder/faster-decoder.h"
+#include "fstext/mapped-const-fst.h"
 
 namespace kaldi {
 
 
-FasterDecoder::FasterDecoder(const fst::Fst<fst::StdArc> &fst,
-                             const FasterDecoderOptions &opts):
+template <typename FST>
+FasterDecoderTpl<FST>::FasterDecoderTpl(const FST &fst,
+                                        const FasterDecoderOptions &opts):
     fst_(fst), config_(opts), num_frames_decoded_(-1) {
   KALDI_ASSERT(config_.hash_ratio >= 1.0);  // less doesn't make much sense.
   KALDI_ASSERT(config_.max_active > 1);
@@ -33,7 +35,8 @@ FasterDecoder::FasterDecoder(const fst::Fst<fst::StdArc> &fst,
 }
 
 
-void FasterDecoder::InitDecoding() {
+template <typename FST>
+void FasterDecoderTpl<FST>::InitDecoding() {
   // clean up from last time:
   ClearToks(toks_.Clear());
   StateId start_state = fst_.Start();
@@ -45,7 +48,8 @@ void FasterDecoder::InitDecoding() {
 }
 
 
-void FasterDecoder::Decode(DecodableInterface *decodable) {
+template <typename FST>
+void FasterDecoderTpl<FST>::Decode(DecodableInterface *decodable) {
   InitDecoding();
   while (!decodable->IsLastFrame(num_frames_decoded_ - 1)) {
     double weight_cutoff = ProcessEmitting(decodable);
@@ -53,8 +57,9 @@ void FasterDecoder::Decode(DecodableInterface *decodable) {
   }
 }
 
-void FasterDecoder::AdvanceDecoding(DecodableInterface *decodable,
-                                      int32 max_num_frames) {
+template <typename FST>
+void FasterDecoderTpl<FST>::AdvanceDecoding(DecodableInterface *decodable,
+                                            int32 max_num_frames) {
   KALDI_ASSERT(num_frames_decoded_ >= 0 &&
                "You must call InitDecoding() before AdvanceDecoding()");
   int32 num_frames_ready = decodable->NumFramesReady();
@@ -75,7 +80,8 @@ void FasterDecoder::AdvanceDecoding(DecodableInterface *decodable,
 }
 
 
-bool FasterDecoder::ReachedFinal() {
+template <typename FST>
+bool FasterDecoderTpl<FST>::ReachedFinal() {
   for (const Elem *e = toks_.GetList(); e != NULL; e = e->tail) {
     if (e->val->cost_ != std::numeric_limits<double>::infinity() &&
         fst_.Final(e->key) != Weight::Zero())
@@ -84,8 +90,9 @@ bool FasterDecoder::ReachedFinal() {
   return false;
 }
 
-bool FasterDecoder::GetBestPath(fst::MutableFst<LatticeArc> *fst_out,
-                                bool use_final_probs) {
+template <typename FST>
+bool FasterDecoderTpl<FST>::GetBestPath(fst::MutableFst<LatticeArc> *fst_out,
+                                        bool use_final_probs) {
   // GetBestPath gets the decoding output.  If "use_final_probs" is true
   // AND we reached a final state, it limits itself to final states;
   // otherwise it gets the most likely token not taking into
@@ -148,8 +155,10 @@ bool FasterDecoder::GetBestPath(fst::MutableFst<LatticeArc> *fst_out,
 
 
 // Gets the weight cutoff.  Also counts the active tokens.
-double FasterDecoder::GetCutoff(Elem *list_head, size_t *tok_count,
-                                BaseFloat *adaptive_beam, Elem **best_elem) {
+template <typename FST>
+double FasterDecoderTpl<FST>::GetCutoff(Elem *list_head, size_t *tok_count,
+                                        BaseFloat *adaptive_beam,
+                                        Elem **best_elem) {
   double best_cost = std::numeric_limits<double>::infinity();
   size_t count = 0;
   if (config_.max_active == std::numeric_limits<int32>::max() &&
@@ -212,7 +221,8 @@ double FasterDecoder::GetCutoff(Elem *list_head, size_t *tok_count,
   }
 }
 
-void FasterDecoder::PossiblyResizeHash(size_t num_toks) {
+template <typename FST>
+void FasterDecoderTpl<FST>::PossiblyResizeHash(size_t num_toks) {
   size_t new_sz = static_cast<size_t>(static_cast<BaseFloat>(num_toks)
                                       * config_.hash_ratio);
   if (new_sz > toks_.Size()) {
@@ -221,7 +231,8 @@ void FasterDecoder::PossiblyResizeHash(size_t num_toks) {
 }
 
 // ProcessEmitting returns the likelihood cutoff used.
-double FasterDecoder::ProcessEmitting(DecodableInterface *decodable) {
+template <typename FST>
+double FasterDecoderTpl<FST>::ProcessEmitting(DecodableInterface *decodable) {
   int32 frame = num_frames_decoded_;
   Elem *last_toks = toks_.Clear();
   size_t tok_cnt;
@@ -242,16 +253,13 @@ double FasterDecoder::ProcessEmitting(DecodableInterface *decodable) {
   if (best_elem) {
     StateId state = best_elem->key;
     Token *tok = best_elem->val;
-    for (fst::ArcIterator<fst::Fst<Arc> > aiter(fst_, state);
+    for (EmittingArcIterator<FST> aiter(fst_, state);
          !aiter.Done();
          aiter.Next()) {
-      const Arc &arc = aiter.Value();
-      if (arc.ilabel != 0) {  // we'd propagate..
-        BaseFloat ac_cost = - decodable->LogLikelihood(frame, arc.ilabel);
-        double new_weight = arc.weight.Value() + tok->cost_ + ac_cost;
-        if (new_weight + adaptive_beam < next_weight_cutoff)
-          next_weight_cutoff = new_weight + adaptive_beam;
-      }
+      BaseFloat ac_cost = - decodable->LogLikelihood(frame, aiter.ILabel());
+      double new_weight = aiter.GraphCost() + tok->cost_ + ac_cost;
+      if (new_weight + adaptive_beam < next_weight_cutoff)
+        next_weight_cutoff = new_weight + adaptive_beam;
     }
   }
 
@@ -268,27 +276,28 @@ double FasterDecoder::ProcessEmitting(DecodableInterface *decodable) {
     if (tok->cost_ < weight_cutoff) {  // not pruned.
       // np++;
       KALDI_ASSERT(state == tok->arc_.nextstate);
-      for (fst::ArcIterator<fst::Fst<Arc> > aiter(fst_, state);
+      for (EmittingArcIterator<FST> aiter(fst_, state);
            !aiter.Done();
            aiter.Next()) {
-        Arc arc = aiter.Value();
-        if (arc.ilabel != 0) {  // propagate..
-          BaseFloat ac_cost =  - decodable->LogLikelihood(frame, arc.ilabel);
-          double new_weight = arc.weight.Value() + tok->cost_ + ac_cost;
-          if (new_weight < next_weight_cutoff) {  // not pruned..
-            Token *new_tok = new Token(arc, ac_cost, tok);
-            Elem *e_found = toks_.Find(arc.nextstate);
-            if (new_weight + adaptive_beam < next_weight_cutoff)
-              next_weight_cutoff = new_weight + adaptive_beam;
-            if (e_found == NULL) {
-              toks_.Insert(arc.nextstate, new_tok);
+        Label ilabel = aiter.ILabel();
+        BaseFloat ac_cost =  - decodable->LogLikelihood(frame, ilabel),
+            graph_cost = aiter.GraphCost();
+        double new_weight = graph_cost + tok->cost_ + ac_cost;
+        if (new_weight < next_weight_cutoff) {  // not pruned..
+          Arc arc(ilabel, aiter.OLabel(), Weight(graph_cost),
+                  aiter.NextState());
+          Token *new_tok = new Token(arc, ac_cost, tok);
+          Elem *e_found = toks_.Find(arc.nextstate);
+          if (new_weight + adaptive_beam < next_weight_cutoff)
+            next_weight_cutoff = new_weight + adaptive_beam;
+          if (e_found == NULL) {
+            toks_.Insert(arc.nextstate, new_tok);
+          } else {
+            if ( *(e_found->val) < *new_tok ) {
+              Token::TokenDelete(e_found->val);
+              e_found->val = new_tok;
             } else {
-              if ( *(e_found->val) < *new_tok ) {
-                Token::TokenDelete(e_found->val);
-                e_found->val = new_tok;
-              } else {
-                Token::TokenDelete(new_tok);
-              }
+              Token::TokenDelete(new_tok);
             }
           }
         }
@@ -303,7 +312,8 @@ double FasterDecoder::ProcessEmitting(DecodableInterface *decodable) {
 }
 
 // TODO: first time we go through this, could avoid using the queue.
-void FasterDecoder::ProcessNonemitting(double cutoff) {
+template <typename FST>
+void FasterDecoderTpl<FST>::ProcessNonemitting(double cutoff) {
   // Processes nonemitting arcs for one frame. 
   KALDI_ASSERT(queue_.empty());
   for (const Elem *e = toks_.GetList(); e != NULL;  e = e->tail)
@@ -317,27 +327,25 @@ void FasterDecoder::ProcessNonemitting(double cutoff) {
       continue;
     }
     KALDI_ASSERT(tok != NULL && state == tok->arc_.nextstate);
-    for (fst::ArcIterator<fst::Fst<Arc> > aiter(fst_, state);
+    for (NonemittingArcIterator<FST> aiter(fst_, state);
          !aiter.Done();
          aiter.Next()) {
-      const Arc &arc = aiter.Value();
-      if (arc.ilabel == 0) {  // propagate nonemitting only...
-        Token *new_tok = new Token(arc, tok);
-        if (new_tok->cost_ > cutoff) {  // prune
-          Token::TokenDelete(new_tok);
+      Arc arc(0, aiter.OLabel(), Weight(aiter.GraphCost()), aiter.NextState());
+      Token *new_tok = new Token(arc, tok);
+      if (new_tok->cost_ > cutoff) {  // prune
+        Token::TokenDelete(new_tok);
+      } else {
+        Elem *e_found = toks_.Find(arc.nextstate);
+        if (e_found == NULL) {
+          toks_.Insert(arc.nextstate, new_tok);
+          queue_.push_back(arc.nextstate);
         } else {
-          Elem *e_found = toks_.Find(arc.nextstate);
-          if (e_found == NULL) {
-            toks_.Insert(arc.nextstate, new_tok);
+          if ( *(e_found->val) < *new_tok ) {
+            Token::TokenDelete(e_found->val);
+            e_found->val = new_tok;
             queue_.push_back(arc.nextstate);
           } else {
-            if ( *(e_found->val) < *new_tok ) {
-              Token::TokenDelete(e_found->val);
-              e_found->val = new_tok;
-              queue_.push_back(arc.nextstate);
-            } else {
-              Token::TokenDelete(new_tok);
-            }
+            Token::TokenDelete(new_tok);
           }
         }
       }
@@ -345,7 +353,8 @@ void FasterDecoder::ProcessNonemitting(double cutoff) {
   }
 }
 
-void FasterDecoder::ClearToks(Elem *list) {
+template <typename FST>
+void FasterDecoderTpl<FST>::ClearToks(Elem *list) {
   for (Elem *e = list, *e_tail; e != NULL; e = e_tail) {
     Token::TokenDelete(e->val);
     e_tail = e->tail;
@@ -353,4 +362,11 @@ void FasterDecoder::ClearToks(Elem *list) {
   }
 }
 
+// Instantiate the template for the types of graph we decode with.
+template class FasterDecoderTpl<fst::Fst<fst::StdArc> >;
+template class FasterDecoderTpl<fst::ConstFst<fst::StdArc> >;
+template class FasterDecoderTpl<fst::VectorFst<fst::StdArc> >;
+template class FasterDecoderTpl<fst::MappedConstFst<fst::StdArc> >;
+template class FasterDecoderTpl<CompactDecodingGraph>;
+
 } // end namespace kaldi.
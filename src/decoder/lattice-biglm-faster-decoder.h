@@ -24,6 +24,7 @@
 
 #include "util/stl-utils.h"
 #include "util/hash-list.h"
+#include "util/memory-pool.h"
 #include "fst/fstlib.h"
 #include "itf/decodable-itf.h"
 #include "fstext/fstext-lib.h"
@@ -70,6 +71,16 @@ class LatticeBiglmFasterDecoder {
   ~LatticeBiglmFasterDecoder() {
     DeleteElems(toks_.Clear());    
     ClearActiveTokens();
+    KALDI_VLOG(2) << AllocatorInfo();
+  }
+
+  /// Returns a string describing the usage of the memory pools from which
+  /// Tokens and ForwardLinks are allocated; for diagnostics.
+  std::string AllocatorInfo() const {
+    std::ostringstream os;
+    os << "Token pool: " << token_pool_.Info()
+       << "; ForwardLink pool: " << link_pool_.Info();
+    return os.str();
   }
 
   // Returns true if any kind of traceback is available (not necessarily from
@@ -78,13 +89,17 @@ class LatticeBiglmFasterDecoder {
     // clean up from last time:
     DeleteElems(toks_.Clear());
     ClearActiveTokens();
+    // All Tokens and ForwardLinks have been freed; this puts the pools' free
+    // lists back in address order, for locality.
+    token_pool_.Reset();
+    link_pool_.Reset();
     warned_ = false;
     final_active_ = false;
     final_costs_.clear();
     num_toks_ = 0;
     PairId start_pair = ConstructPair(fst_.Start(), lm_diff_fst_->Start());
     active_toks_.resize(1);
-    Token *start_tok = new Token(0.0, 0.0, NULL, NULL);
+    Token *start_tok = NewToken(0.0, 0.0, NULL, NULL);
     active_toks_[0].toks = start_tok;
     toks_.Insert(start_pair, start_tok);
     num_toks_++;
@@ -276,15 +291,6 @@ class LatticeBiglmFasterDecoder {
     inline Token(BaseFloat tot_cost, BaseFloat extra_cost, ForwardLink *links,
                  Token *next): tot_cost(tot_cost), extra_cost(extra_cost),
                  links(links), next(next) { }
-    inline void DeleteForwardLinks() {
-      ForwardLink *l = links, *m; 
-      while (l != NULL) {
-        m = l->next;
-        delete l;
-        l = m;
-      }
-      links = NULL;
-    }
   };
   
   // head and tail of per-frame list of Tokens (list is in topological order),
@@ -298,6 +304,34 @@ class LatticeBiglmFasterDecoder {
   };
 
   typedef HashList<PairId, Token*>::Elem Elem;
+
+  // Tokens and ForwardLinks are allocated from token_pool_ and link_pool_
+  // rather than with new and delete; these functions wrap that.
+  inline Token *NewToken(BaseFloat tot_cost, BaseFloat extra_cost,
+                         ForwardLink *links, Token *next) {
+    return new (token_pool_.Allocate()) Token(tot_cost, extra_cost,
+                                              links, next);
+  }
+  inline void DeleteToken(Token *tok) { token_pool_.Free(tok); }
+  inline ForwardLink *NewForwardLink(Token *next_tok, Label ilabel,
+                                     Label olabel, BaseFloat graph_cost,
+                                     BaseFloat acoustic_cost,
+                                     ForwardLink *next) {
+    return new (link_pool_.Allocate()) ForwardLink(
+        next_tok, ilabel, olabel, graph_cost, acoustic_cost, next);
+  }
+  inline void DeleteForwardLink(ForwardLink *link) { link_pool_.Free(link); }
+
+  // Deletes all the forward links of "tok" and sets tok->links to NULL.
+  inline void DeleteForwardLinks(Token *tok) {
+    ForwardLink *l = tok->links, *m;
+    while (l != NULL) {
+      m = l->next;
+      DeleteForwardLink(l);
+      l = m;
+    }
+    tok->links = NULL;
+  }
   
   void PossiblyResizeHash(size_t num_toks) {
     size_t new_sz = static_cast<size_t>(static_cast<BaseFloat>(num_toks)
@@ -324,7 +358,7 @@ class LatticeBiglmFasterDecoder {
       // tokens on the currently final frame have zero extra_cost
       // as any of them could end up
       // on the winning path.
-      Token *new_tok = new Token (tot_cost, extra_cost, NULL, toks);
+      Token *new_tok = NewToken(tot_cost, extra_cost, NULL, toks);
       // NULL: no forward links yet
       toks = new_tok;
       num_toks_++;
@@ -396,7 +430,7 @@ class LatticeBiglmFasterDecoder {
             ForwardLink *next_link = link->next;
             if (prev_link != NULL) prev_link->next = next_link;
             else tok->links = next_link;
-            delete link;
+            DeleteForwardLink(link);
             link = next_link; // advance link but leave prev_link the same.
             *links_pruned = true;
           } else { // keep the link and update the tok_extra_cost if needed.
@@ -487,7 +521,7 @@ class LatticeBiglmFasterDecoder {
             ForwardLink *next_link = link->next;
             if (prev_link != NULL) prev_link->next = next_link;
             else tok->links = next_link;
-            delete link;
+            DeleteForwardLink(link);
             link = next_link; // advance link but leave prev_link the same.
           } else { // keep the link and update the tok_extra_cost if needed.
             if (link_extra_cost < 0.0) { // this is just a precaution.
@@ -548,7 +582,7 @@ class LatticeBiglmFasterDecoder {
         // excise tok from list and delete tok.
         if (prev_tok != NULL) prev_tok->next = tok->next;
         else toks = tok->next;
-        delete tok;
+        DeleteToken(tok);
         num_toks_--;
       } else { // fetch next Token
         prev_tok = tok;
@@ -748,8 +782,8 @@ class LatticeBiglmFasterDecoder {
             // true: emitting, NULL: no change indicator needed
           
             // Add ForwardLink from tok to next_tok (put on head of list tok->links)
-            tok->links = new ForwardLink(next_tok, arc.ilabel, arc.olabel, 
-                                         graph_cost, ac_cost, tok->links);
+            tok->links = NewForwardLink(next_tok, arc.ilabel, arc.olabel,
+                                        graph_cost, ac_cost, tok->links);
           }
         } // for all arcs
       }
@@ -798,7 +832,7 @@ class LatticeBiglmFasterDecoder {
       // because we're about to regenerate them.  This is a kind
       // of non-optimality (remember, this is the simple decoder),
       // but since most states are emitting it's not a huge issue.
-      tok->DeleteForwardLinks(); // necessary when re-visiting
+      DeleteForwardLinks(tok); // necessary when re-visiting
       tok->links = NULL;
       for (fst::ArcIterator<fst::Fst<Arc> > aiter(fst_, state);
           !aiter.Done();
@@ -815,8 +849,8 @@ class LatticeBiglmFasterDecoder {
             Token *new_tok = FindOrAddToken(next_pair, frame, tot_cost,
                                             false, &changed); // false: non-emit
             
-            tok->links = new ForwardLink(new_tok, 0, arc.olabel,
-                                         graph_cost, 0, tok->links);
+            tok->links = NewForwardLink(new_tok, 0, arc.olabel,
+                                        graph_cost, 0, tok->links);
             
             // "changed" tells us whether the new token has a different
             // cost from before, or is new [if so, add into queue].
@@ -844,6 +878,10 @@ class LatticeBiglmFasterDecoder {
   bool warned_noarc_;  
   int32 num_toks_; // current total #toks allocated...
   bool warned_;
+  // Per-decoder memory pools for Tokens and ForwardLinks; the memory is
+  // recycled across frames and across utterances.
+  MemoryPool<Token> token_pool_;
+  MemoryPool<ForwardLink> link_pool_;
   bool final_active_; // use this to say whether we found active final tokens
   // on the last frame.
   std::map<Token*, BaseFloat> final_costs_; // A cache of final-costs
@@ -868,9 +906,9 @@ class LatticeBiglmFasterDecoder {
       // Delete all tokens alive on this frame, and any forward
       // links they may have.
       for (Token *tok = active_toks_[i].toks; tok != NULL; ) {
-        tok->DeleteForwardLinks();
+        DeleteForwardLinks(tok);
         Token *next_tok = tok->next;
-        delete tok;
+        DeleteToken(tok);
         num_toks_--;
         tok = next_tok;
       }
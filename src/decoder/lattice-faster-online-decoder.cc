@@ -29,8 +29,9 @@
 namespace kaldi {
 
 // instantiate this class once for each thing you have to decode.
-LatticeFasterOnlineDecoder::LatticeFasterOnlineDecoder(
-    const fst::Fst<fst::StdArc> &fst,
+template <typename FST>
+LatticeFasterOnlineDecoderTpl<FST>::LatticeFasterOnlineDecoderTpl(
+    const FST &fst,
     const LatticeFasterDecoderConfig &config):
     fst_(fst), delete_fst_(false), config_(config), num_toks_(0) {
   config.Check();
@@ -38,25 +39,41 @@ LatticeFasterOnlineDecoder::LatticeFasterOnlineDecoder(
 }
 
 
-LatticeFasterOnlineDecoder::LatticeFasterOnlineDecoder(const LatticeFasterDecoderConfig &config,
-                                                       fst::Fst<fst::StdArc> *fst):
+template <typename FST>
+LatticeFasterOnlineDecoderTpl<FST>::LatticeFasterOnlineDecoderTpl(
+    const LatticeFasterDecoderConfig &config, FST *fst):
     fst_(*fst), delete_fst_(true), config_(config), num_toks_(0) {
   config.Check();
   toks_.SetSize(1000);  // just so on the first frame we do something reasonable.
 }
 
 
-LatticeFasterOnlineDecoder::~LatticeFasterOnlineDecoder() {
+template <typename FST>
+LatticeFasterOnlineDecoderTpl<FST>::~LatticeFasterOnlineDecoderTpl() {
   DeleteElems(toks_.Clear());
   ClearActiveTokens();
+  KALDI_VLOG(2) << AllocatorInfo();
   if (delete_fst_) delete &(fst_);
 }
 
-void LatticeFasterOnlineDecoder::InitDecoding() {
+template <typename FST>
+std::string LatticeFasterOnlineDecoderTpl<FST>::AllocatorInfo() const {
+  std::ostringstream os;
+  os << "Token pool: " << token_pool_.Info()
+     << "; ForwardLink pool: " << link_pool_.Info();
+  return os.str();
+}
+
+template <typename FST>
+void LatticeFasterOnlineDecoderTpl<FST>::InitDecoding() {
   // clean up from last time:
   DeleteElems(toks_.Clear());
   cost_offsets_.clear();
   ClearActiveTokens();
+  // All Tokens and ForwardLinks have been freed; this puts the pools' free
+  // lists back in address order, for locality.
+  token_pool_.Reset();
+  link_pool_.Reset();
   warned_ = false;
   num_toks_ = 0;
   decoding_finalized_ = false;
@@ -64,7 +81,7 @@ void LatticeFasterOnlineDecoder::InitDecoding() {
   StateId start_state = fst_.Start();
   KALDI_ASSERT(start_state != fst::kNoStateId);
   active_toks_.resize(1);
-  Token *start_tok = new Token(0.0, 0.0, NULL, NULL, NULL);
+  Token *start_tok = NewToken(0.0, 0.0, NULL, NULL, NULL);
   active_toks_[0].toks = start_tok;
   toks_.Insert(start_state, start_tok);
   num_toks_++;
@@ -74,7 +91,8 @@ void LatticeFasterOnlineDecoder::InitDecoding() {
 // Returns true if any kind of traceback is available (not necessarily from
 // a final state).  It should only very rarely return false; this indicates
 // an unusual search error.
-bool LatticeFasterOnlineDecoder::Decode(DecodableInterface *decodable) {
+template <typename FST>
+bool LatticeFasterOnlineDecoderTpl<FST>::Decode(DecodableInterface *decodable) {
   InitDecoding();
 
   // We use 1-based indexing for frames in this decoder (if you view it in
@@ -98,7 +116,8 @@ bool LatticeFasterOnlineDecoder::Decode(DecodableInterface *decodable) {
 
 
 
-bool LatticeFasterOnlineDecoder::TestGetBestPath(bool use_final_probs) const {
+template <typename FST>
+bool LatticeFasterOnlineDecoderTpl<FST>::TestGetBestPath(bool use_final_probs) const {
   Lattice lat1;
   {
     Lattice raw_lat;
@@ -119,8 +138,9 @@ bool LatticeFasterOnlineDecoder::TestGetBestPath(bool use_final_probs) const {
 
 
 // Outputs an FST corresponding to the single best path through the lattice.
-bool LatticeFasterOnlineDecoder::GetBestPath(Lattice *olat,
-                                             bool use_final_probs) const {
+template <typename FST>
+bool LatticeFasterOnlineDecoderTpl<FST>::GetBestPath(
+    Lattice *olat, bool use_final_probs) const {
   olat->DeleteStates();
   BaseFloat final_graph_cost;
   BestPathIterator iter = BestPathEnd(use_final_probs, &final_graph_cost);
@@ -143,8 +163,9 @@ bool LatticeFasterOnlineDecoder::GetBestPath(Lattice *olat,
 
 // Outputs an FST corresponding to the raw, state-level
 // tracebacks.
-bool LatticeFasterOnlineDecoder::GetRawLattice(Lattice *ofst,
-                                               bool use_final_probs) const {
+template <typename FST>
+bool LatticeFasterOnlineDecoderTpl<FST>::GetRawLattice(
+    Lattice *ofst, bool use_final_probs) const {
   typedef LatticeArc Arc;
   typedef Arc::StateId StateId;
   typedef Arc::Weight Weight;
@@ -198,7 +219,7 @@ bool LatticeFasterOnlineDecoder::GetRawLattice(Lattice *ofst,
       for (ForwardLink *l = tok->links;
            l != NULL;
            l = l->next) {
-        unordered_map<Token*, StateId>::const_iterator iter =
+        typename unordered_map<Token*, StateId>::const_iterator iter =
             tok_map.find(l->next_tok);
         StateId nextstate = iter->second;
         KALDI_ASSERT(iter != tok_map.end());
@@ -214,7 +235,7 @@ bool LatticeFasterOnlineDecoder::GetRawLattice(Lattice *ofst,
       }
       if (f == num_frames) {
         if (use_final_probs && !final_costs.empty()) {
-          unordered_map<Token*, BaseFloat>::const_iterator iter =
+          typename unordered_map<Token*, BaseFloat>::const_iterator iter =
               final_costs.find(tok);
           if (iter != final_costs.end())
             ofst->SetFinal(cur_state, LatticeWeight(iter->second, 0));
@@ -227,7 +248,8 @@ bool LatticeFasterOnlineDecoder::GetRawLattice(Lattice *ofst,
   return (ofst->NumStates() > 0);
 }
 
-bool LatticeFasterOnlineDecoder::GetRawLatticePruned(
+template <typename FST>
+bool LatticeFasterOnlineDecoderTpl<FST>::GetRawLatticePruned(
     Lattice *ofst,
     bool use_final_probs,
     BaseFloat beam) const {
@@ -284,7 +306,7 @@ bool LatticeFasterOnlineDecoder::GetRawLatticePruned(
     int32 cur_frame = cur_tok_pair.second;
     KALDI_ASSERT(cur_frame >= 0 && cur_frame <= cost_offsets_.size());
     
-    unordered_map<Token*, StateId>::const_iterator iter =
+    typename unordered_map<Token*, StateId>::const_iterator iter =
         tok_map.find(cur_tok);
     KALDI_ASSERT(iter != tok_map.end());
     StateId cur_state = iter->second;
@@ -312,7 +334,7 @@ bool LatticeFasterOnlineDecoder::GetRawLatticePruned(
     }
     if (cur_frame == num_frames) {
       if (use_final_probs && !final_costs.empty()) {
-        unordered_map<Token*, BaseFloat>::const_iterator iter =
+        typename unordered_map<Token*, BaseFloat>::const_iterator iter =
             final_costs.find(cur_tok);
         if (iter != final_costs.end())
           ofst->SetFinal(cur_state, LatticeWeight(iter->second, 0));
@@ -325,7 +347,8 @@ bool LatticeFasterOnlineDecoder::GetRawLatticePruned(
 }
 
 
-void LatticeFasterOnlineDecoder::PossiblyResizeHash(size_t num_toks) {
+template <typename FST>
+void LatticeFasterOnlineDecoderTpl<FST>::PossiblyResizeHash(size_t num_toks) {
   size_t new_sz = static_cast<size_t>(static_cast<BaseFloat>(num_toks)
                                       * config_.hash_ratio);
   if (new_sz > toks_.Size()) {
@@ -338,7 +361,9 @@ void LatticeFasterOnlineDecoder::PossiblyResizeHash(size_t num_toks) {
 // for the current frame.  [note: it's inserted if necessary into hash toks_
 // and also into the singly linked list of tokens active on this frame
 // (whose head is at active_toks_[frame]).
-inline LatticeFasterOnlineDecoder::Token *LatticeFasterOnlineDecoder::FindOrAddToken(
+template <typename FST>
+inline typename LatticeFasterOnlineDecoderTpl<FST>::Token *
+LatticeFasterOnlineDecoderTpl<FST>::FindOrAddToken(
     StateId state, int32 frame_plus_one, BaseFloat tot_cost,
     Token *backpointer, bool *changed) {
   // Returns the Token pointer.  Sets "changed" (if non-NULL) to true
@@ -351,7 +376,7 @@ inline LatticeFasterOnlineDecoder::Token *LatticeFasterOnlineDecoder::FindOrAddT
     // tokens on the currently final frame have zero extra_cost
     // as any of them could end up
     // on the winning path.
-    Token *new_tok = new Token (tot_cost, extra_cost, NULL, toks, backpointer);
+    Token *new_tok = NewToken(tot_cost, extra_cost, NULL, toks, backpointer);
     // NULL: no forward links yet
     toks = new_tok;
     num_toks_++;
@@ -381,7 +406,8 @@ inline LatticeFasterOnlineDecoder::Token *LatticeFasterOnlineDecoder::FindOrAddT
 // prunes outgoing links for all tokens in active_toks_[frame]
 // it's called by PruneActiveTokens
 // all links, that have link_extra_cost > lattice_beam are pruned
-void LatticeFasterOnlineDecoder::PruneForwardLinks(
+template <typename FST>
+void LatticeFasterOnlineDecoderTpl<FST>::PruneForwardLinks(
     int32 frame_plus_one, bool *extra_costs_changed,
     bool *links_pruned, BaseFloat delta) {
   // delta is the amount by which the extra_costs must change
@@ -425,7 +451,7 @@ void LatticeFasterOnlineDecoder::PruneForwardLinks(
           ForwardLink *next_link = link->next;
           if (prev_link != NULL) prev_link->next = next_link;
           else tok->links = next_link;
-          delete link;
+          DeleteForwardLink(link);
           link = next_link;  // advance link but leave prev_link the same.
           *links_pruned = true;
         } else {   // keep the link and update the tok_extra_cost if needed.
@@ -457,14 +483,15 @@ void LatticeFasterOnlineDecoder::PruneForwardLinks(
 // PruneForwardLinksFinal is a version of PruneForwardLinks that we call
 // on the final frame.  If there are final tokens active, it uses
 // the final-probs for pruning, otherwise it treats all tokens as final.
-void LatticeFasterOnlineDecoder::PruneForwardLinksFinal() {
+template <typename FST>
+void LatticeFasterOnlineDecoderTpl<FST>::PruneForwardLinksFinal() {
   KALDI_ASSERT(!active_toks_.empty());
   int32 frame_plus_one = active_toks_.size() - 1;
 
   if (active_toks_[frame_plus_one].toks == NULL )  // empty list; should not happen.
     KALDI_WARN << "No tokens alive at end of file\n";
 
-  typedef unordered_map<Token*, BaseFloat>::const_iterator IterType;
+  typedef typename unordered_map<Token*, BaseFloat>::const_iterator IterType;
   ComputeFinalCosts(&final_costs_, &final_relative_cost_, &final_best_cost_);
   decoding_finalized_ = true;
   // We call DeleteElems() as a nicety, not because it's really necessary;
@@ -512,7 +539,7 @@ void LatticeFasterOnlineDecoder::PruneForwardLinksFinal() {
           ForwardLink *next_link = link->next;
           if (prev_link != NULL) prev_link->next = next_link;
           else tok->links = next_link;
-          delete link;
+          DeleteForwardLink(link);
           link = next_link; // advance link but leave prev_link the same.
         } else { // keep the link and update the tok_extra_cost if needed.
           if (link_extra_cost < 0.0) { // this is just a precaution.
@@ -542,7 +569,8 @@ void LatticeFasterOnlineDecoder::PruneForwardLinksFinal() {
 
 }
 
-BaseFloat LatticeFasterOnlineDecoder::FinalRelativeCost() const {
+template <typename FST>
+BaseFloat LatticeFasterOnlineDecoderTpl<FST>::FinalRelativeCost() const {
   if (!decoding_finalized_) {
     BaseFloat relative_cost;
     ComputeFinalCosts(NULL, &relative_cost, NULL);
@@ -559,7 +587,8 @@ BaseFloat LatticeFasterOnlineDecoder::FinalRelativeCost() const {
 // [we don't do this in PruneForwardLinks because it would give us
 // a problem with dangling pointers].
 // It's called by PruneActiveTokens if any forward links have been pruned
-void LatticeFasterOnlineDecoder::PruneTokensForFrame(int32 frame_plus_one) {
+template <typename FST>
+void LatticeFasterOnlineDecoderTpl<FST>::PruneTokensForFrame(int32 frame_plus_one) {
   KALDI_ASSERT(frame_plus_one >= 0 && frame_plus_one < active_toks_.size());
   Token *&toks = active_toks_[frame_plus_one].toks;
   if (toks == NULL)
@@ -572,7 +601,7 @@ void LatticeFasterOnlineDecoder::PruneTokensForFrame(int32 frame_plus_one) {
       // excise tok from list and delete tok.
       if (prev_tok != NULL) prev_tok->next = tok->next;
       else toks = tok->next;
-      delete tok;
+      DeleteToken(tok);
       num_toks_--;
     } else {  // fetch next Token
       prev_tok = tok;
@@ -585,7 +614,8 @@ void LatticeFasterOnlineDecoder::PruneTokensForFrame(int32 frame_plus_one) {
 // that.  We go backwards through the frames and stop when we reach a point
 // where the delta-costs are not changing (and the delta controls when we consider
 // a cost to have "not changed").
-void LatticeFasterOnlineDecoder::PruneActiveTokens(BaseFloat delta) {
+template <typename FST>
+void LatticeFasterOnlineDecoderTpl<FST>::PruneActiveTokens(BaseFloat delta) {
   int32 cur_frame_plus_one = NumFramesDecoded();
   int32 num_toks_begin = num_toks_;
   // The index "f" below represents a "frame plus one", i.e. you'd have to subtract
@@ -614,7 +644,8 @@ void LatticeFasterOnlineDecoder::PruneActiveTokens(BaseFloat delta) {
                 << " to " << num_toks_;
 }
 
-void LatticeFasterOnlineDecoder::ComputeFinalCosts(
+template <typename FST>
+void LatticeFasterOnlineDecoderTpl<FST>::ComputeFinalCosts(
     unordered_map<Token*, BaseFloat> *final_costs,
     BaseFloat *final_relative_cost,
     BaseFloat *final_best_cost) const {
@@ -657,7 +688,9 @@ void LatticeFasterOnlineDecoder::ComputeFinalCosts(
 }
 
 
-LatticeFasterOnlineDecoder::BestPathIterator LatticeFasterOnlineDecoder::BestPathEnd(
+template <typename FST>
+typename LatticeFasterOnlineDecoderTpl<FST>::BestPathIterator
+LatticeFasterOnlineDecoderTpl<FST>::BestPathEnd(
     bool use_final_probs,
     BaseFloat *final_cost_out) const {
   if (decoding_finalized_ && !use_final_probs)
@@ -683,7 +716,7 @@ LatticeFasterOnlineDecoder::BestPathIterator LatticeFasterOnlineDecoder::BestPat
     if (use_final_probs && !final_costs.empty()) {
       // if we are instructed to use final-probs, and any final tokens were
       // active on final frame, include the final-prob in the cost of the token.
-      unordered_map<Token*, BaseFloat>::const_iterator iter = final_costs.find(tok);
+      typename unordered_map<Token*, BaseFloat>::const_iterator iter = final_costs.find(tok);
       if (iter != final_costs.end()) {
         final_cost = iter->second;
         cost += final_cost;
@@ -708,7 +741,9 @@ LatticeFasterOnlineDecoder::BestPathIterator LatticeFasterOnlineDecoder::BestPat
 }
 
 
-LatticeFasterOnlineDecoder::BestPathIterator LatticeFasterOnlineDecoder::TraceBackBestPath(
+template <typename FST>
+typename LatticeFasterOnlineDecoderTpl<FST>::BestPathIterator
+LatticeFasterOnlineDecoderTpl<FST>::TraceBackBestPath(
     BestPathIterator iter, LatticeArc *oarc) const {
   KALDI_ASSERT(!iter.Done() && oarc != NULL);
   Token *tok = static_cast<Token*>(iter.tok);
@@ -744,8 +779,9 @@ LatticeFasterOnlineDecoder::BestPathIterator LatticeFasterOnlineDecoder::TraceBa
 }
 
 
-void LatticeFasterOnlineDecoder::AdvanceDecoding(DecodableInterface *decodable,
-                                                   int32 max_num_frames) {
+template <typename FST>
+void LatticeFasterOnlineDecoderTpl<FST>::AdvanceDecoding(
+    DecodableInterface *decodable, int32 max_num_frames) {
   KALDI_ASSERT(!active_toks_.empty() && !decoding_finalized_ &&
                "You must call InitDecoding() before AdvanceDecoding");
   int32 num_frames_ready = decodable->NumFramesReady();
@@ -772,7 +808,8 @@ void LatticeFasterOnlineDecoder::AdvanceDecoding(DecodableInterface *decodable,
 // FinalizeDecoding() is a version of PruneActiveTokens that we call
 // (optionally) on the final frame.  Takes into account the final-prob of
 // tokens.  This function used to be called PruneActiveTokensFinal().
-void LatticeFasterOnlineDecoder::FinalizeDecoding() {
+template <typename FST>
+void LatticeFasterOnlineDecoderTpl<FST>::FinalizeDecoding() {
   int32 final_frame_plus_one = NumFramesDecoded();
   int32 num_toks_begin = num_toks_;
   // PruneForwardLinksFinal() prunes final frame (with final-probs), and
@@ -790,8 +827,10 @@ void LatticeFasterOnlineDecoder::FinalizeDecoding() {
 }
 
 /// Gets the weight cutoff.  Also counts the active tokens.
-BaseFloat LatticeFasterOnlineDecoder::GetCutoff(Elem *list_head, size_t *tok_count,
-                                                BaseFloat *adaptive_beam, Elem **best_elem) {
+template <typename FST>
+BaseFloat LatticeFasterOnlineDecoderTpl<FST>::GetCutoff(
+    Elem *list_head, size_t *tok_count,
+    BaseFloat *adaptive_beam, Elem **best_elem) {
   BaseFloat best_weight = std::numeric_limits<BaseFloat>::infinity();
   // positive == high cost == bad.
   size_t count = 0;
@@ -861,7 +900,8 @@ BaseFloat LatticeFasterOnlineDecoder::GetCutoff(Elem *list_head, size_t *tok_cou
 }
 
 
-BaseFloat LatticeFasterOnlineDecoder::ProcessEmitting(
+template <typename FST>
+BaseFloat LatticeFasterOnlineDecoderTpl<FST>::ProcessEmitting(
     DecodableInterface *decodable) {
   KALDI_ASSERT(active_toks_.size() > 0);
   int32 frame = active_toks_.size() - 1; // frame is the frame-index
@@ -891,18 +931,15 @@ BaseFloat LatticeFasterOnlineDecoder::ProcessEmitting(
     StateId state = best_elem->key;
     Token *tok = best_elem->val;
     cost_offset = - tok->tot_cost;
-    for (fst::ArcIterator<fst::Fst<Arc> > aiter(fst_, state);
+    for (EmittingArcIterator<FST> aiter(fst_, state);
          !aiter.Done();
          aiter.Next()) {
-      Arc arc = aiter.Value();
-      if (arc.ilabel != 0) {  // propagate..
-        arc.weight = Times(arc.weight,
-                           Weight(cost_offset -
-                                  decodable->LogLikelihood(frame, arc.ilabel)));
-        BaseFloat new_weight = arc.weight.Value() + tok->tot_cost;
-        if (new_weight + adaptive_beam < next_cutoff)
-          next_cutoff = new_weight + adaptive_beam;
-      }
+      BaseFloat new_weight = (aiter.GraphCost() +
+                              (cost_offset -
+                               decodable->LogLikelihood(frame, aiter.ILabel())))
+          + tok->tot_cost;
+      if (new_weight + adaptive_beam < next_cutoff)
+        next_cutoff = new_weight + adaptive_beam;
     }
   }
 
@@ -920,30 +957,28 @@ BaseFloat LatticeFasterOnlineDecoder::ProcessEmitting(
     StateId state = e->key;
     Token *tok = e->val;
     if (tok->tot_cost <=  cur_cutoff) {
-      for (fst::ArcIterator<fst::Fst<Arc> > aiter(fst_, state);
+      for (EmittingArcIterator<FST> aiter(fst_, state);
            !aiter.Done();
            aiter.Next()) {
-        const Arc &arc = aiter.Value();
-        if (arc.ilabel != 0) {  // propagate..
-          BaseFloat ac_cost = cost_offset -
-              decodable->LogLikelihood(frame, arc.ilabel),
-              graph_cost = arc.weight.Value(),
-              cur_cost = tok->tot_cost,
-              tot_cost = cur_cost + ac_cost + graph_cost;
-          if (tot_cost > next_cutoff) continue;
-          else if (tot_cost + adaptive_beam < next_cutoff)
-            next_cutoff = tot_cost + adaptive_beam; // prune by best current token
-          // Note: the frame indexes into active_toks_ are one-based,
-          // hence the + 1.
-          Token *next_tok = FindOrAddToken(arc.nextstate,
-                                           frame + 1, tot_cost, tok, NULL);
-          // NULL: no change indicator needed
-
-          // Add ForwardLink from tok to next_tok (put on head of list tok->links)
-          tok->links = new ForwardLink(next_tok, arc.ilabel, arc.olabel,
-                                       graph_cost, ac_cost, tok->links);
-        }
-      } // for all arcs
+        Label ilabel = aiter.ILabel();
+        BaseFloat ac_cost = cost_offset -
+            decodable->LogLikelihood(frame, ilabel),
+            graph_cost = aiter.GraphCost(),
+            cur_cost = tok->tot_cost,
+            tot_cost = cur_cost + ac_cost + graph_cost;
+        if (tot_cost > next_cutoff) continue;
+        else if (tot_cost + adaptive_beam < next_cutoff)
+          next_cutoff = tot_cost + adaptive_beam; // prune by best current token
+        // Note: the frame indexes into active_toks_ are one-based,
+        // hence the + 1.
+        Token *next_tok = FindOrAddToken(aiter.NextState(),
+                                         frame + 1, tot_cost, tok, NULL);
+        // NULL: no change indicator needed
+
+        // Add ForwardLink from tok to next_tok (put on head of list tok->links)
+        tok->links = NewForwardLink(next_tok, ilabel, aiter.OLabel(),
+                                    graph_cost, ac_cost, tok->links);
+      } // for all emitting arcs
     }
     e_tail = e->tail;
     toks_.Delete(e); // delete Elem
@@ -951,7 +986,8 @@ BaseFloat LatticeFasterOnlineDecoder::ProcessEmitting(
   return next_cutoff;
 }
 
-void LatticeFasterOnlineDecoder::ProcessNonemitting(BaseFloat cutoff) {
+template <typename FST>
+void LatticeFasterOnlineDecoderTpl<FST>::ProcessNonemitting(BaseFloat cutoff) {
   KALDI_ASSERT(!active_toks_.empty());
   int32 frame = static_cast<int32>(active_toks_.size()) - 2;
   // Note: "frame" is the time-index we just processed, or -1 if
@@ -986,35 +1022,34 @@ void LatticeFasterOnlineDecoder::ProcessNonemitting(BaseFloat cutoff) {
     // because we're about to regenerate them.  This is a kind
     // of non-optimality (remember, this is the simple decoder),
     // but since most states are emitting it's not a huge issue.
-    tok->DeleteForwardLinks(); // necessary when re-visiting
+    DeleteForwardLinks(tok); // necessary when re-visiting
     tok->links = NULL;
-    for (fst::ArcIterator<fst::Fst<Arc> > aiter(fst_, state);
+    for (NonemittingArcIterator<FST> aiter(fst_, state);
          !aiter.Done();
          aiter.Next()) {
-      const Arc &arc = aiter.Value();
-      if (arc.ilabel == 0) {  // propagate nonemitting only...
-        BaseFloat graph_cost = arc.weight.Value(),
-            tot_cost = cur_cost + graph_cost;
-        if (tot_cost < cutoff) {
-          bool changed;
-
-          Token *new_tok = FindOrAddToken(arc.nextstate, frame + 1, tot_cost,
-                                          tok, &changed);
-
-          tok->links = new ForwardLink(new_tok, 0, arc.olabel,
-                                       graph_cost, 0, tok->links);
-
-          // "changed" tells us whether the new token has a different
-          // cost from before, or is new [if so, add into queue].
-          if (changed) queue_.push_back(arc.nextstate);
-        }
+      BaseFloat graph_cost = aiter.GraphCost(),
+          tot_cost = cur_cost + graph_cost;
+      if (tot_cost < cutoff) {
+        bool changed;
+        StateId nextstate = aiter.NextState();
+
+        Token *new_tok = FindOrAddToken(nextstate, frame + 1, tot_cost,
+                                        tok, &changed);
+
+        tok->links = NewForwardLink(new_tok, 0, aiter.OLabel(),
+                                    graph_cost, 0, tok->links);
+
+        // "changed" tells us whether the new token has a different
+        // cost from before, or is new [if so, add into queue].
+        if (changed) queue_.push_back(nextstate);
       }
-    } // for all arcs
+    } // for all nonemitting arcs
   } // while queue not empty
 }
 
 
-void LatticeFasterOnlineDecoder::DeleteElems(Elem *list) {
+template <typename FST>
+void LatticeFasterOnlineDecoderTpl<FST>::DeleteElems(Elem *list) {
   for (Elem *e = list, *e_tail; e != NULL; e = e_tail) {
     // Token::TokenDelete(e->val);
     e_tail = e->tail;
@@ -1022,14 +1057,15 @@ void LatticeFasterOnlineDecoder::DeleteElems(Elem *list) {
   }
 }
 
-void LatticeFasterOnlineDecoder::ClearActiveTokens() { // a cleanup routine, at utt end/begin
+template <typename FST>
+void LatticeFasterOnlineDecoderTpl<FST>::ClearActiveTokens() { // a cleanup routine, at utt end/begin
   for (size_t i = 0; i < active_toks_.size(); i++) {
     // Delete all tokens alive on this frame, and any forward
     // links they may have.
     for (Token *tok = active_toks_[i].toks; tok != NULL; ) {
-      tok->DeleteForwardLinks();
+      DeleteForwardLinks(tok);
       Token *next_tok = tok->next;
-      delete tok;
+      DeleteToken(tok);
       num_toks_--;
       tok = next_tok;
     }
@@ -1039,10 +1075,11 @@ void LatticeFasterOnlineDecoder::ClearActiveTokens() { // a cleanup routine, at
 }
 
 // static
-void LatticeFasterOnlineDecoder::TopSortTokens(Token *tok_list,
-                                               std::vector<Token*> *topsorted_list) {
+template <typename FST>
+void LatticeFasterOnlineDecoderTpl<FST>::TopSortTokens(
+    Token *tok_list, std::vector<Token*> *topsorted_list) {
   unordered_map<Token*, int32> token2pos;
-  typedef unordered_map<Token*, int32>::iterator IterType;
+  typedef typename unordered_map<Token*, int32>::iterator IterType;
   int32 num_toks = 0;
   for (Token *tok = tok_list; tok != NULL; tok = tok->next)
     num_toks++;
@@ -1084,7 +1121,7 @@ void LatticeFasterOnlineDecoder::TopSortTokens(Token *tok_list,
   for (loop_count = 0;
        !reprocess.empty() && loop_count < max_loop; ++loop_count) {
     std::vector<Token*> reprocess_vec;
-    for (unordered_set<Token*>::iterator iter = reprocess.begin();
+    for (typename unordered_set<Token*>::iterator iter = reprocess.begin();
          iter != reprocess.end(); ++iter)
       reprocess_vec.push_back(*iter);
     reprocess.clear();
@@ -1119,4 +1156,11 @@ void LatticeFasterOnlineDecoder::TopSortTokens(Token *tok_list,
 
 
 
+// Instantiate the template for the types of graph we decode with.
+template class LatticeFasterOnlineDecoderTpl<fst::Fst<fst::StdArc> >;
+template class LatticeFasterOnlineDecoderTpl<fst::ConstFst<fst::StdArc> >;
+template class LatticeFasterOnlineDecoderTpl<fst::VectorFst<fst::StdArc> >;
+template class LatticeFasterOnlineDecoderTpl<fst::MappedConstFst<fst::StdArc> >;
+template class LatticeFasterOnlineDecoderTpl<CompactDecodingGraph>;
+
 } // end namespace kaldi.
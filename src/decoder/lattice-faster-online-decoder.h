@@ -28,6 +28,7 @@
 
 #include "util/stl-utils.h"
 #include "util/hash-list.h"
+#include "util/memory-pool.h"
 #include "fst/fstlib.h"
 #include "itf/decodable-itf.h"
 #include "fstext/fstext-lib.h"
@@ -42,14 +43,17 @@ namespace kaldi {
 
 /** LatticeFasterOnlineDecoder is as LatticeFasterDecoder but also supports an
     efficient way to get the best path (see the function BestPathEnd()), which
-    is useful in endpointing.
+    is useful in endpointing.  Like LatticeFasterDecoderTpl, it is templated on
+    the type of the decoding graph; see the instantiations at the end of
+    lattice-faster-online-decoder.cc.
  */
-class LatticeFasterOnlineDecoder {
+template <typename FST>
+class LatticeFasterOnlineDecoderTpl {
  public:
-  typedef fst::StdArc Arc;
-  typedef Arc::Label Label;
-  typedef Arc::StateId StateId;
-  typedef Arc::Weight Weight;
+  typedef typename FST::Arc Arc;
+  typedef typename Arc::Label Label;
+  typedef typename Arc::StateId StateId;
+  typedef typename Arc::Weight Weight;
 
   struct BestPathIterator {
     void *tok;
@@ -64,13 +68,13 @@ class LatticeFasterOnlineDecoder {
   };
 
   // instantiate this class once for each thing you have to decode.
-  LatticeFasterOnlineDecoder(const fst::Fst<fst::StdArc> &fst,
-                             const LatticeFasterDecoderConfig &config);
+  LatticeFasterOnlineDecoderTpl(const FST &fst,
+                                const LatticeFasterDecoderConfig &config);
 
   // This version of the initializer "takes ownership" of the fst,
   // and will delete it when this object is destroyed.
-  LatticeFasterOnlineDecoder(const LatticeFasterDecoderConfig &config,
-                             fst::Fst<fst::StdArc> *fst);
+  LatticeFasterOnlineDecoderTpl(const LatticeFasterDecoderConfig &config,
+                                FST *fst);
 
 
   void SetOptions(const LatticeFasterDecoderConfig &config) {
@@ -81,7 +85,7 @@ class LatticeFasterOnlineDecoder {
     return config_;
   }
 
-  ~LatticeFasterOnlineDecoder();
+  ~LatticeFasterOnlineDecoderTpl();
 
   /// Decodes until there are no more frames left in the "decodable" object..
   /// note, this may block waiting for input if the "decodable" object blocks.
@@ -193,6 +197,10 @@ class LatticeFasterOnlineDecoder {
   // whenever we call ProcessEmitting().
   inline int32 NumFramesDecoded() const { return active_toks_.size() - 1; }
 
+  /// Returns a string describing the usage of the memory pools from which
+  /// Tokens and ForwardLinks are allocated; for diagnostics.
+  std::string AllocatorInfo() const;
+
  private:
   // ForwardLinks are the links from a token to a token on the next frame.
   // or sometimes on the current frame (for input-epsilon links).
@@ -240,15 +248,6 @@ class LatticeFasterOnlineDecoder {
                  Token *next, Token *backpointer):
         tot_cost(tot_cost), extra_cost(extra_cost), links(links), next(next),
         backpointer(backpointer) { }
-    inline void DeleteForwardLinks() {
-      ForwardLink *l = links, *m;
-      while (l != NULL) {
-        m = l->next;
-        delete l;
-        l = m;
-      }
-      links = NULL;
-    }
   };
 
   // head of per-frame list of Tokens (list is in topological order),
@@ -261,10 +260,39 @@ class LatticeFasterOnlineDecoder {
                  must_prune_tokens(true) { }
   };
 
-  typedef HashList<StateId, Token*>::Elem Elem;
+  typedef typename HashList<StateId, Token*>::Elem Elem;
 
   void PossiblyResizeHash(size_t num_toks);
 
+  // Tokens and ForwardLinks are allocated from token_pool_ and link_pool_
+  // rather than with new and delete; these functions wrap that.
+  inline Token *NewToken(BaseFloat tot_cost, BaseFloat extra_cost,
+                         ForwardLink *links, Token *next,
+                         Token *backpointer) {
+    return new (token_pool_.Allocate()) Token(tot_cost, extra_cost,
+                                              links, next, backpointer);
+  }
+  inline void DeleteToken(Token *tok) { token_pool_.Free(tok); }
+  inline ForwardLink *NewForwardLink(Token *next_tok, Label ilabel,
+                                     Label olabel, BaseFloat graph_cost,
+                                     BaseFloat acoustic_cost,
+                                     ForwardLink *next) {
+    return new (link_pool_.Allocate()) ForwardLink(
+        next_tok, ilabel, olabel, graph_cost, acoustic_cost, next);
+  }
+  inline void DeleteForwardLink(ForwardLink *link) { link_pool_.Free(link); }
+
+  // Deletes all the forward links of "tok" and sets tok->links to NULL.
+  inline void DeleteForwardLinks(Token *tok) {
+    ForwardLink *l = tok->links, *m;
+    while (l != NULL) {
+      m = l->next;
+      DeleteForwardLink(l);
+      l = m;
+    }
+    tok->links = NULL;
+  }
+
   // FindOrAddToken either locates a token in hash of toks_, or if necessary
   // inserts a new, empty token (i.e. with no forward links) for the current
   // frame.  [note: it's inserted if necessary into hash toks_ and also into the
@@ -359,7 +387,7 @@ class LatticeFasterOnlineDecoder {
   std::vector<StateId> queue_;  // temp variable used in ProcessNonemitting,
   std::vector<BaseFloat> tmp_array_;  // used in GetCutoff.
   // make it class member to avoid internal new/delete.
-  const fst::Fst<fst::StdArc> &fst_;
+  const FST &fst_;
   bool delete_fst_;
   std::vector<BaseFloat> cost_offsets_;  // This contains, for each
   // frame, an offset that was added to the acoustic log-likelihoods on that
@@ -369,6 +397,11 @@ class LatticeFasterOnlineDecoder {
   int32 num_toks_; // current total #toks allocated...
   bool warned_;
 
+  // Per-decoder memory pools for Tokens and ForwardLinks; the memory is
+  // recycled across frames and across utterances.
+  MemoryPool<Token> token_pool_;
+  MemoryPool<ForwardLink> link_pool_;
+
   /// decoding_finalized_ is true if someone called FinalizeDecoding().  [note,
   /// calling this is optional].  If true, it's forbidden to decode more.  Also,
   /// if this is set, then the output of ComputeFinalCosts() is in the next
@@ -408,9 +441,12 @@ class LatticeFasterOnlineDecoder {
   void ClearActiveTokens();
 
 
-  KALDI_DISALLOW_COPY_AND_ASSIGN(LatticeFasterOnlineDecoder);
+  KALDI_DISALLOW_COPY_AND_ASSIGN(LatticeFasterOnlineDecoderTpl);
 };
 
+typedef LatticeFasterOnlineDecoderTpl<fst::Fst<fst::StdArc> >
+    LatticeFasterOnlineDecoder;
+
 
 
 } // end namespace kaldi.
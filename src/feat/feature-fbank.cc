@@ -24,13 +24,14 @@
 namespace kaldi {
 
 Fbank::Fbank(const FbankOptions &opts)
-    : opts_(opts), feature_window_function_(opts.frame_opts), srfft_(NULL) {
+    : opts_(opts), feature_window_function_(opts.frame_opts),
+      fft_plan_(NULL) {
   if (opts.energy_floor > 0.0)
     log_energy_floor_ = Log(opts.energy_floor);
 
   int32 padded_window_size = opts.frame_opts.PaddedWindowSize();
-  if ((padded_window_size & (padded_window_size-1)) == 0)  // Is a power of two...
-    srfft_ = new SplitRadixRealFft<BaseFloat>(padded_window_size);
+  fft_plan_ = NewRealFftPlan<BaseFloat>(opts.frame_opts.fft_type,
+                                        padded_window_size);
 
   // We'll definitely need the filterbanks info for VTLN warping factor 1.0.
   // [note: this call caches it.]  The reason we call this here is to
@@ -44,7 +45,7 @@ Fbank::~Fbank() {
       ++iter) {
     delete iter->second;
   }
-  delete srfft_;
+  delete fft_plan_;
 }
 
 const MelBanks *Fbank::GetMelBanks(BaseFloat vtln_warp) {
@@ -89,12 +90,13 @@ void Fbank::Compute(const VectorBase<BaseFloat> &wave,
 void Fbank::Compute(const VectorBase<BaseFloat> &wave,
                     BaseFloat vtln_warp,
                     Matrix<BaseFloat> *output,
-                    Vector<BaseFloat> *wave_remainder) const {
+                    Vector<BaseFloat> *wave_remainder,
+                    RandomState *rand_state) const {
   bool must_delete_mel_banks;
   const MelBanks *mel_banks = GetMelBanks(vtln_warp,
                                           &must_delete_mel_banks);
 
-  ComputeInternal(wave, *mel_banks, output, wave_remainder);
+  ComputeInternal(wave, *mel_banks, output, wave_remainder, rand_state);
 
   if (must_delete_mel_banks)
     delete mel_banks;
@@ -104,7 +106,8 @@ void Fbank::Compute(const VectorBase<BaseFloat> &wave,
 void Fbank::ComputeInternal(const VectorBase<BaseFloat> &wave,
                             const MelBanks &mel_banks,
                             Matrix<BaseFloat> *output,
-                            Vector<BaseFloat> *wave_remainder) const {
+                            Vector<BaseFloat> *wave_remainder,
+                            RandomState *rand_state) const {
   KALDI_ASSERT(output != NULL);
 
   // Get dimensions of output features
@@ -123,34 +126,43 @@ void Fbank::ComputeInternal(const VectorBase<BaseFloat> &wave,
   if (wave_remainder != NULL)
     ExtractWaveformRemainder(wave, opts_.frame_opts, wave_remainder);
 
-  // Buffers
-  Vector<BaseFloat> window;  // windowed waveform.
-  Vector<BaseFloat> mel_energies;
-  std::vector<BaseFloat> temp_buffer;  // used by srfft.
-  BaseFloat log_energy;
-
-  // Compute all the freames, r is frame index..
-  for (int32 r = 0; r < rows_out; r++) {
-    // Cut the window, apply window function
-    ExtractWindow(wave, r, opts_.frame_opts, feature_window_function_, &window,
-                  (opts_.use_energy && opts_.raw_energy ? &log_energy : NULL));
+  // Buffers; we process the frames in batches, so that most of the
+  // computation is done by matrix operations.
+  bool raw_log_energy = opts_.use_energy && opts_.raw_energy;
+  Matrix<BaseFloat> windows;  // windowed waveforms, one per row.
+  Matrix<BaseFloat> mel_energies;
+  Vector<BaseFloat> log_energy;
+  std::vector<BaseFloat> temp_buffer;  // used by fft_plan_.
+
+  // Compute the frames in batches starting at first_frame.
+  for (int32 first_frame = 0; first_frame < rows_out;
+       first_frame += kExtractWindowsBatchSize) {
+    int32 num_frames = std::min(kExtractWindowsBatchSize,
+                                rows_out - first_frame);
+    // Cut the windows, apply window function
+    ExtractWindows(wave, first_frame, num_frames, opts_.frame_opts,
+                   feature_window_function_, &windows,
+                   (raw_log_energy ? &log_energy : NULL), rand_state);
 
     // Compute energy after window function (not the raw one)
-    if (opts_.use_energy && !opts_.raw_energy)
-      log_energy = Log(std::max(VecVec(window, window),
-                                std::numeric_limits<BaseFloat>::min()));
+    if (opts_.use_energy && !opts_.raw_energy) {
+      log_energy.Resize(num_frames, kUndefined);
+      log_energy.AddDiagMat2(1.0, windows, kNoTrans, 0.0);
+      log_energy.ApplyFloor(std::numeric_limits<BaseFloat>::min());
+      log_energy.ApplyLog();
+    }
 
-    if (srfft_ != NULL)  // Compute FFT using split-radix algorithm.
-      srfft_->Compute(window.Data(), true, &temp_buffer);
-    else  // An alternative algorithm that works for non-powers-of-two.
-      RealFft(&window, true);
+    // The FFTs of all the frames at once.
+    fft_plan_->ComputeRows(windows.Data(), num_frames, windows.Stride(),
+                           &temp_buffer);
 
-    // Convert the FFT into a power spectrum.
-    ComputePowerSpectrum(&window);
-    SubVector<BaseFloat> power_spectrum(window, 0, window.Dim()/2 + 1);
+    // Convert the FFTs into power spectra.
+    ComputePowerSpectrum(&windows);
+    SubMatrix<BaseFloat> power_spectra(windows, 0, num_frames,
+                                       0, windows.NumCols() / 2 + 1);
 
-    // Sum with MelFiterbank over power spectrum
-    mel_banks.Compute(power_spectrum, &mel_energies);
+    // Sum with MelFiterbank over power spectra
+    mel_banks.Compute(power_spectra, &mel_energies);
     if (opts_.use_log_fbank) {
       // avoid log of zero (which should be prevented anyway by dithering).
       mel_energies.ApplyFloor(std::numeric_limits<BaseFloat>::min());
@@ -158,27 +170,29 @@ void Fbank::ComputeInternal(const VectorBase<BaseFloat> &wave,
     }
 
     // Output buffers
-    SubVector<BaseFloat> this_output(output->Row(r));
-    SubVector<BaseFloat> this_fbank(this_output.Range((opts_.use_energy? 1 : 0),
-                                                      opts_.mel_opts.num_bins));
+    SubMatrix<BaseFloat> this_output(*output, first_frame, num_frames,
+                                     0, cols_out);
+    SubMatrix<BaseFloat> this_fbank(this_output.ColRange(
+        (opts_.use_energy ? 1 : 0), opts_.mel_opts.num_bins));
 
     // Copy to output
-    this_fbank.CopyFromVec(mel_energies);
+    this_fbank.CopyFromMat(mel_energies);
     // Copy energy as first value
     if (opts_.use_energy) {
-      if (opts_.energy_floor > 0.0 && log_energy < log_energy_floor_) {
-        log_energy = log_energy_floor_;
-      }
-      this_output(0) = log_energy;
+      if (opts_.energy_floor > 0.0)
+        log_energy.ApplyFloor(log_energy_floor_);
+      this_output.CopyColFromVec(log_energy, 0);
     }
 
     // HTK compat: Shift features, so energy is last value
     if (opts_.htk_compat && opts_.use_energy) {
-      BaseFloat energy = this_output(0);
-      for (int32 i = 0; i < opts_.mel_opts.num_bins; i++) {
-        this_output(i) = this_output(i+1);
+      for (int32 r = 0; r < num_frames; r++) {
+        SubVector<BaseFloat> output_row(this_output, r);
+        BaseFloat energy = output_row(0);
+        for (int32 i = 0; i < opts_.mel_opts.num_bins; i++)
+          output_row(i) = output_row(i+1);
+        output_row(opts_.mel_opts.num_bins) = energy;
       }
-      this_output(opts_.mel_opts.num_bins) = energy;
     }
   }
 }
@@ -95,17 +95,21 @@ class Fbank {
                Matrix<BaseFloat> *output,
                Vector<BaseFloat> *wave_remainder = NULL);
 
-  /// Const version of Compute()
+  /// Const version of Compute().  If rand_state != NULL, it is used for the
+  /// dithering instead of the global random number generator, e.g. so that
+  /// the output does not depend on what other threads are doing.
   void Compute(const VectorBase<BaseFloat> &wave,
                BaseFloat vtln_warp,
                Matrix<BaseFloat> *output,
-               Vector<BaseFloat> *wave_remainder = NULL) const;
+               Vector<BaseFloat> *wave_remainder = NULL,
+               RandomState *rand_state = NULL) const;
   typedef FbankOptions Options;
  private:
   void ComputeInternal(const VectorBase<BaseFloat> &wave,
                        const MelBanks &mel_banks,
                        Matrix<BaseFloat> *output,
-                       Vector<BaseFloat> *wave_remainder = NULL) const;
+                       Vector<BaseFloat> *wave_remainder = NULL,
+                       RandomState *rand_state = NULL) const;
 
   const MelBanks *GetMelBanks(BaseFloat vtln_warp);
 
@@ -116,7 +120,7 @@ class Fbank {
   BaseFloat log_energy_floor_;
   std::map<BaseFloat, MelBanks*> mel_banks_;  // BaseFloat is VTLN coefficient.
   FeatureWindowFunction feature_window_function_;
-  SplitRadixRealFft<BaseFloat> *srfft_;
+  RealFftPlan<BaseFloat> *fft_plan_;
   KALDI_DISALLOW_COPY_AND_ASSIGN(Fbank);
 };
 
@@ -92,6 +92,85 @@ void UnitTestOnlineCmvn() {
   }
 }
 
+void UnitTestExtractWindows() {
+  for (int32 i = 0; i < 100; i++) {
+    FrameExtractionOptions opts;
+    opts.dither = 0.0;
+    opts.samp_freq = 1000.0 * RandInt(1, 16);
+    opts.frame_shift_ms = RandInt(5, 10);
+    opts.frame_length_ms = RandInt(10, 30);
+    opts.preemph_coeff = (Rand() % 2 == 0 ? 0.0 : 0.97);
+    opts.remove_dc_offset = (Rand() % 2 == 0);
+    opts.snip_edges = (Rand() % 2 == 0);
+    opts.round_to_power_of_two = (Rand() % 2 == 0);
+    const char *window_types[] = { "hamming", "hanning", "povey",
+                                   "rectangular" };
+    opts.window_type = window_types[Rand() % 4];
+    FeatureWindowFunction window_function(opts);
+
+    Vector<BaseFloat> wave(RandInt(opts.WindowSize(), 5 * opts.WindowSize()));
+    wave.SetRandn();
+    int32 num_frames = NumFrames(wave.Dim(), opts);
+    if (num_frames == 0)
+      continue;
+    int32 first_frame = RandInt(0, num_frames - 1),
+        this_num_frames = RandInt(1, num_frames - first_frame);
+
+    Matrix<BaseFloat> windows;
+    Vector<BaseFloat> log_energy;
+    bool want_energy = (Rand() % 2 == 0);
+    ExtractWindows(wave, first_frame, this_num_frames, opts, window_function,
+                   &windows, (want_energy ? &log_energy : NULL));
+    KALDI_ASSERT(windows.NumRows() == this_num_frames &&
+                 windows.NumCols() == opts.PaddedWindowSize());
+    for (int32 r = 0; r < this_num_frames; r++) {
+      Vector<BaseFloat> window;
+      BaseFloat this_log_energy;
+      ExtractWindow(wave, first_frame + r, opts, window_function, &window,
+                    &this_log_energy);
+      KALDI_ASSERT(window.ApproxEqual(windows.Row(r), 1.0e-04));
+      if (want_energy)
+        KALDI_ASSERT(ApproxEqual(this_log_energy, log_energy(r), 1.0e-04));
+    }
+  }
+}
+
+void UnitTestCmvnPrefixSums() {
+  for (int32 i = 0; i < 100; i++) {
+    int32 num_frames = 1 + Rand() % 200, dim = 1 + Rand() % 10;
+    bool compute_sumsq = (Rand() % 2 == 0);
+    int32 history = (Rand() % 2 == 0 ? -1 : 1 + Rand() % 50),
+        checkpoint_interval = 1 + Rand() % 10,
+        num_checkpoints = (Rand() % 2 == 0 ? -1 : 1 + Rand() % 10);
+    CmvnPrefixSums prefix_sums(dim, compute_sumsq, history,
+                               checkpoint_interval, num_checkpoints);
+    Matrix<double> feats(num_frames, dim);
+    feats.SetRandn();
+    for (int32 t = 0; t < num_frames; t++)
+      prefix_sums.AcceptFrame(feats.Row(t));
+    KALDI_ASSERT(prefix_sums.NumFrames() == num_frames);
+    for (int32 j = 0; j < 20; j++) {
+      int32 begin = Rand() % (num_frames + 1),
+          end = begin + Rand() % (num_frames + 1 - begin);
+      begin = prefix_sums.LatestPrefixSum(begin);
+      end = prefix_sums.LatestPrefixSum(end);
+      KALDI_ASSERT(prefix_sums.HasPrefixSum(begin) &&
+                   prefix_sums.HasPrefixSum(end) &&
+                   prefix_sums.HasPrefixSum(0) &&
+                   prefix_sums.HasPrefixSum(num_frames));
+      Matrix<double> stats(2, dim + 1), ref_stats(2, dim + 1);
+      prefix_sums.GetStats(begin, end, &stats);
+      if (end > begin) {
+        SubMatrix<double> part(feats, begin, end - begin, 0, dim);
+        ref_stats.Row(0).Range(0, dim).AddRowSumMat(1.0, part, 0.0);
+        if (compute_sumsq)
+          ref_stats.Row(1).Range(0, dim).AddDiagMat2(1.0, part, kTrans, 0.0);
+      }
+      ref_stats(0, dim) = end - begin;
+      KALDI_ASSERT(stats.ApproxEqual(ref_stats, 1.0e-06));
+    }
+  }
+}
 
 }
 
@@ -101,6 +180,8 @@ int main() {
   using namespace kaldi;
   try {
     UnitTestOnlineCmvn();
+    UnitTestExtractWindows();
+    UnitTestCmvnPrefixSums();
     std::cout << "Tests succeeded.\n";
     return 0;
   } catch (const std::exception &e) {
@@ -48,9 +48,10 @@ int32 NumFrames(int32 nsamp,
 }
 
 
-void Dither(VectorBase<BaseFloat> *waveform, BaseFloat dither_value) {
+void Dither(VectorBase<BaseFloat> *waveform, BaseFloat dither_value,
+            RandomState *state) {
   for (int32 i = 0; i < waveform->Dim(); i++)
-    (*waveform)(i) += RandGauss() * dither_value;
+    (*waveform)(i) += RandGauss(state) * dither_value;
 }
 
 
@@ -84,26 +85,20 @@ FeatureWindowFunction::FeatureWindowFunction(const FrameExtractionOptions &opts)
   }
 }
 
-// ExtractWindow extracts a windowed frame of waveform with a power-of-two,
-// padded size.  It does mean subtraction, pre-emphasis and dithering as
-// requested.
-
-void ExtractWindow(const VectorBase<BaseFloat> &wave,
-                   int32 f,  // with 0 <= f < NumFrames(feats, opts)
-                   const FrameExtractionOptions &opts,
-                   const FeatureWindowFunction &window_function,
-                   Vector<BaseFloat> *window,
-                   BaseFloat *log_energy_pre_window) {
+// Copies the samples of frame f of "wave" to "frame", which must have dimension
+// opts.WindowSize().  If opts.snip_edges is false, the frames may go slightly
+// over the edges of the waveform, and we extend the data by reflection.
+static void ExtractFrameSamples(const VectorBase<BaseFloat> &wave,
+                                int32 f,
+                                const FrameExtractionOptions &opts,
+                                VectorBase<BaseFloat> *frame) {
   int32 frame_shift = opts.WindowShift();
   int32 frame_length = opts.WindowSize();
-  KALDI_ASSERT(window_function.window.Dim() == frame_length);
-  KALDI_ASSERT(frame_shift != 0 && frame_length != 0);
-
-  Vector<BaseFloat> wave_part(frame_length);
+  KALDI_ASSERT(frame->Dim() == frame_length);
   if (opts.snip_edges) {
     int32 start = frame_shift*f, end = start + frame_length;
     KALDI_ASSERT(start >= 0 && end <= wave.Dim());
-    wave_part.CopyFromVec(wave.Range(start, frame_length));
+    frame->CopyFromVec(wave.Range(start, frame_length));
   } else {
     // If opts.snip_edges = false, we allow the frames to go slightly over the
     // edges of the file; we'll extend the data by reflection.
@@ -115,7 +110,7 @@ void ExtractWindow(const VectorBase<BaseFloat> &wave,
         length_limited = end_limited - begin_limited;
 
     // Copy the main part.  Usually this will be the entire window.
-    wave_part.Range(begin_limited - begin, length_limited).
+    frame->Range(begin_limited - begin, length_limited).
         CopyFromVec(wave.Range(begin_limited, length_limited));
     
     // Deal with any end effects by reflection, if needed.  This code will
@@ -125,7 +120,7 @@ void ExtractWindow(const VectorBase<BaseFloat> &wave,
       // The next statement will only have an effect in the case of files
       // shorter than a single frame, it's to avoid a crash in those cases.
       reflected_f = reflected_f % wave.Dim(); 
-      wave_part(f - begin) = wave(reflected_f);
+      (*frame)(f - begin) = wave(reflected_f);
     }
     for (int32 f = wave.Dim(); f < end; f++) {
       int32 distance_to_end = f - wave.Dim();
@@ -133,9 +128,27 @@ void ExtractWindow(const VectorBase<BaseFloat> &wave,
       // shorter than a single frame, it's to avoid a crash in those cases.
       distance_to_end = distance_to_end % wave.Dim();
       int32 reflected_f = wave.Dim() - 1 - distance_to_end;
-      wave_part(f - begin) = wave(reflected_f);
+      (*frame)(f - begin) = wave(reflected_f);
     }
   }
+}
+
+// ExtractWindow extracts a windowed frame of waveform with a power-of-two,
+// padded size.  It does mean subtraction, pre-emphasis and dithering as
+// requested.
+
+void ExtractWindow(const VectorBase<BaseFloat> &wave,
+                   int32 f,  // with 0 <= f < NumFrames(feats, opts)
+                   const FrameExtractionOptions &opts,
+                   const FeatureWindowFunction &window_function,
+                   Vector<BaseFloat> *window,
+                   BaseFloat *log_energy_pre_window,
+                   RandomState *rand_state) {
+  int32 frame_shift = opts.WindowShift();
+  int32 frame_length = opts.WindowSize();
+  KALDI_ASSERT(window_function.window.Dim() == frame_length);
+  KALDI_ASSERT(frame_shift != 0 && frame_length != 0);
+
   KALDI_ASSERT(window != NULL);
   int32 frame_length_padded = opts.PaddedWindowSize();
 
@@ -143,9 +156,9 @@ void ExtractWindow(const VectorBase<BaseFloat> &wave,
     window->Resize(frame_length_padded);
 
   SubVector<BaseFloat> window_part(*window, 0, frame_length);
-  window_part.CopyFromVec(wave_part);
+  ExtractFrameSamples(wave, f, opts, &window_part);
 
-  if (opts.dither != 0.0) Dither(&window_part, opts.dither);
+  if (opts.dither != 0.0) Dither(&window_part, opts.dither, rand_state);
 
   if (opts.remove_dc_offset)
     window_part.Add(-window_part.Sum() / frame_length);
@@ -166,6 +179,69 @@ void ExtractWindow(const VectorBase<BaseFloat> &wave,
                          frame_length_padded-frame_length).SetZero();
 }
 
+void ExtractWindows(const VectorBase<BaseFloat> &wave,
+                    int32 first_frame,
+                    int32 num_frames,
+                    const FrameExtractionOptions &opts,
+                    const FeatureWindowFunction &window_function,
+                    Matrix<BaseFloat> *windows,
+                    Vector<BaseFloat> *log_energy_pre_window,
+                    RandomState *rand_state) {
+  int32 frame_length = opts.WindowSize(),
+      frame_length_padded = opts.PaddedWindowSize();
+  KALDI_ASSERT(window_function.window.Dim() == frame_length);
+  KALDI_ASSERT(first_frame >= 0 && num_frames > 0 && windows != NULL);
+
+  windows->Resize(num_frames, frame_length_padded, kUndefined);
+  if (frame_length != frame_length_padded)
+    windows->ColRange(frame_length,
+                      frame_length_padded - frame_length).SetZero();
+  // "frames" is the part of the windows that contains the samples.
+  SubMatrix<BaseFloat> frames(windows->ColRange(0, frame_length));
+
+  // Copying the samples and dithering have to be done frame by frame; the
+  // rest is done for all the frames at once.
+  for (int32 r = 0; r < num_frames; r++) {
+    SubVector<BaseFloat> frame(frames, r);
+    ExtractFrameSamples(wave, first_frame + r, opts, &frame);
+  }
+  if (opts.dither != 0.0) {
+    // Constructing a RandomState calls Rand(), so we only do it if we need it.
+    RandomState *local_rand_state = NULL;
+    if (rand_state == NULL)
+      rand_state = local_rand_state = new RandomState();
+    for (int32 r = 0; r < num_frames; r++) {
+      SubVector<BaseFloat> frame(frames, r);
+      Dither(&frame, opts.dither, rand_state);
+    }
+    delete local_rand_state;
+  }
+
+  if (opts.remove_dc_offset) {
+    Vector<BaseFloat> sums(num_frames);
+    sums.AddColSumMat(1.0, frames, 0.0);
+    frames.AddVecToCols(-1.0 / frame_length, sums);
+  }
+
+  if (log_energy_pre_window != NULL) {
+    log_energy_pre_window->Resize(num_frames, kUndefined);
+    log_energy_pre_window->AddDiagMat2(1.0, frames, kNoTrans, 0.0);
+    log_energy_pre_window->ApplyFloor(std::numeric_limits<BaseFloat>::min());
+    log_energy_pre_window->ApplyLog();
+  }
+
+  if (opts.preemph_coeff != 0.0 && frame_length > 1) {
+    // The same as Preemphasize() on each row: column i gets
+    // -preemph_coeff times the old column i - 1 added to it.
+    KALDI_ASSERT(opts.preemph_coeff >= 0.0 && opts.preemph_coeff <= 1.0);
+    Matrix<BaseFloat> prev(frames.ColRange(0, frame_length - 1));
+    frames.ColRange(1, frame_length - 1).AddMat(-opts.preemph_coeff, prev);
+    frames.ColRange(0, 1).Scale(1.0 - opts.preemph_coeff);
+  }
+
+  frames.MulColsVec(window_function.window);
+}
+
 void ExtractWaveformRemainder(const VectorBase<BaseFloat> &wave,
                               const FrameExtractionOptions &opts,
                               Vector<BaseFloat> *wave_remainder) {
@@ -206,6 +282,13 @@ void ComputePowerSpectrum(VectorBase<BaseFloat> *waveform) {
   // if the signal has been bandlimited sensibly this should be zero.
 }
 
+void ComputePowerSpectrum(MatrixBase<BaseFloat> *complex_ffts) {
+  for (int32 r = 0; r < complex_ffts->NumRows(); r++) {
+    SubVector<BaseFloat> row(*complex_ffts, r);
+    ComputePowerSpectrum(&row);
+  }
+}
+
 
 DeltaFeatures::DeltaFeatures(const DeltaFeaturesOptions &opts): opts_(opts) {
   KALDI_ASSERT(opts.order >= 0 && opts.order < 1000);  // just make sure we don't get binary junk.
@@ -425,6 +508,108 @@ void ReverseFrames(const MatrixBase<BaseFloat> &input_features,
 }
 
 
+CmvnPrefixSums::CmvnPrefixSums(int32 dim, bool compute_sumsq,
+                               int32 history, int32 checkpoint_interval,
+                               int32 num_checkpoints):
+    dim_(dim), compute_sumsq_(compute_sumsq), history_(history),
+    checkpoint_interval_(checkpoint_interval),
+    num_checkpoints_(num_checkpoints), num_frames_(0),
+    entry_size_(compute_sumsq ? 2 * dim : dim), cur_sums_(entry_size_),
+    zero_sum_(entry_size_) {
+  KALDI_ASSERT(dim > 0 && (history == -1 || history > 0) &&
+               checkpoint_interval > 0 &&
+               (num_checkpoints == -1 || num_checkpoints > 0));
+  if (history_ != -1) {
+    recent_sums_.resize(static_cast<size_t>(history_) * entry_size_);
+    if (num_checkpoints_ != -1)
+      checkpoint_sums_.resize(static_cast<size_t>(num_checkpoints_) *
+                              entry_size_);
+  }
+  StorePrefixSum();
+}
+
+void CmvnPrefixSums::AcceptFrame(const VectorBase<double> &frame) {
+  KALDI_ASSERT(frame.Dim() == dim_);
+  cur_sums_.Range(0, dim_).AddVec(1.0, frame);
+  if (compute_sumsq_)
+    cur_sums_.Range(dim_, dim_).AddVec2(1.0, frame);
+  num_frames_++;
+  StorePrefixSum();
+}
+
+void CmvnPrefixSums::StorePrefixSum() {
+  size_t t = num_frames_;
+  if (history_ == -1) {
+    recent_sums_.resize((t + 1) * entry_size_);
+    std::copy(cur_sums_.Data(), cur_sums_.Data() + entry_size_,
+              recent_sums_.begin() + t * entry_size_);
+  } else {
+    std::copy(cur_sums_.Data(), cur_sums_.Data() + entry_size_,
+              recent_sums_.begin() + (t % history_) * entry_size_);
+    if (t % checkpoint_interval_ == 0) {
+      if (num_checkpoints_ == -1) {
+        checkpoint_sums_.insert(checkpoint_sums_.end(), cur_sums_.Data(),
+                                cur_sums_.Data() + entry_size_);
+      } else {
+        size_t n = (t / checkpoint_interval_) % num_checkpoints_;
+        std::copy(cur_sums_.Data(), cur_sums_.Data() + entry_size_,
+                  checkpoint_sums_.begin() + n * entry_size_);
+      }
+    }
+  }
+}
+
+bool CmvnPrefixSums::HasPrefixSum(int32 t) const {
+  if (t < 0 || t > num_frames_)
+    return false;
+  if (t == 0 || history_ == -1 || t > num_frames_ - history_)
+    return true;
+  if (t % checkpoint_interval_ != 0)
+    return false;
+  // The checkpoint is stored unless it has dropped out of the ring buffer.
+  return (num_checkpoints_ == -1 ||
+          t / checkpoint_interval_ >
+          num_frames_ / checkpoint_interval_ - num_checkpoints_);
+}
+
+int32 CmvnPrefixSums::LatestPrefixSum(int32 t) const {
+  KALDI_ASSERT(t >= 0 && t <= num_frames_);
+  if (HasPrefixSum(t))
+    return t;
+  int32 checkpoint = t - t % checkpoint_interval_;
+  return (HasPrefixSum(checkpoint) ? checkpoint : 0);
+}
+
+const double *CmvnPrefixSums::PrefixSum(int32 t) const {
+  KALDI_ASSERT(HasPrefixSum(t));
+  if (history_ == -1)
+    return &(recent_sums_[static_cast<size_t>(t) * entry_size_]);
+  else if (t > num_frames_ - history_)
+    return &(recent_sums_[static_cast<size_t>(t % history_) * entry_size_]);
+  else if (t == 0)
+    return zero_sum_.Data();
+  int32 n = t / checkpoint_interval_;
+  if (num_checkpoints_ != -1)
+    n %= num_checkpoints_;
+  return &(checkpoint_sums_[static_cast<size_t>(n) * entry_size_]);
+}
+
+void CmvnPrefixSums::GetStats(int32 begin, int32 end,
+                              MatrixBase<double> *stats) const {
+  KALDI_ASSERT(begin <= end && stats->NumRows() == 2 &&
+               stats->NumCols() == dim_ + 1);
+  const double *begin_sums = PrefixSum(begin), *end_sums = PrefixSum(end);
+  double *sum_row = stats->RowData(0), *sumsq_row = stats->RowData(1);
+  for (int32 d = 0; d < dim_; d++)
+    sum_row[d] = end_sums[d] - begin_sums[d];
+  sum_row[dim_] = end - begin;
+  for (int32 d = 0; d < dim_; d++)
+    sumsq_row[d] = (compute_sumsq_ ? end_sums[dim_ + d] - begin_sums[dim_ + d]
+                    : 0.0);
+  sumsq_row[dim_] = 0.0;
+}
+
+
 void SlidingWindowCmnOptions::Check() const {
   KALDI_ASSERT(cmn_window > 0);
   if (center)
@@ -439,8 +624,15 @@ void SlidingWindowCmnInternal(const SlidingWindowCmnOptions &opts,
   opts.Check();
   int32 num_frames = input.NumRows(), dim = input.NumCols();
 
-  int32 last_window_start = -1, last_window_end = -1;
-  Vector<double> cur_sum(dim), cur_sumsq(dim);
+  // The stats of each window are the difference of two prefix sums, so each
+  // frame takes constant time whatever the window size.
+  CmvnPrefixSums prefix_sums(dim, opts.normalize_variance);
+  for (int32 t = 0; t < num_frames; t++)
+    prefix_sums.AcceptFrame(input.Row(t));
+  Matrix<double> stats(2, dim + 1);
+  SubVector<double> cur_sum(stats.RowData(0), dim),
+      cur_sumsq(stats.RowData(1), dim);
+  Vector<double> variance(dim);
 
   for (int32 t = 0; t < num_frames; t++) {
     int32 window_start, window_end; // note: window_end will be one
@@ -465,32 +657,8 @@ void SlidingWindowCmnInternal(const SlidingWindowCmnOptions &opts,
       window_end = num_frames;
       if (window_start < 0) window_start = 0;
     }
-    if (last_window_start == -1) {
-      SubMatrix<double> input_part(input,
-                                      window_start, window_end - window_start,
-                                      0, dim);
-      cur_sum.AddRowSumMat(1.0, input_part , 0.0);
-      if (opts.normalize_variance)
-        cur_sumsq.AddDiagMat2(1.0, input_part, kTrans, 0.0);
-    } else {
-      if (window_start > last_window_start) {
-        KALDI_ASSERT(window_start == last_window_start + 1);
-        SubVector<double> frame_to_remove(input, last_window_start);
-        cur_sum.AddVec(-1.0, frame_to_remove);
-        if (opts.normalize_variance)
-          cur_sumsq.AddVec2(-1.0, frame_to_remove);
-      }
-      if (window_end > last_window_end) {
-        KALDI_ASSERT(window_end == last_window_end + 1);
-        SubVector<double> frame_to_add(input, last_window_end);
-        cur_sum.AddVec(1.0, frame_to_add);
-        if (opts.normalize_variance)
-          cur_sumsq.AddVec2(1.0, frame_to_add);
-      }
-    }
+    prefix_sums.GetStats(window_start, window_end, &stats);
     int32 window_frames = window_end - window_start;
-    last_window_start = window_start;
-    last_window_end = window_end;
 
     KALDI_ASSERT(window_frames > 0);
     SubVector<double> input_frame(input, t),
@@ -502,7 +670,7 @@ void SlidingWindowCmnInternal(const SlidingWindowCmnOptions &opts,
       if (window_frames == 1) {
         output_frame.Set(0.0);
       } else {
-        Vector<double> variance(cur_sumsq);
+        variance.CopyFromVec(cur_sumsq);
         variance.Scale(1.0 / window_frames);
         variance.AddVec2(-1.0 / (window_frames * window_frames), cur_sum);
         // now "variance" is the variance of the features in the window,
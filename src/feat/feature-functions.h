@@ -79,6 +79,7 @@ struct FrameExtractionOptions {
   bool remove_dc_offset;  // Subtract mean of wave before FFT.
   std::string window_type;  // e.g. Hamming window
   bool round_to_power_of_two;
+  std::string fft_type;  // See NewRealFftPlan().
   bool snip_edges;
   // Maybe "hamming", "rectangular", "povey", "hanning"
   // "povey" is a window I made to be similar to Hamming but to go to zero at the
@@ -93,6 +94,7 @@ struct FrameExtractionOptions {
       remove_dc_offset(true),
       window_type("povey"),
       round_to_power_of_two(true),
+      fft_type("default"),
       snip_edges(true){ }
 
   void Register(OptionsItf *opts) {
@@ -110,6 +112,11 @@ struct FrameExtractionOptions {
                    "(\"hamming\"|\"hanning\"|\"povey\"|\"rectangular\")");
     opts->Register("round-to-power-of-two", &round_to_power_of_two,
                    "If true, round window size to power of two.");
+    opts->Register("fft-type", &fft_type, "FFT algorithm "
+                   "(\"split-radix\"|\"mixed-radix\"|\"generic\"|\"default\"); "
+                   "\"default\" uses split-radix for powers of two, else "
+                   "mixed-radix.  \"mixed-radix\" is most useful with "
+                   "--round-to-power-of-two=false.");
     opts->Register("snip-edges", &snip_edges,
                    "If true, end effects will be handled by outputting only frames that "
                    "completely fit in the file, and the number of frames depends on the "
@@ -138,20 +145,49 @@ struct FeatureWindowFunction {
 int32 NumFrames(int32 wave_length,
                 const FrameExtractionOptions &opts);
 
-void Dither(VectorBase<BaseFloat> *waveform, BaseFloat dither_value);
+// Adds Gaussian noise with standard deviation "dither_value" to "waveform".
+// Giving it a RandomState avoids locking the global random number generator
+// for each sample.
+void Dither(VectorBase<BaseFloat> *waveform, BaseFloat dither_value,
+            RandomState *state = NULL);
 
 void Preemphasize(VectorBase<BaseFloat> *waveform, BaseFloat preemph_coeff);
 
 
 // ExtractWindow extracts a windowed frame of waveform with a power-of-two,
 // padded size. If log_energy_pre_window != NULL, outputs the log of the
-// sum-of-squared samples before preemphasis and windowing
+// sum-of-squared samples before preemphasis and windowing.  If rand_state !=
+// NULL, it is used for the dithering instead of the global random number
+// generator.
 void ExtractWindow(const VectorBase<BaseFloat> &wave,
                    int32 f,  // with 0 <= f < NumFrames(wave.Dim(), opts)
                    const FrameExtractionOptions &opts,
                    const FeatureWindowFunction &window_function,
                    Vector<BaseFloat> *window,
-                   BaseFloat *log_energy_pre_window = NULL);
+                   BaseFloat *log_energy_pre_window = NULL,
+                   RandomState *rand_state = NULL);
+
+// The number of frames that the feature extractors (e.g. Mfcc) give to
+// ExtractWindows() at a time: enough for the matrix operations to be efficient,
+// but few enough that the data stays in the cache.
+const int32 kExtractWindowsBatchSize = 64;
+
+// ExtractWindows extracts "num_frames" frames starting from frame
+// "first_frame" into the rows of "windows", which is resized to num_frames by
+// opts.PaddedWindowSize().  The output is the same as from calling
+// ExtractWindow() for each frame, but most of the processing is done for all
+// the frames at once, with matrix operations.  If log_energy_pre_window !=
+// NULL, it is resized to num_frames and outputs the log energies of the frames
+// before preemphasis and windowing.  If rand_state != NULL, it is used for the
+// dithering; otherwise we use a RandomState seeded from the global generator.
+void ExtractWindows(const VectorBase<BaseFloat> &wave,
+                    int32 first_frame,
+                    int32 num_frames,
+                    const FrameExtractionOptions &opts,
+                    const FeatureWindowFunction &window_function,
+                    Matrix<BaseFloat> *windows,
+                    Vector<BaseFloat> *log_energy_pre_window = NULL,
+                    RandomState *rand_state = NULL);
 
 // ExtractWaveformRemainder is useful if the waveform is coming in segments.
 // It extracts the bit of the waveform at the end of this block that you
@@ -172,6 +208,9 @@ void ExtractWaveformRemainder(const VectorBase<BaseFloat> &wave,
 // remaining (n/2) - 1 elements are undefined at output.
 void ComputePowerSpectrum(VectorBase<BaseFloat> *complex_fft);
 
+// This version of ComputePowerSpectrum() converts each row of "complex_ffts".
+void ComputePowerSpectrum(MatrixBase<BaseFloat> *complex_ffts);
+
 
 
 inline void MaxNormalizeEnergy(Matrix<BaseFloat> *feats) {
@@ -336,6 +375,82 @@ struct SlidingWindowCmnOptions {
 };
 
 
+/// CmvnPrefixSums keeps prefix sums of a sequence of feature vectors (and
+/// optionally of their squares), so that the CMVN stats of any range of frames
+/// can be obtained in constant time, whatever order the ranges are asked for
+/// in.  It is used by SlidingWindowCmn() and by class OnlineCmvn.
+///
+/// If "history" is -1, all the prefix sums are kept.  Otherwise only those of
+/// the most recent "history" frames are kept, plus "checkpoints": one every
+/// "checkpoint_interval" frames.  If "num_checkpoints" is -1 all the
+/// checkpoints are kept, so for long streams the memory is a fraction
+/// 1/checkpoint_interval of what storing the features would take; otherwise
+/// only the most recent "num_checkpoints" are kept, so the memory is bounded
+/// however long the stream is.  The prefix sum for t == 0 (which is zero) is
+/// always available.  The caller has to deal with ranges that start or end
+/// further back than the stored prefix sums, e.g. by getting the stats from the
+/// nearest stored prefix sum (see LatestPrefixSum()) and adding or subtracting
+/// the frames in between.
+class CmvnPrefixSums {
+ public:
+  CmvnPrefixSums(int32 dim, bool compute_sumsq, int32 history = -1,
+                 int32 checkpoint_interval = 1, int32 num_checkpoints = -1);
+
+  int32 Dim() const { return dim_; }
+
+  /// Returns the number of frames accepted so far.
+  int32 NumFrames() const { return num_frames_; }
+
+  /// Adds the next frame.
+  void AcceptFrame(const VectorBase<double> &frame);
+
+  /// Returns true if the sum of frames 0 through t - 1 is stored, which is
+  /// always the case for t == 0 and t == NumFrames().
+  bool HasPrefixSum(int32 t) const;
+
+  /// Returns the largest t2 <= t for which HasPrefixSum(t2) is true (which
+  /// may be zero, if the checkpoints before t have been dropped).  Requires
+  /// 0 <= t <= NumFrames().
+  int32 LatestPrefixSum(int32 t) const;
+
+  /// Outputs the CMVN stats of frames begin through end - 1 to "stats", which
+  /// must be of dimension 2 x (Dim() + 1); see ../transform/cmvn.h for the
+  /// format.  The squared stats are zero unless compute_sumsq was true.
+  /// Requires HasPrefixSum(begin) and HasPrefixSum(end).
+  void GetStats(int32 begin, int32 end, MatrixBase<double> *stats) const;
+
+ private:
+  // Returns the stored sums for frames 0 through t - 1 (the sums of squares,
+  // if present, follow the sums).
+  const double *PrefixSum(int32 t) const;
+
+  // Stores cur_sums_ as the prefix sum for t == num_frames_.
+  void StorePrefixSum();
+
+  int32 dim_;
+  bool compute_sumsq_;
+  int32 history_;
+  int32 checkpoint_interval_;
+  int32 num_checkpoints_;
+  int32 num_frames_;
+  // The number of doubles in each prefix sum: dim_, or 2 * dim_ if
+  // compute_sumsq_.
+  int32 entry_size_;
+  // The sums for frames 0 through num_frames_ - 1.
+  Vector<double> cur_sums_;
+  // If history_ == -1, the prefix sum for t is at entry t.  Otherwise this is
+  // a ring buffer of size history_, in which the prefix sum for t is at
+  // entry t % history_.
+  std::vector<double> recent_sums_;
+  // If history_ != -1, the prefix sum for t = n * checkpoint_interval_ is at
+  // entry n, or, if num_checkpoints_ != -1, in a ring buffer of size
+  // num_checkpoints_ at entry n % num_checkpoints_.
+  std::vector<double> checkpoint_sums_;
+  // The prefix sum for t == 0, i.e. zeros.
+  Vector<double> zero_sum_;
+};
+
+
 /// Applies sliding-window cepstral mean and/or variance normalization.  See the
 /// strings registering the options in the options class for information on how
 /// this works and what the options are.  input and output must have the same
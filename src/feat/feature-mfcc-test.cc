@@ -653,8 +653,32 @@ void UnitTestVtln() {
   }
 }
 
+static void UnitTestMelBanksMatrix() {
+  MelBanksOptions mel_opts;
+  FrameExtractionOptions frame_opts;
+  mel_opts.num_bins = RandInt(3, 40);
+  mel_opts.htk_mode = (Rand() % 2 == 0);
+  BaseFloat vtln_warp = (Rand() % 2 == 0 ? 1.0 : 0.9);
+  MelBanks mel_banks(mel_opts, frame_opts, vtln_warp);
+
+  int32 num_frames = RandInt(1, 20),
+      dim = frame_opts.PaddedWindowSize() / 2 + 1;
+  Matrix<BaseFloat> power_spectra(num_frames, dim), mel_energies;
+  power_spectra.SetRandn();
+  power_spectra.ApplyPow(2.0);
+  mel_banks.Compute(power_spectra, &mel_energies);
+  KALDI_ASSERT(mel_energies.NumRows() == num_frames &&
+               mel_energies.NumCols() == mel_opts.num_bins);
+  for (int32 r = 0; r < num_frames; r++) {
+    Vector<BaseFloat> this_mel_energies;
+    mel_banks.Compute(power_spectra.Row(r), &this_mel_energies);
+    KALDI_ASSERT(this_mel_energies.ApproxEqual(mel_energies.Row(r), 1.0e-04));
+  }
+}
+
 static void UnitTestFeat() {
   UnitTestVtln();
+  UnitTestMelBanksMatrix();
   UnitTestReadWave();
   UnitTestSimple();
   UnitTestHTKCompare1();
@@ -24,7 +24,8 @@
 namespace kaldi {
 
 Mfcc::Mfcc(const MfccOptions &opts)
-    : opts_(opts), feature_window_function_(opts.frame_opts), srfft_(NULL) {
+    : opts_(opts), feature_window_function_(opts.frame_opts),
+      fft_plan_(NULL) {
   int32 num_bins = opts.mel_opts.num_bins;
   Matrix<BaseFloat> dct_matrix(num_bins, num_bins);
   ComputeDctMatrix(&dct_matrix);
@@ -42,8 +43,8 @@ Mfcc::Mfcc(const MfccOptions &opts)
     log_energy_floor_ = Log(opts.energy_floor);
 
   int32 padded_window_size = opts.frame_opts.PaddedWindowSize();
-  if ((padded_window_size & (padded_window_size-1)) == 0)  // Is a power of two...
-    srfft_ = new SplitRadixRealFft<BaseFloat>(padded_window_size);
+  fft_plan_ = NewRealFftPlan<BaseFloat>(opts.frame_opts.fft_type,
+                                        padded_window_size);
   
   // We'll definitely need the filterbanks info for VTLN warping factor 1.0.
   // [note: this call caches it.]  The reason we call this here is to
@@ -56,7 +57,7 @@ Mfcc::~Mfcc() {
       iter != mel_banks_.end();
       ++iter)
     delete iter->second;
-  delete srfft_;
+  delete fft_plan_;
 }
 
 const MelBanks *Mfcc::GetMelBanks(BaseFloat vtln_warp) {
@@ -102,12 +103,13 @@ void Mfcc::Compute(const VectorBase<BaseFloat> &wave,
 void Mfcc::Compute(const VectorBase<BaseFloat> &wave,
                    BaseFloat vtln_warp,
                    Matrix<BaseFloat> *output,
-                   Vector<BaseFloat> *wave_remainder) const {
+                   Vector<BaseFloat> *wave_remainder,
+                   RandomState *rand_state) const {
   bool must_delete_mel_banks;
   const MelBanks *mel_banks = GetMelBanks(vtln_warp,
                                                &must_delete_mel_banks);
   
-  ComputeInternal(wave, *mel_banks, output, wave_remainder);
+  ComputeInternal(wave, *mel_banks, output, wave_remainder, rand_state);
   
   if (must_delete_mel_banks)
     delete mel_banks;
@@ -116,7 +118,8 @@ void Mfcc::Compute(const VectorBase<BaseFloat> &wave,
 void Mfcc::ComputeInternal(const VectorBase<BaseFloat> &wave,
                            const MelBanks &mel_banks,
                            Matrix<BaseFloat> *output,
-                           Vector<BaseFloat> *wave_remainder) const {
+                           Vector<BaseFloat> *wave_remainder,
+                           RandomState *rand_state) const {
   KALDI_ASSERT(output != NULL);
   int32 rows_out = NumFrames(wave.Dim(), opts_.frame_opts),
       cols_out = opts_.num_ceps;
@@ -129,56 +132,70 @@ void Mfcc::ComputeInternal(const VectorBase<BaseFloat> &wave,
   output->Resize(rows_out, cols_out);
   if (wave_remainder != NULL)
     ExtractWaveformRemainder(wave, opts_.frame_opts, wave_remainder);
-  Vector<BaseFloat> window;  // windowed waveform.
-  Vector<BaseFloat> mel_energies;
-  std::vector<BaseFloat> temp_buffer;  // used by srfft.
-  for (int32 r = 0; r < rows_out; r++) {  // r is frame index..
-    BaseFloat log_energy;
-    ExtractWindow(wave, r, opts_.frame_opts, feature_window_function_, &window,
-                  (opts_.use_energy && opts_.raw_energy ? &log_energy : NULL));
-
-    if (opts_.use_energy && !opts_.raw_energy)
-      log_energy = Log(std::max(VecVec(window, window),
-                                std::numeric_limits<BaseFloat>::min()));
+  // We process the frames in batches, so that most of the computation is done
+  // by matrix operations.
+  bool raw_log_energy = opts_.use_energy && opts_.raw_energy;
+  Matrix<BaseFloat> windows;  // windowed waveforms, one per row.
+  Matrix<BaseFloat> mel_energies;
+  Vector<BaseFloat> log_energy;
+  std::vector<BaseFloat> temp_buffer;  // used by fft_plan_.
+  for (int32 first_frame = 0; first_frame < rows_out;
+       first_frame += kExtractWindowsBatchSize) {
+    int32 num_frames = std::min(kExtractWindowsBatchSize,
+                                rows_out - first_frame);
+    ExtractWindows(wave, first_frame, num_frames, opts_.frame_opts,
+                   feature_window_function_, &windows,
+                   (raw_log_energy ? &log_energy : NULL), rand_state);
+
+    if (opts_.use_energy && !opts_.raw_energy) {
+      log_energy.Resize(num_frames, kUndefined);
+      log_energy.AddDiagMat2(1.0, windows, kNoTrans, 0.0);
+      log_energy.ApplyFloor(std::numeric_limits<BaseFloat>::min());
+      log_energy.ApplyLog();
+    }
 
-    if (srfft_ != NULL)  // Compute FFT using the split-radix algorithm.
-      srfft_->Compute(window.Data(), true, &temp_buffer);
-    else  // An alternative algorithm that works for non-powers-of-two.
-      RealFft(&window, true);
+    // The FFTs of all the frames at once.
+    fft_plan_->ComputeRows(windows.Data(), num_frames, windows.Stride(),
+                           &temp_buffer);
 
-    // Convert the FFT into a power spectrum.
-    ComputePowerSpectrum(&window);
-    SubVector<BaseFloat> power_spectrum(window, 0, window.Dim()/2 + 1);
+    // Convert the FFTs into power spectra.
+    ComputePowerSpectrum(&windows);
+    SubMatrix<BaseFloat> power_spectra(windows, 0, num_frames,
+                                       0, windows.NumCols() / 2 + 1);
 
-    mel_banks.Compute(power_spectrum, &mel_energies);
+    mel_banks.Compute(power_spectra, &mel_energies);
 
     // avoid log of zero (which should be prevented anyway by dithering).
     mel_energies.ApplyFloor(std::numeric_limits<BaseFloat>::min());
     mel_energies.ApplyLog();  // take the log.
 
-    SubVector<BaseFloat> this_mfcc(output->Row(r));
+    SubMatrix<BaseFloat> this_mfcc(*output, first_frame, num_frames,
+                                   0, cols_out);
 
-    // this_mfcc = dct_matrix_ * mel_energies [which now have log]
-    this_mfcc.AddMatVec(1.0, dct_matrix_, kNoTrans, mel_energies, 0.0);
+    // this_mfcc = mel_energies [which now have log] * dct_matrix_^T
+    this_mfcc.AddMatMat(1.0, mel_energies, kNoTrans, dct_matrix_, kTrans, 0.0);
 
     if (opts_.cepstral_lifter != 0.0)
-      this_mfcc.MulElements(lifter_coeffs_);
+      this_mfcc.MulColsVec(lifter_coeffs_);
 
     if (opts_.use_energy) {
-      if (opts_.energy_floor > 0.0 && log_energy < log_energy_floor_)
-        log_energy = log_energy_floor_;
-      this_mfcc(0) = log_energy;
+      if (opts_.energy_floor > 0.0)
+        log_energy.ApplyFloor(log_energy_floor_);
+      this_mfcc.CopyColFromVec(log_energy, 0);
     }
 
     if (opts_.htk_compat) {
-      BaseFloat energy = this_mfcc(0);
-      for (int32 i = 0; i < opts_.num_ceps-1; i++)
-        this_mfcc(i) = this_mfcc(i+1);
-      if (!opts_.use_energy)
-        energy *= M_SQRT2;  // scale on C0 (actually removing scale
-      // we previously added that's part of one common definition of
-      // cosine transform.)
-      this_mfcc(opts_.num_ceps-1)  = energy;
+      for (int32 r = 0; r < num_frames; r++) {
+        SubVector<BaseFloat> mfcc_row(this_mfcc, r);
+        BaseFloat energy = mfcc_row(0);
+        for (int32 i = 0; i < opts_.num_ceps-1; i++)
+          mfcc_row(i) = mfcc_row(i+1);
+        if (!opts_.use_energy)
+          energy *= M_SQRT2;  // scale on C0 (actually removing scale
+        // we previously added that's part of one common definition of
+        // cosine transform.)
+        mfcc_row(opts_.num_ceps-1)  = energy;
+      }
     }
   }
 }
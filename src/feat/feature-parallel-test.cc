@@ -0,0 +1,160 @@
+// feat/feature-parallel-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <sstream>
+
+#include "feat/feature-parallel.h"
+#include "feat/feature-mfcc.h"
+#include "thread/kaldi-task-sequence.h"
+
+namespace kaldi {
+
+// Stores the output it is given, in order.
+class TestFeatureOutput: public FeatureTaskOutput {
+ public:
+  virtual void Output(const std::string &utt, Matrix<BaseFloat> *features) {
+    utts.push_back(utt);
+    feats.push_back(Matrix<BaseFloat>());
+    feats.back().Swap(features);
+  }
+  virtual void Failed(const std::string &utt) {
+    utts.push_back(utt);
+    feats.push_back(Matrix<BaseFloat>());
+    failed.push_back(utt);
+  }
+  std::vector<std::string> utts;
+  std::vector<Matrix<BaseFloat> > feats;
+  std::vector<std::string> failed;
+};
+
+// Computes MFCCs, but fails for very short waveforms.
+class TestFeatureComputer {
+ public:
+  explicit TestFeatureComputer(const Mfcc &mfcc): mfcc_(mfcc) { }
+  void Compute(const VectorBase<BaseFloat> &wave, BaseFloat vtln_warp,
+               Matrix<BaseFloat> *output, Vector<BaseFloat> *wave_remainder,
+               RandomState *rand_state) const {
+    if (wave.Dim() < 100)
+      KALDI_ERR << "Waveform too short.";
+    mfcc_.Compute(wave, vtln_warp, output, wave_remainder, rand_state);
+  }
+ private:
+  const Mfcc &mfcc_;
+};
+
+static void UnitTestFeatureComputationTask() {
+  MfccOptions opts;
+  opts.frame_opts.dither = (RandInt(0, 1) == 0 ? 0.0 : 1.0);
+  Mfcc mfcc(opts);
+  TestFeatureComputer computer(mfcc);
+
+  int32 num_utts = RandInt(1, 30);
+  std::vector<std::string> utts(num_utts);
+  std::vector<Vector<BaseFloat> > waves(num_utts);
+  std::vector<BaseFloat> warps(num_utts);
+  for (int32 i = 0; i < num_utts; i++) {
+    std::ostringstream os;
+    os << "utt" << i;
+    utts[i] = os.str();
+    waves[i].Resize(RandInt(0, 1) == 0 ? RandInt(0, 150) : RandInt(0, 20000));
+    waves[i].SetRandn();
+    waves[i].Scale(1000.0);
+    warps[i] = (RandInt(0, 1) == 0 ? 1.0 : 0.9 + 0.01 * RandInt(0, 20));
+  }
+
+  TaskSequencerConfig config;
+  config.num_threads = RandInt(1, 4);
+  if (RandInt(0, 1) == 0)
+    config.num_threads_total = config.num_threads + RandInt(0, 2);
+  config.use_thread_pool = (RandInt(0, 1) == 0);
+  TestFeatureOutput output;
+  {
+    TaskSequencer<FeatureComputationTask<TestFeatureComputer> > sequencer(
+        config);
+    for (int32 i = 0; i < num_utts; i++)
+      sequencer.Run(new FeatureComputationTask<TestFeatureComputer>(
+          computer, utts[i], waves[i], warps[i], &output));
+  }
+
+  // The output should be in the same order as the input, and the same as if
+  // we had computed the features in this thread, including the dither, which
+  // is seeded from the utterance-id.
+  KALDI_ASSERT(output.utts == utts);
+  int32 num_failed = 0;
+  for (int32 i = 0; i < num_utts; i++) {
+    if (waves[i].Dim() < 100) {
+      KALDI_ASSERT(output.failed[num_failed++] == utts[i]);
+    } else {
+      Matrix<BaseFloat> feats;
+      RandomState rand_state;
+      rand_state.seed = static_cast<unsigned>(StringHasher()(utts[i]));
+      mfcc.Compute(waves[i], warps[i], &feats, NULL, &rand_state);
+      KALDI_ASSERT(feats.NumRows() == output.feats[i].NumRows() &&
+                   feats.NumCols() == output.feats[i].NumCols() &&
+                   feats.ApproxEqual(output.feats[i], 1.0e-06));
+    }
+  }
+  KALDI_ASSERT(num_failed == static_cast<int32>(output.failed.size()));
+}
+
+static void UnitTestFeatureArchiveOutput() {
+  bool subtract_mean = (RandInt(0, 1) == 0);
+  Matrix<BaseFloat> feats1(RandInt(1, 10), RandInt(1, 10)),
+      feats2(0, 0);
+  feats1.SetRandn();
+  {
+    FeatureArchiveOutput output("ark:tmpf", "kaldi", subtract_mean, 0);
+    Matrix<BaseFloat> copy(feats1);
+    output.Output("utt1", &copy);
+    output.Failed("utt2");
+    output.Output("utt3", &feats2);
+    KALDI_ASSERT(output.NumSuccess() == 2 && output.NumFail() == 1);
+  }
+  SequentialBaseFloatMatrixReader reader("ark:tmpf");
+  KALDI_ASSERT(!reader.Done() && reader.Key() == "utt1");
+  Matrix<BaseFloat> feats(reader.Value());
+  KALDI_ASSERT(feats.NumRows() == feats1.NumRows());
+  if (subtract_mean) {
+    Vector<BaseFloat> mean(feats.NumCols());
+    mean.AddRowSumMat(1.0, feats);
+    KALDI_ASSERT(mean.Norm(2.0) < 1.0e-04 * feats.NumRows());
+    feats1.AddMat(-1.0, feats);
+    // The difference should be the same in each row.
+    for (int32 i = 1; i < feats1.NumRows(); i++)
+      KALDI_ASSERT(feats1.Row(i).ApproxEqual(feats1.Row(0), 1.0e-04));
+  } else {
+    KALDI_ASSERT(feats.ApproxEqual(feats1));
+  }
+  reader.Next();
+  KALDI_ASSERT(!reader.Done() && reader.Key() == "utt3" &&
+               reader.Value().NumRows() == 0);
+  reader.Next();
+  KALDI_ASSERT(reader.Done());
+  unlink("tmpf");
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 10; i++) {
+    UnitTestFeatureComputationTask();
+    UnitTestFeatureArchiveOutput();
+  }
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
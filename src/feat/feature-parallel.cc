@@ -0,0 +1,77 @@
+// feat/feature-parallel.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "feat/feature-parallel.h"
+
+namespace kaldi {
+
+FeatureArchiveOutput::FeatureArchiveOutput(
+    const std::string &output_wspecifier,
+    const std::string &output_format,
+    bool subtract_mean,
+    uint16 htk_parameter_kind):
+    htk_format_(false), subtract_mean_(subtract_mean),
+    htk_parameter_kind_(htk_parameter_kind),
+    num_success_(0), num_fail_(0) {
+  if (output_format == "kaldi") {
+    if (!kaldi_writer_.Open(output_wspecifier))
+      KALDI_ERR << "Could not initialize output with wspecifier "
+                << output_wspecifier;
+  } else if (output_format == "htk") {
+    htk_format_ = true;
+    if (!htk_writer_.Open(output_wspecifier))
+      KALDI_ERR << "Could not initialize output with wspecifier "
+                << output_wspecifier;
+  } else {
+    KALDI_ERR << "Invalid output_format string " << output_format;
+  }
+}
+
+void FeatureArchiveOutput::Output(const std::string &utt,
+                                  Matrix<BaseFloat> *features) {
+  if (subtract_mean_ && features->NumRows() != 0) {
+    Vector<BaseFloat> mean(features->NumCols());
+    mean.AddRowSumMat(1.0, *features);
+    mean.Scale(1.0 / features->NumRows());
+    features->AddVecToRows(-1.0, mean);
+  }
+  if (!htk_format_) {
+    kaldi_writer_.Write(utt, *features);
+  } else {
+    std::pair<Matrix<BaseFloat>, HtkHeader> p;
+    p.first.Swap(features);
+    HtkHeader header = {
+      p.first.NumRows(),
+      100000,  // 10ms shift
+      static_cast<int16>(sizeof(float) * p.first.NumCols()),
+      htk_parameter_kind_
+    };
+    p.second = header;
+    htk_writer_.Write(utt, p);
+  }
+  num_success_++;
+  if ((num_success_ + num_fail_) % 10 == 0)
+    KALDI_LOG << "Processed " << (num_success_ + num_fail_) << " utterances";
+  KALDI_VLOG(2) << "Processed features for key " << utt;
+}
+
+void FeatureArchiveOutput::Failed(const std::string &utt) {
+  KALDI_WARN << "Failed to compute features for utterance " << utt;
+  num_fail_++;
+}
+
+}  // namespace kaldi
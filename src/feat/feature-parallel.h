@@ -0,0 +1,152 @@
+// feat/feature-parallel.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_FEAT_FEATURE_PARALLEL_H_
+#define KALDI_FEAT_FEATURE_PARALLEL_H_
+
+#include <string>
+
+#include "matrix/kaldi-matrix.h"
+#include "util/common-utils.h"
+#include "util/stl-utils.h"  // for StringHasher.
+
+namespace kaldi {
+/// @addtogroup  feat FeatureExtraction
+/// @{
+
+/// This file contains the code shared by the programs like compute-mfcc-feats
+/// that compute features for a sequence of utterances, so that they can
+/// compute them in several threads using the class TaskSequencer (see
+/// thread/kaldi-task-sequence.h): the program reads the waveforms in the main
+/// thread, the features are computed in FeatureComputationTask::operator (),
+/// and they are written in its destructor, which TaskSequencer calls in the
+/// same order as the utterances were read.
+
+
+/// FeatureTaskOutput is the interface to what happens to the features after
+/// they have been computed by FeatureComputationTask.  Its functions are called
+/// in the order of the utterances, and never at the same time, but they may be
+/// called from any thread.
+class FeatureTaskOutput {
+ public:
+  /// Called with the features of utterance "utt"; it may change "features",
+  /// e.g. by swapping them.
+  virtual void Output(const std::string &utt,
+                      Matrix<BaseFloat> *features) = 0;
+
+  /// Called instead of Output() if the features could not be computed; it
+  /// should print any warning.
+  virtual void Failed(const std::string &utt) { }
+
+  virtual ~FeatureTaskOutput() { }
+};
+
+
+/// This class computes the features of one utterance, for use with class
+/// TaskSequencer.  F may be Mfcc, Fbank, Plp, or any class that has a
+/// thread-safe function
+/// \code
+///   void Compute(const VectorBase<BaseFloat> &wave, BaseFloat vtln_warp,
+///                Matrix<BaseFloat> *output, Vector<BaseFloat> *wave_remainder,
+///                RandomState *rand_state) const;
+/// \endcode
+/// which will be called with wave_remainder == NULL.  The computation happens
+/// in operator (), and the output, to "output", happens in the destructor.
+/// The dither (if any) uses a random seed worked out from the utterance-id, so
+/// the features do not depend on the number of threads or on the order in
+/// which the tasks run.
+template<class F>
+class FeatureComputationTask {
+ public:
+  /// Makes a copy of "waveform" (which will usually be one channel of the wave
+  /// data that the table reader owns).
+  FeatureComputationTask(const F &computer,
+                         const std::string &utt,
+                         const VectorBase<BaseFloat> &waveform,
+                         BaseFloat vtln_warp,
+                         FeatureTaskOutput *output):
+      computer_(computer), utt_(utt), waveform_(waveform),
+      vtln_warp_(vtln_warp), output_(output), succeeded_(false) {
+    rand_state_.seed = static_cast<unsigned>(StringHasher()(utt));
+  }
+
+  void operator () () {
+    try {
+      computer_.Compute(waveform_, vtln_warp_, &features_, NULL, &rand_state_);
+      succeeded_ = true;
+    } catch (...) {
+      // output_->Failed() will be called in the destructor.
+    }
+    waveform_.Resize(0);  // Free memory while waiting to be output.
+  }
+
+  ~FeatureComputationTask() {
+    if (succeeded_)
+      output_->Output(utt_, &features_);
+    else
+      output_->Failed(utt_);
+  }
+ private:
+  const F &computer_;
+  std::string utt_;
+  Vector<BaseFloat> waveform_;
+  BaseFloat vtln_warp_;
+  RandomState rand_state_;  // Used for the dither.
+  FeatureTaskOutput *output_;
+  Matrix<BaseFloat> features_;
+  bool succeeded_;
+};
+
+
+/// This class writes the features for compute-mfcc-feats and similar programs:
+/// it optionally subtracts the mean of each utterance, and writes the features
+/// either in Kaldi format or in HTK format.
+class FeatureArchiveOutput: public FeatureTaskOutput {
+ public:
+  /// "output_format" is "kaldi" or "htk"; "htk_parameter_kind" is the
+  /// parameter kind (e.g. 006 | 020000 for MFCC with C0) for the HTK header.
+  FeatureArchiveOutput(const std::string &output_wspecifier,
+                       const std::string &output_format,
+                       bool subtract_mean,
+                       uint16 htk_parameter_kind);
+
+  virtual void Output(const std::string &utt, Matrix<BaseFloat> *features);
+
+  virtual void Failed(const std::string &utt);
+
+  /// Number of utterances that Output() has been called for.
+  int32 NumSuccess() const { return num_success_; }
+
+  /// Number of utterances that Failed() has been called for.
+  int32 NumFail() const { return num_fail_; }
+ private:
+  BaseFloatMatrixWriter kaldi_writer_;
+  TableWriter<HtkMatrixHolder> htk_writer_;
+  bool htk_format_;
+  bool subtract_mean_;
+  uint16 htk_parameter_kind_;
+  int32 num_success_;
+  int32 num_fail_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(FeatureArchiveOutput);
+};
+
+
+/// @} End of "addtogroup feat"
+}  // namespace kaldi
+
+
+#endif  // KALDI_FEAT_FEATURE_PARALLEL_H_
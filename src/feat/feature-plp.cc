@@ -25,7 +25,8 @@
 namespace kaldi {
 
 Plp::Plp(const PlpOptions &opts)
-    : opts_(opts), feature_window_function_(opts.frame_opts), srfft_(NULL) {
+    : opts_(opts), feature_window_function_(opts.frame_opts),
+      fft_plan_(NULL) {
   if (opts.cepstral_lifter != 0.0) {
     lifter_coeffs_.Resize(opts.num_ceps);
     ComputeLifterCoeffs(opts.cepstral_lifter, &lifter_coeffs_);
@@ -37,8 +38,8 @@ Plp::Plp(const PlpOptions &opts)
     log_energy_floor_ = Log(opts.energy_floor);
 
   int32 padded_window_size = opts.frame_opts.PaddedWindowSize();
-  if ((padded_window_size & (padded_window_size-1)) == 0)  // Is a power of two...
-    srfft_ = new SplitRadixRealFft<BaseFloat>(padded_window_size);
+  fft_plan_ = NewRealFftPlan<BaseFloat>(opts.frame_opts.fft_type,
+                                        padded_window_size);
 
   // We'll definitely need the filterbanks info for VTLN warping factor 1.0.
   // [note: this call caches it.]  The reason we call this here is to
@@ -58,7 +59,7 @@ Plp::~Plp() {
       ++iter)
     delete iter->second;
 
-   delete srfft_;
+   delete fft_plan_;
 }
 
 const MelBanks *Plp::GetMelBanks(BaseFloat vtln_warp) {
@@ -139,7 +140,8 @@ void Plp::Compute(const VectorBase<BaseFloat> &wave,
 void Plp::Compute(const VectorBase<BaseFloat> &wave,
                    BaseFloat vtln_warp,
                    Matrix<BaseFloat> *output,
-                   Vector<BaseFloat> *wave_remainder) const {
+                   Vector<BaseFloat> *wave_remainder,
+                   RandomState *rand_state) const {
   bool must_delete_mel_banks, must_delete_equal_loudness;
   const MelBanks *mel_banks = GetMelBanks(vtln_warp,
                                                &must_delete_mel_banks);
@@ -148,7 +150,7 @@ void Plp::Compute(const VectorBase<BaseFloat> &wave,
                          &must_delete_equal_loudness);
 
   ComputeInternal(wave, *mel_banks, *equal_loudness,
-                  output, wave_remainder);
+                  output, wave_remainder, rand_state);
 
   if (must_delete_mel_banks)
     delete mel_banks;
@@ -161,7 +163,8 @@ void Plp::ComputeInternal(const VectorBase<BaseFloat> &wave,
                           const MelBanks &mel_banks,
                           const Vector<BaseFloat> &equal_loudness,
                           Matrix<BaseFloat> *output,
-                          Vector<BaseFloat> *wave_remainder) const {
+                          Vector<BaseFloat> *wave_remainder,
+                          RandomState *rand_state) const {
   KALDI_ASSERT(output != NULL);
   int32 rows_out = NumFrames(wave.Dim(), opts_.frame_opts),
       cols_out = opts_.num_ceps;
@@ -183,23 +186,21 @@ void Plp::ComputeInternal(const VectorBase<BaseFloat> &wave,
   Vector<BaseFloat> raw_cepstrum(opts_.lpc_order);  // not including C0,
   // and size may differ from final size.
   Vector<BaseFloat> final_cepstrum(opts_.num_ceps);
-  std::vector<BaseFloat> temp_buffer;  // used by srfft.
+  std::vector<BaseFloat> temp_buffer;  // used by fft_plan_.
   
   KALDI_ASSERT(opts_.num_ceps <= opts_.lpc_order+1);  // our num-ceps includes C0.
   for (int32 r = 0; r < rows_out; r++) {  // r is frame index..
     BaseFloat log_energy;
     ExtractWindow(wave, r, opts_.frame_opts,
                   feature_window_function_, &window,
-                  (opts_.use_energy && opts_.raw_energy ? &log_energy : NULL));
+                  (opts_.use_energy && opts_.raw_energy ? &log_energy : NULL),
+                  rand_state);
 
     if (opts_.use_energy && !opts_.raw_energy)
       log_energy = Log(std::max(VecVec(window, window),
                                 std::numeric_limits<BaseFloat>::min()));
 
-    if (srfft_ != NULL)  // Compute FFT using split-radix algorithm.
-      srfft_->Compute(window.Data(), true, &temp_buffer);
-    else  // An alternative algorithm that works for non-powers-of-two.
-      RealFft(&window, true);
+    fft_plan_->Compute(window.Data(), true, &temp_buffer);
 
     // Convert the FFT into a power spectrum.
     ComputePowerSpectrum(&window);  // elements 0 ... window.Dim()/2
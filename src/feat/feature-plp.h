@@ -115,17 +115,21 @@ class Plp {
                Vector<BaseFloat> *wave_remainder = NULL);
 
   typedef PlpOptions Options;
-  /// Const version of Compute()
+  /// Const version of Compute().  If rand_state != NULL, it is used for the
+  /// dithering instead of the global random number generator, e.g. so that
+  /// the output does not depend on what other threads are doing.
   void Compute(const VectorBase<BaseFloat> &wave,
                BaseFloat vtln_warp,
                Matrix<BaseFloat> *output,
-               Vector<BaseFloat> *wave_remainder = NULL) const;
+               Vector<BaseFloat> *wave_remainder = NULL,
+               RandomState *rand_state = NULL) const;
  private:
   void ComputeInternal(const VectorBase<BaseFloat> &wave,
                        const MelBanks &mel_banks,
                        const Vector<BaseFloat> &equal_loudness,
                        Matrix<BaseFloat> *output,
-                       Vector<BaseFloat> *wave_remainder = NULL) const;
+                       Vector<BaseFloat> *wave_remainder = NULL,
+                       RandomState *rand_state = NULL) const;
 
   const MelBanks *GetMelBanks(BaseFloat vtln_warp);
 
@@ -144,7 +148,7 @@ class Plp {
   std::map<BaseFloat, MelBanks*> mel_banks_;  // BaseFloat is VTLN coefficient.
   std::map<BaseFloat, Vector<BaseFloat>* > equal_loudness_;
   FeatureWindowFunction feature_window_function_;
-  SplitRadixRealFft<BaseFloat> *srfft_;
+  RealFftPlan<BaseFloat> *fft_plan_;
   KALDI_DISALLOW_COPY_AND_ASSIGN(Plp);
 };
 
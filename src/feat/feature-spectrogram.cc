@@ -25,17 +25,18 @@
 namespace kaldi {
 
 Spectrogram::Spectrogram(const SpectrogramOptions &opts)
-    : opts_(opts), feature_window_function_(opts.frame_opts), srfft_(NULL) {
+    : opts_(opts), feature_window_function_(opts.frame_opts),
+      fft_plan_(NULL) {
   if (opts.energy_floor > 0.0)
     log_energy_floor_ = Log(opts.energy_floor);
 
   int32 padded_window_size = opts.frame_opts.PaddedWindowSize();
-  if ((padded_window_size & (padded_window_size-1)) == 0)  // Is a power of two
-    srfft_ = new SplitRadixRealFft<BaseFloat>(padded_window_size);
+  fft_plan_ = NewRealFftPlan<BaseFloat>(opts.frame_opts.fft_type,
+                                        padded_window_size);
 }
 
 Spectrogram::~Spectrogram() {
-  delete srfft_;
+  delete fft_plan_;
 }
 
 void Spectrogram::Compute(const VectorBase<BaseFloat> &wave,
@@ -58,6 +59,7 @@ void Spectrogram::Compute(const VectorBase<BaseFloat> &wave,
   // Buffers
   Vector<BaseFloat> window;  // windowed waveform.
   BaseFloat log_energy;
+  std::vector<BaseFloat> temp_buffer;  // used by fft_plan_.
 
   // Compute all the freames, r is frame index..
   for (int32 r = 0; r < rows_out; r++) {
@@ -70,10 +72,7 @@ void Spectrogram::Compute(const VectorBase<BaseFloat> &wave,
       log_energy = Log(std::max(VecVec(window, window),
                                 std::numeric_limits<BaseFloat>::min()));
     
-    if (srfft_ != NULL)  // Compute FFT using split-radix algorithm.
-      srfft_->Compute(window.Data(), true);
-    else  // An alternative algorithm that works for non-powers-of-two
-      RealFft(&window, true);
+    fft_plan_->Compute(window.Data(), true, &temp_buffer);
 
     // Convert the FFT into a power spectrum.
     ComputePowerSpectrum(&window);
@@ -69,7 +69,7 @@ class Spectrogram {
   SpectrogramOptions opts_;
   BaseFloat log_energy_floor_;
   FeatureWindowFunction feature_window_function_;
-  SplitRadixRealFft<BaseFloat> *srfft_;
+  RealFftPlan<BaseFloat> *fft_plan_;
   KALDI_DISALLOW_COPY_AND_ASSIGN(Spectrogram);
 };
 
@@ -133,6 +133,11 @@ MelBanks::MelBanks(const MelBanksOptions &opts,
       bins_[bin].second(0) = 0.0;
     
   }
+  bins_matrix_.Resize(num_bins, num_fft_bins);
+  for (int32 bin = 0; bin < num_bins; bin++)
+    bins_matrix_.Row(bin).Range(bins_[bin].first,
+                                bins_[bin].second.Dim()).CopyFromVec(
+                                    bins_[bin].second);
   if (debug_) {
     for (size_t i = 0; i < bins_.size(); i++) {
       KALDI_LOG << "bin " << i << ", offset = " << bins_[i].first
@@ -245,6 +250,31 @@ void MelBanks::Compute(const VectorBase<BaseFloat> &power_spectrum,
   }
 }
 
+void MelBanks::Compute(const MatrixBase<BaseFloat> &power_spectra,
+                       Matrix<BaseFloat> *mel_energies_out) const {
+  int32 num_bins = bins_.size(), num_fft_bins = bins_matrix_.NumCols();
+  KALDI_ASSERT(power_spectra.NumCols() >= num_fft_bins);
+  mel_energies_out->Resize(power_spectra.NumRows(), num_bins, kUndefined);
+  // The bins do not include the Nyquist frequency, so we only use the first
+  // num_fft_bins columns.
+  mel_energies_out->AddMatMat(1.0, power_spectra.ColRange(0, num_fft_bins),
+                              kNoTrans, bins_matrix_, kTrans, 0.0);
+  // HTK-like flooring- for testing purposes (we prefer dither)
+  if (htk_mode_)
+    mel_energies_out->ApplyFloor(1.0);
+  // See the comment about OpenBlas in the other version of Compute().
+  KALDI_ASSERT(!KALDI_ISNAN(mel_energies_out->Sum()));
+
+  if (debug_) {
+    fprintf(stderr, "MEL BANKS:\n");
+    for (int32 r = 0; r < mel_energies_out->NumRows(); r++) {
+      for (int32 i = 0; i < num_bins; i++)
+        fprintf(stderr, " %f", (*mel_energies_out)(r, i));
+      fprintf(stderr, "\n");
+    }
+  }
+}
+
 void ComputeLifterCoeffs(BaseFloat Q, VectorBase<BaseFloat> *coeffs) {
   // Compute liftering coefficients (scaling on cepstral coeffs)
   // coeffs are numbered slightly differently from HTK: the zeroth
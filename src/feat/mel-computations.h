@@ -76,6 +76,13 @@ class MelBanks {
   void Compute(const VectorBase<BaseFloat> &fft_energies,
                Vector<BaseFloat> *mel_energies_out) const;
 
+  /// Compute Mel energies for many frames at once, as a single matrix
+  /// multiplication.  The rows of "power_spectra" are the FFT energies of the
+  /// frames; "mel_energies_out" is resized to the number of frames by
+  /// NumBins().
+  void Compute(const MatrixBase<BaseFloat> &power_spectra,
+               Matrix<BaseFloat> *mel_energies_out) const;
+
   int32 NumBins() const { return bins_.size(); }
 
   // returns vector of central freq of each bin; needed by plp code.
@@ -90,6 +97,10 @@ class MelBanks {
   // (the first nonzero fft-bin), (the vector of weights).
   std::vector<std::pair<int32, Vector<BaseFloat> > > bins_;
 
+  // The same weights as in "bins_", as a matrix of dimension NumBins() by the
+  // number of FFT bins; used when computing many frames at once.
+  Matrix<BaseFloat> bins_matrix_;
+
   bool debug_;
   bool htk_mode_;
   KALDI_DISALLOW_COPY_AND_ASSIGN(MelBanks);
@@ -384,6 +384,84 @@ void TestOnlineAppendFeature() {
   }
 }
 
+// Checks that GetFrames() gives the same result as calling GetFrame() for
+// each frame, for a range of consecutive frames and for frames in random
+// order with repeats.
+void CheckGetFrames(OnlineFeatureInterface *a) {
+  int32 num_frames = a->NumFramesReady(), dim = a->Dim();
+  KALDI_ASSERT(num_frames > 0);
+  for (int32 n = 0; n < 2; n++) {
+    std::vector<int32> frames;
+    if (n == 0) {
+      int32 begin = rand() % num_frames,
+          end = begin + 1 + rand() % (num_frames - begin);
+      for (int32 t = begin; t < end; t++)
+        frames.push_back(t);
+    } else {
+      for (int32 i = 0; i < 20; i++)
+        frames.push_back(rand() % num_frames);
+    }
+    Matrix<BaseFloat> feats1(frames.size(), dim), feats2(frames.size(), dim);
+    a->GetFrames(frames, &feats1);
+    for (size_t i = 0; i < frames.size(); i++) {
+      SubVector<BaseFloat> row(feats2, i);
+      a->GetFrame(frames[i], &row);
+    }
+    AssertEqual(feats1, feats2);
+  }
+}
+
+void TestOnlineGetFrames() {
+  int32 dim = 2 + rand() % 5;  // dimension of features.
+  int32 num_frames = 100 + rand() % 100;
+
+  Matrix<BaseFloat> input_feats(num_frames, dim);
+  input_feats.SetRandn();
+  OnlineMatrixFeature matrix_feats(input_feats);
+  CheckGetFrames(&matrix_feats);
+
+  DeltaFeaturesOptions delta_opts;
+  delta_opts.order = rand() % 3;
+  delta_opts.window = 1 + rand() % 3;
+  OnlineDeltaFeature delta_feats(delta_opts, &matrix_feats);
+  CheckGetFrames(&delta_feats);
+
+  OnlineSpliceOptions splice_opts;
+  splice_opts.left_context  = rand() % 4;
+  splice_opts.right_context = rand() % 4;
+  OnlineSpliceFrames splice_feats(splice_opts, &delta_feats);
+  CheckGetFrames(&splice_feats);
+
+  Matrix<BaseFloat> transform(dim, splice_feats.Dim() + 1);
+  transform.SetRandn();
+  OnlineTransform transform_feats(transform, &splice_feats);
+  CheckGetFrames(&transform_feats);
+
+  OnlineCmvnOptions cmvn_opts;
+  cmvn_opts.cmn_window = 10 + rand() % 50;
+  cmvn_opts.normalize_variance = (rand() % 2 == 0);
+  Matrix<double> global_stats(2, dim + 1);
+  for (int32 t = 0; t < num_frames; t++) {
+    for (int32 d = 0; d < dim; d++) {
+      global_stats(0, d) += input_feats(t, d);
+      global_stats(1, d) += input_feats(t, d) * input_feats(t, d);
+    }
+    global_stats(0, dim) += 1.0;
+  }
+  OnlineCmvnState cmvn_state(global_stats);
+  OnlineCmvn cmvn_feats(cmvn_opts, cmvn_state, &transform_feats);
+  CheckGetFrames(&cmvn_feats);
+  cmvn_feats.Freeze(num_frames / 2);
+  CheckGetFrames(&cmvn_feats);
+
+  OnlineAppendFeature append_feats(&matrix_feats, &transform_feats);
+  CheckGetFrames(&append_feats);
+
+  OnlineCacheFeature cache_feats(&append_feats);
+  CheckGetFrames(&cache_feats);
+  CheckGetFrames(&cache_feats);  // now partly from the cache.
+}
+
 }  // end namespace kaldi
 
 int main() {
@@ -396,6 +474,7 @@ int main() {
     TestOnlinePlp();
     TestOnlineTransform();
     TestOnlineAppendFeature();
+    TestOnlineGetFrames();
   }
   std::cout << "Test OK.\n";
 }
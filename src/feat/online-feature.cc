@@ -24,6 +24,26 @@
 
 namespace kaldi {
 
+// Sets "run_begins" to the indexes in "frames" where runs of consecutive frame
+// indexes (t, t+1, t+2, ...) begin, followed by frames.size().  The
+// GetFrames() functions that need context process one run at a time, so that
+// they can fetch the input frames for the whole run with a single call.
+static void GetConsecutiveRuns(const std::vector<int32> &frames,
+                               std::vector<int32> *run_begins) {
+  run_begins->clear();
+  for (size_t i = 0; i < frames.size(); i++)
+    if (i == 0 || frames[i] != frames[i - 1] + 1)
+      run_begins->push_back(i);
+  run_begins->push_back(frames.size());
+}
+
+// Sets "frames" to the range begin, begin + 1, ..., end - 1.
+static void GetFrameRange(int32 begin, int32 end, std::vector<int32> *frames) {
+  KALDI_ASSERT(end > begin);
+  frames->resize(end - begin);
+  for (int32 t = begin; t < end; t++)
+    (*frames)[t - begin] = t;
+}
 
 template<class C>
 void OnlineGenericBaseFeature<C>::GetFrame(int32 frame,
@@ -33,6 +53,18 @@ void OnlineGenericBaseFeature<C>::GetFrame(int32 frame,
   feat->CopyFromVec(features_.Row(frame));
 };
 
+template<class C>
+void OnlineGenericBaseFeature<C>::GetFrames(const std::vector<int32> &frames,
+                                            MatrixBase<BaseFloat> *feats) {
+  KALDI_ASSERT(static_cast<int32>(frames.size()) == feats->NumRows() &&
+               feats->NumCols() == Dim());
+  for (size_t i = 0; i < frames.size(); i++) {
+    int32 frame = frames[i];
+    KALDI_ASSERT(frame >= 0 && frame < num_frames_);
+    feats->Row(i).CopyFromVec(features_.Row(frame));
+  }
+}
+
 template<class C>
 bool OnlineGenericBaseFeature<C>::IsLastFrame(int32 frame) const {
   return (frame == num_frames_ - 1 && input_finished_);
@@ -131,10 +163,20 @@ void OnlineCmvnState::Read(std::istream &is, bool binary) {
 
 
 
+// static
+int32 OnlineCmvn::NumCheckpoints(const OnlineCmvnOptions &opts) {
+  // Enough checkpoints for windows that end up to cmn_window frames before
+  // the ones prefix_sums_ keeps all the prefix sums for.
+  return (2 * opts.cmn_window + opts.ring_buffer_size) / opts.modulus + 1;
+}
+
 OnlineCmvn::OnlineCmvn(const OnlineCmvnOptions &opts,
                        const OnlineCmvnState &cmvn_state,
                        OnlineFeatureInterface *src):
-    opts_(opts), src_(src) {
+    opts_(opts),
+    prefix_sums_(src->Dim(), true, opts.cmn_window + opts.ring_buffer_size + 1,
+                 opts.modulus, NumCheckpoints(opts)),
+    src_(src) {
   SetState(cmvn_state);
   if (!SplitStringToIntegers(opts.skip_dims, ":", false, &skip_dims_))
     KALDI_ERR << "Bad --skip-dims option (should be colon-separated list of "
@@ -142,120 +184,69 @@ OnlineCmvn::OnlineCmvn(const OnlineCmvnOptions &opts,
 }
 
 OnlineCmvn::OnlineCmvn(const OnlineCmvnOptions &opts,
-                       OnlineFeatureInterface *src): opts_(opts), src_(src) {
+                       OnlineFeatureInterface *src):
+    opts_(opts),
+    prefix_sums_(src->Dim(), true, opts.cmn_window + opts.ring_buffer_size + 1,
+                 opts.modulus, NumCheckpoints(opts)),
+    src_(src) {
   if (!SplitStringToIntegers(opts.skip_dims, ":", false, &skip_dims_))
     KALDI_ERR << "Bad --skip-dims option (should be colon-separated list of "
               <<  "integers)";
 }
 
 
-void OnlineCmvn::GetMostRecentCachedFrame(int32 frame,
-                                          int32 *cached_frame,
-                                          Matrix<double> *stats) {
-  KALDI_ASSERT(frame >= 0);
-  InitRingBufferIfNeeded();
-  // look for a cached frame on a previous frame as close as possible in time
-  // to "frame".  Return if we get one.
-  for (int32 t = frame; t >= 0 && t >= frame - opts_.ring_buffer_size; t--) {
-    if (t % opts_.modulus == 0) {
-      // if this frame should be cached in cached_stats_modulo_, then
-      // we'll look there, and we won't go back any further in time.
-      break;
-    }
-    int32 index = t % opts_.ring_buffer_size;
-    if (cached_stats_ring_[index].first == t) {
-      *cached_frame = t;
-      *stats = cached_stats_ring_[index].second;
-      return;
-    }
-  }
-  int32 n = frame / opts_.modulus;
-  if (n >= cached_stats_modulo_.size()) {
-    if (cached_stats_modulo_.size() == 0) {
-      *cached_frame = -1;
-      stats->Resize(2, this->Dim() + 1);
-      return;
-    } else {
-      n = static_cast<int32>(cached_stats_modulo_.size() - 1);
-    }
-  }
-  *cached_frame = n * opts_.modulus;
-  KALDI_ASSERT(cached_stats_modulo_[n] != NULL);
-  *stats = *(cached_stats_modulo_[n]);
+void OnlineCmvn::ComputeStatsForFrame(int32 frame,
+                                      MatrixBase<double> *stats_out) {
+  KALDI_ASSERT(frame >= 0 && frame < src_->NumFramesReady());
+  // The window is the last up to cmn_window frames, ending with "frame".
+  int32 end = frame + 1,
+      begin = std::max<int32>(0, end - opts_.cmn_window);
+  ComputeStatsForRange(begin, end, stats_out);
 }
 
-// Initialize ring buffer for caching stats.
-void OnlineCmvn::InitRingBufferIfNeeded() {
-  if (cached_stats_ring_.empty() && opts_.ring_buffer_size > 0) {
-    Matrix<double> temp(2, this->Dim() + 1);
-    cached_stats_ring_.resize(opts_.ring_buffer_size,
-                              std::pair<int32, Matrix<double> >(-1, temp));
+void OnlineCmvn::ComputeStatsForRange(int32 begin, int32 end,
+                                      MatrixBase<double> *stats) {
+  KALDI_ASSERT(begin >= 0 && begin <= end);
+  int32 num_frames = prefix_sums_.NumFrames();
+  if (end > num_frames) {
+    // Accept the frames we have not seen yet, with a single call to src_.
+    std::vector<int32> frames;
+    GetFrameRange(num_frames, end, &frames);
+    Matrix<BaseFloat> feats(frames.size(), src_->Dim(), kUndefined);
+    src_->GetFrames(frames, &feats);
+    Matrix<double> feats_dbl(feats);
+    for (int32 i = 0; i < feats_dbl.NumRows(); i++)
+      prefix_sums_.AcceptFrame(feats_dbl.Row(i));
   }
-}
-
-void OnlineCmvn::CacheFrame(int32 frame, const Matrix<double> &stats) {
-  KALDI_ASSERT(frame >= 0);
-  if (frame % opts_.modulus == 0) {  // store in cached_stats_modulo_.
-    int32 n = frame / opts_.modulus;
-    if (n >= cached_stats_modulo_.size()) {
-      // The following assert is a limitation on in what order you can call
-      // CacheFrame.  Fortunately the calling code always calls it in sequence,
-      // which it has to because you need a previous frame to compute the
-      // current one.
-      KALDI_ASSERT(n == cached_stats_modulo_.size());
-      cached_stats_modulo_.push_back(new Matrix<double>(stats));
-    } else {
-      KALDI_WARN << "Did not expect to reach this part of code.";
-      // do what seems right, but we shouldn't get here.
-      cached_stats_modulo_[n]->CopyFromMat(stats);
-    }
-  } else {  // store in the ring buffer.
-    InitRingBufferIfNeeded();
-    if (!cached_stats_ring_.empty()) {
-      int32 index = frame % cached_stats_ring_.size();
-      cached_stats_ring_[index].first = frame;
-      cached_stats_ring_[index].second.CopyFromMat(stats);
-    }
+  int32 stored_begin = prefix_sums_.LatestPrefixSum(begin),
+      stored_end = prefix_sums_.LatestPrefixSum(end);
+  if ((begin - stored_begin) + (end - stored_end) > end - begin) {
+    // The prefix sums near this window have been dropped, so it is quicker to
+    // add up the frames of the window.
+    stats->SetZero();
+    AddFramesToStats(begin, end, 1.0, stats);
+    return;
   }
+  prefix_sums_.GetStats(stored_begin, stored_end, stats);
+  // The following only does anything for windows that end more than about
+  // ring_buffer_size frames before the most recent frame.
+  AddFramesToStats(stored_end, end, 1.0, stats);
+  AddFramesToStats(stored_begin, begin, -1.0, stats);
 }
 
-OnlineCmvn::~OnlineCmvn() {
-  for (size_t i = 0; i < cached_stats_modulo_.size(); i++)
-    delete cached_stats_modulo_[i];
-  cached_stats_modulo_.clear();
-}
-
-void OnlineCmvn::ComputeStatsForFrame(int32 frame,
-                                      MatrixBase<double> *stats_out) {
-  KALDI_ASSERT(frame >= 0 && frame < src_->NumFramesReady());
-
-  int32 dim = this->Dim(), cur_frame;
-  Matrix<double> stats(2, dim + 1);
-  GetMostRecentCachedFrame(frame, &cur_frame, &stats);
-
-  Vector<BaseFloat> feats(dim);
-  Vector<double> feats_dbl(dim);
-  while (cur_frame < frame) {
-    cur_frame++;
-    src_->GetFrame(cur_frame, &feats);
-    feats_dbl.CopyFromVec(feats);
-    stats.Row(0).Range(0, dim).AddVec(1.0, feats_dbl);
-    stats.Row(1).Range(0, dim).AddVec2(1.0, feats_dbl);
-    stats(0, dim) += 1.0;
-    // it's a sliding buffer; a frame at the back may be
-    // leaving the buffer so we have to subtract that.
-    int32 prev_frame = cur_frame - opts_.cmn_window;
-    if (prev_frame >= 0) {
-      // we need to subtract frame prev_f from the stats.
-      src_->GetFrame(prev_frame, &feats);
-      feats_dbl.CopyFromVec(feats);
-      stats.Row(0).Range(0, dim).AddVec(-1.0, feats_dbl);
-      stats.Row(1).Range(0, dim).AddVec2(-1.0, feats_dbl);
-      stats(0, dim) -= 1.0;
-    }
-    CacheFrame(cur_frame, stats);
-  }
-  stats_out->CopyFromMat(stats);
+void OnlineCmvn::AddFramesToStats(int32 begin, int32 end, double scale,
+                                  MatrixBase<double> *stats) {
+  if (begin >= end)
+    return;
+  int32 dim = this->Dim();
+  std::vector<int32> frames;
+  GetFrameRange(begin, end, &frames);
+  Matrix<BaseFloat> feats(frames.size(), dim, kUndefined);
+  src_->GetFrames(frames, &feats);
+  Matrix<double> feats_dbl(feats);
+  stats->Row(0).Range(0, dim).AddRowSumMat(scale, feats_dbl, 1.0);
+  stats->Row(1).Range(0, dim).AddDiagMat2(scale, feats_dbl, kTrans, 1.0);
+  (*stats)(0, dim) += scale * (end - begin);
 }
 
 
@@ -330,6 +321,37 @@ void OnlineCmvn::GetFrame(int32 frame,
   feat->CopyFromVec(feat_mat.Row(0));
 }
 
+void OnlineCmvn::GetFrames(const std::vector<int32> &frames,
+                           MatrixBase<BaseFloat> *feats) {
+  src_->GetFrames(frames, feats);
+  KALDI_ASSERT(feats->NumCols() == this->Dim());
+  if (!opts_.normalize_mean) {
+    KALDI_ASSERT(!opts_.normalize_variance);
+    return;
+  }
+  int32 dim = feats->NumCols();
+  Matrix<double> stats(2, dim + 1);
+  if (frozen_state_.NumRows() != 0) {
+    // All the frames use the frozen stats, so normalize them all at once.
+    stats.CopyFromMat(frozen_state_);
+    if (!skip_dims_.empty())
+      FakeStatsForSomeDims(skip_dims_, &stats);
+    ApplyCmvn(stats, opts_.normalize_variance, feats);
+    return;
+  }
+  for (size_t i = 0; i < frames.size(); i++) {
+    this->ComputeStatsForFrame(frames[i], &stats);
+    SmoothOnlineCmvnStats(orig_state_.speaker_cmvn_stats,
+                          orig_state_.global_cmvn_stats,
+                          opts_,
+                          &stats);
+    if (!skip_dims_.empty())
+      FakeStatsForSomeDims(skip_dims_, &stats);
+    SubMatrix<BaseFloat> feat(*feats, i, 1, 0, dim);
+    ApplyCmvn(stats, opts_.normalize_variance, &feat);
+  }
+}
+
 void OnlineCmvn::Freeze(int32 cur_frame) {
   int32 dim = this->Dim();
   Matrix<double> stats(2, dim + 1);
@@ -350,14 +372,10 @@ void OnlineCmvn::GetState(int32 cur_frame,
     int32 dim = this->Dim();
     if (state_out->speaker_cmvn_stats.NumRows() == 0)
       state_out->speaker_cmvn_stats.Resize(2, dim + 1);
-    Vector<BaseFloat> feat(dim);
-    Vector<double> feat_dbl(dim);
-    for (int32 t = 0; t <= cur_frame; t++) {
-      src_->GetFrame(t, &feat);
-      feat_dbl.CopyFromVec(feat);
-      state_out->speaker_cmvn_stats(0, dim) += 1.0;
-      state_out->speaker_cmvn_stats.Row(0).Range(0, dim).AddVec(1.0, feat_dbl);
-      state_out->speaker_cmvn_stats.Row(1).Range(0, dim).AddVec2(1.0, feat_dbl);
+    if (cur_frame >= 0) {
+      Matrix<double> stats(2, dim + 1);
+      ComputeStatsForRange(0, cur_frame + 1, &stats);
+      state_out->speaker_cmvn_stats.AddMat(1.0, stats);
     }
   }
   // Store any frozen state (the effect of the user possibly
@@ -366,7 +384,7 @@ void OnlineCmvn::GetState(int32 cur_frame,
 }
 
 void OnlineCmvn::SetState(const OnlineCmvnState &cmvn_state) {
-  KALDI_ASSERT(cached_stats_modulo_.empty() &&
+  KALDI_ASSERT(prefix_sums_.NumFrames() == 0 &&
                "You cannot call SetState() after processing data.");
   orig_state_ = cmvn_state;
   frozen_state_ = cmvn_state.frozen_state;
@@ -397,6 +415,38 @@ void OnlineSpliceFrames::GetFrame(int32 frame, VectorBase<BaseFloat> *feat) {
   }
 }
 
+void OnlineSpliceFrames::GetFrames(const std::vector<int32> &frames,
+                                   MatrixBase<BaseFloat> *feats) {
+  KALDI_ASSERT(left_context_ >= 0 && right_context_ >= 0);
+  KALDI_ASSERT(static_cast<int32>(frames.size()) == feats->NumRows() &&
+               feats->NumCols() == Dim());
+  int32 dim_in = src_->Dim(), T = src_->NumFramesReady(),
+      num_frames_ready = NumFramesReady();
+  std::vector<int32> run_begins, src_frames;
+  GetConsecutiveRuns(frames, &run_begins);
+  for (size_t r = 0; r + 1 < run_begins.size(); r++) {
+    int32 begin = run_begins[r], end = run_begins[r + 1];
+    KALDI_ASSERT(frames[begin] >= 0 && frames[end - 1] < num_frames_ready);
+    // Get all the input frames that this run needs, then copy them into
+    // place.
+    int32 src_begin = std::max<int32>(0, frames[begin] - left_context_),
+        src_end = std::min<int32>(T, frames[end - 1] + right_context_ + 1);
+    GetFrameRange(src_begin, src_end, &src_frames);
+    Matrix<BaseFloat> src_feats(src_end - src_begin, dim_in, kUndefined);
+    src_->GetFrames(src_frames, &src_feats);
+    for (int32 i = begin; i < end; i++) {
+      SubVector<BaseFloat> feat(*feats, i);
+      for (int32 n = 0; n <= left_context_ + right_context_; n++) {
+        int32 t2 = frames[i] - left_context_ + n;
+        if (t2 < 0) t2 = 0;
+        if (t2 >= T) t2 = T - 1;
+        feat.Range(n * dim_in, dim_in).CopyFromVec(
+            src_feats.Row(t2 - src_begin));
+      }
+    }
+  }
+}
+
 OnlineTransform::OnlineTransform(const MatrixBase<BaseFloat> &transform,
                                  OnlineFeatureInterface *src):
     src_(src) {
@@ -421,6 +471,19 @@ void OnlineTransform::GetFrame(int32 frame, VectorBase<BaseFloat> *feat) {
   feat->AddMatVec(1.0, linear_term_, kNoTrans, input_feat, 1.0);
 }
 
+void OnlineTransform::GetFrames(const std::vector<int32> &frames,
+                                MatrixBase<BaseFloat> *feats) {
+  KALDI_ASSERT(static_cast<int32>(frames.size()) == feats->NumRows() &&
+               feats->NumCols() == Dim());
+  if (frames.empty())
+    return;
+  Matrix<BaseFloat> input_feats(frames.size(), linear_term_.NumCols(),
+                                kUndefined);
+  src_->GetFrames(frames, &input_feats);
+  feats->CopyRowsFromVec(offset_);
+  feats->AddMatMat(1.0, input_feats, kNoTrans, linear_term_, kTrans, 1.0);
+}
+
 
 int32 OnlineDeltaFeature::Dim() const {
   int32 src_dim = src_->Dim();
@@ -464,6 +527,35 @@ void OnlineDeltaFeature::GetFrame(int32 frame,
   delta_features_.Process(temp_src, temp_t, feat);
 }
 
+void OnlineDeltaFeature::GetFrames(const std::vector<int32> &frames,
+                                   MatrixBase<BaseFloat> *feats) {
+  KALDI_ASSERT(static_cast<int32>(frames.size()) == feats->NumRows() &&
+               feats->NumCols() == Dim());
+  int32 context = opts_.order * opts_.window,
+      src_frames_ready = src_->NumFramesReady(),
+      num_frames_ready = NumFramesReady();
+  std::vector<int32> run_begins, src_frames;
+  GetConsecutiveRuns(frames, &run_begins);
+  for (size_t r = 0; r + 1 < run_begins.size(); r++) {
+    int32 begin = run_begins[r], end = run_begins[r + 1];
+    KALDI_ASSERT(frames[begin] >= 0 && frames[end - 1] < num_frames_ready);
+    // Get the input for the whole run at once.  Its first and last rows are
+    // only the first and last input frames if the context reaches that far,
+    // so the edge handling in DeltaFeatures::Process() gives the same result
+    // as in GetFrame().
+    int32 src_begin = std::max<int32>(0, frames[begin] - context),
+        src_end = std::min<int32>(src_frames_ready,
+                                  frames[end - 1] + context + 1);
+    GetFrameRange(src_begin, src_end, &src_frames);
+    Matrix<BaseFloat> src_feats(src_end - src_begin, src_->Dim(), kUndefined);
+    src_->GetFrames(src_frames, &src_feats);
+    for (int32 i = begin; i < end; i++) {
+      SubVector<BaseFloat> feat(*feats, i);
+      delta_features_.Process(src_feats, frames[i] - src_begin, &feat);
+    }
+  }
+}
+
 
 OnlineDeltaFeature::OnlineDeltaFeature(const DeltaFeaturesOptions &opts,
                                        OnlineFeatureInterface *src):
@@ -484,6 +576,33 @@ void OnlineCacheFeature::GetFrame(int32 frame, VectorBase<BaseFloat> *feat) {
   }
 }
 
+void OnlineCacheFeature::GetFrames(const std::vector<int32> &frames,
+                                   MatrixBase<BaseFloat> *feats) {
+  KALDI_ASSERT(static_cast<int32>(frames.size()) == feats->NumRows());
+  int32 dim = this->Dim();
+  // First get all the frames that are not cached yet with one call.
+  std::vector<int32> frames_to_compute;
+  for (size_t i = 0; i < frames.size(); i++) {
+    int32 frame = frames[i];
+    KALDI_ASSERT(frame >= 0);
+    if (static_cast<size_t>(frame) >= cache_.size())
+      cache_.resize(frame + 1, NULL);
+    if (cache_[frame] == NULL) {
+      cache_[frame] = new Vector<BaseFloat>(dim, kUndefined);
+      frames_to_compute.push_back(frame);
+    }
+  }
+  if (!frames_to_compute.empty()) {
+    Matrix<BaseFloat> computed(frames_to_compute.size(), dim, kUndefined);
+    // The following call will crash if any frame is not ready.
+    src_->GetFrames(frames_to_compute, &computed);
+    for (size_t i = 0; i < frames_to_compute.size(); i++)
+      cache_[frames_to_compute[i]]->CopyFromVec(computed.Row(i));
+  }
+  for (size_t i = 0; i < frames.size(); i++)
+    feats->Row(i).CopyFromVec(*(cache_[frames[i]]));
+}
+
 void OnlineCacheFeature::ClearCache() {
   for (size_t i = 0; i < cache_.size(); i++)
     delete cache_[i];
@@ -501,5 +620,19 @@ void OnlineAppendFeature::GetFrame(int32 frame, VectorBase<BaseFloat> *feat) {
   src2_->GetFrame(frame, &feat2);
 };
 
+void OnlineAppendFeature::GetFrames(const std::vector<int32> &frames,
+                                    MatrixBase<BaseFloat> *feats) {
+  KALDI_ASSERT(static_cast<int32>(frames.size()) == feats->NumRows() &&
+               feats->NumCols() == Dim());
+  if (frames.empty())
+    return;
+  int32 num_frames = feats->NumRows();
+  SubMatrix<BaseFloat> feats1(*feats, 0, num_frames, 0, src1_->Dim());
+  SubMatrix<BaseFloat> feats2(*feats, 0, num_frames, src1_->Dim(),
+                              src2_->Dim());
+  src1_->GetFrames(frames, &feats1);
+  src2_->GetFrames(frames, &feats2);
+}
+
 
 }  // namespace kaldi
@@ -58,6 +58,9 @@ class OnlineGenericBaseFeature: public OnlineBaseFeature {
   virtual int32 NumFramesReady() const { return num_frames_; }
   virtual void GetFrame(int32 frame, VectorBase<BaseFloat> *feat);
 
+  virtual void GetFrames(const std::vector<int32> &frames,
+                         MatrixBase<BaseFloat> *feats);
+
   //
   // Next, functions that are not in the interface.
   //
@@ -125,6 +128,13 @@ class OnlineMatrixFeature: public OnlineFeatureInterface {
     feat->CopyFromVec(mat_.Row(frame));
   }
 
+  virtual void GetFrames(const std::vector<int32> &frames,
+                         MatrixBase<BaseFloat> *feats) {
+    KALDI_ASSERT(static_cast<int32>(frames.size()) == feats->NumRows());
+    for (size_t i = 0; i < frames.size(); i++)
+      feats->Row(i).CopyFromVec(mat_.Row(frames[i]));
+  }
+
   virtual bool IsLastFrame(int32 frame) const {
     return (frame + 1 == mat_.NumRows());
   }
@@ -150,10 +160,14 @@ struct OnlineCmvnOptions {
   bool normalize_variance;
 
   int32 modulus;  // not configurable from command line, relates to how the
-                  // class computes the cmvn internally.  smaller->more
-                  // time-efficient but less memory-efficient.  Must be >= 1.
-  int32 ring_buffer_size;  // not configurable from command line; size of ring
-                           // buffer used for caching CMVN stats.
+                  // class computes the cmvn internally: for frames too far
+                  // back for "ring_buffer_size", prefix sums of the stats are
+                  // kept every "modulus" frames, for about the last
+                  // 2 * cmn_window frames.  smaller->more time-efficient but
+                  // less memory-efficient.  Must be >= 1.
+  int32 ring_buffer_size;  // not configurable from command line; the number
+                           // of frames before the most recent one for which
+                           // the CMVN stats can be computed in constant time.
   std::string skip_dims; // Colon-separated list of dimensions to skip normalization
                          // of, e.g. 13:14:15.
   
@@ -276,6 +290,9 @@ class OnlineCmvn: public OnlineFeatureInterface {
 
   virtual void GetFrame(int32 frame, VectorBase<BaseFloat> *feat);
 
+  virtual void GetFrames(const std::vector<int32> &frames,
+                         MatrixBase<BaseFloat> *feats);
+
 
   //
   // Next, functions that are not in the interface.
@@ -324,7 +341,7 @@ class OnlineCmvn: public OnlineFeatureInterface {
   // utterance's CMVN object.
   void Freeze(int32 cur_frame);
 
-  virtual ~OnlineCmvn();
+  virtual ~OnlineCmvn() { }
  private:
 
   /// Smooth the CMVN stats "stats" (which are stored in the normal format as a
@@ -336,24 +353,24 @@ class OnlineCmvn: public OnlineFeatureInterface {
                                     const OnlineCmvnOptions &opts,
                                     MatrixBase<double> *stats);
 
-  /// Get the most recent cached frame of CMVN stats.  [If no frames
-  /// were cached, sets up empty stats for frame zero and returns that].
-  void GetMostRecentCachedFrame(int32 frame,
-                                int32 *cached_frame,
-                                Matrix<double> *stats);
-
-  /// Cache this frame of stats.
-  void CacheFrame(int32 frame, const Matrix<double> &stats);
-
-  /// Initialize ring buffer for caching stats.
-  inline void InitRingBufferIfNeeded();
-
-  /// Computes the raw CMVN stats for this frame, making use of (and updating if
-  /// necessary) the cached statistics in raw_stats_.  This means the (x,
-  /// x^2, count) stats for the last up to opts_.cmn_window frames.
+  /// Computes the raw CMVN stats for this frame, i.e. the (x, x^2, count)
+  /// stats for the last up to opts_.cmn_window frames.
   void ComputeStatsForFrame(int32 frame,
                             MatrixBase<double> *stats);
 
+  /// Computes the raw CMVN stats of frames begin through end - 1, from
+  /// prefix_sums_ (which this may need to bring up to date); windows too far
+  /// back for prefix_sums_ to have their prefix sums are corrected by getting
+  /// the frames in between from src_, or, if the nearest prefix sums have been
+  /// dropped, are added up from src_.
+  void ComputeStatsForRange(int32 begin, int32 end,
+                            MatrixBase<double> *stats);
+
+  /// Adds "scale" times the stats of frames begin through end - 1 of src_ to
+  /// "stats".
+  void AddFramesToStats(int32 begin, int32 end, double scale,
+                        MatrixBase<double> *stats);
+
 
   OnlineCmvnOptions opts_;
   std::vector<int32> skip_dims_; // Skip CMVN for these dimensions.  Derived from opts_.
@@ -363,14 +380,17 @@ class OnlineCmvn: public OnlineFeatureInterface {
                                  // will reflect the CMVN state that we froze
                                  // at.
 
-  // The variable below reflects the raw (count, x, x^2) statistics of the
-  // input, computed every opts_.modulus frames.  raw_stats_[n / opts_.modulus]
-  // contains the (count, x, x^2) statistics for the frames from
-  // std::max(0, n - opts_.cmn_window) through n.
-  std::vector<Matrix<double>*> cached_stats_modulo_;
-  // the variable below is a ring-buffer of cached stats.  the int32 is the
-  // frame index.
-  std::vector<std::pair<int32, Matrix<double> > > cached_stats_ring_;
+  // Returns the number of checkpoints (prefix sums kept every opts.modulus
+  // frames) that prefix_sums_ keeps.
+  static int32 NumCheckpoints(const OnlineCmvnOptions &opts);
+
+  // Prefix sums of the input features and their squares.  They are kept for
+  // the last cmn_window + ring_buffer_size frames, so the stats of any
+  // recent frame take constant time to compute; older frames use the prefix
+  // sums that are kept every opts_.modulus frames for a fixed number of
+  // frames further back (see NumCheckpoints()), so the memory used does not
+  // grow with the length of the stream.
+  CmvnPrefixSums prefix_sums_;
 
   OnlineFeatureInterface *src_;  // Not owned here
 };
@@ -405,6 +425,9 @@ class OnlineSpliceFrames: public OnlineFeatureInterface {
 
   virtual void GetFrame(int32 frame, VectorBase<BaseFloat> *feat);
 
+  virtual void GetFrames(const std::vector<int32> &frames,
+                         MatrixBase<BaseFloat> *feats);
+
   //
   // Next, functions that are not in the interface.
   //
@@ -435,6 +458,9 @@ class OnlineTransform: public OnlineFeatureInterface {
 
   virtual void GetFrame(int32 frame, VectorBase<BaseFloat> *feat);
 
+  virtual void GetFrames(const std::vector<int32> &frames,
+                         MatrixBase<BaseFloat> *feats);
+
   //
   // Next, functions that are not in the interface.
   //
@@ -466,6 +492,9 @@ class OnlineDeltaFeature: public OnlineFeatureInterface {
 
   virtual void GetFrame(int32 frame, VectorBase<BaseFloat> *feat);
 
+  virtual void GetFrames(const std::vector<int32> &frames,
+                         MatrixBase<BaseFloat> *feats);
+
   //
   // Next, functions that are not in the interface.
   //
@@ -494,6 +523,9 @@ class OnlineCacheFeature: public OnlineFeatureInterface {
 
   virtual void GetFrame(int32 frame, VectorBase<BaseFloat> *feat);
 
+  virtual void GetFrames(const std::vector<int32> &frames,
+                         MatrixBase<BaseFloat> *feats);
+
   virtual ~OnlineCacheFeature() { ClearCache(); }
 
   // Things that are not in the shared interface:
@@ -527,6 +559,9 @@ class OnlineAppendFeature: public OnlineFeatureInterface {
 
   virtual void GetFrame(int32 frame, VectorBase<BaseFloat> *feat);
 
+  virtual void GetFrames(const std::vector<int32> &frames,
+                         MatrixBase<BaseFloat> *feats);
+
   virtual ~OnlineAppendFeature() {  }
 
   OnlineAppendFeature(OnlineFeatureInterface *src1,
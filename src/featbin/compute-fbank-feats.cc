@@ -22,6 +22,8 @@
 #include "util/common-utils.h"
 #include "feat/feature-fbank.h"
 #include "feat/wave-reader.h"
+#include "feat/feature-parallel.h"
+#include "thread/kaldi-task-sequence.h"
 
 
 int main(int argc, char *argv[]) {
@@ -29,7 +31,10 @@ int main(int argc, char *argv[]) {
     using namespace kaldi;
     const char *usage =
         "Create Mel-filter bank (FBANK) feature files.\n"
-        "Usage:  compute-fbank-feats [options...] <wav-rspecifier> <feats-wspecifier>\n";
+        "Usage:  compute-fbank-feats [options...] <wav-rspecifier> <feats-wspecifier>\n"
+        "With --num-threads > 1, the features are computed in parallel (the output\n"
+        "order is unchanged); you may also want to read the input in a background\n"
+        "thread, e.g. scp,bg:wav.scp\n";
 
     // construct all the global objects
     ParseOptions po(usage);
@@ -42,6 +47,7 @@ int main(int argc, char *argv[]) {
     BaseFloat min_duration = 0.0;
     // Define defaults for gobal options
     std::string output_format = "kaldi";
+    TaskSequencerConfig sequencer_config;
 
     // Register the option struct
     fbank_opts.Register(&po);
@@ -58,6 +64,8 @@ int main(int argc, char *argv[]) {
     //
 
     // parse options (+filling the registered variables)
+    sequencer_config.Register(&po);
+
     po.Read(argc, argv);
 
     if (po.NumArgs() != 2) {
@@ -72,112 +80,74 @@ int main(int argc, char *argv[]) {
     Fbank fbank(fbank_opts);
 
     SequentialTableReader<WaveHolder> reader(wav_rspecifier);
-    BaseFloatMatrixWriter kaldi_writer;  // typedef to TableWriter<something>.
-    TableWriter<HtkMatrixHolder> htk_writer;
 
     if (utt2spk_rspecifier != "")
       KALDI_ASSERT(vtln_map_rspecifier != "" && "the utt2spk option is only "
                    "needed if the vtln-map option is used.");
     RandomAccessBaseFloatReaderMapped vtln_map_reader(vtln_map_rspecifier,
                                                       utt2spk_rspecifier);
-    
-    if (output_format == "kaldi") {
-      if (!kaldi_writer.Open(output_wspecifier))
-        KALDI_ERR << "Could not initialize output with wspecifier "
-                  << output_wspecifier;
-    } else if (output_format == "htk") {
-      if (!htk_writer.Open(output_wspecifier))
-        KALDI_ERR << "Could not initialize output with wspecifier "
-                  << output_wspecifier;
-    } else {
-      KALDI_ERR << "Invalid output_format string " << output_format;
-    }
-
-    int32 num_utts = 0, num_success = 0;
-    for (; !reader.Done(); reader.Next()) {
-      num_utts++;
-      std::string utt = reader.Key();
-      const WaveData &wave_data = reader.Value();
-      if (wave_data.Duration() < min_duration) {
-        KALDI_WARN << "File: " << utt << " is too short ("
-                   << wave_data.Duration() << " sec): producing no output.";
-        continue;
-      }
-      int32 num_chan = wave_data.Data().NumRows(), this_chan = channel;
-      {  // This block works out the channel (0=left, 1=right...)
-        KALDI_ASSERT(num_chan > 0);  // should have been caught in
-        // reading code if no channels.
-        if (channel == -1) {
-          this_chan = 0;
-          if (num_chan != 1)
-            KALDI_WARN << "Channel not specified but you have data with "
-                       << num_chan  << " channels; defaulting to zero";
-        } else {
-          if (this_chan >= num_chan) {
-            KALDI_WARN << "File with id " << utt << " has "
-                       << num_chan << " channels but you specified channel "
-                       << channel << ", producing no output.";
-            continue;
+    uint16 htk_parameter_kind = 007 |  // FBANK
+        (fbank_opts.use_energy ? 0100 : 020000);  // energy; otherwise c0
+    FeatureArchiveOutput output(output_wspecifier, output_format,
+                                subtract_mean, htk_parameter_kind);
+
+    int32 num_utts = 0;
+    {
+      TaskSequencer<FeatureComputationTask<Fbank> > sequencer(
+          sequencer_config);
+      for (; !reader.Done(); reader.Next()) {
+        num_utts++;
+        std::string utt = reader.Key();
+        const WaveData &wave_data = reader.Value();
+        if (wave_data.Duration() < min_duration) {
+          KALDI_WARN << "File: " << utt << " is too short ("
+                     << wave_data.Duration() << " sec): producing no output.";
+          continue;
+        }
+        int32 num_chan = wave_data.Data().NumRows(), this_chan = channel;
+        {  // This block works out the channel (0=left, 1=right...)
+          KALDI_ASSERT(num_chan > 0);  // should have been caught in
+          // reading code if no channels.
+          if (channel == -1) {
+            this_chan = 0;
+            if (num_chan != 1)
+              KALDI_WARN << "Channel not specified but you have data with "
+                         << num_chan  << " channels; defaulting to zero";
+          } else {
+            if (this_chan >= num_chan) {
+              KALDI_WARN << "File with id " << utt << " has "
+                         << num_chan << " channels but you specified channel "
+                         << channel << ", producing no output.";
+              continue;
+            }
           }
         }
-      }
-      BaseFloat vtln_warp_local;  // Work out VTLN warp factor.
-      if (vtln_map_rspecifier != "") {
-        if (!vtln_map_reader.HasKey(utt)) {
-          KALDI_WARN << "No vtln-map entry for utterance-id (or speaker-id) "
-                     << utt;
-          continue;
+        BaseFloat vtln_warp_local;  // Work out VTLN warp factor.
+        if (vtln_map_rspecifier != "") {
+          if (!vtln_map_reader.HasKey(utt)) {
+            KALDI_WARN << "No vtln-map entry for utterance-id (or speaker-id) "
+                       << utt;
+            continue;
+          }
+          vtln_warp_local = vtln_map_reader.Value(utt);
+        } else {
+          vtln_warp_local = vtln_warp;
         }
-        vtln_warp_local = vtln_map_reader.Value(utt);
-      } else {
-        vtln_warp_local = vtln_warp;
-      }
-      if (fbank_opts.frame_opts.samp_freq != wave_data.SampFreq())
-        KALDI_ERR << "Sample frequency mismatch: you specified "
-                  << fbank_opts.frame_opts.samp_freq << " but data has "
-                  << wave_data.SampFreq() << " (use --sample-frequency "
-                  << "option).  Utterance is " << utt;
-
-      SubVector<BaseFloat> waveform(wave_data.Data(), this_chan);
-      Matrix<BaseFloat> features;
-      try {
-        fbank.Compute(waveform, vtln_warp_local, &features, NULL);
-      } catch (...) {
-        KALDI_WARN << "Failed to compute features for utterance "
-                   << utt;
-        continue;
-      }
-      if (subtract_mean) {
-        Vector<BaseFloat> mean(features.NumCols());
-        mean.AddRowSumMat(1.0, features);
-        mean.Scale(1.0 / features.NumRows());
-        for (int32 i = 0; i < features.NumRows(); i++)
-          features.Row(i).AddVec(-1.0, mean);
-      }
-      if (output_format == "kaldi") {
-        kaldi_writer.Write(utt, features);
-      } else {
-        std::pair<Matrix<BaseFloat>, HtkHeader> p;
-        p.first.Resize(features.NumRows(), features.NumCols());
-        p.first.CopyFromMat(features);
-        HtkHeader header = {
-          features.NumRows(),
-          100000,  // 10ms shift
-          static_cast<int16>(sizeof(float)*features.NumCols()),
-          static_cast<uint16>(007 | // FBANK
-          (fbank_opts.use_energy ? 0100 : 020000)) // energy; otherwise c0
-        };
-        p.second = header;
-        htk_writer.Write(utt, p);
+        if (fbank_opts.frame_opts.samp_freq != wave_data.SampFreq())
+          KALDI_ERR << "Sample frequency mismatch: you specified "
+                    << fbank_opts.frame_opts.samp_freq << " but data has "
+                    << wave_data.SampFreq() << " (use --sample-frequency "
+                    << "option).  Utterance is " << utt;
+
+        SubVector<BaseFloat> waveform(wave_data.Data(), this_chan);
+        sequencer.Run(new FeatureComputationTask<Fbank>(
+            fbank, utt, waveform, vtln_warp_local, &output));
       }
-      if (num_utts % 10 == 0)
-        KALDI_LOG << "Processed " << num_utts << " utterances";
-      KALDI_VLOG(2) << "Processed features for key " << utt;
-      num_success++;
+      sequencer.Wait();
     }
-    KALDI_LOG << " Done " << num_success << " out of " << num_utts
+    KALDI_LOG << " Done " << output.NumSuccess() << " out of " << num_utts
               << " utterances.";
-    return (num_success != 0 ? 0 : 1);
+    return (output.NumSuccess() != 0 ? 0 : 1);
   } catch(const std::exception &e) {
     std::cerr << e.what();
     return -1;
@@ -22,7 +22,54 @@
 #include "util/common-utils.h"
 #include "feat/pitch-functions.h"
 #include "feat/wave-reader.h"
+#include "feat/feature-parallel.h"
+#include "thread/kaldi-task-sequence.h"
 
+namespace kaldi {
+
+// This class lets us use ComputeKaldiPitch() with FeatureComputationTask.
+class PitchComputer {
+ public:
+  explicit PitchComputer(const PitchExtractionOptions &opts): opts_(opts) { }
+
+  // "vtln_warp", "wave_remainder" and "rand_state" are ignored.
+  void Compute(const VectorBase<BaseFloat> &wave, BaseFloat vtln_warp,
+               Matrix<BaseFloat> *output, Vector<BaseFloat> *wave_remainder,
+               RandomState *rand_state) const {
+    ComputeKaldiPitch(opts_, wave, output);
+  }
+ private:
+  const PitchExtractionOptions &opts_;
+};
+
+// This class writes the pitch features computed by FeatureComputationTask.
+class PitchArchiveOutput: public FeatureTaskOutput {
+ public:
+  explicit PitchArchiveOutput(const std::string &wspecifier):
+      feat_writer_(wspecifier), num_done_(0), num_err_(0) { }
+
+  virtual void Output(const std::string &utt, Matrix<BaseFloat> *features) {
+    feat_writer_.Write(utt, *features);
+    if (num_done_ % 50 == 0 && num_done_ != 0)
+      KALDI_VLOG(2) << "Processed " << num_done_ << " utterances";
+    num_done_++;
+  }
+
+  virtual void Failed(const std::string &utt) {
+    KALDI_WARN << "Failed to compute pitch for utterance "
+               << utt;
+    num_err_++;
+  }
+
+  int32 NumDone() const { return num_done_; }
+  int32 NumErr() const { return num_err_; }
+ private:
+  BaseFloatMatrixWriter feat_writer_;
+  int32 num_done_;
+  int32 num_err_;
+};
+
+}  // namespace kaldi
 
 int main(int argc, char *argv[]) {
   try {
@@ -35,18 +82,22 @@ int main(int argc, char *argv[]) {
         "Usage: compute-kaldi-pitch-feats [options...] <wav-rspecifier> <feats-wspecifier>\n"
         "e.g.\n"
         "compute-kaldi-pitch-feats --sample-frequency=8000 scp:wav.scp ark:- \n"
+        "With --num-threads > 1, the pitch is computed in parallel (the output order\n"
+        "is unchanged).\n"
         "\n"
         "See also: process-kaldi-pitch-feats, compute-and-process-kaldi-pitch-feats\n";
     
     
     ParseOptions po(usage);
     PitchExtractionOptions pitch_opts;
+    TaskSequencerConfig sequencer_config;
     int32 channel = -1; // Note: this isn't configurable because it's not a very
                         // good idea to control it this way: better to extract the
                         // on the command line (in the .scp file) using sox or
                         // similar.
 
     pitch_opts.Register(&po);
+    sequencer_config.Register(&po);
     
     po.Read(argc, argv);
 
@@ -59,58 +110,50 @@ int main(int argc, char *argv[]) {
         feat_wspecifier = po.GetArg(2);
 
     SequentialTableReader<WaveHolder> wav_reader(wav_rspecifier);
-    BaseFloatMatrixWriter feat_writer(feat_wspecifier);
-
-    int32 num_done = 0, num_err = 0;
-    for (; !wav_reader.Done(); wav_reader.Next()) {
-      std::string utt = wav_reader.Key();  
-      const WaveData &wave_data = wav_reader.Value(); 
-      
-      int32 num_chan = wave_data.Data().NumRows(), this_chan = channel;
-      {
-        KALDI_ASSERT(num_chan > 0); 
-        // reading code if no channels.
-        if (channel == -1) {
-          this_chan = 0;
-          if (num_chan != 1)
-            KALDI_WARN << "Channel not specified but you have data with "
-                       << num_chan  << " channels; defaulting to zero";
-        } else {
-          if (this_chan >= num_chan) {
-            KALDI_WARN << "File with id " << utt << " has "
-                       << num_chan << " channels but you specified channel "
-                       << channel << ", producing no output.";
-            continue;
+    PitchComputer pitch_computer(pitch_opts);
+    PitchArchiveOutput output(feat_wspecifier);
+
+    {
+      TaskSequencer<FeatureComputationTask<PitchComputer> > sequencer(
+          sequencer_config);
+      for (; !wav_reader.Done(); wav_reader.Next()) {
+        std::string utt = wav_reader.Key();
+        const WaveData &wave_data = wav_reader.Value();
+
+        int32 num_chan = wave_data.Data().NumRows(), this_chan = channel;
+        {
+          KALDI_ASSERT(num_chan > 0);
+          // reading code if no channels.
+          if (channel == -1) {
+            this_chan = 0;
+            if (num_chan != 1)
+              KALDI_WARN << "Channel not specified but you have data with "
+                         << num_chan  << " channels; defaulting to zero";
+          } else {
+            if (this_chan >= num_chan) {
+              KALDI_WARN << "File with id " << utt << " has "
+                         << num_chan << " channels but you specified channel "
+                         << channel << ", producing no output.";
+              continue;
+            }
           }
         }
+
+        if (pitch_opts.samp_freq != wave_data.SampFreq())
+          KALDI_ERR << "Sample frequency mismatch: you specified "
+                    << pitch_opts.samp_freq << " but data has "
+                    << wave_data.SampFreq() << " (use --sample-frequency "
+                    << "option).  Utterance is " << utt;
+
+        SubVector<BaseFloat> waveform(wave_data.Data(), this_chan);
+        sequencer.Run(new FeatureComputationTask<PitchComputer>(
+            pitch_computer, utt, waveform, 1.0, &output));
       }
-      
-      if (pitch_opts.samp_freq != wave_data.SampFreq())
-        KALDI_ERR << "Sample frequency mismatch: you specified "
-                  << pitch_opts.samp_freq << " but data has "
-                  << wave_data.SampFreq() << " (use --sample-frequency "
-                  << "option).  Utterance is " << utt;
-      
-      
-      SubVector<BaseFloat> waveform(wave_data.Data(), this_chan);
-      Matrix<BaseFloat> features;
-      try {
-        ComputeKaldiPitch(pitch_opts, waveform, &features);
-      } catch (...) {
-        KALDI_WARN << "Failed to compute pitch for utterance "
-                   << utt;
-        num_err++;        
-        continue;
-      }
-      
-      feat_writer.Write(utt, features);
-      if (num_done % 50 == 0 && num_done != 0)
-        KALDI_VLOG(2) << "Processed " << num_done << " utterances";
-      num_done++;
+      sequencer.Wait();
     }
-    KALDI_LOG << "Done " << num_done << " utterances, " << num_err
-              << " with errors.";
-    return (num_done != 0 ? 0 : 1);
+    KALDI_LOG << "Done " << output.NumDone() << " utterances, "
+              << output.NumErr() << " with errors.";
+    return (output.NumDone() != 0 ? 0 : 1);
   } catch(const std::exception &e) {
     std::cerr << e.what();
     return -1;
@@ -92,7 +92,9 @@ int main(int argc, char *argv[]) {
             kaldi_writer.Write(sphinx_reader.Key(),
                                CompressedMatrix(sphinx_reader.Value()));
         } else {
-          SequentialBaseFloatMatrixReader kaldi_reader(rspecifier);
+          // With the "mmap" rspecifier option, this compresses the features
+          // straight from the mapped archive.
+          SequentialBaseFloatMatrixViewReader kaldi_reader(rspecifier);
           for (; !kaldi_reader.Done(); kaldi_reader.Next(), num_done++)
             kaldi_writer.Write(kaldi_reader.Key(),
                                CompressedMatrix(kaldi_reader.Value()));
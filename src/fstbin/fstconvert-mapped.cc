@@ -0,0 +1,76 @@
+// fstbin/fstconvert-mapped.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "fst/fstlib.h"
+#include "fstext/kaldi-fst-io.h"
+#include "fstext/mapped-const-fst.h"
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    using namespace fst;
+    using kaldi::int32;
+
+    const char *usage =
+        "Converts an FST (e.g. a decoding graph HCLG.fst) to ConstFst format\n"
+        "with aligned data, which decoding programs memory-map instead of\n"
+        "reading (see ReadFstKaldiMapped()); the graph then loads almost\n"
+        "instantly, and all the processes on a machine that use it share\n"
+        "one copy in memory.  The output is readable by OpenFst tools as a\n"
+        "normal ConstFst.  It must be a file, not a pipe.\n"
+        "\n"
+        "Usage: fstconvert-mapped <fst-in> <fst-out>\n"
+        " e.g.: fstconvert-mapped exp/tri3/graph/HCLG.fst HCLG.const.fst\n";
+
+    ParseOptions po(usage);
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 2) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string fst_rxfilename = po.GetArg(1),
+        fst_wxfilename = po.GetArg(2);
+
+    if (ClassifyWxfilename(fst_wxfilename) != kFileOutput)
+      KALDI_ERR << "Output must be a file, not " << fst_wxfilename;
+
+    Fst<StdArc> *fst = ReadFstKaldiMapped(fst_rxfilename);
+    ConstFst<StdArc> const_fst(*fst);
+    delete fst;
+
+    bool binary = true, write_header = false;
+    Output ko(fst_wxfilename, binary, write_header);
+    FstWriteOptions wopts(PrintableWxfilename(fst_wxfilename));
+    wopts.align = true;
+    if (!const_fst.Write(ko.Stream(), wopts))
+      KALDI_ERR << "Error writing FST to " << fst_wxfilename;
+    ko.Close();
+
+    KALDI_LOG << "Wrote FST with " << const_fst.NumStates() << " states to "
+              << fst_wxfilename;
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
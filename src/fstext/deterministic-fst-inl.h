@@ -28,6 +28,97 @@
 namespace fst {
 // Do not include this file directly.  It is included by deterministic-fst.h.
 
+template<class Arc>
+SharedArcCache<Arc>::SharedArcCache(size_t num_cached_arcs, int32 num_locks):
+    num_locks_(num_locks), num_hits_(num_locks, 0),
+    num_misses_(num_locks, 0) {
+  KALDI_ASSERT(num_cached_arcs > 0 && num_locks > 0);
+  CachedArc unused_arc;
+  unused_arc.state = -1;
+  unused_arc.label = 0;
+  unused_arc.nextstate = -1;
+  unused_arc.weight = Weight::Zero();
+  cached_arcs_.resize(num_cached_arcs, unused_arc);
+  locks_ = new kaldi::Mutex[num_locks];
+}
+
+template<class Arc>
+inline size_t SharedArcCache<Arc>::GetIndex(int64 state, Label label) const {
+  // The same primes as in CacheDeterministicOnDemandFst::GetIndex().
+  const uint64 p1 = 26597, p2 = 50329;
+  return static_cast<size_t>((static_cast<uint64>(state) * p1 +
+                              static_cast<uint64>(label) * p2) %
+                             cached_arcs_.size());
+}
+
+template<class Arc>
+bool SharedArcCache<Arc>::Find(int64 state, Label label,
+                               int64 *nextstate, Weight *weight) {
+  size_t index = GetIndex(state, label);
+  int32 lock = index % num_locks_;
+  bool found = false;
+  locks_[lock].Lock();
+  const CachedArc &arc = cached_arcs_[index];
+  if (arc.state == state && arc.label == label) {
+    *nextstate = arc.nextstate;
+    *weight = arc.weight;
+    found = true;
+    num_hits_[lock]++;
+  } else {
+    num_misses_[lock]++;
+  }
+  locks_[lock].Unlock();
+  return found;
+}
+
+template<class Arc>
+void SharedArcCache<Arc>::Insert(int64 state, Label label,
+                                 int64 nextstate, Weight weight) {
+  KALDI_ASSERT(label != 0);
+  size_t index = GetIndex(state, label);
+  int32 lock = index % num_locks_;
+  locks_[lock].Lock();
+  CachedArc &arc = cached_arcs_[index];
+  arc.state = state;
+  arc.label = label;
+  arc.nextstate = nextstate;
+  arc.weight = weight;
+  locks_[lock].Unlock();
+}
+
+template<class Arc>
+int64 SharedArcCache<Arc>::NumHits() const {
+  int64 ans = 0;
+  for (int32 i = 0; i < num_locks_; i++) {
+    locks_[i].Lock();
+    ans += num_hits_[i];
+    locks_[i].Unlock();
+  }
+  return ans;
+}
+
+template<class Arc>
+int64 SharedArcCache<Arc>::NumMisses() const {
+  int64 ans = 0;
+  for (int32 i = 0; i < num_locks_; i++) {
+    locks_[i].Lock();
+    ans += num_misses_[i];
+    locks_[i].Unlock();
+  }
+  return ans;
+}
+
+template<class Arc>
+std::string SharedArcCache<Arc>::Info() const {
+  int64 num_hits = NumHits(), num_misses = NumMisses();
+  std::ostringstream os;
+  os << "Arc cache of size " << cached_arcs_.size() << ": " << num_hits
+     << " hits, " << num_misses << " misses, hit rate "
+     << (num_hits + num_misses == 0 ? 0.0 :
+         static_cast<double>(num_hits) / (num_hits + num_misses));
+  return os.str();
+}
+
 template<class Arc>
 typename Arc::StateId
 BackoffDeterministicOnDemandFst<Arc>::GetBackoffState(StateId s,
@@ -56,18 +147,44 @@ typename Arc::Weight BackoffDeterministicOnDemandFst<Arc>::Final(StateId state)
 
 template<class Arc>
 BackoffDeterministicOnDemandFst<Arc>::BackoffDeterministicOnDemandFst(
-    const Fst<Arc> &fst): fst_(fst) {
+    const Fst<Arc> &fst, SharedArcCache<Arc> *cache): fst_(fst),
+                                                      cache_(cache) {
 #ifdef KALDI_PARANOID
   KALDI_ASSERT(fst_.Properties(kILabelSorted|kIDeterministic, true) ==
                (kILabelSorted|kIDeterministic) &&
                "Input FST is not i-label sorted and deterministic.");
 #endif
+  // The cache only stores the next state and the weight.  We only use the
+  // stored properties here, since testing them would scan the whole FST each
+  // time one of these is constructed (e.g. once per lattice).
+  if (cache_ != NULL)
+    KALDI_ASSERT(fst_.Properties(kNotAcceptor, false) == 0 &&
+                 "Input FST must be an acceptor to use a SharedArcCache.");
 }
 
 template<class Arc>
 bool BackoffDeterministicOnDemandFst<Arc>::GetArc(
     StateId s, Label ilabel, Arc *oarc) {
   KALDI_ASSERT(ilabel != 0); //  We don't allow GetArc for epsilon.
+  if (cache_ == NULL)
+    return GetArcNoCache(s, ilabel, oarc);
+  int64 nextstate;
+  if (cache_->Find(s, ilabel, &nextstate, &(oarc->weight))) {
+    oarc->ilabel = ilabel;
+    oarc->olabel = ilabel;
+    oarc->nextstate = static_cast<StateId>(nextstate);
+    return true;
+  }
+  // As in CacheDeterministicOnDemandFst, we don't cache arcs that don't exist.
+  if (!GetArcNoCache(s, ilabel, oarc))
+    return false;
+  cache_->Insert(s, ilabel, oarc->nextstate, oarc->weight);
+  return true;
+}
+
+template<class Arc>
+bool BackoffDeterministicOnDemandFst<Arc>::GetArcNoCache(
+    StateId s, Label ilabel, Arc *oarc) {
 
   SortedMatcher<Fst<Arc> > sm(fst_, MATCH_INPUT, 1);
   sm.SetState(s);
@@ -79,7 +196,7 @@ bool BackoffDeterministicOnDemandFst<Arc>::GetArc(
     Weight backoff_w;
     StateId backoff_state = GetBackoffState(s, &backoff_w);
     if (backoff_state == kNoStateId) return false;
-    if (!this->GetArc(backoff_state, ilabel, oarc)) return false;
+    if (!GetArcNoCache(backoff_state, ilabel, oarc)) return false;
     oarc->weight = Times(oarc->weight, backoff_w);
     return true;
   }
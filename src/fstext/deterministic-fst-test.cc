@@ -177,6 +177,41 @@ void TestBackoffAndCache() {
   delete rfst;
 }
 
+void TestSharedArcCache() {
+  cout << "Test with generated backoff FSTs sharing an arc cache" << endl;
+  StdVectorFst *nfst = CreateBackoffFst();
+  StdVectorFst *rfst = CreateResultFst();
+
+  ArcSort(nfst, StdILabelCompare());
+  // A small cache, so some arcs replace others.
+  SharedArcCache<StdArc> cache(3, 2);
+  int64 num_lookups = 0;
+  for (int32 i = 0; i < 3; i++) {
+    // A new FST for each pass, as for each lattice of a batch; they all use
+    // the same cache.
+    BackoffDeterministicOnDemandFst<StdArc> dfst(*nfst, &cache);
+    for (StateIterator<StdVectorFst> riter(*rfst); !riter.Done();
+         riter.Next()) {
+      StateId rsrc = riter.Value();
+      for (ArcIterator<StdVectorFst> aiter(*rfst, rsrc); !aiter.Done();
+           aiter.Next()) {
+        StdArc rarc = aiter.Value(), darc;
+        num_lookups++;
+        bool found = dfst.GetArc(rsrc, rarc.ilabel, &darc);
+        KALDI_ASSERT(found);
+        KALDI_ASSERT(ApproxEqual(rarc.weight, darc.weight, 0.001));
+        KALDI_ASSERT(rarc.ilabel == darc.ilabel &&
+                     rarc.olabel == darc.olabel &&
+                     rarc.nextstate == darc.nextstate);
+      }
+    }
+  }
+  KALDI_ASSERT(cache.NumHits() + cache.NumMisses() == num_lookups);
+  cerr << "  " << cache.Info() << endl;
+  delete nfst;
+  delete rfst;
+}
+
 void TestCompose() {
   cout << "Test with single generated backoff FST" << endl;
   StdVectorFst *nfst = CreateBackoffFst();
@@ -224,6 +259,7 @@ void TestCompose() {
 int main() {
   using namespace fst;
   TestBackoffAndCache();
+  TestSharedArcCache();
   TestCompose();
 }
   
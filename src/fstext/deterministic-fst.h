@@ -57,6 +57,7 @@
 #include <fst/fst-decl.h>
 
 #include "util/stl-utils.h"
+#include "thread/kaldi-mutex.h"
 
 namespace fst {
 
@@ -87,6 +88,73 @@ class DeterministicOnDemandFst {
   virtual ~DeterministicOnDemandFst() { }
 };
 
+/**
+   SharedArcCache is a bounded cache of the arcs of a deterministic on-demand
+   acceptor such as a language model, that can be shared by several
+   DeterministicOnDemandFst objects for the same model: for example the ones
+   that rescore the lattices of a batch, possibly in different threads, which
+   ask for many of the same arcs.  The states are identified by 64-bit ids that
+   must mean the same thing in all the FSTs that share the cache (e.g. the state
+   ids in G.fst for BackoffDeterministicOnDemandFst, or the history-state ids in
+   the language model for ConstArpaLmDeterministicFst).
+
+   Like CacheDeterministicOnDemandFst, it is direct-mapped, so an arc replaces
+   whatever arc was in its slot.  The slots are guarded by a fixed set of
+   mutexes, so threads only contend when they access slots with the same lock.
+   Hits and misses are counted, to help choose the size.
+*/
+template<class Arc>
+class SharedArcCache {
+ public:
+  typedef typename Arc::Weight Weight;
+  typedef typename Arc::Label Label;
+
+  /// The cache holds up to <num_cached_arcs> arcs, divided between
+  /// <num_locks> mutexes.
+  explicit SharedArcCache(size_t num_cached_arcs = 1000000,
+                          int32 num_locks = 64);
+
+  ~SharedArcCache() { delete [] locks_; }
+
+  /// If the arc with label <label> leaving state <state> is in the cache,
+  /// outputs its next state and weight and returns true.
+  bool Find(int64 state, Label label, int64 *nextstate, Weight *weight);
+
+  /// Adds the arc with label <label> leaving state <state> to the cache.
+  void Insert(int64 state, Label label, int64 nextstate, Weight weight);
+
+  /// Returns the number of calls to Find() that found the arc.
+  int64 NumHits() const;
+
+  /// Returns the number of calls to Find() that did not find the arc.
+  int64 NumMisses() const;
+
+  /// Returns a string describing the hit rate; for diagnostics.
+  std::string Info() const;
+
+ private:
+  struct CachedArc {
+    int64 state;
+    Label label;  // 0 if the slot is unused; arcs with label 0 are never
+                  // looked up.
+    int64 nextstate;
+    Weight weight;
+  };
+
+  // Returns the slot for the arc.
+  inline size_t GetIndex(int64 state, Label label) const;
+
+  std::vector<CachedArc> cached_arcs_;
+  int32 num_locks_;
+  // The slots with index i are guarded by locks_[i % num_locks_].
+  kaldi::Mutex *locks_;
+  // Hit and miss counts for the slots guarded by each lock.
+  std::vector<int64> num_hits_;
+  std::vector<int64> num_misses_;
+
+  DISALLOW_COPY_AND_ASSIGN(SharedArcCache);
+};
+
 /**
    This class wraps a conventional Fst, representing a
    language model, in the interface for "BackoffDeterministicOnDemandFst".
@@ -103,7 +171,12 @@ class BackoffDeterministicOnDemandFst: public DeterministicOnDemandFst<Arc> {
   typedef typename Arc::StateId StateId;
   typedef typename Arc::Label Label;
   
-  BackoffDeterministicOnDemandFst(const Fst<Arc> &fst_);
+  /// If <cache> is not NULL, the arcs are looked up in it first, and added
+  /// to it when they are not found there.  <fst> must then be an acceptor;
+  /// this is only checked against the properties already stored in <fst>.
+  /// We don't take ownership of the cache.
+  BackoffDeterministicOnDemandFst(const Fst<Arc> &fst,
+                                  SharedArcCache<Arc> *cache = NULL);
   
   StateId Start() { return fst_.Start(); }
 
@@ -113,8 +186,12 @@ class BackoffDeterministicOnDemandFst: public DeterministicOnDemandFst<Arc> {
   
  private:
   inline StateId GetBackoffState(StateId s, Weight *w);
+
+  // Does what GetArc() does, without the cache.
+  bool GetArcNoCache(StateId s, Label ilabel, Arc *oarc);
   
   const Fst<Arc> &fst_;
+  SharedArcCache<Arc> *cache_;
 };
 
 /**
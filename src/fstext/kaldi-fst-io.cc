@@ -20,6 +20,7 @@
 // limitations under the License.
 
 #include "fstext/kaldi-fst-io.h"
+#include "fstext/mapped-const-fst.h"
 #include "base/kaldi-error.h"
 #include "base/kaldi-math.h"
 #include "util/kaldi-io.h"
@@ -58,4 +59,26 @@ void WriteFstKaldi(const VectorFst<StdArc> &fst,
   fst.Write(ko.Stream(), wopts);
 }
 
+Fst<StdArc> *ReadFstKaldiMapped(std::string rxfilename) {
+  if (rxfilename == "") rxfilename = "-"; // interpret "" as stdin,
+  // for compatibility with OpenFst conventions.
+  if (kaldi::ClassifyRxfilename(rxfilename) == kaldi::kFileInput) {
+    Fst<StdArc> *fst = MappedConstFst<StdArc>::Read(rxfilename);
+    if (fst != NULL)
+      return fst;
+    // else it's not in a format we can map, so read it normally.
+  }
+  kaldi::Input ki(rxfilename);
+  fst::FstHeader hdr;
+  if (!hdr.Read(ki.Stream(), rxfilename))
+    KALDI_ERR << "Reading FST: error reading FST header from "
+              << kaldi::PrintableRxfilename(rxfilename);
+  FstReadOptions ropts("<unspecified>", &hdr);
+  Fst<StdArc> *fst = Fst<StdArc>::Read(ki.Stream(), ropts);
+  if (!fst)
+    KALDI_ERR << "Could not read fst from "
+              << kaldi::PrintableRxfilename(rxfilename);
+  return fst;
+}
+
 } // end namespace fst
@@ -51,6 +51,15 @@ void ReadFstKaldi(std::string rxfilename, VectorFst<StdArc> *ofst);
 void WriteFstKaldi(const VectorFst<StdArc> &fst,
                    std::string wxfilename);
 
+// Reads a binary FST of any type that OpenFst can read (e.g. vector or const),
+// for use as a decoding graph.  If rxfilename is a file containing a ConstFst
+// with aligned data (as written by fstconvert-mapped), the file is
+// memory-mapped instead of being read (see MappedConstFst in
+// fstext/mapped-const-fst.h), so the graph loads almost instantly and its
+// memory is shared between all the processes that use it.  On error, throws
+// using KALDI_ERR.
+Fst<StdArc> *ReadFstKaldiMapped(std::string rxfilename);
+
 // This is a more general Kaldi-type-IO mechanism of writing FSTs to
 // streams, supporting binary or text-mode writing.  (note: we just
 // write the integers, symbol tables are not supported).
@@ -0,0 +1,96 @@
+// fstext/mapped-const-fst-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "fstext/rand-fst.h"
+#include "fstext/mapped-const-fst.h"
+#include "fstext/kaldi-fst-io.h"
+
+namespace fst {
+
+// Writes "fst" as a ConstFst to "filename".
+static void WriteConstFst(const Fst<StdArc> &fst, bool align,
+                          const std::string &filename) {
+  ConstFst<StdArc> const_fst(fst);
+  std::ofstream os(filename.c_str(), std::ios::out | std::ios::binary);
+  FstWriteOptions wopts(filename);
+  wopts.align = align;
+  bool ans = const_fst.Write(os, wopts);
+  assert(ans);
+}
+
+void TestMappedConstFst() {
+  std::string filename = "tmpf.fst";
+  RandFstOptions opts;
+  VectorFst<StdArc> *fst = RandFst<StdArc>(opts);
+  WriteConstFst(*fst, true, filename);
+
+  MappedConstFst<StdArc> *mapped_fst = MappedConstFst<StdArc>::Read(filename);
+  assert(mapped_fst != NULL);
+  assert(mapped_fst->NumStates() == fst->NumStates());
+  assert(Equal(*fst, *mapped_fst));
+  // Iterate with the specialized ArcIterator.
+  for (StateIterator<MappedConstFst<StdArc> > siter(*mapped_fst);
+       !siter.Done(); siter.Next()) {
+    StdArc::StateId s = siter.Value();
+    ArcIterator<VectorFst<StdArc> > aiter(*fst, s);
+    ArcIterator<MappedConstFst<StdArc> > mapped_aiter(*mapped_fst, s);
+    for (; !aiter.Done(); aiter.Next(), mapped_aiter.Next()) {
+      assert(!mapped_aiter.Done());
+      const StdArc &arc = aiter.Value(), &mapped_arc = mapped_aiter.Value();
+      assert(arc.ilabel == mapped_arc.ilabel && arc.olabel == mapped_arc.olabel &&
+             arc.nextstate == mapped_arc.nextstate &&
+             arc.weight == mapped_arc.weight);
+    }
+    assert(mapped_aiter.Done());
+  }
+  // Copies share the mapping, and remain valid after the original is deleted.
+  Fst<StdArc> *copy = mapped_fst->Copy();
+  delete mapped_fst;
+  assert(Equal(*fst, *copy));
+  delete copy;
+
+  // ReadFstKaldiMapped() maps the aligned ConstFst.
+  Fst<StdArc> *read_fst = ReadFstKaldiMapped(filename);
+  assert(Equal(*fst, *read_fst));
+  delete read_fst;
+
+  // Formats that cannot be mapped are read normally by ReadFstKaldiMapped().
+  WriteConstFst(*fst, false, filename);
+  assert(MappedConstFst<StdArc>::Read(filename) == NULL);
+  read_fst = ReadFstKaldiMapped(filename);
+  assert(Equal(*fst, *read_fst));
+  delete read_fst;
+
+  WriteFstKaldi(*fst, filename);
+  assert(MappedConstFst<StdArc>::Read(filename) == NULL);
+  read_fst = ReadFstKaldiMapped(filename);
+  assert(Equal(*fst, *read_fst));
+  delete read_fst;
+
+  delete fst;
+  unlink(filename.c_str());
+}
+
+} // end namespace fst
+
+int main() {
+  using namespace fst;
+  for (int i = 0; i < 10; i++) {
+    TestMappedConstFst();
+  }
+  std::cout << "Test OK\n";
+}
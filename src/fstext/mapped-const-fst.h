@@ -0,0 +1,291 @@
+// fstext/mapped-const-fst.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_FSTEXT_MAPPED_CONST_FST_H_
+#define KALDI_FSTEXT_MAPPED_CONST_FST_H_
+
+#include <fstream>
+#include <string>
+#include <fst/fstlib.h>
+#include "base/kaldi-common.h"
+#include "util/mapped-file.h"
+
+namespace fst {
+
+/*
+   MappedConstFst is a read-only FST that uses the data of a ConstFst file in
+   place, by memory-mapping the file (see kaldi::MappedFile), instead of reading
+   it into memory.  This is useful for large decoding graphs (HCLG.fst): the
+   pages of the file are shared, via the page cache, between all the processes
+   on a machine that decode with the same graph, and loading the graph takes
+   essentially no time because nothing is parsed or copied.
+
+   The file must be a ConstFst written with the data aligned (FstWriteOptions
+   with align == true), to a seekable file; fstconvert-mapped writes graphs in
+   this format.  The arc type must be the one this class is instantiated with,
+   and the ConstFst must have the default (uint32) index type.
+
+   Decoders that iterate with ArcIterator< Fst<Arc> > (i.e. through the
+   Fst<Arc> interface) get the arcs as a plain array from InitArcIterator(), so
+   access is as fast as for an in-memory ConstFst.
+*/
+
+template<class A> class MappedConstFst;
+
+template<class A>
+class MappedConstFstImpl : public FstImpl<A> {
+ public:
+  using FstImpl<A>::SetType;
+  using FstImpl<A>::SetProperties;
+  using FstImpl<A>::Properties;
+
+  typedef A Arc;
+  typedef typename A::Weight Weight;
+  typedef typename A::StateId StateId;
+
+  MappedConstFstImpl(): mapped_file_(NULL), states_(NULL), arcs_(NULL),
+                        nstates_(0), narcs_(0), start_(kNoStateId) {
+    SetType("const");
+    SetProperties(kNullProperties | kExpanded);
+  }
+
+  ~MappedConstFstImpl() { delete mapped_file_; }
+
+  StateId Start() const { return start_; }
+  Weight Final(StateId s) const { return states_[s].final; }
+  StateId NumStates() const { return nstates_; }
+  size_t NumArcs(StateId s) const { return states_[s].narcs; }
+  size_t NumInputEpsilons(StateId s) const { return states_[s].niepsilons; }
+  size_t NumOutputEpsilons(StateId s) const { return states_[s].noepsilons; }
+
+  const A *Arcs(StateId s) const { return arcs_ + states_[s].pos; }
+
+  void InitStateIterator(StateIteratorData<A> *data) const {
+    data->base = NULL;
+    data->nstates = nstates_;
+  }
+
+  void InitArcIterator(StateId s, ArcIteratorData<A> *data) const {
+    data->base = NULL;
+    data->arcs = arcs_ + states_[s].pos;
+    data->narcs = states_[s].narcs;
+    data->ref_count = NULL;
+  }
+
+  // Maps the FST in the file "filename".  Returns NULL if the file is not an
+  // aligned ConstFst with arc type A, in which case it cannot be mapped and
+  // should be read in the normal way.  Throws on other errors.
+  static MappedConstFstImpl<A> *Read(const std::string &filename);
+
+ private:
+  // This must have the same layout as ConstFstImpl<A, uint32>::State, which is
+  // what ConstFst writes to disk.
+  struct State {
+    Weight final;        // Final weight
+    uint32 pos;          // Start of state's arcs in *arcs_
+    uint32 narcs;        // Number of arcs (per state)
+    uint32 niepsilons;   // # of input epsilons
+    uint32 noepsilons;   // # of output epsilons
+  };
+
+  // In aligned ConstFst files, the states and the arcs each start at an offset
+  // in the file that is a multiple of this (the same as OpenFst's kFileAlign).
+  static const int64 kDataAlign = 16;
+  // Version 1 of the ConstFst format is always aligned; later versions are
+  // aligned if the header says so.
+  static const int32 kAlignedFileVersion = 1;
+
+  kaldi::MappedFile *mapped_file_;
+  const State *states_;
+  const A *arcs_;
+  StateId nstates_;
+  size_t narcs_;
+  StateId start_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(MappedConstFstImpl);
+};
+
+
+template<class A>
+MappedConstFstImpl<A> *MappedConstFstImpl<A>::Read(
+    const std::string &filename) {
+  std::ifstream strm(filename.c_str(), std::ios::in | std::ios::binary);
+  if (!strm.is_open())
+    KALDI_ERR << "Could not open " << filename << " for reading.";
+  FstHeader file_hdr;
+  if (!file_hdr.Read(strm, filename))
+    KALDI_ERR << "Error reading FST header from " << filename;
+  bool aligned = (file_hdr.Version() == kAlignedFileVersion ||
+                  (file_hdr.GetFlags() & FstHeader::IS_ALIGNED) != 0);
+  if (file_hdr.FstType() != "const" || file_hdr.ArcType() != A::Type() ||
+      !aligned)
+    return NULL;
+
+  MappedConstFstImpl<A> *impl = new MappedConstFstImpl<A>();
+  FstHeader hdr;
+  FstReadOptions opts(filename, &file_hdr);
+  // This sets the properties, and reads any symbol tables.
+  if (!impl->ReadHeader(strm, opts, kAlignedFileVersion, &hdr)) {
+    delete impl;
+    KALDI_ERR << "Error reading FST header from " << filename;
+  }
+  int64 pos = strm.tellg();
+  if (pos < 0) {
+    delete impl;
+    KALDI_ERR << "Error reading FST from " << filename;
+  }
+  strm.close();
+
+  impl->start_ = hdr.Start();
+  impl->nstates_ = hdr.NumStates();
+  impl->narcs_ = hdr.NumArcs();
+  int64 states_offset = (pos + kDataAlign - 1) / kDataAlign * kDataAlign,
+      states_end = states_offset + sizeof(State) * impl->nstates_,
+      arcs_offset = (states_end + kDataAlign - 1) / kDataAlign * kDataAlign,
+      arcs_end = arcs_offset + sizeof(A) * impl->narcs_;
+
+  impl->mapped_file_ = new kaldi::MappedFile(filename);
+  if (arcs_end > static_cast<int64>(impl->mapped_file_->Size())) {
+    delete impl;
+    KALDI_ERR << "FST file " << filename << " is too short (truncated?)";
+  }
+  const char *data = impl->mapped_file_->Data();
+  impl->states_ = reinterpret_cast<const State*>(data + states_offset);
+  impl->arcs_ = reinterpret_cast<const A*>(data + arcs_offset);
+  return impl;
+}
+
+
+template<class A>
+class MappedConstFst : public ExpandedFst<A> {
+ public:
+  friend class ArcIterator< MappedConstFst<A> >;
+
+  typedef A Arc;
+  typedef typename A::Weight Weight;
+  typedef typename A::StateId StateId;
+  typedef MappedConstFstImpl<A> Impl;
+
+  // Copies are cheap, they share the mapping.
+  MappedConstFst(const MappedConstFst<A> &fst): impl_(fst.impl_) {
+    impl_->IncrRefCount();
+  }
+
+  virtual ~MappedConstFst() { if (!impl_->DecrRefCount()) delete impl_; }
+
+  // Maps the FST in the file "filename"; see MappedConstFstImpl::Read().
+  // Returns NULL if the file is not in a format that can be mapped.
+  static MappedConstFst<A> *Read(const std::string &filename) {
+    Impl *impl = Impl::Read(filename);
+    return (impl == NULL ? NULL : new MappedConstFst<A>(impl));
+  }
+
+  virtual StateId Start() const { return impl_->Start(); }
+
+  virtual Weight Final(StateId s) const { return impl_->Final(s); }
+
+  virtual StateId NumStates() const { return impl_->NumStates(); }
+
+  virtual size_t NumArcs(StateId s) const { return impl_->NumArcs(s); }
+
+  virtual size_t NumInputEpsilons(StateId s) const {
+    return impl_->NumInputEpsilons(s);
+  }
+
+  virtual size_t NumOutputEpsilons(StateId s) const {
+    return impl_->NumOutputEpsilons(s);
+  }
+
+  virtual uint64 Properties(uint64 mask, bool test) const {
+    if (test) {
+      uint64 known, test = TestProperties(*this, mask, &known);
+      impl_->SetProperties(test, known);
+      return test & mask;
+    } else {
+      return impl_->Properties(mask);
+    }
+  }
+
+  virtual const string& Type() const { return impl_->Type(); }
+
+  // The data is read-only, so "safe" copies may share it too.
+  virtual MappedConstFst<A> *Copy(bool safe = false) const {
+    return new MappedConstFst<A>(*this);
+  }
+
+  virtual const SymbolTable* InputSymbols() const {
+    return impl_->InputSymbols();
+  }
+
+  virtual const SymbolTable* OutputSymbols() const {
+    return impl_->OutputSymbols();
+  }
+
+  virtual void InitStateIterator(StateIteratorData<A> *data) const {
+    impl_->InitStateIterator(data);
+  }
+
+  virtual void InitArcIterator(StateId s, ArcIteratorData<A> *data) const {
+    impl_->InitArcIterator(s, data);
+  }
+
+ private:
+  explicit MappedConstFst(Impl *impl): impl_(impl) { }
+
+  Impl *impl_;
+
+  void operator = (const MappedConstFst<A> &fst);  // disallow
+};
+
+
+// Specialization for MappedConstFst; avoids the virtual call to
+// InitArcIterator() when the FST type is known at compile time.
+template<class A>
+class ArcIterator< MappedConstFst<A> > {
+ public:
+  typedef typename A::StateId StateId;
+
+  ArcIterator(const MappedConstFst<A> &fst, StateId s)
+      : arcs_(fst.impl_->Arcs(s)), narcs_(fst.impl_->NumArcs(s)), i_(0) { }
+
+  bool Done() const { return i_ >= narcs_; }
+
+  const A& Value() const { return arcs_[i_]; }
+
+  void Next() { ++i_; }
+
+  size_t Position() const { return i_; }
+
+  void Reset() { i_ = 0; }
+
+  void Seek(size_t a) { i_ = a; }
+
+  uint32 Flags() const { return kArcValueFlags; }
+
+  void SetFlags(uint32 f, uint32 m) { }
+
+ private:
+  const A *arcs_;
+  size_t narcs_;
+  size_t i_;
+  DISALLOW_COPY_AND_ASSIGN(ArcIterator);
+};
+
+
+}  // namespace fst
+
+#endif  // KALDI_FSTEXT_MAPPED_CONST_FST_H_
@@ -26,6 +26,7 @@
 
 #include "base/kaldi-common.h"
 #include "gmm/am-diag-gmm.h"
+#include "gmm/stacked-am-diag-gmm.h"
 #include "hmm/transition-model.h"
 #include "itf/decodable-itf.h"
 #include "transform/regression-tree.h"
@@ -159,6 +160,71 @@ class DecodableAmDiagGmmScaled: public DecodableAmDiagGmmUnmapped {
   KALDI_DISALLOW_COPY_AND_ASSIGN(DecodableAmDiagGmmScaled);
 };
 
+/// DecodableAmDiagGmmStacked computes the same (scaled) likelihoods as
+/// DecodableAmDiagGmmScaled, but using a StackedAmDiagGmm, which computes the
+/// likelihoods of each pdf for a block of frames at once (and can optionally
+/// do Gaussian selection).  The StackedAmDiagGmm is not changed, so one copy
+/// may be shared by decoders in several threads.
+class DecodableAmDiagGmmStacked: public DecodableInterface {
+ public:
+  DecodableAmDiagGmmStacked(const StackedAmDiagGmm &gmm,
+                            const TransitionModel &tm,
+                            const Matrix<BaseFloat> &feats,
+                            BaseFloat scale,
+                            BaseFloat log_sum_exp_prune = -1.0):
+      computer_(gmm, log_sum_exp_prune), trans_model_(tm),
+      feature_matrix_(feats), batch_size_(gmm.FrameBatchSize()),
+      scale_(scale), delete_feats_(NULL) {}
+
+  // This version of the initializer takes ownership of the pointer
+  // "feats" and will delete it when this class is destroyed.
+  DecodableAmDiagGmmStacked(const StackedAmDiagGmm &gmm,
+                            const TransitionModel &tm,
+                            BaseFloat scale,
+                            BaseFloat log_sum_exp_prune,
+                            Matrix<BaseFloat> *feats):
+      computer_(gmm, log_sum_exp_prune), trans_model_(tm),
+      feature_matrix_(*feats), batch_size_(gmm.FrameBatchSize()),
+      scale_(scale), delete_feats_(feats) {}
+
+  // Note, frames are numbered from zero but transition-ids from one.
+  virtual BaseFloat LogLikelihood(int32 frame, int32 tid) {
+    if (!computer_.HasFrame(frame)) {
+      KALDI_ASSERT(static_cast<size_t>(frame) <
+                   static_cast<size_t>(NumFramesReady()));
+      int32 num_frames = std::min(batch_size_, NumFramesReady() - frame);
+      computer_.SetFrames(frame, feature_matrix_.RowRange(frame, num_frames));
+    }
+    return scale_ * computer_.LogLikelihood(frame,
+                                            trans_model_.TransitionIdToPdf(tid));
+  }
+
+  virtual int32 NumFramesReady() const { return feature_matrix_.NumRows(); }
+
+  virtual bool IsLastFrame(int32 frame) const {
+    KALDI_ASSERT(frame < NumFramesReady());
+    return (frame == NumFramesReady() - 1);
+  }
+
+  // Indices are one-based!  This is for compatibility with OpenFst.
+  virtual int32 NumIndices() const { return trans_model_.NumTransitionIds(); }
+
+  const TransitionModel *TransModel() { return &trans_model_; }
+
+  virtual ~DecodableAmDiagGmmStacked() {
+    delete delete_feats_;
+  }
+
+ private:
+  StackedAmDiagGmmComputer computer_;
+  const TransitionModel &trans_model_;  // for transition-id to pdf mapping
+  const Matrix<BaseFloat> &feature_matrix_;
+  int32 batch_size_;
+  BaseFloat scale_;
+  Matrix<BaseFloat> *delete_feats_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(DecodableAmDiagGmmStacked);
+};
+
 }  // namespace kaldi
 
 #endif  // KALDI_GMM_DECODABLE_AM_DIAG_GMM_H_
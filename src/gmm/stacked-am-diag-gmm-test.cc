@@ -0,0 +1,99 @@
+// gmm/stacked-am-diag-gmm-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "gmm/model-test-common.h"
+#include "gmm/stacked-am-diag-gmm.h"
+
+namespace kaldi {
+
+// Computes the log-likelihoods of all pdfs for "feats" with
+// StackedAmDiagGmmComputer, visiting the pdfs in a random order for each
+// frame, and checks them against AmDiagGmm::LogLikelihood().  If "exact" is
+// false (Gaussian selection with short lists), only checks that the answers
+// are no greater than the exact ones, since they sum over fewer Gaussians.
+static void CheckStackedLogLikelihoods(const AmDiagGmm &am,
+                                       const StackedAmDiagGmm &stacked,
+                                       const Matrix<BaseFloat> &feats,
+                                       bool exact) {
+  StackedAmDiagGmmComputer computer(stacked);
+  int32 num_frames = feats.NumRows(), num_pdfs = am.NumPdfs();
+  for (int32 t = 0; t < num_frames; t++) {
+    if (!computer.HasFrame(t)) {
+      int32 n = std::min(stacked.FrameBatchSize(), num_frames - t);
+      computer.SetFrames(t, feats.RowRange(t, n));
+    }
+    KALDI_ASSERT(computer.HasFrame(t));
+    for (int32 i = 0; i < num_pdfs; i++) {
+      int32 pdf_id = RandInt(0, num_pdfs - 1);
+      BaseFloat a = computer.LogLikelihood(t, pdf_id),
+          b = am.LogLikelihood(pdf_id, feats.Row(t));
+      if (exact)
+        AssertEqual(a, b, 1.0e-03);
+      else
+        KALDI_ASSERT(a <= b + 1.0e-03 * std::abs(b) + 1.0e-03);
+    }
+  }
+}
+
+static void UnitTestStackedAmDiagGmm() {
+  int32 dim = 1 + RandInt(0, 9),
+      num_pdfs = 5 + RandInt(0, 9),
+      max_comp = 0;
+
+  AmDiagGmm am;
+  for (int32 i = 0; i < num_pdfs; i++) {
+    int32 num_comp = 1 + RandInt(0, 9);
+    DiagGmm gmm;
+    unittest::InitRandDiagGmm(dim, num_comp, &gmm);
+    am.AddPdf(gmm);
+    max_comp = std::max(max_comp, num_comp);
+  }
+  Matrix<BaseFloat> feats(1 + RandInt(0, 20), dim);
+  feats.SetRandn();
+
+  StackedAmDiagGmmOptions opts;
+  opts.frame_batch_size = 1 + RandInt(0, 7);
+  {
+    StackedAmDiagGmm stacked(am, opts);
+    KALDI_ASSERT(stacked.NumPdfs() == num_pdfs && stacked.Dim() == dim &&
+                 stacked.NumGauss() == am.NumGauss() && !stacked.UsesGselect());
+    CheckStackedLogLikelihoods(am, stacked, feats, true);
+  }
+  // Gaussian selection with short lists that contain all the Gaussians is
+  // exact.
+  opts.gselect_codebook_size = 1 + RandInt(0, 9);
+  opts.num_gselect = max_comp;
+  {
+    StackedAmDiagGmm stacked(am, opts);
+    KALDI_ASSERT(stacked.UsesGselect());
+    CheckStackedLogLikelihoods(am, stacked, feats, true);
+  }
+  opts.num_gselect = 1 + RandInt(0, 2);
+  {
+    StackedAmDiagGmm stacked(am, opts);
+    CheckStackedLogLikelihoods(am, stacked, feats, false);
+  }
+}
+
+}  // namespace kaldi
+
+int main() {
+  for (int i = 0; i < 10; i++)
+    kaldi::UnitTestStackedAmDiagGmm();
+  std::cout << "Test OK.\n";
+  return 0;
+}
@@ -0,0 +1,297 @@
+// gmm/stacked-am-diag-gmm.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "gmm/stacked-am-diag-gmm.h"
+
+namespace kaldi {
+
+// For each row of "feats", outputs the index of the row of "codebook" that is
+// closest in Euclidean distance.  "codebook_norms" contains -0.5 times the
+// squared norms of the rows of "codebook".  Works on chunks of rows, to limit
+// the memory used.
+static void NearestCodewords(const MatrixBase<BaseFloat> &feats,
+                             const MatrixBase<BaseFloat> &codebook,
+                             const VectorBase<BaseFloat> &codebook_norms,
+                             std::vector<int32> *codewords) {
+  int32 num_rows = feats.NumRows(), chunk_size = 1024;
+  codewords->resize(num_rows);
+  Matrix<BaseFloat> scores;
+  for (int32 start = 0; start < num_rows; start += chunk_size) {
+    int32 this_num_rows = std::min(chunk_size, num_rows - start);
+    scores.Resize(this_num_rows, codebook.NumRows(), kUndefined);
+    // argmin of the distance |x - c|^2 is the argmax of x.c - 0.5 |c|^2.
+    scores.CopyRowsFromVec(codebook_norms);
+    scores.AddMatMat(1.0, feats.RowRange(start, this_num_rows), kNoTrans,
+                     codebook, kTrans, 1.0);
+    for (int32 i = 0; i < this_num_rows; i++) {
+      MatrixIndexT index;
+      scores.Row(i).Max(&index);
+      (*codewords)[start + i] = index;
+    }
+  }
+}
+
+// Sets "norms" to -0.5 times the squared norms of the rows of "mat".
+static void GetHalfNegSquaredNorms(const MatrixBase<BaseFloat> &mat,
+                                   Vector<BaseFloat> *norms) {
+  norms->Resize(mat.NumRows(), kUndefined);
+  norms->AddDiagMat2(-0.5, mat, kNoTrans, 0.0);
+}
+
+
+StackedAmDiagGmm::StackedAmDiagGmm(const AmDiagGmm &am,
+                                   const StackedAmDiagGmmOptions &opts):
+    opts_(opts), dim_(am.Dim()), max_pdf_gauss_(0) {
+  KALDI_ASSERT(opts.frame_batch_size > 0 && am.NumPdfs() > 0);
+  int32 num_pdfs = am.NumPdfs(), num_gauss = am.NumGauss();
+  pdf_offsets_.resize(num_pdfs + 1);
+  params_.Resize(num_gauss, 2 * dim_, kUndefined);
+  gconsts_.Resize(num_gauss, kUndefined);
+  int32 offset = 0;
+  for (int32 pdf_id = 0; pdf_id < num_pdfs; pdf_id++) {
+    const DiagGmm &pdf = am.GetPdf(pdf_id);
+    if (!pdf.valid_gconsts())
+      KALDI_ERR << "State " << pdf_id << ": Must call ComputeGconsts() "
+          "before computing likelihood.";
+    int32 n = pdf.NumGauss();
+    pdf_offsets_[pdf_id] = offset;
+    params_.Range(offset, n, 0, dim_).CopyFromMat(pdf.means_invvars());
+    SubMatrix<BaseFloat> neg_half_inv_vars(params_, offset, n, dim_, dim_);
+    neg_half_inv_vars.CopyFromMat(pdf.inv_vars());
+    neg_half_inv_vars.Scale(-0.5);
+    gconsts_.Range(offset, n).CopyFromVec(pdf.gconsts());
+    max_pdf_gauss_ = std::max(max_pdf_gauss_, n);
+    offset += n;
+  }
+  pdf_offsets_[num_pdfs] = offset;
+  if (opts.gselect_codebook_size > 0)
+    InitGselect(am);
+}
+
+void StackedAmDiagGmm::InitGselect(const AmDiagGmm &am) {
+  KALDI_ASSERT(opts_.num_gselect > 0);
+  int32 num_pdfs = NumPdfs(), num_gauss = NumGauss(),
+      num_codewords = std::min(opts_.gselect_codebook_size, num_gauss);
+
+  // Get the means, scaled by the inverse of the average standard deviation.
+  Matrix<BaseFloat> means(num_gauss, dim_, kUndefined);
+  Vector<BaseFloat> avg_var(dim_);
+  for (int32 pdf_id = 0; pdf_id < num_pdfs; pdf_id++) {
+    const DiagGmm &pdf = am.GetPdf(pdf_id);
+    Matrix<BaseFloat> pdf_means, pdf_vars;
+    pdf.GetMeans(&pdf_means);
+    pdf.GetVars(&pdf_vars);
+    means.RowRange(pdf_offsets_[pdf_id], pdf.NumGauss()).CopyFromMat(pdf_means);
+    avg_var.AddRowSumMat(1.0 / num_gauss, pdf_vars, 1.0);
+  }
+  codebook_scale_ = avg_var;
+  codebook_scale_.ApplyPow(-0.5);
+  means.MulColsVec(codebook_scale_);
+
+  // A few iterations of k-means, initialized with evenly spaced Gaussians.
+  codebook_.Resize(num_codewords, dim_, kUndefined);
+  for (int32 k = 0; k < num_codewords; k++)
+    codebook_.Row(k).CopyFromVec(
+        means.Row(static_cast<int64>(k) * num_gauss / num_codewords));
+  std::vector<int32> assignment;
+  Matrix<BaseFloat> sums(num_codewords, dim_);
+  std::vector<int32> counts(num_codewords);
+  const int32 num_iters = 5;
+  for (int32 iter = 0; iter < num_iters; iter++) {
+    GetHalfNegSquaredNorms(codebook_, &codebook_norms_);
+    NearestCodewords(means, codebook_, codebook_norms_, &assignment);
+    sums.SetZero();
+    std::fill(counts.begin(), counts.end(), 0);
+    for (int32 g = 0; g < num_gauss; g++) {
+      sums.Row(assignment[g]).AddVec(1.0, means.Row(g));
+      counts[assignment[g]]++;
+    }
+    for (int32 k = 0; k < num_codewords; k++) {
+      if (counts[k] > 0) {  // else leave the codeword where it was.
+        codebook_.Row(k).CopyFromVec(sums.Row(k));
+        codebook_.Row(k).Scale(1.0 / counts[k]);
+      }
+    }
+  }
+  GetHalfNegSquaredNorms(codebook_, &codebook_norms_);
+
+  // For each codeword and pdf, the shortlist is the num_gselect Gaussians with
+  // the highest log-likelihood at the codeword.  We compute the likelihoods
+  // of all Gaussians at a chunk of codewords at a time.
+  shortlist_offsets_.resize(static_cast<size_t>(num_codewords) * num_pdfs + 1);
+  shortlist_.clear();
+  int32 chunk_size = std::max(1, std::min(num_codewords,
+                                          (1 << 22) / num_gauss));
+  Vector<BaseFloat> inv_scale(codebook_scale_);
+  inv_scale.InvertElements();
+  Matrix<BaseFloat> centers, scores;
+  std::vector<std::pair<BaseFloat, int32> > pdf_scores;
+  for (int32 start = 0; start < num_codewords; start += chunk_size) {
+    int32 this_chunk_size = std::min(chunk_size, num_codewords - start);
+    centers.Resize(this_chunk_size, 2 * dim_, kUndefined);
+    SubMatrix<BaseFloat> x(centers, 0, this_chunk_size, 0, dim_),
+        x2(centers, 0, this_chunk_size, dim_, dim_);
+    x.CopyFromMat(codebook_.RowRange(start, this_chunk_size));
+    x.MulColsVec(inv_scale);  // back to the original feature space.
+    x2.CopyFromMat(x);
+    x2.MulElements(x);
+    scores.Resize(this_chunk_size, num_gauss, kUndefined);
+    scores.CopyRowsFromVec(gconsts_);
+    scores.AddMatMat(1.0, centers, kNoTrans, params_, kTrans, 1.0);
+    for (int32 i = 0; i < this_chunk_size; i++) {
+      size_t k = start + i;
+      for (int32 pdf_id = 0; pdf_id < num_pdfs; pdf_id++) {
+        shortlist_offsets_[k * num_pdfs + pdf_id] = shortlist_.size();
+        int32 begin = pdf_offsets_[pdf_id], end = pdf_offsets_[pdf_id + 1];
+        if (end - begin <= opts_.num_gselect) {
+          for (int32 g = begin; g < end; g++)
+            shortlist_.push_back(g);
+          continue;
+        }
+        pdf_scores.clear();
+        for (int32 g = begin; g < end; g++)
+          pdf_scores.push_back(std::make_pair(scores(i, g), g));
+        std::nth_element(pdf_scores.begin(),
+                         pdf_scores.begin() + opts_.num_gselect,
+                         pdf_scores.end(),
+                         std::greater<std::pair<BaseFloat, int32> >());
+        size_t list_begin = shortlist_.size();
+        for (int32 j = 0; j < opts_.num_gselect; j++)
+          shortlist_.push_back(pdf_scores[j].second);
+        std::sort(shortlist_.begin() + list_begin, shortlist_.end());
+      }
+    }
+  }
+  shortlist_offsets_.back() = shortlist_.size();
+  KALDI_VLOG(1) << "Initialized Gaussian selection with " << num_codewords
+                << " codewords; " << shortlist_.size() << " shortlist entries.";
+}
+
+void StackedAmDiagGmm::FindCodewords(const MatrixBase<BaseFloat> &feats,
+                                     std::vector<int32> *codewords) const {
+  KALDI_ASSERT(UsesGselect());
+  Matrix<BaseFloat> scaled_feats(feats);
+  scaled_feats.MulColsVec(codebook_scale_);
+  NearestCodewords(scaled_feats, codebook_, codebook_norms_, codewords);
+}
+
+
+StackedAmDiagGmmComputer::StackedAmDiagGmmComputer(
+    const StackedAmDiagGmm &gmm, BaseFloat log_sum_exp_prune):
+    gmm_(gmm), log_sum_exp_prune_(log_sum_exp_prune), first_frame_(-1),
+    computed_(gmm.NumPdfs(), -1), block_index_(-1) {
+  if (gmm.UsesGselect()) {
+    selected_params_.Resize(gmm.max_pdf_gauss_, 2 * gmm.Dim(), kUndefined);
+    selected_gconsts_.Resize(gmm.max_pdf_gauss_, kUndefined);
+    selected_position_.resize(gmm.max_pdf_gauss_, -1);
+    frame_scores_.Resize(std::min(gmm.max_pdf_gauss_,
+                                  gmm.opts_.num_gselect), kUndefined);
+  }
+}
+
+void StackedAmDiagGmmComputer::SetFrames(int32 first_frame,
+                                         const MatrixBase<BaseFloat> &feats) {
+  int32 num_frames = feats.NumRows(), dim = gmm_.Dim();
+  KALDI_ASSERT(first_frame >= 0 && num_frames > 0);
+  if (feats.NumCols() != dim) {
+    KALDI_ERR << "Dim mismatch: data dim = "  << feats.NumCols()
+              << " vs. model dim = " << dim;
+  }
+  if (feats_.NumRows() != num_frames) {
+    feats_.Resize(num_frames, 2 * dim, kUndefined);
+    loglikes_.Resize(gmm_.NumPdfs(), num_frames, kUndefined);
+    scores_.Resize(num_frames, gmm_.max_pdf_gauss_, kUndefined);
+  }
+  SubMatrix<BaseFloat> x(feats_, 0, num_frames, 0, dim),
+      x2(feats_, 0, num_frames, dim, dim);
+  x.CopyFromMat(feats);
+  x2.CopyFromMat(feats);
+  x2.MulElements(feats);
+  if (gmm_.UsesGselect())
+    gmm_.FindCodewords(feats, &codewords_);
+  first_frame_ = first_frame;
+  block_index_++;
+}
+
+void StackedAmDiagGmmComputer::ComputePdf(int32 pdf_id) {
+  int32 num_frames = feats_.NumRows();
+  SubVector<BaseFloat> loglikes(loglikes_, pdf_id);
+  if (gmm_.UsesGselect()) {
+    ComputePdfGselect(pdf_id, &loglikes);
+  } else {
+    int32 offset = gmm_.pdf_offsets_[pdf_id],
+        num_gauss = gmm_.pdf_offsets_[pdf_id + 1] - offset;
+    SubMatrix<BaseFloat> scores(scores_, 0, num_frames, 0, num_gauss);
+    scores.CopyRowsFromVec(gmm_.gconsts_.Range(offset, num_gauss));
+    scores.AddMatMat(1.0, feats_, kNoTrans,
+                     gmm_.params_.RowRange(offset, num_gauss), kTrans, 1.0);
+    for (int32 f = 0; f < num_frames; f++)
+      loglikes(f) = scores.Row(f).LogSumExp(log_sum_exp_prune_);
+  }
+  for (int32 f = 0; f < num_frames; f++)
+    if (KALDI_ISNAN(loglikes(f)) || KALDI_ISINF(loglikes(f)))
+      KALDI_ERR << "Invalid answer (overflow or invalid variances/features?)";
+}
+
+void StackedAmDiagGmmComputer::ComputePdfGselect(
+    int32 pdf_id, SubVector<BaseFloat> *loglikes) {
+  int32 num_frames = feats_.NumRows(),
+      offset = gmm_.pdf_offsets_[pdf_id];
+  // Get the union of the shortlists of all frames of the block; the position
+  // of Gaussian g in selected_ is selected_position_[g - offset].
+  selected_.clear();
+  for (int32 f = 0; f < num_frames; f++) {
+    const int32 *gauss;
+    int32 n = gmm_.Shortlist(codewords_[f], pdf_id, &gauss);
+    for (int32 i = 0; i < n; i++) {
+      int32 &position = selected_position_[gauss[i] - offset];
+      if (position == -1) {
+        position = selected_.size();
+        selected_.push_back(gauss[i]);
+      }
+    }
+  }
+  int32 num_selected = selected_.size();
+  SubMatrix<BaseFloat> params(selected_params_, 0, num_selected,
+                              0, 2 * gmm_.Dim());
+  SubVector<BaseFloat> gconsts(selected_gconsts_, 0, num_selected);
+  for (int32 i = 0; i < num_selected; i++) {
+    params.Row(i).CopyFromVec(gmm_.params_.Row(selected_[i]));
+    gconsts(i) = gmm_.gconsts_(selected_[i]);
+  }
+  SubMatrix<BaseFloat> scores(scores_, 0, num_frames, 0, num_selected);
+  scores.CopyRowsFromVec(gconsts);
+  scores.AddMatMat(1.0, feats_, kNoTrans, params, kTrans, 1.0);
+  // Each frame only uses the Gaussians in its own shortlist.
+  for (int32 f = 0; f < num_frames; f++) {
+    const int32 *gauss;
+    int32 n = gmm_.Shortlist(codewords_[f], pdf_id, &gauss);
+    SubVector<BaseFloat> frame_scores(frame_scores_, 0, n);
+    for (int32 i = 0; i < n; i++)
+      frame_scores(i) = scores(f, selected_position_[gauss[i] - offset]);
+    (*loglikes)(f) = frame_scores.LogSumExp(log_sum_exp_prune_);
+  }
+  for (int32 i = 0; i < num_selected; i++)
+    selected_position_[selected_[i] - offset] = -1;
+}
+
+}  // namespace kaldi
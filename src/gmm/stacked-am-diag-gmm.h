@@ -0,0 +1,196 @@
+// gmm/stacked-am-diag-gmm.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_GMM_STACKED_AM_DIAG_GMM_H_
+#define KALDI_GMM_STACKED_AM_DIAG_GMM_H_
+
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "gmm/am-diag-gmm.h"
+#include "itf/options-itf.h"
+
+namespace kaldi {
+
+struct StackedAmDiagGmmOptions {
+  int32 frame_batch_size;
+  int32 gselect_codebook_size;
+  int32 num_gselect;
+
+  StackedAmDiagGmmOptions(): frame_batch_size(4), gselect_codebook_size(0),
+                             num_gselect(8) { }
+
+  void Register(OptionsItf *opts) {
+    opts->Register("gmm-frame-batch-size", &frame_batch_size, "Number of "
+                   "frames for which a pdf's likelihood is computed at once, "
+                   "when it is first needed.  Larger values make better use "
+                   "of the matrix library, but compute more likelihoods that "
+                   "the decoder does not use.");
+    opts->Register("gmm-gselect-codebook-size", &gselect_codebook_size,
+                   "If >0, the Gaussian means are clustered into this many "
+                   "codewords, and for each frame only the --gmm-num-gselect "
+                   "Gaussians of each pdf that are best for the frame's "
+                   "codeword are evaluated.  Approximate; 0 means evaluate "
+                   "all Gaussians.");
+    opts->Register("gmm-num-gselect", &num_gselect, "Number of Gaussians per "
+                   "pdf that are evaluated for each frame, if "
+                   "--gmm-gselect-codebook-size > 0.");
+  }
+};
+
+
+/// StackedAmDiagGmm is a copy of the parameters of an AmDiagGmm in a form
+/// that allows the likelihoods of a pdf to be computed for several frames with
+/// one matrix multiplication: the Gaussians of all pdfs are stacked as rows of
+/// a matrix, each row containing [ means * inv_vars, -0.5 * inv_vars ], so
+/// that the log-likelihoods of a block of frames are the products with
+/// [ x, x^2 ] plus the gconsts.  It can optionally do Gaussian selection
+/// based on a vector-quantization codebook of the means: for each codeword
+/// and pdf, it stores a short list of the Gaussians that are most likely at
+/// the codeword, and only those are evaluated for frames that quantize to it.
+///
+/// This object is not changed after it is constructed, so a single copy can
+/// be shared by several decoding threads; the per-utterance state is in class
+/// StackedAmDiagGmmComputer.
+class StackedAmDiagGmm {
+ public:
+  /// The AmDiagGmm must have valid gconsts.  It is not referred to after the
+  /// constructor returns.
+  StackedAmDiagGmm(const AmDiagGmm &am,
+                   const StackedAmDiagGmmOptions &opts);
+
+  int32 Dim() const { return dim_; }
+  int32 NumPdfs() const { return static_cast<int32>(pdf_offsets_.size()) - 1; }
+  int32 NumGauss() const { return params_.NumRows(); }
+  int32 FrameBatchSize() const { return opts_.frame_batch_size; }
+  bool UsesGselect() const { return codebook_.NumRows() != 0; }
+
+ private:
+  friend class StackedAmDiagGmmComputer;
+
+  // Sets up codebook_scale_, codebook_, codebook_norms_ and the shortlists.
+  void InitGselect(const AmDiagGmm &am);
+
+  // Outputs the index of the nearest codeword for each row of "feats".
+  void FindCodewords(const MatrixBase<BaseFloat> &feats,
+                     std::vector<int32> *codewords) const;
+
+  // Returns the number of Gaussians of pdf "pdf_id" that are in the shortlist
+  // for codeword "codeword", and sets "*gauss" to point to their indices
+  // (which are indices into params_, in increasing order).
+  inline int32 Shortlist(int32 codeword, int32 pdf_id,
+                         const int32 **gauss) const {
+    size_t i = static_cast<size_t>(codeword) * NumPdfs() + pdf_id;
+    *gauss = &(shortlist_[shortlist_offsets_[i]]);
+    return shortlist_offsets_[i + 1] - shortlist_offsets_[i];
+  }
+
+  StackedAmDiagGmmOptions opts_;
+  int32 dim_;
+  // The Gaussians of pdf p are rows pdf_offsets_[p] to pdf_offsets_[p+1] - 1
+  // of params_ and elements of gconsts_.
+  std::vector<int32> pdf_offsets_;
+  int32 max_pdf_gauss_;  // the largest number of Gaussians in any pdf.
+  // Row g is [ means_invvars(g), -0.5 * inv_vars(g) ]; dimension is 2 * dim_.
+  Matrix<BaseFloat> params_;
+  Vector<BaseFloat> gconsts_;
+
+  // The following are only set up if we do Gaussian selection.  The codebook
+  // is in a space where the features are scaled by codebook_scale_ (the
+  // inverse of the average standard deviation of the Gaussians), so that
+  // Euclidean distance is meaningful.
+  Vector<BaseFloat> codebook_scale_;
+  Matrix<BaseFloat> codebook_;
+  Vector<BaseFloat> codebook_norms_;  // -0.5 times squared norm of codewords.
+  // The shortlist for codeword k and pdf p is elements shortlist_offsets_[i]
+  // to shortlist_offsets_[i+1] - 1 of shortlist_, with i = k * NumPdfs() + p.
+  std::vector<int32> shortlist_offsets_;
+  std::vector<int32> shortlist_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(StackedAmDiagGmm);
+};
+
+
+/// StackedAmDiagGmmComputer computes and caches pdf log-likelihoods for a block
+/// of frames using a StackedAmDiagGmm.  The first time the likelihood of a pdf
+/// is requested for any frame of the block, it is computed for all frames of
+/// the block at once.  Create one of these per decoder (it is not
+/// thread-safe), typically inside a decodable object.
+class StackedAmDiagGmmComputer {
+ public:
+  /// If you set log_sum_exp_prune to a value greater than 0 it will prune in
+  /// the LogSumExp operation, as in DecodableAmDiagGmmUnmapped.
+  explicit StackedAmDiagGmmComputer(const StackedAmDiagGmm &gmm,
+                                    BaseFloat log_sum_exp_prune = -1.0);
+
+  /// Sets the current block of frames to "feats", whose first row is frame
+  /// number "first_frame"; this invalidates the cached likelihoods.
+  /// Typically feats.NumRows() would be gmm.FrameBatchSize(), or less at the
+  /// end of the utterance.
+  void SetFrames(int32 first_frame, const MatrixBase<BaseFloat> &feats);
+
+  /// Returns true if "frame" is in the current block.
+  bool HasFrame(int32 frame) const {
+    return frame >= first_frame_ && frame < first_frame_ + feats_.NumRows();
+  }
+
+  /// Returns the log-likelihood of pdf "pdf_id" for "frame", which must be in
+  /// the current block.
+  BaseFloat LogLikelihood(int32 frame, int32 pdf_id) {
+    KALDI_ASSERT(HasFrame(frame) && static_cast<size_t>(pdf_id) <
+                 static_cast<size_t>(gmm_.NumPdfs()));
+    if (computed_[pdf_id] != block_index_) {
+      ComputePdf(pdf_id);
+      computed_[pdf_id] = block_index_;
+    }
+    return loglikes_(pdf_id, frame - first_frame_);
+  }
+
+ private:
+  // Computes row "pdf_id" of loglikes_ for the current block.
+  void ComputePdf(int32 pdf_id);
+  // Does the same using Gaussian selection.
+  void ComputePdfGselect(int32 pdf_id, SubVector<BaseFloat> *loglikes);
+
+  const StackedAmDiagGmm &gmm_;
+  BaseFloat log_sum_exp_prune_;
+
+  int32 first_frame_;
+  // The current block of features, with each row [ x, x^2 ].
+  Matrix<BaseFloat> feats_;
+  // The codeword for each frame of the block, if we do Gaussian selection.
+  std::vector<int32> codewords_;
+  // Indexed [pdf][frame - first_frame_]; row p is valid only if computed_[p]
+  // == block_index_.
+  Matrix<BaseFloat> loglikes_;
+  std::vector<int32> computed_;
+  int32 block_index_;
+
+  // Temporary storage for ComputePdf() and ComputePdfGselect().
+  Matrix<BaseFloat> scores_;
+  Matrix<BaseFloat> selected_params_;
+  Vector<BaseFloat> selected_gconsts_;
+  std::vector<int32> selected_;
+  std::vector<int32> selected_position_;
+  Vector<BaseFloat> frame_scores_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(StackedAmDiagGmmComputer);
+};
+
+}  // namespace kaldi
+
+#endif  // KALDI_GMM_STACKED_AM_DIAG_GMM_H_
@@ -0,0 +1,227 @@
+// gmmbin/gmm-latgen-biglm-const-arpa.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "gmm/am-diag-gmm.h"
+#include "tree/context-dep.h"
+#include "hmm/transition-model.h"
+#include "fstext/fstext-lib.h"
+#include "decoder/decoder-wrappers.h"
+#include "decoder/lattice-biglm-faster-decoder.h"
+#include "gmm/decodable-am-diag-gmm.h"
+#include "lm/const-arpa-lm.h"
+#include "base/timer.h"
+
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    typedef kaldi::int32 int32;
+    using fst::SymbolTable;
+    using fst::VectorFst;
+    using fst::StdArc;
+
+    const char *usage =
+        "Generate lattices using GMM-based model, composing the decoding graph\n"
+        "on the fly with a language model in ConstArpaLm format (see\n"
+        "arpa-to-const-arpa).  This is as gmm-latgen-biglm-faster, but the\n"
+        "language model does not have to be compiled as an FST.  If the graph\n"
+        "was built with a (small) language model, give that with --old-lm, also\n"
+        "in ConstArpaLm format, and the decoder applies the difference; if not\n"
+        "(e.g. it was built with a G.fst without scores), the scores of the new\n"
+        "language model are just added.\n"
+        "Usage: gmm-latgen-biglm-const-arpa [options] model-in "
+        "(fst-in|fsts-rspecifier) newlm-const-arpa-in features-rspecifier"
+        " lattice-wspecifier [ words-wspecifier [alignments-wspecifier] ]\n"
+        "e.g.: gmm-latgen-biglm-const-arpa --old-lm=G_small.carpa final.mdl \\\n"
+        "        HCLG.fst G_big.carpa ark:feats.ark ark:lat.ark\n";
+    ParseOptions po(usage);
+    Timer timer;
+    bool allow_partial = false;
+    BaseFloat acoustic_scale = 0.1;
+    int32 num_cached_arcs = 100000;
+    LatticeBiglmFasterDecoderConfig config;
+
+    std::string word_syms_filename, old_lm_rxfilename;
+    config.Register(&po);
+    po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for acoustic likelihoods");
+
+    po.Register("word-symbol-table", &word_syms_filename, "Symbol table for words [for debug output]");
+    po.Register("allow-partial", &allow_partial, "If true, produce output even if end state was not reached.");
+    po.Register("old-lm", &old_lm_rxfilename, "The language model the decoding "
+                "graph was built with, in ConstArpaLm format; if not given, "
+                "the graph is assumed to have no language model scores.");
+    po.Register("num-cached-arcs", &num_cached_arcs, "Number of language "
+                "model arcs that are cached for each utterance.");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() < 5 || po.NumArgs() > 7) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string model_in_filename = po.GetArg(1),
+        fst_in_str = po.GetArg(2),
+        new_lm_rxfilename = po.GetArg(3),
+        feature_rspecifier = po.GetArg(4),
+        lattice_wspecifier = po.GetArg(5),
+        words_wspecifier = po.GetOptArg(6),
+        alignment_wspecifier = po.GetOptArg(7);
+
+    TransitionModel trans_model;
+    AmDiagGmm am_gmm;
+    {
+      bool binary;
+      Input ki(model_in_filename, &binary);
+      trans_model.Read(ki.Stream(), binary);
+      am_gmm.Read(ki.Stream(), binary);
+    }
+
+    // The language models are memory-mapped if they were written in the
+    // aligned format (see const-arpa-copy).
+    ConstArpaLm new_lm, old_lm;
+    new_lm.ReadMapped(new_lm_rxfilename);
+    if (old_lm_rxfilename != "")
+      old_lm.ReadMapped(old_lm_rxfilename);
+
+    bool determinize = config.determinize_lattice;
+    CompactLatticeWriter compact_lattice_writer;
+    LatticeWriter lattice_writer;
+    if (! (determinize ? compact_lattice_writer.Open(lattice_wspecifier)
+           : lattice_writer.Open(lattice_wspecifier)))
+      KALDI_ERR << "Could not open table for writing lattices: "
+                 << lattice_wspecifier;
+
+    Int32VectorWriter words_writer(words_wspecifier);
+
+    Int32VectorWriter alignment_writer(alignment_wspecifier);
+
+    fst::SymbolTable *word_syms = NULL;
+    if (word_syms_filename != "")
+      if (!(word_syms = fst::SymbolTable::ReadText(word_syms_filename)))
+        KALDI_ERR << "Could not read symbol table from file "
+                   << word_syms_filename;
+
+    double tot_like = 0.0;
+    kaldi::int64 frame_count = 0;
+    int num_success = 0, num_fail = 0;
+
+
+    if (ClassifyRspecifier(fst_in_str, NULL, NULL) == kNoRspecifier) {
+      SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
+      // Input FST is just one FST, not a table of FSTs.
+      VectorFst<StdArc> *decode_fst = fst::ReadFstKaldi(fst_in_str);
+
+      {
+        for (; !feature_reader.Done(); feature_reader.Next()) {
+          std::string utt = feature_reader.Key();
+          Matrix<BaseFloat> features (feature_reader.Value());
+          feature_reader.FreeCurrent();
+          if (features.NumRows() == 0) {
+            KALDI_WARN << "Zero-length utterance: " << utt;
+            num_fail++;
+            continue;
+          }
+
+          // The difference FST remembers every state it creates, so we make a
+          // new one for each utterance to keep its memory bounded.
+          ConstArpaLmDiffDeterministicFst lm_diff_dfst(
+              (old_lm_rxfilename != "" ? &old_lm : NULL), new_lm,
+              num_cached_arcs);
+          LatticeBiglmFasterDecoder decoder(*decode_fst, config,
+                                            &lm_diff_dfst);
+          DecodableAmDiagGmmScaled gmm_decodable(am_gmm, trans_model, features,
+                                                 acoustic_scale);
+
+          double like;
+          if (DecodeUtteranceLatticeBiglmFaster(
+                  decoder, gmm_decodable, trans_model, word_syms, utt,
+                  acoustic_scale, determinize, allow_partial,
+                  &alignment_writer, &words_writer, &compact_lattice_writer,
+                  &lattice_writer, &like)) {
+            tot_like += like;
+            frame_count += features.NumRows();
+            num_success++;
+          } else num_fail++;
+          KALDI_VLOG(2) << "The language model difference FST for utterance "
+                        << utt << " has " << lm_diff_dfst.NumStates()
+                        << " states.";
+        }
+      }
+      delete decode_fst; // delete this only after decoder goes out of scope.
+    } else { // We have different FSTs for different utterances.
+      SequentialTableReader<fst::VectorFstHolder> fst_reader(fst_in_str);
+      RandomAccessBaseFloatMatrixReader feature_reader(feature_rspecifier);
+      for (; !fst_reader.Done(); fst_reader.Next()) {
+        std::string utt = fst_reader.Key();
+        if (!feature_reader.HasKey(utt)) {
+          KALDI_WARN << "Not decoding utterance " << utt
+                     << " because no features available.";
+          num_fail++;
+          continue;
+        }
+        const Matrix<BaseFloat> &features = feature_reader.Value(utt);
+        if (features.NumRows() == 0) {
+          KALDI_WARN << "Zero-length utterance: " << utt;
+          num_fail++;
+          continue;
+        }
+        // The difference FST remembers every state it creates, so we make a
+        // new one for each utterance to keep its memory bounded.
+        ConstArpaLmDiffDeterministicFst lm_diff_dfst(
+            (old_lm_rxfilename != "" ? &old_lm : NULL), new_lm,
+            num_cached_arcs);
+        LatticeBiglmFasterDecoder decoder(fst_reader.Value(), config,
+                                          &lm_diff_dfst);
+        DecodableAmDiagGmmScaled gmm_decodable(am_gmm, trans_model, features,
+                                               acoustic_scale);
+        double like;
+        if (DecodeUtteranceLatticeBiglmFaster(
+                decoder, gmm_decodable, trans_model, word_syms, utt,
+                acoustic_scale, determinize, allow_partial,
+                &alignment_writer, &words_writer, &compact_lattice_writer,
+                &lattice_writer, &like)) {
+          tot_like += like;
+          frame_count += features.NumRows();
+          num_success++;
+        } else num_fail++;
+        KALDI_VLOG(2) << "The language model difference FST for utterance "
+                      << utt << " has " << lm_diff_dfst.NumStates()
+                      << " states.";
+      }
+    }
+
+    double elapsed = timer.Elapsed();
+    KALDI_LOG << "Time taken "<< elapsed
+              << "s: real-time factor assuming 100 frames/sec is "
+              << (elapsed*100.0/frame_count);
+    KALDI_LOG << "Done " << num_success << " utterances, failed for "
+              << num_fail;
+    KALDI_LOG << "Overall log-likelihood per frame is " << (tot_like/frame_count) << " over "
+              << frame_count<<" frames.";
+
+    delete word_syms;
+    if (num_success != 0) return 0;
+    else return 1;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
@@ -53,10 +53,12 @@ int main(int argc, char *argv[]) {
     BaseFloat log_sum_exp_prune = 0.0;
     LatticeFasterDecoderConfig latgen_config;
     TaskSequencerConfig sequencer_config; // has --num-threads option
+    StackedAmDiagGmmOptions stacked_opts;
     
     std::string word_syms_filename;
     latgen_config.Register(&po);
     sequencer_config.Register(&po);
+    stacked_opts.Register(&po);
     po.Register("acoustic-scale", &acoustic_scale,
                 "Scaling factor for acoustic likelihoods");
     po.Register("log-sum-exp-prune", &log_sum_exp_prune,
@@ -89,6 +91,8 @@ int main(int argc, char *argv[]) {
       trans_model.Read(ki.Stream(), binary);
       am_gmm.Read(ki.Stream(), binary);
     }
+    // This is shared by the decoding threads.
+    StackedAmDiagGmm stacked_gmm(am_gmm, stacked_opts);
 
     bool determinize = latgen_config.determinize_lattice;
     CompactLatticeWriter compact_lattice_writer;
@@ -138,11 +142,11 @@ int main(int argc, char *argv[]) {
           LatticeFasterDecoder *decoder = new LatticeFasterDecoder(*decode_fst,
                                                                    latgen_config);
           // takes ownership of "features"
-          DecodableAmDiagGmmScaled *gmm_decodable =
-              new DecodableAmDiagGmmScaled(am_gmm, trans_model, 
-                                           acoustic_scale,
-                                           log_sum_exp_prune,
-                                           features);
+          DecodableAmDiagGmmStacked *gmm_decodable =
+              new DecodableAmDiagGmmStacked(stacked_gmm, trans_model,
+                                            acoustic_scale,
+                                            log_sum_exp_prune,
+                                            features);
 
           DecodeUtteranceLatticeFasterClass *task =
               new DecodeUtteranceLatticeFasterClass(
@@ -182,9 +186,10 @@ int main(int argc, char *argv[]) {
             new VectorFst<StdArc>(fst_reader.Value()));
           
         // The "decodable" object takes ownership of the features.
-        DecodableAmDiagGmmScaled *gmm_decodable =
-            new DecodableAmDiagGmmScaled(am_gmm, trans_model, acoustic_scale,
-                                         log_sum_exp_prune, features);
+        DecodableAmDiagGmmStacked *gmm_decodable =
+            new DecodableAmDiagGmmStacked(stacked_gmm, trans_model,
+                                          acoustic_scale, log_sum_exp_prune,
+                                          features);
 
         DecodeUtteranceLatticeFasterClass *task =
             new DecodeUtteranceLatticeFasterClass(
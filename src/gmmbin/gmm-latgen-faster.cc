@@ -37,6 +37,7 @@ int main(int argc, char *argv[]) {
     typedef kaldi::int32 int32;
     using fst::SymbolTable;
     using fst::VectorFst;
+    using fst::Fst;
     using fst::StdArc;
 
     const char *usage =
@@ -48,9 +49,11 @@ int main(int argc, char *argv[]) {
     bool allow_partial = false;
     BaseFloat acoustic_scale = 0.1;
     LatticeFasterDecoderConfig config;
+    StackedAmDiagGmmOptions stacked_opts;
     
     std::string word_syms_filename;
     config.Register(&po);
+    stacked_opts.Register(&po);
     po.Register("acoustic-scale", &acoustic_scale,
                 "Scaling factor for acoustic likelihoods");
     po.Register("word-symbol-table", &word_syms_filename,
@@ -80,6 +83,7 @@ int main(int argc, char *argv[]) {
       trans_model.Read(ki.Stream(), binary);
       am_gmm.Read(ki.Stream(), binary);
     }
+    StackedAmDiagGmm stacked_gmm(am_gmm, stacked_opts);
 
     bool determinize = config.determinize_lattice;
     CompactLatticeWriter compact_lattice_writer;
@@ -106,7 +110,7 @@ int main(int argc, char *argv[]) {
     if (ClassifyRspecifier(fst_in_str, NULL, NULL) == kNoRspecifier) {
       SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
       // Input FST is just one FST, not a table of FSTs.
-      VectorFst<StdArc> *decode_fst = fst::ReadFstKaldi(fst_in_str);
+      Fst<StdArc> *decode_fst = fst::ReadFstKaldiMapped(fst_in_str);
       
       {
         LatticeFasterDecoder decoder(*decode_fst, config);
@@ -121,8 +125,8 @@ int main(int argc, char *argv[]) {
             continue;
           }
           
-          DecodableAmDiagGmmScaled gmm_decodable(am_gmm, trans_model, features,
-                                                 acoustic_scale);
+          DecodableAmDiagGmmStacked gmm_decodable(stacked_gmm, trans_model,
+                                                  features, acoustic_scale);
 
           double like;
           if (DecodeUtteranceLatticeFaster(
@@ -156,8 +160,8 @@ int main(int argc, char *argv[]) {
         }
 
         LatticeFasterDecoder decoder(fst_reader.Value(), config);
-        DecodableAmDiagGmmScaled gmm_decodable(am_gmm, trans_model, features,
-                                               acoustic_scale);
+        DecodableAmDiagGmmStacked gmm_decodable(stacked_gmm, trans_model,
+                                                features, acoustic_scale);
         double like;
         if (DecodeUtteranceLatticeFaster(
                 decoder, gmm_decodable, trans_model, word_syms, utt,
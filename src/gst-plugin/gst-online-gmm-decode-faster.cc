@@ -247,6 +247,8 @@ gst_online_gmm_decode_faster_init(GstOnlineGmmDecodeFaster * filter) {
   filter->decoder_opts_->Register(filter->simple_options_, true);
   filter->feature_reading_opts_ = new OnlineFeatureMatrixOptions();
   filter->feature_reading_opts_->Register(filter->simple_options_);
+  filter->stacked_gmm_opts_ = new StackedAmDiagGmmOptions();
+  filter->stacked_gmm_opts_->Register(filter->simple_options_);
 
   filter->acoustic_scale_ = DEFAULT_ACOUSTIC_SCALE;
   filter->cmn_window_ = 600;
@@ -397,6 +399,8 @@ gst_online_gmm_decode_faster_allocate(GstOnlineGmmDecodeFaster * filter) {
       filter->trans_model_->Read(ki.Stream(), binary);
       filter->am_gmm_->Read(ki.Stream(), binary);
     }
+    filter->stacked_gmm_ = new StackedAmDiagGmm(*(filter->am_gmm_),
+                                                *(filter->stacked_gmm_opts_));
     filter->word_syms_ = NULL;
     if (!(filter->word_syms_ = fst::SymbolTable::ReadText(filter->word_syms_filename_))) {
       GST_ERROR_OBJECT(filter, "Could not read symbol table from file %s", filter->word_syms_filename_);
@@ -433,6 +437,7 @@ gst_online_gmm_decode_faster_finalize(GObject * object) {
   delete filter->silence_phones_;
   delete filter->decoder_opts_;
   delete filter->feature_reading_opts_;
+  delete filter->stacked_gmm_opts_;
   if (filter->decoder_) {
     delete filter->decoder_;
     filter->decoder_ = NULL;
@@ -445,6 +450,10 @@ gst_online_gmm_decode_faster_finalize(GObject * object) {
     delete filter->am_gmm_;
     filter->am_gmm_ = NULL;
   }
+  if (filter->stacked_gmm_) {
+    delete filter->stacked_gmm_;
+    filter->stacked_gmm_ = NULL;
+  }
   if (filter->word_syms_) {
     delete filter->word_syms_;
     filter->word_syms_ = NULL;
@@ -734,7 +743,8 @@ gst_online_gmm_decode_faster_loop(GstOnlineGmmDecodeFaster * filter) {
 
 
   OnlineDecodableDiagGmmScaled decodable(*(filter->am_gmm_), *(filter->trans_model_),
-                                         filter->acoustic_scale_, &feature_matrix);
+                                         filter->acoustic_scale_, &feature_matrix,
+                                         filter->stacked_gmm_);
 
   GST_DEBUG_OBJECT(filter,  "starting decoding loop");
 
@@ -67,6 +67,7 @@ struct _GstOnlineGmmDecodeFaster {
   Matrix<BaseFloat> *lda_transform_;
   TransitionModel *trans_model_;
   AmDiagGmm *am_gmm_;
+  StackedAmDiagGmm *stacked_gmm_;
   fst::Fst<fst::StdArc> *decode_fst_;
   fst::SymbolTable *word_syms_;
   fst::VectorFst<LatticeArc> *out_fst_;
@@ -86,6 +87,7 @@ struct _GstOnlineGmmDecodeFaster {
 
   OnlineFasterDecoderOpts *decoder_opts_;
   OnlineFeatureMatrixOptions *feature_reading_opts_;
+  StackedAmDiagGmmOptions *stacked_gmm_opts_;
 
   SimpleOptions *simple_options_;
 };
@@ -19,6 +19,8 @@
 
 #ifndef KALDI_ITF_ONLINE_FEATURE_ITF_H_
 #define KALDI_ITF_ONLINE_FEATURE_ITF_H_ 1
+#include <vector>
+
 #include "base/kaldi-common.h"
 #include "matrix/matrix-lib.h"
 
@@ -74,6 +76,22 @@ class OnlineFeatureInterface {
   /// the class.
   virtual void GetFrame(int32 frame, VectorBase<BaseFloat> *feat) = 0;
 
+  /// This is like GetFrame() but for a collection of frames: it gets frame
+  /// frames[i] into row i of "feats", which must already have the right size.
+  /// The frames do not have to be consecutive or distinct, but the usual case
+  /// is a range of consecutive frames, and child classes may make that case
+  /// faster, e.g. by doing a transform as one matrix multiply or by fetching
+  /// the context they need from their input only once.  The default
+  /// implementation just calls GetFrame() for each frame.
+  virtual void GetFrames(const std::vector<int32> &frames,
+                         MatrixBase<BaseFloat> *feats) {
+    KALDI_ASSERT(static_cast<int32>(frames.size()) == feats->NumRows());
+    for (size_t i = 0; i < frames.size(); i++) {
+      SubVector<BaseFloat> feat(*feats, i);
+      GetFrame(frames[i], &feat);
+    }
+  }
+
   /// Virtual destructor.  Note: constructors that take another member of
   /// type OnlineFeatureInterface are not expected to take ownership of
   /// that pointer; the caller needs to keep track of that manually.
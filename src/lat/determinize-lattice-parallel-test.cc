@@ -0,0 +1,106 @@
+// lat/determinize-lattice-parallel-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lat/determinize-lattice-parallel.h"
+#include "fstext/lattice-utils.h"
+#include "fstext/fst-test-utils.h"
+#include "lat/kaldi-lattice.h"
+
+namespace kaldi {
+
+// Creates a lattice that is several random acyclic lattices one after the
+// other, so it has states that all paths go through.
+static Lattice *RandomLongLattice(int32 num_parts) {
+  fst::RandFstOptions opts;
+  opts.n_states = 4;
+  opts.n_arcs = 8;
+  opts.n_final = 2;
+  opts.allow_empty = false;
+  opts.weight_multiplier = 0.5;  // so the weights are exactly representable.
+  opts.acyclic = true;
+  Lattice *lat = fst::RandPairFst<LatticeArc>(opts);
+  for (int32 i = 1; i < num_parts; i++) {
+    Lattice *part = fst::RandPairFst<LatticeArc>(opts);
+    fst::Concat(lat, *part);
+    delete part;
+  }
+  fst::Connect(lat);
+  bool sorted = fst::TopSort(lat);
+  KALDI_ASSERT(sorted);
+  return lat;
+}
+
+static void TestDeterminizeLatticePrunedParallel() {
+  Lattice *lat = RandomLongLattice(1 + Rand() % 8);
+  double beam = 10.0;
+
+  CompactLattice clat;
+  bool ans = fst::DeterminizeLatticePruned(*lat, beam, &clat);
+  KALDI_ASSERT(ans);
+
+  fst::DeterminizeMemoryBudget budget(1000000);
+  fst::DeterminizeLatticePrunedOptions det_opts;
+  if (Rand() % 2 == 0)
+    det_opts.memory_budget = &budget;
+  DeterminizeLatticeParallelOptions opts;
+  opts.segment_length = 1 + Rand() % 3;
+  opts.num_threads = 1 + Rand() % 3;
+  CompactLattice parallel_clat;
+  ans = DeterminizeLatticePrunedParallel(*lat, beam, &parallel_clat,
+                                         det_opts, opts);
+  KALDI_ASSERT(ans);
+  // All the memory has been given back to the budget.
+  KALDI_ASSERT(budget.Update(0, 0) == 0);
+
+  KALDI_ASSERT(parallel_clat.Properties(fst::kIDeterministic, true) &
+               fst::kIDeterministic);
+  KALDI_ASSERT(fst::RandEquivalent(clat, parallel_clat, 5 /*paths*/,
+                                   0.01 /*delta*/, Rand() /*seed*/,
+                                   100 /*path length, max*/));
+  delete lat;
+}
+
+static void TestFindLatticeCutStates() {
+  Lattice *lat = RandomLongLattice(1 + Rand() % 8);
+  std::vector<int32> cut_states;
+  FindLatticeCutStates(*lat, 1, &cut_states);
+  // Check that no arc goes past a cut state and that no state before it is
+  // final.
+  for (size_t i = 0; i < cut_states.size(); i++) {
+    int32 cut = cut_states[i];
+    KALDI_ASSERT(cut > 0 && (i == 0 || cut > cut_states[i - 1]));
+    for (int32 s = 0; s < cut; s++) {
+      KALDI_ASSERT(lat->Final(s) == LatticeWeight::Zero());
+      for (fst::ArcIterator<Lattice> aiter(*lat, s); !aiter.Done();
+           aiter.Next())
+        KALDI_ASSERT(aiter.Value().nextstate <= cut);
+    }
+  }
+  delete lat;
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 20; i++) {
+    TestFindLatticeCutStates();
+    TestDeterminizeLatticePrunedParallel();
+  }
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
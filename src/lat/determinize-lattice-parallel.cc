@@ -0,0 +1,200 @@
+// lat/determinize-lattice-parallel.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lat/determinize-lattice-parallel.h"
+#include "lat/lattice-functions.h"
+#include "thread/kaldi-task-sequence.h"
+
+namespace kaldi {
+
+void FindLatticeCutStates(const Lattice &lat, int32 segment_length,
+                          std::vector<int32> *cut_states) {
+  typedef Lattice::Arc Arc;
+  typedef Arc::StateId StateId;
+  typedef Arc::Weight Weight;
+
+  cut_states->clear();
+  StateId num_states = lat.NumStates();
+  if (segment_length <= 0 || num_states == 0)
+    return;
+  KALDI_ASSERT(lat.Start() == 0 &&
+               lat.Properties(fst::kTopSorted, true) == fst::kTopSorted);
+
+  // times[s] is the number of frames (arcs with transition-ids, which are on
+  // the output side) before state s.
+  std::vector<int32> times(num_states, 0);
+  int32 num_frames = 0;
+  for (StateId s = 0; s < num_states; s++) {
+    for (fst::ArcIterator<Lattice> aiter(lat, s); !aiter.Done(); aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      int32 t = times[s] + (arc.olabel != 0 ? 1 : 0);
+      times[arc.nextstate] = std::max(times[arc.nextstate], t);
+    }
+    num_frames = std::max(num_frames, times[s]);
+  }
+
+  // Because the lattice is topologically sorted, all paths go through state s
+  // if and only if no arc from a state before s goes past s and no state
+  // before s is final.
+  StateId max_nextstate = 0;
+  bool seen_final = false;
+  int32 last_cut_time = 0;
+  for (StateId s = 0; s < num_states; s++) {
+    if (s > 0 && max_nextstate == s && !seen_final &&
+        times[s] - last_cut_time >= segment_length &&
+        num_frames - times[s] >= segment_length) {
+      cut_states->push_back(s);
+      last_cut_time = times[s];
+    }
+    if (lat.Final(s) != Weight::Zero())
+      seen_final = true;
+    for (fst::ArcIterator<Lattice> aiter(lat, s); !aiter.Done(); aiter.Next())
+      max_nextstate = std::max(max_nextstate, aiter.Value().nextstate);
+  }
+}
+
+// Puts in "segment" the part of "lat" between the states "begin" and "end"
+// (which are cut states, or the start state and the number of states).  The
+// state "end" becomes a final state of the segment, with no arcs.
+static void ExtractLatticeSegment(const Lattice &lat,
+                                  int32 begin, int32 end,
+                                  Lattice *segment) {
+  typedef Lattice::Arc Arc;
+  typedef Arc::Weight Weight;
+
+  bool is_last = (end == lat.NumStates());
+  segment->DeleteStates();
+  for (int32 s = begin; s < end; s++)
+    segment->AddState();
+  if (!is_last)
+    segment->SetFinal(segment->AddState(), Weight::One());
+  segment->SetStart(0);
+  for (int32 s = begin; s < end; s++) {
+    segment->SetFinal(s - begin, lat.Final(s));
+    for (fst::ArcIterator<Lattice> aiter(lat, s); !aiter.Done(); aiter.Next()) {
+      Arc arc = aiter.Value();
+      KALDI_ASSERT(arc.nextstate <= end);
+      arc.nextstate -= begin;
+      segment->AddArc(s - begin, arc);
+    }
+  }
+}
+
+class DeterminizeLatticeSegmentTask {
+ public:
+  // Takes ownership of "segment".
+  DeterminizeLatticeSegmentTask(
+      const fst::DeterminizeLatticePrunedOptions &opts,
+      double beam,
+      Lattice *segment,
+      CompactLattice *det_segment,
+      bool *all_succeeded):
+      opts_(opts), beam_(beam), segment_(segment), det_segment_(det_segment),
+      all_succeeded_(all_succeeded), succeeded_(false) { }
+
+  void operator () () {
+    fst::ArcSort(segment_, fst::ILabelCompare<LatticeArc>());
+    succeeded_ = fst::DeterminizeLatticePruned(*segment_, beam_, det_segment_,
+                                               opts_);
+    delete segment_;
+    segment_ = NULL;
+  }
+
+  ~DeterminizeLatticeSegmentTask() {
+    delete segment_;
+    if (!succeeded_)
+      *all_succeeded_ = false;
+  }
+ private:
+  const fst::DeterminizeLatticePrunedOptions &opts_;
+  double beam_;
+  Lattice *segment_;
+  CompactLattice *det_segment_;
+  bool *all_succeeded_;
+  bool succeeded_;
+};
+
+bool DeterminizeLatticePrunedParallel(
+    const Lattice &ifst,
+    double beam,
+    CompactLattice *ofst,
+    fst::DeterminizeLatticePrunedOptions det_opts,
+    const DeterminizeLatticeParallelOptions &opts) {
+  if (opts.segment_length <= 0 || ifst.NumStates() == 0)
+    return fst::DeterminizeLatticePruned(ifst, beam, ofst, det_opts);
+
+  // Parts of the lattice that are not within "beam" of the best path cannot
+  // affect the output, so we prune them first; this way, there are many more
+  // states that all the paths go through.
+  Lattice lat(ifst);
+  if (!PruneLattice(beam, &lat) || !fst::TopSort(&lat) || lat.Start() != 0)
+    return fst::DeterminizeLatticePruned(ifst, beam, ofst, det_opts);
+
+  std::vector<int32> cut_states;
+  FindLatticeCutStates(lat, opts.segment_length, &cut_states);
+  if (cut_states.empty())
+    return fst::DeterminizeLatticePruned(lat, beam, ofst, det_opts);
+
+  fst::DeterminizeMemoryBudget local_budget(det_opts.max_mem);
+  if (det_opts.memory_budget == NULL && det_opts.max_mem > 0)
+    det_opts.memory_budget = &local_budget;
+
+  int32 num_segments = cut_states.size() + 1;
+  KALDI_VLOG(2) << "Determinizing lattice in " << num_segments << " segments.";
+  std::vector<CompactLattice> det_segments(num_segments);
+  bool ans = true;
+  {
+    TaskSequencerConfig sequencer_config;
+    sequencer_config.num_threads = opts.num_threads;
+    TaskSequencer<DeterminizeLatticeSegmentTask> sequencer(sequencer_config);
+    for (int32 i = 0; i < num_segments; i++) {
+      int32 begin = (i == 0 ? 0 : cut_states[i - 1]),
+          end = (i + 1 < num_segments ? cut_states[i] : lat.NumStates());
+      Lattice *segment = new Lattice();
+      ExtractLatticeSegment(lat, begin, end, segment);
+      sequencer.Run(new DeterminizeLatticeSegmentTask(
+          det_opts, beam, segment, &(det_segments[i]), &ans));
+    }
+    sequencer.Wait();
+  }
+  lat.DeleteStates();  // Free memory.
+
+  CompactLattice joined(det_segments[0]);
+  for (int32 i = 1; i < num_segments; i++) {
+    fst::Concat(&joined, det_segments[i]);
+    det_segments[i].DeleteStates();
+  }
+  if (joined.Start() == fst::kNoStateId) {
+    KALDI_WARN << "Empty output from determinizing lattice segments.";
+    ofst->DeleteStates();
+    return false;
+  }
+
+  // Determinize the joined lattice: there may be more than one path with the
+  // same word sequence, because the word labels do not have a fixed position
+  // relative to the cut states.
+  Lattice joined_lat;
+  fst::ConvertLattice(joined, &joined_lat, false);  // words on input side.
+  joined.DeleteStates();
+  if (!fst::TopSort(&joined_lat))
+    KALDI_ERR << "Cycles in joined lattice segments (should not happen)";
+  fst::ArcSort(&joined_lat, fst::ILabelCompare<LatticeArc>());
+  ans = fst::DeterminizeLatticePruned(joined_lat, beam, ofst, det_opts) && ans;
+  return ans;
+}
+
+}  // namespace kaldi
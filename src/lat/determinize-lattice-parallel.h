@@ -0,0 +1,97 @@
+// lat/determinize-lattice-parallel.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_LAT_DETERMINIZE_LATTICE_PARALLEL_H_
+#define KALDI_LAT_DETERMINIZE_LATTICE_PARALLEL_H_
+
+#include <vector>
+#include "base/kaldi-common.h"
+#include "itf/options-itf.h"
+#include "lat/kaldi-lattice.h"
+#include "lat/determinize-lattice-pruned.h"
+
+namespace kaldi {
+
+struct DeterminizeLatticeParallelOptions {
+  // segment_length: if > 0, lattices are split into segments of at least this
+  // many frames, at states that every path goes through, and the segments
+  // are determinized separately.  If <= 0, lattices are not split.
+  int32 segment_length;
+  // num_threads: the number of segments of a lattice that are determinized
+  // at the same time.
+  int32 num_threads;
+  DeterminizeLatticeParallelOptions(): segment_length(0), num_threads(1) { }
+  void Register(OptionsItf *opts) {
+    opts->Register("segment-length", &segment_length, "If >0, split long "
+                   "lattices into segments of at least this many frames, at "
+                   "states that all paths go through, and determinize the "
+                   "segments in parallel (see --segment-threads).");
+    opts->Register("segment-threads", &num_threads, "Number of segments of "
+                   "a lattice that are determinized at the same time (only "
+                   "relevant if --segment-length > 0).");
+  }
+};
+
+/// Finds the states of a lattice that every successful path goes through
+/// ("cut states"), and from them chooses the places to split the lattice into
+/// segments of at least "segment_length" frames.  The lattice must be
+/// topologically sorted, with its start state numbered 0 (as TopSort() does
+/// for a connected lattice), and it must have the transition-ids on the output
+/// side (as for DeterminizeLatticePruned()).  On exit, "cut_states" will
+/// contain the states where it is to be split, in increasing order; it does
+/// not include the start state.  A lattice that cannot be split gives an empty
+/// vector.
+void FindLatticeCutStates(const Lattice &lat, int32 segment_length,
+                          std::vector<int32> *cut_states);
+
+/**
+   This function does the same thing as fst::DeterminizeLatticePruned()
+   (the version that outputs CompactLattice), but splits long lattices into
+   segments and determinizes them in parallel.  As for that function, "ifst"
+   must have words on the input side and transition-ids on the output side
+   (i.e. be inverted), and be topologically sorted.
+
+   A state that all the paths go through is a point where the lattice, after
+   pruning with "beam", has collapsed to a single hypothesis; this happens
+   often in long recordings, e.g. in pauses.  The lattice is split at such
+   states into segments of at least opts.segment_length frames, which are
+   determinized by opts.num_threads threads.  The determinized segments are
+   joined, and the result is determinized once more, as a word sequence may
+   come out of the segments in more than one way (a word near a split point
+   may be in the segment on either side); this final pass is on the small,
+   already-determinized lattice and is cheap.
+
+   The memory limit applies to all the determinizations together: if
+   det_opts.memory_budget is set, the segments use that budget (which may
+   also be shared with other lattices); otherwise, if det_opts.max_mem > 0,
+   the segments share a budget of that size, so the limit is the same as if
+   the lattice were determinized in one piece.
+
+   Returns true on success, and false if the output had to be pruned tighter
+   than "beam" because of the limits in det_opts.
+*/
+bool DeterminizeLatticePrunedParallel(
+    const Lattice &ifst,
+    double beam,
+    CompactLattice *ofst,
+    fst::DeterminizeLatticePrunedOptions det_opts,
+    const DeterminizeLatticeParallelOptions &opts);
+
+}  // namespace kaldi
+
+#endif  // KALDI_LAT_DETERMINIZE_LATTICE_PARALLEL_H_
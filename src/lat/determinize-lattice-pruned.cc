@@ -187,8 +187,8 @@ template<class Weight, class IntType> class LatticeDeterminizerPruned {
   LatticeDeterminizerPruned(const ExpandedFst<Arc> &ifst,
                             double beam,
                             DeterminizeLatticePrunedOptions opts):
-      num_arcs_(0), num_elems_(0), ifst_(ifst.Copy()), beam_(beam), opts_(opts),
-      equal_(opts_.delta), determinized_(false),
+      num_arcs_(0), num_elems_(0), budget_size_(0), ifst_(ifst.Copy()),
+      beam_(beam), opts_(opts), equal_(opts_.delta), determinized_(false),
       minimal_hash_(3, hasher_, equal_), initial_hash_(3, hasher_, equal_) {
     KALDI_ASSERT(Weight::Properties() & kIdempotent); // this algorithm won't
     // work correctly otherwise.
@@ -239,6 +239,8 @@ template<class Weight, class IntType> class LatticeDeterminizerPruned {
   ~LatticeDeterminizerPruned() {
     FreeMostMemory();
     FreeOutputStates();
+    if (opts_.memory_budget != NULL)
+      opts_.memory_budget->Update(budget_size_, 0);
     // rest is deleted by destructors.
   }
   
@@ -285,12 +287,26 @@ template<class Weight, class IntType> class LatticeDeterminizerPruned {
     repository_.Rebuild(needed_strings);
   }
   
+  // Returns the memory usage that is to be compared with the limit: our own
+  // usage "size", or if we share a memory budget with other determinizations,
+  // the total usage of all of them.
+  kaldi::int64 UpdateMemoryUsage(kaldi::int64 size) {
+    if (opts_.memory_budget == NULL)
+      return size;
+    kaldi::int64 total = opts_.memory_budget->Update(budget_size_, size);
+    budget_size_ = size;
+    return total;
+  }
+
   bool CheckMemoryUsage() {
     int32 repo_size = repository_.MemSize(),
         arcs_size = num_arcs_ * sizeof(TempArc),
         elems_size = num_elems_ * sizeof(Element),
         total_size = repo_size + arcs_size + elems_size;
-    if (opts_.max_mem > 0 && total_size > opts_.max_mem) { // We passed the memory threshold.
+    kaldi::int64 max_mem = (opts_.memory_budget != NULL ?
+                            opts_.memory_budget->MaxMem() : opts_.max_mem);
+    if (max_mem > 0 && UpdateMemoryUsage(total_size) > max_mem) {
+      // We passed the memory threshold.
       // This is usually due to the repository getting large, so we
       // clean this out.
       RebuildRepository();
@@ -300,7 +316,7 @@ template<class Weight, class IntType> class LatticeDeterminizerPruned {
       KALDI_VLOG(2) << "Rebuilt repository in determinize-lattice: repository shrank from "
                     << repo_size << " to " << new_repo_size << " bytes (approximately)";
       
-      if (new_total_size > static_cast<int32>(opts_.max_mem * 0.8)) {
+      if (UpdateMemoryUsage(new_total_size) > max_mem * 0.8) {
         // Rebuilding didn't help enough-- we need a margin to stop
         // having to rebuild too often.  We'll just return to the user at
         // this point, with a partial lattice that's pruned tighter than
@@ -314,8 +330,10 @@ template<class Weight, class IntType> class LatticeDeterminizerPruned {
           effective_beam = task->priority_cost - total_weight;
         }
         KALDI_WARN << "Did not reach requested beam in determinize-lattice: "
-                   << "size exceeds maximum " << opts_.max_mem
-                   << " bytes; (repo,arcs,elems) = (" << repo_size << ","
+                   << "size exceeds maximum " << max_mem
+                   << " bytes" << (opts_.memory_budget != NULL ?
+                                   " (shared with other determinizations)" : "")
+                   << "; (repo,arcs,elems) = (" << repo_size << ","
                    << arcs_size << "," << elems_size
                    << "), after rebuilding, repo size was " << new_repo_size
                    << ", effective beam was " << effective_beam
@@ -1112,6 +1130,8 @@ template<class Weight, class IntType> class LatticeDeterminizerPruned {
   int num_arcs_; // keep track of memory usage: number of arcs in output_states_[ ]->arcs
   int num_elems_; // keep track of memory usage: number of elems in output_states_ and
   // the keys of initial_hash_
+  kaldi::int64 budget_size_; // the memory usage we last reported to
+  // opts_.memory_budget, if it is set.
   
   const ExpandedFst<Arc> *ifst_;
   std::vector<double> backward_costs_; // This vector stores, for every state in ifst_,
@@ -31,6 +31,7 @@
 #include "hmm/transition-model.h"
 #include "itf/options-itf.h"
 #include "lat/kaldi-lattice.h"
+#include "thread/kaldi-mutex.h"
 
 namespace fst {
 
@@ -109,6 +110,40 @@ namespace fst {
 */   
 
 
+/**
+   DeterminizeMemoryBudget is a limit on the (approximate) memory used by
+   several determinizations that run at the same time, e.g. in different
+   threads.  Each determinization that is given the budget (see
+   DeterminizeLatticePrunedOptions::memory_budget) reports its memory usage to
+   it, and when the total goes over the limit, the determinization that notices
+   it cleans up its memory, and stops (returning a lattice that is pruned
+   tighter than the requested beam) if that did not bring the total back
+   under the limit.  It is thread-safe.
+ */
+class DeterminizeMemoryBudget {
+ public:
+  explicit DeterminizeMemoryBudget(kaldi::int64 max_mem):
+      max_mem_(max_mem), total_(0) { }
+
+  kaldi::int64 MaxMem() const { return max_mem_; }
+
+  /// Changes the memory attributed to one determinization from "old_size"
+  /// to "new_size" bytes, and returns the total over all determinizations.
+  kaldi::int64 Update(kaldi::int64 old_size, kaldi::int64 new_size) {
+    mutex_.Lock();
+    total_ += new_size - old_size;
+    kaldi::int64 ans = total_;
+    mutex_.Unlock();
+    return ans;
+  }
+
+ private:
+  kaldi::int64 max_mem_;
+  kaldi::int64 total_;
+  kaldi::Mutex mutex_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(DeterminizeMemoryBudget);
+};
+
 struct DeterminizeLatticePrunedOptions {
   float delta; // A small offset used to measure equality of weights.
   int max_mem; // If >0, determinization will fail and return false
@@ -118,12 +153,16 @@ struct DeterminizeLatticePrunedOptions {
   int max_states;
   int max_arcs;
   float retry_cutoff;
+  // If non-NULL, a memory limit shared with other determinizations running in
+  // parallel; max_mem is then ignored.  Not owned here.
+  DeterminizeMemoryBudget *memory_budget;
   DeterminizeLatticePrunedOptions(): delta(kDelta),
                                      max_mem(-1),
                                      max_loop(-1),
                                      max_states(-1),
                                      max_arcs(-1),
-                                     retry_cutoff(0.5) { }
+                                     retry_cutoff(0.5),
+                                     memory_budget(NULL) { }
   void Register (kaldi::OptionsItf *opts) {
     opts->Register("delta", &delta, "Tolerance used in determinization");
     opts->Register("max-mem", &max_mem, "Maximum approximate memory usage in "
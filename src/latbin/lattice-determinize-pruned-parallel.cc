@@ -20,6 +20,7 @@
 #include "util/common-utils.h"
 #include "lat/kaldi-lattice.h"
 #include "lat/determinize-lattice-pruned.h"
+#include "lat/determinize-lattice-parallel.h"
 #include "lat/lattice-functions.h"
 #include "lat/push-lattice.h"
 #include "lat/minimize-lattice.h"
@@ -32,6 +33,7 @@ class DeterminizeLatticeTask {
   // Initializer takes ownership of "lat".
   DeterminizeLatticeTask(
       fst::DeterminizeLatticePrunedOptions &opts,
+      const DeterminizeLatticeParallelOptions &parallel_opts,
       std::string key,
       BaseFloat acoustic_scale,
       BaseFloat beam,
@@ -39,9 +41,9 @@ class DeterminizeLatticeTask {
       Lattice *lat,
       CompactLatticeWriter *clat_writer,
       int32 *num_warn):
-      opts_(opts), key_(key), acoustic_scale_(acoustic_scale), beam_(beam),
-      minimize_(minimize), lat_(lat), clat_writer_(clat_writer),
-      num_warn_(num_warn) { }
+      opts_(opts), parallel_opts_(parallel_opts), key_(key),
+      acoustic_scale_(acoustic_scale), beam_(beam), minimize_(minimize),
+      lat_(lat), clat_writer_(clat_writer), num_warn_(num_warn) { }
 
   void operator () () {
     Invert(lat_); // to get word labels on the input side.
@@ -55,7 +57,8 @@ class DeterminizeLatticeTask {
       (*num_warn_)++;
     }
     fst::ArcSort(lat_, fst::ILabelCompare<LatticeArc>());
-    if (!DeterminizeLatticePruned(*lat_, beam_, &det_clat_, opts_)) {
+    if (!DeterminizeLatticePrunedParallel(*lat_, beam_, &det_clat_, opts_,
+                                          parallel_opts_)) {
       KALDI_WARN << "For key " << key_ << ", determinization did not succeed"
           "(partial output will be pruned tighter than the specified beam.)";
       (*num_warn_)++;
@@ -78,6 +81,7 @@ class DeterminizeLatticeTask {
   }
  private:
   const fst::DeterminizeLatticePrunedOptions &opts_;
+  const DeterminizeLatticeParallelOptions &parallel_opts_;
   std::string key_;
   BaseFloat acoustic_scale_;
   BaseFloat beam_;
@@ -103,6 +107,9 @@ int main(int argc, char *argv[]) {
         "for each input-symbol sequence.  This is a version of lattice-determnize-pruned\n"
         "that accepts the --num-threads option.  These programs do pruning as part of the\n"
         "determinization algorithm, which is more efficient and prevents blowup.\n"
+        "With --segment-length, long lattices are also split into segments that\n"
+        "are determinized in parallel (see --segment-threads), and --max-mem-total\n"
+        "limits the memory used by all the threads together.\n"
         "See http://kaldi.sourceforge.net/lattices.html for more information on lattices.\n"
         "\n"
         "Usage: lattice-determinize-pruned-parallel [options] lattice-rspecifier lattice-wspecifier\n"
@@ -113,6 +120,8 @@ int main(int argc, char *argv[]) {
     BaseFloat beam = 10.0;
     bool minimize = false;
     TaskSequencerConfig sequencer_config; // has --num-threads option
+    DeterminizeLatticeParallelOptions parallel_config;
+    int32 max_mem_total = 0;
     fst::DeterminizeLatticePrunedOptions determinize_config; // Options used in DeterminizeLatticePruned--
     // this options class does not have its own Register function as it's viewed as
     // being more part of "fst world", so we register its elements independently.
@@ -124,8 +133,12 @@ int main(int argc, char *argv[]) {
     po.Register("beam", &beam, "Pruning beam [applied after acoustic scaling].");
     po.Register("minimize", &minimize,
                 "If true, push and minimize after determinization");
+    po.Register("max-mem-total", &max_mem_total, "If >0, the maximum "
+                "approximate memory usage of all the determinizations running "
+                "at the same time (replaces --max-mem)");
     determinize_config.Register(&po);
     sequencer_config.Register(&po);
+    parallel_config.Register(&po);
     po.Read(argc, argv);
 
     if (po.NumArgs() != 2) {
@@ -143,6 +156,9 @@ int main(int argc, char *argv[]) {
     
     // Write as compact lattice.
     CompactLatticeWriter compact_lat_writer(lats_wspecifier); 
+    fst::DeterminizeMemoryBudget memory_budget(max_mem_total);
+    if (max_mem_total > 0)
+      determinize_config.memory_budget = &memory_budget;
     TaskSequencer<DeterminizeLatticeTask> sequencer(sequencer_config);
     
     int32 n_done = 0, n_warn = 0;
@@ -159,7 +175,8 @@ int main(int argc, char *argv[]) {
       KALDI_VLOG(2) << "Processing lattice " << key;
 
       DeterminizeLatticeTask *task = new DeterminizeLatticeTask(
-          determinize_config, key, acoustic_scale, beam, minimize,
+          determinize_config, parallel_config, key, acoustic_scale, beam,
+          minimize,
           lat, &compact_lat_writer, &n_warn);
       sequencer.Run(task);
       n_done++;
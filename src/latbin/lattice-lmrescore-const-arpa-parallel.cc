@@ -0,0 +1,188 @@
+// latbin/lattice-lmrescore-const-arpa-parallel.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "base/kaldi-common.h"
+#include "fstext/fstext-lib.h"
+#include "lat/kaldi-lattice.h"
+#include "lat/lattice-functions.h"
+#include "lm/const-arpa-lm.h"
+#include "thread/kaldi-task-sequence.h"
+#include "util/common-utils.h"
+
+namespace kaldi {
+
+class ConstArpaLmRescoreTask {
+ public:
+  // Initializer takes ownership of "clat".  The language model is shared by
+  // all the tasks; this is safe because it is only accessed through const
+  // methods.  So is "lm_cache", if not NULL, which is thread-safe.
+  ConstArpaLmRescoreTask(const ConstArpaLm &const_arpa,
+                         fst::SharedArcCache<fst::StdArc> *lm_cache,
+                         BaseFloat lm_scale,
+                         const std::string &key,
+                         CompactLattice *clat,
+                         CompactLatticeWriter *clat_writer,
+                         int32 *num_done,
+                         int32 *num_fail):
+      const_arpa_(const_arpa), lm_cache_(lm_cache), lm_scale_(lm_scale),
+      key_(key), clat_(clat), clat_writer_(clat_writer), num_done_(num_done),
+      num_fail_(num_fail) { }
+
+  void operator () () {
+    if (lm_scale_ == 0.0) {
+      // Zero scale so nothing to do.
+      std::swap(*clat_, rescored_clat_);
+    } else {
+      // Before composing with the LM FST, we scale the lattice weights by the
+      // inverse of "lm_scale".  We'll later scale by "lm_scale".  We do it this
+      // way so we can determinize and it will give the right effect (taking
+      // the "best path" through the LM) regardless of the sign of lm_scale.
+      fst::ScaleLattice(fst::GraphLatticeScale(1.0 / lm_scale_), clat_);
+      ArcSort(clat_, fst::OLabelCompare<CompactLatticeArc>());
+
+      // Wraps the ConstArpaLm format language model into FST.  Each task has
+      // its own, since it caches the states it has visited.
+      ConstArpaLmDeterministicFst const_arpa_fst(const_arpa_, lm_cache_);
+
+      // Composes lattice with language model.
+      CompactLattice composed_clat;
+      ComposeCompactLatticeDeterministic(*clat_, &const_arpa_fst,
+                                         &composed_clat);
+      delete clat_;  // This is no longer needed so we can delete it now.
+      clat_ = NULL;
+
+      // Determinizes the composed lattice.
+      Lattice composed_lat;
+      ConvertLattice(composed_clat, &composed_lat);
+      composed_clat.DeleteStates();
+      Invert(&composed_lat);
+      DeterminizeLattice(composed_lat, &rescored_clat_);
+      fst::ScaleLattice(fst::GraphLatticeScale(lm_scale_), &rescored_clat_);
+    }
+  }
+
+  ~ConstArpaLmRescoreTask() {
+    delete clat_;
+    if (lm_scale_ != 0.0 && rescored_clat_.Start() == fst::kNoStateId) {
+      KALDI_WARN << "Empty lattice for utterance " << key_
+                 << " (incompatible LM?)";
+      (*num_fail_)++;
+    } else {
+      clat_writer_->Write(key_, rescored_clat_);
+      (*num_done_)++;
+    }
+  }
+
+ private:
+  const ConstArpaLm &const_arpa_;
+  fst::SharedArcCache<fst::StdArc> *lm_cache_;
+  BaseFloat lm_scale_;
+  std::string key_;
+  CompactLattice *clat_;  // The input lattice.  Owned locally.
+  CompactLattice rescored_clat_;  // The output of our process.  Will be
+                                  // written to clat_writer_ in the destructor.
+  CompactLatticeWriter *clat_writer_;
+  int32 *num_done_;
+  int32 *num_fail_;
+};
+
+}  // namespace kaldi
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    typedef kaldi::int32 int32;
+    typedef kaldi::int64 int64;
+
+    const char *usage =
+        "Rescores lattice with the ConstArpaLm format language model.  This is\n"
+        "a version of lattice-lmrescore-const-arpa that accepts the\n"
+        "--num-threads option: lattices are rescored in parallel, sharing one\n"
+        "copy of the language model, and are written in the order they were\n"
+        "read.\n"
+        "\n"
+        "Usage: lattice-lmrescore-const-arpa-parallel [options] \\\n"
+        "            lattice-rspecifier const-arpa-in lattice-wspecifier\n"
+        " e.g.: lattice-lmrescore-const-arpa-parallel --num-threads=8 \\\n"
+        "            --lm-scale=-1.0 ark:in.lats const_arpa ark:out.lats\n";
+
+    ParseOptions po(usage);
+    BaseFloat lm_scale = 1.0;
+    int32 lm_cache_size = 0;
+    TaskSequencerConfig sequencer_config;  // has --num-threads option
+
+    po.Register("lm-scale", &lm_scale, "Scaling factor for language model "
+                "costs; frequently 1.0 or -1.0");
+    po.Register("lm-cache-size", &lm_cache_size, "If positive, the number of "
+                "language model arcs cached across lattices and threads; the "
+                "hit rate is printed at the end, to help choose it.");
+    sequencer_config.Register(&po);
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 3) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string lats_rspecifier = po.GetArg(1),
+        lm_rxfilename = po.GetArg(2),
+        lats_wspecifier = po.GetArg(3);
+
+    // Reads the language model in ConstArpaLm format.  If it was written in
+    // the aligned format (see const-arpa-copy), it is memory-mapped.
+    ConstArpaLm const_arpa;
+    const_arpa.ReadMapped(lm_rxfilename);
+
+    // The cache of language model arcs shared by all the lattices.
+    fst::SharedArcCache<fst::StdArc> *lm_cache = NULL;
+    if (lm_cache_size > 0)
+      lm_cache = new fst::SharedArcCache<fst::StdArc>(lm_cache_size);
+
+    // Reads and writes as compact lattice.
+    SequentialCompactLatticeReader compact_lattice_reader(lats_rspecifier);
+    CompactLatticeWriter compact_lattice_writer(lats_wspecifier);
+
+    int32 n_done = 0, n_fail = 0;
+    {
+      TaskSequencer<ConstArpaLmRescoreTask> sequencer(sequencer_config);
+      for (; !compact_lattice_reader.Done(); compact_lattice_reader.Next()) {
+        std::string key = compact_lattice_reader.Key();
+        // Will give ownership to "task" below.
+        CompactLattice *clat =
+            new CompactLattice(compact_lattice_reader.Value());
+        compact_lattice_reader.FreeCurrent();
+
+        sequencer.Run(new ConstArpaLmRescoreTask(
+            const_arpa, lm_cache, lm_scale, key, clat,
+            &compact_lattice_writer, &n_done, &n_fail));
+      }
+      sequencer.Wait();
+    }
+
+    if (lm_cache != NULL) {
+      KALDI_LOG << lm_cache->Info();
+      delete lm_cache;
+    }
+    KALDI_LOG << "Done " << n_done << " lattices, failed for " << n_fail;
+    return (n_done != 0 ? 0 : 1);
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
@@ -45,9 +45,13 @@ int main(int argc, char *argv[]) {
 
     ParseOptions po(usage);
     BaseFloat lm_scale = 1.0;
+    int32 lm_cache_size = 0;
 
     po.Register("lm-scale", &lm_scale, "Scaling factor for language model "
                 "costs; frequently 1.0 or -1.0");
+    po.Register("lm-cache-size", &lm_cache_size, "If positive, the number of "
+                "language model arcs cached across lattices; the hit rate is "
+                "printed at the end, to help choose it.");
 
     po.Read(argc, argv);
 
@@ -60,9 +64,15 @@ int main(int argc, char *argv[]) {
         lm_rxfilename = po.GetArg(2),
         lats_wspecifier = po.GetArg(3);
 
-    // Reads the language model in ConstArpaLm format.
+    // Reads the language model in ConstArpaLm format.  If it was written in
+    // the aligned format (see const-arpa-copy), it is memory-mapped.
     ConstArpaLm const_arpa;
-    ReadKaldiObject(lm_rxfilename, &const_arpa);
+    const_arpa.ReadMapped(lm_rxfilename);
+
+    // The cache of language model arcs shared by all the lattices.
+    fst::SharedArcCache<fst::StdArc> *lm_cache = NULL;
+    if (lm_cache_size > 0)
+      lm_cache = new fst::SharedArcCache<fst::StdArc>(lm_cache_size);
 
     // Reads and writes as compact lattice.
     SequentialCompactLatticeReader compact_lattice_reader(lats_rspecifier);
@@ -84,8 +94,9 @@ int main(int argc, char *argv[]) {
         ArcSort(&clat, fst::OLabelCompare<CompactLatticeArc>());
 
         // Wraps the ConstArpaLm format language model into FST. We re-create it
-        // for each lattice to prevent memory usage increasing with time.
-        ConstArpaLmDeterministicFst const_arpa_fst(const_arpa);
+        // for each lattice to prevent memory usage increasing with time;
+        // <lm_cache> is bounded, so it can be kept.
+        ConstArpaLmDeterministicFst const_arpa_fst(const_arpa, lm_cache);
 
         // Composes lattice with language model.
         CompactLattice composed_clat;
@@ -114,6 +125,10 @@ int main(int argc, char *argv[]) {
       }
     }
 
+    if (lm_cache != NULL) {
+      KALDI_LOG << lm_cache->Info();
+      delete lm_cache;
+    }
     KALDI_LOG << "Done " << n_done << " lattices, failed for " << n_fail;
     return (n_done != 0 ? 0 : 1);
   } catch(const std::exception &e) {
@@ -0,0 +1,230 @@
+// latbin/lattice-lmrescore-rnnlm-parallel.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "base/kaldi-common.h"
+#include "fstext/fstext-lib.h"
+#include "lat/kaldi-lattice.h"
+#include "lat/lattice-functions.h"
+#include "lm/kaldi-rnnlm.h"
+#include "lm/kaldi-rnnlm-batched.h"
+#include "thread/kaldi-task-sequence.h"
+#include "util/common-utils.h"
+
+namespace kaldi {
+
+class RnnlmRescoreTask {
+ public:
+  // Initializer takes ownership of the lattices in "clats".  The model is
+  // shared by all the tasks.
+  RnnlmRescoreTask(const RnnlmBatchedModel &model,
+                   int32 max_ngram_order,
+                   BaseFloat lm_scale,
+                   const std::vector<std::string> &keys,
+                   const std::vector<CompactLattice*> &clats,
+                   CompactLatticeWriter *clat_writer,
+                   int32 *num_done,
+                   int32 *num_fail):
+      model_(model), max_ngram_order_(max_ngram_order), lm_scale_(lm_scale),
+      keys_(keys), clats_(clats), rescored_clats_(clats.size()),
+      clat_writer_(clat_writer), num_done_(num_done), num_fail_(num_fail) { }
+
+  void operator () () {
+    if (lm_scale_ == 0.0) {
+      // Zero scale so nothing to do.
+      for (size_t i = 0; i < clats_.size(); i++)
+        std::swap(*(clats_[i]), rescored_clats_[i]);
+      return;
+    }
+    // The lattices of this task share the RNNLM computer, so that the RNNLM
+    // queries for all of them are computed in the same batches.  Each has its
+    // own RNNLM FST, so that its states (which with --max-ngram-order decide
+    // the hidden layers) do not depend on the other lattices in the batch.
+    RnnlmBatchedComputer computer(model_, max_ngram_order_);
+    std::vector<RnnlmBatchedDeterministicFst*> rnnlm_fsts(clats_.size());
+    std::vector<const fst::Fst<CompactLatticeArc>*> fsts(clats_.size());
+    for (size_t i = 0; i < clats_.size(); i++) {
+      rnnlm_fsts[i] = new RnnlmBatchedDeterministicFst(&computer);
+      // Before composing with the LM FST, we scale the lattice weights by the
+      // inverse of "lm_scale".  We'll later scale by "lm_scale".  We do it this
+      // way so we can determinize and it will give the right effect (taking
+      // the "best path" through the LM) regardless of the sign of lm_scale.
+      fst::ScaleLattice(fst::GraphLatticeScale(1.0 / lm_scale_), clats_[i]);
+      ArcSort(clats_[i], fst::OLabelCompare<CompactLatticeArc>());
+      fsts[i] = clats_[i];
+    }
+    RnnlmBatchedDeterministicFst::Prefetch(fsts, rnnlm_fsts);
+
+    for (size_t i = 0; i < clats_.size(); i++) {
+      // Composes lattice with language model.
+      CompactLattice composed_clat;
+      ComposeCompactLatticeDeterministic(*(clats_[i]), rnnlm_fsts[i],
+                                         &composed_clat);
+      delete rnnlm_fsts[i];
+      delete clats_[i];  // This is no longer needed so we can delete it now.
+      clats_[i] = NULL;
+
+      // Determinizes the composed lattice.
+      Lattice composed_lat;
+      ConvertLattice(composed_clat, &composed_lat);
+      composed_clat.DeleteStates();
+      Invert(&composed_lat);
+      DeterminizeLattice(composed_lat, &(rescored_clats_[i]));
+      fst::ScaleLattice(fst::GraphLatticeScale(lm_scale_),
+                        &(rescored_clats_[i]));
+    }
+  }
+
+  ~RnnlmRescoreTask() {
+    for (size_t i = 0; i < clats_.size(); i++) {
+      delete clats_[i];
+      if (lm_scale_ != 0.0 &&
+          rescored_clats_[i].Start() == fst::kNoStateId) {
+        KALDI_WARN << "Empty lattice for utterance " << keys_[i]
+                   << " (incompatible LM?)";
+        (*num_fail_)++;
+      } else {
+        clat_writer_->Write(keys_[i], rescored_clats_[i]);
+        (*num_done_)++;
+      }
+    }
+  }
+
+ private:
+  const RnnlmBatchedModel &model_;
+  int32 max_ngram_order_;
+  BaseFloat lm_scale_;
+  std::vector<std::string> keys_;
+  std::vector<CompactLattice*> clats_;  // The input lattices.  Owned locally.
+  std::vector<CompactLattice> rescored_clats_;  // The output of our process.
+                                                // Will be written to
+                                                // clat_writer_ in the
+                                                // destructor.
+  CompactLatticeWriter *clat_writer_;
+  int32 *num_done_;
+  int32 *num_fail_;
+};
+
+}  // namespace kaldi
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    typedef kaldi::int32 int32;
+
+    const char *usage =
+        "Rescores lattice with rnnlm.  This is a version of\n"
+        "lattice-lmrescore-rnnlm that evaluates the rnnlm for many histories\n"
+        "at once with matrix products, rescores groups of --batch-size\n"
+        "lattices together, and accepts the --num-threads option; all the\n"
+        "threads share one copy of the rnnlm.  Lattices are written in the\n"
+        "order they were read.\n"
+        "\n"
+        "Usage: lattice-lmrescore-rnnlm-parallel [options] \\\n"
+        "             [unk_prob_rspecifier] <word-symbol-table-rxfilename> \\\n"
+        "             <lattice-rspecifier> <rnnlm-rxfilename> \\\n"
+        "             <lattice-wspecifier>\n"
+        " e.g.: lattice-lmrescore-rnnlm-parallel --num-threads=8 \\\n"
+        "             --lm-scale=-1.0 words.txt ark:in.lats rnnlm ark:out.lats\n";
+
+    ParseOptions po(usage);
+    int32 max_ngram_order = 3;
+    BaseFloat lm_scale = 1.0;
+    int32 batch_size = 4;
+    TaskSequencerConfig sequencer_config;  // has --num-threads option
+
+    po.Register("lm-scale", &lm_scale, "Scaling factor for language model "
+                "costs; frequently 1.0 or -1.0");
+    po.Register("max-ngram-order", &max_ngram_order, "If positive, limit the "
+                "rnnlm context to the given number, -1 means we are not going "
+                "to limit it.");
+    po.Register("batch-size", &batch_size, "Number of lattices that are "
+                "rescored together, sharing the rnnlm computation; this does "
+                "not change the output.");
+
+    KaldiRnnlmWrapperOpts opts;
+    opts.Register(&po);
+    sequencer_config.Register(&po);
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 4 && po.NumArgs() != 5) {
+      po.PrintUsage();
+      exit(1);
+    }
+    if (batch_size < 1)
+      KALDI_ERR << "Invalid --batch-size " << batch_size;
+
+    std::string lats_rspecifier, unk_prob_rspecifier,
+        word_symbols_rxfilename, rnnlm_rxfilename, lats_wspecifier;
+    if (po.NumArgs() == 4) {
+      unk_prob_rspecifier = "";
+      word_symbols_rxfilename = po.GetArg(1);
+      lats_rspecifier = po.GetArg(2);
+      rnnlm_rxfilename = po.GetArg(3);
+      lats_wspecifier = po.GetArg(4);
+    } else if (po.NumArgs() == 5) {
+      unk_prob_rspecifier = po.GetArg(1);
+      word_symbols_rxfilename = po.GetArg(2);
+      lats_rspecifier = po.GetArg(3);
+      rnnlm_rxfilename = po.GetArg(4);
+      lats_wspecifier = po.GetArg(5);
+    }
+
+    // Reads the language model.  The batched model keeps a pointer to the
+    // direct connections of <rnnlm>, so we keep that too.
+    KaldiRnnlmWrapper rnnlm(opts, unk_prob_rspecifier,
+                            word_symbols_rxfilename, rnnlm_rxfilename);
+    RnnlmBatchedModel model(rnnlm.GetRnnlm(), rnnlm.GetLabelToWord(),
+                            rnnlm.GetEos());
+
+    // Reads and writes as compact lattice.
+    SequentialCompactLatticeReader compact_lattice_reader(lats_rspecifier);
+    CompactLatticeWriter compact_lattice_writer(lats_wspecifier);
+
+    int32 n_done = 0, n_fail = 0;
+    {
+      TaskSequencer<RnnlmRescoreTask> sequencer(sequencer_config);
+      std::vector<std::string> keys;
+      std::vector<CompactLattice*> clats;
+      for (; !compact_lattice_reader.Done(); compact_lattice_reader.Next()) {
+        keys.push_back(compact_lattice_reader.Key());
+        // Will give ownership to "task" below.
+        clats.push_back(new CompactLattice(compact_lattice_reader.Value()));
+        compact_lattice_reader.FreeCurrent();
+        if (clats.size() == static_cast<size_t>(batch_size)) {
+          sequencer.Run(new RnnlmRescoreTask(
+              model, max_ngram_order, lm_scale, keys, clats,
+              &compact_lattice_writer, &n_done, &n_fail));
+          keys.clear();
+          clats.clear();
+        }
+      }
+      if (!clats.empty())
+        sequencer.Run(new RnnlmRescoreTask(
+            model, max_ngram_order, lm_scale, keys, clats,
+            &compact_lattice_writer, &n_done, &n_fail));
+      sequencer.Wait();
+    }
+
+    KALDI_LOG << "Done " << n_done << " lattices, failed for " << n_fail;
+    return (n_done != 0 ? 0 : 1);
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
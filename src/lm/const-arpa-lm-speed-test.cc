@@ -0,0 +1,151 @@
+// lm/const-arpa-lm-speed-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <set>
+
+#include "base/timer.h"
+#include "lm/const-arpa-lm.h"
+
+namespace kaldi {
+
+// Returns a random word from 3 ... num_words, with a skewed distribution as in
+// real text, so that frequent words have many successors.
+static int32 RandWord(int32 num_words) {
+  return 3 + std::min(num_words - 3, static_cast<int32>(
+      (num_words - 2) * std::pow(RandUniform(), 3)));
+}
+
+// Writes a random Arpa language model with integer words (<s> is 1, </s> is
+// 2), where every n-gram has its history and its suffix as n-grams of the
+// order below, and outputs some of the n-grams of the highest order.
+static void WriteRandomArpa(const std::string &filename, int32 ngram_order,
+                            int32 num_words, int32 num_ngrams_per_order,
+                            std::vector<std::vector<int32> > *top_ngrams) {
+  std::vector<std::set<std::vector<int32> > > ngrams(ngram_order + 1);
+  for (int32 w = 1; w <= num_words; w++)
+    ngrams[1].insert(std::vector<int32>(1, w));
+  for (int32 n = 2; n <= ngram_order; n++) {
+    // The last word of an n-gram is one that follows its history without the
+    // first word, so that its suffix exists.
+    std::vector<std::vector<int32> > histories;
+    std::map<std::vector<int32>, std::vector<int32> > successors;
+    std::set<std::vector<int32> >::iterator iter;
+    for (iter = ngrams[n - 1].begin(); iter != ngrams[n - 1].end(); ++iter) {
+      if (iter->back() == 2) continue;
+      histories.push_back(*iter);
+      if (n > 2)
+        successors[std::vector<int32>(iter->begin(), iter->end() - 1)].
+            push_back(iter->back());
+    }
+    for (int32 i = 0; i < num_ngrams_per_order; i++) {
+      std::vector<int32> ngram(histories[RandInt(0, histories.size() - 1)]);
+      if (n == 2) {
+        ngram.push_back(RandWord(num_words));
+      } else {
+        std::vector<int32> suffix(ngram.begin() + 1, ngram.end());
+        std::map<std::vector<int32>, std::vector<int32> >::iterator
+            succ_iter = successors.find(suffix);
+        if (succ_iter == successors.end()) continue;
+        const std::vector<int32> &words = succ_iter->second;
+        ngram.push_back(words[RandWord(words.size() + 2) - 3]);
+      }
+      ngrams[n].insert(ngram);
+    }
+  }
+  top_ngrams->assign(ngrams[ngram_order].begin(), ngrams[ngram_order].end());
+
+  std::ofstream os(filename.c_str());
+  os << "\n\\data\\\n";
+  for (int32 n = 1; n <= ngram_order; n++)
+    os << "ngram " << n << "=" << ngrams[n].size() << "\n";
+  for (int32 n = 1; n <= ngram_order; n++) {
+    os << "\n\\" << n << "-grams:\n";
+    std::set<std::vector<int32> >::iterator iter;
+    for (iter = ngrams[n].begin(); iter != ngrams[n].end(); ++iter) {
+      os << (iter->front() == 1 && n == 1 ? -99.0 : -RandUniform() * 3)
+         << '\t';
+      for (size_t i = 0; i < iter->size(); i++)
+        os << (i == 0 ? "" : " ") << (*iter)[i];
+      if (n < ngram_order)
+        os << '\t' << -RandUniform();
+      os << '\n';
+    }
+  }
+  os << "\n\\end\\\n";
+}
+
+// Compares the memory and the time per query of the language model in the
+// normal format and quantized to 16 and 8 bits.
+static void TestConstArpaLmSpeed(int32 ngram_order, int32 num_words,
+                                 int32 num_ngrams_per_order) {
+  std::vector<std::vector<int32> > top_ngrams;
+  WriteRandomArpa("tmp.arpa", ngram_order, num_words, num_ngrams_per_order,
+                  &top_ngrams);
+
+  // Half the queries are n-grams of the highest order and half are random
+  // words, which mostly back off.
+  int32 num_queries = 1000000;
+  std::vector<std::vector<int32> > hists(num_queries);
+  std::vector<int32> words(num_queries);
+  for (int32 i = 0; i < num_queries; i++) {
+    if (RandInt(0, 1) == 0) {
+      const std::vector<int32> &ngram =
+          top_ngrams[RandInt(0, top_ngrams.size() - 1)];
+      hists[i].assign(ngram.begin(), ngram.end() - 1);
+      words[i] = ngram.back();
+    } else {
+      for (int32 j = 0; j + 1 < ngram_order; j++)
+        hists[i].push_back(RandWord(num_words));
+      words[i] = RandWord(num_words);
+    }
+  }
+
+  ArpaParseOptions options;
+  options.bos_symbol = 1;
+  options.eos_symbol = 2;
+  int32 quantize_bits[] = { 0, 16, 8 };
+  for (int32 q = 0; q < 3; q++) {
+    BuildConstArpaLm(options, "tmp.arpa", "tmp.carpa", quantize_bits[q]);
+    ConstArpaLm lm;
+    ReadKaldiObject("tmp.carpa", &lm);
+    unlink("tmp.carpa");
+
+    Timer timer;
+    double sum = 0.0;
+    for (int32 i = 0; i < num_queries; i++)
+      sum += lm.GetNgramLogprob(words[i], hists[i]);
+    double time = timer.Elapsed();
+    KALDI_LOG << "For order " << ngram_order << ", " << num_words
+              << " words, --quantize-bits=" << quantize_bits[q] << ": "
+              << lm.NumBytes() << " bytes, "
+              << (time * 1.0e+09 / num_queries) << " ns per query "
+              << "(average log-prob " << (sum / num_queries) << ")";
+  }
+  unlink("tmp.arpa");
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  TestConstArpaLmSpeed(3, 20000, 500000);
+  TestConstArpaLmSpeed(5, 50000, 500000);
+}
@@ -0,0 +1,275 @@
+// lm/const-arpa-lm-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+
+#include "lm/const-arpa-lm.h"
+
+namespace kaldi {
+
+// Writes a random Arpa language model with integer words: <s> is 1, </s> is 2
+// and the other words are 3 ... num_words.  Every n-gram has its history and
+// its suffix as n-grams of the order below.  Half the higher-order n-grams
+// extend one of a few histories, so that some histories have many children.
+// The order is reduced if no n-grams of an order could be made.  If
+// <ngrams_out> is not NULL, outputs the n-grams of all orders with their
+// log-prob and backoff.
+static void WriteRandomArpa(const std::string &filename, int32 ngram_order,
+                            int32 num_words, int32 num_ngrams_per_order,
+                            std::map<std::vector<int32>,
+                                     std::pair<float, float> > *ngrams_out =
+                                NULL) {
+  // For each order, maps the n-grams to their log-prob and backoff.
+  std::vector<std::map<std::vector<int32>, std::pair<float, float> > >
+      ngrams(ngram_order + 1);
+  for (int32 w = 2; w <= num_words; w++) {
+    ngrams[1][std::vector<int32>(1, w)] =
+        std::make_pair(-RandUniform() * 3 - 0.1,
+                       (RandInt(0, 3) == 0 ? 0.0 : -RandUniform()));
+  }
+  ngrams[1][std::vector<int32>(1, 1)] = std::make_pair(-99.0, -RandUniform());
+  for (int32 n = 2; n <= ngram_order; n++) {
+    std::vector<std::vector<int32> > histories;
+    std::map<std::vector<int32>, std::pair<float, float> >::iterator iter;
+    for (iter = ngrams[n - 1].begin(); iter != ngrams[n - 1].end(); ++iter)
+      if (iter->first.back() != 2) histories.push_back(iter->first);
+    for (int32 i = 0; !histories.empty() && i < num_ngrams_per_order; i++) {
+      int32 h = (RandInt(0, 1) == 0 ? RandInt(0, 2) :
+                 RandInt(0, histories.size() - 1));
+      std::vector<int32> ngram(histories[h % histories.size()]);
+      ngram.push_back(RandInt(2, num_words));
+      std::vector<int32> suffix(ngram.begin() + 1, ngram.end());
+      if (ngrams[n - 1].count(suffix) == 0) continue;
+      ngrams[n][ngram] = std::make_pair(
+          -RandUniform() * 2 - 0.1,
+          (n == ngram_order || RandInt(0, 3) == 0 ? 0.0 : -RandUniform()));
+    }
+    if (ngrams[n].empty()) {
+      ngram_order = n - 1;
+      break;
+    }
+  }
+  std::ofstream os(filename.c_str());
+  os << "\n\\data\\\n";
+  for (int32 n = 1; n <= ngram_order; n++)
+    os << "ngram " << n << "=" << ngrams[n].size() << "\n";
+  for (int32 n = 1; n <= ngram_order; n++) {
+    os << "\n\\" << n << "-grams:\n";
+    std::map<std::vector<int32>, std::pair<float, float> >::iterator iter;
+    for (iter = ngrams[n].begin(); iter != ngrams[n].end(); ++iter) {
+      os << iter->second.first << '\t';
+      for (size_t i = 0; i < iter->first.size(); i++)
+        os << (i == 0 ? "" : " ") << iter->first[i];
+      if (n < ngram_order)
+        os << '\t' << iter->second.second;
+      os << '\n';
+    }
+  }
+  os << "\n\\end\\\n";
+  if (ngrams_out != NULL) {
+    ngrams_out->clear();
+    for (int32 n = 1; n <= ngram_order; n++)
+      ngrams_out->insert(ngrams[n].begin(), ngrams[n].end());
+  }
+}
+
+// Checks that <lm2> gives the same log-probs as <lm1> to within <delta>, and
+// has the same history states, for random word sequences.
+static void CheckSameLm(const ConstArpaLm &lm1, const ConstArpaLm &lm2,
+                        int32 num_words, float delta) {
+  KALDI_ASSERT(lm1.NgramOrder() == lm2.NgramOrder());
+  // The state ids are different, but must correspond one to one.
+  std::map<int64, int64> ids12, ids21;
+  for (int32 i = 0; i < 2000; i++) {
+    // Mostly words that are in the language model, and sometimes words that
+    // are not.
+    std::vector<int32> hist;
+    if (RandInt(0, 1) == 0) hist.push_back(1);
+    int32 length = RandInt(0, lm1.NgramOrder() + 1);
+    for (int32 j = 0; j < length; j++)
+      hist.push_back(RandInt(0, 20) == 0 ? num_words + 1 + RandInt(0, 3) :
+                     RandInt(2, num_words));
+    int32 word = (RandInt(0, 20) == 0 ? num_words + 1 : RandInt(2, num_words));
+    float logprob1 = lm1.GetNgramLogprob(word, hist),
+        logprob2 = lm2.GetNgramLogprob(word, hist);
+    if (logprob1 == std::numeric_limits<float>::min())
+      KALDI_ASSERT(logprob2 == logprob1);
+    else
+      AssertEqual(logprob1, logprob2, delta);
+
+    int64 id1, id2;
+    bool exists1 = lm1.HistoryStateExists(hist, &id1),
+        exists2 = lm2.HistoryStateExists(hist, &id2);
+    KALDI_ASSERT(exists1 == exists2);
+    std::vector<int32> hist1(hist), hist2(hist);
+    lm1.ExtendHistoryState(word, &hist1, &id1);
+    lm2.ExtendHistoryState(word, &hist2, &id2);
+    KALDI_ASSERT(hist1 == hist2);
+    KALDI_ASSERT((id1 == -1) == (id2 == -1));
+    if (ids12.count(id1) == 0) ids12[id1] = id2;
+    if (ids21.count(id2) == 0) ids21[id2] = id1;
+    KALDI_ASSERT(ids12[id1] == id2 && ids21[id2] == id1);
+  }
+}
+
+static void UnitTestConstArpaLmQuantized() {
+  int32 ngram_order = RandInt(1, 5), num_words = RandInt(5, 500),
+      num_ngrams_per_order = RandInt(10, 5000);
+  WriteRandomArpa("tmp.arpa", ngram_order, num_words, num_ngrams_per_order);
+  ArpaParseOptions options;
+  options.bos_symbol = 1;
+  options.eos_symbol = 2;
+  BuildConstArpaLm(options, "tmp.arpa", "tmp.carpa");
+  BuildConstArpaLm(options, "tmp.arpa", "tmp.q8.carpa", 8);
+  BuildConstArpaLm(options, "tmp.arpa", "tmp.q16.carpa", 16);
+  unlink("tmp.arpa");
+
+  ConstArpaLm lm, lm8, lm16;
+  ReadKaldiObject("tmp.carpa", &lm);
+  ReadKaldiObject("tmp.q8.carpa", &lm8);
+  ReadKaldiObject("tmp.q16.carpa", &lm16);
+  KALDI_ASSERT(lm.QuantizeBits() == 0 && lm8.QuantizeBits() == 8 &&
+               lm16.QuantizeBits() == 16);
+  KALDI_LOG << "Order " << lm.NgramOrder() << ", " << num_words << " words: "
+            << lm.NumBytes() << " bytes, quantized to 8 bits "
+            << lm8.NumBytes() << ", to 16 bits " << lm16.NumBytes();
+  // The test language models have fewer than 2^16 n-grams of each order, so
+  // with 16 bits there is no loss.
+  CheckSameLm(lm, lm16, num_words, 1.0e-04);
+  CheckSameLm(lm, lm8, num_words, 0.1);
+
+  // Writes the quantized model in both formats and reads it back, by mapping
+  // the file if it is aligned.
+  for (int32 aligned = 0; aligned < 2; aligned++) {
+    {
+      Output ko("tmp.q8.copy.carpa", true);
+      lm8.Write(ko.Stream(), true, aligned == 1);
+    }
+    ConstArpaLm lm8_copy;
+    lm8_copy.ReadMapped("tmp.q8.copy.carpa");
+    CheckSameLm(lm8, lm8_copy, num_words, 0.0);
+    unlink("tmp.q8.copy.carpa");
+  }
+
+  // The Arpa files written from the models have the same n-grams.
+  std::ostringstream os, os16;
+  lm.WriteArpa(os);
+  lm16.WriteArpa(os16);
+  std::string arpa = os.str(), arpa16 = os16.str();
+  KALDI_ASSERT(std::count(arpa.begin(), arpa.end(), '\n') ==
+               std::count(arpa16.begin(), arpa16.end(), '\n'));
+
+  unlink("tmp.carpa");
+  unlink("tmp.q8.carpa");
+  unlink("tmp.q16.carpa");
+}
+
+// The reference for GetNgramLogprob(): the recursion over the n-grams that
+// ConstArpaLm used before it looked up the histories in place.  <hist> has at
+// most ngram_order - 1 words.  The result is in log10, as in the Arpa file.
+static float ReferenceNgramLogprob(
+    const std::map<std::vector<int32>, std::pair<float, float> > &ngrams,
+    int32 word, const std::vector<int32> &hist) {
+  std::vector<int32> ngram(hist);
+  ngram.push_back(word);
+  std::map<std::vector<int32>, std::pair<float, float> >::const_iterator
+      iter = ngrams.find(ngram);
+  if (iter != ngrams.end())
+    return iter->second.first;
+  if (hist.empty())
+    return std::numeric_limits<float>::min();
+  float backoff_logprob = 0.0;
+  if ((iter = ngrams.find(hist)) != ngrams.end())
+    backoff_logprob = iter->second.second;
+  return backoff_logprob + ReferenceNgramLogprob(
+      ngrams, word, std::vector<int32>(hist.begin() + 1, hist.end()));
+}
+
+// Compares GetNgramLogprob() and ExtendHistoryState() with the reference
+// computed from the n-grams, for random word sequences.  A history state
+// exists for the n-grams that have children.
+static void UnitTestConstArpaLmBackoff() {
+  int32 ngram_order = RandInt(1, 5), num_words = RandInt(5, 500),
+      num_ngrams_per_order = RandInt(10, 5000);
+  std::map<std::vector<int32>, std::pair<float, float> > ngrams;
+  WriteRandomArpa("tmp.arpa", ngram_order, num_words, num_ngrams_per_order,
+                  &ngrams);
+  ArpaParseOptions options;
+  options.bos_symbol = 1;
+  options.eos_symbol = 2;
+  BuildConstArpaLm(options, "tmp.arpa", "tmp.carpa");
+  unlink("tmp.arpa");
+  ConstArpaLm lm;
+  ReadKaldiObject("tmp.carpa", &lm);
+  unlink("tmp.carpa");
+  ngram_order = lm.NgramOrder();
+
+  std::set<std::vector<int32> > states;
+  std::map<std::vector<int32>, std::pair<float, float> >::const_iterator iter;
+  for (iter = ngrams.begin(); iter != ngrams.end(); ++iter) {
+    const std::vector<int32> &ngram = iter->first;
+    if (ngram.size() > 1)
+      states.insert(std::vector<int32>(ngram.begin(), ngram.end() - 1));
+  }
+
+  for (int32 i = 0; i < 2000; i++) {
+    std::vector<int32> hist;
+    if (RandInt(0, 1) == 0) hist.push_back(1);
+    int32 length = RandInt(0, ngram_order + 1);
+    for (int32 j = 0; j < length; j++)
+      hist.push_back(RandInt(0, 20) == 0 ? num_words + 1 + RandInt(0, 3) :
+                     RandInt(2, num_words));
+    int32 word = (RandInt(0, 20) == 0 ? num_words + 1 : RandInt(2, num_words));
+
+    std::vector<int32> ref_hist(hist);
+    if (ref_hist.size() >= static_cast<size_t>(ngram_order))
+      ref_hist.erase(ref_hist.begin(),
+                     ref_hist.end() - (ngram_order - 1));
+    float logprob = lm.GetNgramLogprob(word, hist),
+        ref_logprob = ReferenceNgramLogprob(ngrams, word, ref_hist) * M_LN10;
+    if (ngrams.count(std::vector<int32>(1, word)) == 0)
+      KALDI_ASSERT(logprob == std::numeric_limits<float>::min());
+    else
+      AssertEqual(logprob, ref_logprob, 1.0e-04);
+
+    // The new history state is the longest suffix that has a state.
+    ref_hist.push_back(word);
+    if (ref_hist.size() >= static_cast<size_t>(ngram_order))
+      ref_hist.erase(ref_hist.begin());
+    while (!ref_hist.empty() && states.count(ref_hist) == 0)
+      ref_hist.erase(ref_hist.begin());
+    int64 state_id;
+    lm.ExtendHistoryState(word, &hist, &state_id);
+    KALDI_ASSERT(hist == ref_hist);
+    KALDI_ASSERT((state_id == -1) == hist.empty());
+  }
+}
+
+}  // namespace kaldi
+
+int main() {
+  for (int32 i = 0; i < 10; i++) {
+    kaldi::UnitTestConstArpaLmQuantized();
+    kaldi::UnitTestConstArpaLmBackoff();
+  }
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
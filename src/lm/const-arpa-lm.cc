@@ -18,6 +18,7 @@
 // limitations under the License.
 
 #include <algorithm>
+#include <fstream>
 #include <limits>
 #include <sstream>
 #include <utility>
@@ -31,6 +32,50 @@
 
 namespace kaldi {
 
+// In the aligned on-disk format, the LmStates array starts at an offset in the
+// file that is a multiple of this many bytes.
+static const int32 kLmStatesAlignment = 16;
+
+// In the aligned on-disk format, writes the number of padding bytes, and then
+// the padding, so that the array that follows starts at an offset in the file
+// that is a multiple of kLmStatesAlignment.
+static void WriteAlignmentPadding(std::ostream &os, bool binary) {
+  int64 pos = os.tellp();
+  if (pos < 0) {
+    KALDI_ERR << "Writing ConstArpaLm in aligned format requires an output "
+              << "that supports seeking, e.g. a file and not a pipe.";
+  }
+  // WriteBasicType() writes one byte for the size of the type, and then the
+  // int32 itself.
+  pos += 1 + sizeof(int32);
+  int32 num_pad = (kLmStatesAlignment - pos % kLmStatesAlignment) %
+      kLmStatesAlignment;
+  WriteBasicType(os, binary, num_pad);
+  std::string padding(num_pad, '\0');
+  os.write(padding.data(), num_pad);
+}
+
+// Reads what WriteAlignmentPadding() wrote.  If <mapped_file> is not NULL, it
+// is the file that "is" is reading, and this returns a pointer to the
+// <num_bytes> bytes of the array in the mapping and skips them in "is";
+// otherwise it returns NULL, and the caller has to read the array.
+static const char* ReadAlignmentPadding(std::istream &is, bool binary,
+                                        const MappedFile *mapped_file,
+                                        int64 num_bytes) {
+  int32 num_pad;
+  ReadBasicType(is, binary, &num_pad);
+  is.ignore(num_pad);
+  if (mapped_file == NULL) return NULL;
+  int64 offset = is.tellg();
+  if (offset < 0 || offset % kLmStatesAlignment != 0 ||
+      offset + num_bytes > static_cast<int64>(mapped_file->Size())) {
+    KALDI_ERR << "ConstArpaLm aligned section has bad offset " << offset
+              << " (corrupted file?)";
+  }
+  is.seekg(num_bytes, std::ios::cur);
+  return mapped_file->Data() + offset;
+}
+
 // Auxiliary struct for converting ConstArpaLm format langugae model to Arpa
 // format.
 struct ArpaLine {
@@ -176,8 +221,16 @@ class LmState {
 // auxiliary class LmState above.
 class ConstArpaLmBuilder : public ArpaFileParser {
  public:
-  ConstArpaLmBuilder(ArpaParseOptions options)
+  // If <quantize_bits> is nonzero, builds the language model in the quantized
+  // trie format (see ConstArpaLmTrie).
+  ConstArpaLmBuilder(ArpaParseOptions options, int32 quantize_bits = 0)
       : ArpaFileParser(options, NULL) {
+    if (quantize_bits != 0 && (quantize_bits < 2 || quantize_bits > 16)) {
+      KALDI_ERR << "Invalid number of quantization bits " << quantize_bits
+                << ", expected 0 or from 2 to 16.";
+    }
+    quantize_bits_ = quantize_bits;
+    trie_ = NULL;
     ngram_order_ = 0;
     num_words_ = 0;
     overflow_buffer_size_ = 0;
@@ -199,6 +252,7 @@ class ConstArpaLmBuilder : public ArpaFileParser {
       delete[] lm_states_;
       delete[] unigram_states_;
       delete[] overflow_buffer_;
+      delete trie_;
     }
   }
 
@@ -218,6 +272,9 @@ class ConstArpaLmBuilder : public ArpaFileParser {
   virtual void ReadComplete();
 
  private:
+  // Builds <trie_> instead of <lm_states_> etc. from the LmStates.
+  void BuildTrie();
+
   struct WordsAndLmStatePairLessThan {
     bool operator()(
         const std::pair<std::vector<int32>*, LmState*>& lhs,
@@ -230,6 +287,14 @@ class ConstArpaLmBuilder : public ArpaFileParser {
   // Indicating if ConstArpaLm has been built or not.
   bool is_built_;
 
+  // Number of bits of the quantized log-probs, or 0 if we are not building
+  // the quantized trie format.
+  int32 quantize_bits_;
+
+  // The language model in the quantized trie format, if <quantize_bits_> is
+  // nonzero.
+  ConstArpaLmTrie* trie_;
+
   // Maximum relative address for the child. We put it here just for testing.
   // The default value is 30-bits and should not be changed except for testing.
   int32 max_address_offset_;
@@ -345,6 +410,12 @@ void ConstArpaLmBuilder::ConsumeNGram(const NGram &ngram) {
 //    <unigram_states_>
 //    <overflow_buffer_>
 void ConstArpaLmBuilder::ReadComplete() {
+  if (quantize_bits_ != 0) {
+    BuildTrie();
+    is_built_ = true;
+    return;
+  }
+
   // STEP 1: sorting LmStates lexicographically.
   // Vector for holding the sorted LmStates.
   std::vector<std::pair<std::vector<int32>*, LmState*> > sorted_vec;
@@ -471,12 +542,72 @@ void ConstArpaLmBuilder::ReadComplete() {
   is_built_ = true;
 }
 
+// The n-grams of each order of the trie are the children of the n-grams of the
+// order below, in the order of those, and sorted by word.
+void ConstArpaLmBuilder::BuildTrie() {
+  std::vector<ConstArpaLmTrie::Order> orders(ngram_order_);
+
+  // Unigrams are indexed by word.
+  std::vector<LmState*> states(num_words_, NULL), next_states;
+  unordered_map<std::vector<int32>,
+                LmState*, VectorHasher<int32> >::iterator iter;
+  for (iter = seq_to_state_.begin(); iter != seq_to_state_.end(); ++iter) {
+    if (iter->first.size() == 1)
+      states[iter->first[0]] = iter->second;
+  }
+  ConstArpaLmTrie::Order &unigrams = orders[0];
+  unigrams.logprobs.resize(num_words_, std::numeric_limits<float>::infinity());
+  unigrams.backoffs.resize(num_words_, 0.0);
+  for (int32 i = 0; i < num_words_; ++i) {
+    if (states[i] != NULL) {
+      unigrams.logprobs[i] = states[i]->Logprob();
+      unigrams.backoffs[i] = states[i]->BackoffLogprob();
+    }
+  }
+
+  for (int32 k = 1; k < ngram_order_; ++k) {
+    ConstArpaLmTrie::Order &order = orders[k];
+    std::vector<int64> &child_begin = orders[k - 1].child_begin;
+    child_begin.resize(states.size() + 1);
+    child_begin[0] = 0;
+    next_states.clear();
+    for (size_t i = 0; i < states.size(); ++i) {
+      LmState *state = states[i];
+      int32 num_children = (state == NULL ? 0 : state->NumChildren());
+      if (num_children > 0) state->SortChildren();
+      for (int32 j = 0; j < num_children; ++j) {
+        std::pair<int32, LmState::ChildType> child = state->GetChild(j);
+        order.words.push_back(child.first);
+        if (state->IsChildFinalOrder()) {
+          order.logprobs.push_back(child.second.prob);
+        } else {
+          order.logprobs.push_back(child.second.state->Logprob());
+          order.backoffs.push_back(child.second.state->BackoffLogprob());
+          next_states.push_back(child.second.state);
+        }
+      }
+      child_begin[i + 1] = child_begin[i] + num_children;
+    }
+    states.swap(next_states);
+  }
+
+  trie_ = new ConstArpaLmTrie();
+  trie_->Init(quantize_bits_, &orders);
+}
+
 void ConstArpaLmBuilder::Write(std::ostream &os, bool binary) const {
   if (!binary) {
     KALDI_ERR << "text-mode writing is not implemented for ConstArpaLmBuilder.";
   }
   KALDI_ASSERT(is_built_);
 
+  if (trie_ != NULL) {
+    ConstArpaLm const_arpa_lm(Options().bos_symbol, Options().eos_symbol,
+                              Options().unk_symbol, trie_);
+    const_arpa_lm.Write(os, binary);
+    return;
+  }
+
   // Creates ConstArpaLm.
   ConstArpaLm const_arpa_lm(
       Options().bos_symbol, Options().eos_symbol, Options().unk_symbol,
@@ -485,7 +616,388 @@ void ConstArpaLmBuilder::Write(std::ostream &os, bool binary) const {
   const_arpa_lm.Write(os, binary);
 }
 
-void ConstArpaLm::Write(std::ostream &os, bool binary) const {
+// Returns the number of bits needed to store <value>; 0 for 0.
+static int32 NumBitsFor(uint64 value) {
+  int32 num_bits = 0;
+  while (value != 0) {
+    value >>= 1;
+    num_bits++;
+  }
+  return num_bits;
+}
+
+// Computes the codebook for quantizing <values> to <num_bits> bits: if there
+// are no more distinct values than codes, the codebook is just those values;
+// otherwise the sorted values are divided into bins with equal counts, and the
+// codebook has the mean of each bin.  If <exact_zero> is true, code 0 is
+// reserved for the value zero, which is then not counted.  The codebook is
+// sorted (apart from the zero).
+static void ComputeCodebook(const std::vector<float> &values, int32 num_bits,
+                            bool exact_zero, std::vector<float> *codebook) {
+  codebook->clear();
+  if (exact_zero) codebook->push_back(0.0);
+  std::vector<float> sorted;
+  sorted.reserve(values.size());
+  for (size_t i = 0; i < values.size(); ++i) {
+    if (!exact_zero || values[i] != 0.0)
+      sorted.push_back(values[i]);
+  }
+  std::sort(sorted.begin(), sorted.end());
+  int64 num_values = sorted.size(),
+      num_bins = (static_cast<int64>(1) << num_bits) - codebook->size();
+  int64 num_distinct = std::unique(sorted.begin(), sorted.end()) -
+      sorted.begin();
+  if (num_distinct <= num_bins) {
+    codebook->insert(codebook->end(), sorted.begin(),
+                     sorted.begin() + num_distinct);
+    return;
+  }
+  // std::unique() has reordered <sorted>, so sort it again.
+  std::sort(sorted.begin(), sorted.end());
+  for (int64 bin = 0; bin < num_bins; ++bin) {
+    int64 begin = num_values * bin / num_bins,
+        end = num_values * (bin + 1) / num_bins;
+    double sum = 0.0;
+    for (int64 i = begin; i < end; ++i)
+      sum += sorted[i];
+    codebook->push_back(sum / (end - begin));
+  }
+}
+
+// Returns the code of the closest value to <value> in <codebook>, as computed
+// by ComputeCodebook().
+static int32 QuantizeValue(const std::vector<float> &codebook, bool exact_zero,
+                           float value) {
+  if (exact_zero && value == 0.0) return 0;
+  std::vector<float>::const_iterator begin = codebook.begin() +
+      (exact_zero ? 1 : 0), iter =
+      std::lower_bound(begin, codebook.end(), value);
+  if (iter == codebook.end() ||
+      (iter != begin && value - *(iter - 1) < *iter - value))
+    --iter;
+  KALDI_ASSERT(iter >= begin);
+  return iter - codebook.begin();
+}
+
+void ConstArpaLmTrie::SetBits(int64 bit, int32 width, uint64 value) {
+  KALDI_ASSERT(width < 64 && (value >> width) == 0);
+  uint64 *p = &(owned_data_[bit >> 6]);
+  int32 shift = bit & 63;
+  p[0] |= value << shift;
+  if (shift + width > 64)
+    p[1] |= value >> (64 - shift);
+}
+
+void ConstArpaLmTrie::Set(int32 order, Field field, int64 i, uint64 value) {
+  int32 c = (order - 1) * kNumFields + field;
+  SetBits(column_offsets_[c] + i * column_widths_[c], column_widths_[c],
+          value);
+}
+
+void ConstArpaLmTrie::ComputeNgramIdOffsets() {
+  ngram_id_offset_.resize(ngram_order_);
+  int64 offset = 0;
+  for (int32 k = 0; k < ngram_order_; ++k) {
+    ngram_id_offset_[k] = offset;
+    offset += num_ngrams_[k];
+  }
+}
+
+void ConstArpaLmTrie::Init(int32 quantize_bits, std::vector<Order> *orders) {
+  KALDI_ASSERT(quantize_bits >= 2 && quantize_bits <= 16);
+  KALDI_ASSERT(!orders->empty());
+  quantize_bits_ = quantize_bits;
+  ngram_order_ = orders->size();
+  num_words_ = (*orders)[0].logprobs.size();
+  num_ngrams_.resize(ngram_order_);
+  column_offsets_.assign(ngram_order_ * kNumFields, 0);
+  column_widths_.assign(ngram_order_ * kNumFields, 0);
+
+  // First works out the size of each field.  For the word ids we need the
+  // minimum and the number of bits of each block.
+  std::vector<int64> column_bits(ngram_order_ * kNumFields, 0);
+  std::vector<std::vector<float> > logprob_codebooks(ngram_order_),
+      backoff_codebooks(ngram_order_);
+  std::vector<std::vector<int32> > block_bases(ngram_order_),
+      block_widths(ngram_order_);
+  for (int32 k = 1; k <= ngram_order_; ++k) {
+    const Order &order = (*orders)[k - 1];
+    int32 *widths = &(column_widths_[(k - 1) * kNumFields]);
+    int64 *bits = &(column_bits[(k - 1) * kNumFields]), n;
+    if (k == 1) {
+      n = num_words_;
+      KALDI_ASSERT(order.words.empty() &&
+                   static_cast<int64>(order.backoffs.size()) == n);
+      widths[kLogprob] = widths[kBackoff] = 32;
+    } else {
+      n = order.words.size();
+      KALDI_ASSERT(static_cast<int64>(order.logprobs.size()) == n);
+      KALDI_ASSERT(static_cast<int64>(order.backoffs.size()) ==
+                   (k < ngram_order_ ? n : 0));
+      // Word ids, either directly or in blocks.
+      int32 max_word = 0;
+      std::vector<int32> &bases = block_bases[k - 1],
+          &block_bits = block_widths[k - 1];
+      int64 num_block_bits = 0;
+      for (int64 b = 0; b * kWordBlockSize < n; ++b) {
+        int64 begin = b * kWordBlockSize,
+            end = std::min<int64>(begin + kWordBlockSize, n);
+        int32 min_word = order.words[begin], block_max_word = min_word;
+        for (int64 i = begin; i < end; ++i) {
+          KALDI_ASSERT(order.words[i] >= 0);
+          min_word = std::min(min_word, order.words[i]);
+          block_max_word = std::max(block_max_word, order.words[i]);
+        }
+        max_word = std::max(max_word, block_max_word);
+        bases.push_back(min_word);
+        block_bits.push_back(NumBitsFor(block_max_word - min_word));
+        num_block_bits += block_bits.back() * (end - begin);
+      }
+      int64 num_blocks = bases.size();
+      int32 base_width = NumBitsFor(max_word),
+          width_width = NumBitsFor(base_width),
+          offset_width = NumBitsFor(num_block_bits);
+      if (num_block_bits + num_blocks * (base_width + width_width +
+                                         offset_width) < n * base_width) {
+        widths[kWordBlockBase] = base_width;
+        widths[kWordBlockWidth] = width_width;
+        widths[kWordBlockOffset] = offset_width;
+        bits[kWordBlockBase] = num_blocks * base_width;
+        bits[kWordBlockWidth] = num_blocks * width_width;
+        bits[kWordBlockOffset] = num_blocks * offset_width;
+        bits[kWord] = num_block_bits;
+      } else {
+        widths[kWord] = base_width;
+        bits[kWord] = n * base_width;
+        bases.clear();
+        block_bits.clear();
+      }
+      // Quantized log-probs and backoffs.
+      ComputeCodebook(order.logprobs, quantize_bits, false,
+                      &(logprob_codebooks[k - 1]));
+      widths[kLogprob] = quantize_bits;
+      widths[kLogprobCodebook] = 32;
+      bits[kLogprobCodebook] = 32 * logprob_codebooks[k - 1].size();
+      if (k < ngram_order_) {
+        ComputeCodebook(order.backoffs, quantize_bits, true,
+                        &(backoff_codebooks[k - 1]));
+        widths[kBackoff] = quantize_bits;
+        widths[kBackoffCodebook] = 32;
+        bits[kBackoffCodebook] = 32 * backoff_codebooks[k - 1].size();
+      }
+    }
+    bits[kLogprob] = n * widths[kLogprob];
+    bits[kBackoff] = n * widths[kBackoff];
+    if (k < ngram_order_) {
+      KALDI_ASSERT(static_cast<int64>(order.child_begin.size()) == n + 1 &&
+                   order.child_begin[0] == 0 &&
+                   order.child_begin[n] ==
+                   static_cast<int64>((*orders)[k].words.size()));
+      widths[kChildBegin] = NumBitsFor(order.child_begin[n]);
+      bits[kChildBegin] = (n + 1) * widths[kChildBegin];
+    }
+    num_ngrams_[k - 1] = n;
+  }
+  int64 num_bits = 0;
+  for (size_t c = 0; c < column_bits.size(); ++c) {
+    column_offsets_[c] = num_bits;
+    num_bits += column_bits[c];
+  }
+  owned_data_.resize((num_bits + 63) / 64 + 1, 0);
+
+  // Fills in the fields.
+  for (int32 k = 1; k <= ngram_order_; ++k) {
+    Order &order = (*orders)[k - 1];
+    int64 n = num_ngrams_[k - 1];
+    if (k == 1) {
+      for (int64 i = 0; i < n; ++i) {
+        SetFloat(k, kLogprob, i, order.logprobs[i]);
+        SetFloat(k, kBackoff, i, order.backoffs[i]);
+      }
+    } else {
+      const std::vector<int32> &bases = block_bases[k - 1],
+          &block_bits = block_widths[k - 1];
+      if (bases.empty()) {
+        for (int64 i = 0; i < n; ++i)
+          Set(k, kWord, i, order.words[i]);
+      } else {
+        // Each block of kWord has its own width.
+        int64 word_offset = column_offsets_[(k - 1) * kNumFields + kWord],
+            block_offset = 0;
+        for (size_t b = 0; b < bases.size(); ++b) {
+          Set(k, kWordBlockBase, b, bases[b]);
+          Set(k, kWordBlockWidth, b, block_bits[b]);
+          Set(k, kWordBlockOffset, b, block_offset);
+          int64 begin = b * kWordBlockSize,
+              end = std::min<int64>(begin + kWordBlockSize, n);
+          for (int64 i = begin; i < end; ++i) {
+            SetBits(word_offset + block_offset, block_bits[b],
+                    order.words[i] - bases[b]);
+            block_offset += block_bits[b];
+          }
+        }
+      }
+      const std::vector<float> &logprob_codebook = logprob_codebooks[k - 1];
+      for (size_t i = 0; i < logprob_codebook.size(); ++i)
+        SetFloat(k, kLogprobCodebook, i, logprob_codebook[i]);
+      for (int64 i = 0; i < n; ++i)
+        Set(k, kLogprob, i,
+            QuantizeValue(logprob_codebook, false, order.logprobs[i]));
+      if (k < ngram_order_) {
+        const std::vector<float> &backoff_codebook = backoff_codebooks[k - 1];
+        for (size_t i = 0; i < backoff_codebook.size(); ++i)
+          SetFloat(k, kBackoffCodebook, i, backoff_codebook[i]);
+        for (int64 i = 0; i < n; ++i)
+          Set(k, kBackoff, i,
+              QuantizeValue(backoff_codebook, true, order.backoffs[i]));
+      }
+    }
+    if (k < ngram_order_) {
+      for (int64 i = 0; i <= n; ++i)
+        Set(k, kChildBegin, i, order.child_begin[i]);
+    }
+    // Frees the memory of this order.
+    std::vector<int32>().swap(order.words);
+    std::vector<float>().swap(order.logprobs);
+    std::vector<float>().swap(order.backoffs);
+    std::vector<int64>().swap(order.child_begin);
+  }
+  data_ = &(owned_data_[0]);
+  data_size_ = owned_data_.size();
+  ComputeNgramIdOffsets();
+  KALDI_LOG << "Built quantized language model with "
+            << quantize_bits_ << "-bit log-probs; it takes " << NumBytes()
+            << " bytes.";
+}
+
+void ConstArpaLmTrie::Write(std::ostream &os, bool binary,
+                            bool aligned) const {
+  KALDI_ASSERT(data_ != NULL);
+  WriteBasicType(os, binary, quantize_bits_);
+  WriteIntegerVector(os, binary, num_ngrams_);
+  WriteIntegerVector(os, binary, column_offsets_);
+  WriteIntegerVector(os, binary, column_widths_);
+  WriteToken(os, binary, aligned ? "<DataAligned>" : "<Data>");
+  WriteBasicType(os, binary, data_size_);
+  if (aligned)
+    WriteAlignmentPadding(os, binary);
+  os.write(reinterpret_cast<const char*>(data_),
+           sizeof(uint64) * data_size_);
+  if (!os.good()) {
+    KALDI_ERR << "ConstArpaLm <LmTrie> section writing failed.";
+  }
+  WriteToken(os, binary, aligned ? "</DataAligned>" : "</Data>");
+}
+
+void ConstArpaLmTrie::Read(std::istream &is, bool binary,
+                           const MappedFile *mapped_file) {
+  KALDI_ASSERT(data_ == NULL);
+  ReadBasicType(is, binary, &quantize_bits_);
+  ReadIntegerVector(is, binary, &num_ngrams_);
+  ReadIntegerVector(is, binary, &column_offsets_);
+  ReadIntegerVector(is, binary, &column_widths_);
+  ngram_order_ = num_ngrams_.size();
+  size_t num_columns = ngram_order_ * kNumFields;
+  if (ngram_order_ == 0 || column_offsets_.size() != num_columns ||
+      column_widths_.size() != num_columns) {
+    KALDI_ERR << "ConstArpaLm <LmTrie> section is corrupted.";
+  }
+  num_words_ = num_ngrams_[0];
+  ComputeNgramIdOffsets();
+
+  std::string token;
+  ReadToken(is, binary, &token);
+  bool aligned = (token == "<DataAligned>");
+  if (!aligned && token != "<Data>") {
+    KALDI_ERR << "Expected token <Data> or <DataAligned>, got " << token;
+  }
+  ReadBasicType(is, binary, &data_size_);
+  if (aligned) {
+    // The data is mapped read-only, and is never modified after reading.
+    data_ = reinterpret_cast<const uint64*>(
+        ReadAlignmentPadding(is, binary, mapped_file,
+                             sizeof(uint64) * data_size_));
+  }
+  if (data_ == NULL) {
+    owned_data_.resize(data_size_);
+    is.read(reinterpret_cast<char*>(&(owned_data_[0])),
+            sizeof(uint64) * data_size_);
+    data_ = &(owned_data_[0]);
+  }
+  if (!is.good()) {
+    KALDI_ERR << "ConstArpaLm <LmTrie> section reading failed.";
+  }
+  ExpectToken(is, binary, aligned ? "</DataAligned>" : "</Data>");
+}
+
+int32 ConstArpaLmTrie::Word(int32 order, int64 index) const {
+  if (order == 1) return index;
+  int32 c = (order - 1) * kNumFields;
+  if (column_widths_[c + kWordBlockWidth] == 0)
+    return Get(order, kWord, index);
+  int64 block = index / kWordBlockSize;
+  int32 width = Get(order, kWordBlockWidth, block);
+  return Get(order, kWordBlockBase, block) +
+      GetBits(column_offsets_[c + kWord] +
+              Get(order, kWordBlockOffset, block) +
+              (index % kWordBlockSize) * width, width);
+}
+
+float ConstArpaLmTrie::Logprob(int32 order, int64 index) const {
+  if (order == 1) return GetFloat(1, kLogprob, index);
+  return GetFloat(order, kLogprobCodebook, Get(order, kLogprob, index));
+}
+
+float ConstArpaLmTrie::Backoff(int32 order, int64 index) const {
+  if (order == 1) return GetFloat(1, kBackoff, index);
+  if (order == ngram_order_) return 0.0;
+  return GetFloat(order, kBackoffCodebook, Get(order, kBackoff, index));
+}
+
+void ConstArpaLmTrie::GetChildRange(int32 order, int64 index,
+                                    int64 *begin, int64 *end) const {
+  if (order >= ngram_order_) {
+    *begin = *end = 0;
+  } else {
+    *begin = Get(order, kChildBegin, index);
+    *end = Get(order, kChildBegin, index + 1);
+  }
+}
+
+bool ConstArpaLmTrie::FindChild(int32 order, int64 index, int32 word,
+                                int64 *child) const {
+  int64 begin, end;
+  GetChildRange(order, index, &begin, &end);
+  // A binary search, as the children are sorted by word.
+  while (begin < end) {
+    int64 mid = begin + (end - begin) / 2;
+    int32 mid_word = Word(order + 1, mid);
+    if (mid_word == word) {
+      *child = mid;
+      return true;
+    } else if (mid_word < word) {
+      begin = mid + 1;
+    } else {
+      end = mid;
+    }
+  }
+  return false;
+}
+
+bool ConstArpaLmTrie::FindNgram(const int32 *begin, const int32 *end,
+                                int64 *index) const {
+  KALDI_ASSERT(begin != end);
+  if (*begin < 0 || !HasUnigram(*begin)) return false;
+  *index = *begin;
+  int32 order = 1;
+  for (const int32 *iter = begin + 1; iter != end; ++iter, ++order) {
+    if (!FindChild(order, *index, *iter, index))
+      return false;
+  }
+  return true;
+}
+
+void ConstArpaLm::Write(std::ostream &os, bool binary, bool aligned) const {
   KALDI_ASSERT(initialized_);
   if (!binary) {
     KALDI_ERR << "text-mode writing is not implemented for ConstArpaLm.";
@@ -501,15 +1013,33 @@ void ConstArpaLm::Write(std::ostream &os, bool binary) const {
   WriteBasicType(os, binary, ngram_order_);
   WriteToken(os, binary, "</LmInfo>");
 
+  if (trie_ != NULL) {
+    // Quantized trie format, which replaces all the sections below.
+    WriteToken(os, binary, "<LmTrie>");
+    trie_->Write(os, binary, aligned);
+    WriteToken(os, binary, "</LmTrie>");
+    WriteToken(os, binary, "</ConstArpaLm>");
+    return;
+  }
+
   // LmStates section.
-  WriteToken(os, binary, "<LmStates>");
-  WriteBasicType(os, binary, lm_states_size_);
+  if (!aligned) {
+    WriteToken(os, binary, "<LmStates>");
+    WriteBasicType(os, binary, lm_states_size_);
+  } else {
+    // In the aligned format we write the number of padding bytes, and then
+    // the padding, so that the array starts at an offset in the file that is
+    // a multiple of kLmStatesAlignment.
+    WriteToken(os, binary, "<LmStatesAligned>");
+    WriteBasicType(os, binary, lm_states_size_);
+    WriteAlignmentPadding(os, binary);
+  }
   os.write(reinterpret_cast<char *>(lm_states_),
            sizeof(int32) * lm_states_size_);
   if (!os.good()) {
     KALDI_ERR << "ConstArpaLm <LmStates> section writing failed.";
   }
-  WriteToken(os, binary, "</LmStates>");
+  WriteToken(os, binary, aligned ? "</LmStatesAligned>" : "</LmStates>");
 
   // Unigram section. We write memory offset to disk instead of the absolute
   // pointers.
@@ -575,6 +1105,40 @@ void ConstArpaLm::Read(std::istream &is, bool binary) {
   }
 }
 
+void ConstArpaLm::ReadMapped(const std::string &rxfilename) {
+  KALDI_ASSERT(!initialized_);
+  if (ClassifyRxfilename(rxfilename) != kFileInput) {
+    ReadKaldiObject(rxfilename, this);
+    return;
+  }
+  mapped_file_ = new MappedFile(rxfilename);
+  // We parse the file through a stream as usual; ReadInternal() uses
+  // <mapped_file_> for the <LmStatesAligned> section.
+  std::ifstream is(rxfilename.c_str(), std::ios::in | std::ios::binary);
+  bool binary;
+  if (!is.is_open() || !InitKaldiInputStream(is, &binary)) {
+    KALDI_ERR << "Failed to open " << rxfilename << " for reading.";
+  }
+  Read(is, binary);
+  bool mapped;
+  if (trie_ != NULL) {
+    mapped = trie_->IsMapped();
+  } else {
+    const char *lm_states = reinterpret_cast<const char*>(lm_states_);
+    mapped = (lm_states >= mapped_file_->Data() &&
+              lm_states < mapped_file_->Data() + mapped_file_->Size());
+  }
+  if (!mapped) {
+    // The file is not in the aligned format, so <lm_states_> (or the trie) was
+    // read into memory and there is no point in keeping the file mapped.
+    delete mapped_file_;
+    mapped_file_ = NULL;
+    KALDI_LOG << "Language model in " << rxfilename << " is not in the "
+              << "aligned format, so it was not memory-mapped; you can use "
+              << "const-arpa-copy to convert it.";
+  }
+}
+
 void ConstArpaLm::ReadInternal(std::istream &is, bool binary) {
   KALDI_ASSERT(!initialized_);
   if (!binary) {
@@ -591,16 +1155,40 @@ void ConstArpaLm::ReadInternal(std::istream &is, bool binary) {
   ReadBasicType(is, binary, &ngram_order_);
   ExpectToken(is, binary, "</LmInfo>");
 
-  // LmStates section.
-  ExpectToken(is, binary, "<LmStates>");
+  // LmStates section, or the trie.
+  std::string token;
+  ReadToken(is, binary, &token);
+  if (token == "<LmTrie>") {
+    ReadTrieInternal(is, binary);
+    return;
+  }
+  bool aligned = (token == "<LmStatesAligned>");
+  if (!aligned && token != "<LmStates>") {
+    KALDI_ERR << "Expected token <LmStates> or <LmStatesAligned>, got "
+              << token;
+  }
   ReadBasicType(is, binary, &lm_states_size_);
-  lm_states_ = new int32[lm_states_size_];
-  is.read(reinterpret_cast<char *>(lm_states_),
-          sizeof(int32) * lm_states_size_);
+  bool mapped = false;
+  if (aligned) {
+    // If ReadMapped() has mapped the file that "is" is reading, we point into
+    // the mapping instead of reading the array.
+    const char *data = ReadAlignmentPadding(is, binary, mapped_file_,
+                                            sizeof(int32) * lm_states_size_);
+    if (data != NULL) {
+      // The data is mapped read-only, and is never modified after reading.
+      lm_states_ = reinterpret_cast<int32*>(const_cast<char*>(data));
+      mapped = true;
+    }
+  }
+  if (!mapped) {
+    lm_states_ = new int32[lm_states_size_];
+    is.read(reinterpret_cast<char *>(lm_states_),
+            sizeof(int32) * lm_states_size_);
+  }
   if (!is.good()) {
     KALDI_ERR << "ConstArpaLm <LmStates> section reading failed.";
   }
-  ExpectToken(is, binary, "</LmStates>");
+  ExpectToken(is, binary, aligned ? "</LmStatesAligned>" : "</LmStates>");
 
   // Unigram section. We write memory offset to disk instead of the absolute
   // pointers.
@@ -653,6 +1241,23 @@ void ConstArpaLm::ReadInternal(std::istream &is, bool binary) {
   initialized_ = true;
 }
 
+void ConstArpaLm::ReadTrieInternal(std::istream &is, bool binary) {
+  ConstArpaLmTrie *trie = new ConstArpaLmTrie();
+  trie_ = trie;
+  trie->Read(is, binary, mapped_file_);
+  ExpectToken(is, binary, "</LmTrie>");
+  ExpectToken(is, binary, "</ConstArpaLm>");
+
+  num_words_ = trie->NumWords();
+  KALDI_ASSERT(ngram_order_ > 0 && trie->NgramOrder() == ngram_order_);
+  KALDI_ASSERT(bos_symbol_ < num_words_ && bos_symbol_ > 0);
+  KALDI_ASSERT(eos_symbol_ < num_words_ && eos_symbol_ > 0);
+  KALDI_ASSERT(unk_symbol_ < num_words_ &&
+               (unk_symbol_ > 0 || unk_symbol_ == -1));
+  memory_assigned_ = true;
+  initialized_ = true;
+}
+
 void ConstArpaLm::ReadInternalOldFormat(std::istream &is, bool binary) {
   KALDI_ASSERT(!initialized_);
   if (!binary) {
@@ -709,15 +1314,48 @@ void ConstArpaLm::ReadInternalOldFormat(std::istream &is, bool binary) {
   initialized_ = true;
 }
 
+int64 ConstArpaLm::NumBytes() const {
+  KALDI_ASSERT(initialized_);
+  if (trie_ != NULL)
+    return trie_->NumBytes();
+  return sizeof(int32) * lm_states_size_ + sizeof(int32*) *
+      (static_cast<int64>(num_words_) + overflow_buffer_size_);
+}
+
 bool ConstArpaLm::HistoryStateExists(const std::vector<int32>& hist) const {
+  int64 state_id;
+  return HistoryStateExists(hist, &state_id);
+}
+
+bool ConstArpaLm::HistoryStateExists(const std::vector<int32>& hist,
+                                     int64 *state_id) const {
   // We do not create LmState for empty word sequence, but technically it is the
   // history state of all unigrams.
   if (hist.size() == 0) {
+    *state_id = -1;
+    return true;
+  }
+
+  return GetHistoryStateId(&(hist[0]), &(hist[0]) + hist.size(), state_id);
+}
+
+bool ConstArpaLm::GetHistoryStateId(const int32* begin, const int32* end,
+                                    int64* state_id) const {
+  KALDI_ASSERT(begin != end);
+  if (trie_ != NULL) {
+    // A history state is an n-gram that has children, and the n-grams of all
+    // orders have different ids.
+    int32 order = end - begin;
+    int64 index, child_begin, child_end;
+    if (!trie_->FindNgram(begin, end, &index)) return false;
+    trie_->GetChildRange(order, index, &child_begin, &child_end);
+    if (child_begin == child_end) return false;
+    *state_id = trie_->NgramId(order, index);
     return true;
   }
 
   // Tries to locate the LmState of the given word sequence.
-  int32* lm_state = GetLmState(hist);
+  int32* lm_state = GetLmState(begin, end);
   if (lm_state == NULL) {
     // <lm_state> does not exist means <hist> has no child.
     return false;
@@ -726,26 +1364,46 @@ bool ConstArpaLm::HistoryStateExists(const std::vector<int32>& hist) const {
     // not NULL, we still have to check if it has child.
     KALDI_ASSERT(lm_state >= lm_states_);
     KALDI_ASSERT(lm_state + 2 <= lm_states_end_);
-    // <lm_state + 2> points to <num_children>.
+    // <lm_state + 2> points to <num_children>.  The position of the LmState
+    // identifies it.
     if (*(lm_state + 2) > 0) {
+      *state_id = lm_state - lm_states_;
       return true;
     } else {
       return false;
     }
   }
-  return true;
+}
+
+void ConstArpaLm::ExtendHistoryState(int32 word, std::vector<int32>* hist,
+                                     int64* state_id) const {
+  KALDI_ASSERT(initialized_);
+  KALDI_ASSERT(hist != NULL && state_id != NULL);
+  hist->push_back(word);
+
+  // History state has at most <ngram_order_> - 1 words.  We try the suffixes
+  // of the history from the longest down, without copying them.
+  size_t begin = 0;
+  if (hist->size() >= static_cast<size_t>(ngram_order_))
+    begin = hist->size() - (ngram_order_ - 1);
+  const int32* data = &((*hist)[0]);
+  *state_id = -1;
+  for (; begin < hist->size(); ++begin) {
+    if (GetHistoryStateId(data + begin, data + hist->size(), state_id))
+      break;
+  }
+  hist->erase(hist->begin(), hist->begin() + begin);
 }
 
 float ConstArpaLm::GetNgramLogprob(const int32 word,
                                    const std::vector<int32>& hist) const {
   KALDI_ASSERT(initialized_);
 
-  // If the history size plus one is larger than <ngram_order_>, remove the old
-  // words.
-  std::vector<int32> mapped_hist(hist);
-  while (mapped_hist.size() >= ngram_order_) {
-    mapped_hist.erase(mapped_hist.begin(), mapped_hist.begin() + 1);
-  }
+  // If the history size plus one is larger than <ngram_order_>, we only use
+  // the most recent words.
+  size_t hist_size = std::min(hist.size(),
+                              static_cast<size_t>(ngram_order_ - 1));
+  std::vector<int32> mapped_hist(hist.end() - hist_size, hist.end());
   KALDI_ASSERT(mapped_hist.size() + 1 <= ngram_order_);
 
   // TODO(guoguo): check with Dan if this is reasonable.
@@ -755,76 +1413,101 @@ float ConstArpaLm::GetNgramLogprob(const int32 word,
   int32 mapped_word = word;
   if (unk_symbol_ != -1) {
     KALDI_ASSERT(mapped_word >= 0);
-    if (mapped_word >= num_words_ || unigram_states_[mapped_word] == NULL) {
+    if (!HasUnigram(mapped_word)) {
       mapped_word = unk_symbol_;
     }
     for (int32 i = 0; i < mapped_hist.size(); ++i) {
       KALDI_ASSERT(mapped_hist[i] >= 0);
-      if (mapped_hist[i] >= num_words_ ||
-          unigram_states_[mapped_hist[i]] == NULL) {
+      if (!HasUnigram(mapped_hist[i])) {
         mapped_hist[i] = unk_symbol_;
       }
     }
   }
 
   // Loops up n-gram probability.
-  return GetNgramLogprobRecurse(mapped_word, mapped_hist);
+  const int32* hist_begin = (mapped_hist.empty() ? NULL : &(mapped_hist[0]));
+  return GetNgramLogprobInternal(mapped_word, hist_begin,
+                                 hist_begin + mapped_hist.size());
 }
 
-float ConstArpaLm::GetNgramLogprobRecurse(
-    const int32 word, const std::vector<int32>& hist) const {
+float ConstArpaLm::GetNgramLogprobInternal(const int32 word,
+                                           const int32* hist_begin,
+                                           const int32* hist_end) const {
   KALDI_ASSERT(initialized_);
-  KALDI_ASSERT(hist.size() + 1 <= ngram_order_);
-
-  // Unigram case.
-  if (hist.size() == 0) {
-    if (word >= num_words_ || unigram_states_[word] == NULL) {
-      // If <unk> is defined, then the word sequence should have already been
-      // mapped to <unk> is necessary; this is for the case where <unk> is not
-      // defined.
-      return std::numeric_limits<float>::min();
-    } else {
-      Int32AndFloat logprob_i(*unigram_states_[word]);
-      return logprob_i.f;
-    }
+  KALDI_ASSERT(hist_end - hist_begin + 1 <= ngram_order_);
+  if (trie_ != NULL)
+    return GetNgramLogprobTrie(word, hist_begin, hist_end);
+
+  if (word >= num_words_ || unigram_states_[word] == NULL) {
+    // If <unk> is defined, then the word sequence should have already been
+    // mapped to <unk> is necessary; this is for the case where <unk> is not
+    // defined.  No n-gram can end in this word.
+    return std::numeric_limits<float>::min();
   }
 
-  // High n-gram orders.
-  float logprob = 0.0;
+  // High n-gram orders, longest history first.
   float backoff_logprob = 0.0;
-  int32* state;
-  if ((state = GetLmState(hist)) != NULL) {
+  for (; hist_begin != hist_end; ++hist_begin) {
+    int32* state = GetLmState(hist_begin, hist_end);
+    if (state == NULL) continue;
     int32 child_info;
-    int32* child_lm_state = NULL;
     if (GetChildInfo(word, state, &child_info)) {
+      int32* child_lm_state = NULL;
+      float logprob;
       DecodeChildInfo(child_info, state, &child_lm_state, &logprob);
-      return logprob;
+      return backoff_logprob + logprob;
     } else {
       Int32AndFloat backoff_logprob_i(*(state + 1));
-      backoff_logprob = backoff_logprob_i.f;
+      backoff_logprob += backoff_logprob_i.f;
     }
   }
-  std::vector<int32> new_hist(hist);
-  new_hist.erase(new_hist.begin(), new_hist.begin() + 1);
-  return backoff_logprob + GetNgramLogprobRecurse(word, new_hist);
+
+  // Unigram case.
+  Int32AndFloat logprob_i(*unigram_states_[word]);
+  return backoff_logprob + logprob_i.f;
+}
+
+float ConstArpaLm::GetNgramLogprobTrie(const int32 word,
+                                       const int32* hist_begin,
+                                       const int32* hist_end) const {
+  if (!trie_->HasUnigram(word))
+    return std::numeric_limits<float>::min();
+
+  // As in GetNgramLogprobInternal(), but n-grams that are leaves are in the
+  // trie too, with zero backoff.
+  float backoff_logprob = 0.0;
+  for (; hist_begin != hist_end; ++hist_begin) {
+    int32 order = hist_end - hist_begin;
+    int64 index, child;
+    if (!trie_->FindNgram(hist_begin, hist_end, &index)) continue;
+    if (trie_->FindChild(order, index, word, &child))
+      return backoff_logprob + trie_->Logprob(order + 1, child);
+    backoff_logprob += trie_->Backoff(order, index);
+  }
+  return backoff_logprob + trie_->Logprob(1, word);
 }
 
 int32* ConstArpaLm::GetLmState(const std::vector<int32>& seq) const {
+  if (seq.size() == 0) return NULL;
+  return GetLmState(&(seq[0]), &(seq[0]) + seq.size());
+}
+
+int32* ConstArpaLm::GetLmState(const int32* begin, const int32* end) const {
   KALDI_ASSERT(initialized_);
 
   // No LmState exists for empty word sequence.
-  if (seq.size() == 0) return NULL;
+  if (begin == end) return NULL;
 
   // If <unk> is defined, then the word sequence should have already been mapped
   // to <unk> is necessary; this is for the case where <unk> is not defined.
-  if (seq[0] >= num_words_ || unigram_states_[seq[0]] == NULL) return NULL;
-  int32* parent = unigram_states_[seq[0]];
+  if (*begin >= num_words_ || unigram_states_[*begin] == NULL) return NULL;
+  int32* parent = unigram_states_[*begin];
 
   int32 child_info;
   int32* child_lm_state = NULL;
   float logprob;
-  for (int32 i = 1; i < seq.size(); ++i) {
-    if (!GetChildInfo(seq[i], parent, &child_info)) {
+  for (const int32* iter = begin + 1; iter != end; ++iter) {
+    if (!GetChildInfo(*iter, parent, &child_info)) {
       return NULL;
     }
     DecodeChildInfo(child_info, parent, &child_lm_state, &logprob);
@@ -940,12 +1623,34 @@ void ConstArpaLm::WriteArpaRecurse(int32* lm_state,
   }
 }
 
+void ConstArpaLm::WriteArpaRecurseTrie(int32 order, int64 index,
+                                       std::vector<int32>* seq,
+                                       std::vector<ArpaLine> *output) const {
+  seq->push_back(trie_->Word(order, index));
+  ArpaLine arpa_line;
+  arpa_line.words = *seq;
+  arpa_line.logprob = trie_->Logprob(order, index);
+  arpa_line.backoff_logprob = trie_->Backoff(order, index);
+  output->push_back(arpa_line);
+
+  int64 child_begin, child_end;
+  trie_->GetChildRange(order, index, &child_begin, &child_end);
+  for (int64 child = child_begin; child < child_end; ++child)
+    WriteArpaRecurseTrie(order + 1, child, seq, output);
+  seq->pop_back();
+}
+
 void ConstArpaLm::WriteArpa(std::ostream &os) const {
   KALDI_ASSERT(initialized_);
 
   std::vector<ArpaLine> tmp_output;
   for (int32 i = 0; i < num_words_; ++i) {
-    if (unigram_states_[i] != NULL) {
+    if (trie_ != NULL) {
+      if (trie_->HasUnigram(i)) {
+        std::vector<int32> seq;
+        WriteArpaRecurseTrie(1, i, &seq, &tmp_output);
+      }
+    } else if (unigram_states_[i] != NULL) {
       std::vector<int32> seq(1, i);
       WriteArpaRecurse(unigram_states_[i], seq, &tmp_output);
     }
@@ -1002,70 +1707,233 @@ void ConstArpaLm::WriteArpa(std::ostream &os) const {
 }
 
 ConstArpaLmDeterministicFst::ConstArpaLmDeterministicFst(
-    const ConstArpaLm& lm) : lm_(lm) {
+    const ConstArpaLm& lm, fst::SharedArcCache<fst::StdArc>* cache)
+    : lm_(lm), cache_(cache) {
   // Creates a history state for <s>.
   std::vector<Label> bos_state(1, lm_.BosSymbol());
-  state_to_wseq_.push_back(bos_state);
-  wseq_to_state_[bos_state] = 0;
-  start_state_ = 0;
+  int64 lm_state_id;
+  wseq_begin_.push_back(0);
+  if (lm_.HistoryStateExists(bos_state, &lm_state_id)) {
+    start_state_ = FindOrAddState(bos_state, lm_state_id);
+  } else {
+    // <s> is not a history state in the language model, so no other state can
+    // have the same history; we don't need to put it in the map.
+    wseq_words_.push_back(lm_.BosSymbol());
+    wseq_begin_.push_back(wseq_words_.size());
+    final_logprob_.push_back(std::numeric_limits<float>::infinity());
+    cache_key_.push_back(-2);
+    start_state_ = 0;
+  }
 }
 
-fst::StdArc::Weight ConstArpaLmDeterministicFst::Final(StateId s) {
-  // At this point, we should have created the state.
-  KALDI_ASSERT(static_cast<size_t>(s) < state_to_wseq_.size());
-  const std::vector<Label>& wseq = state_to_wseq_[s];
-  float logprob = lm_.GetNgramLogprob(lm_.EosSymbol(), wseq);
-  return Weight(-logprob);
+ConstArpaLmDeterministicFst::StateId
+ConstArpaLmDeterministicFst::FindOrAddState(const std::vector<Label>& wseq,
+                                            int64 lm_state_id) {
+  StateId new_state = static_cast<StateId>(final_logprob_.size());
+  std::pair<unordered_map<int64, StateId>::iterator, bool> result =
+      lm_state_to_state_.insert(std::make_pair(lm_state_id, new_state));
+  if (result.second) {
+    wseq_words_.insert(wseq_words_.end(), wseq.begin(), wseq.end());
+    wseq_begin_.push_back(wseq_words_.size());
+    final_logprob_.push_back(std::numeric_limits<float>::infinity());
+    cache_key_.push_back(lm_state_id);
+  }
+  return result.first->second;
 }
 
-bool ConstArpaLmDeterministicFst::GetArc(StateId s,
-                                         Label ilabel, fst::StdArc *oarc) {
+void ConstArpaLmDeterministicFst::GetWordSequence(
+    StateId s, std::vector<Label>* wseq) const {
   // At this point, we should have created the state.
-  KALDI_ASSERT(static_cast<size_t>(s) < state_to_wseq_.size());
-  std::vector<Label> wseq = state_to_wseq_[s];
+  KALDI_ASSERT(static_cast<size_t>(s) < final_logprob_.size());
+  wseq->assign(wseq_words_.begin() + wseq_begin_[s],
+               wseq_words_.begin() + wseq_begin_[s + 1]);
+}
 
-  float logprob = lm_.GetNgramLogprob(ilabel, wseq);
-  if (logprob == std::numeric_limits<float>::min()) {
-    return false;
+fst::StdArc::Weight ConstArpaLmDeterministicFst::Final(StateId s) {
+  KALDI_ASSERT(static_cast<size_t>(s) < final_logprob_.size());
+  if (final_logprob_[s] == std::numeric_limits<float>::infinity()) {
+    GetWordSequence(s, &wseq_);
+    final_logprob_[s] = lm_.GetNgramLogprob(lm_.EosSymbol(), wseq_);
   }
+  return Weight(-final_logprob_[s]);
+}
 
-  // Locates the next state in ConstArpaLm. Note that OOV and backoff have been
-  // taken care of in ConstArpaLm.
-  wseq.push_back(ilabel);
-  while (wseq.size() >= lm_.NgramOrder()) {
-    // History state has at most lm_.NgramOrder() -1 words in the state.
-    wseq.erase(wseq.begin(), wseq.begin() + 1);
+bool ConstArpaLmDeterministicFst::GetArc(StateId s,
+                                         Label ilabel, fst::StdArc *oarc) {
+  int64 key = (static_cast<int64>(s) << 32) + static_cast<uint32>(ilabel);
+  unordered_map<int64, std::pair<StateId, float> >::iterator iter =
+      arc_cache_.find(key);
+  if (iter == arc_cache_.end()) {
+    float logprob;
+    StateId nextstate = fst::kNoStateId;
+    int64 lm_state_id;
+    Weight weight;
+    if (cache_ != NULL &&
+        cache_->Find(cache_key_[s], ilabel, &lm_state_id, &weight)) {
+      logprob = -weight.Value();
+      unordered_map<int64, StateId>::const_iterator state_iter =
+          lm_state_to_state_.find(lm_state_id);
+      if (state_iter != lm_state_to_state_.end()) {
+        nextstate = state_iter->second;
+      } else {
+        // We still need the history of the next state.
+        GetWordSequence(s, &wseq_);
+        lm_.ExtendHistoryState(ilabel, &wseq_, &lm_state_id);
+        nextstate = FindOrAddState(wseq_, lm_state_id);
+      }
+    } else {
+      GetWordSequence(s, &wseq_);
+      logprob = lm_.GetNgramLogprob(ilabel, wseq_);
+      if (logprob != std::numeric_limits<float>::min()) {
+        // Locates the next state in ConstArpaLm. Note that OOV and backoff have
+        // been taken care of in ConstArpaLm.
+        lm_.ExtendHistoryState(ilabel, &wseq_, &lm_state_id);
+        nextstate = FindOrAddState(wseq_, lm_state_id);
+        if (cache_ != NULL)
+          cache_->Insert(cache_key_[s], ilabel, lm_state_id, Weight(-logprob));
+      }
+    }
+    iter = arc_cache_.insert(
+        std::make_pair(key, std::make_pair(nextstate, logprob))).first;
   }
-  while (!lm_.HistoryStateExists(wseq)) {
-    KALDI_ASSERT(wseq.size() > 0);
-    wseq.erase(wseq.begin(), wseq.begin() + 1);
+  if (iter->second.first == fst::kNoStateId)
+    return false;
+
+  // Creates the arc.
+  oarc->ilabel = ilabel;
+  oarc->olabel = ilabel;
+  oarc->nextstate = iter->second.first;
+  oarc->weight = Weight(-iter->second.second);
+
+  return true;
+}
+
+ConstArpaLmDiffDeterministicFst::ConstArpaLmDiffDeterministicFst(
+    const ConstArpaLm* old_lm, const ConstArpaLm& new_lm,
+    int32 num_cached_arcs) : old_lm_(old_lm), new_lm_(new_lm) {
+  KALDI_ASSERT(num_cached_arcs > 0);
+  if (old_lm_ != NULL &&
+      (old_lm_->BosSymbol() != new_lm_.BosSymbol() ||
+       old_lm_->EosSymbol() != new_lm_.EosSymbol()))
+    KALDI_ERR << "The two language models have different symbols for <s> or "
+              << "</s>.";
+  CachedArc unused_arc;
+  unused_arc.state = fst::kNoStateId;
+  unused_arc.ilabel = 0;
+  unused_arc.nextstate = fst::kNoStateId;
+  unused_arc.cost = 0.0;
+  cached_arcs_.resize(num_cached_arcs, unused_arc);
+
+  // Creates the state for <s>.  ExtendHistoryState() removes <s> from the
+  // histories if it is not a history state.
+  int64 old_lm_state_id = -1, new_lm_state_id;
+  if (old_lm_ != NULL)
+    old_lm_->ExtendHistoryState(old_lm_->BosSymbol(), &old_wseq_,
+                                &old_lm_state_id);
+  new_lm_.ExtendHistoryState(new_lm_.BosSymbol(), &new_wseq_,
+                             &new_lm_state_id);
+  wseq_begin_.push_back(0);
+  start_state_ = FindOrAddState(old_wseq_, old_lm_state_id,
+                                new_wseq_, new_lm_state_id);
+}
+
+ConstArpaLmDiffDeterministicFst::StateId
+ConstArpaLmDiffDeterministicFst::FindOrAddState(
+    const std::vector<Label>& old_wseq, int64 old_lm_state_id,
+    const std::vector<Label>& new_wseq, int64 new_lm_state_id) {
+  StateId new_state = static_cast<StateId>(final_cost_.size());
+  std::pair<unordered_map<std::pair<int64, int64>, StateId,
+                          PairHasher<int64> >::iterator, bool> result =
+      lm_states_to_state_.insert(std::make_pair(
+          std::make_pair(old_lm_state_id, new_lm_state_id), new_state));
+  if (result.second) {
+    wseq_words_.insert(wseq_words_.end(), old_wseq.begin(), old_wseq.end());
+    wseq_begin_.push_back(wseq_words_.size());
+    wseq_words_.insert(wseq_words_.end(), new_wseq.begin(), new_wseq.end());
+    wseq_begin_.push_back(wseq_words_.size());
+    final_cost_.push_back(std::numeric_limits<float>::infinity());
   }
+  return result.first->second;
+}
 
-  std::pair<const std::vector<Label>, StateId> wseq_state_pair(
-      wseq, static_cast<Label>(state_to_wseq_.size()));
+void ConstArpaLmDiffDeterministicFst::GetWordSequences(
+    StateId s, std::vector<Label>* old_wseq,
+    std::vector<Label>* new_wseq) const {
+  // At this point, we should have created the state.
+  KALDI_ASSERT(static_cast<size_t>(s) < final_cost_.size());
+  old_wseq->assign(wseq_words_.begin() + wseq_begin_[2 * s],
+                   wseq_words_.begin() + wseq_begin_[2 * s + 1]);
+  new_wseq->assign(wseq_words_.begin() + wseq_begin_[2 * s + 1],
+                   wseq_words_.begin() + wseq_begin_[2 * s + 2]);
+}
 
-  // Attemps to insert the current <wseq_state_pair>. If the pair already exists
-  // then it returns false.
-  typedef MapType::iterator IterType;
-  std::pair<IterType, bool> result = wseq_to_state_.insert(wseq_state_pair);
+fst::StdArc::Weight ConstArpaLmDiffDeterministicFst::Final(StateId s) {
+  KALDI_ASSERT(static_cast<size_t>(s) < final_cost_.size());
+  if (final_cost_[s] == std::numeric_limits<float>::infinity()) {
+    GetWordSequences(s, &old_wseq_, &new_wseq_);
+    float cost = -new_lm_.GetNgramLogprob(new_lm_.EosSymbol(), new_wseq_);
+    if (old_lm_ != NULL)
+      cost += old_lm_->GetNgramLogprob(old_lm_->EosSymbol(), old_wseq_);
+    final_cost_[s] = cost;
+  }
+  return Weight(final_cost_[s]);
+}
 
-  // If the pair was just inserted, then also add it to <state_to_wseq_>.
-  if (result.second == true)
-    state_to_wseq_.push_back(wseq);
+bool ConstArpaLmDiffDeterministicFst::ComputeArc(StateId s, Label ilabel,
+                                                 StateId* nextstate,
+                                                 float* cost) {
+  GetWordSequences(s, &old_wseq_, &new_wseq_);
+  float new_logprob = new_lm_.GetNgramLogprob(ilabel, new_wseq_),
+      old_logprob = 0.0;
+  if (new_logprob == std::numeric_limits<float>::min())
+    return false;
+  int64 old_lm_state_id = -1, new_lm_state_id;
+  if (old_lm_ != NULL) {
+    old_logprob = old_lm_->GetNgramLogprob(ilabel, old_wseq_);
+    // The graph should not have words that the old language model does not
+    // have.
+    if (old_logprob == std::numeric_limits<float>::min())
+      return false;
+    old_lm_->ExtendHistoryState(ilabel, &old_wseq_, &old_lm_state_id);
+  }
+  new_lm_.ExtendHistoryState(ilabel, &new_wseq_, &new_lm_state_id);
+  *nextstate = FindOrAddState(old_wseq_, old_lm_state_id,
+                              new_wseq_, new_lm_state_id);
+  *cost = old_logprob - new_logprob;
+  return true;
+}
 
-  // Creates the arc.
+bool ConstArpaLmDiffDeterministicFst::GetArc(StateId s, Label ilabel,
+                                             fst::StdArc* oarc) {
+  // As in CacheDeterministicOnDemandFst, we don't cache arcs that don't
+  // exist; the decoder should hardly ever ask for them.
+  KALDI_ASSERT(s >= 0 && ilabel != 0);
+  const size_t p1 = 26597, p2 = 50329;
+  CachedArc& cached_arc = cached_arcs_[
+      (static_cast<size_t>(s) * p1 + static_cast<size_t>(ilabel) * p2) %
+      cached_arcs_.size()];
+  if (cached_arc.state != s || cached_arc.ilabel != ilabel) {
+    StateId nextstate;
+    float cost;
+    if (!ComputeArc(s, ilabel, &nextstate, &cost))
+      return false;
+    cached_arc.state = s;
+    cached_arc.ilabel = ilabel;
+    cached_arc.nextstate = nextstate;
+    cached_arc.cost = cost;
+  }
   oarc->ilabel = ilabel;
   oarc->olabel = ilabel;
-  oarc->nextstate = result.first->second;
-  oarc->weight = Weight(-logprob);
-
+  oarc->nextstate = cached_arc.nextstate;
+  oarc->weight = Weight(cached_arc.cost);
   return true;
 }
 
 bool BuildConstArpaLm(const ArpaParseOptions& options,
                       const std::string& arpa_rxfilename,
-                      const std::string& const_arpa_wxfilename) {
-  ConstArpaLmBuilder lm_builder(options);
+                      const std::string& const_arpa_wxfilename,
+                      int32 quantize_bits) {
+  ConstArpaLmBuilder lm_builder(options, quantize_bits);
   KALDI_LOG << "Reading " << arpa_rxfilename;
   ReadKaldiObject(arpa_rxfilename, &lm_builder);
   WriteKaldiObject(lm_builder, const_arpa_wxfilename, true);
@@ -20,6 +20,7 @@
 #ifndef KALDI_LM_CONST_ARPA_LM_H_
 #define KALDI_LM_CONST_ARPA_LM_H_
 
+#include <limits>
 #include <string>
 #include <vector>
 
@@ -27,6 +28,7 @@
 #include "fstext/deterministic-fst.h"
 #include "lm/arpa-file-parser.h"
 #include "util/common-utils.h"
+#include "util/mapped-file.h"
 
 namespace kaldi {
 
@@ -194,6 +196,8 @@ namespace kaldi {
        of LmState whose address differs too much from the parent address. See
        above how we handle the leaf case.
     5. With the information in step 4, create the class ConstArpaLm.
+    If the language model is built with quantization, steps 2 to 4 are
+    replaced by building a ConstArpaLmTrie (see below) from the LmStates.
 */
 
 // Forward declaration of Auxiliary struct ArpaLine.
@@ -208,6 +212,195 @@ union Int32AndFloat {
   Int32AndFloat(float input_f) : f(input_f) {}
 };
 
+/**
+   ConstArpaLmTrie is a compact form of the language model, which ConstArpaLm
+   uses instead of <lm_states_> if it was built with quantization (see
+   arpa-to-const-arpa --quantize-bits).  It is a trie in the style of KenLM's:
+   the n-grams of each order are stored in an array, sorted by the position of
+   their history n-gram in the array of the order below and then by their last
+   word, so the children of an n-gram are a range of the array of the next
+   order, given by one index per n-gram.  There are no LmStates and no
+   pointers; all the fields are bit-packed, with as few bits as they need:
+    - unigrams are indexed by word, and their log-probs and backoffs are
+      stored as floats.
+    - for the higher orders, log-probs and backoffs are stored as indexes into
+      a codebook with up to 2^quantize_bits values per order, each the mean of
+      an equal-count bin of the sorted values.  Backoffs of exactly zero, which
+      are common, are kept exact.
+    - word ids are stored, per block of kWordBlockSize consecutive n-grams, as
+      the difference from the smallest word id in the block, with as many bits
+      as that block needs.  As children are sorted by word, this is much
+      smaller than the word id for the long child ranges of frequent histories
+      (mostly the bigrams); for orders where it does not help, the word ids are
+      stored directly.  Either way any word id can be decoded in constant time,
+      so children are found by binary search.
+    - child ranges are indexes into the array of the next order.
+   All of this is in one array of 64-bit words, so like <lm_states_> it can be
+   memory-mapped from a file in the aligned format.
+*/
+class ConstArpaLmTrie {
+ public:
+  // The n-grams of one order, as input to Init().
+  struct Order {
+    // The last word of each n-gram; empty for unigrams, which are indexed by
+    // word.
+    std::vector<int32> words;
+    // The log-prob of each n-gram.  For unigrams, infinity means that there is
+    // no unigram for the word.
+    std::vector<float> logprobs;
+    // The backoff log-prob of each n-gram; empty for the highest order.
+    std::vector<float> backoffs;
+    // The children of n-gram i are n-grams child_begin[i] ... child_begin[i +
+    // 1] - 1 of the next order; empty for the highest order.
+    std::vector<int64> child_begin;
+  };
+
+  ConstArpaLmTrie(): ngram_order_(0), num_words_(0), quantize_bits_(0),
+                     data_(NULL), data_size_(0) { }
+
+  // Builds the trie from the n-grams in <orders>, where (*orders)[k] is the
+  // order k + 1, sorted as explained above.  <quantize_bits> is the number of
+  // bits for log-probs and backoffs, from 2 to 16 (e.g. 8 or 16).  The vectors
+  // in <orders> are freed as they are used.
+  void Init(int32 quantize_bits, std::vector<Order> *orders);
+
+  // Writes the trie.  See ConstArpaLm::Write() about <aligned>.
+  void Write(std::ostream &os, bool binary, bool aligned) const;
+
+  // Reads the trie.  If <mapped_file> is not NULL it is the file that <is>
+  // reads (see ConstArpaLm::ReadMapped()), and if the trie was written in the
+  // aligned format its data is used in place rather than read.
+  void Read(std::istream &is, bool binary, const MappedFile *mapped_file);
+
+  // Returns true if the data is in a memory-mapped file.
+  bool IsMapped() const { return data_ != NULL && owned_data_.empty(); }
+
+  int32 NgramOrder() const { return ngram_order_; }
+
+  // Index of the largest word with a unigram, plus one.
+  int32 NumWords() const { return num_words_; }
+
+  int32 QuantizeBits() const { return quantize_bits_; }
+
+  // Returns the size of the data in bytes, which is nearly all the memory the
+  // trie uses.
+  int64 NumBytes() const { return data_size_ * sizeof(uint64); }
+
+  // Returns true if <word> (which must be nonnegative) has a unigram.
+  bool HasUnigram(int32 word) const {
+    return word < num_words_ &&
+        GetFloat(1, kLogprob, word) != std::numeric_limits<float>::infinity();
+  }
+
+  // The following functions are about n-gram <index> of order <order>, i.e.
+  // element <index> of the array for that order (for unigrams, the index is
+  // the word).
+
+  // Returns its last word.
+  int32 Word(int32 order, int64 index) const;
+
+  // Returns its log-prob.
+  float Logprob(int32 order, int64 index) const;
+
+  // Returns its backoff log-prob.
+  float Backoff(int32 order, int64 index) const;
+
+  // Outputs the range of its children, which are the n-grams begin ... end - 1
+  // of order <order> + 1.
+  void GetChildRange(int32 order, int64 index, int64 *begin, int64 *end) const;
+
+  // Finds its child for <word>; returns false if there is none.
+  bool FindChild(int32 order, int64 index, int32 word, int64 *child) const;
+
+  // Returns a number that identifies it among the n-grams of all orders.
+  int64 NgramId(int32 order, int64 index) const {
+    return ngram_id_offset_[order - 1] + index;
+  }
+
+  // Finds the n-gram of the (nonempty) word sequence begin ... end - 1, whose
+  // order is end - begin; returns false if there is none.
+  bool FindNgram(const int32 *begin, const int32 *end, int64 *index) const;
+
+ private:
+  // The fields of each order.  Each is stored with a fixed number of bits per
+  // element, except kWord if the word ids are stored in blocks.
+  enum Field {
+    kWord = 0,          // Word ids, or their differences from the block bases.
+    kWordBlockBase,     // The smallest word id in each block.
+    kWordBlockWidth,    // The number of bits per word in each block; this field
+                        // is empty if the word ids are stored directly.
+    kWordBlockOffset,   // Where each block starts in kWord, in bits.
+    kLogprob,           // Floats for unigrams, else codebook indexes.
+    kBackoff,           // Floats for unigrams, else codebook indexes.
+    kChildBegin,        // Start of the children, as in Order::child_begin.
+    kLogprobCodebook,   // Floats.
+    kBackoffCodebook,   // Floats.
+    kNumFields
+  };
+
+  static const int32 kWordBlockSize = 64;
+
+  // Returns <width> bits of <data_> starting at bit <bit>.
+  uint64 GetBits(int64 bit, int32 width) const {
+    const uint64 *p = data_ + (bit >> 6);
+    int32 shift = bit & 63;
+    uint64 value = p[0] >> shift;
+    if (shift + width > 64)
+      value |= p[1] << (64 - shift);
+    return value & ((static_cast<uint64>(1) << width) - 1);
+  }
+
+  // Returns element <i> of field <field> of order <order>.
+  uint64 Get(int32 order, Field field, int64 i) const {
+    int32 c = (order - 1) * kNumFields + field;
+    return GetBits(column_offsets_[c] + i * column_widths_[c],
+                   column_widths_[c]);
+  }
+
+  float GetFloat(int32 order, Field field, int64 i) const {
+    Int32AndFloat value(static_cast<int32>(Get(order, field, i)));
+    return value.f;
+  }
+
+  // Sets <width> bits of <owned_data_> starting at bit <bit>, which must be
+  // zero, to <value> while building.
+  void SetBits(int64 bit, int32 width, uint64 value);
+
+  // Sets element <i> of field <field> of order <order> while building.
+  void Set(int32 order, Field field, int64 i, uint64 value);
+
+  void SetFloat(int32 order, Field field, int64 i, float value) {
+    Int32AndFloat value_i(value);
+    Set(order, field, i, static_cast<uint32>(value_i.i));
+  }
+
+  // Sets <ngram_id_offset_> from <num_ngrams_>.
+  void ComputeNgramIdOffsets();
+
+  int32 ngram_order_;
+  int32 num_words_;
+  int32 quantize_bits_;
+
+  // The number of n-grams of each order (for unigrams, <num_words_>).
+  std::vector<int64> num_ngrams_;
+  // See NgramId().
+  std::vector<int64> ngram_id_offset_;
+
+  // Where field f of order k starts in <data_> in bits, and how many bits
+  // each element has, are element (k - 1) * kNumFields + f of these.
+  std::vector<int64> column_offsets_;
+  std::vector<int32> column_widths_;
+
+  // The data, which is <owned_data_> unless it is memory-mapped.  There is
+  // one more word than the fields need, as GetBits() always reads a whole
+  // word.
+  std::vector<uint64> owned_data_;
+  const uint64 *data_;
+  int64 data_size_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(ConstArpaLmTrie);
+};
+
 class ConstArpaLm {
  public:
 
@@ -217,6 +410,8 @@ class ConstArpaLm {
     lm_states_ = NULL;
     unigram_states_ = NULL;
     overflow_buffer_ = NULL;
+    trie_ = NULL;
+    mapped_file_ = NULL;
     memory_assigned_ = false;
     initialized_ = false;
   }
@@ -242,56 +437,141 @@ class ConstArpaLm {
     KALDI_ASSERT(unk_symbol_ < num_words_ &&
                  (unk_symbol_ > 0 || unk_symbol_ == -1));
     lm_states_end_ = lm_states_ + lm_states_size_ - 1;
+    trie_ = NULL;
+    mapped_file_ = NULL;
+    memory_assigned_ = false;
+    initialized_ = true;
+  }
+
+  // Special constructor for a language model in the quantized trie format (see
+  // ConstArpaLmTrie).  It does not take ownership of <trie>.
+  ConstArpaLm(const int32 bos_symbol, const int32 eos_symbol,
+              const int32 unk_symbol, const ConstArpaLmTrie* trie) :
+      bos_symbol_(bos_symbol), eos_symbol_(eos_symbol),
+      unk_symbol_(unk_symbol), ngram_order_(trie->NgramOrder()),
+      num_words_(trie->NumWords()), overflow_buffer_size_(0),
+      lm_states_size_(0), lm_states_end_(NULL), unigram_states_(NULL),
+      overflow_buffer_(NULL), lm_states_(NULL), trie_(trie) {
+    KALDI_ASSERT(ngram_order_ > 0);
+    KALDI_ASSERT(bos_symbol_ < num_words_ && bos_symbol_ > 0);
+    KALDI_ASSERT(eos_symbol_ < num_words_ && eos_symbol_ > 0);
+    KALDI_ASSERT(unk_symbol_ < num_words_ &&
+                 (unk_symbol_ > 0 || unk_symbol_ == -1));
+    mapped_file_ = NULL;
     memory_assigned_ = false;
     initialized_ = true;
   }
 
   ~ConstArpaLm() {
     if (memory_assigned_) {
-      delete[] lm_states_;
+      if (mapped_file_ == NULL)
+        delete[] lm_states_;
       delete[] unigram_states_;
       delete[] overflow_buffer_;
+      delete trie_;
     }
+    delete mapped_file_;
   }
 
   // Reads the ConstArpaLm format language model. It calls ReadInternal() or
   // ReadInternalOldFormat() to do the actual reading.
   void Read(std::istream &is, bool binary);
 
-  // Writes the language model in ConstArpaLm format.
-  void Write(std::ostream &os, bool binary) const;
+  // Reads the language model from <rxfilename>. If it is a file that was
+  // written with aligned=true (see Write()), <lm_states_>, which is nearly all
+  // of the model, is not copied but memory-mapped read-only from the file, so
+  // it is shared between all the processes on the machine that use the same
+  // file, and loading takes very little time.  Otherwise (e.g. for pipes, or
+  // files in the normal format) this does the same as ReadKaldiObject().
+  void ReadMapped(const std::string &rxfilename);
+
+  // Writes the language model in ConstArpaLm format (or the quantized trie
+  // format, if that is what it is in). If <aligned> is true, the
+  // <lm_states_> array (or the data of the trie) is padded so that it starts at an offset in the stream
+  // that is a multiple of 16 bytes, so that ReadMapped() can use it directly.
+  // This requires a stream that supports tellp(), i.e. a file and not a pipe.
+  // Files written this way cannot be read by older versions of the code.
+  void Write(std::ostream &os, bool binary, bool aligned = false) const;
 
   // Creates Arpa format language model from ConstArpaLm format, and writes it
   // to output stream. This will be useful in testing.
   void WriteArpa(std::ostream &os) const;
 
-  // Wrapper of GetNgramLogprobRecurse. It first maps possible out-of-vocabulary
-  // words to <unk>, if <unk> is defined, and then calls GetNgramLogprobRecurse.
+  // Wrapper of GetNgramLogprobInternal. It first maps possible
+  // out-of-vocabulary words to <unk>, if <unk> is defined, and then calls
+  // GetNgramLogprobInternal.
   float GetNgramLogprob(const int32 word, const std::vector<int32>& hist) const;
 
   // Returns true if the history word sequence <hist> has successor, which means
   // <hist> will be a state in the FST format language model.
   bool HistoryStateExists(const std::vector<int32>& hist) const;
 
+  // Like HistoryStateExists(), but if the history state exists, also outputs
+  // to <state_id> a number that identifies it: different history states have
+  // different ids, and the empty history has id -1.  This is a cheap key for
+  // history states, e.g. for hashing.
+  bool HistoryStateExists(const std::vector<int32>& hist,
+                          int64 *state_id) const;
+
+  // Appends <word> to the history <hist> and then removes words from the
+  // front of it until it is a history state (so it has at most NgramOrder() - 1
+  // words; it may end up empty).  Outputs the id of that history state to
+  // <state_id>, as HistoryStateExists() does.  This is what you need to follow
+  // an arc of the FST form of the language model.
+  void ExtendHistoryState(int32 word, std::vector<int32>* hist,
+                          int64* state_id) const;
+
   int32 BosSymbol() const { return bos_symbol_; }
   int32 EosSymbol() const { return eos_symbol_; }
   int32 UnkSymbol() const { return unk_symbol_; }
   int32 NgramOrder() const { return ngram_order_; }
 
+  // Returns the number of bits of the quantized log-probs if the language
+  // model is in the quantized trie format (see ConstArpaLmTrie), else 0.
+  int32 QuantizeBits() const {
+    return (trie_ != NULL ? trie_->QuantizeBits() : 0);
+  }
+
+  // Returns the number of bytes of memory taken by the n-grams (not counting
+  // small fixed-size parts).
+  int64 NumBytes() const;
+
  private:
   // Function that loads data from stream to the class.
   void ReadInternal(std::istream &is, bool binary);
 
+  // Does the rest of ReadInternal() for the quantized trie format, after the
+  // <LmTrie> token.
+  void ReadTrieInternal(std::istream &is, bool binary);
+
   // Function that loads data from stream to the class. This is a deprecated one
   // that handles the old on-disk format. We keep this for back-compatibility
   // purpose. We have modified the Write() function so for all the new on-disk
   // format, ReadInternal() will be called.
   void ReadInternalOldFormat(std::istream &is, bool binary);
 
-  // Loops up n-gram probability for given word sequence. Backoff is handled by
-  // recursively calling this function.
-  float GetNgramLogprobRecurse(const int32 word,
-                               const std::vector<int32>& hist) const;
+  // Loops up n-gram probability for the word sequence hist_begin ...
+  // hist_end - 1 followed by <word>.  Backoff is handled by walking down the
+  // suffixes of the history in place, adding up the backoff weights of the
+  // ones that exist, so no word sequences are copied.
+  float GetNgramLogprobInternal(const int32 word, const int32* hist_begin,
+                                const int32* hist_end) const;
+
+  // As GetNgramLogprobInternal(), for the quantized trie format.
+  float GetNgramLogprobTrie(const int32 word, const int32* hist_begin,
+                            const int32* hist_end) const;
+
+  // Returns true if the word sequence begin ... end - 1 (which must not be
+  // empty) is a history state, i.e. it has successors, and if so outputs its
+  // id (see HistoryStateExists()).  Works for both formats.
+  bool GetHistoryStateId(const int32* begin, const int32* end,
+                         int64* state_id) const;
+
+  // Returns true if <word> (which must be nonnegative) has a unigram.
+  bool HasUnigram(const int32 word) const {
+    if (trie_ != NULL) return trie_->HasUnigram(word);
+    return word < num_words_ && unigram_states_[word] != NULL;
+  }
 
   // Given a word sequence, find the address of the corresponding LmState.
   // Returns NULL if no corresponding LmState is found.
@@ -301,6 +581,9 @@ class ConstArpaLm {
   // reserved for this sequence.
   int32* GetLmState(const std::vector<int32>& seq) const;
 
+  // As above, for the word sequence begin ... end - 1.
+  int32* GetLmState(const int32* begin, const int32* end) const;
+
   // Given a pointer to the parent, find the child_info that corresponds to
   // given word. The parent has the following structure:
   // struct LmState {
@@ -321,10 +604,20 @@ class ConstArpaLm {
                         const std::vector<int32>& seq,
                         std::vector<ArpaLine> *output) const;
 
+  // As WriteArpaRecurse(), for n-gram <index> of order <order> of the trie;
+  // <seq> is its history.
+  void WriteArpaRecurseTrie(int32 order, int64 index,
+                            std::vector<int32>* seq,
+                            std::vector<ArpaLine> *output) const;
+
   // We assign memory in Read(). If it is called, we have to release memory in
   // the destructor.
   bool memory_assigned_;
 
+  // If ReadMapped() mapped <lm_states_> from a file, this is the mapping, and
+  // we own it; otherwise NULL.
+  MappedFile *mapped_file_;
+
   // Makes sure that the language model has been loaded before using it.
   bool initialized_;
 
@@ -382,6 +675,12 @@ class ConstArpaLm {
   //
   // x = 1 + 1 + 1 + 2 * children.size() = 3 + 2 * children.size()
   int32* lm_states_;
+
+  // The language model in the quantized trie format, in which case the arrays
+  // above are not used; NULL otherwise.
+  const ConstArpaLmTrie* trie_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(ConstArpaLm);
 };
 
 /**
@@ -395,7 +694,12 @@ class ConstArpaLmDeterministicFst
   typedef fst::StdArc::StateId StateId;
   typedef fst::StdArc::Label Label;
 
-  explicit ConstArpaLmDeterministicFst(const ConstArpaLm& lm);
+  // If <cache> is not NULL, the arcs are looked up in it before they are
+  // computed, and added to it after; it may be shared with other
+  // ConstArpaLmDeterministicFst objects for the same language model, e.g. in
+  // other threads.  We don't take ownership of the cache.
+  explicit ConstArpaLmDeterministicFst(
+      const ConstArpaLm& lm, fst::SharedArcCache<fst::StdArc>* cache = NULL);
 
   // We cannot use "const" because the pure virtual function in the interface is
   // not const.
@@ -408,20 +712,146 @@ class ConstArpaLmDeterministicFst
   virtual bool GetArc(StateId s, Label ilabel, fst::StdArc* oarc);
 
  private:
-  typedef unordered_map<std::vector<Label>,
-                        StateId, VectorHasher<Label> > MapType;
+  // Returns the state for history <wseq>, whose id in the language model is
+  // <lm_state_id>, creating it if it does not exist.
+  StateId FindOrAddState(const std::vector<Label>& wseq, int64 lm_state_id);
+
+  // Outputs the history word sequence of state <s>.
+  void GetWordSequence(StateId s, std::vector<Label>* wseq) const;
+
   StateId start_state_;
-  MapType wseq_to_state_;
-  std::vector<std::vector<Label> > state_to_wseq_;
+
+  // Maps history state ids in the language model (see
+  // ConstArpaLm::HistoryStateExists()) to our states.  Using the id rather than
+  // the word sequence as the key means we don't have to hash and allocate a
+  // vector for each lookup.
+  unordered_map<int64, StateId> lm_state_to_state_;
+
+  // The history word sequence of state s is elements wseq_begin_[s] to
+  // wseq_begin_[s+1] - 1 of <wseq_words_>.
+  std::vector<int32> wseq_begin_;
+  std::vector<Label> wseq_words_;
+
+  // Caches the result of GetArc(), since the composition asks for the same arc
+  // once for each lattice state paired with our state.  The key is (s << 32) +
+  // ilabel; the value is the next state (kNoStateId if there is no arc) and the
+  // log-prob.
+  unordered_map<int64, std::pair<StateId, float> > arc_cache_;
+
+  // Caches the log-prob of </s> for each state; +infinity if not computed yet.
+  std::vector<float> final_logprob_;
+
+  // The key of each state in <cache_>: the id of its history state in the
+  // language model, or -2 for the start state if <s> is not a history state.
+  std::vector<int64> cache_key_;
+
+  // Temporary storage for GetArc().
+  std::vector<Label> wseq_;
+
   const ConstArpaLm& lm_;
+  fst::SharedArcCache<fst::StdArc>* cache_;
+};
+
+/**
+ This class gives, as a DeterministicOnDemandFst, the difference between a
+ language model in ConstArpaLm format and the language model a decoding graph
+ was built with (which must be in ConstArpaLm format too), for decoding with
+ LatticeBiglmFasterDecoder.  The weight of an arc is the cost of its word under
+ <new_lm> minus its cost under <old_lm>, and likewise for the final weights.
+ If <old_lm> is NULL, the arcs have the costs of <new_lm> only; this is for
+ graphs that were built without language model scores.
+
+ This way a small graph can be decoded with a very large language model
+ without building the FST of the large one.  The states are pairs of history
+ states of the two models, identified by their ids in the models (see
+ ConstArpaLm::HistoryStateExists()), and the arcs are found by looking up
+ the n-grams in the models directly.  The decoder asks for the same few arcs
+ for many tokens on each frame, so the most recently used arcs are kept in a
+ fixed-size, direct-mapped cache, as in CacheDeterministicOnDemandFst.  The
+ states it creates are never freed, so use a new one for each utterance.
+ */
+class ConstArpaLmDiffDeterministicFst
+  : public fst::DeterministicOnDemandFst<fst::StdArc> {
+ public:
+  typedef fst::StdArc::Weight Weight;
+  typedef fst::StdArc::StateId StateId;
+  typedef fst::StdArc::Label Label;
+
+  // Does not take ownership of the language models.  The two models must use
+  // the same integer ids for words, and for <s> and </s>.
+  ConstArpaLmDiffDeterministicFst(const ConstArpaLm* old_lm,
+                                  const ConstArpaLm& new_lm,
+                                  int32 num_cached_arcs = 100000);
+
+  virtual StateId Start() { return start_state_; }
+
+  virtual Weight Final(StateId s);
+
+  virtual bool GetArc(StateId s, Label ilabel, fst::StdArc* oarc);
+
+  // Returns the number of states created so far.
+  StateId NumStates() const { return final_cost_.size(); }
+
+ private:
+  struct CachedArc {
+    StateId state;  // kNoStateId if this entry is unused.
+    Label ilabel;
+    StateId nextstate;
+    float cost;
+  };
+
+  // Returns the state for the pair of histories, creating it if it does not
+  // exist.
+  StateId FindOrAddState(const std::vector<Label>& old_wseq,
+                         int64 old_lm_state_id,
+                         const std::vector<Label>& new_wseq,
+                         int64 new_lm_state_id);
+
+  // Outputs the history word sequences of state s in the old and new language
+  // models.
+  void GetWordSequences(StateId s, std::vector<Label>* old_wseq,
+                        std::vector<Label>* new_wseq) const;
+
+  // Computes the arc that GetArc() returns, without the cache.
+  bool ComputeArc(StateId s, Label ilabel, StateId* nextstate, float* cost);
+
+  StateId start_state_;
+
+  // Maps the pairs of history state ids in the two language models to our
+  // states.
+  unordered_map<std::pair<int64, int64>, StateId,
+                PairHasher<int64> > lm_states_to_state_;
+
+  // The history word sequence of state s in the old language model is elements
+  // wseq_begin_[2 * s] to wseq_begin_[2 * s + 1] - 1 of <wseq_words_>, and that
+  // in the new language model the elements from there to
+  // wseq_begin_[2 * s + 2] - 1.
+  std::vector<int32> wseq_begin_;
+  std::vector<Label> wseq_words_;
+
+  // The direct-mapped cache of arcs.
+  std::vector<CachedArc> cached_arcs_;
+
+  // Caches the final cost of each state; +infinity if not computed yet.
+  std::vector<float> final_cost_;
+
+  // Temporary storage for GetArc() and Final().
+  std::vector<Label> old_wseq_;
+  std::vector<Label> new_wseq_;
+
+  const ConstArpaLm* old_lm_;
+  const ConstArpaLm& new_lm_;
 };
 
 // Reads in an Arpa format language model and converts it into ConstArpaLm
 // format. We assume that the words in the input Arpa format language model have
-// been converted into integers.
+// been converted into integers.  If <quantize_bits> is nonzero, the language
+// model is written in the quantized trie format (see ConstArpaLmTrie) with that
+// many bits for the log-probs and backoffs of the orders above unigrams.
 bool BuildConstArpaLm(const ArpaParseOptions& options,
                       const std::string& arpa_rxfilename,
-                      const std::string& const_arpa_wxfilename);
+                      const std::string& const_arpa_wxfilename,
+                      int32 quantize_bits = 0);
 
 }  // namespace kaldi
 
@@ -0,0 +1,347 @@
+// lm/kaldi-rnnlm-batched-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <fstream>
+#include <map>
+#include <sstream>
+
+#include "lm/kaldi-rnnlm-batched.h"
+
+namespace kaldi {
+
+// Writes an RNNLM with random weights in the text format that
+// CRnnLM::restoreNet() reads.  The vocabulary is </s>, a0, a1, ..., and then
+// <RNN_UNK> if "with_unk" is true.
+static void WriteRandomRnnlm(const std::string &filename, int32 vocab_size,
+                             int32 hidden_dim, int32 compression_dim,
+                             int32 num_classes, int32 direct_size,
+                             int32 direct_order, bool with_unk) {
+  std::ofstream os(filename.c_str());
+  os << "version: 10\nfile format: 0\n\n"
+     << "training data file: train\nvalidation data file: valid\n\n"
+     << "last probability of validation data: 0\n"
+     << "number of finished iterations: 0\n"
+     << "current position in training data: 0\n"
+     << "current probability of training data: 0\n"
+     << "save after processing: 0\n# of training words: 0\n"
+     << "input layer size: " << (vocab_size + hidden_dim) << "\n"
+     << "hidden layer size: " << hidden_dim << "\n"
+     << "compression layer size: " << compression_dim << "\n"
+     << "output layer size: " << (vocab_size + num_classes) << "\n"
+     << "direct connections: " << direct_size << "\n"
+     << "direct order: " << direct_order << "\n"
+     << "bptt: 0\nbptt block: 10\n"
+     << "vocabulary size: " << vocab_size << "\n"
+     << "class size: " << num_classes << "\n"
+     << "old classes: 0\nindependent sentences mode: 0\n"
+     << "starting learning rate: 0.1\ncurrent learning rate: 0.1\n"
+     << "learning rate decrease: 0\n\n\nVocabulary:\n";
+  for (int32 i = 0; i < vocab_size; i++) {
+    std::ostringstream word;
+    if (i == 0)
+      word << "</s>";
+    else if (with_unk && i == vocab_size - 1)
+      word << "<RNN_UNK>";
+    else
+      word << 'a' << (i - 1);
+    // restoreNet() assigns the classes from the counts.
+    os << i << ' ' << (1000 / (i + 1)) << ' ' << word.str() << " 0\n";
+  }
+  os << "\nHidden layer activation:\n";
+  for (int32 i = 0; i < hidden_dim; i++)
+    os << RandUniform() << '\n';
+  int32 output_dim = (compression_dim > 0 ? compression_dim : hidden_dim);
+  os << "\nWeights 0->1:\n";
+  for (int32 i = 0; i < hidden_dim * (vocab_size + hidden_dim); i++)
+    os << 0.5 * RandGauss() << '\n';
+  if (compression_dim > 0) {
+    os << "\nWeights 1->c:\n";
+    for (int32 i = 0; i < compression_dim * hidden_dim; i++)
+      os << 0.5 * RandGauss() << '\n';
+    os << "\n\nWeights c->2:\n";
+  } else {
+    os << "\nWeights 1->2:\n";
+  }
+  for (int32 i = 0; i < output_dim * (vocab_size + num_classes); i++)
+    os << RandGauss() << '\n';
+  os << "\nDirect connections:\n";
+  for (int32 i = 0; i < direct_size; i++)
+    os << RandGauss() << '\n';
+}
+
+// Outputs the labels for an RNNLM written by WriteRandomRnnlm(): <eps>, the
+// vocabulary words a0, a1, ..., two words that are not in the vocabulary, and
+// </s>, which is the last one.
+static void GetRandomRnnlmLabels(int32 vocab_size, bool with_unk,
+                                 std::vector<std::string> *label_to_word) {
+  label_to_word->assign(1, "<eps>");
+  for (int32 i = 0; i + (with_unk ? 2 : 1) < vocab_size; i++) {
+    std::ostringstream word;
+    word << 'a' << i;
+    label_to_word->push_back(word.str());
+  }
+  label_to_word->push_back("b0");
+  label_to_word->push_back("b1");
+  label_to_word->push_back("</s>");
+}
+
+// Computes log-probs as RnnlmDeterministicFst does, using CRnnLM directly.
+class ReferenceRnnlm {
+ public:
+  ReferenceRnnlm(rnnlm::CRnnLM *rnnlm,
+                 const std::vector<std::string> &label_to_word,
+                 int32 max_ngram_order):
+      rnnlm_(rnnlm), label_to_word_(label_to_word),
+      max_ngram_order_(max_ngram_order) {
+    // The empty history starts with a hidden layer of ones.
+    contexts_[std::vector<int32>()].resize(rnnlm->getHiddenLayerSize(), 1.0);
+  }
+
+  // The state is the word sequence and the context.  Outputs the next state,
+  // which is the first one created for its word sequence, as in
+  // RnnlmDeterministicFst.
+  BaseFloat GetLogProb(const std::vector<int32> &wseq,
+                       const std::vector<float> &context, int32 word,
+                       std::vector<int32> *next_wseq,
+                       std::vector<float> *next_context) {
+    std::vector<std::string> history;
+    for (size_t i = 0; i < wseq.size(); i++)
+      history.push_back(label_to_word_[wseq[i]]);
+    std::vector<float> context_out;
+    BaseFloat logprob = rnnlm_->computeConditionalLogprob(
+        label_to_word_[word], history, context, &context_out);
+    if (next_wseq != NULL) {
+      *next_wseq = wseq;
+      next_wseq->push_back(word);
+      if (max_ngram_order_ > 0)
+        while (next_wseq->size() >= max_ngram_order_)
+          next_wseq->erase(next_wseq->begin());
+      std::map<std::vector<int32>, std::vector<float> >::iterator iter =
+          contexts_.find(*next_wseq);
+      if (iter == contexts_.end())
+        iter = contexts_.insert(std::make_pair(*next_wseq,
+                                               context_out)).first;
+      *next_context = iter->second;
+    }
+    return logprob;
+  }
+
+ private:
+  rnnlm::CRnnLM *rnnlm_;
+  std::vector<std::string> label_to_word_;
+  int32 max_ngram_order_;
+  std::map<std::vector<int32>, std::vector<float> > contexts_;
+};
+
+static void UnitTestRnnlmBatched(int32 seed) {
+  // CRnnLM's constructor calls srand(), so we reseed for each test.
+  srand(seed);
+  int32 vocab_size = 5 + RandInt(0, 20), hidden_dim = 1 + RandInt(0, 20),
+      compression_dim = (RandInt(0, 1) == 0 ? 0 : 1 + RandInt(0, 10)),
+      num_classes = 1 + RandInt(0, 5),
+      direct_size = (RandInt(0, 1) == 0 ? 0 : 2 * RandInt(1, 500)),
+      direct_order = RandInt(1, 4), max_ngram_order = RandInt(-1, 4);
+  bool with_unk = (RandInt(0, 3) != 0);
+  std::string filename = "tmp.rnnlm";
+  WriteRandomRnnlm(filename, vocab_size, hidden_dim, compression_dim,
+                   num_classes, direct_size, direct_order, with_unk);
+  rnnlm::CRnnLM rnnlm;
+  rnnlm.setRnnLMFile(filename);
+  rnnlm.setRandSeed(1);
+  rnnlm.setUnkSym("<RNN_UNK>");
+  rnnlm.restoreNet();
+  unlink(filename.c_str());
+
+  std::vector<std::string> label_to_word;
+  GetRandomRnnlmLabels(vocab_size, with_unk, &label_to_word);
+  int32 eos = label_to_word.size() - 1;
+
+  RnnlmBatchedModel model(rnnlm, label_to_word, eos);
+  KALDI_ASSERT(model.HiddenDim() == hidden_dim &&
+               model.NumClasses() == num_classes && model.Eos() == eos);
+  RnnlmBatchedComputer computer(model, max_ngram_order);
+  ReferenceRnnlm reference(&rnnlm, label_to_word, max_ngram_order);
+
+  // Each element of the frontier is a state of "computer" and the word
+  // sequence and context of the reference.
+  struct State {
+    int32 state;
+    std::vector<int32> wseq;
+    std::vector<float> context;
+  };
+  std::vector<State> frontier(1), next_frontier;
+  frontier[0].state = computer.StartState();
+  frontier[0].context.resize(hidden_dim, 1.0);
+  // Maps word sequences to states, to check that the states are shared in the
+  // same way.
+  std::map<std::vector<int32>, int32> wseq_to_state;
+  wseq_to_state[frontier[0].wseq] = frontier[0].state;
+  for (int32 depth = 0; depth < 4; depth++) {
+    // Queries some random words, and </s>, after each state at this depth,
+    // either all together or one by one.  The computer reaches new states in
+    // the order of the queries either way, which is the order in which the
+    // reference reaches them, so states that are shared because of history
+    // truncation get the same hidden layer.
+    bool batched = (RandInt(0, 1) == 0);
+    std::vector<std::pair<size_t, int32> > queries;
+    for (size_t i = 0; i < frontier.size(); i++) {
+      for (int32 j = 0; j < 3; j++)
+        queries.push_back(std::make_pair(i, RandInt(1, eos)));
+      queries.push_back(std::make_pair(i, eos));
+    }
+    if (batched) {
+      for (size_t i = 0; i < queries.size(); i++)
+        computer.AddQuery(frontier[queries[i].first].state, queries[i].second);
+      computer.ComputeQueries();
+    }
+    next_frontier.clear();
+    for (size_t i = 0; i < queries.size(); i++) {
+      const State &state = frontier[queries[i].first];
+      int32 word = queries[i].second, next_state;
+      State next;
+      BaseFloat a = computer.GetLogProb(state.state, word, &next_state),
+          b = reference.GetLogProb(state.wseq, state.context, word,
+                                   (word == eos ? NULL : &next.wseq),
+                                   &next.context);
+      AssertEqual(a, b, 1.0e-03);
+      if (word == eos) {
+        KALDI_ASSERT(next_state == -1);
+        continue;
+      }
+      next.state = next_state;
+      std::map<std::vector<int32>, int32>::iterator iter =
+          wseq_to_state.find(next.wseq);
+      if (iter == wseq_to_state.end())
+        wseq_to_state[next.wseq] = next_state;
+      else
+        KALDI_ASSERT(iter->second == next_state);
+      if (next_frontier.size() < 50)
+        next_frontier.push_back(next);
+    }
+    frontier.swap(next_frontier);
+  }
+  KALDI_ASSERT(computer.NumStates() >= wseq_to_state.size());
+}
+
+// Scores the sentences of a batch of "lattices" as rescoring the lattices
+// together does: each lattice has its own start state, and the histories of
+// all of them are expanded breadth-first, with the queries of each generation
+// computed together.  Appends the log-probs of the words of each sentence
+// (and of </s>) to <logprobs>, one element per lattice.
+static void ScoreSentences(
+    const std::vector<std::vector<std::vector<int32> > > &lattices,
+    int32 eos, RnnlmBatchedComputer *computer,
+    std::vector<std::vector<std::vector<BaseFloat> > > *logprobs) {
+  size_t offset = logprobs->size();
+  logprobs->resize(offset + lattices.size());
+  // The current state of each sentence; the first lattice starts from the
+  // computer's own start state.
+  std::vector<std::vector<int32> > states(lattices.size());
+  for (size_t i = 0; i < lattices.size(); i++) {
+    int32 start = (i == 0 ? computer->StartState() :
+                   computer->AddStartState());
+    states[i].resize(lattices[i].size(), start);
+    (*logprobs)[offset + i].resize(lattices[i].size());
+  }
+  for (size_t t = 0; ; t++) {
+    bool done = true;
+    for (size_t i = 0; i < lattices.size(); i++) {
+      for (size_t j = 0; j < lattices[i].size(); j++) {
+        const std::vector<int32> &sentence = lattices[i][j];
+        if (t <= sentence.size()) {
+          computer->AddQuery(states[i][j],
+                             (t < sentence.size() ? sentence[t] : eos));
+          done = false;
+        }
+      }
+    }
+    if (done)
+      break;
+    computer->ComputeQueries();
+    for (size_t i = 0; i < lattices.size(); i++) {
+      for (size_t j = 0; j < lattices[i].size(); j++) {
+        const std::vector<int32> &sentence = lattices[i][j];
+        if (t <= sentence.size()) {
+          int32 word = (t < sentence.size() ? sentence[t] : eos);
+          (*logprobs)[offset + i][j].push_back(
+              computer->GetLogProb(states[i][j], word, &(states[i][j])));
+        }
+      }
+    }
+  }
+}
+
+// Checks that scoring lattices together gives the same results as scoring them
+// one at a time.  With max_ngram_order > 0 the hidden layer of a truncated
+// history is that of the first history that reached it, so this fails if the
+// lattices share history states.  The sentences use few words so that they
+// reach the same truncated histories in different ways.
+static void UnitTestRnnlmBatchedStartStates(int32 seed) {
+  srand(seed);
+  int32 vocab_size = 5 + RandInt(0, 10), hidden_dim = 1 + RandInt(0, 10),
+      num_classes = 1 + RandInt(0, 3), max_ngram_order = RandInt(1, 4);
+  std::string filename = "tmp.rnnlm";
+  WriteRandomRnnlm(filename, vocab_size, hidden_dim, 0, num_classes, 0, 1,
+                   true);
+  rnnlm::CRnnLM rnnlm;
+  rnnlm.setRnnLMFile(filename);
+  rnnlm.setRandSeed(1);
+  rnnlm.setUnkSym("<RNN_UNK>");
+  rnnlm.restoreNet();
+  unlink(filename.c_str());
+  std::vector<std::string> label_to_word;
+  GetRandomRnnlmLabels(vocab_size, true, &label_to_word);
+  int32 eos = label_to_word.size() - 1;
+  RnnlmBatchedModel model(rnnlm, label_to_word, eos);
+
+  int32 num_lattices = RandInt(2, 6);
+  std::vector<std::vector<std::vector<int32> > > lattices(num_lattices);
+  for (int32 i = 0; i < num_lattices; i++) {
+    lattices[i].resize(RandInt(1, 5));
+    for (size_t j = 0; j < lattices[i].size(); j++) {
+      int32 length = RandInt(0, 6);
+      for (int32 t = 0; t < length; t++)
+        lattices[i][j].push_back(RandInt(1, 3));
+    }
+  }
+
+  std::vector<std::vector<std::vector<BaseFloat> > > logprobs, logprobs1;
+  RnnlmBatchedComputer computer(model, max_ngram_order);
+  ScoreSentences(lattices, eos, &computer, &logprobs);
+  for (int32 i = 0; i < num_lattices; i++) {
+    RnnlmBatchedComputer computer1(model, max_ngram_order);
+    ScoreSentences(std::vector<std::vector<std::vector<int32> > >(
+        1, lattices[i]), eos, &computer1, &logprobs1);
+  }
+  // The results are the same up to roundoff, which may depend on the number of
+  // rows in the matrix products.
+  for (int32 i = 0; i < num_lattices; i++)
+    for (size_t j = 0; j < lattices[i].size(); j++)
+      for (size_t t = 0; t <= lattices[i][j].size(); t++)
+        AssertEqual(logprobs[i][j][t], logprobs1[i][j][t], 1.0e-06);
+}
+
+}  // namespace kaldi
+
+int main() {
+  for (int32 i = 0; i < 20; i++) {
+    kaldi::UnitTestRnnlmBatched(i);
+    kaldi::UnitTestRnnlmBatchedStartStates(i);
+  }
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
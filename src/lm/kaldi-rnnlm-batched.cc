@@ -0,0 +1,436 @@
+// lm/kaldi-rnnlm-batched.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cstring>
+
+#include "lm/kaldi-rnnlm-batched.h"
+
+namespace kaldi {
+
+// The log-prob that CRnnLM gives to words that are not in its vocabulary.
+static const BaseFloat kRnnlmOovLogprob = -16.118;
+
+// The approximate exp() that CRnnLM uses (the FAST_EXP macro in
+// mikolov-rnnlm-lib.cc), without the static variable that makes that macro
+// unsafe to use from several threads.  It is only accurate to a few percent,
+// but we use it so that we get the same answers as CRnnLM.
+static inline double RnnlmFastExp(double y) {
+  const double kExpA = 1048576 / M_LN2;
+  const int32 kExpC = 60801;
+  uint64 bits = static_cast<uint64>(static_cast<uint32>(
+      static_cast<int32>(kExpA * y + (1072693248 - kExpC)))) << 32;
+  double ans;
+  memcpy(&ans, &bits, sizeof(ans));
+  return ans;
+}
+
+// Applies the sigmoid function as CRnnLM does.
+static void RnnlmSigmoid(MatrixBase<BaseFloat> *mat) {
+  for (MatrixIndexT r = 0; r < mat->NumRows(); r++) {
+    BaseFloat *data = mat->RowData(r);
+    for (MatrixIndexT c = 0; c < mat->NumCols(); c++) {
+      double x = std::max(-50.0, std::min(50.0, static_cast<double>(data[c])));
+      data[c] = 1.0 / (1.0 + RnnlmFastExp(-x));
+    }
+  }
+}
+
+// Replaces the scores with log-probs from the softmax as CRnnLM does it.
+static void RnnlmLogSoftmax(int32 dim, double *scores) {
+  double sum = 0.0;
+  for (int32 i = 0; i < dim; i++) {
+    scores[i] = RnnlmFastExp(std::max(-50.0, std::min(50.0, scores[i])));
+    sum += scores[i];
+  }
+  for (int32 i = 0; i < dim; i++)
+    scores[i] = log(scores[i] / sum);
+}
+
+RnnlmBatchedModel::RnnlmBatchedModel(
+    const rnnlm::CRnnLM &rnnlm,
+    const std::vector<std::string> &label_to_word,
+    int32 eos): eos_(eos) {
+  int32 vocab_size = rnnlm.vocab_size, hidden_dim = rnnlm.layer1_size,
+      compression_dim = rnnlm.layerc_size, num_classes = rnnlm.class_size,
+      layer0_size = rnnlm.layer0_size;
+  if (rnnlm.neu0 == NULL)
+    KALDI_ERR << "The RNNLM has not been read.";
+  KALDI_ASSERT(layer0_size == vocab_size + hidden_dim &&
+               rnnlm.layer2_size == vocab_size + num_classes);
+  KALDI_ASSERT(eos >= 0 && eos < static_cast<int32>(label_to_word.size()));
+
+  // Maps the labels to the vocabulary as CRnnLM::computeConditionalLogprob()
+  // does, but once and for all rather than with a string search per query.
+  unordered_map<std::string, int32, StringHasher> word_to_index;
+  for (int32 i = vocab_size - 1; i >= 0; i--)
+    word_to_index[rnnlm.vocab[i].word] = i;  // The first one wins.
+  unordered_map<std::string, int32, StringHasher>::const_iterator iter =
+      word_to_index.find(rnnlm.unk_sym);
+  int32 unk_index = (iter == word_to_index.end() ? -1 : iter->second);
+  label_to_index_.resize(label_to_word.size());
+  label_penalty_.resize(label_to_word.size(), 0.0);
+  for (size_t i = 0; i < label_to_word.size(); i++) {
+    const std::string &word = label_to_word[i];
+    iter = word_to_index.find(word);
+    if (iter != word_to_index.end() && word != rnnlm.unk_sym) {
+      label_to_index_[i] = iter->second;
+    } else {
+      label_to_index_[i] = unk_index;
+      unordered_map<std::string, float>::const_iterator penalty_iter =
+          rnnlm.unk_penalty.find(word);
+      label_penalty_[i] = (penalty_iter != rnnlm.unk_penalty.end() ?
+                           penalty_iter->second : kRnnlmOovLogprob);
+      // If the unknown-word symbol is not in the vocabulary either, this is
+      // the whole log-prob.
+      if (unk_index == -1)
+        label_penalty_[i] += kRnnlmOovLogprob;
+    }
+  }
+
+  // CRnnLM assigns the classes in the order of the words, so the words of each
+  // class are contiguous, and its output layer relies on that.
+  word_class_.resize(vocab_size);
+  class_begin_.resize(num_classes + 1);
+  for (int32 i = 0; i < vocab_size; i++) {
+    word_class_[i] = rnnlm.vocab[i].class_index;
+    KALDI_ASSERT(word_class_[i] >= 0 && word_class_[i] < num_classes);
+    if (i > 0 && word_class_[i] < word_class_[i - 1])
+      KALDI_ERR << "The words of each class in the RNNLM are not contiguous.";
+  }
+  for (int32 c = 0, i = 0; c <= num_classes; c++) {
+    while (i < vocab_size && word_class_[i] < c)
+      i++;
+    class_begin_[c] = i;
+  }
+
+  input_.Resize(vocab_size, hidden_dim);
+  recurrent_.Resize(hidden_dim, hidden_dim);
+  for (int32 b = 0; b < hidden_dim; b++) {
+    const rnnlm::synapse *row = rnnlm.syn0 + b * layer0_size;
+    for (int32 a = 0; a < vocab_size; a++)
+      input_(a, b) = row[a].weight;
+    for (int32 a = 0; a < hidden_dim; a++)
+      recurrent_(b, a) = row[vocab_size + a].weight;
+  }
+  const rnnlm::synapse *output = rnnlm.syn1;
+  int32 output_dim = hidden_dim;
+  if (compression_dim > 0) {
+    compression_.Resize(compression_dim, hidden_dim);
+    for (int32 b = 0; b < compression_dim; b++)
+      for (int32 a = 0; a < hidden_dim; a++)
+        compression_(b, a) = rnnlm.syn1[a + b * hidden_dim].weight;
+    output = rnnlm.sync;
+    output_dim = compression_dim;
+  }
+  word_output_.Resize(vocab_size, output_dim);
+  class_output_.Resize(num_classes, output_dim);
+  for (int32 b = 0; b < vocab_size + num_classes; b++) {
+    BaseFloat *row = (b < vocab_size ? word_output_.RowData(b) :
+                      class_output_.RowData(b - vocab_size));
+    for (int32 a = 0; a < output_dim; a++)
+      row[a] = output[a + b * output_dim].weight;
+  }
+
+  direct_ = rnnlm.syn_d;
+  direct_size_ = rnnlm.direct_size;
+  direct_order_ = rnnlm.direct_order;
+  KALDI_ASSERT(direct_order_ <= rnnlm::MAX_NGRAM_ORDER);
+}
+
+RnnlmBatchedComputer::RnnlmBatchedComputer(const RnnlmBatchedModel &model,
+                                           int32 max_ngram_order):
+    model_(model),
+    max_history_length_(max_ngram_order > 0 ? max_ngram_order - 1 : -1) {
+  // The empty history, which starts with a hidden layer of ones.
+  states_.push_back(HistoryState(-1, -1, 0, 0));
+  states_[0].context = 0;
+  hidden_.resize(model_.HiddenDim(), 1.0);
+}
+
+int32 RnnlmBatchedComputer::AddStartState() {
+  int32 state = states_.size();
+  states_.push_back(HistoryState(-1, -1, 0, state));
+  states_[state].context = 0;
+  return state;
+}
+
+void RnnlmBatchedComputer::AddQuery(int32 state, int32 word) {
+  KALDI_ASSERT(static_cast<size_t>(state) < states_.size() &&
+               states_[state].context != -1);
+  KALDI_ASSERT(word >= 0 && word < model_.NumLabels());
+  int64 key = (static_cast<int64>(state) << 32) + word;
+  if (results_.insert(std::make_pair(key, std::make_pair(-2, 0.0f))).second)
+    queries_.push_back(std::make_pair(state, word));
+}
+
+BaseFloat RnnlmBatchedComputer::GetLogProb(int32 state, int32 word,
+                                           int32 *next_state) {
+  int64 key = (static_cast<int64>(state) << 32) + word;
+  unordered_map<int64, std::pair<int32, BaseFloat> >::const_iterator iter =
+      results_.find(key);
+  if (iter == results_.end() || iter->second.first == -2) {
+    AddQuery(state, word);
+    ComputeQueries();
+    iter = results_.find(key);
+  }
+  if (next_state != NULL)
+    *next_state = iter->second.first;
+  return iter->second.second;
+}
+
+void RnnlmBatchedComputer::ComputeQueries() {
+  if (queries_.empty())
+    return;
+
+  std::vector<int32> to_expand;
+  for (size_t i = 0; i < queries_.size(); i++)
+    if (states_[queries_[i].first].expanded == -1)
+      to_expand.push_back(queries_[i].first);
+  SortAndUniq(&to_expand);
+  ExpandStates(to_expand);
+
+  // Sorts the queries by class and then state, so that the words of each class
+  // are done with one matrix product.
+  int32 num_classes = model_.NumClasses();
+  std::vector<std::pair<int32, std::pair<int32, int32> > > sorted_queries;
+  for (size_t i = 0; i < queries_.size(); i++) {
+    int32 state = queries_[i].first, word = queries_[i].second,
+        index = model_.label_to_index_[word];
+    if (index == -1) {
+      int64 key = (static_cast<int64>(state) << 32) + word;
+      results_[key].second = model_.label_penalty_[word];
+    } else {
+      sorted_queries.push_back(std::make_pair(model_.word_class_[index],
+                                              queries_[i]));
+    }
+  }
+  std::sort(sorted_queries.begin(), sorted_queries.end());
+
+  std::vector<int32> class_states;
+  Matrix<double> word_logprobs;
+  for (size_t begin = 0, end; begin < sorted_queries.size(); begin = end) {
+    int32 c = sorted_queries[begin].first;
+    class_states.clear();
+    for (end = begin; end < sorted_queries.size() &&
+             sorted_queries[end].first == c; end++)
+      if (class_states.empty() ||
+          class_states.back() != sorted_queries[end].second.first)
+        class_states.push_back(sorted_queries[end].second.first);
+    ComputeClassWords(c, class_states, &word_logprobs);
+    for (size_t i = begin, row = 0; i < end; i++) {
+      int32 state = sorted_queries[i].second.first,
+          word = sorted_queries[i].second.second;
+      while (class_states[row] != state)
+        row++;
+      double class_logprob =
+          class_logprobs_[states_[state].expanded * num_classes + c];
+      int32 index = model_.label_to_index_[word] - model_.class_begin_[c];
+      int64 key = (static_cast<int64>(state) << 32) + word;
+      results_[key].second = model_.label_penalty_[word] +
+          (class_logprob + word_logprobs(row, index));
+    }
+  }
+
+  for (size_t i = 0; i < queries_.size(); i++) {
+    int32 state = queries_[i].first, word = queries_[i].second;
+    int64 key = (static_cast<int64>(state) << 32) + word;
+    results_[key].first =
+        (word == model_.Eos() ? -1 : NextState(state, word));
+  }
+  queries_.clear();
+}
+
+int32 RnnlmBatchedComputer::FindOrAddChild(int32 state, int32 word) {
+  int64 key = (static_cast<int64>(state) << 32) + word;
+  std::pair<unordered_map<int64, int32>::iterator, bool> result =
+      children_.insert(std::make_pair(key,
+                                      static_cast<int32>(states_.size())));
+  if (result.second)
+    states_.push_back(HistoryState(state, word, states_[state].length + 1,
+                                   states_[state].start));
+  return result.first->second;
+}
+
+int32 RnnlmBatchedComputer::NextState(int32 state, int32 word) {
+  KALDI_ASSERT(states_[state].expanded != -1);
+  int32 length = states_[state].length, next_state = states_[state].start;
+  if (max_history_length_ < 0 || length < max_history_length_) {
+    next_state = FindOrAddChild(state, word);
+  } else if (max_history_length_ > 0) {
+    // The first word of the history drops out, so we go down the trie from
+    // the empty history we started from.
+    words_.resize(length);
+    for (int32 s = state, i = length - 1; i >= 0; s = states_[s].parent, i--)
+      words_[i] = states_[s].word;
+    for (int32 i = 1; i < length; i++)
+      next_state = FindOrAddChild(next_state, words_[i]);
+    next_state = FindOrAddChild(next_state, word);
+  }
+  HistoryState &next = states_[next_state];
+  if (next.context == -1)
+    next.context = states_[state].expanded + 1;
+  return next_state;
+}
+
+void RnnlmBatchedComputer::GetHistory(int32 state,
+                                      std::vector<int32> *history) const {
+  history->assign(model_.direct_order_, 0);
+  for (int32 i = 0, s = state;
+       i < model_.direct_order_ && states_[s].length > 0;
+       i++, s = states_[s].parent)
+    (*history)[i] = model_.label_to_index_[states_[s].word];
+}
+
+void RnnlmBatchedComputer::AddDirect(const std::vector<int32> &history,
+                                     int32 c, double *scores) const {
+  // This follows CRnnLM::computeNet(), including the overflow in its
+  // unsigned-int arithmetic, which determines which weights are used.
+  using rnnlm::PRIMES;
+  using rnnlm::PRIMES_SIZE;
+  int32 order = model_.direct_order_;
+  int64 direct_size = model_.direct_size_;
+  if (direct_size <= 0)
+    return;
+  unsigned long long hash[rnnlm::MAX_NGRAM_ORDER];
+  for (int32 a = 0; a < order; a++)
+    hash[a] = 0;
+  for (int32 a = 0; a < order; a++) {
+    if (a > 0 && history[a - 1] == -1)
+      break;
+    if (c == -1)
+      hash[a] = PRIMES[0] * PRIMES[1];
+    else
+      hash[a] = PRIMES[0] * PRIMES[1] * static_cast<unsigned long long>(c + 1);
+    for (int32 b = 1; b <= a; b++)
+      hash[a] += PRIMES[(a * PRIMES[b] + b) % PRIMES_SIZE] *
+          static_cast<unsigned long long>(history[b - 1] + 1);
+    if (c == -1)
+      hash[a] = hash[a] % (direct_size / 2);
+    else
+      hash[a] = (hash[a] % (direct_size / 2)) + direct_size / 2;
+  }
+  int32 dim = (c == -1 ? model_.NumClasses() :
+               model_.class_begin_[c + 1] - model_.class_begin_[c]);
+  for (int32 i = 0; i < dim; i++) {
+    for (int32 b = 0; b < order && hash[b] != 0; b++) {
+      scores[i] += model_.direct_[hash[b]];
+      hash[b]++;
+      if (c != -1)
+        hash[b] = hash[b] % direct_size;
+    }
+  }
+}
+
+BaseFloat *RnnlmBatchedComputer::OutputInput(int32 state) {
+  int32 expanded = states_[state].expanded;
+  KALDI_ASSERT(expanded != -1);
+  if (model_.compression_.NumRows() > 0)
+    return &(compressed_[expanded * model_.compression_.NumRows()]);
+  else
+    return &(hidden_[(expanded + 1) * model_.HiddenDim()]);
+}
+
+void RnnlmBatchedComputer::ExpandStates(const std::vector<int32> &states) {
+  int32 num_states = states.size(), hidden_dim = model_.HiddenDim(),
+      num_classes = model_.NumClasses();
+  if (num_states == 0)
+    return;
+
+  // The hidden layer, from the previous hidden layer and the previous word.
+  Matrix<BaseFloat> context(num_states, hidden_dim, kUndefined),
+      hidden(num_states, hidden_dim, kUndefined);
+  for (int32 i = 0; i < num_states; i++) {
+    const HistoryState &state = states_[states[i]];
+    KALDI_ASSERT(state.context != -1 && state.expanded == -1);
+    context.Row(i).CopyFromVec(
+        SubVector<BaseFloat>(&(hidden_[state.context * hidden_dim]),
+                             hidden_dim));
+  }
+  hidden.AddMatMat(1.0, context, kNoTrans, model_.recurrent_, kTrans, 0.0);
+  for (int32 i = 0; i < num_states; i++) {
+    const HistoryState &state = states_[states[i]];
+    // The empty history is treated as following word 0, which is </s>.
+    int32 index = (state.length == 0 ? 0 :
+                   model_.label_to_index_[state.word]);
+    if (index != -1)
+      hidden.Row(i).AddVec(1.0, model_.input_.Row(index));
+  }
+  RnnlmSigmoid(&hidden);
+
+  int32 num_expanded = hidden_.size() / hidden_dim - 1;
+  for (int32 i = 0; i < num_states; i++) {
+    states_[states[i]].expanded = num_expanded + i;
+    hidden_.insert(hidden_.end(), hidden.RowData(i),
+                   hidden.RowData(i) + hidden_dim);
+  }
+
+  // The compression layer, if any, and the class log-probs.
+  const MatrixBase<BaseFloat> *output_input = &hidden;
+  Matrix<BaseFloat> compressed;
+  if (model_.compression_.NumRows() > 0) {
+    compressed.Resize(num_states, model_.compression_.NumRows(), kUndefined);
+    compressed.AddMatMat(1.0, hidden, kNoTrans,
+                         model_.compression_, kTrans, 0.0);
+    RnnlmSigmoid(&compressed);
+    for (int32 i = 0; i < num_states; i++)
+      compressed_.insert(compressed_.end(), compressed.RowData(i),
+                         compressed.RowData(i) + compressed.NumCols());
+    output_input = &compressed;
+  }
+  Matrix<BaseFloat> class_scores(num_states, num_classes, kUndefined);
+  class_scores.AddMatMat(1.0, *output_input, kNoTrans,
+                         model_.class_output_, kTrans, 0.0);
+  std::vector<double> scores(num_classes);
+  std::vector<int32> history;
+  for (int32 i = 0; i < num_states; i++) {
+    std::copy(class_scores.RowData(i), class_scores.RowData(i) + num_classes,
+              scores.begin());
+    GetHistory(states[i], &history);
+    AddDirect(history, -1, &(scores[0]));
+    RnnlmLogSoftmax(num_classes, &(scores[0]));
+    class_logprobs_.insert(class_logprobs_.end(), scores.begin(),
+                           scores.end());
+  }
+}
+
+void RnnlmBatchedComputer::ComputeClassWords(int32 c,
+                                             const std::vector<int32> &states,
+                                             Matrix<double> *logprobs) {
+  int32 num_states = states.size(), begin = model_.class_begin_[c],
+      num_words = model_.class_begin_[c + 1] - begin,
+      dim = model_.word_output_.NumCols();
+  KALDI_ASSERT(num_words > 0);
+  Matrix<BaseFloat> output_input(num_states, dim, kUndefined),
+      scores(num_states, num_words, kUndefined);
+  for (int32 i = 0; i < num_states; i++)
+    output_input.Row(i).CopyFromVec(
+        SubVector<BaseFloat>(OutputInput(states[i]), dim));
+  scores.AddMatMat(1.0, output_input, kNoTrans,
+                   model_.word_output_.RowRange(begin, num_words), kTrans, 0.0);
+  logprobs->Resize(num_states, num_words, kUndefined);
+  std::vector<int32> history;
+  for (int32 i = 0; i < num_states; i++) {
+    double *row = logprobs->RowData(i);
+    std::copy(scores.RowData(i), scores.RowData(i) + num_words, row);
+    GetHistory(states[i], &history);
+    AddDirect(history, c, row);
+    RnnlmLogSoftmax(num_words, row);
+  }
+}
+
+}  // namespace kaldi
@@ -0,0 +1,223 @@
+// lm/kaldi-rnnlm-batched.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_LM_KALDI_RNNLM_BATCHED_H_
+#define KALDI_LM_KALDI_RNNLM_BATCHED_H_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "lm/mikolov-rnnlm-lib.h"
+#include "matrix/matrix-lib.h"
+#include "util/stl-utils.h"
+
+namespace kaldi {
+
+/// RnnlmBatchedModel holds the weights of an RNNLM in the format of
+/// rnnlm::CRnnLM as matrices, so that the log-probabilities for many
+/// (history, word) pairs can be computed with matrix-matrix products; see
+/// RnnlmBatchedComputer.  It gives the same answers as
+/// CRnnLM::computeConditionalLogprob(), up to single-precision roundoff.
+/// Unlike CRnnLM it is not changed by computing log-probabilities, so one copy
+/// can be shared by several threads, each with its own RnnlmBatchedComputer.
+class RnnlmBatchedModel {
+ public:
+  /// <label_to_word> gives the word for each integer label that may be queried
+  /// (see KaldiRnnlmWrapper), and <eos> is the label of the end-of-sentence
+  /// symbol.  Words that are not in the RNNLM's vocabulary are treated as its
+  /// unknown-word symbol, with the penalties set in <rnnlm>.  The
+  /// direct-connection weights are not copied, so <rnnlm> must outlive this
+  /// object.
+  RnnlmBatchedModel(const rnnlm::CRnnLM &rnnlm,
+                    const std::vector<std::string> &label_to_word,
+                    int32 eos);
+
+  int32 HiddenDim() const { return recurrent_.NumRows(); }
+
+  int32 NumClasses() const { return class_output_.NumRows(); }
+
+  int32 NumLabels() const { return label_to_index_.size(); }
+
+  int32 Eos() const { return eos_; }
+
+ private:
+  friend class RnnlmBatchedComputer;
+
+  // For each label, its index in the RNNLM vocabulary after mapping unknown
+  // words to the unknown-word symbol; -1 if that is not in the vocabulary
+  // either.
+  std::vector<int32> label_to_index_;
+  // For each label, the log-prob added when predicting it; nonzero for words
+  // that are mapped to the unknown-word symbol.
+  std::vector<BaseFloat> label_penalty_;
+
+  // The class of each word in the vocabulary.
+  std::vector<int32> word_class_;
+  // The words of class c are class_begin_[c] ... class_begin_[c + 1] - 1.
+  std::vector<int32> class_begin_;
+
+  // Weights from the previous word to the hidden layer (vocab-size by
+  // hidden-dim).
+  Matrix<BaseFloat> input_;
+  // Weights from the previous hidden layer to the hidden layer.
+  Matrix<BaseFloat> recurrent_;
+  // Weights from the hidden layer to the compression layer; empty if there is
+  // no compression layer.
+  Matrix<BaseFloat> compression_;
+  // Weights from the hidden (or compression) layer to the classes and to the
+  // words.
+  Matrix<BaseFloat> class_output_;
+  Matrix<BaseFloat> word_output_;
+
+  // The direct (maximum entropy) weights, which belong to the CRnnLM.
+  const rnnlm::direct_t *direct_;
+  int64 direct_size_;
+  int32 direct_order_;
+
+  int32 eos_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(RnnlmBatchedModel);
+};
+
+/// RnnlmBatchedComputer computes RNNLM log-probabilities of words given their
+/// histories.  Queries are collected with AddQuery(), e.g. for all the arcs
+/// leaving a set of lattice states, and ComputeQueries() evaluates them
+/// together: the hidden layers of all the new histories with one matrix
+/// product, and the word probabilities with one matrix product per class.
+///
+/// Histories are identified by integer states; StartState() is the empty
+/// history, and GetLogProb() outputs the state reached by a word.  If
+/// max_ngram_order > 0, histories are truncated to their most recent
+/// max_ngram_order - 1 words, and histories that are the same after truncation
+/// share a state and the hidden layer of whichever of them was reached first,
+/// as in RnnlmDeterministicFst.  Histories are stored as a trie, so finding a
+/// state does not need vectors of words to be hashed.
+///
+/// AddStartState() adds other states for the empty history.  The histories
+/// reached from different start states never share a state, so the states
+/// reached from one start state (and their hidden layers) only depend on the
+/// queries made from it.  This is how several lattices can be rescored
+/// together with the same results as one at a time; only the matrix products
+/// are shared.
+///
+/// This class is not thread-safe; use one per thread.
+class RnnlmBatchedComputer {
+ public:
+  /// Does not take ownership of <model>.
+  RnnlmBatchedComputer(const RnnlmBatchedModel &model, int32 max_ngram_order);
+
+  int32 StartState() const { return 0; }
+
+  /// Adds a new state for the empty history and returns it; see above.
+  int32 AddStartState();
+
+  int32 Eos() const { return model_.Eos(); }
+
+  /// Adds a query for the log-prob of label <word> (which may be the
+  /// end-of-sentence label) after history state <state>, unless it has already
+  /// been added or computed.
+  void AddQuery(int32 state, int32 word);
+
+  /// Computes all the queries added since the last call.
+  void ComputeQueries();
+
+  /// Returns the log-prob of label <word> after history state <state>,
+  /// computing it first if it was not already computed.  If <next_state> is
+  /// not NULL, outputs the state of the history extended by <word>; this is
+  /// -1 for the end-of-sentence label.
+  BaseFloat GetLogProb(int32 state, int32 word, int32 *next_state);
+
+  int32 NumStates() const { return states_.size(); }
+
+ private:
+  struct HistoryState {
+    int32 parent;  // The state for this history without its last word; -1 for
+                   // the empty history.
+    int32 word;    // The last word (label) of the history.
+    int32 length;  // The number of words in the history.
+    int32 start;   // The start state that this history was reached from.
+    int32 context;  // The row of hidden_ that is the input from the previous
+                    // hidden layer; -1 if this history was only created as
+                    // part of the trie and not reached yet.
+    int32 expanded;  // The row of hidden_ (minus one), class_logprobs_ and
+                     // compressed_ for this history, once computed; else -1.
+    HistoryState(int32 parent, int32 word, int32 length, int32 start):
+        parent(parent), word(word), length(length), start(start),
+        context(-1), expanded(-1) { }
+  };
+
+  // Returns the trie child of <state> for <word>, creating it if necessary.
+  int32 FindOrAddChild(int32 state, int32 word);
+
+  // Returns the state for history <state> extended by <word> (after
+  // truncation), setting its context if it was not reached before.  <state>
+  // must have been expanded.
+  int32 NextState(int32 state, int32 word);
+
+  // Computes the hidden layer and the class log-probs for the listed states.
+  void ExpandStates(const std::vector<int32> &states);
+
+  // Computes the log-probs of the words of class <c> after each of the listed
+  // (expanded) states; row i of <logprobs> is for states[i].
+  void ComputeClassWords(int32 c, const std::vector<int32> &states,
+                         Matrix<double> *logprobs);
+
+  // Outputs the RNNLM indices of the most recent words of history <state>,
+  // most recent first, as used for the direct connections; words beyond the
+  // start of the history are 0.
+  void GetHistory(int32 state, std::vector<int32> *history) const;
+
+  // Adds the direct-connection weights for history <history> to the class
+  // scores (if c == -1) or to the scores of the words of class c.
+  void AddDirect(const std::vector<int32> &history, int32 c,
+                 double *scores) const;
+
+  // Returns a pointer to the input of the output layer (the compression layer,
+  // if any, else the hidden layer) for an expanded state.
+  BaseFloat *OutputInput(int32 state);
+
+  const RnnlmBatchedModel &model_;
+  int32 max_history_length_;  // -1 if unlimited.
+
+  std::vector<HistoryState> states_;
+  // Maps (state << 32) + word to the trie child.
+  unordered_map<int64, int32> children_;
+
+  // Rows of hidden-layer activations; row 0 is the initial context (all ones)
+  // and row i + 1 is for the state with expanded == i.
+  std::vector<BaseFloat> hidden_;
+  // Rows of compression-layer activations, if there is that layer.
+  std::vector<BaseFloat> compressed_;
+  // Rows of class log-probs, indexed by <expanded>.
+  std::vector<BaseFloat> class_logprobs_;
+
+  // Maps (state << 32) + word to the next state and the log-prob; the next
+  // state is -2 while the query is pending.
+  unordered_map<int64, std::pair<int32, BaseFloat> > results_;
+  std::vector<std::pair<int32, int32> > queries_;
+
+  // Temporary storage for NextState().
+  std::vector<int32> words_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(RnnlmBatchedComputer);
+};
+
+}  // namespace kaldi
+
+#endif  // KALDI_LM_KALDI_RNNLM_BATCHED_H_
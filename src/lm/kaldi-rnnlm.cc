@@ -137,4 +137,18 @@ bool RnnlmDeterministicFst::GetArc(StateId s, Label ilabel, fst::StdArc *oarc) {
   return true;
 }
 
+bool RnnlmBatchedDeterministicFst::GetArc(StateId s, Label ilabel,
+                                          fst::StdArc *oarc) {
+  int32 next_state;
+  BaseFloat logprob = computer_->GetLogProb(s, ilabel, &next_state);
+
+  // Creates the arc.
+  oarc->ilabel = ilabel;
+  oarc->olabel = ilabel;
+  oarc->nextstate = next_state;
+  oarc->weight = Weight(-logprob);
+
+  return true;
+}
+
 }  // namespace kaldi
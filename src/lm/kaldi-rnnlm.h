@@ -25,6 +25,7 @@
 
 #include "base/kaldi-common.h"
 #include "fstext/deterministic-fst.h"
+#include "lm/kaldi-rnnlm-batched.h"
 #include "lm/mikolov-rnnlm-lib.h"
 #include "util/common-utils.h"
 
@@ -55,6 +56,13 @@ class KaldiRnnlmWrapper {
 
   int32 GetEos() const { return eos_; }
 
+  // The model and the word for each label, e.g. to create an
+  // RnnlmBatchedModel.
+  const rnnlm::CRnnLM &GetRnnlm() const { return rnnlm_; }
+  const std::vector<std::string> &GetLabelToWord() const {
+    return label_to_word_;
+  }
+
   BaseFloat GetLogProb(int32 word, const std::vector<int32> &wseq,
                        const std::vector<float> &context_in,
                        std::vector<float> *context_out);
@@ -99,6 +107,102 @@ class RnnlmDeterministicFst
   std::vector<std::vector<float> > state_to_context_;
 };
 
+/// This is like RnnlmDeterministicFst, but it computes the log-probs with an
+/// RnnlmBatchedComputer, which several of these FSTs may share (e.g. one for
+/// each of a batch of lattices).  Each FST has its own start state in the
+/// computer, so its states and log-probs do not depend on the others.
+/// Prefetch() computes all the arcs that the compositions with a set of FSTs
+/// will need, in batches, before the compositions ask for them.
+class RnnlmBatchedDeterministicFst
+    : public fst::DeterministicOnDemandFst<fst::StdArc> {
+ public:
+  typedef fst::StdArc::Weight Weight;
+  typedef fst::StdArc::StateId StateId;
+  typedef fst::StdArc::Label Label;
+
+  // Does not take ownership.
+  explicit RnnlmBatchedDeterministicFst(RnnlmBatchedComputer *computer):
+      computer_(computer), start_state_(computer->AddStartState()) { }
+
+  virtual StateId Start() { return start_state_; }
+
+  virtual Weight Final(StateId s) {
+    return Weight(-computer_->GetLogProb(s, computer_->Eos(), NULL));
+  }
+
+  virtual bool GetArc(StateId s, Label ilabel, fst::StdArc* oarc);
+
+  /// Computes the arcs and final-probs that composing each of <fsts> with the
+  /// corresponding element of <lm_fsts> (matching their output labels, as
+  /// ComposeCompactLatticeDeterministic() does) will ask for.  The <lm_fsts>
+  /// must share one computer.  The composed states of all the pairs are
+  /// visited breadth-first, and the queries for each generation of states are
+  /// computed together.
+  template<class Arc>
+  static void Prefetch(
+      const std::vector<const fst::Fst<Arc>*> &fsts,
+      const std::vector<RnnlmBatchedDeterministicFst*> &lm_fsts);
+
+ private:
+  RnnlmBatchedComputer *computer_;
+  StateId start_state_;
+};
+
+template<class Arc>
+void RnnlmBatchedDeterministicFst::Prefetch(
+    const std::vector<const fst::Fst<Arc>*> &fsts,
+    const std::vector<RnnlmBatchedDeterministicFst*> &lm_fsts) {
+  typedef std::pair<StateId, StateId> StatePair;
+  typedef std::pair<size_t, StatePair> FstStatePair;
+  KALDI_ASSERT(fsts.size() == lm_fsts.size());
+  if (fsts.empty())
+    return;
+  RnnlmBatchedComputer *computer = lm_fsts[0]->computer_;
+  int32 eos = computer->Eos();
+  std::vector<unordered_set<StatePair, PairHasher<StateId> > > visited(
+      fsts.size());
+  std::vector<FstStatePair> frontier, next_frontier;
+  for (size_t i = 0; i < fsts.size(); i++) {
+    KALDI_ASSERT(lm_fsts[i]->computer_ == computer);
+    if (fsts[i]->Start() == fst::kNoStateId)
+      continue;
+    StatePair start_pair(fsts[i]->Start(), lm_fsts[i]->Start());
+    visited[i].insert(start_pair);
+    frontier.push_back(FstStatePair(i, start_pair));
+  }
+  while (!frontier.empty()) {
+    for (size_t j = 0; j < frontier.size(); j++) {
+      const fst::Fst<Arc> &fst = *(fsts[frontier[j].first]);
+      StateId s1 = frontier[j].second.first, s2 = frontier[j].second.second;
+      if (fst.Final(s1) != Arc::Weight::Zero())
+        computer->AddQuery(s2, eos);
+      for (fst::ArcIterator<fst::Fst<Arc> > aiter(fst, s1); !aiter.Done();
+           aiter.Next())
+        if (aiter.Value().olabel != 0)
+          computer->AddQuery(s2, aiter.Value().olabel);
+    }
+    computer->ComputeQueries();
+
+    next_frontier.clear();
+    for (size_t j = 0; j < frontier.size(); j++) {
+      size_t i = frontier[j].first;
+      StateId s2 = frontier[j].second.second;
+      for (fst::ArcIterator<fst::Fst<Arc> > aiter(*(fsts[i]),
+                                                  frontier[j].second.first);
+           !aiter.Done(); aiter.Next()) {
+        const Arc &arc = aiter.Value();
+        int32 next_state2 = s2;
+        if (arc.olabel != 0)
+          computer->GetLogProb(s2, arc.olabel, &next_state2);
+        StatePair next_pair(arc.nextstate, next_state2);
+        if (visited[i].insert(next_pair).second)
+          next_frontier.push_back(FstStatePair(i, next_pair));
+      }
+    }
+    frontier.swap(next_frontier);
+  }
+}
+
 }  // namespace kaldi
 
 #endif  // KALDI_LM_KALDI_RNNLM_H_
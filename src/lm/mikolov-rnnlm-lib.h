@@ -56,6 +56,10 @@
 #include <vector>
 #include "util/stl-utils.h"
 
+namespace kaldi {
+class RnnlmBatchedModel;
+}
+
 namespace rnnlm {
 
 #define MAX_STRING 100
@@ -186,6 +190,9 @@ class CRnnLM {
   unordered_map<std::string, float> unk_penalty;
   std::string unk_sym;
 
+  // Reads the weights, vocabulary and classes.
+  friend class kaldi::RnnlmBatchedModel;
+
  public:
 
   int alpha_set, train_file_set;
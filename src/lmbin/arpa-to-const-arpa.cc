@@ -38,6 +38,12 @@ int main(int argc, char *argv[]) {
         "format language model to integers using utils/map_arpa_m.pl, and\n"
         "then use this program to build a ConstArpaLm format language model.\n"
         "\n"
+        "With --quantize-bits=8 (or 16) the language model is written in a\n"
+        "compact trie format with quantized log-probs and backoffs, which\n"
+        "takes about a third of the memory (or half, with 16 bits) at about the\n"
+        "same speed; programs that read ConstArpaLm format language models\n"
+        "read it the same way.\n"
+        "\n"
         "Usage: arpa-to-const-arpa [opts] <input-arpa> <const-arpa>\n"
         " e.g.: arpa-to-const-arpa --bos-symbol=1 --eos-symbol=2 \\\n"
         "                          arpa.txt const_arpa";
@@ -46,6 +52,7 @@ int main(int argc, char *argv[]) {
 
     ArpaParseOptions options;
     options.Register(&po);
+    int32 quantize_bits = 0;
 
     // Ideally, these registrations would be in ArpaParseOptions, but some
     // programs want integers and other want symbols, so we register them
@@ -59,6 +66,10 @@ int main(int argc, char *argv[]) {
     po.Register("eos-symbol", &options.eos_symbol,
                 "Integer corresponds to </s>. You must set this to your actual "
                 "EOS integer.");
+    po.Register("quantize-bits", &quantize_bits, "If nonzero, write the "
+                "language model in the quantized trie format, with this many "
+                "bits (from 2 to 16, e.g. 8 or 16) for the log-probs and "
+                "backoffs of the orders above unigrams.");
 
     po.Read(argc, argv);
 
@@ -76,7 +87,7 @@ int main(int argc, char *argv[]) {
         const_arpa_wxfilename = po.GetOptArg(2);
 
     bool ans = BuildConstArpaLm(options, arpa_rxfilename,
-                                const_arpa_wxfilename);
+                                const_arpa_wxfilename, quantize_bits);
     if (ans)
       return 0;
     else
@@ -0,0 +1,70 @@
+// lmbin/const-arpa-copy.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABILITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+
+#include "lm/const-arpa-lm.h"
+#include "util/parse-options.h"
+
+int main(int argc, char *argv[]) {
+  using namespace kaldi;
+  typedef kaldi::int32 int32;
+  try {
+    const char *usage  =
+        "Copies a ConstArpaLm format language model.  By default the output\n"
+        "is written in the aligned format, which programs that read the\n"
+        "language model with ConstArpaLm::ReadMapped() (e.g.\n"
+        "lattice-lmrescore-const-arpa) memory-map instead of reading, so it\n"
+        "is loaded almost instantly and shared between processes.  The\n"
+        "output must be a file, not a pipe.  Use --aligned=false to convert\n"
+        "back to the format that older versions of the code can read.\n"
+        "\n"
+        "Usage: const-arpa-copy [opts] <const-arpa-in> <const-arpa-out>\n"
+        " e.g.: const-arpa-copy data/lang_test_fg/G.carpa G_aligned.carpa\n";
+
+    kaldi::ParseOptions po(usage);
+
+    bool aligned = true;
+    po.Register("aligned", &aligned, "If true, write the language model in "
+                "the aligned format that can be memory-mapped.");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 2) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string lm_rxfilename = po.GetArg(1),
+        lm_wxfilename = po.GetArg(2);
+
+    ConstArpaLm const_arpa;
+    ReadKaldiObject(lm_rxfilename, &const_arpa);
+
+    bool binary = true;
+    Output ko(lm_wxfilename, binary);
+    const_arpa.Write(ko.Stream(), binary, aligned);
+    ko.Close();
+
+    KALDI_LOG << "Copied language model from " << lm_rxfilename << " to "
+              << lm_wxfilename << (aligned ? " (aligned)" : "");
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what() << '\n';
+    return -1;
+  }
+}
@@ -0,0 +1,213 @@
+// matrix/array-math-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cfloat>
+#include <limits>
+
+#include "base/timer.h"
+#include "matrix/array-math.h"
+#include "matrix/matrix-lib.h"
+
+namespace kaldi {
+
+// Checks the float ExpArray() on a fine grid over the whole range where the
+// answer is a normal number, against the double-precision exp() and the bound
+// in array-math.h.
+static void UnitTestExpArrayAccuracy() {
+  int32 n = 1000000;
+  std::vector<float> x(n), y(n);
+  for (int32 i = 0; i < n; i++)
+    x[i] = -87.3f + (88.7f + 87.3f) * i / (n - 1);
+  ExpArray(&(x[0]), n, &(y[0]));
+  double max_rel_error = 0.0;
+  for (int32 i = 0; i < n; i++) {
+    double ref = exp(static_cast<double>(x[i]));
+    max_rel_error = std::max(max_rel_error, std::abs(y[i] - ref) / ref);
+  }
+  KALDI_LOG << "Maximum relative error of ExpArray() is " << max_rel_error;
+  KALDI_ASSERT(max_rel_error < 1.2e-07);
+
+  const float inf = std::numeric_limits<float>::infinity();
+  float special[6] = { -inf, inf, -100.0f, 0.0f, 89.0f,
+                       std::numeric_limits<float>::quiet_NaN() };
+  ExpArray(special, 6, special);
+  KALDI_ASSERT(special[0] == 0.0f && special[1] == inf &&
+               special[2] == 0.0f && special[3] == 1.0f &&
+               special[4] == inf && KALDI_ISNAN(special[5]));
+}
+
+// Checks the float LogArray() on numbers spread over the whole range of
+// normal floats, against the bound in array-math.h.
+static void UnitTestLogArrayAccuracy() {
+  int32 n = 1000000;
+  std::vector<float> x(n), y(n);
+  for (int32 i = 0; i < n; i++) {
+    // Alternate between numbers close to one and numbers over the whole range.
+    if (i % 2 == 0)
+      x[i] = 0.5f + 1.5f * i / n;
+    else
+      x[i] = exp(-87.0 + 175.0 * i / n);
+  }
+  LogArray(&(x[0]), n, &(y[0]));
+  double max_error = 0.0;
+  for (int32 i = 0; i < n; i++) {
+    double ref = log(static_cast<double>(x[i])),
+        error = std::abs(y[i] - ref) / (std::abs(ref) * 1.0e-07 + 5.0e-08);
+    max_error = std::max(max_error, error);
+  }
+  KALDI_LOG << "Maximum error of LogArray(), relative to the bound, is "
+            << max_error;
+  KALDI_ASSERT(max_error < 1.0);
+
+  const float inf = std::numeric_limits<float>::infinity();
+  float special[6] = { 0.0f, -1.0f, inf, 1.0f, FLT_MIN / 16.0f,
+                       std::numeric_limits<float>::quiet_NaN() };
+  LogArray(special, 6, special);
+  KALDI_ASSERT(special[0] == -inf && KALDI_ISNAN(special[1]) &&
+               special[2] == inf && special[3] == 0.0f &&
+               std::abs(special[4] - log(FLT_MIN / 16.0)) < 1.0e-04 &&
+               KALDI_ISNAN(special[5]));
+}
+
+// Checks that the results don't depend on the length of the array or the
+// position in it (the last few elements are done separately), and that
+// in-place operation works.
+static void UnitTestArrayLengths() {
+  for (int32 n = 0; n < 20; n++) {
+    Vector<float> x(n), y(n), z(n), w(n);
+    x.SetRandn();
+    x.Scale(10.0);
+    for (int32 i = 0; i < n; i++) {
+      ExpArray(x.Data() + i, 1, y.Data() + i);
+      SigmoidArray(x.Data() + i, 1, w.Data() + i);
+    }
+    z.CopyFromVec(x);
+    ExpArray(z.Data(), n, z.Data());
+    AssertEqual(y, z, 1.0e-06);
+    z.CopyFromVec(x);
+    SigmoidArray(z.Data(), n, z.Data());
+    AssertEqual(w, z, 1.0e-06);
+    x.ApplyAbs();
+    for (int32 i = 0; i < n; i++)
+      LogArray(x.Data() + i, 1, y.Data() + i);
+    LogArray(x.Data(), n, z.Data());
+    AssertEqual(y, z, 1.0e-06);
+  }
+}
+
+static void UnitTestSumExpArray() {
+  for (int32 i = 0; i < 10; i++) {
+    int32 n = Rand() % 1000;
+    Vector<float> x(n);
+    x.SetRandn();
+    x.Scale(5.0);
+    float offset = RandGauss(), cutoff = RandGauss();
+    double sum = 0.0;
+    for (int32 j = 0; j < n; j++)
+      if (x(j) >= cutoff)
+        sum += exp(static_cast<double>(x(j) + offset));
+    double sum2 = SumExpArray(x.Data(), n, offset, cutoff);
+    KALDI_ASSERT(std::abs(sum - sum2) <= 1.0e-06 * sum);
+  }
+}
+
+template<typename Real>
+static void UnitTestSigmoidTanhArray() {
+  int32 n = 10000;
+  Vector<Real> x(n), y(n), z(n);
+  x.SetRandn();
+  x.Scale(10.0);
+  SigmoidArray(x.Data(), n, y.Data());
+  TanhArray(x.Data(), n, z.Data());
+  for (int32 i = 0; i < n; i++) {
+    double f = x(i);
+    KALDI_ASSERT(std::abs(y(i) - 1.0 / (1.0 + exp(-f))) < 1.0e-06);
+    KALDI_ASSERT(std::abs(z(i) - tanh(f)) < 1.0e-06);
+  }
+}
+
+// Double precision uses exp() and log() directly.
+static void UnitTestDoubleArray() {
+  int32 n = 100;
+  Vector<double> x(n), y(n);
+  x.SetRandn();
+  x.Scale(10.0);
+  ExpArray(x.Data(), n, y.Data());
+  for (int32 i = 0; i < n; i++)
+    KALDI_ASSERT(y(i) == exp(x(i)));
+  LogArray(y.Data(), n, y.Data());
+  for (int32 i = 0; i < n; i++)
+    KALDI_ASSERT(y(i) == log(exp(x(i))));
+}
+
+// Prints the time that "func" takes per element, compared with calling "ref"
+// for each element.
+static void TestArraySpeed(const std::string &name,
+                           void (*func)(const float*, MatrixIndexT, float*),
+                           float (*ref)(float), float min, float max) {
+  int32 n = 1000;
+  Vector<float> x(n), y(n);
+  for (int32 i = 0; i < n; i++)
+    x(i) = min + (max - min) * RandUniform();
+  double times[2];
+  for (int32 k = 0; k < 2; k++) {
+    int32 num_iters = 0;
+    Timer timer;
+    do {
+      for (int32 i = 0; i < 100; i++) {
+        if (k == 0) {
+          func(x.Data(), n, y.Data());
+        } else {
+          const float *x_data = x.Data();
+          float *y_data = y.Data();
+          for (int32 j = 0; j < n; j++)
+            y_data[j] = ref(x_data[j]);
+        }
+      }
+      num_iters += 100;
+    } while (timer.Elapsed() < 0.1);
+    times[k] = 1.0e+09 * timer.Elapsed() / (static_cast<double>(num_iters) * n);
+  }
+  KALDI_LOG << name << ": " << times[0] << " ns per element, vs. "
+            << times[1] << " for libm; speedup is " << (times[1] / times[0]);
+}
+
+static float LibmExp(float x) { return expf(x); }
+static float LibmLog(float x) { return logf(x); }
+static float LibmTanh(float x) { return tanhf(x); }
+
+static void TestArraySpeeds() {
+  TestArraySpeed("ExpArray", ExpArray, LibmExp, -20.0, 20.0);
+  TestArraySpeed("LogArray", LogArray, LibmLog, 1.0e-10, 100.0);
+  TestArraySpeed("TanhArray", TanhArray, LibmTanh, -5.0, 5.0);
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  UnitTestExpArrayAccuracy();
+  UnitTestLogArrayAccuracy();
+  UnitTestArrayLengths();
+  UnitTestSumExpArray();
+  UnitTestSigmoidTanhArray<float>();
+  UnitTestSigmoidTanhArray<double>();
+  UnitTestDoubleArray();
+  TestArraySpeeds();
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
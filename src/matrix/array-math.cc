@@ -0,0 +1,300 @@
+// matrix/array-math.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define KALDI_ARRAY_MATH_SSE2 1
+#endif
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <limits>
+
+#include "base/kaldi-math.h"
+#include "matrix/array-math.h"
+
+namespace kaldi {
+
+// The constants of the approximations to expf() and logf() from the Cephes
+// library.  kExpMax is a bit less than log(FLT_MAX), so that 2^n in the exp
+// computation is always representable; kExpMin is log(FLT_MIN).
+static const float kExpMax = 88.0f, kExpMin = -87.3365447504f,
+    kLog2e = 1.44269504088896341f, kLn2Hi = 0.693359375f,
+    kLn2Lo = -2.12194440e-4f, kSqrtHalf = 0.707106781186547524f;
+static const float kExpCoeffs[6] = { 1.9875691500e-4f, 1.3981999507e-3f,
+                                     8.3334519073e-3f, 4.1665795894e-2f,
+                                     1.6666665459e-1f, 5.0000001201e-1f };
+static const float kLogCoeffs[9] = { 7.0376836292e-2f, -1.1514610310e-1f,
+                                     1.1676998740e-1f, -1.2420140846e-1f,
+                                     1.4249322787e-1f, -1.6668057665e-1f,
+                                     2.0000714765e-1f, -2.4999993993e-1f,
+                                     3.3333331174e-1f };
+
+// The elements are processed in blocks of this size by the functions that
+// need temporary storage.
+static const MatrixIndexT kBlockSize = 256;
+
+static inline float FloatFromBits(int32 i) {
+  float f;
+  memcpy(&f, &i, sizeof(f));
+  return f;
+}
+
+static inline int32 BitsFromFloat(float f) {
+  int32 i;
+  memcpy(&i, &f, sizeof(i));
+  return i;
+}
+
+// Scalar version of the exp approximation.
+static inline float ExpFloat(float x) {
+  if (!(x <= kExpMax))  // overflow, or NaN.
+    return Exp(x);
+  if (x < kExpMin)
+    return 0.0f;
+  float fn = std::floor(x * kLog2e + 0.5f);
+  float r = x - fn * kLn2Hi - fn * kLn2Lo, p = kExpCoeffs[0];
+  for (int32 i = 1; i < 6; i++)
+    p = p * r + kExpCoeffs[i];
+  p = p * r * r + r + 1.0f;
+  return p * FloatFromBits((static_cast<int32>(fn) + 127) << 23);
+}
+
+// Scalar version of the log approximation.
+static inline float LogFloat(float x) {
+  if (!(x >= FLT_MIN && x <= FLT_MAX))  // zero, negative, denormal, inf, NaN.
+    return Log(x);
+  int32 bits = BitsFromFloat(x);
+  float e = static_cast<float>((bits >> 23) - 126),
+      m = FloatFromBits((bits & 0x007fffff) | 0x3f000000);  // in [0.5, 1).
+  if (m < kSqrtHalf) {
+    e -= 1.0f;
+    m = m + m - 1.0f;
+  } else {
+    m = m - 1.0f;
+  }
+  float z = m * m, y = kLogCoeffs[0];
+  for (int32 i = 1; i < 9; i++)
+    y = y * m + kLogCoeffs[i];
+  y = y * m * z + e * kLn2Lo - 0.5f * z;
+  return m + y + e * kLn2Hi;
+}
+
+#ifdef KALDI_ARRAY_MATH_SSE2
+// Computes the exp approximation for 4 elements; they must not be NaN or
+// greater than kExpMax.
+static inline __m128 ExpSse(__m128 x) {
+  __m128 underflow = _mm_cmplt_ps(x, _mm_set1_ps(kExpMin));
+  x = _mm_max_ps(x, _mm_set1_ps(kExpMin));
+  __m128i n = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(kLog2e)));
+  __m128 fn = _mm_cvtepi32_ps(n);
+  __m128 r = _mm_sub_ps(_mm_sub_ps(x, _mm_mul_ps(fn, _mm_set1_ps(kLn2Hi))),
+                        _mm_mul_ps(fn, _mm_set1_ps(kLn2Lo)));
+  __m128 p = _mm_set1_ps(kExpCoeffs[0]);
+  for (int32 i = 1; i < 6; i++)
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(kExpCoeffs[i]));
+  p = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(p, r), r),
+                 _mm_add_ps(r, _mm_set1_ps(1.0f)));
+  __m128 pow2n = _mm_castsi128_ps(
+      _mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)), 23));
+  return _mm_andnot_ps(underflow, _mm_mul_ps(p, pow2n));
+}
+
+// Computes the log approximation for 4 elements; they must be normal,
+// positive and finite.
+static inline __m128 LogSse(__m128 x) {
+  __m128i bits = _mm_castps_si128(x);
+  __m128 e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23),
+                                           _mm_set1_epi32(126)));
+  __m128 m = _mm_castsi128_ps(
+      _mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)),
+                   _mm_set1_epi32(0x3f000000)));
+  __m128 one = _mm_set1_ps(1.0f),
+      small = _mm_cmplt_ps(m, _mm_set1_ps(kSqrtHalf));
+  e = _mm_sub_ps(e, _mm_and_ps(one, small));
+  m = _mm_add_ps(_mm_sub_ps(m, one), _mm_and_ps(m, small));
+  __m128 z = _mm_mul_ps(m, m), y = _mm_set1_ps(kLogCoeffs[0]);
+  for (int32 i = 1; i < 9; i++)
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(kLogCoeffs[i]));
+  y = _mm_mul_ps(_mm_mul_ps(y, m), z);
+  y = _mm_add_ps(y, _mm_mul_ps(e, _mm_set1_ps(kLn2Lo)));
+  y = _mm_sub_ps(y, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+  return _mm_add_ps(_mm_add_ps(m, y), _mm_mul_ps(e, _mm_set1_ps(kLn2Hi)));
+}
+
+// Does exp for 4 elements, handling special cases.
+static inline void ExpBlock4(const float *x, float *y) {
+  __m128 v = _mm_loadu_ps(x);
+  __m128 special = _mm_or_ps(_mm_cmpgt_ps(v, _mm_set1_ps(kExpMax)),
+                             _mm_cmpunord_ps(v, v));
+  if (_mm_movemask_ps(special) == 0) {
+    _mm_storeu_ps(y, ExpSse(v));
+  } else {
+    for (int32 i = 0; i < 4; i++)
+      y[i] = ExpFloat(x[i]);
+  }
+}
+
+// Does log for 4 elements, handling special cases.
+static inline void LogBlock4(const float *x, float *y) {
+  __m128 v = _mm_loadu_ps(x);
+  __m128 special = _mm_or_ps(_mm_cmpnge_ps(v, _mm_set1_ps(FLT_MIN)),
+                             _mm_cmpgt_ps(v, _mm_set1_ps(FLT_MAX)));
+  if (_mm_movemask_ps(special) == 0) {
+    _mm_storeu_ps(y, LogSse(v));
+  } else {
+    for (int32 i = 0; i < 4; i++)
+      y[i] = LogFloat(x[i]);
+  }
+}
+#endif  // KALDI_ARRAY_MATH_SSE2
+
+void ExpArray(const float *x, MatrixIndexT n, float *y) {
+  MatrixIndexT i = 0;
+#ifdef KALDI_ARRAY_MATH_SSE2
+  for (; i + 4 <= n; i += 4)
+    ExpBlock4(x + i, y + i);
+  if (i < n) {  // Do the remaining elements the same way, for consistency.
+    float buf[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    std::copy(x + i, x + n, buf);
+    ExpBlock4(buf, buf);
+    std::copy(buf, buf + (n - i), y + i);
+    return;
+  }
+#endif
+  for (; i < n; i++)
+    y[i] = ExpFloat(x[i]);
+}
+
+void ExpArray(const double *x, MatrixIndexT n, double *y) {
+  for (MatrixIndexT i = 0; i < n; i++)
+    y[i] = Exp(x[i]);
+}
+
+void LogArray(const float *x, MatrixIndexT n, float *y) {
+  MatrixIndexT i = 0;
+#ifdef KALDI_ARRAY_MATH_SSE2
+  for (; i + 4 <= n; i += 4)
+    LogBlock4(x + i, y + i);
+  if (i < n) {
+    float buf[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    std::copy(x + i, x + n, buf);
+    LogBlock4(buf, buf);
+    std::copy(buf, buf + (n - i), y + i);
+    return;
+  }
+#endif
+  for (; i < n; i++)
+    y[i] = LogFloat(x[i]);
+}
+
+void LogArray(const double *x, MatrixIndexT n, double *y) {
+  for (MatrixIndexT i = 0; i < n; i++)
+    y[i] = Log(x[i]);
+}
+
+double SumExpArray(const float *x, MatrixIndexT n, float offset,
+                   float cutoff) {
+  const float neg_inf = -std::numeric_limits<float>::infinity();
+  float buf[kBlockSize];
+  double sum = 0.0;
+  for (MatrixIndexT start = 0; start < n; start += kBlockSize) {
+    MatrixIndexT block_size = std::min(kBlockSize, n - start);
+    const float *this_x = x + start;
+    for (MatrixIndexT i = 0; i < block_size; i++)
+      buf[i] = (this_x[i] >= cutoff ? this_x[i] + offset : neg_inf);
+    ExpArray(buf, block_size, buf);
+    float block_sum = 0.0f;
+    for (MatrixIndexT i = 0; i < block_size; i++)
+      block_sum += buf[i];
+    sum += block_sum;
+  }
+  return sum;
+}
+
+double SumExpArray(const double *x, MatrixIndexT n, double offset,
+                   double cutoff) {
+  double sum = 0.0;
+  for (MatrixIndexT i = 0; i < n; i++)
+    if (x[i] >= cutoff)
+      sum += Exp(x[i] + offset);
+  return sum;
+}
+
+void SigmoidArray(const float *x, MatrixIndexT n, float *y) {
+  // We use exp(-|x|), which cannot overflow.
+  float buf[kBlockSize];
+  for (MatrixIndexT start = 0; start < n; start += kBlockSize) {
+    MatrixIndexT block_size = std::min(kBlockSize, n - start);
+    const float *this_x = x + start;
+    float *this_y = y + start;
+    for (MatrixIndexT i = 0; i < block_size; i++)
+      buf[i] = -std::abs(this_x[i]);
+    ExpArray(buf, block_size, buf);
+    for (MatrixIndexT i = 0; i < block_size; i++) {
+      float e = buf[i], inv = 1.0f / (1.0f + e);
+      this_y[i] = (this_x[i] > 0.0f ? inv : e * inv);
+    }
+  }
+}
+
+void SigmoidArray(const double *x, MatrixIndexT n, double *y) {
+  for (MatrixIndexT i = 0; i < n; i++) {
+    double f = x[i];
+    // We aim to avoid floating-point overflow here.
+    if (f > 0.0) {
+      f = 1.0 / (1.0 + Exp(-f));
+    } else {
+      double ex = Exp(f);
+      f = ex / (ex + 1.0);
+    }
+    y[i] = f;
+  }
+}
+
+void TanhArray(const float *x, MatrixIndexT n, float *y) {
+  // tanh(x) = (1 - exp(-2|x|)) / (1 + exp(-2|x|)), with the sign of x.
+  float buf[kBlockSize];
+  for (MatrixIndexT start = 0; start < n; start += kBlockSize) {
+    MatrixIndexT block_size = std::min(kBlockSize, n - start);
+    const float *this_x = x + start;
+    float *this_y = y + start;
+    for (MatrixIndexT i = 0; i < block_size; i++)
+      buf[i] = -2.0f * std::abs(this_x[i]);
+    ExpArray(buf, block_size, buf);
+    for (MatrixIndexT i = 0; i < block_size; i++) {
+      float e = buf[i], t = (1.0f - e) / (1.0f + e);
+      this_y[i] = (this_x[i] > 0.0f ? t : -t);
+    }
+  }
+}
+
+void TanhArray(const double *x, MatrixIndexT n, double *y) {
+  for (MatrixIndexT i = 0; i < n; i++) {
+    double f = x[i];
+    if (f > 0.0) {
+      double inv_expx = Exp(-f);
+      f = -1.0 + 2.0 / (1.0 + inv_expx * inv_expx);
+    } else {
+      double inv_expx = Exp(f);
+      f = 1.0 - 2.0 / (1.0 + inv_expx * inv_expx);
+    }
+    y[i] = f;
+  }
+}
+
+}  // namespace kaldi
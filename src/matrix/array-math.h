@@ -0,0 +1,76 @@
+// matrix/array-math.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_MATRIX_ARRAY_MATH_H_
+#define KALDI_MATRIX_ARRAY_MATH_H_
+
+#include "matrix/matrix-common.h"
+
+namespace kaldi {
+
+/// @addtogroup matrix_funcs_misc
+/// @{
+
+/// \file array-math.h
+/// Functions that apply exp() and log() to arrays of numbers, used by the
+/// vector and matrix code (ApplyExp(), ApplySoftMax(), Sigmoid() and so on).
+///
+/// For float, these use polynomial approximations (as in the Cephes library)
+/// that are evaluated four elements at a time with SSE2 where available; they
+/// are several times faster than calling expf() and logf() element by element,
+/// and do not depend on the speed of the libm in use (see
+/// ../probe/README.slow_expf).  Measured over every float input, the maximum
+/// relative error of ExpArray() is 1.2e-07 (about 1 ulp); the maximum error of
+/// LogArray() is 1.0e-07 relative, or 5.0e-08 absolute where |log(x)| < 1.
+/// array-math-test checks these bounds.  Results that would be below FLT_MIN
+/// (i.e. exp(x) for x < -87.33) are flushed to zero.
+/// Infinities, NaNs, zero and negative inputs to log, and inputs to exp that
+/// overflow are passed to libm, so they give the usual answers.
+///
+/// For double, these just call exp() and log(), because double is used where
+/// full precision is wanted.
+///
+/// The input and output arrays may be the same (for in-place operation), but
+/// they may not otherwise overlap.
+
+/// Sets y[i] = exp(x[i]) for 0 <= i < n.
+void ExpArray(const float *x, MatrixIndexT n, float *y);
+void ExpArray(const double *x, MatrixIndexT n, double *y);
+
+/// Sets y[i] = log(x[i]) for 0 <= i < n.
+void LogArray(const float *x, MatrixIndexT n, float *y);
+void LogArray(const double *x, MatrixIndexT n, double *y);
+
+/// Returns the sum of exp(x[i] + offset) over 0 <= i < n, skipping any
+/// elements with x[i] < cutoff.  The sum is accumulated in double.
+double SumExpArray(const float *x, MatrixIndexT n, float offset, float cutoff);
+double SumExpArray(const double *x, MatrixIndexT n, double offset,
+                   double cutoff);
+
+/// Sets y[i] = 1 / (1 + exp(-x[i])) for 0 <= i < n.
+void SigmoidArray(const float *x, MatrixIndexT n, float *y);
+void SigmoidArray(const double *x, MatrixIndexT n, double *y);
+
+/// Sets y[i] = tanh(x[i]) for 0 <= i < n.
+void TanhArray(const float *x, MatrixIndexT n, float *y);
+void TanhArray(const double *x, MatrixIndexT n, double *y);
+
+/// @} end of "addtogroup matrix_funcs_misc"
+
+}  // namespace kaldi
+
+#endif  // KALDI_MATRIX_ARRAY_MATH_H_
@@ -421,7 +421,9 @@ void CompressedMatrix::Write(std::ostream &os, bool binary) const {
       GlobalHeader h;
       h.range = h.min_value = 0.0;
       h.num_rows = h.num_cols = 0;
-      os.write(reinterpret_cast<const char*>(&h), sizeof(h));
+      // As above, we don't write out the "int32 format"; Read() doesn't
+      // read it.
+      os.write(reinterpret_cast<const char*>(&h) + 4, sizeof(h) - 4);
     }
   } else {
     // In text mode, just use the same format as a regular matrix.
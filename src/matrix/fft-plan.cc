@@ -0,0 +1,86 @@
+// matrix/fft-plan.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "matrix/fft-plan.h"
+#include "matrix/matrix-functions.h"
+#include "matrix/mixed-radix-fft.h"
+#include "matrix/srfft.h"
+
+namespace kaldi {
+
+// RealFftPlan for SplitRadixRealFft.
+template<typename Real>
+class SplitRadixRealFftPlan: public RealFftPlan<Real> {
+ public:
+  explicit SplitRadixRealFftPlan(MatrixIndexT N): N_(N), srfft_(N) { }
+  virtual MatrixIndexT Dim() const { return N_; }
+  virtual void Compute(Real *x, bool forward,
+                       std::vector<Real> *temp_buffer) const {
+    srfft_.Compute(x, forward, temp_buffer);
+  }
+  virtual void ComputeRows(Real *data, MatrixIndexT num_rows,
+                           MatrixIndexT stride,
+                           std::vector<Real> *temp_buffer) const {
+    srfft_.ComputeRows(data, num_rows, stride, temp_buffer);
+  }
+ private:
+  MatrixIndexT N_;
+  SplitRadixRealFft<Real> srfft_;
+};
+
+// RealFftPlan for the function RealFft().
+template<typename Real>
+class GenericRealFftPlan: public RealFftPlan<Real> {
+ public:
+  explicit GenericRealFftPlan(MatrixIndexT N): N_(N) { }
+  virtual MatrixIndexT Dim() const { return N_; }
+  virtual void Compute(Real *x, bool forward,
+                       std::vector<Real> *temp_buffer) const {
+    SubVector<Real> v(x, N_);
+    RealFft(&v, forward);
+  }
+ private:
+  MatrixIndexT N_;
+};
+
+template<typename Real>
+RealFftPlan<Real> *NewRealFftPlan(const std::string &type, MatrixIndexT N) {
+  if (N < 2 || N % 2 != 0)
+    KALDI_ERR << "Real FFT needs an even number of points, got " << N;
+  bool power_of_two = ((N & (N - 1)) == 0);
+  if (type == "split-radix" || (type == "default" && power_of_two && N >= 4)) {
+    if (!power_of_two || N < 4)
+      KALDI_ERR << "Split-radix FFT needs a power of two >= 4, got " << N
+                << " (try --fft-type=mixed-radix)";
+    return new SplitRadixRealFftPlan<Real>(N);
+  } else if (type == "mixed-radix" || type == "default") {
+    return new MixedRadixRealFft<Real>(N);
+  } else if (type == "generic") {
+    return new GenericRealFftPlan<Real>(N);
+  } else {
+    KALDI_ERR << "Invalid FFT type " << type << ", expected split-radix, "
+              << "mixed-radix, generic or default";
+    return NULL;  // Suppress compiler warning.
+  }
+}
+
+template
+RealFftPlan<float> *NewRealFftPlan(const std::string &type, MatrixIndexT N);
+template
+RealFftPlan<double> *NewRealFftPlan(const std::string &type, MatrixIndexT N);
+
+}  // namespace kaldi
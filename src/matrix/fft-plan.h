@@ -0,0 +1,80 @@
+// matrix/fft-plan.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_MATRIX_FFT_PLAN_H_
+#define KALDI_MATRIX_FFT_PLAN_H_
+
+#include <string>
+#include <vector>
+
+#include "matrix/matrix-common.h"
+
+namespace kaldi {
+
+/// @addtogroup matrix_funcs_misc
+/// @{
+
+/// RealFftPlan is the interface to the classes that compute the Fourier
+/// transform of N real points, for a fixed N.  Their constructors precompute
+/// what they need (e.g. tables of twiddle factors), and Compute() is const, so
+/// one object can be shared by all the threads that need an FFT of that size;
+/// each thread just needs its own temporary buffer.  Use NewRealFftPlan() to
+/// choose the implementation at runtime.
+template<typename Real>
+class RealFftPlan {
+ public:
+  /// Returns N, the number of real points.
+  virtual MatrixIndexT Dim() const = 0;
+
+  /// If forward == true, this function transforms the N real points in "x" to
+  /// their complex Fourier transform, in the same format as SplitRadixRealFft
+  /// and RealFft() use: [real0, real_{N/2}, real1, im1, real2, im2, ...].
+  /// Otherwise it goes in the reverse direction, without the 1/N factor.
+  /// "temp_buffer" is used as temporary storage, and is resized if needed.
+  virtual void Compute(Real *x, bool forward,
+                       std::vector<Real> *temp_buffer) const = 0;
+
+  /// Does the forward transform of each of the "num_rows" rows of "data",
+  /// which start "stride" elements apart, as Compute(row, true, temp_buffer)
+  /// would.  This calls Compute() for each row; implementations that can do
+  /// many rows at once faster (e.g. with SIMD instructions across the rows)
+  /// override it.
+  virtual void ComputeRows(Real *data, MatrixIndexT num_rows,
+                           MatrixIndexT stride,
+                           std::vector<Real> *temp_buffer) const {
+    for (MatrixIndexT r = 0; r < num_rows; r++)
+      Compute(data + r * stride, true, temp_buffer);
+  }
+
+  virtual ~RealFftPlan() { }
+};
+
+/// Returns a newly allocated RealFftPlan for N real points (N must be even),
+/// which the caller must delete.  "type" says which implementation to use:
+///  - "split-radix": SplitRadixRealFft, from srfft.h; N must be a power of two.
+///  - "mixed-radix": MixedRadixRealFft, from mixed-radix-fft.h; any even N.
+///  - "generic": the function RealFft() from matrix-functions.h; any even N,
+///    but slow, so it is mostly useful for testing.
+///  - "default": "split-radix" if N is a power of two, else "mixed-radix".
+template<typename Real>
+RealFftPlan<Real> *NewRealFftPlan(const std::string &type, MatrixIndexT N);
+
+/// @} end of "addtogroup matrix_funcs_misc"
+
+}  // namespace kaldi
+
+#endif  // KALDI_MATRIX_FFT_PLAN_H_
@@ -0,0 +1,99 @@
+// matrix/fft-speed-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "matrix/matrix-lib.h"
+#include "base/timer.h"
+
+namespace kaldi {
+
+// Prints the time that the FFT of type "type" takes for "N" points, in
+// microseconds per FFT.
+template<typename Real>
+static void TestFftSpeed(const std::string &type, MatrixIndexT N) {
+  RealFftPlan<Real> *plan = NewRealFftPlan<Real>(type, N);
+  Vector<Real> v(N);
+  v.SetRandn();
+  std::vector<Real> temp_buffer;
+  // Keep going for at least 0.1 seconds, so the time is accurate enough.
+  int32 num_ffts = 0;
+  Timer timer;
+  double elapsed;
+  do {
+    for (int32 i = 0; i < 100; i++)
+      plan->Compute(v.Data(), (i % 2 == 0), &temp_buffer);
+    num_ffts += 100;
+    elapsed = timer.Elapsed();
+  } while (elapsed < 0.1);
+  KALDI_LOG << "FFT type " << type << (sizeof(Real) == 4 ? " <float>" :
+                                      " <double>")
+            << ", N = " << N << ": " << (1.0e+06 * elapsed / num_ffts)
+            << " microseconds per FFT.";
+  delete plan;
+}
+
+// As TestFftSpeed(), for ComputeRows() on 64 rows (e.g. the frames of a batch
+// in feature extraction), in microseconds per row.
+template<typename Real>
+static void TestFftRowsSpeed(const std::string &type, MatrixIndexT N) {
+  RealFftPlan<Real> *plan = NewRealFftPlan<Real>(type, N);
+  MatrixIndexT num_rows = 64;
+  Matrix<Real> m(num_rows, N);
+  m.SetRandn();
+  std::vector<Real> temp_buffer;
+  int32 num_ffts = 0;
+  Timer timer;
+  double elapsed;
+  do {
+    for (int32 i = 0; i < 10; i++) {
+      plan->ComputeRows(m.Data(), num_rows, m.Stride(), &temp_buffer);
+      m.Scale(1.0 / N);  // Keeps the data from overflowing.
+    }
+    num_ffts += 10 * num_rows;
+    elapsed = timer.Elapsed();
+  } while (elapsed < 0.1);
+  KALDI_LOG << "FFT type " << type << (sizeof(Real) == 4 ? " <float>" :
+                                      " <double>")
+            << ", N = " << N << ", " << num_rows << " rows at once: "
+            << (1.0e+06 * elapsed / num_ffts) << " microseconds per FFT.";
+  delete plan;
+}
+
+template<typename Real>
+static void TestFftSpeeds() {
+  // 400 samples is a 25ms window at 16kHz, which is normally padded to 512 for
+  // the split-radix FFT; 200 is the same at 8kHz.
+  MatrixIndexT sizes[] = { 200, 256, 400, 512, 1024 };
+  for (int32 i = 0; i < 5; i++) {
+    MatrixIndexT N = sizes[i];
+    if ((N & (N - 1)) == 0) {
+      TestFftSpeed<Real>("split-radix", N);
+      TestFftRowsSpeed<Real>("split-radix", N);
+    }
+    TestFftSpeed<Real>("mixed-radix", N);
+    TestFftSpeed<Real>("generic", N);
+  }
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  TestFftSpeeds<float>();
+  TestFftSpeeds<double>();
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
@@ -20,6 +20,7 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include "matrix/array-math.h"
 #include "matrix/kaldi-matrix.h"
 #include "matrix/sp-matrix.h"
 #include "matrix/jama-svd.h"
@@ -2497,13 +2498,9 @@ Real MatrixBase<Real>::LogSumExp(Real prune) const {
 
   double sum_relto_max_elem = 0.0;
 
-  for (MatrixIndexT i = 0; i < num_rows_; i++) {
-    for (MatrixIndexT j = 0; j < num_cols_; j++) {
-      BaseFloat f = (*this)(i, j);
-      if (f >= cutoff)
-        sum_relto_max_elem += Exp(f - max_elem);
-    }
-  }
+  for (MatrixIndexT i = 0; i < num_rows_; i++)
+    sum_relto_max_elem += SumExpArray(RowData(i), num_cols_, -max_elem,
+                                      cutoff);
   return max_elem + Log(sum_relto_max_elem);
 }
 
@@ -2511,9 +2508,11 @@ template<typename Real>
 Real MatrixBase<Real>::ApplySoftMax() {
   Real max = this->Max(), sum = 0.0;
   // the 'max' helps to get in good numeric range.
-  for (MatrixIndexT i = 0; i < num_rows_; i++)
-    for (MatrixIndexT j = 0; j < num_cols_; j++)
-      sum += ((*this)(i, j) = Exp((*this)(i, j) - max));
+  this->Add(-max);
+  for (MatrixIndexT i = 0; i < num_rows_; i++) {
+    ExpArray(RowData(i), num_cols_, RowData(i));
+    sum += Row(i).Sum();
+  }
   this->Scale(1.0 / sum);
   return max + Log(sum);
 }
@@ -23,7 +23,9 @@
 // limitations under the License.
 
 #include <algorithm>
+#include <limits>
 #include <string>
+#include "matrix/array-math.h"
 #include "matrix/cblas-wrappers.h"
 #include "matrix/kaldi-vector.h"
 #include "matrix/kaldi-matrix.h"
@@ -752,13 +754,7 @@ Real VectorBase<Real>::LogSumExp(Real prune) const {
   if (prune > 0.0 && max_elem - prune > cutoff) // explicit pruning...
     cutoff = max_elem - prune;
 
-  double sum_relto_max_elem = 0.0;
-
-  for (MatrixIndexT i = 0; i < dim_; i++) {
-    BaseFloat f = data_[i];
-    if (f >= cutoff)
-      sum_relto_max_elem += Exp(f - max_elem);
-  }
+  double sum_relto_max_elem = SumExpArray(data_, dim_, -max_elem, cutoff);
   return max_elem + Log(sum_relto_max_elem);
 }
 
@@ -774,23 +770,19 @@ void VectorBase<Real>::ApplyLog() {
   for (MatrixIndexT i = 0; i < dim_; i++) {
     if (data_[i] < 0.0)
       KALDI_ERR << "Trying to take log of a negative number.";
-    data_[i] = Log(data_[i]);
   }
+  LogArray(data_, dim_, data_);
 }
 
 template<typename Real>
 void VectorBase<Real>::ApplyLogAndCopy(const VectorBase<Real> &v) {
   KALDI_ASSERT(dim_ == v.Dim());
-  for (MatrixIndexT i = 0; i < dim_; i++) {
-    data_[i] = Log(v(i));
-  }
+  LogArray(v.Data(), dim_, data_);
 }
 
 template<typename Real>
 void VectorBase<Real>::ApplyExp() {
-  for (MatrixIndexT i = 0; i < dim_; i++) {
-    data_[i] = Exp(data_[i]);
-  }
+  ExpArray(data_, dim_, data_);
 }
 
 template<typename Real>
@@ -838,21 +830,20 @@ MatrixIndexT VectorBase<Real>::ApplyFloor(const VectorBase<Real> &floor_vec) {
 
 template<typename Real>
 Real VectorBase<Real>::ApplySoftMax() {
-  Real max = this->Max(), sum = 0.0;
-  for (MatrixIndexT i = 0; i < dim_; i++) {
-    sum += (data_[i] = Exp(data_[i] - max));
-  }
+  Real max = this->Max();
+  this->Add(-max);
+  ExpArray(data_, dim_, data_);
+  Real sum = this->Sum();
   this->Scale(1.0 / sum);
   return max + Log(sum);
 }
 
 template<typename Real>
 Real VectorBase<Real>::ApplyLogSoftMax() {
-  Real max = this->Max(), sum = 0.0;
-  for (MatrixIndexT i = 0; i < dim_; i++) {
-    sum += Exp((data_[i] -= max));
-  }
-  sum = Log(sum);
+  Real max = this->Max();
+  this->Add(-max);
+  Real sum = Log(SumExpArray(data_, dim_, static_cast<Real>(0.0),
+                             -std::numeric_limits<Real>::infinity()));
   this->Add(-1.0 * sum);
   return max + sum;
 }
@@ -872,17 +863,7 @@ void VectorBase<double>::Tanh(const VectorBase<double> &src) {
 template<typename Real>
 void VectorBase<Real>::Tanh(const VectorBase<Real> &src) {
   KALDI_ASSERT(dim_ == src.dim_);
-  for (MatrixIndexT i = 0; i < dim_; i++) {
-    Real x = src.data_[i];
-    if (x > 0.0) {
-      Real inv_expx = Exp(-x);
-      x = -1.0 + 2.0 / (1.0 + inv_expx * inv_expx);
-    } else {
-      Real inv_expx = Exp(x);
-      x = 1.0 - 2.0 / (1.0 + inv_expx * inv_expx);
-    }
-    data_[i] = x;
-  }
+  TanhArray(src.data_, dim_, data_);
 }
 #endif
 
@@ -910,17 +891,7 @@ void VectorBase<double>::Sigmoid(const VectorBase<double> &src) {
 template<typename Real>
 void VectorBase<Real>::Sigmoid(const VectorBase<Real> &src) {
   KALDI_ASSERT(dim_ == src.dim_);
-  for (MatrixIndexT i = 0; i < dim_; i++) {
-    Real x = src.data_[i];
-    // We aim to avoid floating-point overflow here.
-    if (x > 0.0) {
-      x = 1.0 / (1.0 + Exp(-x));
-    } else {
-      Real ex = Exp(x);
-      x = ex / (ex + 1.0);
-    }
-    data_[i] = x;
-  }
+  SigmoidArray(src.data_, dim_, data_);
 }
 #endif
 
@@ -4129,6 +4129,20 @@ template<typename Real> static void UnitTestCompressedMatrix() {
   CompressedMatrix empty_cmat;  // some tests on empty matrix
   KALDI_ASSERT(empty_cmat.NumRows() == 0);
   KALDI_ASSERT(empty_cmat.NumCols() == 0);
+  {
+    // Reading an empty matrix should consume exactly what was written, so
+    // that what follows it (e.g. in an archive) can be read.
+    std::ostringstream os;
+    empty_cmat.Write(os, true);
+    WriteBasicType(os, true, static_cast<int32>(17));
+    std::istringstream is(os.str());
+    CompressedMatrix empty_cmat2;
+    empty_cmat2.Read(is, true);
+    KALDI_ASSERT(empty_cmat2.NumRows() == 0);
+    int32 i;
+    ReadBasicType(is, true, &i);
+    KALDI_ASSERT(i == 17);
+  }
 
   // could set num_tot to 10000 for more thorough testing.
   MatrixIndexT num_failure = 0, num_tot = 10000, max_failure = 1;
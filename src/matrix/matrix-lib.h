@@ -30,6 +30,8 @@
 #include "matrix/tp-matrix.h"
 #include "matrix/matrix-functions.h"
 #include "matrix/srfft.h"
+#include "matrix/fft-plan.h"
+#include "matrix/mixed-radix-fft.h"
 #include "matrix/compressed-matrix.h"
 #include "matrix/sparse-matrix.h"
 #include "matrix/optimization.h"
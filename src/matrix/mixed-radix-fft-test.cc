@@ -0,0 +1,128 @@
+// matrix/mixed-radix-fft-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "matrix/matrix-lib.h"
+
+namespace kaldi {
+
+// Returns a random size: mostly small, with various factors, sometimes
+// typical window sizes.
+static MatrixIndexT RandomFftSize() {
+  const MatrixIndexT typical_sizes[] = { 200, 256, 400, 512, 600, 1000 };
+  if (Rand() % 4 == 0)
+    return typical_sizes[Rand() % 6];
+  return 1 + Rand() % 100;
+}
+
+template<typename Real>
+static void UnitTestMixedRadixComplexFft() {
+  for (int32 i = 0; i < 50; i++) {
+    MatrixIndexT N = RandomFftSize();
+    bool forward = (Rand() % 2 == 0);
+    Vector<Real> v(N * 2), v2(N * 2);
+    v.SetRandn();
+    ComplexFt(v, &v2, forward);  // the simple O(N^2) version.
+    MixedRadixComplexFft<Real> fft(N);
+    std::vector<Real> temp_buffer;
+    fft.Compute(v.Data(), forward, &temp_buffer);
+    AssertEqual(v, v2, 1.0e-03);
+  }
+}
+
+template<typename Real>
+static void UnitTestMixedRadixRealFft() {
+  for (int32 i = 0; i < 50; i++) {
+    MatrixIndexT N = 2 * RandomFftSize();
+    Vector<Real> v(N), v2(N), v3(N);
+    v.SetRandn();
+    v2.CopyFromVec(v);
+    v3.CopyFromVec(v);
+    MixedRadixRealFft<Real> fft(N);
+    KALDI_ASSERT(fft.Dim() == N);
+    std::vector<Real> temp_buffer;
+    fft.Compute(v.Data(), true, &temp_buffer);
+    RealFftInefficient(&v2, true);
+    AssertEqual(v, v2, 1.0e-03);
+    // Check that the inverse gets us back to the start.
+    fft.Compute(v.Data(), false, &temp_buffer);
+    v.Scale(1.0 / N);
+    AssertEqual(v, v3, 1.0e-03);
+  }
+}
+
+template<typename Real>
+static void UnitTestNewRealFftPlan() {
+  const char *types[] = { "default", "mixed-radix", "generic", "split-radix" };
+  for (int32 i = 0; i < 20; i++) {
+    MatrixIndexT N = (Rand() % 2 == 0 ? 2 * RandomFftSize() :
+                      (4 << (Rand() % 8)));
+    bool power_of_two = ((N & (N - 1)) == 0 && N >= 4);
+    Vector<Real> v(N);
+    v.SetRandn();
+    Vector<Real> ref(v);
+    RealFftInefficient(&ref, true);
+    for (int32 t = 0; t < (power_of_two ? 4 : 3); t++) {
+      RealFftPlan<Real> *plan = NewRealFftPlan<Real>(types[t], N);
+      KALDI_ASSERT(plan->Dim() == N);
+      Vector<Real> w(v);
+      std::vector<Real> temp_buffer;
+      plan->Compute(w.Data(), true, &temp_buffer);
+      AssertEqual(w, ref, 1.0e-03);
+      delete plan;
+    }
+  }
+}
+
+// Checks that ComputeRows() gives the same results as Compute() for each row.
+template<typename Real>
+static void UnitTestRealFftPlanRows() {
+  const char *types[] = { "default", "mixed-radix", "generic", "split-radix" };
+  for (int32 i = 0; i < 20; i++) {
+    MatrixIndexT N = (Rand() % 2 == 0 ? 2 * RandomFftSize() :
+                      (4 << (Rand() % 8))),
+        num_rows = 1 + Rand() % 40;
+    bool power_of_two = ((N & (N - 1)) == 0 && N >= 4);
+    Matrix<Real> m(num_rows, N);
+    m.SetRandn();
+    for (int32 t = 0; t < (power_of_two ? 4 : 3); t++) {
+      RealFftPlan<Real> *plan = NewRealFftPlan<Real>(types[t], N);
+      Matrix<Real> m1(m), m2(m);
+      std::vector<Real> temp_buffer;
+      plan->ComputeRows(m1.Data(), num_rows, m1.Stride(), &temp_buffer);
+      for (MatrixIndexT r = 0; r < num_rows; r++)
+        plan->Compute(m2.RowData(r), true, &temp_buffer);
+      AssertEqual(m1, m2, 1.0e-05);
+      delete plan;
+    }
+  }
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  UnitTestMixedRadixComplexFft<float>();
+  UnitTestMixedRadixComplexFft<double>();
+  UnitTestMixedRadixRealFft<float>();
+  UnitTestMixedRadixRealFft<double>();
+  UnitTestNewRealFftPlan<float>();
+  UnitTestNewRealFftPlan<double>();
+  UnitTestRealFftPlanRows<float>();
+  UnitTestRealFftPlanRows<double>();
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
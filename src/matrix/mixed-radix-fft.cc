@@ -0,0 +1,369 @@
+// matrix/mixed-radix-fft.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cmath>
+
+#include "matrix/mixed-radix-fft.h"
+#include "matrix/matrix-functions.h"
+
+namespace kaldi {
+
+template<typename Real>
+MixedRadixComplexFft<Real>::MixedRadixComplexFft(MatrixIndexT N): N_(N) {
+  KALDI_ASSERT(N >= 1);
+  // Factor N, taking out the factors of 4 first, since the radix-4 passes are
+  // the most efficient.
+  std::vector<MatrixIndexT> radices;
+  MatrixIndexT n = N;
+  while (n % 4 == 0) {
+    radices.push_back(4);
+    n /= 4;
+  }
+  if (n % 2 == 0) {
+    radices.push_back(2);
+    n /= 2;
+  }
+  for (MatrixIndexT p = 3; n > 1; p += 2) {
+    if (p * p > n)  // n is prime.
+      p = n;
+    while (n % p == 0) {
+      radices.push_back(p);
+      n /= p;
+    }
+  }
+
+  passes_.resize(radices.size());
+  MatrixIndexT stride = 1;
+  n = N;
+  for (size_t i = 0; i < radices.size(); i++) {
+    Pass &pass = passes_[i];
+    MatrixIndexT radix = radices[i], size = n / radix;
+    pass.radix = radix;
+    pass.size = size;
+    pass.stride = stride;
+    pass.twiddle_re.resize(size * (radix - 1));
+    pass.twiddle_im.resize(size * (radix - 1));
+    for (MatrixIndexT p = 0; p < size; p++) {
+      for (MatrixIndexT k = 1; k < radix; k++) {
+        // We compute the angles in double precision and reduce p * k modulo n
+        // first, for accuracy.
+        double angle = -M_2PI * ((p * k) % n) / n;
+        pass.twiddle_re[p * (radix - 1) + k - 1] = std::cos(angle);
+        pass.twiddle_im[p * (radix - 1) + k - 1] = std::sin(angle);
+      }
+    }
+    if (radix > 5) {
+      pass.root_re.resize(radix);
+      pass.root_im.resize(radix);
+      for (MatrixIndexT k = 0; k < radix; k++) {
+        double angle = -M_2PI * k / radix;
+        pass.root_re[k] = std::cos(angle);
+        pass.root_im[k] = std::sin(angle);
+      }
+    }
+    n = size;
+    stride *= radix;
+  }
+}
+
+template<typename Real>
+void MixedRadixComplexFft<Real>::ComputePass(const Pass &pass,
+                                             const Real *xr, const Real *xi,
+                                             Real *yr, Real *yi) {
+  const MatrixIndexT radix = pass.radix, size = pass.size, s = pass.stride;
+  const Real *twr = &(pass.twiddle_re[0]), *twi = &(pass.twiddle_im[0]);
+  if (radix == 2) {
+    for (MatrixIndexT p = 0; p < size; p++) {
+      const Real w1r = twr[p], w1i = twi[p];
+      const Real *ar = xr + s * p, *ai = xi + s * p,
+          *br = xr + s * (p + size), *bi = xi + s * (p + size);
+      Real *y0r = yr + s * 2 * p, *y0i = yi + s * 2 * p,
+          *y1r = y0r + s, *y1i = y0i + s;
+      for (MatrixIndexT q = 0; q < s; q++) {
+        Real dr = ar[q] - br[q], di = ai[q] - bi[q];
+        y0r[q] = ar[q] + br[q];
+        y0i[q] = ai[q] + bi[q];
+        y1r[q] = dr * w1r - di * w1i;
+        y1i[q] = dr * w1i + di * w1r;
+      }
+    }
+  } else if (radix == 4) {
+    for (MatrixIndexT p = 0; p < size; p++) {
+      const Real w1r = twr[3 * p], w1i = twi[3 * p],
+          w2r = twr[3 * p + 1], w2i = twi[3 * p + 1],
+          w3r = twr[3 * p + 2], w3i = twi[3 * p + 2];
+      const Real *a0r = xr + s * p, *a0i = xi + s * p,
+          *a1r = a0r + s * size, *a1i = a0i + s * size,
+          *a2r = a1r + s * size, *a2i = a1i + s * size,
+          *a3r = a2r + s * size, *a3i = a2i + s * size;
+      Real *y0r = yr + s * 4 * p, *y0i = yi + s * 4 * p,
+          *y1r = y0r + s, *y1i = y0i + s,
+          *y2r = y1r + s, *y2i = y1i + s,
+          *y3r = y2r + s, *y3i = y2i + s;
+      for (MatrixIndexT q = 0; q < s; q++) {
+        // t3 is (a1 - a3) times -i.
+        Real t0r = a0r[q] + a2r[q], t0i = a0i[q] + a2i[q],
+            t1r = a0r[q] - a2r[q], t1i = a0i[q] - a2i[q],
+            t2r = a1r[q] + a3r[q], t2i = a1i[q] + a3i[q],
+            t3r = a1i[q] - a3i[q], t3i = a3r[q] - a1r[q];
+        y0r[q] = t0r + t2r;
+        y0i[q] = t0i + t2i;
+        Real ur = t1r + t3r, ui = t1i + t3i;
+        y1r[q] = ur * w1r - ui * w1i;
+        y1i[q] = ur * w1i + ui * w1r;
+        ur = t0r - t2r;
+        ui = t0i - t2i;
+        y2r[q] = ur * w2r - ui * w2i;
+        y2i[q] = ur * w2i + ui * w2r;
+        ur = t1r - t3r;
+        ui = t1i - t3i;
+        y3r[q] = ur * w3r - ui * w3i;
+        y3i[q] = ur * w3i + ui * w3r;
+      }
+    }
+  } else if (radix == 3) {
+    const Real sin60 = std::sqrt(0.75);
+    for (MatrixIndexT p = 0; p < size; p++) {
+      const Real w1r = twr[2 * p], w1i = twi[2 * p],
+          w2r = twr[2 * p + 1], w2i = twi[2 * p + 1];
+      const Real *a0r = xr + s * p, *a0i = xi + s * p,
+          *a1r = a0r + s * size, *a1i = a0i + s * size,
+          *a2r = a1r + s * size, *a2i = a1i + s * size;
+      Real *y0r = yr + s * 3 * p, *y0i = yi + s * 3 * p,
+          *y1r = y0r + s, *y1i = y0i + s,
+          *y2r = y1r + s, *y2i = y1i + s;
+      for (MatrixIndexT q = 0; q < s; q++) {
+        // t3 is (a1 - a2) times -i sin(60 degrees).
+        Real t1r = a1r[q] + a2r[q], t1i = a1i[q] + a2i[q],
+            t2r = a0r[q] - 0.5 * t1r, t2i = a0i[q] - 0.5 * t1i,
+            t3r = sin60 * (a1i[q] - a2i[q]), t3i = sin60 * (a2r[q] - a1r[q]);
+        y0r[q] = a0r[q] + t1r;
+        y0i[q] = a0i[q] + t1i;
+        Real ur = t2r + t3r, ui = t2i + t3i;
+        y1r[q] = ur * w1r - ui * w1i;
+        y1i[q] = ur * w1i + ui * w1r;
+        ur = t2r - t3r;
+        ui = t2i - t3i;
+        y2r[q] = ur * w2r - ui * w2i;
+        y2i[q] = ur * w2i + ui * w2r;
+      }
+    }
+  } else if (radix == 5) {
+    const Real c1 = std::cos(M_2PI / 5), c2 = std::cos(2 * M_2PI / 5),
+        s1 = std::sin(M_2PI / 5), s2 = std::sin(2 * M_2PI / 5);
+    for (MatrixIndexT p = 0; p < size; p++) {
+      const Real *w = twr + 4 * p, *wi = twi + 4 * p;
+      const Real *a0r = xr + s * p, *a0i = xi + s * p,
+          *a1r = a0r + s * size, *a1i = a0i + s * size,
+          *a2r = a1r + s * size, *a2i = a1i + s * size,
+          *a3r = a2r + s * size, *a3i = a2i + s * size,
+          *a4r = a3r + s * size, *a4i = a3i + s * size;
+      Real *y0r = yr + s * 5 * p, *y0i = yi + s * 5 * p,
+          *y1r = y0r + s, *y1i = y0i + s,
+          *y2r = y1r + s, *y2i = y1i + s,
+          *y3r = y2r + s, *y3i = y2i + s,
+          *y4r = y3r + s, *y4i = y3i + s;
+      for (MatrixIndexT q = 0; q < s; q++) {
+        Real b1r = a1r[q] + a4r[q], b1i = a1i[q] + a4i[q],
+            b2r = a2r[q] + a3r[q], b2i = a2i[q] + a3i[q],
+            d1r = a1r[q] - a4r[q], d1i = a1i[q] - a4i[q],
+            d2r = a2r[q] - a3r[q], d2i = a2i[q] - a3i[q];
+        y0r[q] = a0r[q] + b1r + b2r;
+        y0i[q] = a0i[q] + b1i + b2i;
+        // Outputs 1 and 4 are e1 -/+ i f1; outputs 2 and 3 are e2 -/+ i f2.
+        Real e1r = a0r[q] + c1 * b1r + c2 * b2r,
+            e1i = a0i[q] + c1 * b1i + c2 * b2i,
+            e2r = a0r[q] + c2 * b1r + c1 * b2r,
+            e2i = a0i[q] + c2 * b1i + c1 * b2i,
+            f1r = s1 * d1r + s2 * d2r, f1i = s1 * d1i + s2 * d2i,
+            f2r = s2 * d1r - s1 * d2r, f2i = s2 * d1i - s1 * d2i;
+        Real ur = e1r + f1i, ui = e1i - f1r;
+        y1r[q] = ur * w[0] - ui * wi[0];
+        y1i[q] = ur * wi[0] + ui * w[0];
+        ur = e2r + f2i;
+        ui = e2i - f2r;
+        y2r[q] = ur * w[1] - ui * wi[1];
+        y2i[q] = ur * wi[1] + ui * w[1];
+        ur = e2r - f2i;
+        ui = e2i + f2r;
+        y3r[q] = ur * w[2] - ui * wi[2];
+        y3i[q] = ur * wi[2] + ui * w[2];
+        ur = e1r - f1i;
+        ui = e1i + f1r;
+        y4r[q] = ur * w[3] - ui * wi[3];
+        y4i[q] = ur * wi[3] + ui * w[3];
+      }
+    }
+  } else {
+    // General radix: output k is the sum over j of input j times
+    // root^(j k), and then times the twiddle factor.
+    const Real *rootr = &(pass.root_re[0]), *rooti = &(pass.root_im[0]);
+    for (MatrixIndexT p = 0; p < size; p++) {
+      for (MatrixIndexT k = 0; k < radix; k++) {
+        Real *ykr = yr + s * (radix * p + k), *yki = yi + s * (radix * p + k);
+        const Real *a0r = xr + s * p, *a0i = xi + s * p;
+        for (MatrixIndexT q = 0; q < s; q++) {
+          ykr[q] = a0r[q];
+          yki[q] = a0i[q];
+        }
+        for (MatrixIndexT j = 1; j < radix; j++) {
+          const Real cr = rootr[(j * k) % radix], ci = rooti[(j * k) % radix];
+          const Real *ajr = xr + s * (p + j * size),
+              *aji = xi + s * (p + j * size);
+          for (MatrixIndexT q = 0; q < s; q++) {
+            ykr[q] += ajr[q] * cr - aji[q] * ci;
+            yki[q] += ajr[q] * ci + aji[q] * cr;
+          }
+        }
+        if (k != 0) {
+          const Real wr = twr[p * (radix - 1) + k - 1],
+              wi = twi[p * (radix - 1) + k - 1];
+          for (MatrixIndexT q = 0; q < s; q++) {
+            Real ur = ykr[q], ui = yki[q];
+            ykr[q] = ur * wr - ui * wi;
+            yki[q] = ur * wi + ui * wr;
+          }
+        }
+      }
+    }
+  }
+}
+
+template<typename Real>
+void MixedRadixComplexFft<Real>::ComputeSplit(Real *xr, Real *xi,
+                                              Real *yr, Real *yi,
+                                              bool forward) const {
+  MatrixIndexT N = N_;
+  // The inverse FFT is the conjugate of the forward FFT of the conjugate.
+  if (!forward)
+    for (MatrixIndexT i = 0; i < N; i++)
+      xi[i] = -xi[i];
+  for (size_t i = 0; i < passes_.size(); i++) {
+    ComputePass(passes_[i], xr, xi, yr, yi);
+    std::swap(xr, yr);
+    std::swap(xi, yi);
+  }
+  // Now the output is in (xr, xi), but these may have been swapped with
+  // (yr, yi) an odd number of times.
+  if (passes_.size() % 2 == 1) {
+    std::swap(xr, yr);
+    std::swap(xi, yi);
+    for (MatrixIndexT i = 0; i < N; i++) {
+      xr[i] = yr[i];
+      xi[i] = (forward ? yi[i] : -yi[i]);
+    }
+  } else if (!forward) {
+    for (MatrixIndexT i = 0; i < N; i++)
+      xi[i] = -xi[i];
+  }
+}
+
+template<typename Real>
+void MixedRadixComplexFft<Real>::Compute(Real *x, bool forward,
+                                         std::vector<Real> *temp_buffer) const {
+  MatrixIndexT N = N_;
+  if (temp_buffer->size() < static_cast<size_t>(4 * N))
+    temp_buffer->resize(4 * N);
+  Real *xr = &((*temp_buffer)[0]), *xi = xr + N, *yr = xi + N, *yi = yr + N;
+  for (MatrixIndexT i = 0; i < N; i++) {
+    xr[i] = x[2 * i];
+    xi[i] = x[2 * i + 1];
+  }
+  ComputeSplit(xr, xi, yr, yi, forward);
+  for (MatrixIndexT i = 0; i < N; i++) {
+    x[2 * i] = xr[i];
+    x[2 * i + 1] = xi[i];
+  }
+}
+
+
+template<typename Real>
+MixedRadixRealFft<Real>::MixedRadixRealFft(MatrixIndexT N):
+    N_(N), complex_fft_(N / 2) {
+  KALDI_ASSERT(N >= 2 && N % 2 == 0);
+  MatrixIndexT N4 = N / 4;
+  cos_table_.resize(N4);
+  sin_table_.resize(N4);
+  for (MatrixIndexT k = 1; k <= N4; k++) {
+    double angle = M_2PI * k / N;
+    cos_table_[k - 1] = std::cos(angle);
+    sin_table_[k - 1] = std::sin(angle);
+  }
+}
+
+// This is the same computation as SplitRadixRealFft<Real>::Compute(), except
+// that the factors exp(-2 pi i k / N) are taken from a table.
+template<typename Real>
+void MixedRadixRealFft<Real>::Compute(Real *data, bool forward,
+                                      std::vector<Real> *temp_buffer) const {
+  MatrixIndexT N = N_, N2 = N / 2;
+  if (forward)
+    complex_fft_.Compute(data, true, temp_buffer);
+
+  for (MatrixIndexT k = 1; 2 * k <= N2; k++) {
+    // kN is exp(-2pik/N) for the forward transform, and -exp(2pik/N) for the
+    // backward one.
+    Real kN_re = (forward ? cos_table_[k - 1] : -cos_table_[k - 1]),
+        kN_im = -sin_table_[k - 1];
+
+    Real Ck_re, Ck_im, Dk_re, Dk_im;
+    // C_k = 1/2 (B_k + B_{N/2 - k}^*) :
+    Ck_re = 0.5 * (data[2*k] + data[N - 2*k]);
+    Ck_im = 0.5 * (data[2*k + 1] - data[N - 2*k + 1]);
+    // re(D_k)= 1/2 (im(B_k) + im(B_{N/2-k})):
+    Dk_re = 0.5 * (data[2*k + 1] + data[N - 2*k + 1]);
+    // im(D_k) = -1/2 (re(B_k) - re(B_{N/2-k}))
+    Dk_im =-0.5 * (data[2*k] - data[N - 2*k]);
+    // A_k = C_k + 1^(k/N) D_k:
+    data[2*k] = Ck_re;
+    data[2*k+1] = Ck_im;
+    ComplexAddProduct(Dk_re, Dk_im, kN_re, kN_im,
+                      &(data[2*k]), &(data[2*k+1]));
+
+    MatrixIndexT kdash = N2 - k;
+    if (kdash != k) {
+      // See the comments in srfft.cc.
+      data[2*kdash] = Ck_re;
+      data[2*kdash+1] = -Ck_im;
+      ComplexAddProduct(Dk_re, -Dk_im, -kN_re, kN_im,
+                        &(data[2*kdash]), &(data[2*kdash+1]));
+    }
+  }
+
+  {  // Now handle k = 0.
+    Real zeroth = data[0] + data[1],
+        n2th = data[0] - data[1];
+    data[0] = zeroth;
+    data[1] = n2th;
+    if (!forward) {
+      data[0] /= 2;
+      data[1] /= 2;
+    }
+  }
+  if (!forward) {
+    complex_fft_.Compute(data, false, temp_buffer);
+    for (MatrixIndexT i = 0; i < N; i++)
+      data[i] *= 2.0;
+  }
+}
+
+template class MixedRadixComplexFft<float>;
+template class MixedRadixComplexFft<double>;
+template class MixedRadixRealFft<float>;
+template class MixedRadixRealFft<double>;
+
+}  // namespace kaldi
@@ -0,0 +1,106 @@
+// matrix/mixed-radix-fft.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_MATRIX_MIXED_RADIX_FFT_H_
+#define KALDI_MATRIX_MIXED_RADIX_FFT_H_
+
+#include <vector>
+
+#include "matrix/fft-plan.h"
+
+namespace kaldi {
+
+/// MixedRadixComplexFft computes the FFT of N complex points, for any N >= 1
+/// (unlike SplitRadixComplexFft, N does not have to be a power of two).  It
+/// factors N into radices 4, 2, 3, 5 and any larger primes, and does one pass of
+/// the Stockham "autosort" algorithm per factor, so no bit-reversal
+/// permutation is needed.  The twiddle factors for all the passes are
+/// precomputed by the constructor.  The data is processed as separate arrays
+/// of real and imaginary parts, and the innermost loops go over contiguous
+/// elements, so that the compiler can vectorize them.
+template<typename Real>
+class MixedRadixComplexFft {
+ public:
+  explicit MixedRadixComplexFft(MatrixIndexT N);
+
+  MatrixIndexT Dim() const { return N_; }
+
+  /// Does the FFT of the array "x" of size N*2, containing
+  /// [ r0 im0 r1 im1 ... ].  If "forward", does the forward FFT; else does the
+  /// inverse FFT (without the 1/N factor).  "temp_buffer" is used as temporary
+  /// storage, and is resized if needed.  This function is const, so it may be
+  /// called from several threads at once with different buffers.
+  void Compute(Real *x, bool forward, std::vector<Real> *temp_buffer) const;
+
+ private:
+  // The same as Compute(), but takes the real and imaginary parts in separate
+  // arrays (xr, xi), and uses (yr, yi), of the same size, as temporary
+  // storage.
+  void ComputeSplit(Real *xr, Real *xi, Real *yr, Real *yi,
+                    bool forward) const;
+
+  // One pass of the algorithm.  Before it, the data is "stride" interleaved
+  // sequences of length radix * size; it computes one level of the
+  // decimation-in-frequency FFT of each of them.
+  struct Pass {
+    MatrixIndexT radix;
+    MatrixIndexT size;
+    MatrixIndexT stride;
+    // The twiddle factors exp(-2 pi i p k / (radix * size)), for 0 <= p < size
+    // and 1 <= k < radix, at index p * (radix - 1) + k - 1.
+    std::vector<Real> twiddle_re, twiddle_im;
+    // exp(-2 pi i k / radix) for 0 <= k < radix; only used for radices
+    // greater than 5, which do not have their own code.
+    std::vector<Real> root_re, root_im;
+  };
+
+  static void ComputePass(const Pass &pass,
+                          const Real *xr, const Real *xi,
+                          Real *yr, Real *yi);
+
+  MatrixIndexT N_;
+  std::vector<Pass> passes_;
+};
+
+
+/// MixedRadixRealFft computes the FFT of N real points, for any even N, using
+/// a complex FFT of N/2 points.  It implements the same computation as
+/// SplitRadixRealFft, with the same data format, but N does not need to be a
+/// power of two; e.g. a 400-sample (25ms at 16kHz) window can be transformed
+/// without padding it to 512.
+template<typename Real>
+class MixedRadixRealFft: public RealFftPlan<Real> {
+ public:
+  explicit MixedRadixRealFft(MatrixIndexT N);
+
+  virtual MatrixIndexT Dim() const { return N_; }
+
+  /// See RealFftPlan::Compute() for the format.
+  virtual void Compute(Real *x, bool forward,
+                       std::vector<Real> *temp_buffer) const;
+
+ private:
+  MatrixIndexT N_;
+  MixedRadixComplexFft<Real> complex_fft_;
+  // cos and sin of (2 pi k / N), for 1 <= k <= N/4, at index k - 1.
+  std::vector<Real> cos_table_, sin_table_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(MixedRadixRealFft);
+};
+
+}  // namespace kaldi
+
+#endif  // KALDI_MATRIX_MIXED_RADIX_FFT_H_
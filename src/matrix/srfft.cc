@@ -25,11 +25,108 @@
 // License v2.0.
 
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "matrix/srfft.h"
 #include "matrix/matrix-functions.h"
 
 namespace kaldi {
 
+// LaneOps<Real> has the arithmetic that the *Lanes() functions below do on
+// kWidth lanes at a time: SSE registers of 4 floats if we have SSE2, else one
+// Real.  The operations are the same as the scalar code's, so the results are
+// the same too.
+template<typename Real>
+struct LaneOps {
+  typedef Real Vec;
+  static const int32 kWidth = 1;
+  static inline Vec Load(const Real *x) { return *x; }
+  static inline void Store(Real *x, Vec v) { *x = v; }
+  static inline Vec Set(Real a) { return a; }
+  static inline Vec Add(Vec a, Vec b) { return a + b; }
+  static inline Vec Sub(Vec a, Vec b) { return a - b; }
+  static inline Vec Mul(Vec a, Vec b) { return a * b; }
+};
+
+#if defined(__SSE2__)
+template<>
+struct LaneOps<float> {
+  typedef __m128 Vec;
+  static const int32 kWidth = 4;
+  static inline Vec Load(const float *x) { return _mm_loadu_ps(x); }
+  static inline void Store(float *x, Vec v) { _mm_storeu_ps(x, v); }
+  static inline Vec Set(float a) { return _mm_set1_ps(a); }
+  static inline Vec Add(Vec a, Vec b) { return _mm_add_ps(a, b); }
+  static inline Vec Sub(Vec a, Vec b) { return _mm_sub_ps(a, b); }
+  static inline Vec Mul(Vec a, Vec b) { return _mm_mul_ps(a, b); }
+};
+#endif
+
+// The steps of ComputeRecursive() for the lanes of ComputeLanes(); "dim" is a
+// multiple of LaneOps<Real>::kWidth.
+
+// a, b <-- a + b, a - b.
+template<typename Real>
+static inline void LanesButterfly(Real *a, Real *b, MatrixIndexT dim) {
+  typedef LaneOps<Real> Ops;
+  for (MatrixIndexT i = 0; i < dim; i += Ops::kWidth) {
+    typename Ops::Vec x = Ops::Load(a + i), y = Ops::Load(b + i);
+    Ops::Store(a + i, Ops::Add(x, y));
+    Ops::Store(b + i, Ops::Sub(x, y));
+  }
+}
+
+// xr1, xi1, xr2, xi2 <-- xr1 + xi2, xi1 - xr2, xr1 - xi2, xi1 + xr2.
+template<typename Real>
+static inline void LanesRotate(Real *xr1, Real *xi1, Real *xr2, Real *xi2,
+                               MatrixIndexT dim) {
+  typedef LaneOps<Real> Ops;
+  for (MatrixIndexT i = 0; i < dim; i += Ops::kWidth) {
+    typename Ops::Vec r1 = Ops::Load(xr1 + i), i1 = Ops::Load(xi1 + i),
+        r2 = Ops::Load(xr2 + i), i2 = Ops::Load(xi2 + i);
+    Ops::Store(xr1 + i, Ops::Add(r1, i2));
+    Ops::Store(xi1 + i, Ops::Sub(i1, r2));
+    Ops::Store(xr2 + i, Ops::Sub(r1, i2));
+    Ops::Store(xi2 + i, Ops::Add(i1, r2));
+  }
+}
+
+// xr, xi <-- smc * xi + c * (xr + xi), spc * xr + c * (xr + xi).
+template<typename Real>
+static inline void LanesTwiddle(Real c, Real spc, Real smc,
+                                Real *xr, Real *xi, MatrixIndexT dim) {
+  typedef LaneOps<Real> Ops;
+  typename Ops::Vec cv = Ops::Set(c), spcv = Ops::Set(spc),
+      smcv = Ops::Set(smc);
+  for (MatrixIndexT i = 0; i < dim; i += Ops::kWidth) {
+    typename Ops::Vec r = Ops::Load(xr + i), im = Ops::Load(xi + i),
+        tmp = Ops::Mul(cv, Ops::Add(r, im));
+    Ops::Store(xr + i, Ops::Add(Ops::Mul(smcv, im), tmp));
+    Ops::Store(xi + i, Ops::Add(Ops::Mul(spcv, r), tmp));
+  }
+}
+
+// The n == m8 case of LanesTwiddle() for both halves, with s = sqrt(1/2):
+// xr1, xi1 <-- s * (xr1 + xi1), s * (xi1 - xr1);
+// xr2, xi2 <-- s * (xi2 - xr2), -s * (xr2 + xi2).
+template<typename Real>
+static inline void LanesSqrtHalf(Real *xr1, Real *xi1, Real *xr2, Real *xi2,
+                                 MatrixIndexT dim) {
+  typedef LaneOps<Real> Ops;
+  Real sqhalf = M_SQRT1_2;
+  typename Ops::Vec s = Ops::Set(sqhalf), minus_s = Ops::Set(-sqhalf);
+  for (MatrixIndexT i = 0; i < dim; i += Ops::kWidth) {
+    typename Ops::Vec r1 = Ops::Load(xr1 + i), i1 = Ops::Load(xi1 + i),
+        r2 = Ops::Load(xr2 + i), i2 = Ops::Load(xi2 + i);
+    Ops::Store(xr1 + i, Ops::Mul(s, Ops::Add(r1, i1)));
+    Ops::Store(xi1 + i, Ops::Mul(s, Ops::Sub(i1, r1)));
+    Ops::Store(xr2 + i, Ops::Mul(s, Ops::Sub(i2, r2)));
+    Ops::Store(xi2 + i, Ops::Mul(minus_s, Ops::Add(r2, i2)));
+  }
+}
+
 
 template<typename Real>
 SplitRadixComplexFft<Real>::SplitRadixComplexFft(MatrixIndexT N) {
@@ -325,6 +422,94 @@ void SplitRadixComplexFft<Real>::ComputeRecursive(Real *xr, Real *xi, MatrixInde
 }
 
 
+template<typename Real>
+void SplitRadixComplexFft<Real>::ComputeLanes(Real *xr, Real *xi,
+                                              MatrixIndexT num_lanes) const {
+  KALDI_ASSERT(num_lanes % 4 == 0);
+  ComputeRecursiveLanes(xr, xi, logn_, num_lanes);
+  if (logn_ > 1) {
+    BitReversePermuteLanes(xr, logn_, num_lanes);
+    BitReversePermuteLanes(xi, logn_, num_lanes);
+  }
+}
+
+template<typename Real>
+void SplitRadixComplexFft<Real>::BitReversePermuteLanes(
+    Real *x, MatrixIndexT logn, MatrixIndexT num_lanes) const {
+  // As BitReversePermute(), swapping groups of lanes.
+  MatrixIndexT lg2 = logn >> 1, n = 1 << lg2;
+  for (MatrixIndexT off = 1; off < n; off++) {
+    MatrixIndexT fj = n * brseed_[off], i = off, j = fj;
+    std::swap_ranges(x + i * num_lanes, x + (i + 1) * num_lanes,
+                     x + j * num_lanes);
+    const MatrixIndexT *brp = &(brseed_[1]);
+    for (MatrixIndexT gno = 1; gno < brseed_[off]; gno++) {
+      i += n;
+      j = fj + *brp++;
+      std::swap_ranges(x + i * num_lanes, x + (i + 1) * num_lanes,
+                       x + j * num_lanes);
+    }
+  }
+}
+
+template<typename Real>
+void SplitRadixComplexFft<Real>::ComputeRecursiveLanes(
+    Real *xr, Real *xi, MatrixIndexT logn, MatrixIndexT num_lanes) const {
+  // This does the same operations as ComputeRecursive(), in the same order.
+  MatrixIndexT L = num_lanes;
+  if (logn == 0) {
+    return;
+  } else if (logn == 1) {
+    LanesButterfly(xr, xr + L, L);
+    LanesButterfly(xi, xi + L, L);
+    return;
+  } else if (logn == 2) {
+    LanesButterfly(xr, xr + 2 * L, L);
+    LanesButterfly(xi, xi + 2 * L, L);
+    LanesButterfly(xr + L, xr + 3 * L, L);
+    LanesButterfly(xi + L, xi + 3 * L, L);
+    LanesButterfly(xr, xr + L, L);
+    LanesButterfly(xi, xi + L, L);
+    LanesRotate(xr + 2 * L, xi + 2 * L, xr + 3 * L, xi + 3 * L, L);
+    return;
+  }
+
+  MatrixIndexT m = 1 << logn, m2 = m / 2, m4 = m2 / 2, m8 = m4 / 2;
+
+  // Step 1.
+  LanesButterfly(xr, xr + m2 * L, m2 * L);
+  LanesButterfly(xi, xi + m2 * L, m2 * L);
+
+  // Step 2.
+  Real *xr1 = xr + m2 * L, *xr2 = xr1 + m4 * L,
+      *xi1 = xi + m2 * L, *xi2 = xi1 + m4 * L;
+  LanesRotate(xr1, xi1, xr2, xi2, m4 * L);
+
+  // Steps 3 & 4.
+  const Real *cn = NULL, *spcn = NULL, *smcn = NULL, *c3n = NULL,
+      *spc3n = NULL, *smc3n = NULL;
+  if (logn >= 4) {
+    MatrixIndexT nel = m4 - 2;
+    cn = tab_[logn - 4]; spcn = cn + nel; smcn = spcn + nel;
+    c3n = smcn + nel; spc3n = c3n + nel; smc3n = spc3n + nel;
+  }
+  for (MatrixIndexT n = 1; n < m4; n++) {
+    Real *r1 = xr1 + n * L, *i1 = xi1 + n * L,
+        *r2 = xr2 + n * L, *i2 = xi2 + n * L;
+    if (n == m8) {
+      LanesSqrtHalf(r1, i1, r2, i2, L);
+    } else {
+      LanesTwiddle(*cn++, *spcn++, *smcn++, r1, i1, L);
+      LanesTwiddle(*c3n++, *spc3n++, *smc3n++, r2, i2, L);
+    }
+  }
+
+  ComputeRecursiveLanes(xr, xi, logn - 1, L);
+  ComputeRecursiveLanes(xr + m2 * L, xi + m2 * L, logn - 2, L);
+  ComputeRecursiveLanes(xr + 3 * m4 * L, xi + 3 * m4 * L, logn - 2, L);
+}
+
+
 template<typename Real>
 void SplitRadixRealFft<Real>::Compute(Real *data, bool forward) {
   Compute(data, forward, &this->temp_buffer_);
@@ -404,6 +589,107 @@ void SplitRadixRealFft<Real>::Compute(Real *data, bool forward,
   }
 }
 
+template<typename Real>
+SplitRadixRealFft<Real>::SplitRadixRealFft(MatrixIndexT N):
+    SplitRadixComplexFft<Real>(N / 2), N_(N),
+    twiddle_re_(N / 4 + 1), twiddle_im_(N / 4 + 1) {
+  Real rootN_re, rootN_im;
+  ComplexImExp(static_cast<Real>(-M_2PI / N), &rootN_re, &rootN_im);
+  twiddle_re_[0] = 1.0;
+  twiddle_im_[0] = 0.0;
+  for (MatrixIndexT k = 1; 4 * k <= N; k++) {
+    twiddle_re_[k] = twiddle_re_[k - 1];
+    twiddle_im_[k] = twiddle_im_[k - 1];
+    ComplexMul(rootN_re, rootN_im, &(twiddle_re_[k]), &(twiddle_im_[k]));
+  }
+}
+
+template<typename Real>
+void SplitRadixRealFft<Real>::ComputeRows(Real *data, MatrixIndexT num_rows,
+                                          MatrixIndexT stride,
+                                          std::vector<Real> *temp_buffer) const {
+  typedef LaneOps<Real> Ops;
+  typedef typename Ops::Vec Vec;
+  KALDI_ASSERT(temp_buffer != NULL);
+  if (Ops::kWidth < 4) {
+    // Without SIMD instructions that do 4 rows at once (e.g. for double),
+    // copying the rows costs more than it saves.
+    for (MatrixIndexT r = 0; r < num_rows; r++)
+      Compute(data + r * stride, true, temp_buffer);
+    return;
+  }
+  MatrixIndexT N = N_, N2 = N / 2;
+  // L is the number of rows we do at once: 16, or fewer (but at least 4) if
+  // that makes our copy of the rows fit in 32K bytes, which is about the size
+  // of the level-1 cache.  This is faster even though we do fewer at once.
+  MatrixIndexT L = 16;
+  while (L > 4 && N * L * sizeof(Real) > 32768)
+    L /= 2;
+  if (temp_buffer->size() < static_cast<size_t>(N * L))
+    temp_buffer->resize(N * L);
+  // The real and imaginary parts of the complex FFT of N/2 points.
+  Real *xr = &((*temp_buffer)[0]), *xi = xr + N2 * L;
+
+  for (MatrixIndexT first_row = 0; first_row < num_rows; first_row += L) {
+    MatrixIndexT this_num_rows = std::min(L, num_rows - first_row);
+    for (MatrixIndexT r = 0; r < L; r++) {
+      if (r < this_num_rows) {
+        const Real *row = data + (first_row + r) * stride;
+        for (MatrixIndexT n = 0; n < N2; n++) {
+          xr[n * L + r] = row[2 * n];
+          xi[n * L + r] = row[2 * n + 1];
+        }
+      } else {  // Lanes that we don't use.
+        for (MatrixIndexT n = 0; n < N2; n++)
+          xr[n * L + r] = xi[n * L + r] = 0.0;
+      }
+    }
+
+    this->ComputeLanes(xr, xi, L);
+
+    // As in Compute(): with C_k and D_k as there, A_k = C_k + 1^(k/N) D_k and
+    // A_{N/2-k} = C_k^* - (1^(k/N))^* D_k^*.  With P and Q the imaginary and
+    // real parts of 1^(k/N) D_k, these are the same sums as in Compute().
+    Vec half = Ops::Set(0.5), minus_half = Ops::Set(-0.5);
+    for (MatrixIndexT k = 1; 2 * k <= N2; k++) {
+      MatrixIndexT kdash = N2 - k;
+      Vec kr = Ops::Set(twiddle_re_[k]), ki = Ops::Set(twiddle_im_[k]);
+      Real *br = xr + k * L, *bi = xi + k * L,
+          *bdr = xr + kdash * L, *bdi = xi + kdash * L;
+      for (MatrixIndexT i = 0; i < L; i += Ops::kWidth) {
+        Vec b_re = Ops::Load(br + i), b_im = Ops::Load(bi + i),
+            bd_re = Ops::Load(bdr + i), bd_im = Ops::Load(bdi + i),
+            ck_re = Ops::Mul(half, Ops::Add(b_re, bd_re)),
+            ck_im = Ops::Mul(half, Ops::Sub(b_im, bd_im)),
+            dk_re = Ops::Mul(half, Ops::Add(b_im, bd_im)),
+            dk_im = Ops::Mul(minus_half, Ops::Sub(b_re, bd_re)),
+            q = Ops::Sub(Ops::Mul(kr, dk_re), Ops::Mul(ki, dk_im)),
+            p = Ops::Add(Ops::Mul(kr, dk_im), Ops::Mul(ki, dk_re));
+        Ops::Store(br + i, Ops::Add(ck_re, q));
+        Ops::Store(bi + i, Ops::Add(ck_im, p));
+        if (kdash != k) {
+          Ops::Store(bdr + i, Ops::Sub(ck_re, q));
+          Ops::Store(bdi + i, Ops::Sub(p, ck_im));
+        }
+      }
+    }
+    for (MatrixIndexT i = 0; i < L; i += Ops::kWidth) {
+      // k = 0: A_0 and A_{N/2}, which are real.
+      Vec b_re = Ops::Load(xr + i), b_im = Ops::Load(xi + i);
+      Ops::Store(xr + i, Ops::Add(b_re, b_im));
+      Ops::Store(xi + i, Ops::Sub(b_re, b_im));
+    }
+
+    for (MatrixIndexT r = 0; r < this_num_rows; r++) {
+      Real *row = data + (first_row + r) * stride;
+      for (MatrixIndexT n = 0; n < N2; n++) {
+        row[2 * n] = xr[n * L + r];
+        row[2 * n + 1] = xi[n * L + r];
+      }
+    }
+  }
+}
+
 template class SplitRadixComplexFft<float>;
 template class SplitRadixComplexFft<double>;
 template class SplitRadixRealFft<float>;
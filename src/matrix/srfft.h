@@ -77,6 +77,14 @@ class SplitRadixComplexFft {
   ~SplitRadixComplexFft();
 
  protected:
+  // Does the forward FFT of "num_lanes" sequences at once.  Element n of the
+  // real and imaginary parts of the sequences is at xr + n * num_lanes and
+  // xi + n * num_lanes, so each step of the FFT is done for all the sequences
+  // together, with SIMD instructions if they are available.  "num_lanes" must
+  // be a multiple of 4.  The arithmetic is the same as Compute()'s for each
+  // sequence.
+  void ComputeLanes(Real *xr, Real *xi, Integer num_lanes) const;
+
   // temp_buffer_ is allocated only if someone calls Compute with only one Real*
   // argument and we need a temporary buffer while creating interleaved data.
   std::vector<Real> temp_buffer_;
@@ -84,6 +92,10 @@ class SplitRadixComplexFft {
   void ComputeTables();
   void ComputeRecursive(Real *xr, Real *xi, Integer logn) const;
   void BitReversePermute(Real *x, Integer logn) const;
+  // As ComputeRecursive() and BitReversePermute(), for ComputeLanes().
+  void ComputeRecursiveLanes(Real *xr, Real *xi, Integer logn,
+                             Integer num_lanes) const;
+  void BitReversePermuteLanes(Real *x, Integer logn, Integer num_lanes) const;
 
   Integer N_;
   Integer logn_;  // log(N)
@@ -100,8 +112,7 @@ class SplitRadixComplexFft {
 template<typename Real>
 class SplitRadixRealFft: private SplitRadixComplexFft<Real> {
  public:
-  SplitRadixRealFft(MatrixIndexT N):  // will fail unless N>=4 and N is a power of 2.
-      SplitRadixComplexFft<Real> (N/2), N_(N) { }
+  SplitRadixRealFft(MatrixIndexT N);  // will fail unless N>=4 and N is a power of 2.
   
   /// If forward == true, this function transforms from a sequence of N real points to its complex fourier
   /// transform; otherwise it goes in the reverse direction.  If you call it
@@ -117,9 +128,24 @@ class SplitRadixRealFft: private SplitRadixComplexFft<Real> {
   /// uses a user-supplied buffer.
   void Compute(Real *x, bool forward, std::vector<Real> *temp_buffer) const;
 
+  /// Does the forward FFT of each of the "num_rows" rows of "data", which
+  /// start "stride" elements apart, as Compute(row, true, temp_buffer) would.
+  /// For float, if we have SSE2, the rows are transposed in groups of up to
+  /// 16 so that each step of the FFT is done for the whole group with SIMD
+  /// instructions, which is much faster than one row at a time; otherwise
+  /// this just calls Compute() for each row.  The arithmetic is the same as
+  /// Compute()'s, so the results are the same, except perhaps for roundoff if
+  /// the compiler fuses multiplies and adds differently in the two.
+  void ComputeRows(Real *data, MatrixIndexT num_rows, MatrixIndexT stride,
+                   std::vector<Real> *temp_buffer) const;
+
  private:
   KALDI_DISALLOW_COPY_AND_ASSIGN(SplitRadixRealFft);  
   int N_;
+  // The twiddle factors 1^(k/N) for 0 <= k <= N/4, for ComputeRows(); they
+  // are computed as Compute() computes them, so the results are the same.
+  std::vector<Real> twiddle_re_;
+  std::vector<Real> twiddle_im_;
 };
 
 
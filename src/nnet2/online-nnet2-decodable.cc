@@ -101,17 +101,18 @@ void DecodableNnet2Online::ComputeForFrame(int32 frame) {
                                           opts_.max_nnet_batch_size);
   KALDI_ASSERT(input_frame_end > input_frame_begin);
   Matrix<BaseFloat> features(input_frame_end - input_frame_begin,
-                             feat_dim_);
+                             feat_dim_, kUndefined);
+  std::vector<int32> frames(input_frame_end - input_frame_begin);
   for (int32 t = input_frame_begin; t < input_frame_end; t++) {
-    SubVector<BaseFloat> row(features, t - input_frame_begin);
     int32 t_modified = t;
     // The next two if-statements take care of "pad_input"
     if (t_modified < 0)
       t_modified = 0;
     if (t_modified >= features_ready)
       t_modified = features_ready - 1;
-    features_->GetFrame(t_modified, &row);
+    frames[t - input_frame_begin] = t_modified;
   }
+  features_->GetFrames(frames, &features);
   CuMatrix<BaseFloat> cu_features; 
   cu_features.Swap(&features);  // Copy to GPU, if we're using one.
   
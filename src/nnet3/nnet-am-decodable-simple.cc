@@ -39,20 +39,54 @@ NnetDecodableBase::NnetDecodableBase(
     feats_(feats),
     ivector_(ivector), online_ivector_feats_(online_ivectors),
     online_ivector_period_(online_ivector_period),
-    compiler_(nnet_, opts_.optimize_config),
+    compiler_(new CachingOptimizingCompiler(nnet_, opts_.optimize_config)),
+    own_compiler_(true),
     current_log_post_subsampled_offset_(0) {
+  Init();
+}
+
+NnetDecodableBase::NnetDecodableBase(
+    const NnetSimpleComputationOptions &opts,
+    const Nnet &nnet,
+    const VectorBase<BaseFloat> &priors,
+    CachingOptimizingCompiler *compiler,
+    const MatrixBase<BaseFloat> &feats,
+    const VectorBase<BaseFloat> *ivector,
+    const MatrixBase<BaseFloat> *online_ivectors,
+    int32 online_ivector_period):
+    opts_(opts),
+    nnet_(nnet),
+    output_dim_(nnet_.OutputDim("output")),
+    log_priors_(priors),
+    feats_(feats),
+    ivector_(ivector), online_ivector_feats_(online_ivectors),
+    online_ivector_period_(online_ivector_period),
+    compiler_(compiler),
+    own_compiler_(false),
+    current_log_post_subsampled_offset_(0) {
+  KALDI_ASSERT(compiler != NULL);
+  Init();
+}
+
+void NnetDecodableBase::Init() {
   num_subsampled_frames_ =
       (feats_.NumRows() + opts_.frame_subsampling_factor - 1) /
       opts_.frame_subsampling_factor;
-  KALDI_ASSERT(IsSimpleNnet(nnet));
-  ComputeSimpleNnetContext(nnet, &nnet_left_context_, &nnet_right_context_);
-  KALDI_ASSERT(!(ivector != NULL && online_ivectors != NULL));
-  KALDI_ASSERT(!(online_ivectors != NULL && online_ivector_period <= 0 &&
+  KALDI_ASSERT(IsSimpleNnet(nnet_));
+  ComputeSimpleNnetContext(nnet_, &nnet_left_context_, &nnet_right_context_);
+  KALDI_ASSERT(!(ivector_ != NULL && online_ivector_feats_ != NULL));
+  KALDI_ASSERT(!(online_ivector_feats_ != NULL &&
+                 online_ivector_period_ <= 0 &&
                  "You need to set the --online-ivector-period option!"));
   log_priors_.ApplyLog();
   CheckAndFixConfigs();
 }
 
+NnetDecodableBase::~NnetDecodableBase() {
+  if (own_compiler_)
+    delete compiler_;
+}
+
 
 DecodableAmNnetSimple::DecodableAmNnetSimple(
     const NnetSimpleComputationOptions &opts,
@@ -67,6 +101,54 @@ DecodableAmNnetSimple::DecodableAmNnetSimple(
                       online_ivector_period),
     trans_model_(trans_model) { }
 
+DecodableAmNnetSimple::DecodableAmNnetSimple(
+    const NnetSimpleComputationOptions &opts,
+    const TransitionModel &trans_model,
+    const AmNnetSimple &am_nnet,
+    CachingOptimizingCompiler *compiler,
+    const MatrixBase<BaseFloat> &feats,
+    const VectorBase<BaseFloat> *ivector,
+    const MatrixBase<BaseFloat> *online_ivectors,
+    int32 online_ivector_period):
+    NnetDecodableBase(opts, am_nnet.GetNnet(), am_nnet.Priors(), compiler,
+                      feats, ivector, online_ivectors,
+                      online_ivector_period),
+    trans_model_(trans_model) { }
+
+DecodableAmNnetSimpleParallel::DecodableAmNnetSimpleParallel(
+    const NnetSimpleComputationOptions &opts,
+    const TransitionModel &trans_model,
+    const AmNnetSimple &am_nnet,
+    CachingOptimizingCompiler *compiler,
+    const MatrixBase<BaseFloat> &feats,
+    const VectorBase<BaseFloat> *ivector,
+    const MatrixBase<BaseFloat> *online_ivectors,
+    int32 online_ivector_period):
+    opts_(opts), trans_model_(trans_model), am_nnet_(am_nnet),
+    compiler_(compiler), feats_(feats),
+    online_ivector_period_(online_ivector_period),
+    decodable_nnet_(NULL) {
+  KALDI_ASSERT(compiler != NULL);
+  if (ivector != NULL)
+    ivector_ = *ivector;
+  if (online_ivectors != NULL)
+    online_ivectors_ = *online_ivectors;
+  // This must be the same as what NnetDecodableBase::NumFrames() will return.
+  // Note: the frame-subsampling-factor is not modified by CheckAndFixConfigs().
+  num_frames_ = (feats_.NumRows() + opts_.frame_subsampling_factor - 1) /
+      opts_.frame_subsampling_factor;
+}
+
+void DecodableAmNnetSimpleParallel::Init() {
+  KALDI_ASSERT(decodable_nnet_ == NULL);
+  decodable_nnet_ = new NnetDecodableBase(
+      opts_, am_nnet_.GetNnet(), am_nnet_.Priors(), compiler_, feats_,
+      ivector_.Dim() != 0 ? &ivector_ : NULL,
+      online_ivectors_.NumRows() != 0 ? &online_ivectors_ : NULL,
+      online_ivector_period_);
+  KALDI_ASSERT(decodable_nnet_->NumFrames() == num_frames_);
+}
+
 
 
 
@@ -244,9 +326,11 @@ void NnetDecodableBase::DoNnetComputation(
   request.outputs.resize(1);
   request.outputs[0].Swap(&output_spec);
 
-  const NnetComputation *computation = compiler_.Compile(request);
+  // "computation" will not be purged from the cache by other threads that
+  // share compiler_ while we are using it.
+  CachedComputation computation(compiler_, request);
   Nnet *nnet_to_update = NULL;  // we're not doing any update.
-  NnetComputer computer(opts_.compute_config, *computation,
+  NnetComputer computer(opts_.compute_config, computation.Computation(),
                         nnet_, nnet_to_update);
 
   CuMatrix<BaseFloat> input_feats_cu(input_feats);
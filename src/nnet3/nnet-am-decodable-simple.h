@@ -138,6 +138,22 @@ class NnetDecodableBase {
                     const MatrixBase<BaseFloat> *online_ivectors = NULL,
                     int32 online_ivector_period = 1);
 
+  /// This version of the constructor uses the supplied "compiler" instead of
+  /// creating its own, so that computations compiled for one utterance can be
+  /// reused for the next ones (possibly by other threads; see
+  /// class CachedComputation).  "compiler" must have been constructed with
+  /// the same "nnet" and with opts.optimize_config, and must outlive this
+  /// object.
+  NnetDecodableBase(const NnetSimpleComputationOptions &opts,
+                    const Nnet &nnet,
+                    const VectorBase<BaseFloat> &priors,
+                    CachingOptimizingCompiler *compiler,
+                    const MatrixBase<BaseFloat> &feats,
+                    const VectorBase<BaseFloat> *ivector = NULL,
+                    const MatrixBase<BaseFloat> *online_ivectors = NULL,
+                    int32 online_ivector_period = 1);
+
+  ~NnetDecodableBase();
 
   // returns the number of frames of likelihoods.  The same as feats_.NumRows()
   // in the normal case (but may be less if opts_.frame_subsampling_factor !=
@@ -186,6 +202,9 @@ class NnetDecodableBase {
                          int32 num_output_frames,
                          Vector<BaseFloat> *ivector);
 
+  // called from the constructors
+  void Init();
+
   // called from constructor
   void CheckAndFixConfigs();
 
@@ -214,7 +233,10 @@ class NnetDecodableBase {
   // number of frames the rows of ivector_feats are separated by.
   int32 online_ivector_period_;
 
-  CachingOptimizingCompiler compiler_;
+  // The compiler; owned by this object if own_compiler_ is true, else shared
+  // with other objects.
+  CachingOptimizingCompiler *compiler_;
+  bool own_compiler_;
 
   // The current log-posteriors that we got from the last time we
   // ran the computation.
@@ -224,7 +246,7 @@ class NnetDecodableBase {
   // frames.
   int32 current_log_post_subsampled_offset_;
 
-
+  KALDI_DISALLOW_COPY_AND_ASSIGN(NnetDecodableBase);
 };
 
 class DecodableAmNnetSimple: public DecodableInterface,
@@ -263,6 +285,16 @@ class DecodableAmNnetSimple: public DecodableInterface,
                         const MatrixBase<BaseFloat> *online_ivectors = NULL,
                         int32 online_ivector_period = 1);
 
+  /// This version of the constructor shares "compiler" with other objects;
+  /// see the corresponding constructor of class NnetDecodableBase.
+  DecodableAmNnetSimple(const NnetSimpleComputationOptions &opts,
+                        const TransitionModel &trans_model,
+                        const AmNnetSimple &am_nnet,
+                        CachingOptimizingCompiler *compiler,
+                        const MatrixBase<BaseFloat> &feats,
+                        const VectorBase<BaseFloat> *ivector = NULL,
+                        const MatrixBase<BaseFloat> *online_ivectors = NULL,
+                        int32 online_ivector_period = 1);
 
   virtual BaseFloat LogLikelihood(int32 frame, int32 transition_id);
 
@@ -283,6 +315,65 @@ class DecodableAmNnetSimple: public DecodableInterface,
 };
 
 
+/**
+   This version of DecodableAmNnetSimple is intended for a version of the
+   decoder that processes different utterances with multiple threads (see
+   nnet3-latgen-faster-parallel).  It differs from DecodableAmNnetSimple in
+   that it stores copies of the features and iVectors, so the caller doesn't
+   have to keep them, and that the NnetDecodableBase object (whose
+   constructor does some work) is only created when it is first needed, i.e.
+   in the decoding thread rather than in the main thread of the program.
+   "compiler" is normally shared between all the threads; it must outlive this
+   object.
+*/
+class DecodableAmNnetSimpleParallel: public DecodableInterface {
+ public:
+  DecodableAmNnetSimpleParallel(
+      const NnetSimpleComputationOptions &opts,
+      const TransitionModel &trans_model,
+      const AmNnetSimple &am_nnet,
+      CachingOptimizingCompiler *compiler,
+      const MatrixBase<BaseFloat> &feats,
+      const VectorBase<BaseFloat> *ivector = NULL,
+      const MatrixBase<BaseFloat> *online_ivectors = NULL,
+      int32 online_ivector_period = 1);
+
+  virtual BaseFloat LogLikelihood(int32 frame, int32 transition_id) {
+    if (decodable_nnet_ == NULL) Init();
+    return decodable_nnet_->GetOutput(
+        frame, trans_model_.TransitionIdToPdf(transition_id));
+  }
+
+  virtual int32 NumFramesReady() const { return num_frames_; }
+
+  virtual int32 NumIndices() const { return trans_model_.NumTransitionIds(); }
+
+  virtual bool IsLastFrame(int32 frame) const {
+    KALDI_ASSERT(frame < NumFramesReady());
+    return (frame == NumFramesReady() - 1);
+  }
+
+  ~DecodableAmNnetSimpleParallel() { delete decodable_nnet_; }
+ private:
+  // Creates decodable_nnet_.
+  void Init();
+
+  const NnetSimpleComputationOptions &opts_;
+  const TransitionModel &trans_model_;
+  const AmNnetSimple &am_nnet_;
+  CachingOptimizingCompiler *compiler_;
+  Matrix<BaseFloat> feats_;
+  Vector<BaseFloat> ivector_;  // empty if not supplied.
+  Matrix<BaseFloat> online_ivectors_;  // empty if not supplied.
+  int32 online_ivector_period_;
+  // The number of (subsampled) frames of output.
+  int32 num_frames_;
+  NnetDecodableBase *decodable_nnet_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(DecodableAmNnetSimpleParallel);
+};
+
+
 } // namespace nnet3
 } // namespace kaldi
 
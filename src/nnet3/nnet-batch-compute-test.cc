@@ -0,0 +1,256 @@
+// nnet3/nnet-batch-compute-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nnet3/nnet-batch-compute.h"
+#include "nnet3/nnet-am-decodable-simple.h"
+#include "nnet3/nnet-nnet.h"
+#include "base/timer.h"
+
+namespace kaldi {
+namespace nnet3 {
+
+// Creates a TDNN-like config with some left and right context, and an
+// iVector input if ivector_dim > 0.
+static std::string GetTdnnConfig(int32 input_dim, int32 ivector_dim,
+                                 int32 hidden_dim, int32 output_dim) {
+  std::ostringstream os;
+  os << "input-node name=input dim=" << input_dim << std::endl;
+  if (ivector_dim > 0)
+    os << "input-node name=ivector dim=" << ivector_dim << std::endl;
+  os << "component name=affine1 type=AffineComponent input-dim="
+     << (3 * input_dim + ivector_dim) << " output-dim=" << hidden_dim
+     << std::endl;
+  os << "component-node name=affine1 component=affine1 input=Append("
+     << "Offset(input, -2), input, Offset(input, 1)";
+  if (ivector_dim > 0)
+    os << ", ReplaceIndex(ivector, t, 0)";
+  os << ")" << std::endl;
+  os << "component name=relu1 type=RectifiedLinearComponent dim="
+     << hidden_dim << std::endl;
+  os << "component-node name=relu1 component=relu1 input=affine1\n";
+  os << "component name=affine2 type=AffineComponent input-dim="
+     << (2 * hidden_dim) << " output-dim=" << hidden_dim << std::endl;
+  os << "component-node name=affine2 component=affine2 input=Append("
+     << "Offset(relu1, -3), Offset(relu1, 3))\n";
+  os << "component name=relu2 type=RectifiedLinearComponent dim="
+     << hidden_dim << std::endl;
+  os << "component-node name=relu2 component=relu2 input=affine2\n";
+  os << "component name=final type=AffineComponent input-dim="
+     << hidden_dim << " output-dim=" << output_dim << std::endl;
+  os << "component-node name=final component=final input=relu2\n";
+  os << "component name=logsoftmax type=LogSoftmaxComponent dim="
+     << output_dim << std::endl;
+  os << "component-node name=logsoftmax component=logsoftmax input=final\n";
+  os << "output-node name=output input=logsoftmax\n";
+  return os.str();
+}
+
+static void GenerateUtterances(int32 num_utts, int32 input_dim,
+                               int32 ivector_dim, int32 max_length,
+                               std::vector<Matrix<BaseFloat> > *feats,
+                               std::vector<Matrix<BaseFloat> > *ivectors) {
+  feats->resize(num_utts);
+  ivectors->resize(num_utts);
+  for (int32 i = 0; i < num_utts; i++) {
+    int32 num_frames = RandInt(1, max_length);
+    (*feats)[i].Resize(num_frames, input_dim);
+    (*feats)[i].SetRandn();
+    if (ivector_dim > 0) {
+      // online iVectors with period 10.
+      (*ivectors)[i].Resize((num_frames + 9) / 10, ivector_dim);
+      (*ivectors)[i].SetRandn();
+    }
+  }
+}
+
+// Checks that the batch decodables give the same output as NnetDecodableBase.
+static void CompareOutputs(
+    const NnetSimpleComputationOptions &opts,
+    const Nnet &nnet,
+    const VectorBase<BaseFloat> &priors,
+    const std::vector<Matrix<BaseFloat> > &feats,
+    const std::vector<Matrix<BaseFloat> > &ivectors,
+    const std::vector<NnetBatchDecodableBase*> &batch_decodables) {
+  int32 output_dim = nnet.OutputDim("output");
+  for (size_t i = 0; i < feats.size(); i++) {
+    const Matrix<BaseFloat> *online_ivectors =
+        (ivectors[i].NumRows() > 0 ? &(ivectors[i]) : NULL);
+    NnetDecodableBase decodable(opts, nnet, priors, feats[i], NULL,
+                                online_ivectors, 10);
+    KALDI_ASSERT(decodable.NumFrames() == batch_decodables[i]->NumFrames());
+    int32 num_frames = decodable.NumFrames();
+    // Note: we have to go through NnetDecodableBase in order, since the way
+    // it divides the utterance into chunks depends on the order of access.
+    Matrix<BaseFloat> ref_output(num_frames, output_dim);
+    for (int32 t = 0; t < num_frames; t++) {
+      SubVector<BaseFloat> row(ref_output, t);
+      decodable.GetOutputForFrame(t, &row);
+    }
+    // Go through the batch output backwards sometimes, so we test waiting for
+    // frames that are not in the first chunk.
+    bool backwards = (RandInt(0, 1) == 0);
+    Vector<BaseFloat> batch_output(output_dim);
+    for (int32 f = 0; f < num_frames; f++) {
+      int32 t = (backwards ? num_frames - 1 - f : f);
+      batch_decodables[i]->GetOutputForFrame(t, &batch_output);
+      KALDI_ASSERT(batch_output.ApproxEqual(ref_output.Row(t), 0.001));
+      int32 pdf_id = RandInt(0, output_dim - 1);
+      AssertEqual(ref_output(t, pdf_id),
+                  batch_decodables[i]->GetOutput(t, pdf_id), 0.001);
+    }
+  }
+}
+
+// Checks that NnetBatchComputer gives the same output as NnetDecodableBase.
+void UnitTestNnetBatchCompute() {
+  int32 input_dim = RandInt(5, 10),
+      ivector_dim = (RandInt(0, 1) == 0 ? 0 : RandInt(2, 4)),
+      output_dim = RandInt(10, 20);
+  Nnet nnet;
+  {
+    std::istringstream is(GetTdnnConfig(input_dim, ivector_dim,
+                                         RandInt(10, 20), output_dim));
+    nnet.ReadConfig(is);
+  }
+  Vector<BaseFloat> priors;
+  if (RandInt(0, 1) == 0) {
+    priors.Resize(output_dim);
+    priors.SetRandn();
+    priors.ApplyExp();
+  }
+
+  NnetBatchComputerOptions opts;
+  opts.frame_subsampling_factor = RandInt(1, 3);
+  opts.frames_per_chunk = RandInt(1, 30) * opts.frame_subsampling_factor;
+  opts.minibatch_size = RandInt(1, 20);
+  opts.acoustic_scale = 0.5;
+  if (RandInt(0, 1) == 0)
+    opts.extra_left_context = RandInt(0, 3);
+  if (RandInt(0, 1) == 0)
+    opts.extra_left_context_initial = RandInt(0, 3);
+  if (RandInt(0, 1) == 0)
+    opts.extra_right_context_final = RandInt(0, 3);
+
+  int32 num_utts = RandInt(1, 20);
+  std::vector<Matrix<BaseFloat> > feats, ivectors;
+  GenerateUtterances(num_utts, input_dim, ivector_dim, 100,
+                     &feats, &ivectors);
+
+  CachingOptimizingCompiler compiler(nnet, opts.optimize_config);
+  NnetBatchComputer computer(opts, nnet, priors, &compiler);
+  std::vector<NnetBatchDecodableBase*> batch_decodables(num_utts);
+  for (int32 i = 0; i < num_utts; i++)
+    batch_decodables[i] = new NnetBatchDecodableBase(
+        &computer, feats[i], NULL,
+        (ivector_dim > 0 ? &(ivectors[i]) : NULL), 10);
+
+  if (RandInt(0, 1) == 0) {
+    // Do the computation in a separate thread, as it would normally be done;
+    // GetOutputForFrame() will wait for it.
+    MultiThreader<NnetBatchComputerThread> compute_thread(
+        1, NnetBatchComputerThread(&computer));
+    NnetBatchComputerTerminator terminator(&computer);
+    CompareOutputs(opts, nnet, priors, feats, ivectors, batch_decodables);
+  } else {
+    // Compute synchronously.
+    while (computer.Compute(true));
+    CompareOutputs(opts, nnet, priors, feats, ivectors, batch_decodables);
+  }
+  for (int32 i = 0; i < num_utts; i++)
+    delete batch_decodables[i];
+}
+
+// Compares the speed of NnetDecodableBase, which is what nnet3-latgen-faster
+// uses, and NnetBatchComputer, which is what nnet3-latgen-faster-batch uses, on
+// a network of a more realistic size.  The decoding itself is the same in the
+// two programs, so this is the difference in speed between them when they run
+// in one thread.  Each is timed a few times and we keep the fastest, as the
+// times vary a lot on a loaded machine.
+void NnetBatchComputeSpeedTest(int32 frames_per_chunk) {
+  int32 input_dim = 40, output_dim = 2000, hidden_dim = 512;
+  Nnet nnet;
+  {
+    std::istringstream is(GetTdnnConfig(input_dim, 0, hidden_dim,
+                                        output_dim));
+    nnet.ReadConfig(is);
+  }
+  Vector<BaseFloat> priors;
+  NnetBatchComputerOptions opts;
+  opts.frames_per_chunk = frames_per_chunk;
+  int32 num_utts = 40, num_repeats = 3;
+  std::vector<Matrix<BaseFloat> > feats, ivectors;
+  GenerateUtterances(num_utts, input_dim, 0, 1000, &feats, &ivectors);
+  int64 num_frames = 0;
+  for (int32 i = 0; i < num_utts; i++)
+    num_frames += feats[i].NumRows();
+  Vector<BaseFloat> output(output_dim);
+
+  double simple_time = 0.0, batch_time = 0.0;
+  for (int32 r = 0; r < num_repeats; r++) {
+    Timer timer;
+    for (int32 i = 0; i < num_utts; i++) {
+      NnetDecodableBase decodable(opts, nnet, priors, feats[i]);
+      for (int32 t = 0; t < decodable.NumFrames(); t++)
+        decodable.GetOutputForFrame(t, &output);
+    }
+    double time = timer.Elapsed();
+    if (r == 0 || time < simple_time)
+      simple_time = time;
+
+    timer.Reset();
+    {
+      CachingOptimizingCompiler compiler(nnet, opts.optimize_config);
+      NnetBatchComputer computer(opts, nnet, priors, &compiler);
+      std::vector<NnetBatchDecodableBase*> decodables(num_utts);
+      for (int32 i = 0; i < num_utts; i++)
+        decodables[i] = new NnetBatchDecodableBase(&computer, feats[i]);
+      while (computer.Compute(true));
+      for (int32 i = 0; i < num_utts; i++) {
+        for (int32 t = 0; t < decodables[i]->NumFrames(); t++)
+          decodables[i]->GetOutputForFrame(t, &output);
+        delete decodables[i];
+      }
+    }
+    time = timer.Elapsed();
+    if (r == 0 || time < batch_time)
+      batch_time = time;
+  }
+  KALDI_LOG << "For " << num_frames << " frames with frames-per-chunk="
+            << frames_per_chunk << ", NnetDecodableBase took "
+            << simple_time << " seconds (" << (num_frames / simple_time)
+            << " frames/sec), NnetBatchComputer with minibatch-size="
+            << opts.minibatch_size << " took " << batch_time << " seconds ("
+            << (num_frames / batch_time) << " frames/sec); speedup is "
+            << (simple_time / batch_time);
+}
+
+
+} // namespace nnet3
+} // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  using namespace kaldi::nnet3;
+
+  for (int32 n = 0; n < 20; n++)
+    UnitTestNnetBatchCompute();
+  NnetBatchComputeSpeedTest(50);
+  NnetBatchComputeSpeedTest(20);
+
+  KALDI_LOG << "Nnet batch-compute tests succeeded.";
+  return 0;
+}
@@ -0,0 +1,474 @@
+// nnet3/nnet-batch-compute.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nnet3/nnet-batch-compute.h"
+#include "nnet3/nnet-utils.h"
+
+namespace kaldi {
+namespace nnet3 {
+
+
+NnetBatchComputer::NnetBatchComputer(
+    const NnetBatchComputerOptions &opts,
+    const Nnet &nnet,
+    const VectorBase<BaseFloat> &priors,
+    CachingOptimizingCompiler *compiler):
+    opts_(opts),
+    nnet_(nnet),
+    input_dim_(nnet.InputDim("input")),
+    ivector_dim_(std::max<int32>(0, nnet.InputDim("ivector"))),
+    output_dim_(nnet.OutputDim("output")),
+    log_priors_(priors),
+    compiler_(compiler),
+    num_tasks_queued_(0),
+    num_waiting_(0),
+    terminate_(false),
+    num_minibatches_(0),
+    num_tasks_computed_(0),
+    num_rows_computed_(0) {
+  KALDI_ASSERT(IsSimpleNnet(nnet));
+  ComputeSimpleNnetContext(nnet, &nnet_left_context_, &nnet_right_context_);
+  KALDI_ASSERT(log_priors_.Dim() == 0 || log_priors_.Dim() == output_dim_);
+  log_priors_.ApplyLog();
+  CheckAndFixConfigs();
+}
+
+NnetBatchComputer::~NnetBatchComputer() {
+  if (!queue_.empty())
+    KALDI_WARN << "Destroying NnetBatchComputer with tasks still queued.";
+  if (num_minibatches_ > 0) {
+    KALDI_LOG << "Computed " << num_tasks_computed_ << " chunks in "
+              << num_minibatches_ << " minibatches, average minibatch size "
+              << (num_tasks_computed_ * 1.0 / num_minibatches_)
+              << "; " << (100.0 * (num_rows_computed_ - num_tasks_computed_) /
+                          num_rows_computed_)
+              << "% of computed chunks were padding.";
+  }
+}
+
+void NnetBatchComputer::CheckAndFixConfigs() {
+  static bool warned_subsampling = false;
+  if (opts_.frame_subsampling_factor < 1 ||
+      opts_.frames_per_chunk < 1)
+    KALDI_ERR << "--frame-subsampling-factor and --frames-per-chunk must be > 0";
+  if (opts_.minibatch_size < 1)
+    KALDI_ERR << "--minibatch-size must be > 0";
+  if (opts_.frames_per_chunk % opts_.frame_subsampling_factor != 0) {
+    int32 f = opts_.frame_subsampling_factor,
+        frames_per_chunk = f * ((opts_.frames_per_chunk + f - 1) / f);
+    if (!warned_subsampling) {
+      warned_subsampling = true;
+      KALDI_LOG << "Increasing --frames-per-chunk from "
+                << opts_.frames_per_chunk << " to "
+                << frames_per_chunk << " to make it a multiple of "
+                << "--frame-subsampling-factor="
+                << opts_.frame_subsampling_factor;
+    }
+    opts_.frames_per_chunk = frames_per_chunk;
+  }
+  KALDI_ASSERT(opts_.extra_left_context >= 0 && opts_.extra_right_context >= 0);
+}
+
+// This gets the iVector for a chunk in the same way as
+// NnetDecodableBase::GetCurrentIvector(), so the results are the same.
+static void GetIvectorForChunk(const VectorBase<BaseFloat> *ivector,
+                               const MatrixBase<BaseFloat> *online_ivectors,
+                               int32 online_ivector_period,
+                               int32 output_t_start,
+                               int32 num_output_frames,
+                               Vector<BaseFloat> *ans) {
+  if (ivector != NULL) {
+    *ans = *ivector;
+    return;
+  } else if (online_ivectors == NULL) {
+    return;
+  }
+  KALDI_ASSERT(online_ivector_period > 0);
+  int32 frame_to_search = output_t_start + num_output_frames / 2;
+  int32 ivector_frame = frame_to_search / online_ivector_period;
+  KALDI_ASSERT(ivector_frame >= 0);
+  if (ivector_frame >= online_ivectors->NumRows()) {
+    int32 margin = ivector_frame - (online_ivectors->NumRows() - 1);
+    if (margin * online_ivector_period > 50) {
+      // Half a second seems like too long to be explainable as edge effects.
+      KALDI_ERR << "Could not get iVector for frame " << frame_to_search
+                << ", only available till frame "
+                << online_ivectors->NumRows()
+                << " * ivector-period=" << online_ivector_period
+                << " (mismatched --ivector-period?)";
+    }
+    ivector_frame = online_ivectors->NumRows() - 1;
+  }
+  *ans = online_ivectors->Row(ivector_frame);
+}
+
+void NnetBatchComputer::SplitUtteranceIntoTasks(
+    const MatrixBase<BaseFloat> &feats,
+    const VectorBase<BaseFloat> *ivector,
+    const MatrixBase<BaseFloat> *online_ivectors,
+    int32 online_ivector_period,
+    MatrixBase<BaseFloat> *output,
+    Semaphore *semaphore,
+    std::vector<NnetInferenceTask> *tasks) const {
+  KALDI_ASSERT(!(ivector != NULL && online_ivectors != NULL));
+  KALDI_ASSERT(!(online_ivectors != NULL && online_ivector_period <= 0 &&
+                 "You need to set the --online-ivector-period option!"));
+  if (feats.NumCols() != input_dim_)
+    KALDI_ERR << "Neural net expects 'input' features with dimension "
+              << input_dim_ << " but you provided " << feats.NumCols();
+  int32 ivector_dim = (ivector != NULL ? ivector->Dim() :
+                       (online_ivectors != NULL ?
+                        online_ivectors->NumCols() : 0));
+  if (ivector_dim != ivector_dim_)
+    KALDI_ERR << "Neural net expects 'ivector' features with dimension "
+              << ivector_dim_ << " but you provided " << ivector_dim;
+
+  int32 num_input_frames_total = feats.NumRows(),
+      num_subsampled_frames = NumSubsampledFrames(num_input_frames_total),
+      subsampling_factor = opts_.frame_subsampling_factor,
+      subsampled_frames_per_chunk = opts_.frames_per_chunk / subsampling_factor,
+      num_chunks = (num_subsampled_frames + subsampled_frames_per_chunk - 1) /
+                   subsampled_frames_per_chunk;
+  KALDI_ASSERT(num_subsampled_frames > 0 &&
+               output->NumRows() == num_subsampled_frames &&
+               output->NumCols() == output_dim_);
+  // All the chunks compute the same number of frames, so that they can be
+  // computed together; if the utterance is not a multiple of the chunk size,
+  // the last chunk overlaps with the one before it.
+  int32 num_output_frames = std::min<int32>(subsampled_frames_per_chunk,
+                                            num_subsampled_frames);
+  tasks->clear();
+  tasks->resize(num_chunks);
+  for (int32 c = 0; c < num_chunks; c++) {
+    NnetInferenceTask &task = (*tasks)[c];
+    int32 first_used_subsampled_frame = c * subsampled_frames_per_chunk,
+        num_used_frames = std::min<int32>(
+            subsampled_frames_per_chunk,
+            num_subsampled_frames - first_used_subsampled_frame),
+        first_subsampled_frame = first_used_subsampled_frame +
+            num_used_frames - num_output_frames,
+        last_subsampled_frame = first_subsampled_frame + num_output_frames - 1;
+    int32 first_output_frame = first_subsampled_frame * subsampling_factor,
+        last_output_frame = last_subsampled_frame * subsampling_factor;
+
+    int32 extra_left_context = opts_.extra_left_context,
+        extra_right_context = opts_.extra_right_context;
+    if (first_output_frame == 0 && opts_.extra_left_context_initial >= 0)
+      extra_left_context = opts_.extra_left_context_initial;
+    if (last_subsampled_frame == num_subsampled_frames - 1 &&
+        opts_.extra_right_context_final >= 0)
+      extra_right_context = opts_.extra_right_context_final;
+    int32 left_context = nnet_left_context_ + extra_left_context,
+        right_context = nnet_right_context_ + extra_right_context;
+    int32 first_input_frame = first_output_frame - left_context,
+        last_input_frame = last_output_frame + right_context,
+        num_input_frames = last_input_frame + 1 - first_input_frame;
+
+    task.input.Resize(num_input_frames, feats.NumCols(), kUndefined);
+    for (int32 i = 0; i < num_input_frames; i++) {
+      int32 t = i + first_input_frame;
+      if (t < 0) t = 0;
+      if (t >= num_input_frames_total) t = num_input_frames_total - 1;
+      task.input.Row(i).CopyFromVec(feats.Row(t));
+    }
+    // We choose the iVector based on the frames whose output we will use,
+    // which gives the same result as NnetDecodableBase.
+    GetIvectorForChunk(ivector, online_ivectors, online_ivector_period,
+                       first_used_subsampled_frame * subsampling_factor,
+                       (num_used_frames - 1) * subsampling_factor,
+                       &task.ivector);
+    task.input_t_start = -left_context;
+    task.num_output_frames = num_output_frames;
+    task.num_initial_unused_output_frames =
+        first_used_subsampled_frame - first_subsampled_frame;
+    task.first_used_output_frame = first_used_subsampled_frame;
+    task.output = output;
+    task.semaphore = semaphore;
+    task.done = false;
+  }
+}
+
+void NnetBatchComputer::AcceptTask(NnetInferenceTask *task) {
+  KALDI_ASSERT(!task->done && task->output != NULL);
+  mutex_.Lock();
+  queue_[TaskShape(*task)].push_back(
+      std::pair<int64, NnetInferenceTask*>(num_tasks_queued_++, task));
+  mutex_.Unlock();
+  work_available_.Signal();
+}
+
+void NnetBatchComputer::GetNextMinibatch(
+    bool allow_partial_minibatch,
+    std::vector<NnetInferenceTask*> *tasks) {
+  tasks->clear();
+  QueueType::iterator chosen = queue_.end();
+  for (QueueType::iterator iter = queue_.begin(); iter != queue_.end();
+       ++iter) {
+    const TaskQueue &q = iter->second;
+    if (q.empty())
+      continue;
+    if (static_cast<int32>(q.size()) >= opts_.minibatch_size) {
+      chosen = iter;
+      break;
+    }
+    if (allow_partial_minibatch &&
+        (chosen == queue_.end() ||
+         q.front().first < chosen->second.front().first))
+      chosen = iter;
+  }
+  if (chosen == queue_.end())
+    return;
+  TaskQueue &q = chosen->second;
+  while (!q.empty() && static_cast<int32>(tasks->size()) < opts_.minibatch_size) {
+    tasks->push_back(q.front().second);
+    q.pop_front();
+  }
+  if (q.empty())
+    queue_.erase(chosen);
+}
+
+int32 NnetBatchComputer::GetActualMinibatchSize(int32 num_tasks) const {
+  KALDI_ASSERT(num_tasks > 0 && num_tasks <= opts_.minibatch_size);
+  int32 ans = 1;
+  while (ans < num_tasks)
+    ans *= 2;
+  return std::min<int32>(ans, opts_.minibatch_size);
+}
+
+void NnetBatchComputer::GetComputationRequest(
+    const NnetInferenceTask &task,
+    int32 minibatch_size,
+    ComputationRequest *request) const {
+  request->need_model_derivative = false;
+  request->store_component_stats = false;
+  request->inputs.clear();
+  request->inputs.reserve(2);
+
+  // The indexes are ordered with 'n' varying fastest, which lets the compiler
+  // use whole row-ranges when it splices frames together.
+  int32 num_input_frames = task.input.NumRows();
+  request->inputs.push_back(IoSpecification());
+  IoSpecification &input = request->inputs.back();
+  input.name = "input";
+  input.indexes.resize(num_input_frames * minibatch_size);
+  for (int32 t = 0; t < num_input_frames; t++)
+    for (int32 n = 0; n < minibatch_size; n++)
+      input.indexes[t * minibatch_size + n] =
+          Index(n, task.input_t_start + t, 0);
+  if (task.ivector.Dim() != 0) {
+    std::vector<Index> indexes(minibatch_size);
+    for (int32 n = 0; n < minibatch_size; n++)
+      indexes[n] = Index(n, 0, 0);
+    request->inputs.push_back(IoSpecification("ivector", indexes));
+  }
+  request->outputs.resize(1);
+  IoSpecification &output = request->outputs[0];
+  output.name = "output";
+  output.has_deriv = false;
+  int32 subsample = opts_.frame_subsampling_factor;
+  output.indexes.resize(task.num_output_frames * minibatch_size);
+  for (int32 i = 0; i < task.num_output_frames; i++)
+    for (int32 n = 0; n < minibatch_size; n++)
+      output.indexes[i * minibatch_size + n] = Index(n, i * subsample, 0);
+}
+
+void NnetBatchComputer::DoComputation(
+    const std::vector<NnetInferenceTask*> &tasks) {
+  int32 num_tasks = tasks.size(),
+      minibatch_size = GetActualMinibatchSize(num_tasks);
+  const NnetInferenceTask &first_task = *(tasks[0]);
+  ComputationRequest request;
+  GetComputationRequest(first_task, minibatch_size, &request);
+  // The compiler may be shared, so another thread could purge the
+  // computation from its cache while we use it, unless we hold on to it.
+  CachedComputation computation(compiler_, request);
+  Nnet *nnet_to_update = NULL;  // we're not doing any update.
+  NnetComputer computer(opts_.compute_config, computation.Computation(),
+                        nnet_, nnet_to_update);
+
+  // In the matrices below, row t * minibatch_size + n is frame t of task n,
+  // so the rows of one task form a submatrix with stride
+  // minibatch_size * (row stride); the rows after num_tasks are dummies, for
+  // which we repeat the last task.
+  int32 num_input_frames = first_task.input.NumRows(),
+      input_dim = first_task.input.NumCols();
+  Matrix<BaseFloat> input(num_input_frames * minibatch_size, input_dim,
+                          kUndefined);
+  for (int32 n = 0; n < minibatch_size; n++) {
+    const NnetInferenceTask &task = *(tasks[std::min(n, num_tasks - 1)]);
+    SubMatrix<BaseFloat> dest(input.Data() + n * input.Stride(),
+                              num_input_frames, input_dim,
+                              input.Stride() * minibatch_size);
+    dest.CopyFromMat(task.input);
+  }
+  CuMatrix<BaseFloat> input_cu;
+  input_cu.Swap(&input);
+  computer.AcceptInput("input", &input_cu);
+  if (first_task.ivector.Dim() != 0) {
+    CuMatrix<BaseFloat> ivectors_cu(minibatch_size, first_task.ivector.Dim(),
+                                    kUndefined);
+    for (int32 n = 0; n < minibatch_size; n++)
+      ivectors_cu.Row(n).CopyFromVec(
+          tasks[std::min(n, num_tasks - 1)]->ivector);
+    computer.AcceptInput("ivector", &ivectors_cu);
+  }
+  computer.Forward();
+  CuMatrix<BaseFloat> cu_output;
+  computer.GetOutputDestructive("output", &cu_output);
+  // subtract log-prior (divide by prior)
+  if (log_priors_.Dim() != 0)
+    cu_output.AddVecToRows(-1.0, log_priors_);
+  // apply the acoustic scale
+  cu_output.Scale(opts_.acoustic_scale);
+  Matrix<BaseFloat> output;
+  // the following statement just swaps the pointers if we're not using a GPU.
+  cu_output.Swap(&output);
+
+  int32 num_output_frames = first_task.num_output_frames;
+  for (int32 n = 0; n < num_tasks; n++) {
+    NnetInferenceTask &task = *(tasks[n]);
+    int32 num_unused = task.num_initial_unused_output_frames,
+        num_used = num_output_frames - num_unused;
+    SubMatrix<BaseFloat> src(output.Data() +
+                             (num_unused * minibatch_size + n) * output.Stride(),
+                             num_used, output.NumCols(),
+                             output.Stride() * minibatch_size);
+    task.output->RowRange(task.first_used_output_frame,
+                          num_used).CopyFromMat(src);
+  }
+  num_minibatches_++;
+  num_tasks_computed_ += num_tasks;
+  num_rows_computed_ += minibatch_size;
+}
+
+bool NnetBatchComputer::Compute(bool allow_partial_minibatch) {
+  compute_mutex_.Lock();
+  std::vector<NnetInferenceTask*> tasks;
+  mutex_.Lock();
+  GetNextMinibatch(allow_partial_minibatch, &tasks);
+  mutex_.Unlock();
+  if (tasks.empty()) {
+    compute_mutex_.Unlock();
+    return false;
+  }
+  DoComputation(tasks);
+  compute_mutex_.Unlock();
+
+  mutex_.Lock();
+  for (size_t i = 0; i < tasks.size(); i++)
+    tasks[i]->done = true;
+  // Signal while holding the lock: once the lock is released, the owner of
+  // the task may destroy it (and its semaphore).
+  for (size_t i = 0; i < tasks.size(); i++)
+    if (tasks[i]->semaphore != NULL)
+      tasks[i]->semaphore->Signal();
+  mutex_.Unlock();
+  return true;
+}
+
+void NnetBatchComputer::WaitForTask(NnetInferenceTask *task) {
+  KALDI_ASSERT(task->semaphore != NULL);
+  mutex_.Lock();
+  if (task->done) {
+    mutex_.Unlock();
+    return;
+  }
+  num_waiting_++;
+  mutex_.Unlock();
+  // Wake up ComputeLoop(), which may now do partial minibatches.
+  work_available_.Signal();
+  while (true) {
+    // The semaphore is signaled once for each task of its owner that is
+    // done, not necessarily this one, so we have to check.
+    task->semaphore->Wait();
+    mutex_.Lock();
+    bool done = task->done;
+    if (done)
+      num_waiting_--;
+    mutex_.Unlock();
+    if (done)
+      return;
+  }
+}
+
+void NnetBatchComputer::ComputeLoop() {
+  while (true) {
+    mutex_.Lock();
+    bool allow_partial_minibatch = (num_waiting_ > 0 || terminate_),
+        finished = (terminate_ && queue_.empty());
+    mutex_.Unlock();
+    if (finished)
+      return;
+    if (!Compute(allow_partial_minibatch))
+      work_available_.Wait();
+  }
+}
+
+void NnetBatchComputer::Terminate() {
+  mutex_.Lock();
+  terminate_ = true;
+  mutex_.Unlock();
+  work_available_.Signal();
+}
+
+
+NnetBatchDecodableBase::NnetBatchDecodableBase(
+    NnetBatchComputer *computer,
+    const MatrixBase<BaseFloat> &feats,
+    const VectorBase<BaseFloat> *ivector,
+    const MatrixBase<BaseFloat> *online_ivectors,
+    int32 online_ivector_period):
+    computer_(computer),
+    output_(computer->NumSubsampledFrames(feats.NumRows()),
+            computer->OutputDim(), kUndefined),
+    num_tasks_done_(0),
+    num_frames_ready_(0) {
+  computer_->SplitUtteranceIntoTasks(feats, ivector, online_ivectors,
+                                     online_ivector_period, &output_,
+                                     &semaphore_, &tasks_);
+  for (size_t i = 0; i < tasks_.size(); i++)
+    computer_->AcceptTask(&(tasks_[i]));
+}
+
+NnetBatchDecodableBase::~NnetBatchDecodableBase() {
+  // The computer may still be writing to our tasks if we did not use all the
+  // output (e.g. decoding failed).
+  for (size_t i = num_tasks_done_; i < tasks_.size(); i++)
+    computer_->WaitForTask(&(tasks_[i]));
+}
+
+void NnetBatchDecodableBase::WaitForFrame(int32 subsampled_frame) {
+  KALDI_ASSERT(subsampled_frame >= 0 && subsampled_frame < NumFrames());
+  while (subsampled_frame >= num_frames_ready_) {
+    NnetInferenceTask &task = tasks_[num_tasks_done_];
+    computer_->WaitForTask(&task);
+    num_frames_ready_ = task.first_used_output_frame + task.num_output_frames -
+        task.num_initial_unused_output_frames;
+    num_tasks_done_++;
+  }
+}
+
+void NnetBatchDecodableBase::GetOutputForFrame(int32 subsampled_frame,
+                                               VectorBase<BaseFloat> *output) {
+  if (subsampled_frame >= num_frames_ready_)
+    WaitForFrame(subsampled_frame);
+  output->CopyFromVec(output_.Row(subsampled_frame));
+}
+
+
+} // namespace nnet3
+} // namespace kaldi
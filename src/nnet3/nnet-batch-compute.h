@@ -0,0 +1,414 @@
+// nnet3/nnet-batch-compute.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_NNET3_NNET_BATCH_COMPUTE_H_
+#define KALDI_NNET3_NNET_BATCH_COMPUTE_H_
+
+#include <vector>
+#include <deque>
+#include <map>
+#include "base/kaldi-common.h"
+#include "hmm/transition-model.h"
+#include "itf/decodable-itf.h"
+#include "nnet3/nnet-optimize.h"
+#include "nnet3/nnet-compute.h"
+#include "nnet3/am-nnet-simple.h"
+#include "nnet3/nnet-am-decodable-simple.h"
+#include "thread/kaldi-mutex.h"
+#include "thread/kaldi-semaphore.h"
+#include "thread/kaldi-thread.h"
+
+namespace kaldi {
+namespace nnet3 {
+
+/* This file provides a way to do the neural-net computation for many
+   utterances at once, for offline decoding.  The class NnetDecodableBase
+   computes one chunk of one utterance at a time, and for typical chunk sizes
+   the matrix multiplications in the network have few rows and make poor use
+   of the CPU.  Here, chunks from different utterances (that have the same
+   size) are put into a single ComputationRequest with different 'n' indexes,
+   the same way MergeExamples() does for training, and evaluated together.
+
+   The typical usage is: one thread runs NnetBatchComputer::ComputeLoop()
+   (see class NnetBatchComputerThread), the main thread creates one
+   DecodableAmNnetBatch for each utterance, which gives its chunks to the
+   NnetBatchComputer, and the decoding of each utterance happens in another
+   thread (e.g. via class TaskSequencer), whose calls to LogLikelihood() wait
+   until the relevant chunk has been computed.  See
+   nnet3bin/nnet3-latgen-faster-batch.cc.
+*/
+
+
+struct NnetBatchComputerOptions: public NnetSimpleComputationOptions {
+  int32 minibatch_size;
+
+  NnetBatchComputerOptions(): minibatch_size(128) { }
+
+  void Register(OptionsItf *opts) {
+    NnetSimpleComputationOptions::Register(opts);
+    opts->Register("minibatch-size", &minibatch_size,
+                   "Maximum number of chunks (possibly from different "
+                   "utterances) that are evaluated together in one neural net "
+                   "computation.");
+  }
+};
+
+
+/**
+   NnetInferenceTask represents one chunk of one utterance that is to be
+   computed by class NnetBatchComputer.  You would not normally create these
+   yourself; class NnetBatchDecodableBase does it.
+*/
+struct NnetInferenceTask {
+  // The input features for this chunk, including the left and right context,
+  // with any padding at the utterance edges already done.
+  Matrix<BaseFloat> input;
+
+  // The iVector for this chunk, or the empty vector if the nnet does not use
+  // iVectors.
+  Vector<BaseFloat> ivector;
+
+  // The 't' value of the first row of 'input', relative to the first output
+  // frame of this chunk (which is treated as t = 0).  This is minus the left
+  // context.
+  int32 input_t_start;
+
+  // The number of (subsampled) output frames that the chunk computes.
+  int32 num_output_frames;
+
+  // The number of output frames at the start of this chunk that we discard,
+  // because they were already computed by the previous chunk.  This is
+  // nonzero only for the last chunk of an utterance, which we shift back so
+  // that it has the same size as the others.
+  int32 num_initial_unused_output_frames;
+
+  // The (subsampled) frame index in the utterance that the first used output
+  // frame corresponds to, i.e. the row of 'output' that it is written to.
+  int32 first_used_output_frame;
+
+  // The matrix that the output of the chunk is written to; it is owned
+  // elsewhere and contains the whole utterance.
+  MatrixBase<BaseFloat> *output;
+
+  // If non-NULL, this is signaled when the task is done.
+  Semaphore *semaphore;
+
+  // True when the output has been written.  Protected by the mutex of the
+  // NnetBatchComputer.
+  bool done;
+
+  NnetInferenceTask(): input_t_start(0), num_output_frames(0),
+                       num_initial_unused_output_frames(0),
+                       first_used_output_frame(0), output(NULL),
+                       semaphore(NULL), done(false) { }
+};
+
+
+/**
+   Class NnetBatchComputer does the neural net computation for chunks
+   (NnetInferenceTask) that may come from many different utterances.  Tasks
+   are grouped by their size; whenever a group has enough tasks for a full
+   minibatch (or when someone is waiting for a task that is not done yet),
+   the tasks are merged into one computation with 'n' values 0, 1, ... and
+   evaluated together.
+
+   AcceptTask(), Compute() and WaitForTask() may be called from different
+   threads.  Compute() calls are serialized internally, so there is no point
+   calling it from more than one thread.
+*/
+class NnetBatchComputer {
+ public:
+  /// Note: "nnet" and "priors" must stay alive as long as this object; the
+  /// nnet must satisfy IsSimpleNnet().  If "priors" is nonempty we subtract
+  /// their log from the output, and the acoustic scale in "opts" is applied.
+  /// "compiler" is owned externally, so that its computations can be shared
+  /// with other users and saved (see ComputationCacheOptions); it must have
+  /// been constructed with the same "nnet" and with opts.optimize_config, and
+  /// must outlive this object.
+  NnetBatchComputer(const NnetBatchComputerOptions &opts,
+                    const Nnet &nnet,
+                    const VectorBase<BaseFloat> &priors,
+                    CachingOptimizingCompiler *compiler);
+
+  /// Splits an utterance into chunks that can be given to AcceptTask().  The
+  /// output of the chunks will be written to "output", which must be sized to
+  /// NumSubsampledFrames(feats.NumRows()) by OutputDim().  The arguments
+  /// "ivector", "online_ivectors" and "online_ivector_period" are as for
+  /// class NnetDecodableBase.  The input is copied, so the caller does not
+  /// need to keep it.
+  void SplitUtteranceIntoTasks(const MatrixBase<BaseFloat> &feats,
+                               const VectorBase<BaseFloat> *ivector,
+                               const MatrixBase<BaseFloat> *online_ivectors,
+                               int32 online_ivector_period,
+                               MatrixBase<BaseFloat> *output,
+                               Semaphore *semaphore,
+                               std::vector<NnetInferenceTask> *tasks) const;
+
+  /// Returns the number of output frames for an utterance with this many
+  /// input frames.
+  int32 NumSubsampledFrames(int32 num_frames) const {
+    return (num_frames + opts_.frame_subsampling_factor - 1) /
+        opts_.frame_subsampling_factor;
+  }
+
+  int32 OutputDim() const { return output_dim_; }
+
+  /// Adds a task to the queue.  The task is not owned here, and must not be
+  /// destroyed or modified until it is done (see WaitForTask()).
+  void AcceptTask(NnetInferenceTask *task);
+
+  /// Does the computation for one minibatch of tasks, if there is one ready,
+  /// and returns true; returns false if there was nothing to do.  If
+  /// allow_partial_minibatch is false, it will only do the computation if
+  /// there are at least opts.minibatch_size tasks of the same size queued.
+  bool Compute(bool allow_partial_minibatch);
+
+  /// Waits until "task" is done.  While anyone is waiting, the computation
+  /// thread (ComputeLoop()) will compute partial minibatches, because there
+  /// may be no more tasks coming.  Requires that task->semaphore is set.
+  void WaitForTask(NnetInferenceTask *task);
+
+  /// Repeatedly calls Compute() until Terminate() has been called and no
+  /// tasks remain.  Intended to be called in a separate thread.
+  void ComputeLoop();
+
+  /// Tells ComputeLoop() to return once the queue is empty.
+  void Terminate();
+
+  ~NnetBatchComputer();
+
+ private:
+  // The size of a task determines which tasks can be computed together.
+  struct TaskShape {
+    int32 num_input_frames;
+    int32 input_t_start;
+    int32 num_output_frames;
+    int32 ivector_dim;
+    explicit TaskShape(const NnetInferenceTask &task):
+        num_input_frames(task.input.NumRows()),
+        input_t_start(task.input_t_start),
+        num_output_frames(task.num_output_frames),
+        ivector_dim(task.ivector.Dim()) { }
+    bool operator < (const TaskShape &other) const {
+      if (num_input_frames != other.num_input_frames)
+        return num_input_frames < other.num_input_frames;
+      if (input_t_start != other.input_t_start)
+        return input_t_start < other.input_t_start;
+      if (num_output_frames != other.num_output_frames)
+        return num_output_frames < other.num_output_frames;
+      return ivector_dim < other.ivector_dim;
+    }
+  };
+  // Each queued task, with a sequence number that says how old it is.
+  typedef std::deque<std::pair<int64, NnetInferenceTask*> > TaskQueue;
+  typedef std::map<TaskShape, TaskQueue> QueueType;
+
+  // Removes the tasks for the next minibatch from the queue and puts them in
+  // "tasks" (or leaves it empty if there is nothing to do).  If there is a
+  // group with a full minibatch we take that; otherwise, if
+  // allow_partial_minibatch, we take the group with the oldest task.
+  // Requires mutex_ to be locked.
+  void GetNextMinibatch(bool allow_partial_minibatch,
+                        std::vector<NnetInferenceTask*> *tasks);
+
+  // Returns the size of minibatch we actually compute for "num_tasks" tasks:
+  // the smallest power of two that is >= num_tasks, but not more than
+  // opts_.minibatch_size.  Rounding up limits the number of distinct
+  // computations we have to compile; the extra rows are dummies.
+  int32 GetActualMinibatchSize(int32 num_tasks) const;
+
+  // Creates the ComputationRequest for a minibatch of "minibatch_size" tasks
+  // with the shape of "task".
+  void GetComputationRequest(const NnetInferenceTask &task,
+                             int32 minibatch_size,
+                             ComputationRequest *request) const;
+
+  // Does the computation for "tasks" (all of the same shape) and writes the
+  // output.
+  void DoComputation(const std::vector<NnetInferenceTask*> &tasks);
+
+  // called from constructor
+  void CheckAndFixConfigs();
+
+  NnetBatchComputerOptions opts_;
+  const Nnet &nnet_;
+  int32 nnet_left_context_;
+  int32 nnet_right_context_;
+  int32 input_dim_;
+  int32 ivector_dim_;  // the nnet's iVector dim, or 0 if it takes none.
+  int32 output_dim_;
+  // the log priors (or the empty vector if the priors are not set in the model)
+  CuVector<BaseFloat> log_priors_;
+
+  CachingOptimizingCompiler *compiler_;
+
+  // mutex_ protects queue_, num_tasks_queued_, num_waiting_, terminate_ and
+  // the 'done' members of the tasks.
+  Mutex mutex_;
+  QueueType queue_;
+  int64 num_tasks_queued_;  // number of tasks ever queued, used as sequence no.
+  int32 num_waiting_;  // number of threads in WaitForTask().
+  bool terminate_;
+  // Signaled whenever there may be something for ComputeLoop() to do.
+  Semaphore work_available_;
+
+  // Serializes calls to Compute(); there is no point doing more than one
+  // minibatch at a time.
+  Mutex compute_mutex_;
+
+  // Statistics, protected by compute_mutex_.
+  int64 num_minibatches_;
+  int64 num_tasks_computed_;
+  int64 num_rows_computed_;  // including the dummy ones.
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(NnetBatchComputer);
+};
+
+
+/**
+   This class is a wrapper that runs NnetBatchComputer::ComputeLoop() in a
+   thread, e.g.:
+     MultiThreader<NnetBatchComputerThread> compute_thread(
+         1, NnetBatchComputerThread(&computer));
+     NnetBatchComputerTerminator terminator(&computer);
+   The thread is joined when compute_thread goes out of scope, which needs
+   computer.Terminate() to have been called first; class
+   NnetBatchComputerTerminator does that, also if an exception is thrown.
+*/
+class NnetBatchComputerThread: public MultiThreadable {
+ public:
+  explicit NnetBatchComputerThread(NnetBatchComputer *computer):
+      computer_(computer) { }
+  void operator() () { computer_->ComputeLoop(); }
+ private:
+  NnetBatchComputer *computer_;
+};
+
+/**
+   This class calls Terminate() on the NnetBatchComputer in its destructor.
+   Declare it after the MultiThreader that runs the computer's ComputeLoop(),
+   so that it is destroyed before the thread is joined; otherwise, if an
+   exception is thrown, the join would wait forever.
+*/
+class NnetBatchComputerTerminator {
+ public:
+  explicit NnetBatchComputerTerminator(NnetBatchComputer *computer):
+      computer_(computer) { }
+  ~NnetBatchComputerTerminator() { computer_->Terminate(); }
+ private:
+  NnetBatchComputer *computer_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(NnetBatchComputerTerminator);
+};
+
+
+/**
+   This class handles the neural net output for one utterance that is
+   computed by class NnetBatchComputer.  The constructor splits the utterance
+   into chunks and queues them; GetOutput() waits, if necessary, until the
+   chunk containing the requested frame has been computed.  It is analogous
+   to class NnetDecodableBase.
+*/
+class NnetBatchDecodableBase {
+ public:
+  /// The arguments "feats", "ivector", "online_ivectors" and
+  /// "online_ivector_period" are as for class NnetDecodableBase, except that
+  /// they are copied, so you don't have to keep them.  "computer" must stay
+  /// alive as long as this object.
+  NnetBatchDecodableBase(NnetBatchComputer *computer,
+                         const MatrixBase<BaseFloat> &feats,
+                         const VectorBase<BaseFloat> *ivector = NULL,
+                         const MatrixBase<BaseFloat> *online_ivectors = NULL,
+                         int32 online_ivector_period = 1);
+
+  inline int32 NumFrames() const { return output_.NumRows(); }
+
+  inline int32 OutputDim() const { return output_.NumCols(); }
+
+  // Gets the output for a particular frame, with 0 <= frame < NumFrames().
+  // 'output' must be correctly sized (with dimension OutputDim()).
+  void GetOutputForFrame(int32 subsampled_frame, VectorBase<BaseFloat> *output);
+
+  // Gets the output for a particular frame and pdf_id, with
+  // 0 <= subsampled_frame < NumFrames(),
+  // and 0 <= pdf_id < OutputDim().
+  inline BaseFloat GetOutput(int32 subsampled_frame, int32 pdf_id) {
+    if (subsampled_frame >= num_frames_ready_)
+      WaitForFrame(subsampled_frame);
+    return output_(subsampled_frame, pdf_id);
+  }
+
+  /// The destructor waits until all the tasks are done.
+  ~NnetBatchDecodableBase();
+
+ private:
+  // Waits until the tasks up to the one containing this frame are done, and
+  // updates num_frames_ready_.
+  void WaitForFrame(int32 subsampled_frame);
+
+  NnetBatchComputer *computer_;
+  std::vector<NnetInferenceTask> tasks_;
+  // The output for the whole utterance, written by the computer.
+  Matrix<BaseFloat> output_;
+  // Signaled by the computer each time one of our tasks is done.
+  Semaphore semaphore_;
+  // We know that tasks_[0 ... num_tasks_done_ - 1] are done, which means
+  // that the output for frames 0 ... num_frames_ready_ - 1 is ready.
+  int32 num_tasks_done_;
+  int32 num_frames_ready_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(NnetBatchDecodableBase);
+};
+
+
+class DecodableAmNnetBatch: public DecodableInterface,
+                            private NnetBatchDecodableBase {
+ public:
+  /// See NnetBatchDecodableBase for the meaning of the arguments.  Note:
+  /// the priors and acoustic scale are applied by "computer", so it should
+  /// have been initialized with am_nnet.Priors().
+  DecodableAmNnetBatch(NnetBatchComputer *computer,
+                       const TransitionModel &trans_model,
+                       const MatrixBase<BaseFloat> &feats,
+                       const VectorBase<BaseFloat> *ivector = NULL,
+                       const MatrixBase<BaseFloat> *online_ivectors = NULL,
+                       int32 online_ivector_period = 1):
+      NnetBatchDecodableBase(computer, feats, ivector, online_ivectors,
+                             online_ivector_period),
+      trans_model_(trans_model) { }
+
+  virtual BaseFloat LogLikelihood(int32 frame, int32 transition_id) {
+    return GetOutput(frame, trans_model_.TransitionIdToPdf(transition_id));
+  }
+
+  virtual inline int32 NumFramesReady() const { return NumFrames(); }
+
+  virtual int32 NumIndices() const { return trans_model_.NumTransitionIds(); }
+
+  virtual bool IsLastFrame(int32 frame) const {
+    KALDI_ASSERT(frame < NumFramesReady());
+    return (frame == NumFramesReady() - 1);
+  }
+
+ private:
+  const TransitionModel &trans_model_;
+};
+
+
+} // namespace nnet3
+} // namespace kaldi
+
+#endif  // KALDI_NNET3_NNET_BATCH_COMPUTE_H_
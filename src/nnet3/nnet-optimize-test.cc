@@ -23,6 +23,7 @@
 #include "nnet3/nnet-test-utils.h"
 #include "nnet3/nnet-optimize.h"
 #include "nnet3/nnet-compute.h"
+#include "thread/kaldi-thread.h"
 
 namespace kaldi {
 namespace nnet3 {
@@ -223,6 +224,149 @@ static void UnitTestNnetOptimize() {
 #undef KALDI_SUCCFAIL
 }
 
+
+// This class is used to test sharing a CachingOptimizingCompiler between
+// threads: each thread repeatedly compiles randomly chosen requests (via
+// class CachedComputation), runs them and checks the output.
+class SharedCompilerTestThread: public MultiThreadable {
+ public:
+  SharedCompilerTestThread(
+      const Nnet &nnet,
+      CachingOptimizingCompiler *compiler,
+      const std::vector<ComputationRequest> &requests,
+      const std::vector<std::vector<Matrix<BaseFloat> > > &inputs,
+      const std::vector<Matrix<BaseFloat> > &ref_outputs):
+      nnet_(nnet), compiler_(compiler), requests_(requests),
+      inputs_(inputs), ref_outputs_(ref_outputs) { }
+
+  void operator() () {
+    for (int32 n = 0; n < 20; n++) {
+      int32 r = RandInt(0, requests_.size() - 1);
+      CachedComputation computation(compiler_, requests_[r]);
+      NnetComputeOptions compute_opts;
+      NnetComputer computer(compute_opts, computation.Computation(),
+                            nnet_, NULL);
+      for (size_t i = 0; i < requests_[r].inputs.size(); i++) {
+        CuMatrix<BaseFloat> temp(inputs_[r][i]);
+        computer.AcceptInput(requests_[r].inputs[i].name, &temp);
+      }
+      computer.Forward();
+      Matrix<BaseFloat> output(computer.GetOutput("output"));
+      KALDI_ASSERT(ApproxEqual(output, ref_outputs_[r]));
+    }
+  }
+ private:
+  const Nnet &nnet_;
+  CachingOptimizingCompiler *compiler_;
+  const std::vector<ComputationRequest> &requests_;
+  const std::vector<std::vector<Matrix<BaseFloat> > > &inputs_;
+  const std::vector<Matrix<BaseFloat> > &ref_outputs_;
+};
+
+// Each thread compiles a request that cannot be compiled, and checks that this
+// throws (rather than waiting forever for another thread that threw).
+class FailingCompilerTestThread: public MultiThreadable {
+ public:
+  FailingCompilerTestThread(CachingOptimizingCompiler *compiler,
+                            const ComputationRequest &request):
+      compiler_(compiler), request_(request) { }
+
+  void operator() () {
+    bool threw = false;
+    try {
+      compiler_->Compile(request_);
+    } catch (const std::exception &e) {
+      threw = true;
+    }
+    KALDI_ASSERT(threw);
+  }
+ private:
+  CachingOptimizingCompiler *compiler_;
+  const ComputationRequest &request_;
+};
+
+// Tests that one CachingOptimizingCompiler can be shared between threads, with
+// a cache capacity small enough that computations are purged while in use.
+static void UnitTestCachingCompilerShared() {
+  struct NnetGenerationOptions gen_config;
+  std::vector<std::string> configs;
+  GenerateConfigSequence(gen_config, &configs);
+  Nnet nnet;
+  for (size_t j = 0; j < configs.size(); j++) {
+    std::istringstream is(configs[j]);
+    nnet.ReadConfig(is);
+  }
+
+  int32 num_requests = 5;
+  std::vector<ComputationRequest> requests(num_requests);
+  std::vector<std::vector<Matrix<BaseFloat> > > inputs(num_requests);
+  std::vector<Matrix<BaseFloat> > ref_outputs(num_requests);
+  for (int32 r = 0; r < num_requests; r++) {
+    ComputeExampleComputationRequestSimple(nnet, &(requests[r]),
+                                           &(inputs[r]));
+    // we only do the forward computation.
+    requests[r].need_model_derivative = false;
+    requests[r].store_component_stats = false;
+    for (size_t i = 0; i < requests[r].inputs.size(); i++)
+      requests[r].inputs[i].has_deriv = false;
+    for (size_t i = 0; i < requests[r].outputs.size(); i++)
+      requests[r].outputs[i].has_deriv = false;
+
+    CachingOptimizingCompiler compiler(nnet);
+    NnetComputeOptions compute_opts;
+    NnetComputer computer(compute_opts, *compiler.Compile(requests[r]),
+                          nnet, NULL);
+    for (size_t i = 0; i < requests[r].inputs.size(); i++) {
+      CuMatrix<BaseFloat> temp(inputs[r][i]);
+      computer.AcceptInput(requests[r].inputs[i].name, &temp);
+    }
+    computer.Forward();
+    ref_outputs[r].Resize(computer.GetOutput("output").NumRows(),
+                          computer.GetOutput("output").NumCols());
+    computer.GetOutput("output").CopyToMat(&(ref_outputs[r]));
+  }
+
+  int32 capacity = 2;
+  CachingOptimizingCompiler shared_compiler(nnet, capacity);
+  {
+    SharedCompilerTestThread c(nnet, &shared_compiler, requests, inputs,
+                               ref_outputs);
+    // the destructor of MultiThreader waits for the threads to finish.
+    MultiThreader<SharedCompilerTestThread> m(4, c);
+  }
+
+  // Test writing and reading the cache; the computations read back must give
+  // the same output.
+  bool binary = (RandInt(0, 1) == 0);
+  std::ostringstream os;
+  shared_compiler.WriteCache(os, binary);
+  CachingOptimizingCompiler compiler2(nnet, capacity);
+  {
+    std::istringstream is(os.str());
+    compiler2.ReadCache(is, binary);
+    // check that the cache was not rejected (the hash of the nnet structure
+    // and the optimization options match).
+    std::ostringstream os2;
+    compiler2.WriteCache(os2, binary);
+    KALDI_ASSERT(os2.str().size() == os.str().size());
+  }
+  {
+    SharedCompilerTestThread c(nnet, &compiler2, requests, inputs,
+                               ref_outputs);
+    MultiThreader<SharedCompilerTestThread> m(2, c);
+  }
+
+  // A request for an output the nnet doesn't have fails to compile; the
+  // compiler must still work afterwards.
+  ComputationRequest bad_request(requests[0]);
+  bad_request.outputs[0].name = "no-such-output";
+  {
+    FailingCompilerTestThread c(&compiler2, bad_request);
+    MultiThreader<FailingCompilerTestThread> m(4, c);
+  }
+  KALDI_ASSERT(compiler2.Compile(requests[0]) != NULL);
+}
+
 } // namespace nnet3
 } // namespace kaldi
 
@@ -237,6 +381,8 @@ int main() {
   CuDevice::Instantiate().SelectGpuId("yes");
 #endif
   UnitTestNnetOptimize();
+  for (int32 n = 0; n < 5; n++)
+    UnitTestCachingCompilerShared();
 
   KALDI_LOG << "Nnet tests succeeded.";
 
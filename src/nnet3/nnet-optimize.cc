@@ -20,6 +20,9 @@
 
 #include "nnet3/nnet-optimize.h"
 #include "nnet3/nnet-optimize-utils.h"
+#include "nnet3/nnet-utils.h"
+#include <cstdio>
+#include <unistd.h>
 
 namespace kaldi {
 namespace nnet3 {
@@ -497,9 +500,13 @@ void CachingOptimizingCompiler::UpdateCache(const ComputationRequest *request,
     const CacheType::iterator it =
         computation_cache_.find(access_queue_.front());
     KALDI_ASSERT(it != computation_cache_.end());
-    // purge the least-recently-accessed request
+    // purge the least-recently-accessed request.  If some thread is still
+    // using the computation, it will be deleted by Release().
     delete it->first;
-    delete it->second.first;
+    if (num_users_.count(it->second.first) != 0)
+      purged_.insert(it->second.first);
+    else
+      delete it->second.first;
     computation_cache_.erase(it);
     access_queue_.pop_front();
   }
@@ -513,14 +520,31 @@ void CachingOptimizingCompiler::ReadCache(std::istream &is, bool binary) {
   opt_config_cached.Read(is, binary);
   // we won't read cached computations if any optimize option has been changed.
   bool read_cache = (opt_config_ == opt_config_cached);
+  if (!read_cache)
+    KALDI_WARN << "Not using the computation cache, since it was written with "
+               << "different optimization options.";
+
+  std::string token;
+  ReadToken(is, binary, &token);
+  if (token == "<NnetStructureHash>") {
+    int64 hash;
+    ReadBasicType(is, binary, &hash);
+    if (read_cache && hash != NnetStructureHash(nnet_)) {
+      KALDI_WARN << "Not using the computation cache, since it was written "
+                 << "for a network with a different structure.";
+      read_cache = false;
+    }
+    ReadToken(is, binary, &token);
+  }
+  // else it was written before we stored the hash; we have to trust it.
 
   if (read_cache) {
+    if (token != "<ComputationCacheSize>")
+      KALDI_ERR << "Expected token <ComputationCacheSize>, got " << token;
     int32 computation_cache_size;
-    ExpectToken(is, binary, "<ComputationCacheSize>");
     ReadBasicType(is, binary, &computation_cache_size);
     KALDI_ASSERT(computation_cache_size >= 0);
-    computation_cache_.clear();
-    access_queue_.clear();
+    ClearCache();
     ExpectToken(is, binary, "<ComputationCache>");
     for (size_t c = 0; c < computation_cache_size; c++) {
       ComputationRequest *request = new ComputationRequest();
@@ -534,6 +558,8 @@ void CachingOptimizingCompiler::ReadCache(std::istream &is, bool binary) {
 
 void CachingOptimizingCompiler::WriteCache(std::ostream &os, bool binary) const {
   opt_config_.Write(os, binary);
+  WriteToken(os, binary, "<NnetStructureHash>");
+  WriteBasicType(os, binary, NnetStructureHash(nnet_));
   WriteToken(os, binary, "<ComputationCacheSize>");
   WriteBasicType(os, binary, static_cast<int32>(computation_cache_.size()));
   WriteToken(os, binary, "<ComputationCache>");
@@ -552,67 +578,217 @@ void CachingOptimizingCompiler::UpdateAccessQueue(CacheType::iterator &cit) {
                        cit->second.second);
 }
 
-CachingOptimizingCompiler::~CachingOptimizingCompiler() {
+void CachingOptimizingCompiler::ClearCache() {
   CacheType::const_iterator itr = computation_cache_.begin(),
       end = computation_cache_.end();
   for (; itr !=end; ++itr) {
     delete itr->first;
-    delete itr->second.first;
+    if (num_users_.count(itr->second.first) != 0)
+      purged_.insert(itr->second.first);
+    else
+      delete itr->second.first;
   }
+  computation_cache_.clear();
+  access_queue_.clear();
+}
+
+CachingOptimizingCompiler::~CachingOptimizingCompiler() {
+  KALDI_ASSERT(in_progress_.empty());
+  if (!num_users_.empty())
+    KALDI_WARN << "Destroying CachingOptimizingCompiler while "
+               << num_users_.size() << " computations are still in use.";
+  num_users_.clear();
+  ClearCache();
+  std::set<const NnetComputation*>::const_iterator pitr = purged_.begin();
+  for (; pitr != purged_.end(); ++pitr)
+    delete *pitr;
 }
 
 const NnetComputation* CachingOptimizingCompiler::Compile(
-    const ComputationRequest  &in_request) {
-  NnetComputation *computation;
-  ComputationRequest *request;
-  // find computation in the cache
-  CacheType::iterator cit = computation_cache_.find(&in_request);
-  if (cit == computation_cache_.end()) {
-    // if not found, compile and update cache
-    request = new ComputationRequest;
-    *request = in_request;
-    Compiler compiler(*request, nnet_);
-    CompilerOptions opts;
-    computation = new NnetComputation;
-    compiler.CreateComputation(opts, computation);
-
-    int32 verbose_cutoff = 4;
-    if (GetVerboseLevel() >= verbose_cutoff) {
-      std::ostringstream os1;
-      request->Print(os1);
-      KALDI_LOG << "Computation request is " << os1.str();
-      std::ostringstream os2;
-      computation->Print(os2, nnet_);
-      KALDI_LOG << "Generated computation is: " << os2.str();
-    }
-    { // some checking.
-      CheckComputationOptions check_config;
-      // we can do the rewrite check since it's before optimization.
-      check_config.check_rewrite = true;
-      ComputationChecker checker(check_config, nnet_, *computation);
-      checker.Check();
-    }
-    Optimize(opt_config_, nnet_, *request, computation);
-    if (GetVerboseLevel() >= verbose_cutoff) {
-      std::ostringstream os;
-      computation->Print(os, nnet_);
-      KALDI_LOG << "Optimized computation is: " << os.str();
-    }
-    {  // check the computation again.
-      CheckComputationOptions check_config;
-      ComputationChecker checker(check_config, nnet_, *computation);
-      checker.Check();
+    const ComputationRequest &request) {
+  mutex_.Lock();
+  const NnetComputation *computation;
+  try {
+    computation = CompileInternal(request);
+  } catch (...) {
+    mutex_.Unlock();
+    throw;
+  }
+  mutex_.Unlock();
+  return computation;
+}
+
+const NnetComputation* CachingOptimizingCompiler::Acquire(
+    const ComputationRequest &request) {
+  mutex_.Lock();
+  const NnetComputation *computation;
+  try {
+    computation = CompileInternal(request);
+  } catch (...) {
+    mutex_.Unlock();
+    throw;
+  }
+  num_users_[computation]++;
+  mutex_.Unlock();
+  return computation;
+}
+
+void CachingOptimizingCompiler::Release(const NnetComputation *computation) {
+  mutex_.Lock();
+  std::map<const NnetComputation*, int32>::iterator iter =
+      num_users_.find(computation);
+  KALDI_ASSERT(iter != num_users_.end() && iter->second > 0);
+  if (--(iter->second) == 0) {
+    num_users_.erase(iter);
+    if (purged_.erase(computation) != 0)
+      delete computation;
+  }
+  mutex_.Unlock();
+}
+
+NnetComputation* CachingOptimizingCompiler::CompileInternal(
+    const ComputationRequest &in_request) {
+  while (true) {
+    // find computation in the cache
+    CacheType::iterator cit = computation_cache_.find(&in_request);
+    if (cit != computation_cache_.end()) {
+      // if found, update access queue
+      UpdateAccessQueue(cit);
+      return cit->second.first;
     }
-    computation->ComputeCudaIndexes();
-    UpdateCache(request, computation);
+    InProgressType::iterator pit = in_progress_.find(&in_request);
+    if (pit == in_progress_.end())
+      break;
+    // Another thread is compiling this request; wait for it, then look in
+    // the cache again.
+    RequestInProgress *in_progress = pit->second;
+    in_progress->num_waiting++;
+    mutex_.Unlock();
+    in_progress->done.Wait();
+    mutex_.Lock();
+    KALDI_ASSERT(in_progress->finished);
+    bool failed = in_progress->failed;
+    if (--(in_progress->num_waiting) == 0)
+      delete in_progress;
+    if (failed)
+      KALDI_ERR << "Compiling the computation failed in another thread.";
+  }
+
+  // if not found, compile (with mutex_ unlocked, so that other threads can
+  // use the cache or compile other requests in the meantime) and update
+  // cache.
+  ComputationRequest *request = new ComputationRequest(in_request);
+  RequestInProgress *in_progress = new RequestInProgress();
+  in_progress_[request] = in_progress;
+  mutex_.Unlock();
+  NnetComputation *computation;
+  try {
+    computation = CreateComputation(*request);
+  } catch (...) {
+    // The waiting threads will throw too; we rethrow with mutex_ locked, as
+    // our caller expects.
+    mutex_.Lock();
+    in_progress_.erase(request);
+    delete request;
+    in_progress->failed = true;
+    FinishRequest(in_progress);
+    throw;
+  }
+  mutex_.Lock();
+  in_progress_.erase(request);
+  UpdateCache(request, computation);
+  FinishRequest(in_progress);
+  return computation;
+}
+
+void CachingOptimizingCompiler::FinishRequest(RequestInProgress *in_progress) {
+  in_progress->finished = true;
+  if (in_progress->num_waiting == 0) {
+    delete in_progress;
   } else {
-    // if found, update access queue
-    computation = cit->second.first;
-    UpdateAccessQueue(cit);
+    for (int32 i = 0; i < in_progress->num_waiting; i++)
+      in_progress->done.Signal();
+  }
+}
+
+NnetComputation* CachingOptimizingCompiler::CreateComputation(
+    const ComputationRequest &request) {
+  Compiler compiler(request, nnet_);
+  CompilerOptions opts;
+  NnetComputation *computation = new NnetComputation;
+  compiler.CreateComputation(opts, computation);
+
+  int32 verbose_cutoff = 4;
+  if (GetVerboseLevel() >= verbose_cutoff) {
+    std::ostringstream os1;
+    request.Print(os1);
+    KALDI_LOG << "Computation request is " << os1.str();
+    std::ostringstream os2;
+    computation->Print(os2, nnet_);
+    KALDI_LOG << "Generated computation is: " << os2.str();
+  }
+  { // some checking.
+    CheckComputationOptions check_config;
+    // we can do the rewrite check since it's before optimization.
+    check_config.check_rewrite = true;
+    ComputationChecker checker(check_config, nnet_, *computation);
+    checker.Check();
+  }
+  Optimize(opt_config_, nnet_, request, computation);
+  if (GetVerboseLevel() >= verbose_cutoff) {
+    std::ostringstream os;
+    computation->Print(os, nnet_);
+    KALDI_LOG << "Optimized computation is: " << os.str();
+  }
+  {  // check the computation again.
+    CheckComputationOptions check_config;
+    ComputationChecker checker(check_config, nnet_, *computation);
+    checker.Check();
   }
+  computation->ComputeCudaIndexes();
   return computation;
 }
 
 
+void ReadComputationCache(const ComputationCacheOptions &opts,
+                          CachingOptimizingCompiler *compiler) {
+  if (opts.read_cache == "")
+    return;
+  bool binary;
+  Input ki;
+  if (!ki.Open(opts.read_cache, &binary)) {
+    KALDI_WARN << "Could not open computation cache " << opts.read_cache
+               << " (this is expected the first time).";
+    return;
+  }
+  compiler->ReadCache(ki.Stream(), binary);
+  KALDI_LOG << "Read computation cache from " << opts.read_cache;
+}
+
+void WriteComputationCache(const ComputationCacheOptions &opts,
+                           const CachingOptimizingCompiler &compiler) {
+  if (opts.write_cache == "")
+    return;
+  std::string filename = opts.write_cache;
+  bool use_rename = (ClassifyWxfilename(filename) == kFileOutput);
+  if (use_rename) {
+    // Write to a temporary file in the same directory, and rename it, since
+    // other processes may be reading the cache right now.
+    std::ostringstream tmp_name;
+    tmp_name << opts.write_cache << ".tmp." << getpid();
+    filename = tmp_name.str();
+  }
+  {
+    Output ko(filename, opts.binary_write_cache);
+    compiler.WriteCache(ko.Stream(), opts.binary_write_cache);
+  }
+  if (use_rename && std::rename(filename.c_str(),
+                                opts.write_cache.c_str()) != 0)
+    KALDI_ERR << "Could not rename " << filename << " to "
+              << opts.write_cache;
+  KALDI_LOG << "Wrote computation cache to " << opts.write_cache;
+}
+
+
 } // namespace nnet3
 } // namespace kaldi
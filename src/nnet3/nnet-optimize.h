@@ -23,8 +23,12 @@
 
 #include "nnet3/nnet-compile.h"
 #include "nnet3/nnet-analyze.h"
+#include "thread/kaldi-mutex.h"
+#include "thread/kaldi-semaphore.h"
 
 #include <list>
+#include <map>
+#include <set>
 
 namespace kaldi {
 namespace nnet3 {
@@ -133,6 +137,20 @@ struct ComputationRequestPtrEqual {
 /// This class enables you to do the compilation and optimization in one call,
 /// and also ensures that if the ComputationRequest is identical to the previous
 /// one, the compilation process is not repeated.
+///
+/// Compile() may be called from several threads at once, so one object can be
+/// shared between decoding threads.  Different requests are compiled in
+/// parallel; a thread that needs a computation which another thread is
+/// currently compiling waits for it instead of compiling it again.  However,
+/// the pointer Compile() returns may be invalidated when another thread's
+/// Compile() purges that computation from the cache; if you share this object
+/// between threads, get your computations via class CachedComputation, which
+/// prevents that.
+///
+/// The cache may be written to disk and read back by later processes (see
+/// ReadCache() and WriteCache(), and struct ComputationCacheOptions); the
+/// file records a hash of the network structure (NnetStructureHash()) and the
+/// optimization options, and the cache is not used if they don't match.
 class CachingOptimizingCompiler {
  public:
   CachingOptimizingCompiler(const Nnet &nnet,
@@ -151,12 +169,40 @@ class CachingOptimizingCompiler {
   /// It calls ComputeCudaIndexes() for you, because you wouldn't
   /// be able to do this on a const object.
   const NnetComputation* Compile(const ComputationRequest &request);
+  /// ReadCache() and WriteCache() must not be called while other threads
+  /// are using this object.  ReadCache() replaces the current contents of
+  /// the cache, unless the cache was written for a network with a different
+  /// structure or with different optimization options, in which case it
+  /// prints a warning and leaves the cache unchanged.
   void ReadCache(std::istream &is, bool binary);
   void WriteCache(std::ostream &os, bool binary) const;
  private:
+  friend class CachedComputation;
+
+  // Does the work of Compile(); must be called with mutex_ locked, which it
+  // unlocks while compiling.  If compilation throws (in this thread or in
+  // another thread compiling the same request), it rethrows with mutex_
+  // locked.
+  NnetComputation* CompileInternal(const ComputationRequest &request);
+
+  // Compiles and optimizes the computation; called without mutex_ locked.
+  NnetComputation* CreateComputation(const ComputationRequest &request);
+
+  // Deletes everything in the cache.
+  void ClearCache();
+
+  // Like Compile(), but the computation will not be deleted until
+  // Release(computation) has been called as many times as Acquire()
+  // returned it.  Called by class CachedComputation.
+  const NnetComputation* Acquire(const ComputationRequest &request);
+  void Release(const NnetComputation *computation);
+
   const Nnet &nnet_;
   NnetOptimizeOptions opt_config_;
 
+  // mutex_ guards all the variables below.
+  Mutex mutex_;
+
   // The access queue for keeping track of the freshness of computation.
   // Most-recently-accessed computation is at the end, and
   // least-recently-accessed computaiton is at the beginning.
@@ -185,6 +231,97 @@ class CachingOptimizingCompiler {
   // This configuration value determines how many unique Computations
   // to cache in our most-recently-used cache.
   int32 cache_capacity_;
+
+  // The number of users of each computation that has been returned by
+  // Acquire() and not yet released (computations with no users are not
+  // present).
+  std::map<const NnetComputation*, int32> num_users_;
+  // Computations that were purged from the cache while they still had users;
+  // they are deleted by Release() when the last user is done with them.
+  std::set<const NnetComputation*> purged_;
+
+  // Records a request that some thread is currently compiling, so that other
+  // threads that need it can wait.  The compiling thread signals "done" once
+  // for each waiting thread; the last thread to use this object deletes it.
+  struct RequestInProgress {
+    Semaphore done;
+    int32 num_waiting;
+    bool finished;
+    bool failed;  // True if the compilation threw.
+    RequestInProgress(): num_waiting(0), finished(false), failed(false) { }
+  };
+  typedef unordered_map<const ComputationRequest*, RequestInProgress*,
+    ComputationRequestHasher, ComputationRequestPtrEqual> InProgressType;
+  // The requests currently being compiled; the keys are owned by the
+  // compiling threads.
+  InProgressType in_progress_;
+
+  // Called by the compiling thread, with mutex_ locked, when it is done with
+  // "in_progress": wakes up the waiting threads, or deletes it if there are
+  // none.
+  void FinishRequest(RequestInProgress *in_progress);
+};
+
+
+/// Options for programs that want the computations compiled by a
+/// CachingOptimizingCompiler to be saved to disk and reused by later runs, so
+/// that short-lived processes don't have to compile them again.
+struct ComputationCacheOptions {
+  std::string read_cache;
+  std::string write_cache;
+  bool binary_write_cache;
+
+  ComputationCacheOptions(): binary_write_cache(true) { }
+
+  void Register(OptionsItf *opts) {
+    opts->Register("read-cache", &read_cache, "If set, the location from "
+                   "which to read previously compiled computations (it is "
+                   "not an error if it does not exist yet).  Ignored if it "
+                   "was written for a network with a different structure.");
+    opts->Register("write-cache", &write_cache, "If set, the location to "
+                   "which to write the compiled computations at exit, for use "
+                   "with --read-cache by later runs.  May be the same as "
+                   "--read-cache.");
+    opts->Register("binary-write-cache", &binary_write_cache, "Write "
+                   "computation cache in binary mode");
+  }
+};
+
+/// Reads the cache of "compiler" from opts.read_cache, if set.  It only warns
+/// if the file cannot be read, since the first run will not find it.
+void ReadComputationCache(const ComputationCacheOptions &opts,
+                          CachingOptimizingCompiler *compiler);
+
+/// Writes the cache of "compiler" to opts.write_cache, if set.  If it is an
+/// ordinary file, it is written under a temporary name and then renamed, so
+/// that processes that read it at the same time see either the old or the
+/// new version.
+void WriteComputationCache(const ComputationCacheOptions &opts,
+                           const CachingOptimizingCompiler &compiler);
+
+/// This class gets a computation from a CachingOptimizingCompiler that may be
+/// shared between threads, and makes sure the computation stays valid (is not
+/// purged from the cache by other threads) while this object exists.
+/// Example:
+/// \code
+///   CachedComputation computation(&compiler, request);
+///   NnetComputer computer(compute_opts, computation.Computation(), nnet, NULL);
+/// \endcode
+/// Make sure the NnetComputer is destroyed first, as it holds a reference to
+/// the computation.
+class CachedComputation {
+ public:
+  CachedComputation(CachingOptimizingCompiler *compiler,
+                    const ComputationRequest &request):
+      compiler_(compiler), computation_(compiler->Acquire(request)) { }
+
+  const NnetComputation &Computation() const { return *computation_; }
+
+  ~CachedComputation() { compiler_->Release(computation_); }
+ private:
+  CachingOptimizingCompiler *compiler_;
+  const NnetComputation *computation_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(CachedComputation);
 };
 
 
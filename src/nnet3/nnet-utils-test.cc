@@ -100,6 +100,53 @@ void UnitTestConvertRepeatedToBlockAffineComposite() {
   }
 }
 
+void UnitTestNnetStructureHash() {
+  for (int32 n = 0; n < 10; n++) {
+    struct NnetGenerationOptions gen_config;
+    std::vector<std::string> configs;
+    GenerateConfigSequence(gen_config, &configs);
+    Nnet nnet;
+    std::istringstream is(configs[0]);
+    nnet.ReadConfig(is);
+
+    // changing the parameters should not change the hash.
+    Nnet nnet2(nnet);
+    PerturbParams(0.1, &nnet2);
+    KALDI_ASSERT(NnetStructureHash(nnet) == NnetStructureHash(nnet2));
+
+    // changing the structure should.
+    std::ostringstream os;
+    os << "input-node name=extra-input dim=" << RandInt(1, 10) << "\n"
+       << "output-node name=extra-output input=extra-input\n";
+    std::istringstream is2(os.str());
+    nnet2.ReadConfig(is2);
+    KALDI_ASSERT(NnetStructureHash(nnet) != NnetStructureHash(nnet2));
+  }
+  {
+    // nor should the parameters of components that are not updatable (the
+    // Info() of FixedAffineComponent includes statistics of them).
+    std::istringstream is("input-node name=input dim=4\n"
+                          "component name=fixed type=AffineComponent "
+                          "input-dim=4 output-dim=3\n"
+                          "component-node name=fixed component=fixed "
+                          "input=input\n"
+                          "output-node name=output input=fixed\n");
+    Nnet nnet;
+    nnet.ReadConfig(is);
+    Nnet nnet2(nnet);
+    CuMatrix<BaseFloat> mat(3, 5);
+    mat.SetRandn();
+    FixedAffineComponent *fixed = new FixedAffineComponent();
+    fixed->Init(mat);
+    nnet.SetComponent(0, fixed);
+    mat.Scale(2.0);
+    FixedAffineComponent *fixed2 = new FixedAffineComponent();
+    fixed2->Init(mat);
+    nnet2.SetComponent(0, fixed2);
+    KALDI_ASSERT(NnetStructureHash(nnet) == NnetStructureHash(nnet2));
+  }
+}
+
 } // namespace nnet3
 } // namespace kaldi
 
@@ -111,6 +158,7 @@ int main() {
   UnitTestNnetContext();
   UnitTestConvertRepeatedToBlockAffine();
   UnitTestConvertRepeatedToBlockAffineComposite();
+  UnitTestNnetStructureHash();
 
   KALDI_LOG << "Nnet tests succeeded.";
 
@@ -494,6 +494,32 @@ std::string NnetInfo(const Nnet &nnet) {
   return ostr.str();
 }
 
+int64 NnetStructureHash(const Nnet &nnet) {
+  std::ostringstream ostr;
+  // nnet.Info() describes the nodes and then has one line per component; we
+  // keep the former (note, component-node lines start with "component-node").
+  std::istringstream info(nnet.Info());
+  std::string line;
+  while (std::getline(info, line))
+    if (line.compare(0, 15, "component name=") != 0)
+      ostr << line << '\n';
+  for (int32 c = 0; c < nnet.NumComponents(); c++) {
+    const Component *comp = nnet.GetComponent(c);
+    ostr << nnet.GetComponentName(c) << ' ' << comp->Type() << ' '
+         << comp->InputDim() << ' ' << comp->OutputDim() << ' '
+         << comp->Properties() << '\n';
+    // What a non-simple component does to the indexes depends on its
+    // configuration (e.g. the periods of StatisticsExtractionComponent),
+    // which is all that its Info() contains.  The Info() of simple
+    // components may contain statistics of the parameters, even if they are
+    // fixed (e.g. FixedAffineComponent), so we don't use it.
+    if (!(comp->Properties() & kSimpleComponent))
+      ostr << comp->Info() << '\n';
+  }
+  StringHasher hasher;
+  return static_cast<int64>(hasher(ostr.str()));
+}
+
 
 } // namespace nnet3
 } // namespace kaldi
@@ -174,6 +174,14 @@ void ConvertRepeatedToBlockAffine(Nnet *nnet);
 /// Info() function (we need this in the CTC code).
 std::string NnetInfo(const Nnet &nnet);
 
+/// Returns a hash of the structure of the network: its nodes, and the types,
+/// dimensions and properties of its components (and, for components that are
+/// not simple, their configuration), but not their parameters, whether
+/// updatable or not.  Networks with the same hash give the same compiled
+/// computations, so this is used to check that a cache of computations read
+/// from disk matches the network.
+int64 NnetStructureHash(const Nnet &nnet);
+
 
 } // namespace nnet3
 } // namespace kaldi
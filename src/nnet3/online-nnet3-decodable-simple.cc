@@ -0,0 +1,264 @@
+// nnet3/online-nnet3-decodable-simple.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nnet3/online-nnet3-decodable-simple.h"
+#include "nnet3/nnet-utils.h"
+
+namespace kaldi {
+namespace nnet3 {
+
+DecodableNnet3SimpleOnline::DecodableNnet3SimpleOnline(
+    const AmNnetSimple &am_nnet,
+    const TransitionModel &trans_model,
+    const DecodableNnet3OnlineOptions &opts,
+    CachingOptimizingCompiler *compiler,
+    OnlineFeatureInterface *input_features,
+    OnlineFeatureInterface *ivector_features):
+    input_features_(input_features),
+    ivector_features_(ivector_features),
+    am_nnet_(am_nnet),
+    trans_model_(trans_model),
+    opts_(opts),
+    feat_dim_(input_features->Dim()),
+    left_context_(am_nnet.LeftContext()),
+    right_context_(am_nnet.RightContext()),
+    num_pdfs_(am_nnet.GetNnet().OutputDim("output")),
+    compiler_(compiler),
+    current_log_post_offset_(-1),
+    cached_input_offset_(0) {
+  KALDI_ASSERT(compiler != NULL && IsSimpleNnet(am_nnet.GetNnet()));
+  if (feat_dim_ != am_nnet.InputDim())
+    KALDI_ERR << "Neural net expects 'input' features with dimension "
+              << am_nnet.InputDim() << " but you provided " << feat_dim_;
+  int32 ivector_dim = (ivector_features != NULL ? ivector_features->Dim() : 0),
+      nnet_ivector_dim = std::max<int32>(0, am_nnet.IvectorDim());
+  if (ivector_dim != nnet_ivector_dim)
+    KALDI_ERR << "Neural net expects 'ivector' features with dimension "
+              << nnet_ivector_dim << " but you provided " << ivector_dim;
+  log_priors_ = am_nnet.Priors();
+  KALDI_ASSERT((log_priors_.Dim() == 0 || log_priors_.Dim() == num_pdfs_) &&
+               "Priors in neural network must match with num-pdfs");
+  log_priors_.ApplyLog();
+  CheckAndFixConfigs();
+}
+
+
+BaseFloat DecodableNnet3SimpleOnline::LogLikelihood(int32 subsampled_frame,
+                                                    int32 index) {
+  ComputeForFrame(subsampled_frame);
+  int32 pdf_id = trans_model_.TransitionIdToPdf(index);
+  KALDI_ASSERT(subsampled_frame >= current_log_post_offset_);
+  return current_log_post_(subsampled_frame - current_log_post_offset_,
+                           pdf_id);
+}
+
+
+bool DecodableNnet3SimpleOnline::IsLastFrame(int32 subsampled_frame) const {
+  int32 features_ready = input_features_->NumFramesReady();
+  if (features_ready == 0 ||
+      !input_features_->IsLastFrame(features_ready - 1))
+    return false;
+  return (subsampled_frame == NumFramesReady() - 1);
+}
+
+int32 DecodableNnet3SimpleOnline::NumFramesReady() const {
+  int32 features_ready = input_features_->NumFramesReady();
+  if (features_ready == 0)
+    return 0;
+  bool input_finished = input_features_->IsLastFrame(features_ready - 1);
+  int32 num_frames;
+  if (opts_.pad_input) {
+    // normal case... we'll pad with duplicates of first + last frame to get
+    // the required left and right context.
+    if (input_finished) num_frames = features_ready;
+    else num_frames = std::max<int32>(0, features_ready - right_context_);
+  } else {
+    num_frames = std::max<int32>(0, features_ready - right_context_ -
+                                 left_context_);
+  }
+  int32 sf = opts_.frame_subsampling_factor;
+  return (num_frames + sf - 1) / sf;
+}
+
+void DecodableNnet3SimpleOnline::ComputeForFrame(int32 subsampled_frame) {
+  KALDI_ASSERT(subsampled_frame >= 0);
+  if (subsampled_frame >= current_log_post_offset_ &&
+      subsampled_frame < current_log_post_offset_ +
+                         current_log_post_.NumRows())
+    return;
+  int32 num_subsampled_frames_ready = NumFramesReady();
+  KALDI_ASSERT(subsampled_frame < num_subsampled_frames_ready);
+
+  int32 sf = opts_.frame_subsampling_factor,
+      num_subsampled_frames = std::min<int32>(
+          opts_.frames_per_chunk / sf,
+          num_subsampled_frames_ready - subsampled_frame),
+      first_output_frame = subsampled_frame * sf,
+      last_output_frame = first_output_frame + (num_subsampled_frames - 1) * sf;
+  // If we are not padding, output frame t is centered on input frame
+  // t + left_context_.
+  int32 offset = (opts_.pad_input ? 0 : left_context_),
+      input_frame_begin = first_output_frame + offset - left_context_,
+      input_frame_end = last_output_frame + offset + right_context_ + 1;
+
+  Matrix<BaseFloat> input_feats;
+  GetInputFeatures(input_frame_begin, input_frame_end, &input_feats);
+
+  Vector<BaseFloat> ivector;
+  if (ivector_features_ != NULL) {
+    // Use the most recent iVector that is available for the input we have;
+    // the iVector is estimated online so later ones are better.
+    int32 ivector_frame = std::min<int32>(
+        std::min<int32>(input_frame_end, input_features_->NumFramesReady()),
+        ivector_features_->NumFramesReady()) - 1;
+    KALDI_ASSERT(ivector_frame >= 0);
+    ivector.Resize(ivector_features_->Dim(), kUndefined);
+    ivector_features_->GetFrame(ivector_frame, &ivector);
+  }
+  DoNnetComputation(input_frame_begin - offset, input_feats, ivector,
+                    first_output_frame, num_subsampled_frames);
+  current_log_post_offset_ = subsampled_frame;
+}
+
+void DecodableNnet3SimpleOnline::GetInputFeatures(
+    int32 input_frame_begin, int32 input_frame_end,
+    Matrix<BaseFloat> *input_feats) {
+  int32 features_ready = input_features_->NumFramesReady(),
+      cache_begin = cached_input_offset_,
+      cache_end = cached_input_offset_ + cached_input_feats_.NumRows();
+  KALDI_ASSERT(features_ready > 0 && input_frame_end > input_frame_begin);
+  input_feats->Resize(input_frame_end - input_frame_begin, feat_dim_,
+                      kUndefined);
+  // The frames that are not cached are got with a single GetFrames() call.
+  std::vector<int32> frames_to_get, rows_to_get;
+  for (int32 t = input_frame_begin; t < input_frame_end; t++) {
+    int32 t_modified = t;
+    // The next two if-statements take care of "pad_input"
+    if (t_modified < 0)
+      t_modified = 0;
+    if (t_modified >= features_ready)
+      t_modified = features_ready - 1;
+    if (t_modified >= cache_begin && t_modified < cache_end) {
+      input_feats->Row(t - input_frame_begin).CopyFromVec(
+          cached_input_feats_.Row(t_modified - cache_begin));
+    } else {
+      frames_to_get.push_back(t_modified);
+      rows_to_get.push_back(t - input_frame_begin);
+    }
+  }
+  if (!frames_to_get.empty()) {
+    Matrix<BaseFloat> new_feats(frames_to_get.size(), feat_dim_, kUndefined);
+    input_features_->GetFrames(frames_to_get, &new_feats);
+    for (size_t i = 0; i < rows_to_get.size(); i++)
+      input_feats->Row(rows_to_get[i]).CopyFromVec(new_feats.Row(i));
+  }
+  // Remember the real (not padded) frames for use as the left context of the
+  // next chunk.
+  int32 real_begin = std::max<int32>(input_frame_begin, 0),
+      real_end = std::min<int32>(input_frame_end, features_ready);
+  if (real_end > real_begin) {
+    cached_input_feats_.Resize(real_end - real_begin, feat_dim_, kUndefined);
+    cached_input_feats_.CopyFromMat(
+        input_feats->RowRange(real_begin - input_frame_begin,
+                              real_end - real_begin));
+    cached_input_offset_ = real_begin;
+  }
+}
+
+void DecodableNnet3SimpleOnline::DoNnetComputation(
+    int32 input_t_start,
+    const MatrixBase<BaseFloat> &input_feats,
+    const VectorBase<BaseFloat> &ivector,
+    int32 output_t_start,
+    int32 num_subsampled_frames) {
+  ComputationRequest request;
+  request.need_model_derivative = false;
+  request.store_component_stats = false;
+
+  // Shift the 'input' and 'output' to a consistent time, so that chunks of
+  // the same size give identical requests and the compiler's cache is used.
+  int32 time_offset = -output_t_start;
+
+  // First add the regular features-- named "input".
+  request.inputs.reserve(2);
+  request.inputs.push_back(
+      IoSpecification("input", time_offset + input_t_start,
+                      time_offset + input_t_start + input_feats.NumRows()));
+  if (ivector.Dim() != 0) {
+    std::vector<Index> indexes;
+    indexes.push_back(Index(0, 0, 0));
+    request.inputs.push_back(IoSpecification("ivector", indexes));
+  }
+  IoSpecification output_spec;
+  output_spec.name = "output";
+  output_spec.has_deriv = false;
+  int32 subsample = opts_.frame_subsampling_factor;
+  output_spec.indexes.resize(num_subsampled_frames);
+  // leave n and x values at 0 (the constructor sets these).
+  for (int32 i = 0; i < num_subsampled_frames; i++)
+    output_spec.indexes[i].t = i * subsample;
+  request.outputs.resize(1);
+  request.outputs[0].Swap(&output_spec);
+
+  const NnetComputation *computation = compiler_->Compile(request);
+  Nnet *nnet_to_update = NULL;  // we're not doing any update.
+  NnetComputer computer(opts_.compute_config, *computation,
+                        am_nnet_.GetNnet(), nnet_to_update);
+
+  CuMatrix<BaseFloat> input_feats_cu(input_feats);
+  computer.AcceptInput("input", &input_feats_cu);
+  CuMatrix<BaseFloat> ivector_feats_cu;
+  if (ivector.Dim() > 0) {
+    ivector_feats_cu.Resize(1, ivector.Dim());
+    ivector_feats_cu.Row(0).CopyFromVec(ivector);
+    computer.AcceptInput("ivector", &ivector_feats_cu);
+  }
+  computer.Forward();
+  CuMatrix<BaseFloat> cu_output;
+  computer.GetOutputDestructive("output", &cu_output);
+  // subtract log-prior (divide by prior)
+  if (log_priors_.Dim() != 0)
+    cu_output.AddVecToRows(-1.0, log_priors_);
+  // apply the acoustic scale
+  cu_output.Scale(opts_.acoustic_scale);
+  current_log_post_.Resize(0, 0);
+  // the following statement just swaps the pointers if we're not using a GPU.
+  cu_output.Swap(&current_log_post_);
+}
+
+void DecodableNnet3SimpleOnline::CheckAndFixConfigs() {
+  static bool warned_subsampling = false;
+  if (opts_.frame_subsampling_factor < 1 ||
+      opts_.frames_per_chunk < 1)
+    KALDI_ERR << "--frame-subsampling-factor and --frames-per-chunk must be > 0";
+  if (opts_.frames_per_chunk % opts_.frame_subsampling_factor != 0) {
+    int32 f = opts_.frame_subsampling_factor,
+        frames_per_chunk = f * ((opts_.frames_per_chunk + f - 1) / f);
+    if (!warned_subsampling) {
+      warned_subsampling = true;
+      KALDI_LOG << "Increasing --frames-per-chunk from "
+                << opts_.frames_per_chunk << " to "
+                << frames_per_chunk << " to make it a multiple of "
+                << "--frame-subsampling-factor="
+                << opts_.frame_subsampling_factor;
+    }
+    opts_.frames_per_chunk = frames_per_chunk;
+  }
+}
+
+} // namespace nnet3
+} // namespace kaldi
@@ -0,0 +1,182 @@
+// nnet3/online-nnet3-decodable-simple.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_NNET3_ONLINE_NNET3_DECODABLE_SIMPLE_H_
+#define KALDI_NNET3_ONLINE_NNET3_DECODABLE_SIMPLE_H_
+
+#include "itf/online-feature-itf.h"
+#include "itf/decodable-itf.h"
+#include "hmm/transition-model.h"
+#include "nnet3/nnet-optimize.h"
+#include "nnet3/nnet-compute.h"
+#include "nnet3/am-nnet-simple.h"
+
+namespace kaldi {
+namespace nnet3 {
+
+// Note: see also nnet-am-decodable-simple.h, which does the same kind of
+// computation for the case where the whole feature matrix is available.
+
+struct DecodableNnet3OnlineOptions {
+  int32 frame_subsampling_factor;
+  BaseFloat acoustic_scale;
+  bool pad_input;
+  int32 frames_per_chunk;
+  NnetOptimizeOptions optimize_config;
+  NnetComputeOptions compute_config;
+
+  DecodableNnet3OnlineOptions():
+      frame_subsampling_factor(1),
+      acoustic_scale(0.1),
+      pad_input(true),
+      frames_per_chunk(20) { }
+
+  void Register(OptionsItf *opts) {
+    opts->Register("acoustic-scale", &acoustic_scale,
+                   "Scaling factor for acoustic log-likelihoods");
+    opts->Register("pad-input", &pad_input,
+                   "If true, duplicate the first and last frames of input "
+                   "features as required for temporal context, to prevent #frames "
+                   "of output being less than those of input.");
+    opts->Register("frame-subsampling-factor", &frame_subsampling_factor,
+                   "Required if the frame-rate of the output (e.g. in 'chain' "
+                   "models) is less than the frame-rate of the original "
+                   "alignment.");
+    opts->Register("frames-per-chunk", &frames_per_chunk,
+                   "Number of frames in each chunk that is separately evaluated "
+                   "by the neural net.  Measured before any subsampling, if the "
+                   "--frame-subsampling-factor options is used (i.e. counts "
+                   "input frames).  Smaller values reduce latency, larger ones "
+                   "are more efficient.");
+
+    // register the optimization options with the prefix "optimization".
+    ParseOptions optimization_opts("optimization", opts);
+    optimize_config.Register(&optimization_opts);
+
+    // register the compute options with the prefix "computation".
+    ParseOptions compute_opts("computation", opts);
+    compute_config.Register(&compute_opts);
+  }
+};
+
+
+/**
+   This Decodable object for class nnet3::AmNnetSimple takes feature input from
+   class OnlineFeatureInterface, unlike, say, class DecodableAmNnetSimple which
+   takes feature input from a matrix.  The features may be supplied a little at
+   a time, e.g. as audio arrives; the network is evaluated in chunks of
+   opts.frames_per_chunk frames as soon as enough input (including the
+   network's right context) is ready.
+
+   The input frames each chunk needs as left context mostly overlap with the
+   previous chunk's input, so we keep the previous chunk's input features and
+   copy from there instead of asking the feature pipeline for them again.  We
+   also shift the time indexes of every chunk to start at zero, so all the
+   chunks of the same size share one entry in the CachingOptimizingCompiler.
+   The compiler is supplied by the caller and shared by all the utterances,
+   so only the first few chunks of the first utterance trigger compilation.
+
+   The frame indexes used in the DecodableInterface functions (LogLikelihood(),
+   NumFramesReady(), IsLastFrame()) are subsampled frames if
+   opts.frame_subsampling_factor != 1, as for 'chain' models.
+*/
+class DecodableNnet3SimpleOnline: public DecodableInterface {
+ public:
+  /// "input_features" is the main features, and "ivector_features" is the
+  /// iVector features if the nnet takes iVectors (else NULL).  These pointers
+  /// are not owned here.  "compiler" must have been constructed with
+  /// am_nnet.GetNnet() and opts.optimize_config, and must outlive this object;
+  /// it would normally be shared by all the utterances.
+  DecodableNnet3SimpleOnline(const AmNnetSimple &am_nnet,
+                             const TransitionModel &trans_model,
+                             const DecodableNnet3OnlineOptions &opts,
+                             CachingOptimizingCompiler *compiler,
+                             OnlineFeatureInterface *input_features,
+                             OnlineFeatureInterface *ivector_features);
+
+  /// Returns the scaled log likelihood; "subsampled_frame" is measured after
+  /// frame subsampling.
+  virtual BaseFloat LogLikelihood(int32 subsampled_frame, int32 index);
+
+  virtual bool IsLastFrame(int32 subsampled_frame) const;
+
+  virtual int32 NumFramesReady() const;
+
+  /// Indices are one-based!  This is for compatibility with OpenFst.
+  virtual int32 NumIndices() const { return trans_model_.NumTransitionIds(); }
+
+  int32 FrameSubsamplingFactor() const { return opts_.frame_subsampling_factor; }
+
+ private:
+  /// If the neural-network outputs for this frame are not cached, it computes
+  /// them (and possibly for some succeeding frames).
+  void ComputeForFrame(int32 subsampled_frame);
+
+  /// Gets the input features for input frames [input_frame_begin,
+  /// input_frame_end), where frames outside the range of available features
+  /// are replaced by the first or last available frame (only possible if
+  /// opts_.pad_input is true).  Uses and updates cached_input_feats_.
+  void GetInputFeatures(int32 input_frame_begin, int32 input_frame_end,
+                        Matrix<BaseFloat> *input_feats);
+
+  /// Does the nnet computation for the given input features and puts the
+  /// output in current_log_post_.  "first_output_frame" is the first
+  /// (un-subsampled) output frame, "num_subsampled_frames" the number of output
+  /// frames.
+  void DoNnetComputation(int32 input_frame_begin,
+                         const MatrixBase<BaseFloat> &input_feats,
+                         const VectorBase<BaseFloat> &ivector,
+                         int32 first_output_frame,
+                         int32 num_subsampled_frames);
+
+  /// Called from the constructor.
+  void CheckAndFixConfigs();
+
+  OnlineFeatureInterface *input_features_;
+  OnlineFeatureInterface *ivector_features_;
+  const AmNnetSimple &am_nnet_;
+  const TransitionModel &trans_model_;
+  DecodableNnet3OnlineOptions opts_;
+  CuVector<BaseFloat> log_priors_;  // log-priors taken from the model, or
+                                    // empty if the model has no priors.
+  int32 feat_dim_;  // dimensionality of the input features.
+  int32 left_context_;  // Left context of the network (cached here)
+  int32 right_context_;  // Right context of the network (cached here)
+  int32 num_pdfs_;  // Number of pdfs, equals output-dim of the network
+                    // (cached here)
+
+  CachingOptimizingCompiler *compiler_;  // Not owned here.
+
+  // current_log_post_ contains the neural network pseudo-likelihoods (the log
+  // of (prob divided by the prior), scaled by opts.acoustic_scale) for a
+  // range of subsampled frames starting at current_log_post_offset_.
+  Matrix<BaseFloat> current_log_post_;
+  int32 current_log_post_offset_;
+
+  // The (unpadded) input features of the most recently computed chunk, for
+  // input frames starting at cached_input_offset_.  Used to provide the left
+  // context of the next chunk.
+  Matrix<BaseFloat> cached_input_feats_;
+  int32 cached_input_offset_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(DecodableNnet3SimpleOnline);
+};
+
+} // namespace nnet3
+} // namespace kaldi
+
+#endif // KALDI_NNET3_ONLINE_NNET3_DECODABLE_SIMPLE_H_
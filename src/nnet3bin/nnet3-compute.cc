@@ -48,6 +48,7 @@ int main(int argc, char *argv[]) {
 
     NnetSimpleComputationOptions opts;
     opts.acoustic_scale = 1.0; // by default do no scaling in this recipe.
+    ComputationCacheOptions cache_opts;
 
     bool apply_exp = false;
     std::string use_gpu = "yes";
@@ -58,6 +59,7 @@ int main(int argc, char *argv[]) {
                 utt2spk_rspecifier;
     int32 online_ivector_period = 0;
     opts.Register(&po);
+    cache_opts.Register(&po);
 
     po.Register("ivectors", &ivector_rspecifier, "Rspecifier for "
                 "iVectors as vectors (i.e. not estimated online); per utterance "
@@ -93,6 +95,11 @@ int main(int argc, char *argv[]) {
     Nnet nnet;
     ReadKaldiObject(nnet_rxfilename, &nnet);
 
+    // The compiled computations are shared by all utterances, and optionally
+    // saved for later runs.
+    CachingOptimizingCompiler compiler(nnet, opts.optimize_config);
+    ReadComputationCache(cache_opts, &compiler);
+
     RandomAccessBaseFloatMatrixReader online_ivector_reader(
         online_ivector_rspecifier);
     RandomAccessBaseFloatVectorReaderMapped ivector_reader(
@@ -136,7 +143,7 @@ int main(int argc, char *argv[]) {
 
       Vector<BaseFloat> priors;
       NnetDecodableBase nnet_computer(
-          opts, nnet, priors,
+          opts, nnet, priors, &compiler,
           features,
           ivector, online_ivectors,
           online_ivector_period);
@@ -157,6 +164,8 @@ int main(int argc, char *argv[]) {
       num_success++;
     }
 
+    WriteComputationCache(cache_opts, compiler);
+
     double elapsed = timer.Elapsed();
     KALDI_LOG << "Time taken "<< elapsed
               << "s: real-time factor assuming 100 frames/sec is "
@@ -0,0 +1,301 @@
+// nnet3bin/nnet3-latgen-faster-batch.cc
+
+// Copyright 2012-2015   Johns Hopkins University (author: Daniel Povey)
+//                2014   Guoguo Chen
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "tree/context-dep.h"
+#include "hmm/transition-model.h"
+#include "fstext/fstext-lib.h"
+#include "decoder/decoder-wrappers.h"
+#include "nnet3/nnet-batch-compute.h"
+#include "base/timer.h"
+#include "thread/kaldi-task-sequence.h"
+
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    using namespace kaldi::nnet3;
+    typedef kaldi::int32 int32;
+    using fst::SymbolTable;
+    using fst::VectorFst;
+    using fst::Fst;
+    using fst::StdArc;
+
+    const char *usage =
+        "Generate lattices using nnet3 neural net model.  This version uses\n"
+        "multiple decoding threads, and evaluates the neural net on chunks\n"
+        "from several utterances at once (see --minibatch-size), which is\n"
+        "more efficient than nnet3-latgen-faster, especially with a GPU.\n"
+        "Otherwise the interface and behavior is the same as nnet3-latgen-faster.\n"
+        "Usage: nnet3-latgen-faster-batch [options] <nnet-in> <fst-in|fsts-rspecifier> <features-rspecifier>"
+        " <lattice-wspecifier> [ <words-wspecifier> [<alignments-wspecifier>] ]\n";
+    ParseOptions po(usage);
+    Timer timer;
+    bool allow_partial = false;
+    LatticeFasterDecoderConfig config;
+    NnetBatchComputerOptions compute_opts;
+    ComputationCacheOptions cache_opts;
+    TaskSequencerConfig sequencer_config; // has --num-threads option
+    std::string use_gpu = "no";
+
+    std::string word_syms_filename;
+    std::string ivector_rspecifier,
+        online_ivector_rspecifier,
+        utt2spk_rspecifier;
+    int32 online_ivector_period = 0;
+    config.Register(&po);
+    compute_opts.Register(&po);
+    cache_opts.Register(&po);
+    sequencer_config.Register(&po);
+    po.Register("word-symbol-table", &word_syms_filename,
+                "Symbol table for words [for debug output]");
+    po.Register("allow-partial", &allow_partial,
+                "If true, produce output even if end state was not reached.");
+    po.Register("ivectors", &ivector_rspecifier, "Rspecifier for "
+                "iVectors as vectors (i.e. not estimated online); per utterance "
+                "by default, or per speaker if you provide the --utt2spk option.");
+    po.Register("utt2spk", &utt2spk_rspecifier, "Rspecifier for "
+                "utt2spk option used to get ivectors per speaker");
+    po.Register("online-ivectors", &online_ivector_rspecifier, "Rspecifier for "
+                "iVectors estimated online, as matrices.  If you supply this,"
+                " you must set the --online-ivector-period option.");
+    po.Register("online-ivector-period", &online_ivector_period, "Number of frames "
+                "between iVectors in matrices supplied to the --online-ivectors "
+                "option");
+    po.Register("use-gpu", &use_gpu,
+                "yes|no|optional|wait, only has effect if compiled with CUDA");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() < 4 || po.NumArgs() > 6) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+#if HAVE_CUDA==1
+    CuDevice::Instantiate().SelectGpuId(use_gpu);
+#endif
+
+    std::string model_in_filename = po.GetArg(1),
+        fst_in_str = po.GetArg(2),
+        feature_rspecifier = po.GetArg(3),
+        lattice_wspecifier = po.GetArg(4),
+        words_wspecifier = po.GetOptArg(5),
+        alignment_wspecifier = po.GetOptArg(6);
+
+    TransitionModel trans_model;
+    AmNnetSimple am_nnet;
+    {
+      bool binary;
+      Input ki(model_in_filename, &binary);
+      trans_model.Read(ki.Stream(), binary);
+      am_nnet.Read(ki.Stream(), binary);
+    }
+
+    bool determinize = config.determinize_lattice;
+    CompactLatticeWriter compact_lattice_writer;
+    LatticeWriter lattice_writer;
+    if (! (determinize ? compact_lattice_writer.Open(lattice_wspecifier)
+           : lattice_writer.Open(lattice_wspecifier)))
+      KALDI_ERR << "Could not open table for writing lattices: "
+                 << lattice_wspecifier;
+
+    RandomAccessBaseFloatMatrixReader online_ivector_reader(
+        online_ivector_rspecifier);
+    RandomAccessBaseFloatVectorReaderMapped ivector_reader(
+        ivector_rspecifier, utt2spk_rspecifier);
+
+    Int32VectorWriter words_writer(words_wspecifier);
+    Int32VectorWriter alignment_writer(alignment_wspecifier);
+
+    fst::SymbolTable *word_syms = NULL;
+    if (word_syms_filename != "")
+      if (!(word_syms = fst::SymbolTable::ReadText(word_syms_filename)))
+        KALDI_ERR << "Could not read symbol table from file "
+                   << word_syms_filename;
+
+    double tot_like = 0.0;
+    kaldi::int64 frame_count = 0;
+    int32 num_done = 0, num_err = 0;
+    Fst<StdArc> *decode_fst = NULL; // only used if there is a single
+                                          // decoding graph.
+
+    // The compiled computations are optionally saved for later runs.
+    CachingOptimizingCompiler compiler(am_nnet.GetNnet(),
+                                       compute_opts.optimize_config);
+    ReadComputationCache(cache_opts, &compiler);
+
+    // The neural net is evaluated in a single thread, on minibatches of chunks
+    // that come from all the utterances currently being decoded.
+    NnetBatchComputer computer(compute_opts, am_nnet.GetNnet(),
+                               am_nnet.Priors(), &compiler);
+    MultiThreader<NnetBatchComputerThread> compute_thread(
+        1, NnetBatchComputerThread(&computer));
+    // When "terminator" goes out of scope, which is before "compute_thread"
+    // is joined, the compute thread is told to return once it is out of work.
+    // Doing this in a destructor means the program exits with an error,
+    // instead of hanging, if something below throws.
+    NnetBatchComputerTerminator terminator(&computer);
+
+    {
+      TaskSequencer<DecodeUtteranceLatticeFasterClass> sequencer(
+          sequencer_config);
+
+      if (ClassifyRspecifier(fst_in_str, NULL, NULL) == kNoRspecifier) {
+        SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
+        // Input FST is just one FST, not a table of FSTs.
+        decode_fst = fst::ReadFstKaldiMapped(fst_in_str);
+
+        for (; !feature_reader.Done(); feature_reader.Next()) {
+          std::string utt = feature_reader.Key();
+          const Matrix<BaseFloat> &features (feature_reader.Value());
+          if (features.NumRows() == 0) {
+            KALDI_WARN << "Zero-length utterance: " << utt;
+            num_err++;
+            continue;
+          }
+          const Matrix<BaseFloat> *online_ivectors = NULL;
+          const Vector<BaseFloat> *ivector = NULL;
+          if (!ivector_rspecifier.empty()) {
+            if (!ivector_reader.HasKey(utt)) {
+              KALDI_WARN << "No iVector available for utterance " << utt;
+              num_err++;
+              continue;
+            } else {
+              ivector = &ivector_reader.Value(utt);
+            }
+          }
+          if (!online_ivector_rspecifier.empty()) {
+            if (!online_ivector_reader.HasKey(utt)) {
+              KALDI_WARN << "No online iVector available for utterance " << utt;
+              num_err++;
+              continue;
+            } else {
+              online_ivectors = &online_ivector_reader.Value(utt);
+            }
+          }
+
+          LatticeFasterDecoder *decoder =
+              new LatticeFasterDecoder(*decode_fst, config);
+          // The decodable object copies the features and queues its chunks
+          // with "computer" right away.
+          DecodableAmNnetBatch *nnet_decodable = new DecodableAmNnetBatch(
+              &computer, trans_model, features, ivector, online_ivectors,
+              online_ivector_period);
+
+          DecodeUtteranceLatticeFasterClass *task =
+              new DecodeUtteranceLatticeFasterClass(
+                  decoder, nnet_decodable, // takes ownership of these two.
+                  trans_model, word_syms, utt, compute_opts.acoustic_scale,
+                  determinize, allow_partial, &alignment_writer, &words_writer,
+                  &compact_lattice_writer, &lattice_writer,
+                  &tot_like, &frame_count, &num_done, &num_err, NULL);
+
+          sequencer.Run(task); // takes ownership of "task",
+          // and will delete it when done.
+        }
+      } else { // We have different FSTs for different utterances.
+        SequentialTableReader<fst::VectorFstHolder> fst_reader(fst_in_str);
+        RandomAccessBaseFloatMatrixReader feature_reader(feature_rspecifier);
+        for (; !fst_reader.Done(); fst_reader.Next()) {
+          std::string utt = fst_reader.Key();
+          if (!feature_reader.HasKey(utt)) {
+            KALDI_WARN << "Not decoding utterance " << utt
+                       << " because no features available.";
+            num_err++;
+            continue;
+          }
+          const Matrix<BaseFloat> &features = feature_reader.Value(utt);
+          if (features.NumRows() == 0) {
+            KALDI_WARN << "Zero-length utterance: " << utt;
+            num_err++;
+            continue;
+          }
+          const Matrix<BaseFloat> *online_ivectors = NULL;
+          const Vector<BaseFloat> *ivector = NULL;
+          if (!ivector_rspecifier.empty()) {
+            if (!ivector_reader.HasKey(utt)) {
+              KALDI_WARN << "No iVector available for utterance " << utt;
+              num_err++;
+              continue;
+            } else {
+              ivector = &ivector_reader.Value(utt);
+            }
+          }
+          if (!online_ivector_rspecifier.empty()) {
+            if (!online_ivector_reader.HasKey(utt)) {
+              KALDI_WARN << "No online iVector available for utterance " << utt;
+              num_err++;
+              continue;
+            } else {
+              online_ivectors = &online_ivector_reader.Value(utt);
+            }
+          }
+
+          // the "decoder" object takes ownership of the new FST object.
+          LatticeFasterDecoder *decoder = new LatticeFasterDecoder(
+              config, new VectorFst<StdArc>(fst_reader.Value()));
+          DecodableAmNnetBatch *nnet_decodable = new DecodableAmNnetBatch(
+              &computer, trans_model, features, ivector, online_ivectors,
+              online_ivector_period);
+
+          DecodeUtteranceLatticeFasterClass *task =
+              new DecodeUtteranceLatticeFasterClass(
+                  decoder, nnet_decodable, // takes ownership of these two.
+                  trans_model, word_syms, utt, compute_opts.acoustic_scale,
+                  determinize, allow_partial, &alignment_writer, &words_writer,
+                  &compact_lattice_writer, &lattice_writer,
+                  &tot_like, &frame_count, &num_done, &num_err, NULL);
+          sequencer.Run(task); // takes ownership of "task",
+          // and will delete it when done.
+        }
+      }
+      sequencer.Wait();
+    }
+
+    // All the chunks have been computed, so "computer" no longer uses the
+    // compiler.
+    WriteComputationCache(cache_opts, compiler);
+
+    delete decode_fst;
+
+    double elapsed = timer.Elapsed();
+    KALDI_LOG << "Decoded with " << sequencer_config.num_threads
+              << " decoding threads and minibatch-size "
+              << compute_opts.minibatch_size << ".";
+    KALDI_LOG << "Time taken "<< elapsed
+              << "s: real-time factor assuming 100 frames/sec is "
+              << (elapsed * 100.0 / frame_count);
+    KALDI_LOG << "Done " << num_done << " utterances, failed for "
+              << num_err;
+    KALDI_LOG << "Overall log-likelihood per frame is "
+              << (tot_like / frame_count) << " over "
+              << frame_count << " frames.";
+
+    delete word_syms;
+    if (num_done != 0) return 0;
+    else return 1;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
@@ -39,6 +39,7 @@ int main(int argc, char *argv[]) {
     typedef kaldi::int32 int32;
     using fst::SymbolTable;
     using fst::VectorFst;
+    using fst::Fst;
     using fst::StdArc;
 
     const char *usage =
@@ -50,6 +51,7 @@ int main(int argc, char *argv[]) {
     bool allow_partial = false;
     LatticeFasterDecoderConfig config;
     NnetSimpleComputationOptions decodable_opts;
+    ComputationCacheOptions cache_opts;
 
     std::string word_syms_filename;
     std::string ivector_rspecifier,
@@ -58,6 +60,7 @@ int main(int argc, char *argv[]) {
     int32 online_ivector_period = 0;
     config.Register(&po);
     decodable_opts.Register(&po);
+    cache_opts.Register(&po);
     po.Register("word-symbol-table", &word_syms_filename,
                 "Symbol table for words [for debug output]");
     po.Register("allow-partial", &allow_partial,
@@ -95,6 +98,12 @@ int main(int argc, char *argv[]) {
       am_nnet.Read(ki.Stream(), binary);
     }
 
+    // The compiled computations are shared by all utterances, and optionally
+    // saved for later runs.
+    CachingOptimizingCompiler compiler(am_nnet.GetNnet(),
+                                       decodable_opts.optimize_config);
+    ReadComputationCache(cache_opts, &compiler);
+
     bool determinize = config.determinize_lattice;
     CompactLatticeWriter compact_lattice_writer;
     LatticeWriter lattice_writer;
@@ -125,7 +134,7 @@ int main(int argc, char *argv[]) {
       SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
 
       // Input FST is just one FST, not a table of FSTs.
-      VectorFst<StdArc> *decode_fst = fst::ReadFstKaldi(fst_in_str);
+      Fst<StdArc> *decode_fst = fst::ReadFstKaldiMapped(fst_in_str);
 
       {
         LatticeFasterDecoder decoder(*decode_fst, config);
@@ -160,7 +169,7 @@ int main(int argc, char *argv[]) {
           }
 
           DecodableAmNnetSimple nnet_decodable(
-              decodable_opts, trans_model, am_nnet,
+              decodable_opts, trans_model, am_nnet, &compiler,
               features, ivector, online_ivectors,
               online_ivector_period);
 
@@ -220,7 +229,7 @@ int main(int argc, char *argv[]) {
         }
 
         DecodableAmNnetSimple nnet_decodable(
-            decodable_opts, trans_model, am_nnet,
+            decodable_opts, trans_model, am_nnet, &compiler,
             features, ivector, online_ivectors,
             online_ivector_period);
 
@@ -237,6 +246,8 @@ int main(int argc, char *argv[]) {
       }
     }
 
+    WriteComputationCache(cache_opts, compiler);
+
     double elapsed = timer.Elapsed();
     KALDI_LOG << "Time taken "<< elapsed
               << "s: real-time factor assuming 100 frames/sec is "
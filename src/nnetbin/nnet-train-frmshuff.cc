@@ -119,7 +119,9 @@ int main(int argc, char *argv[]) {
 
     kaldi::int64 total_frames = 0;
 
-    SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
+    // The features are read as views, so with the "mmap" rspecifier option
+    // they are not copied before being copied to the GPU.
+    SequentialBaseFloatMatrixViewReader feature_reader(feature_rspecifier);
     RandomAccessPosteriorReader targets_reader(targets_rspecifier);
     RandomAccessBaseFloatVectorReader weights_reader;
     if (frame_weights != "") {
@@ -183,7 +185,8 @@ int main(int argc, char *argv[]) {
           continue;
         }
         // get feature / target pair
-        Matrix<BaseFloat> mat = feature_reader.Value();
+        SubMatrix<BaseFloat> mat(feature_reader.Value());
+        int32 num_frames = mat.NumRows();
         Posterior targets = targets_reader.Value(utt);
         // get per-frame weights
         Vector<BaseFloat> weights;
@@ -205,7 +208,7 @@ int main(int argc, char *argv[]) {
         {
           // add lengths to vector
           std::vector<int32> lenght;
-          lenght.push_back(mat.NumRows());
+          lenght.push_back(num_frames);
           lenght.push_back(targets.size());
           lenght.push_back(weights.Dim());
           // find min, max
@@ -213,7 +216,7 @@ int main(int argc, char *argv[]) {
           int32 max = *std::max_element(lenght.begin(),lenght.end());
           // fix or drop ?
           if (max - min < length_tolerance) {
-            if(mat.NumRows() != min) mat.Resize(min, mat.NumCols(), kCopyData);
+            num_frames = min;
             if(targets.size() != min) targets.resize(min);
             if(weights.Dim() != min) weights.Resize(min, kCopyData);
           } else {
@@ -224,7 +227,8 @@ int main(int argc, char *argv[]) {
           }
         }
         // apply optional feature transform
-        nnet_transf.Feedforward(CuMatrix<BaseFloat>(mat), &feats_transf);
+        nnet_transf.Feedforward(
+            CuMatrix<BaseFloat>(mat.RowRange(0, num_frames)), &feats_transf);
 
         // remove frames with '0' weight from training,
         {
@@ -26,10 +26,12 @@ namespace kaldi {
 
 OnlineDecodableDiagGmmScaled::OnlineDecodableDiagGmmScaled(
     const AmDiagGmm &am, const TransitionModel &trans_model,
-    const BaseFloat scale, OnlineFeatureMatrix *input_feats):  
+    const BaseFloat scale, OnlineFeatureMatrix *input_feats,
+    const StackedAmDiagGmm *stacked_am):
       features_(input_feats), ac_model_(am),
       ac_scale_(scale), trans_model_(trans_model),
-      feat_dim_(input_feats->Dim()), cur_frame_(-1) {
+      feat_dim_(input_feats->Dim()), cur_frame_(-1),
+      stacked_am_(stacked_am), stacked_computer_(NULL) {
   if (!input_feats->IsValidFrame(0)) {
     // It's not safe to throw from a constructor, so please check
     // this condition yourself before reaching this point in the code.
@@ -38,6 +40,10 @@ OnlineDecodableDiagGmmScaled::OnlineDecodableDiagGmmScaled(
   }
   int32 num_pdfs = trans_model_.NumPdfs();
   cache_.resize(num_pdfs, std::pair<int32,BaseFloat>(-1, 0.0));
+  if (stacked_am != NULL) {
+    KALDI_ASSERT(stacked_am->NumPdfs() == am.NumPdfs());
+    stacked_computer_ = new StackedAmDiagGmmComputer(*stacked_am);
+  }
 }
 
 void OnlineDecodableDiagGmmScaled::CacheFrame(int32 frame) {
@@ -50,10 +56,31 @@ void OnlineDecodableDiagGmmScaled::CacheFrame(int32 frame) {
   cur_frame_ = frame;
 }
 
+void OnlineDecodableDiagGmmScaled::CacheFrames(int32 frame) {
+  KALDI_ASSERT(frame >= 0);
+  if (!features_->IsValidFrame(frame))
+    KALDI_ERR << "Request for invalid frame (you need to check IsLastFrame, or, "
+              << "for frame zero, check that the input is valid.";
+  // Only use frames we already have; we don't want to wait for more input.
+  int32 num_frames = 1;
+  while (num_frames < stacked_am_->FrameBatchSize() &&
+         features_->HasFrame(frame + num_frames))
+    num_frames++;
+  block_feats_.Resize(num_frames, feat_dim_, kUndefined);
+  for (int32 i = 0; i < num_frames; i++)
+    block_feats_.Row(i).CopyFromVec(features_->GetFrame(frame + i));
+  stacked_computer_->SetFrames(frame, block_feats_);
+}
+
 BaseFloat OnlineDecodableDiagGmmScaled::LogLikelihood(int32 frame, int32 index) {
+  int32 pdf_id = trans_model_.TransitionIdToPdf(index);
+  if (stacked_computer_ != NULL) {
+    if (!stacked_computer_->HasFrame(frame))
+      CacheFrames(frame);
+    return stacked_computer_->LogLikelihood(frame, pdf_id) * ac_scale_;
+  }
   if (frame != cur_frame_)
     CacheFrame(frame);
-  int32 pdf_id = trans_model_.TransitionIdToPdf(index);
   if (cache_[pdf_id].first == frame)
     return cache_[pdf_id].second;
   BaseFloat ans = ac_model_.LogLikelihood(pdf_id, cur_feats_) * ac_scale_;
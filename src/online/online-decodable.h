@@ -31,13 +31,20 @@ namespace kaldi {
 
 
 
-// A decodable, taking input from an OnlineFeatureInput object on-demand
+// A decodable, taking input from an OnlineFeatureInput object on-demand.
+// If "stacked_am" is not NULL it should be a StackedAmDiagGmm created from
+// "am"; it is then used to compute the likelihoods of each pdf for several
+// frames at once (only frames that have already been read are batched, so it
+// does not add latency).
 class OnlineDecodableDiagGmmScaled : public DecodableInterface {
  public:
   OnlineDecodableDiagGmmScaled(const AmDiagGmm &am,
                                const TransitionModel &trans_model,
                                const BaseFloat scale,
-                               OnlineFeatureMatrix *input_feats);
+                               OnlineFeatureMatrix *input_feats,
+                               const StackedAmDiagGmm *stacked_am = NULL);
+
+  virtual ~OnlineDecodableDiagGmmScaled() { delete stacked_computer_; }
 
   
   /// Returns the log likelihood, which will be negated in the decoder.
@@ -50,6 +57,8 @@ class OnlineDecodableDiagGmmScaled : public DecodableInterface {
 
  private:
   void CacheFrame(int32 frame);
+  // Gives the block of frames starting at "frame" to stacked_computer_.
+  void CacheFrames(int32 frame);
   
   OnlineFeatureMatrix *features_;
   const AmDiagGmm &ac_model_;
@@ -59,6 +68,10 @@ class OnlineDecodableDiagGmmScaled : public DecodableInterface {
   Vector<BaseFloat> cur_feats_;
   int32 cur_frame_;
   std::vector<std::pair<int32, BaseFloat> > cache_;
+  // The following are only used if we were given a StackedAmDiagGmm.
+  const StackedAmDiagGmm *stacked_am_;
+  StackedAmDiagGmmComputer *stacked_computer_;
+  Matrix<BaseFloat> block_feats_;
 
   KALDI_DISALLOW_COPY_AND_ASSIGN(OnlineDecodableDiagGmmScaled);
 };
@@ -356,6 +356,14 @@ class OnlineFeatureMatrix {
   
   bool IsValidFrame (int32 frame); 
 
+  // Returns true if "frame" is in the current batch of features, so that
+  // GetFrame() can be called for it.  Unlike IsValidFrame(), this never reads
+  // more input (which may discard older frames).
+  bool HasFrame(int32 frame) const {
+    return frame >= feat_offset_ &&
+        frame < feat_offset_ + feat_matrix_.NumRows();
+  }
+
   int32 Dim() const { return feat_dim_; }
 
   // GetFrame() will die if it's not a valid frame; you have to
@@ -182,9 +182,6 @@ bool EndpointDetected(const OnlineEndpointConfig &config,
                       BaseFloat final_relative_cost);
 
 
-
-class LatticeFasterOnlineDecoder;
-
 /// returns the number of frames of trailing silence in the best-path traceback
 /// (not using final-probs).  "silence_phones" is a colon-separated list of
 /// integer id's of phones that we consider silence.  We use the the
@@ -253,6 +253,11 @@ void OnlineFeaturePipeline::GetFrame(int32 frame,
   AdaptedFeature()->GetFrame(frame, feat);
 }
 
+void OnlineFeaturePipeline::GetFrames(const std::vector<int32> &frames,
+                                      MatrixBase<BaseFloat> *feats) {
+  AdaptedFeature()->GetFrames(frames, feats);
+}
+
 OnlineFeaturePipeline::~OnlineFeaturePipeline() {
   // Note: the delete command only deletes pointers that are non-NULL.  Not all
   // of the pointers below will be non-NULL.
@@ -128,6 +128,11 @@ void OnlineNnet2FeaturePipeline::GetFrame(int32 frame,
   return final_feature_->GetFrame(frame, feat);
 }
 
+void OnlineNnet2FeaturePipeline::GetFrames(const std::vector<int32> &frames,
+                                           MatrixBase<BaseFloat> *feats) {
+  final_feature_->GetFrames(frames, feats);
+}
+
 void OnlineNnet2FeaturePipeline::SetAdaptationState(
     const OnlineIvectorExtractorAdaptationState &adaptation_state) {
   if (info_.use_ivectors) {
@@ -192,6 +192,8 @@ class OnlineNnet2FeaturePipeline: public OnlineFeatureInterface {
   virtual bool IsLastFrame(int32 frame) const;
   virtual int32 NumFramesReady() const;
   virtual void GetFrame(int32 frame, VectorBase<BaseFloat> *feat);
+  virtual void GetFrames(const std::vector<int32> &frames,
+                         MatrixBase<BaseFloat> *feats);
 
   /// Set the adaptation state to a particular value, e.g. reflecting previous
   /// utterances of the same speaker; this will generally be called after
@@ -231,6 +233,20 @@ class OnlineNnet2FeaturePipeline: public OnlineFeatureInterface {
   /// rescoring the lattices, this may not be much of an issue.
   void InputFinished();
 
+  /// This function returns the part of the feature pipeline that does not
+  /// include the iVectors (i.e. the base features plus pitch, if used).  This
+  /// is for nnet3 setups, where the iVector is a separate input of the
+  /// network.
+  OnlineFeatureInterface *InputFeature() {
+    return feature_plus_optional_pitch_;
+  }
+
+  /// This function returns the iVector part of the feature pipeline, or NULL
+  /// if iVectors are not being used.
+  OnlineFeatureInterface *IvectorFeature() {
+    return ivector_feature_;
+  }
+
   virtual ~OnlineNnet2FeaturePipeline();
  private:
 
@@ -0,0 +1,75 @@
+// thread/kaldi-task-sequence-speed-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-common.h"
+#include "base/timer.h"
+#include "thread/kaldi-task-sequence.h"
+
+namespace kaldi {
+
+// A task that does a small, fixed amount of work, and whose destructor sums up
+// the results; this is like decoding a very short utterance.
+class ShortTaskClass {
+ public:
+  ShortTaskClass(int32 work, double *sum): work_(work), result_(0.0),
+                                           sum_(sum) { }
+  void operator() () {
+    for (int32 i = 0; i < work_; i++)
+      result_ += 1.0 / (i + 1);
+  }
+  ~ShortTaskClass() { *sum_ += result_; }
+ private:
+  int32 work_;
+  double result_;
+  double *sum_;
+};
+
+// Compares the time taken to run many short tasks with a new thread per task,
+// and with the thread pool.
+void TestTaskSequencerSpeed(int32 num_threads, int32 work) {
+  int32 num_tasks = 20000;
+  double time[2], sum[2];
+  for (int32 use_pool = 0; use_pool < 2; use_pool++) {
+    TaskSequencerConfig config;
+    config.num_threads = num_threads;
+    config.use_thread_pool = (use_pool == 1);
+    sum[use_pool] = 0.0;
+    Timer timer;
+    {
+      TaskSequencer<ShortTaskClass> sequencer(config);
+      for (int32 i = 0; i < num_tasks; i++)
+        sequencer.Run(new ShortTaskClass(work, &(sum[use_pool])));
+    }
+    time[use_pool] = timer.Elapsed();
+  }
+  KALDI_ASSERT(ApproxEqual(sum[0], sum[1]));
+  KALDI_LOG << "For num-threads=" << num_threads << ", work=" << work
+            << ", " << num_tasks << " tasks took " << time[0]
+            << " seconds with one thread per task and " << time[1]
+            << " seconds with the thread pool (speedup "
+            << (time[0] / time[1]) << ")";
+}
+
+}  // end namespace kaldi.
+
+int main() {
+  using namespace kaldi;
+  for (int32 num_threads = 1; num_threads <= 8; num_threads *= 2) {
+    TestTaskSequencerSpeed(num_threads, 100);
+    TestTaskSequencerSpeed(num_threads, 10000);
+  }
+}
@@ -51,6 +51,7 @@ void TestTaskSequencer() {
   config.num_threads = 1 + Rand() % 20;
   if (Rand() % 2 == 1 )
     config.num_threads_total = config.num_threads + Rand() % config.num_threads;
+  config.use_thread_pool = (Rand() % 2 == 0);
 
   int32 num_tasks = Rand() % 100;
   
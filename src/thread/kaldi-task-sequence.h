@@ -21,8 +21,10 @@
 #define KALDI_THREAD_KALDI_TASK_SEQUENCE_H_ 1
 
 #include <pthread.h>
+#include <deque>
 #include "thread/kaldi-thread.h"
 #include "itf/options-itf.h"
+#include "thread/kaldi-mutex.h"
 #include "thread/kaldi-semaphore.h"
 
 
@@ -55,12 +57,23 @@ namespace kaldi {
 
    Note: the destructor of TaskSequencer will wait for any remaining jobs that
    are still running and will call the destructors.   
+
+   By default (--use-thread-pool=true) the jobs are not each given their own
+   thread; instead, TaskSequencer keeps a pool of num_threads worker threads
+   for its whole lifetime, and idle workers take the oldest waiting job from a
+   shared queue.  This avoids the cost of creating and joining one thread per
+   job, which is significant when the jobs are short (e.g. decoding short
+   utterances).  The guarantees above (sequential, in-order destructors, and
+   the limit of num_threads_total jobs alive at any time) are the same in
+   both modes.
  */
 
 struct TaskSequencerConfig {
   int32 num_threads;
   int32 num_threads_total;
-  TaskSequencerConfig(): num_threads(1), num_threads_total(0)  { }
+  bool use_thread_pool;
+  TaskSequencerConfig(): num_threads(1), num_threads_total(0),
+                         use_thread_pool(true) { }
   void Register(OptionsItf *opts) {
     opts->Register("num-threads", &num_threads, "Number of actively processing "
                    "threads to run in parallel");
@@ -69,6 +82,10 @@ struct TaskSequencerConfig {
                    "to produce their output.  Controls memory use.  If <= 0, "
                    "defaults to --num-threads plus 20.  Otherwise, must "
                    "be >= num-threads.");
+    opts->Register("use-thread-pool", &use_thread_pool, "If true, run the "
+                   "tasks in a pool of --num-threads persistent worker "
+                   "threads; if false, create a new thread for each task.  "
+                   "The output is the same either way.");
   }
 };
 
@@ -82,10 +99,28 @@ class TaskSequencer {
       threads_avail_(config.num_threads),
       tot_threads_avail_(config.num_threads_total > 0 ? config.num_threads_total :
                          config.num_threads + 20),
-      thread_list_(NULL) {
+      thread_list_(NULL),
+      num_threads_total_(config.num_threads_total > 0 ?
+                         config.num_threads_total : config.num_threads + 20),
+      outputting_(false) {
     KALDI_ASSERT((config.num_threads_total <= 0 ||
                   config.num_threads_total >= config.num_threads) &&
                  "num-threads-total, if specified, must be >= num-threads");
+    KALDI_ASSERT(config.num_threads > 0);
+    if (config.use_thread_pool) {
+      workers_.resize(config.num_threads);
+      for (size_t i = 0; i < workers_.size(); i++) {
+        int32 ret;
+        if ((ret=pthread_create(&(workers_[i]),
+                                NULL, // default attributes
+                                TaskSequencer<C>::RunWorker,
+                                static_cast<void*>(this)))) {
+          const char *c = strerror(ret);
+          KALDI_ERR << "Error creating thread, errno was: "
+                    << (c ? c : "[NULL]");
+        }
+      }
+    }
   }
 
   /// This function takes ownership of the pointer "c", and will delete it
@@ -94,6 +129,19 @@ class TaskSequencer {
     threads_avail_.Wait(); // wait till we have a thread for computation free.
     tot_threads_avail_.Wait(); // this ensures we don't have too many threads
     // waiting on I/O, and consume too much memory.
+
+    if (!workers_.empty()) {
+      // Thread-pool mode: append the job to the list of jobs awaiting output
+      // (which defines the order of the destructors), and to the queue from
+      // which the workers take jobs to run.
+      PoolTask *task = new PoolTask(c);
+      queue_mutex_.Lock();
+      pending_.push_back(task);
+      queue_.push_back(task);
+      queue_mutex_.Unlock();
+      tasks_queued_.Signal();
+      return;
+    }
     
     // put the new RunTaskArgsList object at head of the singly
     // linked list thread_list_.
@@ -110,6 +158,16 @@ class TaskSequencer {
 
   void Wait() { // You call this at the end if it's more convenient
     // than waiting for the destructor.  It waits for all tasks to finish.
+    if (!workers_.empty()) {
+      // Each job holds one count of tot_threads_avail_ until it has been
+      // deleted, so once we have acquired all of them, all jobs are done.
+      for (int32 i = 0; i < num_threads_total_; i++)
+        tot_threads_avail_.Wait();
+      for (int32 i = 0; i < num_threads_total_; i++)
+        tot_threads_avail_.Signal();
+      KALDI_ASSERT(pending_.empty());
+      return;
+    }
     if (thread_list_ != NULL) {
       int ret = pthread_join(thread_list_->thread, NULL);
       if (ret != 0) {
@@ -126,6 +184,23 @@ class TaskSequencer {
   /// The destructor waits for the last thread to exit.
   ~TaskSequencer() {
     Wait();      
+    if (!workers_.empty()) {
+      // A NULL job tells a worker thread to exit.
+      queue_mutex_.Lock();
+      for (size_t i = 0; i < workers_.size(); i++)
+        queue_.push_back(NULL);
+      queue_mutex_.Unlock();
+      for (size_t i = 0; i < workers_.size(); i++)
+        tasks_queued_.Signal();
+      for (size_t i = 0; i < workers_.size(); i++) {
+        int ret = pthread_join(workers_[i], NULL);
+        if (ret != 0) {
+          const char *c = strerror(ret);
+          KALDI_ERR << "Error joining thread, errno was: "
+                    << (c ? c : "[NULL]");
+        }
+      }
+    }
   }
  private:
   struct RunTaskArgsList {
@@ -183,13 +258,75 @@ class TaskSequencer {
     return NULL;
   }
 
+  // The remaining functions and types are used only in thread-pool mode.
+  struct PoolTask {
+    C *c;
+    bool done;  // set after operator () has returned.
+    explicit PoolTask(C *c): c(c), done(false) { }
+  };
+
+  // This static function is what the worker threads run: it repeatedly takes
+  // a job from queue_ and runs it, until it gets a NULL job.
+  static void* RunWorker(void *input) {
+    TaskSequencer *me = static_cast<TaskSequencer*>(input);
+    while (true) {
+      me->tasks_queued_.Wait();
+      me->queue_mutex_.Lock();
+      PoolTask *task = me->queue_.front();
+      me->queue_.pop_front();
+      me->queue_mutex_.Unlock();
+      if (task == NULL)
+        return NULL;
+      (*(task->c))();  // do the computation.
+      me->threads_avail_.Signal();
+      me->OutputFinishedTasks(task);
+    }
+  }
+
+  // Called by a worker after running "task".  Deletes, in order, all the jobs
+  // at the front of pending_ that are done.  If another worker is already
+  // doing this we just mark the task as done and return; that worker will
+  // see it.  This way only one thread at a time runs destructors, and no
+  // worker ever blocks waiting for another job to finish.
+  void OutputFinishedTasks(PoolTask *task) {
+    queue_mutex_.Lock();
+    task->done = true;
+    if (outputting_) {
+      queue_mutex_.Unlock();
+      return;
+    }
+    outputting_ = true;
+    while (!pending_.empty() && pending_.front()->done) {
+      PoolTask *head = pending_.front();
+      pending_.pop_front();
+      queue_mutex_.Unlock();
+      delete head->c;  // this may produce output.
+      delete head;
+      tot_threads_avail_.Signal();
+      queue_mutex_.Lock();
+    }
+    outputting_ = false;
+    queue_mutex_.Unlock();
+  }
+
   Semaphore threads_avail_; // Initialized to the number of threads we are
   // supposed to run with; the function Run() waits on this.
 
   Semaphore tot_threads_avail_; // We use this semaphore to ensure we don't
   // consume too much memory...
   RunTaskArgsList *thread_list_; 
-  
+
+  // The following are used only in thread-pool mode.
+  int32 num_threads_total_;  // the initial value of tot_threads_avail_.
+  std::vector<pthread_t> workers_;  // empty if not in thread-pool mode.
+  Semaphore tasks_queued_;  // number of entries in queue_.
+  Mutex queue_mutex_;  // protects queue_, pending_, outputting_ and the
+                       // "done" members of the tasks.
+  std::deque<PoolTask*> queue_;  // jobs waiting for a worker.
+  std::deque<PoolTask*> pending_;  // jobs not yet deleted, in the order
+                                   // Run() was called.
+  bool outputting_;  // true while a worker is inside the deletion loop of
+                     // OutputFinishedTasks().
 };
 
 } // namespace kaldi
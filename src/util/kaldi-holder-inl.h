@@ -23,6 +23,7 @@
 #define KALDI_UTIL_KALDI_HOLDER_INL_H_
 
 #include <algorithm>
+#include <cstring>
 #include <vector>
 #include <utility>
 #include <string>
@@ -118,6 +119,142 @@ template<class KaldiType> class KaldiObjectHolder {
 };
 
 
+// MatrixViewHolder reads matrices as KaldiObjectHolder<Matrix<Real> > does,
+// but its value is a SubMatrix<Real>.  If the stream was opened with
+// Input::OpenMapped() (the "mmap" rspecifier option) and the matrix is stored
+// uncompressed, in binary, with the same floating-point type, the value points
+// directly into the mapped file and nothing is copied; otherwise the matrix is
+// read into memory owned by the holder.  The mapped memory is read-only, so the
+// value must never be modified (e.g. through a const_cast).  Note: the matrix
+// data in an archive is not necessarily aligned, which does not matter on x86.
+template<class Real> class MatrixViewHolder {
+ public:
+  typedef SubMatrix<Real> T;
+
+  MatrixViewHolder(): view_(NULL) { }
+
+  static bool Write(std::ostream &os, bool binary, const T &t) {
+    InitKaldiOutputStream(os, binary);  // Puts binary header if binary mode.
+    try {
+      t.Write(os, binary);
+      return os.good();
+    } catch(const std::exception &e) {
+      KALDI_WARN << "Exception caught writing Table object: " << e.what();
+      if (!IsKaldiError(e.what())) { std::cerr << e.what(); }
+      return false;  // Write failure.
+    }
+  }
+
+  void Clear() {
+    delete view_;
+    view_ = NULL;
+    mat_.Resize(0, 0);
+  }
+
+  bool Read(std::istream &is) {
+    Clear();
+    bool is_binary;
+    if (!InitKaldiInputStream(is, &is_binary)) {
+      KALDI_WARN << "Reading Table object, failed reading binary header\n";
+      return false;
+    }
+    try {
+      if (is_binary && ReadMapped(is))
+        return true;
+      mat_.Read(is, is_binary);
+      view_ = new SubMatrix<Real>(mat_, 0, mat_.NumRows(), 0, mat_.NumCols());
+      return true;
+    } catch(const std::exception &e) {
+      KALDI_WARN << "Exception caught reading Table object ";
+      if (!IsKaldiError(e.what())) { std::cerr << e.what(); }
+      Clear();
+      return false;
+    }
+  }
+
+  static bool IsReadInBinary() { return true; }
+
+  const T &Value() const {
+    // code error if !view_.
+    if (!view_) KALDI_ERR << "MatrixViewHolder::Value() called wrongly.";
+    return *view_;
+  }
+
+  void Swap(MatrixViewHolder<Real> *other) {
+    // Matrix::Swap() keeps the data where it was, so the views stay valid.
+    mat_.Swap(&(other->mat_));
+    std::swap(view_, other->view_);
+  }
+
+  // If "other" points into mapped memory, the range is a view of it too (the
+  // mapping stays valid after "other" reads the next object; see
+  // MappedInputImpl).  Otherwise the range is copied, because the memory of
+  // "other" is freed when it reads the next object, which the "bg" reader
+  // does while the range is still in use.
+  bool ExtractRange(const MatrixViewHolder<Real> &other,
+                    const std::string &range) {
+    KALDI_ASSERT(other.view_ != NULL);
+    Clear();
+    int32 row_offset, row_size, col_offset, col_size;
+    ParseMatrixRangeSpecifier(range, other.view_->NumRows(),
+                              other.view_->NumCols(), &row_offset, &row_size,
+                              &col_offset, &col_size);
+    SubMatrix<Real> range_view(*(other.view_), row_offset, row_size,
+                               col_offset, col_size);
+    if (other.mat_.NumRows() == 0) {
+      view_ = new SubMatrix<Real>(range_view);
+    } else {
+      mat_.Resize(row_size, col_size, kUndefined);
+      mat_.CopyFromMat(range_view);
+      view_ = new SubMatrix<Real>(mat_, 0, row_size, 0, col_size);
+    }
+    return true;
+  }
+
+  ~MatrixViewHolder() { delete view_; }
+ private:
+  // If "is" reads from mapped memory and the matrix there is in the binary
+  // format of Matrix<Real>, sets view_ to point to it, skips over it and
+  // returns true; otherwise leaves the stream where it was and returns false.
+  bool ReadMapped(std::istream &is) {
+    size_t num_bytes;
+    const char *data = MappedInputData(is, &num_bytes);
+    if (data == NULL)
+      return false;
+    // The format is the token ("FM " or "DM "), then the number of rows and of
+    // columns, each written by WriteBasicType() as a size byte (4) and an
+    // int32, and then the rows.
+    const char *token = (sizeof(Real) == 4 ? "FM " : "DM ");
+    const size_t header_size = 3 + 2 * (1 + sizeof(int32));
+    if (num_bytes < header_size || std::memcmp(data, token, 3) != 0 ||
+        data[3] != sizeof(int32) || data[8] != sizeof(int32))
+      return false;
+    int32 num_rows, num_cols;
+    std::memcpy(&num_rows, data + 4, sizeof(int32));
+    std::memcpy(&num_cols, data + 9, sizeof(int32));
+    if (num_rows < 0 || num_cols < 0)
+      return false;
+    size_t data_size = sizeof(Real) * static_cast<size_t>(num_rows) *
+        static_cast<size_t>(num_cols);
+    if (num_bytes - header_size < data_size)
+      return false;  // Matrix::Read() will report the error.
+    if (data_size == 0) {
+      view_ = new SubMatrix<Real>(NULL, 0, 0, 0);
+    } else {
+      Real *mat_data = reinterpret_cast<Real*>(
+          const_cast<char*>(data + header_size));
+      view_ = new SubMatrix<Real>(mat_data, num_rows, num_cols, num_cols);
+    }
+    is.seekg(header_size + data_size, std::ios_base::cur);
+    return true;
+  }
+
+  Matrix<Real> mat_;  // Holds the matrix when it is not read in place.
+  SubMatrix<Real> *view_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(MatrixViewHolder);
+};
+
+
 // BasicHolder is valid for float, double, bool, and integer
 // types.  There will be a compile time error otherwise, because
 // we make sure that the {Write, Read}BasicType functions do not
@@ -23,20 +23,17 @@
 
 namespace kaldi {
 
-template<class Real>
-bool ExtractObjectRange(const Matrix<Real> &input, const std::string &range,
-                        Matrix<Real> *output) {
-  if (range.empty()) {
+void ParseMatrixRangeSpecifier(const std::string &range,
+                               int32 num_rows, int32 num_cols,
+                               int32 *row_offset, int32 *row_size,
+                               int32 *col_offset, int32 *col_size) {
+  if (range.empty())
     KALDI_ERR << "Empty range specifier.";
-    return false;
-  }
   std::vector<std::string> splits;
   SplitStringToVector(range, ",", false, &splits);
   if (!((splits.size() == 1 && !splits[0].empty()) ||
-        (splits.size() == 2  && !splits[0].empty() && !splits[1].empty()))) {
+        (splits.size() == 2  && !splits[0].empty() && !splits[1].empty())))
     KALDI_ERR << "Invalid range specifier: " << range;
-    return false;
-  }
   std::vector<int32> row_range, col_range;
   bool status = true;
   if (splits[0] != ":")
@@ -46,26 +43,34 @@ bool ExtractObjectRange(const Matrix<Real> &input, const std::string &range,
   }
   if (row_range.size() == 0) {
     row_range.push_back(0);
-    row_range.push_back(input.NumRows() - 1);
+    row_range.push_back(num_rows - 1);
   }
   if (col_range.size() == 0) {
     col_range.push_back(0);
-    col_range.push_back(input.NumCols() - 1);
+    col_range.push_back(num_cols - 1);
   }
   if (!(status && row_range.size() == 2 && col_range.size() == 2 &&
         row_range[0] >= 0 && row_range[0] <= row_range[1] &&
-        row_range[1] < input.NumRows() && col_range[0] >=0 &&
-        col_range[0] <= col_range[1] && col_range[1] < input.NumCols())) {
+        row_range[1] < num_rows && col_range[0] >=0 &&
+        col_range[0] <= col_range[1] && col_range[1] < num_cols))
     KALDI_ERR << "Invalid range specifier: " << range
-              << " for matrix of size " << input.NumRows()
-              << "x" << input.NumCols();
-    return false;
-  }
-  int32 row_size = row_range[1] - row_range[0] + 1,
-        col_size = col_range[1] - col_range[0] + 1;
+              << " for matrix of size " << num_rows
+              << "x" << num_cols;
+  *row_offset = row_range[0];
+  *row_size = row_range[1] - row_range[0] + 1;
+  *col_offset = col_range[0];
+  *col_size = col_range[1] - col_range[0] + 1;
+}
+
+template<class Real>
+bool ExtractObjectRange(const Matrix<Real> &input, const std::string &range,
+                        Matrix<Real> *output) {
+  int32 row_offset, row_size, col_offset, col_size;
+  ParseMatrixRangeSpecifier(range, input.NumRows(), input.NumCols(),
+                            &row_offset, &row_size, &col_offset, &col_size);
   output->Resize(row_size, col_size, kUndefined);
-  output->CopyFromMat(input.Range(row_range[0], row_size,
-                                  col_range[0], col_size));
+  output->CopyFromMat(input.Range(row_offset, row_size,
+                                  col_offset, col_size));
   return true;
 }
 
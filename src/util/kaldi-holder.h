@@ -218,6 +218,11 @@ class HtkMatrixHolder;
 /// A class for reading/writing Sphinx format matrices.
 template<int kFeatDim = 13> class SphinxMatrixHolder;
 
+/// A holder for matrices whose value is a SubMatrix<Real>, which, when reading
+/// with the "mmap" rspecifier option, points into the mapped archive rather
+/// than to a copy.  T == SubMatrix<Real>.
+template<class Real> class MatrixViewHolder;
+
 /// This templated function exists so that we can write .scp files with
 /// 'object ranges' specified: the canonical example is a [first:last] range
 /// of rows of a matrix, or [first-row:last-row,first-column,last-column]
@@ -242,6 +247,15 @@ template <class Real>
 bool ExtractObjectRange(const Matrix<Real> &input, const std::string &range,
                         Matrix<Real> *output);
 
+/// Parses a range specifier for a matrix with "num_rows" rows and "num_cols"
+/// columns, as used by ExtractObjectRange(), into the first row and the
+/// number of rows, and the first column and the number of columns.  Throws
+/// if the range is invalid.
+void ParseMatrixRangeSpecifier(const std::string &range,
+                               int32 num_rows, int32 num_cols,
+                               int32 *row_offset, int32 *row_size,
+                               int32 *col_offset, int32 *col_size);
+
 /// @} end "addtogroup holders"
 
 
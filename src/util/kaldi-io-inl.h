@@ -31,6 +31,10 @@ bool Input::OpenTextMode(const std::string &rxfilename) {
   return OpenInternal(rxfilename, false, NULL);
 }
 
+bool Input::OpenMapped(const std::string &rxfilename, bool *binary) {
+  return OpenInternal(rxfilename, true, binary, true);
+}
+
 bool Input::IsOpen() {
   return impl_ != NULL;
 }
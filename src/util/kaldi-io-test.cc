@@ -110,9 +110,14 @@ void UnitTestIoNew(bool binary) {
     ko.Close();
 
     {
-      bool binary_in;
-      Input ki(filename, &binary_in);
+      bool binary_in, mapped = (Rand() % 2 == 0);
+      Input ki;
+      bool ans = (mapped ? ki.OpenMapped(filename, &binary_in) :
+                  ki.Open(filename, &binary_in));
+      KALDI_ASSERT(ans);
       std::istream &infile = ki.Stream();
+      size_t num_bytes;
+      KALDI_ASSERT((MappedInputData(infile, &num_bytes) != NULL) == mapped);
       int64 i1_in;
       ReadBasicType(infile, binary_in, &i1_in);
       KALDI_ASSERT(i1_in == i1);
@@ -159,6 +164,46 @@ void UnitTestIoNew(bool binary) {
   }
 }
 
+void UnitTestIoMapped() {
+  {
+    Output ko("tmpf", true, false);
+    ko.Stream() << "0123456789";
+    Output ko2("tmpf2", true, false);
+    ko2.Stream() << "abcdef";
+  }
+  Input ki;
+  size_t num_bytes;
+  bool ans = ki.OpenMapped("tmpf:3");
+  KALDI_ASSERT(ans);
+  const char *data = MappedInputData(ki.Stream(), &num_bytes);
+  KALDI_ASSERT(data != NULL && num_bytes == 7 && *data == '3');
+  ki.Stream().seekg(2, std::ios_base::cur);
+  int c = ki.Stream().get();
+  KALDI_ASSERT(c == '5' && ki.Stream().tellg() == 6);
+  // Opening the same file at another offset just seeks.
+  ans = ki.OpenMapped("tmpf:8");
+  KALDI_ASSERT(ans);
+  KALDI_ASSERT(MappedInputData(ki.Stream(), &num_bytes) == data + 5 &&
+               num_bytes == 2);
+  std::string str;
+  ki.Stream() >> str;
+  KALDI_ASSERT(str == "89" && ki.Stream().eof());
+  ans = ki.OpenMapped("tmpf2");
+  KALDI_ASSERT(ans);
+  ki.Stream() >> str;
+  KALDI_ASSERT(str == "abcdef");
+  // Pipes are not mapped.
+  ans = ki.OpenMapped("echo foo |");
+  KALDI_ASSERT(ans);
+  KALDI_ASSERT(MappedInputData(ki.Stream(), &num_bytes) == NULL);
+  ans = ki.OpenMapped("tmpf:11");
+  KALDI_ASSERT(!ans);
+  ans = ki.OpenMapped("nonexistent-file");
+  KALDI_ASSERT(!ans);
+  unlink("tmpf");
+  unlink("tmpf2");
+}
+
 void UnitTestIoPipe(bool binary) {
   // This is as UnitTestIoNew except with different filenames.
   {
@@ -351,6 +396,7 @@ int main(int argc, const char** argv) {
   UnitTestNativeFilename();
   UnitTestIoNew(false);
   UnitTestIoNew(true);
+  UnitTestIoMapped();
   UnitTestIoPipe(true);
   UnitTestIoPipe(false);
   UnitTestIoStandard();
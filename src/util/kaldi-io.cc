@@ -25,6 +25,7 @@
 #include "util/parse-options.h"
 
 #include "util/kaldi-pipebuf.h"
+#include "util/mapped-file.h"
 
 #ifdef KALDI_CYGWIN_COMPAT
 #include "util/kaldi-cygwin-io-inl.h"
@@ -359,6 +360,8 @@ class InputImplBase {
   virtual InputType MyType() = 0;  // Because if it's kOffsetFileInput, we may
                                    // call Open twice
   // (has efficiency benefits).
+  virtual bool IsMapped() { return false; }  // True for MappedInputImpl, which
+                                             // may also be opened repeatedly.
 
   virtual ~InputImplBase() { }
 };
@@ -647,6 +650,121 @@ class OffsetFileInputImpl: public InputImplBase {
 };
 
 
+// A stream buffer that reads from a block of memory, which for
+// MappedInputImpl is a file mapped into memory.  Unlike std::stringbuf, it does
+// not copy the data.
+class MappedInputBuf: public std::streambuf {
+ public:
+  void SetData(const char *data, size_t size) {
+    char *begin = const_cast<char*>(data);  // we never write to it.
+    setg(begin, begin, begin + size);
+  }
+  const char *Current() const { return gptr(); }
+  size_t NumBytesLeft() const { return egptr() - gptr(); }
+
+ protected:
+  virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                           std::ios_base::openmode which) {
+    if (!(which & std::ios_base::in))
+      return pos_type(off_type(-1));
+    off_type pos = off;
+    if (dir == std::ios_base::cur) pos += gptr() - eback();
+    else if (dir == std::ios_base::end) pos += egptr() - eback();
+    if (pos < 0 || pos > egptr() - eback())
+      return pos_type(off_type(-1));
+    setg(eback(), eback() + pos, egptr());
+    return pos_type(pos);
+  }
+  virtual pos_type seekpos(pos_type pos, std::ios_base::openmode which) {
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+  }
+};
+
+// MappedInputImpl is used by Input::OpenMapped() for files and offsets into
+// files.  Like OffsetFileInputImpl it may be opened repeatedly, and if the file
+// is the same it just seeks.  When it moves to a different file it keeps the
+// previous one mapped as well, because an object read from it that points
+// into the mapped memory (see MatrixViewHolder) may still be in use, e.g. by
+// the background reader of the "bg" rspecifier option.
+class MappedInputImpl: public InputImplBase {
+ public:
+  MappedInputImpl(): file_(NULL), prev_file_(NULL), is_(&buf_) { }
+
+  virtual bool Open(const std::string &rxfilename, bool binary) {
+    std::string filename;
+    size_t offset = 0;
+    if (ClassifyRxfilename(rxfilename) == kOffsetFileInput)
+      OffsetFileInputImpl::SplitFilename(rxfilename, &filename, &offset);
+    else
+      filename = rxfilename;
+    if (file_ == NULL || filename != filename_) {
+      delete prev_file_;
+      prev_file_ = file_;
+      file_ = NULL;
+      {  // Check that the file can be opened, as MappedFile would throw.
+        std::ifstream is(MapOsPath(filename).c_str(),
+                         std::ios_base::in | std::ios_base::binary);
+        if (!is.is_open())
+          return false;
+      }
+      try {
+        file_ = new MappedFile(MapOsPath(filename));
+      } catch (...) {
+        return false;  // The error was printed.
+      }
+      filename_ = filename;
+      buf_.SetData(file_->Data(), file_->Size());
+    }
+    is_.clear();
+    if (offset > file_->Size()) {
+      KALDI_WARN << "Offset " << offset << " is past the end of "
+                 << filename_;
+      return false;
+    }
+    is_.seekg(offset, std::ios_base::beg);
+    return !is_.fail();
+  }
+
+  virtual std::istream &Stream() {
+    if (file_ == NULL)
+      KALDI_ERR << "MappedInputImpl::Stream(), file is not open.";
+    return is_;
+  }
+
+  virtual int32 Close() {
+    if (file_ == NULL)
+      KALDI_ERR << "MappedInputImpl::Close(), file is not open.";
+    delete file_;
+    delete prev_file_;
+    file_ = prev_file_ = NULL;
+    return 0;
+  }
+
+  virtual InputType MyType() { return kFileInput; }
+
+  virtual bool IsMapped() { return true; }
+
+  virtual ~MappedInputImpl() {
+    delete file_;
+    delete prev_file_;
+  }
+ private:
+  std::string filename_;  // the filename of file_.
+  MappedFile *file_;
+  MappedFile *prev_file_;
+  MappedInputBuf buf_;
+  std::istream is_;
+};
+
+const char *MappedInputData(std::istream &is, size_t *num_bytes) {
+  MappedInputBuf *buf = dynamic_cast<MappedInputBuf*>(is.rdbuf());
+  if (buf == NULL)
+    return NULL;
+  *num_bytes = buf->NumBytesLeft();
+  return buf->Current();
+}
+
+
 Output::Output(const std::string &wxfilename, bool binary,
                bool write_header):impl_(NULL) {
   if (!Open(wxfilename, binary, write_header)) {
@@ -756,11 +874,16 @@ int32 Input::Close() {
 
 bool Input::OpenInternal(const std::string &rxfilename,
                          bool file_binary,
-                         bool *contents_binary) {
+                         bool *contents_binary,
+                         bool mapped) {
   InputType type = ClassifyRxfilename(rxfilename);
+  if (type != kFileInput && type != kOffsetFileInput)
+    mapped = false;  // Only actual files can be mapped.
   if (IsOpen()) {
     // May have to close the stream first.
-    if (type == kOffsetFileInput && impl_->MyType() == kOffsetFileInput) {
+    if (mapped ? impl_->IsMapped() :
+        (type == kOffsetFileInput && impl_->MyType() == kOffsetFileInput &&
+         !impl_->IsMapped())) {
       // We want to use the same object to Open... this is in case
       // the files are the same, so we can just seek.
       if (!impl_->Open(rxfilename, file_binary)) {  // true is binary mode--
@@ -779,7 +902,9 @@ bool Input::OpenInternal(const std::string &rxfilename,
       // and fall through to code below which actually opens the file.
     }
   }
-  if (type ==  kFileInput) {
+  if (mapped) {
+    impl_ = new MappedInputImpl();
+  } else if (type ==  kFileInput) {
     impl_ = new FileInputImpl();
   } else if (type == kStandardInput) {
     impl_ = new StandardInputImpl();
@@ -814,5 +939,76 @@ std::istream &Input::Stream() {
 }
 
 
+InputCache::InputCache(int32 num_inputs): num_inputs_(num_inputs),
+                                          mapped_(false) {
+  KALDI_ASSERT(num_inputs > 0);
+}
+
+void InputCache::SetNumInputs(int32 num_inputs) {
+  KALDI_ASSERT(num_inputs > 0);
+  num_inputs_ = num_inputs;
+  while (static_cast<int32>(inputs_.size()) > num_inputs_) {
+    Element &last = inputs_.back();
+    if (!last.archive.empty())
+      archive_map_.erase(last.archive);
+    delete last.input;
+    inputs_.pop_back();
+  }
+}
+
+Input *InputCache::Open(const std::string &rxfilename,
+                        bool *contents_binary) {
+  std::string archive;
+  if (ClassifyRxfilename(rxfilename) == kOffsetFileInput)
+    archive = rxfilename.substr(0, rxfilename.find_last_of(':'));
+
+  ListType::iterator iter = inputs_.end();
+  if (!archive.empty()) {
+    unordered_map<std::string, ListType::iterator, StringHasher>::iterator
+        map_iter = archive_map_.find(archive);
+    if (map_iter != archive_map_.end())
+      iter = map_iter->second;
+  }
+  if (iter == inputs_.end()) {
+    if (static_cast<int32>(inputs_.size()) < num_inputs_) {
+      Element elem;
+      elem.input = new Input();
+      inputs_.push_back(elem);
+    } else if (!inputs_.back().archive.empty()) {
+      // Reuse the least recently used input.  If it is on an archive,
+      // Input::Open() will close it and open the new one.
+      archive_map_.erase(inputs_.back().archive);
+    }
+    iter = --inputs_.end();
+    iter->archive = archive;
+    if (!archive.empty())
+      archive_map_[archive] = iter;
+  }
+  // Move it to the front: it is now the most recently used.  Splicing does not
+  // invalidate the iterators in archive_map_.
+  inputs_.splice(inputs_.begin(), inputs_, iter);
+
+  bool ans = (mapped_ ? iter->input->OpenMapped(rxfilename, contents_binary) :
+              iter->input->Open(rxfilename, contents_binary));
+  if (!ans) {
+    if (!iter->archive.empty()) {
+      archive_map_.erase(iter->archive);
+      iter->archive = "";
+    }
+    iter->input->Close();
+    return NULL;
+  }
+  return iter->input;
+}
+
+void InputCache::Close() {
+  for (ListType::iterator iter = inputs_.begin(); iter != inputs_.end();
+       ++iter)
+    delete iter->input;
+  inputs_.clear();
+  archive_map_.clear();
+}
+
+
 
 }  // end namespace kaldi
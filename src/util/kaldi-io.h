@@ -26,8 +26,10 @@
 #endif
 #include <cctype>  // For isspace.
 #include <limits>
+#include <list>
 #include <string>
 #include "base/kaldi-common.h"
+#include "util/stl-utils.h"
 
 
 namespace kaldi {
@@ -212,6 +214,15 @@ class Input {
   // binary mode (and ignore the \r).
   inline bool OpenTextMode(const std::string &rxfilename);
 
+  // As Open, but if rxfilename is an actual file or an offset into one, the
+  // file is mapped into memory (see MappedFile) and the stream reads from the
+  // mapped memory instead of through the file system.  Objects that support
+  // it (see MatrixViewHolder) can then point into the mapped memory instead of
+  // being copied; see MappedInputData().  Other rxfilenames are opened as by
+  // Open.
+  inline bool OpenMapped(const std::string &rxfilename,
+                         bool *contents_binary = NULL);
+
   // Return true if currently open for reading and Stream() will
   // succeed.  Does not guarantee that the stream is good.
   inline bool IsOpen();
@@ -230,11 +241,69 @@ class Input {
   ~Input();
  private:
   bool OpenInternal(const std::string &rxfilename, bool file_binary,
-                    bool *contents_binary);
+                    bool *contents_binary, bool mapped = false);
   InputImplBase *impl_;
   KALDI_DISALLOW_COPY_AND_ASSIGN(Input);
 };
 
+/// InputCache keeps up to a specified number of Input objects open, one per
+/// archive, so that reading objects from offsets into many archives (as in an
+/// scp file with lines like "utt1 /foo/raw_mfcc.12.ark:1234") in a random order
+/// does not close and reopen an archive for each object.  When all the inputs
+/// are in use, the one that was least recently used is reused.  Inputs that
+/// are not offsets into files (e.g. pipes) are opened in the same way, but
+/// they are never reused.  Note: each cached input uses a file descriptor, so
+/// the number of inputs should be well below the limit on open files
+/// (see "ulimit -n").
+class InputCache {
+ public:
+  explicit InputCache(int32 num_inputs = 1);
+
+  /// Changes the maximum number of open inputs, closing inputs if there are
+  /// too many.
+  void SetNumInputs(int32 num_inputs);
+
+  /// If "mapped" is true, inputs are opened with Input::OpenMapped() rather
+  /// than Input::Open().
+  void SetMapped(bool mapped) { mapped_ = mapped; }
+
+  int32 NumInputs() const { return num_inputs_; }
+
+  /// Opens "rxfilename" as Input::Open() would, reusing an open input on the
+  /// same archive if there is one.  Returns the input, or NULL on failure.
+  /// The returned input remains valid until the next call to Open() or
+  /// Close().
+  Input *Open(const std::string &rxfilename, bool *contents_binary = NULL);
+
+  /// Closes all the inputs.
+  void Close();
+
+  ~InputCache() { Close(); }
+ private:
+  struct Element {
+    std::string archive;  // The filename part of an offset rxfilename, or ""
+                          // if the input cannot be reused.
+    Input *input;
+  };
+  typedef std::list<Element> ListType;
+  int32 num_inputs_;
+  bool mapped_;
+  // The open inputs, most recently used first.
+  ListType inputs_;
+  // Maps from the archive filename to the position in inputs_.
+  unordered_map<std::string, ListType::iterator, StringHasher> archive_map_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(InputCache);
+};
+
+/// If "is" is the stream of an Input that was opened with Input::OpenMapped()
+/// on an actual file, returns the address of the stream's current position in
+/// the mapped memory, and puts in "num_bytes" the number of bytes from there to
+/// the end of the file; the caller may then skip over data it uses in place
+/// with is.seekg().  Otherwise returns NULL.  The memory is read-only, and
+/// remains valid until the Input is closed or opened on a file other than
+/// the current and the previous one.
+const char *MappedInputData(std::istream &is, size_t *num_bytes);
+
 template <class C> inline void ReadKaldiObject(const std::string &filename,
                                                C *c) {
   bool binary_in;
@@ -313,7 +313,10 @@ template<class Holder>  class SequentialTableReaderScriptImpl:
       bool ans;
       // note, NULL means it doesn't read the binary-mode header
       if (Holder::IsReadInBinary()) {
-        ans = data_input_.Open(data_rxfilename_, NULL);
+        if (opts_.mmap)
+          ans = data_input_.OpenMapped(data_rxfilename_, NULL);
+        else
+          ans = data_input_.Open(data_rxfilename_, NULL);
       } else {
         ans = data_input_.OpenTextMode(data_rxfilename_);
       }
@@ -426,7 +429,9 @@ template<class Holder>  class SequentialTableReaderScriptImpl:
       state_ = kEof;  // there is nothing more in the scp file.  Might as well
                       // close input streams as we don't need them.
       script_input_.Close();
-      if (data_input_.IsOpen())
+      // With "mmap" the last object may point into the mapped file and still
+      // be in use (e.g. with "bg"), so we leave that to Close().
+      if (data_input_.IsOpen() && !opts_.mmap)
         data_input_.Close();
       holder_.Clear();  // clear the holder if it was nonempty.
       range_holder_.Clear();  // clear the range holder if it was nonempty.
@@ -516,7 +521,9 @@ template<class Holder>  class SequentialTableReaderArchiveImpl:
 
     bool ans;
     // NULL means don't expect binary-mode header
-    if (Holder::IsReadInBinary())
+    if (Holder::IsReadInBinary() && opts_.mmap)
+      ans = input_.OpenMapped(archive_rxfilename_, NULL);
+    else if (Holder::IsReadInBinary())
       ans = input_.Open(archive_rxfilename_, NULL);
     else
       ans = input_.OpenTextMode(archive_rxfilename_);
@@ -1621,7 +1628,8 @@ class RandomAccessTableReaderScriptImpl:
  public:
   typedef typename Holder::T T;
 
-  RandomAccessTableReaderScriptImpl(): last_found_(0), state_(kUninitialized) {}
+  RandomAccessTableReaderScriptImpl(): last_found_(0), state_(kUninitialized),
+                                       read_ahead_running_(false) {}
 
   virtual bool Open(const std::string &rspecifier) {
     switch (state_) {
@@ -1637,6 +1645,9 @@ class RandomAccessTableReaderScriptImpl:
                                            &opts_);
     KALDI_ASSERT(rs == kScriptRspecifier);  // or wrongly called.
     KALDI_ASSERT(script_.empty());  // no way it could be nonempty at this point
+    inputs_.SetNumInputs(opts_.num_open_files);
+    inputs_.SetMapped(opts_.mmap && Holder::IsReadInBinary());
+    read_ahead_inputs_.SetNumInputs(opts_.num_open_files);
 
     if (!ReadScriptFile(script_rxfilename_,
                         true,  // print any warnings
@@ -1679,6 +1690,10 @@ class RandomAccessTableReaderScriptImpl:
     if (!IsOpen())
       KALDI_ERR << "Close() called on RandomAccessTableReader that was not"
                    " open.";
+    FinishReadAhead();
+    read_ahead_holder_.Clear();
+    inputs_.Close();
+    read_ahead_inputs_.Close();
     holder_.Clear();
     range_holder_.Clear();
     state_ = kUninitialized;
@@ -1716,7 +1731,7 @@ class RandomAccessTableReaderScriptImpl:
     }
   }
 
-  virtual ~RandomAccessTableReaderScriptImpl() { }
+  virtual ~RandomAccessTableReaderScriptImpl() { FinishReadAhead(); }
 
  private:
 
@@ -1751,19 +1766,8 @@ class RandomAccessTableReaderScriptImpl:
                       // object could be read.
       } else {  // preload specified, so we have to attempt to pre-load the
                 // object before returning.
-        std::string data_rxfilename, range; // We will split
-        // script_[key_pos].second (e.g. "1.ark:100[0:2]" into data_rxfilename
-        // (e.g. "1.ark:100") and range (if any), e.g. "0:2".
-        if (script_[key_pos].second[script_[key_pos].second.size()-1] == ']') {
-          if(!ExtractRangeSpecifier(script_[key_pos].second,
-                                    &data_rxfilename,
-                                    &range)) {
-            KALDI_ERR << "TableReader: failed to parse range in '"
-                      << script_[key_pos].second << "'";
-          }
-        } else {
-          data_rxfilename = script_[key_pos].second;
-        }
+        std::string data_rxfilename, range;
+        SplitScriptEntry(script_[key_pos].second, &data_rxfilename, &range);
         if (state_ == kHaveRange) {
           if (data_rxfilename_ == data_rxfilename && range_ == range) {
             // the odd situation where two keys had the same rxfilename and range:
@@ -1791,19 +1795,10 @@ class RandomAccessTableReaderScriptImpl:
         range_ = range;
         if (state_ == kNotHaveObject) {
           // we need to read the object.
-          if (!input_.Open(data_rxfilename)) {
-            KALDI_WARN << "Error opening stream "
-                       << PrintableRxfilename(data_rxfilename);
+          if (ReadObject(key_pos, data_rxfilename))
+            state_ = kHaveObject;
+          else
             return false;
-          } else {
-            if (holder_.Read(input_.Stream())) {
-              state_ = kHaveObject;
-            } else {
-              KALDI_WARN << "Error reading object from "
-                  "stream " << PrintableRxfilename(data_rxfilename);
-              return false;
-            }
-          }
         }
         // At this point the state is kHaveObject.
         if (range.empty())
@@ -1822,6 +1817,114 @@ class RandomAccessTableReaderScriptImpl:
     }
   }
 
+  // Splits an entry of the scp file (e.g. "1.ark:100[0:2]") into the
+  // rxfilename (e.g. "1.ark:100") and the range (if any, e.g. "0:2").
+  static void SplitScriptEntry(const std::string &entry,
+                               std::string *data_rxfilename,
+                               std::string *range) {
+    range->clear();
+    if (!entry.empty() && entry[entry.size() - 1] == ']') {
+      if (!ExtractRangeSpecifier(entry, data_rxfilename, range)) {
+        KALDI_ERR << "TableReader: failed to parse range in '"
+                  << entry << "'";
+      }
+    } else {
+      *data_rxfilename = entry;
+    }
+  }
+
+  // Reads the object from "data_rxfilename", which is the rxfilename (without
+  // any range) of script_[key_pos], into holder_.  Takes it from the
+  // read-ahead thread if that was reading it.  Returns true on success.
+  bool ReadObject(size_t key_pos, const std::string &data_rxfilename) {
+    bool ans = false;
+    if (read_ahead_running_) {
+      FinishReadAhead();
+      if (read_ahead_ok_ && read_ahead_rxfilename_ == data_rxfilename) {
+        holder_.Swap(&read_ahead_holder_);
+        ans = true;
+      }
+      read_ahead_holder_.Clear();
+    }
+    if (!ans) {
+      Input *input = inputs_.Open(data_rxfilename);
+      if (input == NULL) {
+        KALDI_WARN << "Error opening stream "
+                   << PrintableRxfilename(data_rxfilename);
+      } else if (holder_.Read(input->Stream())) {
+        ans = true;
+      } else {
+        KALDI_WARN << "Error reading object from "
+            "stream " << PrintableRxfilename(data_rxfilename);
+      }
+    }
+    // The "cs" option asserts that the keys will be requested in sorted
+    // order, so if "bg" was also given we start reading the object for the
+    // next key while the caller processes this one.  We don't with "mmap",
+    // as the object read ahead could point into an archive that is unmapped
+    // while it is in use.
+    if (opts_.background && opts_.called_sorted && !opts_.mmap)
+      StartReadAhead(key_pos, data_rxfilename);
+    return ans;
+  }
+
+  // Starts a thread that reads the object for the first entry after
+  // script_[key_pos] whose rxfilename is not "data_rxfilename", into
+  // read_ahead_holder_.
+  void StartReadAhead(size_t key_pos, const std::string &data_rxfilename) {
+    KALDI_ASSERT(!read_ahead_running_);
+    for (size_t i = key_pos + 1; i < script_.size(); i++) {
+      std::string rxfilename, range;
+      SplitScriptEntry(script_[i].second, &rxfilename, &range);
+      if (rxfilename == data_rxfilename)
+        continue;
+      read_ahead_rxfilename_ = rxfilename;
+      read_ahead_ok_ = false;
+      pthread_attr_t pthread_attr;
+      pthread_attr_init(&pthread_attr);
+      int32 ret = pthread_create(
+          &read_ahead_thread_,
+          &pthread_attr,
+          RandomAccessTableReaderScriptImpl<Holder>::RunReadAhead,
+          static_cast<void*>(this));
+      if (ret != 0) {
+        const char *c = strerror(ret);
+        KALDI_WARN << "Error creating thread, errno was: " << c;
+      } else {
+        read_ahead_running_ = true;
+      }
+      return;
+    }
+  }
+
+  // This function is called in the read-ahead thread.  It only accesses the
+  // read_ahead_* variables, which the main thread does not touch until it
+  // has called FinishReadAhead().
+  static void *RunReadAhead(void *this_ptr) {
+    RandomAccessTableReaderScriptImpl<Holder> *self =
+        reinterpret_cast<RandomAccessTableReaderScriptImpl<Holder>*>(this_ptr);
+    try {
+      Input *input = self->read_ahead_inputs_.Open(
+          self->read_ahead_rxfilename_);
+      self->read_ahead_ok_ = (input != NULL &&
+                              self->read_ahead_holder_.Read(input->Stream()));
+    } catch (...) {
+      // If reading fails, the main thread will read the object again and
+      // print the error.
+      self->read_ahead_ok_ = false;
+    }
+    return NULL;
+  }
+
+  // Waits for the read-ahead thread, if it is running, to finish.
+  void FinishReadAhead() {
+    if (read_ahead_running_) {
+      if (pthread_join(read_ahead_thread_, NULL) != 0)
+        KALDI_WARN << "Error rejoining thread.";
+      read_ahead_running_ = false;
+    }
+  }
+
   // This function attempts to look up the key "key" in the sorted array
   // script_.  If it was found it returns true and puts the array offset into
   // 'script_offset'; otherwise it returns false.
@@ -1854,9 +1957,9 @@ class RandomAccessTableReaderScriptImpl:
   }
 
 
-  Input input_;  // Use the same input_ object for reading each file, in case
-                 // the scp specifies offsets in an archive so we can keep the
-                 // same file open.
+  InputCache inputs_;  // Keeps the archives that the scp file points into
+                       // open, so we can seek within them rather than
+                       // reopening them (see the "files=N" option).
   RspecifierOptions opts_;
   std::string rspecifier_;  // rspecifier used to open this object; used in
                             // debug messages
@@ -1904,6 +2007,17 @@ class RandomAccessTableReaderScriptImpl:
     // corresponds to the range 'range_' of the object in 'holder_', and always
     // corresponds to the current key.
   } state_;
+
+  // The following variables are used when reading ahead ("bg" and "cs"
+  // options).  While read_ahead_running_ is true, the read-ahead thread is
+  // reading the object from read_ahead_rxfilename_ into read_ahead_holder_,
+  // using read_ahead_inputs_; read_ahead_ok_ will be true if that succeeded.
+  bool read_ahead_running_;
+  pthread_t read_ahead_thread_;
+  std::string read_ahead_rxfilename_;
+  Holder read_ahead_holder_;
+  InputCache read_ahead_inputs_;
+  bool read_ahead_ok_;
 };
 
 
@@ -1938,7 +2052,9 @@ class RandomAccessTableReaderArchiveImplBase:
 
     // NULL means don't expect binary-mode header
     bool ans;
-    if (Holder::IsReadInBinary())
+    if (Holder::IsReadInBinary() && opts_.mmap)
+      ans = input_.OpenMapped(archive_rxfilename_, NULL);
+    else if (Holder::IsReadInBinary())
       ans = input_.Open(archive_rxfilename_, NULL);
     else
       ans = input_.OpenTextMode(archive_rxfilename_);
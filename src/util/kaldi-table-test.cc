@@ -25,6 +25,12 @@
 
 namespace kaldi {
 
+static std::string IntToString(int32 i) {
+  std::ostringstream os;
+  os << i;
+  return os.str();
+}
+
 void UnitTestReadScriptFile() {
   typedef std::pair<std::string, std::string>  pr;
   {
@@ -324,6 +330,24 @@ void UnitTestClassifyRspecifier() {
     RspecifierType ans = ClassifyRspecifier(a, &b, NULL);
     KALDI_ASSERT(ans == kArchiveRspecifier && b == "a");
   }
+
+  {
+    std::string a = "s,files=20,scp:a", b;
+    RspecifierOptions opts;
+    RspecifierType ans = ClassifyRspecifier(a, &b, &opts);
+    KALDI_ASSERT(ans == kScriptRspecifier && b == "a" && opts.sorted &&
+                 opts.num_open_files == 20);
+  }
+  {
+    std::string a = "files=0,scp:a";
+    RspecifierType ans = ClassifyRspecifier(a, NULL, NULL);
+    KALDI_ASSERT(ans == kNoRspecifier);
+  }
+  {
+    std::string a = "files=x,scp:a";
+    RspecifierType ans = ClassifyRspecifier(a, NULL, NULL);
+    KALDI_ASSERT(ans == kNoRspecifier);
+  }
 }
 
 void UnitTestTableSequentialInt32(bool binary) {
@@ -1048,7 +1072,246 @@ void UnitTestTableRandomBothDoubleMatrix(bool binary, bool read_scp,
   unlink("tmpf.scp");
 }
 
+// Writes several archives and reads them through one scp file whose entries
+// alternate between the archives, with the "files=N" and (if called_sorted)
+// the "bg" options.
+// Tests RandomAccessDoubleMatrixReader with the rspecifier option "option"
+// (e.g. "bg," or "mmap,").  If called_sorted, the keys are looked up in
+// sorted order with the "cs" option, otherwise in reverse order.
+void UnitTestTableRandomDoubleMatrixOption(bool binary, bool read_scp,
+                                           bool called_sorted,
+                                           const std::string &option) {
+  int32 sz = 1 + Rand() % 10;
+  std::vector<std::string> k(sz);
+  std::vector<Matrix<double> > v(sz);
+  DoubleMatrixWriter bw(binary ? "b,ark,scp:tmpf,tmpf.scp" :
+                        "t,ark,scp:tmpf,tmpf.scp");
+  for (int32 i = 0; i < sz; i++) {
+    k[i] = "key" + IntToString(1000 + i);  // The keys are sorted.
+    v[i].Resize(1 + Rand() % 3, 1 + Rand() % 3);
+    v[i].SetRandn();
+    bw.Write(k[i], v[i]);
+  }
+  bool ans = bw.Close();
+  KALDI_ASSERT(ans);
 
+  std::string name = option + "s,";
+  if (called_sorted) name += "cs,";
+  name += (read_scp ? "scp:tmpf.scp" : "ark:tmpf");
+  RandomAccessDoubleMatrixReader reader(name);
+  for (int32 n = 0; n < sz; n++) {
+    int32 i = (called_sorted ? n : sz - 1 - n);
+    ans = reader.HasKey(k[i]);
+    KALDI_ASSERT(ans);
+    KALDI_ASSERT(v[i].ApproxEqual(reader.Value(k[i]), binary ? 1.0e-10 : 0.01));
+  }
+  ans = reader.Close();
+  KALDI_ASSERT(ans);
+  unlink("tmpf");
+  unlink("tmpf.scp");
+}
+
+void UnitTestTableRandomMultipleArchives(bool binary, bool called_sorted) {
+  int32 num_archives = 1 + Rand() % 4, sz = Rand() % 20;
+  std::vector<std::string> k;
+  std::vector<Matrix<double> > v;
+  std::vector<std::pair<std::string, std::string> > script;
+  for (int32 a = 0; a < num_archives; a++) {
+    std::string ark = "tmpf." + IntToString(a),
+        scp = ark + ".scp";
+    DoubleMatrixWriter bw(std::string(binary ? "b," : "t,") + "ark,scp:" +
+                          ark + "," + scp);
+    for (int32 i = a; i < sz; i += num_archives) {
+      k.push_back("key" + IntToString(1000 + i));
+      v.resize(v.size() + 1);
+      v.back().Resize(1 + Rand() % 3, 1 + Rand() % 3);
+      v.back().SetRandn();
+      bw.Write(k.back(), v.back());
+    }
+    bool ans = bw.Close();
+    KALDI_ASSERT(ans);
+    std::vector<std::pair<std::string, std::string> > this_script;
+    ans = ReadScriptFile(scp, true, &this_script);
+    KALDI_ASSERT(ans);
+    script.insert(script.end(), this_script.begin(), this_script.end());
+    unlink(scp.c_str());
+  }
+  std::sort(script.begin(), script.end());
+  bool ans = WriteScriptFile("tmpf.scp", script);
+  KALDI_ASSERT(ans);
+
+  std::string name = "files=" + IntToString(1 + Rand() % 3) + ",";
+  if (called_sorted) name += "cs,bg,";
+  if (Rand() % 2 == 0) name += "mmap,";
+  name += "scp:tmpf.scp";
+  RandomAccessDoubleMatrixReader reader(name);
+  std::vector<int32> order;
+  for (int32 i = 0; i < sz; i++)
+    if (Rand() % 3 != 0)
+      order.push_back(i);
+  if (called_sorted) {
+    // The keys sort in the same order as the index "i" above.
+    std::sort(order.begin(), order.end());
+  } else {
+    RandomizeVector(&order);
+  }
+  for (size_t i = 0; i < order.size(); i++) {
+    int32 j = std::find(k.begin(), k.end(),
+                        "key" + IntToString(1000 + order[i])) -
+        k.begin();
+    ans = reader.HasKey(k[j]);
+    KALDI_ASSERT(ans);
+    KALDI_ASSERT(v[j].ApproxEqual(reader.Value(k[j]), binary ? 1.0e-10 : 0.01));
+  }
+  ans = reader.HasKey("key");
+  KALDI_ASSERT(!ans);
+  ans = reader.Close();
+  KALDI_ASSERT(ans);
+  for (int32 a = 0; a < num_archives; a++)
+    unlink(("tmpf." + IntToString(a)).c_str());
+  unlink("tmpf.scp");
+}
+
+// Tests MatrixViewHolder, with and without the "mmap" option.
+void UnitTestTableMatrixView(bool binary, bool compress, bool mmap) {
+  int32 sz = Rand() % 10;
+  std::vector<std::string> k;
+  std::vector<Matrix<BaseFloat> > v(sz);
+  {
+    std::string wspecifier = (binary ? "b,ark,scp:tmpf,tmpf.scp" :
+                              "t,ark,scp:tmpf,tmpf.scp");
+    BaseFloatMatrixWriter writer;
+    CompressedMatrixWriter compressed_writer;
+    bool ans = (compress ? compressed_writer.Open(wspecifier) :
+                writer.Open(wspecifier));
+    KALDI_ASSERT(ans);
+    for (int32 i = 0; i < sz; i++) {
+      k.push_back("key" + IntToString(10 + i * i));  // various lengths.
+      int32 rows = Rand() % 4;
+      v[i].Resize(rows, rows == 0 ? 0 : 1 + Rand() % 5);
+      v[i].SetRandn();
+      if (compress) {
+        CompressedMatrix cmat(v[i]);
+        cmat.CopyToMat(&(v[i]));
+        compressed_writer.Write(k[i], cmat);
+      } else {
+        writer.Write(k[i], v[i]);
+      }
+    }
+  }
+  BaseFloat tolerance = (binary ? 1.0e-10 : 0.01);
+  std::string opts = (mmap ? "mmap," : "");
+
+  SequentialBaseFloatMatrixViewReader reader(opts + "ark:tmpf");
+  const char *prev_data = NULL;
+  for (int32 i = 0; i < sz; i++, reader.Next()) {
+    KALDI_ASSERT(!reader.Done() && reader.Key() == k[i]);
+    const SubMatrix<BaseFloat> &value = reader.Value();
+    KALDI_ASSERT(value.ApproxEqual(v[i], tolerance));
+    if (binary && !compress && mmap && value.NumRows() != 0) {
+      // The matrices are read in place from the archive, so the distance
+      // between two of them is the size of what was written in between.
+      const char *data = reinterpret_cast<const char*>(value.Data());
+      if (prev_data != NULL && v[i - 1].NumRows() != 0) {
+        size_t expected = v[i - 1].NumRows() * v[i - 1].NumCols() *
+            sizeof(BaseFloat) + k[i].size() + 1 + 2 + 3 + 2 * 5;
+        KALDI_ASSERT(data - prev_data == static_cast<ptrdiff_t>(expected));
+      }
+      prev_data = data;
+    } else {
+      prev_data = NULL;
+    }
+  }
+  KALDI_ASSERT(reader.Done());
+
+  // Write an scp file with ranges.
+  std::vector<std::pair<std::string, std::string> > script;
+  bool ans = ReadScriptFile("tmpf.scp", true, &script);
+  KALDI_ASSERT(ans);
+  std::vector<int32> row_offsets(sz, 0), num_rows(sz, 0);
+  for (int32 i = 0; i < sz; i++) {
+    num_rows[i] = v[i].NumRows();
+    if (v[i].NumRows() != 0 && Rand() % 2 == 0) {
+      row_offsets[i] = Rand() % v[i].NumRows();
+      num_rows[i] = 1 + Rand() % (v[i].NumRows() - row_offsets[i]);
+      script[i].second += "[" + IntToString(row_offsets[i]) + ":" +
+          IntToString(row_offsets[i] + num_rows[i] - 1) + "]";
+    }
+  }
+  ans = WriteScriptFile("tmpf.scp", script);
+  KALDI_ASSERT(ans);
+  RandomAccessBaseFloatMatrixViewReader scp_reader(opts + "scp:tmpf.scp"),
+      ark_reader(opts + "ark:tmpf");
+  for (int32 n = 0; n < 2 * sz; n++) {
+    int32 i = Rand() % sz;
+    KALDI_ASSERT(ark_reader.Value(k[i]).ApproxEqual(v[i], tolerance));
+    if (num_rows[i] != 0) {
+      SubMatrix<BaseFloat> range(v[i], row_offsets[i], num_rows[i],
+                                 0, v[i].NumCols());
+      KALDI_ASSERT(scp_reader.Value(k[i]).ApproxEqual(range, tolerance));
+    }
+  }
+  unlink("tmpf");
+  unlink("tmpf.scp");
+}
+
+// Tests MatrixViewHolder with the "bg" option and an scp file with ranges:
+// the background thread reads the next matrix while we still use the range of
+// the current one, which must therefore not point into the memory it frees.
+// The matrices all have the same size, so that this memory would be reused.
+void UnitTestTableMatrixViewBackground(bool binary, bool compress, bool mmap) {
+  int32 sz = 2 + Rand() % 5, rows = 2 + Rand() % 10, cols = 1 + Rand() % 5;
+  std::vector<std::string> k;
+  std::vector<Matrix<BaseFloat> > v(sz);
+  {
+    std::string wspecifier = (binary ? "b,ark,scp:tmpf,tmpf.scp" :
+                              "t,ark,scp:tmpf,tmpf.scp");
+    BaseFloatMatrixWriter writer;
+    CompressedMatrixWriter compressed_writer;
+    bool ans = (compress ? compressed_writer.Open(wspecifier) :
+                writer.Open(wspecifier));
+    KALDI_ASSERT(ans);
+    for (int32 i = 0; i < sz; i++) {
+      k.push_back("key" + IntToString(10 + i));
+      v[i].Resize(rows, cols);
+      v[i].SetRandn();
+      if (compress) {
+        CompressedMatrix cmat(v[i]);
+        cmat.CopyToMat(&(v[i]));
+        compressed_writer.Write(k[i], cmat);
+      } else {
+        writer.Write(k[i], v[i]);
+      }
+    }
+  }
+  std::vector<std::pair<std::string, std::string> > script;
+  bool ans = ReadScriptFile("tmpf.scp", true, &script);
+  KALDI_ASSERT(ans);
+  std::vector<int32> row_offsets(sz);
+  for (int32 i = 0; i < sz; i++) {
+    row_offsets[i] = Rand() % (rows - 1);
+    script[i].second += "[" + IntToString(row_offsets[i]) + ":" +
+        IntToString(rows - 1) + "]";
+  }
+  ans = WriteScriptFile("tmpf.scp", script);
+  KALDI_ASSERT(ans);
+
+  BaseFloat tolerance = (binary ? 1.0e-10 : 0.01);
+  SequentialBaseFloatMatrixViewReader reader(
+      std::string("bg,") + (mmap ? "mmap," : "") + "scp:tmpf.scp");
+  for (int32 i = 0; i < sz; i++, reader.Next()) {
+    KALDI_ASSERT(!reader.Done() && reader.Key() == k[i]);
+    const SubMatrix<BaseFloat> &value = reader.Value();
+    // Give the background thread time to read the next matrix.
+    Sleep(0.01);
+    SubMatrix<BaseFloat> range(v[i], row_offsets[i], rows - row_offsets[i],
+                               0, cols);
+    KALDI_ASSERT(value.ApproxEqual(range, tolerance));
+  }
+  KALDI_ASSERT(reader.Done());
+  unlink("tmpf");
+  unlink("tmpf.scp");
+}
 
 }  // end namespace kaldi.
 
@@ -1083,6 +1346,16 @@ int main() {
           }
         }
       }
+      for (int k = 0; k < 2; k++) {
+        bool d = (k == 0);
+        UnitTestTableRandomDoubleMatrixOption(b, c, d, "bg,");
+        UnitTestTableRandomDoubleMatrixOption(b, c, d, "files=2,");
+        UnitTestTableRandomDoubleMatrixOption(b, c, d, "mmap,");
+      }
+      UnitTestTableRandomMultipleArchives(b, c);
+      UnitTestTableMatrixView(b, c, Rand() % 2 == 0);
+      UnitTestTableMatrixViewBackground(b, c, false);
+      UnitTestTableMatrixViewBackground(b, c, true);
     }
   }
   std::cout << "Test OK.\n";
@@ -247,7 +247,7 @@ RspecifierType ClassifyRspecifier(const std::string &rspecifier,
   // We also allow the meaningless prefixes b, and t,
   // plus the options o (once), no (not-once),
   // s (sorted) and ns (not-sorted), p (permissive)
-  // and np (not-permissive).
+  // and np (not-permissive), bg (background), files=N and mmap.
   // so the following would be valid:
   //
   // f, o, b, np, ark:rxfilename  ->  kArchiveRspecifier
@@ -308,6 +308,14 @@ RspecifierType ClassifyRspecifier(const std::string &rspecifier,
       if (opts) opts->called_sorted = false;
     } else if (!strcmp(c, "bg")) {
       if (opts) opts->background = true;
+    } else if (!strcmp(c, "mmap")) {
+      if (opts) opts->mmap = true;
+    } else if (!strncmp(c, "files=", 6)) {
+      int32 num_open_files;
+      if (!ConvertStringToInteger(std::string(c + 6), &num_open_files) ||
+          num_open_files <= 0)
+        return kNoRspecifier;
+      if (opts) opts->num_open_files = num_open_files;
     } else if (!strcmp(c, "ark")) {
       if (rs == kNoRspecifier) rs = kArchiveRspecifier;
       else
@@ -184,11 +184,27 @@ bool WriteScriptFile(std::ostream &os,
 //       [any of the above options can be prefixed by n to negate them, e.g. no,
 //       ns, ncs, np; but these aren't currently useful as you could just omit
 //       the option].
-//   bg means "background".  It currently has no effect for random-access readers,
-//       but for sequential readers it will cause it to "read ahead" to the next
-//       value, in a background thread.  Recommended when reading larger objects
-//       such as neural-net training examples, especially when you want to
-//       maximize GPU usage.
+//   bg means "background".  For sequential readers it will cause it to "read
+//       ahead" to the next value, in a background thread.  Recommended when
+//       reading larger objects such as neural-net training examples, especially
+//       when you want to maximize GPU usage.  For random-access readers it only
+//       has an effect for scp files when combined with cs: then, after reading
+//       the value for a key, it reads the value for the next key in the scp
+//       file in a background thread.
+//   files=N  For random-access readers of scp files, means that up to N
+//       archives that the scp file points into are kept open (the default is
+//       1).  This avoids reopening archives for each key when the keys are
+//       requested in a different order from that of the scp file, e.g. when
+//       the scp file was sorted after being combined from many archives.
+//       With "bg" and "cs", the background thread keeps its own set of up to N
+//       archives open, so up to 2N files may be open; this should be well
+//       below the limit on open files ("ulimit -n").
+//   mmap  means that archives that are actual files (not pipes), whether read
+//       directly or through offsets in an scp file, are mapped into memory
+//       and read from there.  This is faster for binary archives on local
+//       disks, and with holders that support it (MatrixViewHolder) the
+//       objects point into the mapped memory instead of being copied.  With
+//       mmap, the "bg" option has no effect for random-access readers.
 //
 //   b   is ignored [for scripting convenience]
 //   t   is ignored [for scripting convenience]
@@ -197,6 +213,8 @@ bool WriteScriptFile(std::ostream &os,
 //  So for instance the following would be a valid rspecifier:
 //
 //   "o, s, p, ark:gunzip -c foo.gz|"
+//   "s, cs, bg, files=100, scp:feats.scp"
+//   "mmap, ark:/data/egs.1.ark"
 
 struct  RspecifierOptions {
   // These options only make a difference for the RandomAccessTableReader class.
@@ -210,10 +228,17 @@ struct  RspecifierOptions {
   // is corrupted and can't be read to the end.
   bool background;  // For sequential readers, if the background option ("bg")
                     // is provided, it will read ahead to the next object in a
-                    // background thread.
+                    // background thread.  For random-access readers of scp
+                    // files it does the same if "called_sorted" is also set.
+  int32 num_open_files;  // For random-access readers of scp files: the number
+                         // of archives that are kept open ("files=N" option);
+                         // twice as many with read-ahead ("bg" and "cs").
+  bool mmap;  // If the "mmap" option is provided, archives that are actual
+              // files are mapped into memory rather than read through a stream
+              // (see Input::OpenMapped()).
   RspecifierOptions(): once(false), sorted(false),
                        called_sorted(false), permissive(false),
-                       background(false) { }
+                       background(false), num_open_files(1), mmap(false) { }
 };
 
 enum RspecifierType  {
@@ -0,0 +1,70 @@
+// util/mapped-file-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "util/mapped-file.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace kaldi {
+
+void UnitTestMappedFile() {
+  std::string filename = "tmpf.mapped";
+  std::string contents;
+  int32 size = Rand() % 10000;
+  if (Rand() % 5 == 0) size = 0;
+  for (int32 i = 0; i < size; i++)
+    contents.push_back(static_cast<char>(Rand() % 256));
+  {
+    std::ofstream os(filename.c_str(), std::ios::out | std::ios::binary);
+    os.write(contents.data(), contents.size());
+    KALDI_ASSERT(os.good());
+  }
+  {
+    MappedFile mapped(filename);
+    KALDI_ASSERT(mapped.Size() == contents.size());
+    if (size > 0)
+      KALDI_ASSERT(std::string(mapped.Data(), mapped.Size()) == contents);
+    // Two mappings of the same file see the same contents.
+    MappedFile mapped2(filename);
+    KALDI_ASSERT(mapped2.Size() == mapped.Size());
+    if (size > 0)
+      KALDI_ASSERT(memcmp(mapped.Data(), mapped2.Data(), mapped.Size()) == 0);
+  }
+  unlink(filename.c_str());
+}
+
+void UnitTestMappedFileMissing() {
+  bool threw = false;
+  try {
+    MappedFile mapped("tmpf.mapped.nonexistent");
+  } catch (const std::exception &e) {
+    threw = true;
+  }
+  KALDI_ASSERT(threw);
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 10; i++)
+    UnitTestMappedFile();
+  UnitTestMappedFileMissing();
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
@@ -0,0 +1,88 @@
+// util/mapped-file.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "util/mapped-file.h"
+#include <errno.h>
+#include <cstring>
+#include <fstream>
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace kaldi {
+
+#ifndef _MSC_VER
+
+MappedFile::MappedFile(const std::string &filename):
+    filename_(filename), data_(NULL), size_(0) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd == -1)
+    KALDI_ERR << "Could not open file " << filename << " for reading: "
+              << strerror(errno);
+  struct stat buf;
+  if (fstat(fd, &buf) != 0) {
+    close(fd);
+    KALDI_ERR << "Could not stat file " << filename << ": " << strerror(errno);
+  }
+  size_ = buf.st_size;
+  if (size_ == 0) {  // mmap() does not accept a zero length.
+    close(fd);
+    return;
+  }
+  void *addr = mmap(NULL, size_, PROT_READ, MAP_SHARED, fd, 0);
+  // The mapping stays valid after the file descriptor is closed.
+  close(fd);
+  if (addr == MAP_FAILED)
+    KALDI_ERR << "Could not memory-map file " << filename << " of size "
+              << size_ << ": " << strerror(errno);
+  data_ = static_cast<const char*>(addr);
+}
+
+MappedFile::~MappedFile() {
+  if (data_ != NULL && munmap(const_cast<char*>(data_), size_) != 0)
+    KALDI_WARN << "Error unmapping file " << filename_ << ": "
+               << strerror(errno);
+}
+
+#else  // _MSC_VER
+
+MappedFile::MappedFile(const std::string &filename):
+    filename_(filename), data_(NULL), size_(0) {
+  std::ifstream is(filename.c_str(), std::ios::in | std::ios::binary);
+  if (!is.is_open())
+    KALDI_ERR << "Could not open file " << filename << " for reading.";
+  is.seekg(0, std::ios::end);
+  size_ = is.tellg();
+  is.seekg(0, std::ios::beg);
+  char *data = new char[size_];
+  if (!is.read(data, size_)) {
+    delete[] data;
+    KALDI_ERR << "Error reading file " << filename;
+  }
+  data_ = data;
+}
+
+MappedFile::~MappedFile() {
+  delete[] data_;
+}
+
+#endif  // _MSC_VER
+
+}  // namespace kaldi
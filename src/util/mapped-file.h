@@ -0,0 +1,63 @@
+// util/mapped-file.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_UTIL_MAPPED_FILE_H_
+#define KALDI_UTIL_MAPPED_FILE_H_
+
+#include <string>
+#include "base/kaldi-common.h"
+
+namespace kaldi {
+
+/// MappedFile gives read-only access to the contents of a file, by mapping it
+/// into memory with mmap().  The pages are shared with the page cache, so if
+/// several processes on a machine map the same large file (e.g. a decoding
+/// graph or a language model), it only occupies physical memory once, and
+/// there is no time spent parsing it when a process starts.
+///
+/// The data is mapped read-only, so anything that points into it must be
+/// treated as const.  The start of the data is aligned to a page boundary, so
+/// a byte offset into the file that is a multiple of n gives an address that
+/// is a multiple of n, for n up to the page size.
+///
+/// On platforms without mmap() the file is just read into memory, so the
+/// interface still works but there is no sharing between processes.
+class MappedFile {
+ public:
+  /// Maps the file "filename", which must be an actual file, not a pipe or
+  /// the standard input (see ClassifyRxfilename()).  Throws on error.
+  explicit MappedFile(const std::string &filename);
+
+  ~MappedFile();
+
+  /// Returns the start of the file's contents.
+  const char *Data() const { return data_; }
+
+  /// Returns the size of the file in bytes.
+  size_t Size() const { return size_; }
+
+ private:
+  std::string filename_;
+  const char *data_;
+  size_t size_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(MappedFile);
+};
+
+
+}  // namespace kaldi
+
+#endif  // KALDI_UTIL_MAPPED_FILE_H_
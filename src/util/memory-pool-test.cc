@@ -0,0 +1,83 @@
+// util/memory-pool-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "util/memory-pool.h"
+#include <set>
+#include <iostream>
+
+namespace kaldi {
+
+struct TestObject {
+  float cost;
+  int32 label;
+  TestObject *next;
+  TestObject(float cost, int32 label, TestObject *next):
+      cost(cost), label(label), next(next) { }
+};
+
+void TestMemoryPool() {
+  size_t block_size = 1 + Rand() % 100;
+  MemoryPool<TestObject> pool(block_size);
+  std::vector<TestObject*> objects;
+  std::set<TestObject*> live;
+  for (int32 i = 0; i < 1000; i++) {
+    if (objects.empty() || Rand() % 3 != 0) {
+      TestObject *t = new (pool.Allocate()) TestObject(0.5 * i, i, NULL);
+      KALDI_ASSERT(live.count(t) == 0);  // must not hand out a live object.
+      live.insert(t);
+      objects.push_back(t);
+    } else {
+      size_t k = Rand() % objects.size();
+      TestObject *t = objects[k];
+      KALDI_ASSERT(t->cost == 0.5 * t->label);  // check not overwritten.
+      objects[k] = objects.back();
+      objects.pop_back();
+      live.erase(t);
+      pool.Free(t);
+    }
+    KALDI_ASSERT(pool.NumInUse() == objects.size());
+    KALDI_ASSERT(pool.Capacity() >= pool.MaxInUse() &&
+                 pool.MaxInUse() >= pool.NumInUse());
+  }
+  KALDI_ASSERT(pool.NumAllocations() >= objects.size());
+  size_t capacity = pool.Capacity(), max_in_use = pool.MaxInUse();
+  for (size_t i = 0; i < objects.size(); i++)
+    pool.Free(objects[i]);
+  objects.clear();
+  pool.Reset();
+  KALDI_ASSERT(pool.MaxInUse() == 0 && pool.NumInUse() == 0);
+  // After Reset(), allocating up to the old peak should not need any more
+  // memory from the system.
+  for (size_t i = 0; i < max_in_use; i++)
+    objects.push_back(new (pool.Allocate()) TestObject(1.0, i, NULL));
+  KALDI_ASSERT(pool.Capacity() == capacity);
+  KALDI_LOG << pool.Info();
+  for (size_t i = 0; i < objects.size(); i++)
+    pool.Free(objects[i]);
+}
+
+
+}  // end namespace kaldi
+
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 10; i++)
+    TestMemoryPool();
+  std::cout << "Test OK.\n";
+}
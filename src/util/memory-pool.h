@@ -0,0 +1,185 @@
+// util/memory-pool.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_UTIL_MEMORY_POOL_H_
+#define KALDI_UTIL_MEMORY_POOL_H_
+#include <new>
+#include <string>
+#include <sstream>
+#include <vector>
+#include "base/kaldi-common.h"
+
+
+/* This header provides a simple allocator for fixed-size objects, intended for
+   the Tokens and ForwardLinks in the decoders.  Those are created and destroyed
+   in very large numbers (millions per utterance), and doing that with new and
+   delete is slow, and when many decoders run in different threads of the same
+   process it also causes contention inside malloc.
+
+   The pool gets memory from the system in blocks of many objects at a time and
+   never gives it back until the pool is destroyed; objects that are freed go on
+   a free list and are handed out again by the next call to Allocate().  So
+   memory is recycled both within and across utterances.  The pool is not
+   thread-safe: the idea is that each decoder owns its own pool.
+
+   Example:
+     MemoryPool<Token> pool;
+     Token *tok = new (pool.Allocate()) Token(cost, 0.0, NULL, NULL);
+     ...
+     pool.Free(tok);  // calls the destructor, then recycles the memory.
+
+   See memory-pool-test.cc for more.
+*/
+
+
+namespace kaldi {
+
+template<class T> class MemoryPool {
+ public:
+  /// "block_size" is the number of objects we allocate from the system at a
+  /// time.  It should be largish so that the bookkeeping of blocks is cheap.
+  explicit MemoryPool(size_t block_size = 1024);
+
+  /// Returns uninitialized memory suitable for one object of type T.  The
+  /// caller should construct the object with placement new.
+  inline void *Allocate();
+
+  /// Calls the destructor of t (which must have been allocated by this pool)
+  /// and puts its memory on the free list.  Think of this like delete.
+  inline void Free(T *t);
+
+  /// This may be called only when no objects are in use (e.g. at the start of
+  /// an utterance).  It re-creates the free list so that objects will be
+  /// handed out in address order, which gives better memory locality than
+  /// the order in which they happened to be freed.  It also resets the
+  /// statistics returned by MaxInUse().
+  void Reset();
+
+  /// Returns the number of objects currently allocated and not yet freed.
+  size_t NumInUse() const { return num_in_use_; }
+
+  /// Returns the largest value NumInUse() has had since construction or the
+  /// last call to Reset().
+  size_t MaxInUse() const { return max_in_use_; }
+
+  /// Returns the number of objects we have memory for (in use or not).
+  size_t Capacity() const { return blocks_.size() * block_size_; }
+
+  /// Returns the total number of times Allocate() has been called.
+  size_t NumAllocations() const { return num_allocations_; }
+
+  /// Returns a string summarizing the statistics above, for diagnostics.
+  std::string Info() const;
+
+  ~MemoryPool();
+
+ private:
+  // When an object is on the free list its memory is used to store the
+  // pointer to the next free object; the union ensures that each slot is
+  // large enough and suitably aligned for that and for T.
+  union Slot {
+    Slot *next;
+    char data[sizeof(T)];
+    double align_double;
+    int64 align_int64;
+  };
+
+  void AllocateBlock();
+
+  size_t block_size_;
+  Slot *free_head_;  // head of the list of free slots.
+  std::vector<Slot*> blocks_;  // the blocks obtained from the system.
+  size_t num_in_use_;
+  size_t max_in_use_;
+  size_t num_allocations_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(MemoryPool);
+};
+
+
+template<class T> MemoryPool<T>::MemoryPool(size_t block_size):
+    block_size_(block_size), free_head_(NULL), num_in_use_(0),
+    max_in_use_(0), num_allocations_(0) {
+  KALDI_ASSERT(block_size > 0);
+}
+
+template<class T> inline void *MemoryPool<T>::Allocate() {
+  if (free_head_ == NULL)
+    AllocateBlock();
+  Slot *ans = free_head_;
+  free_head_ = free_head_->next;
+  num_allocations_++;
+  if (++num_in_use_ > max_in_use_)
+    max_in_use_ = num_in_use_;
+  return static_cast<void*>(ans);
+}
+
+template<class T> inline void MemoryPool<T>::Free(T *t) {
+  t->~T();
+  Slot *slot = reinterpret_cast<Slot*>(t);
+  slot->next = free_head_;
+  free_head_ = slot;
+  KALDI_PARANOID_ASSERT(num_in_use_ > 0);
+  num_in_use_--;
+}
+
+template<class T> void MemoryPool<T>::AllocateBlock() {
+  Slot *block = new Slot[block_size_];
+  for (size_t i = 0; i + 1 < block_size_; i++)
+    block[i].next = block + i + 1;
+  block[block_size_ - 1].next = free_head_;
+  free_head_ = block;
+  blocks_.push_back(block);
+}
+
+template<class T> void MemoryPool<T>::Reset() {
+  KALDI_ASSERT(num_in_use_ == 0 &&
+               "MemoryPool::Reset() called while objects are in use");
+  free_head_ = NULL;
+  // Go backwards so that the first block ends up at the head of the list.
+  for (size_t b = blocks_.size(); b > 0; b--) {
+    Slot *block = blocks_[b - 1];
+    for (size_t i = 0; i + 1 < block_size_; i++)
+      block[i].next = block + i + 1;
+    block[block_size_ - 1].next = free_head_;
+    free_head_ = block;
+  }
+  max_in_use_ = 0;
+}
+
+template<class T> std::string MemoryPool<T>::Info() const {
+  std::ostringstream os;
+  os << "in-use=" << num_in_use_ << ", max-in-use=" << max_in_use_
+     << ", capacity=" << Capacity() << " (" << blocks_.size()
+     << " blocks, " << (Capacity() * sizeof(Slot)) << " bytes)"
+     << ", num-allocations=" << num_allocations_;
+  return os.str();
+}
+
+template<class T> MemoryPool<T>::~MemoryPool() {
+  if (num_in_use_ != 0) {
+    KALDI_WARN << "Possible memory leak: " << num_in_use_
+               << " objects were not freed before destroying MemoryPool.";
+  }
+  for (size_t i = 0; i < blocks_.size(); i++)
+    delete [] blocks_[i];
+}
+
+
+}  // end namespace kaldi
+
+#endif  // KALDI_UTIL_MEMORY_POOL_H_
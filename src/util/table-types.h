@@ -51,6 +51,11 @@ typedef RandomAccessTableReader<KaldiObjectHolder<Matrix<double> > >
 typedef RandomAccessTableReaderMapped<KaldiObjectHolder<Matrix<double> > >
                                       RandomAccessDoubleMatrixReaderMapped;
 
+typedef SequentialTableReader<MatrixViewHolder<BaseFloat> >
+                              SequentialBaseFloatMatrixViewReader;
+typedef RandomAccessTableReader<MatrixViewHolder<BaseFloat> >
+                                RandomAccessBaseFloatMatrixViewReader;
+
 typedef TableWriter<KaldiObjectHolder<CompressedMatrix> >
                                       CompressedMatrixWriter;
 